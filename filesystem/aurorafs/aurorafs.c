@@ -14,6 +14,12 @@
 static aurorafs_mount_t g_aurorafs_mount = {0};
 static bool g_aurorafs_mounted = false;
 
+/* Registered block devices */
+static struct {
+    const char* name;
+    const aurorafs_device_t* dev;
+} g_aurorafs_devices[AURORAFS_MAX_DEVICES];
+
 /* Forward declarations */
 static int aurorafs_mount(const char* device);
 static int aurorafs_unmount(void);
@@ -52,13 +58,81 @@ void aurorafs_init(void) {
     g_aurorafs_mount.dedup_hash_table = NULL;
 }
 
+static void afs_memcpy(void* dest, const void* src, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+    for (size_t i = 0; i < n; i++) {
+        d[i] = s[i];
+    }
+}
+
+static void afs_memset(void* dest, int value, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    for (size_t i = 0; i < n; i++) {
+        d[i] = (uint8_t)value;
+    }
+}
+
+static int afs_strcmp(const char* a, const char* b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return (unsigned char)*a - (unsigned char)*b;
+}
+
 /**
- * Calculate SHA-256 hash (simplified stub)
+ * Register a block device under a name
  */
-static void aurorafs_calculate_hash(const void* data, size_t size, uint8_t* hash) {
-    /* Simplified hash - real implementation would use proper SHA-256 */
-    for (size_t i = 0; i < AURORAFS_HASH_SIZE; i++) {
-        hash[i] = (uint8_t)(i ^ (size & 0xFF));
+int aurorafs_register_device(const char* name, const aurorafs_device_t* dev) {
+    if (!name || !dev || !dev->read || !dev->write) {
+        return -1;
+    }
+
+    int slot = -1;
+    for (int i = 0; i < AURORAFS_MAX_DEVICES; i++) {
+        if (g_aurorafs_devices[i].name && afs_strcmp(g_aurorafs_devices[i].name, name) == 0) {
+            return -1;
+        }
+        if (!g_aurorafs_devices[i].name && slot < 0) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        return -1;
+    }
+
+    g_aurorafs_devices[slot].name = name;
+    g_aurorafs_devices[slot].dev = dev;
+    return 0;
+}
+
+static const aurorafs_device_t* aurorafs_find_device(const char* name) {
+    for (int i = 0; name && i < AURORAFS_MAX_DEVICES; i++) {
+        if (g_aurorafs_devices[i].name && afs_strcmp(g_aurorafs_devices[i].name, name) == 0) {
+            return g_aurorafs_devices[i].dev;
+        }
+    }
+    return NULL;
+}
+
+static inline uint64_t afs_bitmap_blocks(uint64_t total_blocks) {
+    return (total_blocks + AURORAFS_BITMAP_BITS - 1) / AURORAFS_BITMAP_BITS;
+}
+
+/* Bitmap words covering a volume, padded to whole bitmap blocks */
+static inline size_t afs_bitmap_words(uint64_t total_blocks) {
+    return (size_t)(afs_bitmap_blocks(total_blocks) * (AURORAFS_BLOCK_SIZE / sizeof(uint64_t)));
+}
+
+/* Mark the superblock, the bitmap and the padding past the last block
+ * allocated, so the allocator never hands them out */
+static void aurorafs_reserve_metadata(uint64_t* bitmap, uint64_t total_blocks, uint64_t data_start) {
+    for (uint64_t b = 0; b < data_start; b++) {
+        bitmap[b / 64] |= 1ull << (b % 64);
+    }
+    for (uint64_t b = total_blocks; b < afs_bitmap_words(total_blocks) * 64; b++) {
+        bitmap[b / 64] |= 1ull << (b % 64);
     }
 }
 
@@ -66,34 +140,64 @@ static void aurorafs_calculate_hash(const void* data, size_t size, uint8_t* hash
  * Format AuroraFS file system
  */
 int aurorafs_format(const char* device, uint64_t size, uint32_t features) {
-    if (!device) {
+    const aurorafs_device_t* dev = aurorafs_find_device(device);
+    if (!dev) {
+        return -1;
+    }
+
+    uint64_t total_blocks = size / AURORAFS_BLOCK_SIZE;
+    if (total_blocks > dev->blocks) {
+        total_blocks = dev->blocks;
+    }
+    uint64_t bitmap_blocks = afs_bitmap_blocks(total_blocks);
+    uint64_t data_start = 1 + bitmap_blocks;
+    if (total_blocks <= data_start) {
         return -1;
     }
     
     /* Allocate superblock */
+    uint8_t* block = (uint8_t*)kmalloc(AURORAFS_BLOCK_SIZE);
     aurorafs_superblock_t* sb = (aurorafs_superblock_t*)kmalloc(sizeof(aurorafs_superblock_t));
-    if (!sb) {
+    uint64_t* bitmap = (uint64_t*)kmalloc(afs_bitmap_words(total_blocks) * sizeof(uint64_t));
+    if (!block || !sb || !bitmap) {
+        if (block) kfree(block);
+        if (sb) kfree(sb);
+        if (bitmap) kfree(bitmap);
         return -1;
     }
+    afs_memset(sb, 0, sizeof(*sb));
+    afs_memset(bitmap, 0, afs_bitmap_words(total_blocks) * sizeof(uint64_t));
     
     /* Initialize superblock */
     sb->magic = AURORAFS_MAGIC;
     sb->version = AURORAFS_VERSION;
     sb->block_size = AURORAFS_BLOCK_SIZE;
-    sb->total_blocks = size / AURORAFS_BLOCK_SIZE;
-    sb->free_blocks = sb->total_blocks - 100;  /* Reserve some blocks */
+    sb->total_blocks = total_blocks;
+    sb->free_blocks = total_blocks - data_start;
     sb->total_inodes = sb->total_blocks / 4;
     sb->free_inodes = sb->total_inodes - 1;  /* Root inode used */
     sb->features = features;
     sb->root_inode = 1;
+    sb->dedup_table_inode = 0;
     sb->default_compress = AURORAFS_COMPRESS_LZ4;
     sb->default_encrypt = AURORAFS_ENCRYPT_AES256;
     
-    /* Write superblock to device */
-    /* In real implementation, would call storage driver */
+    /* Write the bitmap, then the superblock that makes it a volume */
+    aurorafs_reserve_metadata(bitmap, total_blocks, data_start);
+    int result = dev->write(dev->ctx, 1, bitmap, (uint32_t)bitmap_blocks);
+    if (result == 0) {
+        afs_memset(block, 0, AURORAFS_BLOCK_SIZE);
+        afs_memcpy(block, sb, sizeof(*sb));
+        result = dev->write(dev->ctx, 0, block, 1);
+    }
+    if (result == 0 && dev->flush) {
+        result = dev->flush(dev->ctx);
+    }
     
+    kfree(bitmap);
+    kfree(block);
     kfree(sb);
-    return 0;
+    return result == 0 ? 0 : -1;
 }
 
 /**
@@ -104,40 +208,119 @@ static int aurorafs_mount(const char* device) {
         return -1;  /* Already mounted */
     }
     
+    const aurorafs_device_t* dev = aurorafs_find_device(device);
+    if (!dev) {
+        return -1;
+    }
+    
     /* Allocate and read superblock */
+    uint8_t* block = (uint8_t*)kmalloc(AURORAFS_BLOCK_SIZE);
     aurorafs_superblock_t* sb = (aurorafs_superblock_t*)kmalloc(sizeof(aurorafs_superblock_t));
-    if (!sb) {
+    if (!block || !sb) {
+        if (block) kfree(block);
+        if (sb) kfree(sb);
         return -1;
     }
     
-    /* Read superblock from device */
-    /* In real implementation, would call storage driver to read block 0 */
+    int result = dev->read(dev->ctx, 0, block, 1);
+    afs_memcpy(sb, block, sizeof(*sb));
+    kfree(block);
     
     /* Verify magic number */
-    if (sb->magic != AURORAFS_MAGIC) {
+    if (result != 0 || sb->magic != AURORAFS_MAGIC || sb->block_size != AURORAFS_BLOCK_SIZE ||
+        sb->total_blocks > dev->blocks) {
         kfree(sb);
         return -1;
     }
     
     /* Initialize mount structure */
-    g_aurorafs_mount.superblock = sb;
-    g_aurorafs_mount.device = (void*)device;
-    g_aurorafs_mount.current_snapshot = 0;
-    g_aurorafs_mount.dedup_enabled = (sb->features & AURORAFS_FEAT_DEDUP) != 0;
-    g_aurorafs_mount.compress_enabled = (sb->features & AURORAFS_FEAT_COMPRESS) != 0;
-    g_aurorafs_mount.encryption_enabled = (sb->features & AURORAFS_FEAT_ENCRYPT) != 0;
+    aurorafs_mount_t* mount = &g_aurorafs_mount;
+    mount->superblock = sb;
+    mount->device = dev;
+    mount->current_snapshot = 0;
+    mount->dedup_enabled = (sb->features & AURORAFS_FEAT_DEDUP) != 0;
+    mount->compress_enabled = (sb->features & AURORAFS_FEAT_COMPRESS) != 0;
+    mount->encryption_enabled = (sb->features & AURORAFS_FEAT_ENCRYPT) != 0;
+    mount->dedup_hash_table = NULL;
+    spinlock_init(&mount->alloc_lock);
+    mount->bitmap_start = 1;
+    mount->bitmap_blocks = afs_bitmap_blocks(sb->total_blocks);
+    mount->data_start = mount->bitmap_start + mount->bitmap_blocks;
+    mount->free_space = NULL;
+    
+    /* Load the free-block bitmap */
+    mount->block_bitmap = (uint64_t*)kmalloc(afs_bitmap_words(sb->total_blocks) * sizeof(uint64_t));
+    if (!mount->block_bitmap ||
+        dev->read(dev->ctx, mount->bitmap_start, mount->block_bitmap,
+                  (uint32_t)mount->bitmap_blocks) != 0 ||
+        aurorafs_freespace_create(mount) != 0) {
+        goto fail;
+    }
     
     /* Initialize deduplication hash table if enabled */
-    if (g_aurorafs_mount.dedup_enabled) {
-        g_aurorafs_mount.dedup_hash_table = kmalloc(65536 * sizeof(void*));
-        if (!g_aurorafs_mount.dedup_hash_table) {
-            kfree(sb);
-            return -1;
+    if (mount->dedup_enabled) {
+        if (aurorafs_dedup_create(mount) != 0 || aurorafs_dedup_load(mount) != 0) {
+            goto fail;
         }
     }
     
     g_aurorafs_mounted = true;
     return 0;
+
+fail:
+    aurorafs_dedup_destroy(mount);
+    aurorafs_freespace_destroy(mount);
+    if (mount->block_bitmap) {
+        kfree(mount->block_bitmap);
+        mount->block_bitmap = NULL;
+    }
+    kfree(sb);
+    mount->superblock = NULL;
+    mount->device = NULL;
+    return -1;
+}
+
+/**
+ * Write the dedup table, bitmap and superblock back to the device
+ */
+int aurorafs_sync(aurorafs_mount_t* mount) {
+    if (!mount || !mount->superblock || !mount->device) {
+        return -1;
+    }
+    
+    const aurorafs_device_t* dev = mount->device;
+    int result = 0;
+    if (mount->dedup_hash_table) {
+        result = aurorafs_dedup_store(mount);
+    }
+    
+    uint8_t* block = (uint8_t*)kmalloc(AURORAFS_BLOCK_SIZE);
+    if (!block) {
+        return -1;
+    }
+    
+    spinlock_acquire(&mount->alloc_lock);
+    if (result == 0) {
+        result = dev->write(dev->ctx, mount->bitmap_start, mount->block_bitmap,
+                            (uint32_t)mount->bitmap_blocks);
+    }
+    afs_memset(block, 0, AURORAFS_BLOCK_SIZE);
+    afs_memcpy(block, mount->superblock, sizeof(aurorafs_superblock_t));
+    spinlock_release(&mount->alloc_lock);
+    
+    /* The superblock goes last, once what it points to is durable */
+    if (result == 0 && dev->flush) {
+        result = dev->flush(dev->ctx);
+    }
+    if (result == 0) {
+        result = dev->write(dev->ctx, 0, block, 1);
+    }
+    if (result == 0 && dev->flush) {
+        result = dev->flush(dev->ctx);
+    }
+    
+    kfree(block);
+    return result == 0 ? 0 : -1;
 }
 
 /**
@@ -149,20 +332,25 @@ static int aurorafs_unmount(void) {
     }
     
     /* Flush pending writes */
-    /* Write superblock */
+    int result = aurorafs_sync(&g_aurorafs_mount);
     
-    if (g_aurorafs_mount.dedup_hash_table) {
-        kfree(g_aurorafs_mount.dedup_hash_table);
+    aurorafs_dedup_destroy(&g_aurorafs_mount);
+    aurorafs_freespace_destroy(&g_aurorafs_mount);
+    
+    if (g_aurorafs_mount.block_bitmap) {
+        kfree(g_aurorafs_mount.block_bitmap);
+        g_aurorafs_mount.block_bitmap = NULL;
     }
     
     if (g_aurorafs_mount.superblock) {
         kfree(g_aurorafs_mount.superblock);
+        g_aurorafs_mount.superblock = NULL;
     }
     
     g_aurorafs_mounted = false;
     g_aurorafs_mount.device = NULL;
     
-    return 0;
+    return result;
 }
 
 /**
@@ -332,155 +520,6 @@ static int aurorafs_rename(const char* oldpath, const char* newpath) {
     return 0;
 }
 
-/* ============================================================================
- * DEDUPLICATION FUNCTIONS
- * ============================================================================ */
-
-/**
- * Find block by hash in dedup table
- */
-int aurorafs_dedup_find_block(aurorafs_mount_t* mount, const uint8_t* hash, 
-                              uint64_t* physical_block) {
-    if (!mount || !hash || !physical_block || !mount->dedup_enabled) {
-        return -1;
-    }
-    
-    /* Calculate hash table index */
-    uint32_t hash_index = (hash[0] << 8) | hash[1];
-    
-    /* Search collision chain */
-    /* Simplified - would traverse linked list of dedup entries */
-    
-    return -1;  /* Not found */
-}
-
-/**
- * Add block to dedup table
- */
-int aurorafs_dedup_add_block(aurorafs_mount_t* mount, const uint8_t* hash, 
-                             uint64_t physical_block) {
-    if (!mount || !hash || !mount->dedup_enabled) {
-        return -1;
-    }
-    
-    /* Allocate dedup entry */
-    aurorafs_dedup_entry_t* entry = (aurorafs_dedup_entry_t*)kmalloc(sizeof(aurorafs_dedup_entry_t));
-    if (!entry) {
-        return -1;
-    }
-    
-    /* Initialize entry - copy hash */
-    for (size_t i = 0; i < AURORAFS_HASH_SIZE; i++) {
-        entry->hash[i] = hash[i];
-    }
-    entry->physical_block = physical_block;
-    entry->refcount = 1;
-    
-    /* Add to hash table */
-    
-    return 0;
-}
-
-/**
- * Increment refcount for deduplicated block
- */
-int aurorafs_dedup_inc_refcount(aurorafs_mount_t* mount, uint64_t physical_block) {
-    if (!mount || !mount->dedup_enabled) {
-        return -1;
-    }
-    
-    /* Find dedup entry and increment refcount */
-    
-    return 0;
-}
-
-/**
- * Decrement refcount for deduplicated block
- */
-int aurorafs_dedup_dec_refcount(aurorafs_mount_t* mount, uint64_t physical_block) {
-    if (!mount || !mount->dedup_enabled) {
-        return -1;
-    }
-    
-    /* Find dedup entry and decrement refcount */
-    /* If refcount reaches 0, free the block */
-    
-    return 0;
-}
-
-/* ============================================================================
- * COMPRESSION FUNCTIONS
- * ============================================================================ */
-
-/**
- * Compress block using specified algorithm
- */
-int aurorafs_compress_block(const void* input, size_t input_size, 
-                            void* output, size_t* output_size, uint32_t algorithm) {
-    if (!input || !output || !output_size) {
-        return -1;
-    }
-    
-    /* Implement compression based on algorithm */
-    switch (algorithm) {
-        case AURORAFS_COMPRESS_LZ4:
-            /* LZ4 compression (simplified stub) */
-            *output_size = input_size;  /* No compression for now */
-            for (size_t i = 0; i < input_size; i++) {
-                ((uint8_t*)output)[i] = ((const uint8_t*)input)[i];
-            }
-            break;
-            
-        case AURORAFS_COMPRESS_ZSTD:
-            /* ZSTD compression */
-            *output_size = input_size;
-            break;
-            
-        case AURORAFS_COMPRESS_LZMA:
-            /* LZMA compression */
-            *output_size = input_size;
-            break;
-            
-        default:
-            return -1;
-    }
-    
-    return 0;
-}
-
-/**
- * Decompress block using specified algorithm
- */
-int aurorafs_decompress_block(const void* input, size_t input_size,
-                              void* output, size_t output_size, uint32_t algorithm) {
-    if (!input || !output) {
-        return -1;
-    }
-    
-    /* Implement decompression based on algorithm */
-    switch (algorithm) {
-        case AURORAFS_COMPRESS_LZ4:
-            /* LZ4 decompression (simplified stub) */
-            for (size_t i = 0; i < input_size && i < output_size; i++) {
-                ((uint8_t*)output)[i] = ((const uint8_t*)input)[i];
-            }
-            break;
-            
-        case AURORAFS_COMPRESS_ZSTD:
-            /* ZSTD decompression */
-            break;
-            
-        case AURORAFS_COMPRESS_LZMA:
-            /* LZMA decompression */
-            break;
-            
-        default:
-            return -1;
-    }
-    
-    return 0;
-}
-
 /* ============================================================================
  * SNAPSHOT FUNCTIONS
  * ============================================================================ */
@@ -841,8 +880,21 @@ int aurorafs_derive_key(const uint8_t* master_key, const uint8_t* salt,
  * EXTENT MANAGEMENT
  * ============================================================================ */
 
+/* Blocks an extent takes on the device */
+static inline uint64_t afs_stored_blocks(const aurorafs_extent_t* extent) {
+    if (extent->flags & AURORAFS_EXTENT_COMPRESSED) {
+        return (extent->compressed_size + AURORAFS_BLOCK_SIZE - 1) / AURORAFS_BLOCK_SIZE;
+    }
+    return extent->length;
+}
+
+static inline uint32_t afs_extent_algorithm(const aurorafs_extent_t* extent) {
+    return (extent->flags & AURORAFS_EXTENT_ZSTD) ? AURORAFS_COMPRESS_ZSTD : AURORAFS_COMPRESS_LZ4;
+}
+
 /**
- * Allocate extent for data storage
+ * Allocate extent for data storage. The blocks are only reserved here;
+ * they are placed when the extent is first written.
  */
 int aurorafs_allocate_extent(aurorafs_mount_t* mount, uint64_t size, 
                              aurorafs_extent_t* extent) {
@@ -853,12 +905,15 @@ int aurorafs_allocate_extent(aurorafs_mount_t* mount, uint64_t size,
     /* Calculate number of blocks needed */
     uint64_t blocks = (size + AURORAFS_BLOCK_SIZE - 1) / AURORAFS_BLOCK_SIZE;
     
-    /* Allocate blocks from free list */
-    extent->logical_offset = 0;
-    extent->physical_block = 0;  /* Would allocate from bitmap */
+    if (blocks && aurorafs_reserve_blocks(mount, blocks) != 0) {
+        return -1;
+    }
+    afs_memset(extent, 0, sizeof(*extent));
     extent->length = blocks;
-    extent->flags = 0;
     extent->refcount = 1;
+    if (blocks) {
+        extent->flags = AURORAFS_EXTENT_DELALLOC;
+    }
     
     return 0;
 }
@@ -871,14 +926,108 @@ int aurorafs_free_extent(aurorafs_mount_t* mount, const aurorafs_extent_t* exten
         return -1;
     }
     
-    /* Update dedup refcounts */
-    if (mount->dedup_enabled) {
-        aurorafs_dedup_dec_refcount(mount, extent->physical_block);
-    } else {
-        /* Free blocks directly */
+    if (extent->flags & AURORAFS_EXTENT_DELALLOC) {
+        aurorafs_unreserve_blocks(mount, extent->length);
+        return 0;
     }
     
-    return 0;
+    if (!extent->physical_block || !extent->length) {
+        return 0;
+    }
+    
+    /* Shared blocks are freed once the last extent lets go of them */
+    if ((extent->flags & AURORAFS_EXTENT_DEDUP) &&
+        aurorafs_dedup_dec_refcount(mount, extent->physical_block) >= 0) {
+        return 0;
+    }
+    
+    return aurorafs_free_blocks(mount, extent->physical_block, afs_stored_blocks(extent));
+}
+
+/**
+ * Move bytes between a buffer and a byte range of blocks starting at
+ * first, going through a bounce block for partial blocks. With fresh set
+ * the blocks hold nothing yet and partial blocks are zero-filled rather
+ * than read.
+ */
+static int aurorafs_block_rw(aurorafs_mount_t* mount, uint64_t first, void* buffer,
+                             size_t offset, size_t size, bool write, bool fresh) {
+    const aurorafs_device_t* dev = mount->device;
+    uint8_t* data = (uint8_t*)buffer;
+    uint8_t* bounce = NULL;
+    int result = 0;
+    
+    while (size > 0 && result == 0) {
+        uint64_t block = first + offset / AURORAFS_BLOCK_SIZE;
+        size_t in = offset % AURORAFS_BLOCK_SIZE;
+        
+        if (in == 0 && size >= AURORAFS_BLOCK_SIZE) {
+            uint32_t count = (uint32_t)(size / AURORAFS_BLOCK_SIZE);
+            result = write ? dev->write(dev->ctx, block, data, count)
+                           : dev->read(dev->ctx, block, data, count);
+            size_t n = (size_t)count * AURORAFS_BLOCK_SIZE;
+            data += n;
+            offset += n;
+            size -= n;
+            continue;
+        }
+        
+        size_t n = AURORAFS_BLOCK_SIZE - in;
+        if (n > size) {
+            n = size;
+        }
+        if (!bounce) {
+            bounce = (uint8_t*)kmalloc(AURORAFS_BLOCK_SIZE);
+            if (!bounce) {
+                return -1;
+            }
+        }
+        if (write && fresh) {
+            afs_memset(bounce, 0, AURORAFS_BLOCK_SIZE);
+        } else {
+            result = dev->read(dev->ctx, block, bounce, 1);
+        }
+        if (result == 0) {
+            if (write) {
+                afs_memcpy(bounce + in, data, n);
+                result = dev->write(dev->ctx, block, bounce, 1);
+            } else {
+                afs_memcpy(data, bounce + in, n);
+            }
+        }
+        data += n;
+        offset += n;
+        size -= n;
+    }
+    
+    if (bounce) {
+        kfree(bounce);
+    }
+    return result == 0 ? 0 : -1;
+}
+
+/**
+ * Write zeros to count blocks starting at first
+ */
+static int aurorafs_zero_blocks(aurorafs_mount_t* mount, uint64_t first, uint64_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    
+    const aurorafs_device_t* dev = mount->device;
+    uint8_t* zeros = (uint8_t*)kmalloc(AURORAFS_BLOCK_SIZE);
+    if (!zeros) {
+        return -1;
+    }
+    afs_memset(zeros, 0, AURORAFS_BLOCK_SIZE);
+    
+    int result = 0;
+    for (uint64_t i = 0; i < count && result == 0; i++) {
+        result = dev->write(dev->ctx, first + i, zeros, 1);
+    }
+    
+    kfree(zeros);
+    return result == 0 ? 0 : -1;
 }
 
 /**
@@ -886,28 +1035,255 @@ int aurorafs_free_extent(aurorafs_mount_t* mount, const aurorafs_extent_t* exten
  */
 int aurorafs_read_extent(aurorafs_mount_t* mount, const aurorafs_extent_t* extent,
                          void* buffer, size_t offset, size_t size) {
-    if (!mount || !extent || !buffer) {
+    if (!mount || !extent || !buffer || !mount->device) {
+        return -1;
+    }
+    
+    uint64_t bytes = extent->length * AURORAFS_BLOCK_SIZE;
+    if (offset > bytes || size > bytes - offset) {
         return -1;
     }
     
+    /* Nothing written yet reads as zeros */
+    if (!extent->physical_block) {
+        afs_memset(buffer, 0, size);
+        return (int)size;
+    }
+    
+    /* Compressed extents are decompressed whole */
+    if (extent->flags & AURORAFS_EXTENT_COMPRESSED) {
+        const aurorafs_device_t* dev = mount->device;
+        uint64_t stored = afs_stored_blocks(extent);
+        uint8_t* packed = (uint8_t*)kmalloc((size_t)stored * AURORAFS_BLOCK_SIZE);
+        uint8_t* image = (offset == 0 && size == bytes) ? (uint8_t*)buffer
+                                                         : (uint8_t*)kmalloc((size_t)bytes);
+        int result = -1;
+        if (packed && image && dev->read(dev->ctx, extent->physical_block, packed, (uint32_t)stored) == 0) {
+            result = aurorafs_decompress_block(packed, extent->compressed_size, image, (size_t)bytes,
+                                               afs_extent_algorithm(extent));
+        }
+        if (result == 0 && image != buffer) {
+            afs_memcpy(buffer, image + offset, size);
+        }
+        if (packed) kfree(packed);
+        if (image && image != buffer) kfree(image);
+        return result == 0 ? (int)size : -1;
+    }
+    
     /* Read blocks from device */
-    /* Handle compression and encryption if needed */
+    /* Handle encryption if needed */
+    if (aurorafs_block_rw(mount, extent->physical_block, buffer, offset, size, false, false) != 0) {
+        return -1;
+    }
     
     return (int)size;
 }
 
+/**
+ * Allocate blocks to write an extent to. A delayed allocation draws on
+ * its reservation, which it keeps if this fails.
+ */
+static int aurorafs_alloc_extent_blocks(aurorafs_mount_t* mount, aurorafs_extent_t* extent,
+                                        uint64_t count, uint64_t* start) {
+    if (!(extent->flags & AURORAFS_EXTENT_DELALLOC)) {
+        return aurorafs_alloc_blocks(mount, count, start);
+    }
+    if (aurorafs_alloc_reserved(mount, count, extent->length, start) != 0) {
+        return -1;
+    }
+    extent->flags &= ~AURORAFS_EXTENT_DELALLOC;
+    return 0;
+}
+
+/**
+ * Store the whole contents of an extent, compressed if that saves blocks.
+ * The extent keeps its blocks when the new data fits in them, and moves
+ * to a new run when it does not.
+ */
+static int aurorafs_store_extent(aurorafs_mount_t* mount, aurorafs_extent_t* extent,
+                                 const uint8_t* image, uint32_t algorithm) {
+    const aurorafs_device_t* dev = mount->device;
+    size_t bytes = (size_t)extent->length * AURORAFS_BLOCK_SIZE;
+    uint8_t* packed = NULL;
+    size_t packed_size = 0;
+    uint16_t packed_flag = 0;
+    
+    if (algorithm != AURORAFS_COMPRESS_NONE && aurorafs_compress_worthwhile(image, bytes)) {
+        packed = (uint8_t*)kmalloc(bytes);
+        if (packed && aurorafs_compress_block(image, bytes, packed, &packed_size, algorithm) == 0 &&
+            (packed_size + AURORAFS_BLOCK_SIZE - 1) / AURORAFS_BLOCK_SIZE < extent->length) {
+            packed_flag = (algorithm == AURORAFS_COMPRESS_ZSTD) ? AURORAFS_EXTENT_ZSTD
+                                                                : AURORAFS_EXTENT_LZ4;
+            size_t padded = (packed_size + AURORAFS_BLOCK_SIZE - 1) / AURORAFS_BLOCK_SIZE * AURORAFS_BLOCK_SIZE;
+            afs_memset(packed + packed_size, 0, padded - packed_size);
+        } else if (packed) {
+            /* Incompressible: fall back to raw */
+            kfree(packed);
+            packed = NULL;
+        }
+    }
+    
+    uint64_t stored = packed ? (packed_size + AURORAFS_BLOCK_SIZE - 1) / AURORAFS_BLOCK_SIZE
+                             : extent->length;
+    uint64_t old = extent->physical_block;
+    uint64_t old_stored = old ? afs_stored_blocks(extent) : 0;
+    uint64_t start = old;
+    if (!old || stored > old_stored) {
+        if (aurorafs_alloc_extent_blocks(mount, extent, stored, &start) != 0) {
+            if (packed) kfree(packed);
+            return -1;
+        }
+    }
+    
+    int result = dev->write(dev->ctx, start, packed ? packed : image, (uint32_t)stored);
+    if (packed) {
+        kfree(packed);
+    }
+    if (result != 0) {
+        if (start != old) {
+            aurorafs_free_blocks(mount, start, stored);
+        }
+        return -1;
+    }
+    
+    if (old && start != old) {
+        aurorafs_free_blocks(mount, old, old_stored);
+    } else if (old_stored > stored) {
+        aurorafs_free_blocks(mount, old + stored, old_stored - stored);
+    }
+    extent->physical_block = start;
+    extent->flags = (uint16_t)((extent->flags & ~AURORAFS_EXTENT_COMPRESSED) | packed_flag);
+    extent->compressed_size = packed ? (uint32_t)packed_size : 0;
+    return 0;
+}
+
+/**
+ * Write part of an extent stored compressed: merge it into the whole
+ * contents and store them again
+ */
+static int aurorafs_write_compressed(aurorafs_mount_t* mount, aurorafs_extent_t* extent,
+                                     const void* buffer, size_t offset, size_t size) {
+    size_t bytes = (size_t)extent->length * AURORAFS_BLOCK_SIZE;
+    uint32_t algorithm = mount->superblock->default_compress;
+    if (offset == 0 && size == bytes) {
+        return aurorafs_store_extent(mount, extent, (const uint8_t*)buffer, algorithm);
+    }
+    
+    uint8_t* image = (uint8_t*)kmalloc(bytes);
+    if (!image) {
+        return -1;
+    }
+    int result = -1;
+    if (aurorafs_read_extent(mount, extent, image, 0, bytes) == (int)bytes) {
+        afs_memcpy(image + offset, buffer, size);
+        result = aurorafs_store_extent(mount, extent, image, algorithm);
+    }
+    kfree(image);
+    return result;
+}
+
+/**
+ * Rewrite an extent compressed with another algorithm
+ */
+int aurorafs_recompress_extent(aurorafs_mount_t* mount, aurorafs_extent_t* extent,
+                               uint32_t algorithm) {
+    if (!mount || !extent || !mount->device || extent->length < 2) {
+        return -1;
+    }
+    if (!extent->physical_block) {
+        return 0;
+    }
+    
+    size_t bytes = (size_t)extent->length * AURORAFS_BLOCK_SIZE;
+    uint8_t* image = (uint8_t*)kmalloc(bytes);
+    if (!image) {
+        return -1;
+    }
+    int result = -1;
+    if (aurorafs_read_extent(mount, extent, image, 0, bytes) == (int)bytes) {
+        result = aurorafs_store_extent(mount, extent, image, algorithm);
+    }
+    kfree(image);
+    return result;
+}
+
+/**
+ * Write a whole single-block extent through the dedup index: point it at
+ * an existing block with the same contents, or write it to a block of
+ * its own and index that
+ */
+static int aurorafs_write_dedup_block(aurorafs_mount_t* mount, aurorafs_extent_t* extent,
+                                      const void* buffer) {
+    uint8_t hash[AURORAFS_HASH_SIZE];
+    aurorafs_calculate_hash(buffer, AURORAFS_BLOCK_SIZE, hash);
+    
+    uint64_t existing;
+    if (aurorafs_dedup_get_block(mount, hash, &existing) == 0) {
+        /* Block already exists, use it */
+        aurorafs_free_extent(mount, extent);
+        extent->physical_block = existing;
+        extent->flags = (uint16_t)((extent->flags & ~AURORAFS_EXTENT_DELALLOC) | AURORAFS_EXTENT_DEDUP);
+        afs_memcpy(extent->hash, hash, AURORAFS_HASH_SIZE);
+        return AURORAFS_BLOCK_SIZE;
+    }
+    
+    /* New contents. The old block can be overwritten unless other extents
+     * share it; take a spare first so that case cannot fail half done. */
+    uint64_t block = extent->physical_block;
+    uint64_t spare = 0;
+    if (!block || (extent->flags & AURORAFS_EXTENT_DEDUP)) {
+        if (aurorafs_alloc_extent_blocks(mount, extent, 1, &spare) != 0) {
+            return -1;
+        }
+    }
+    if (block && (extent->flags & AURORAFS_EXTENT_DEDUP) &&
+        aurorafs_dedup_unshare(mount, block) == 1) {
+        block = 0;
+    }
+    if (!block) {
+        block = spare;
+        spare = 0;
+    }
+    if (spare) {
+        aurorafs_free_blocks(mount, spare, 1);
+    }
+    
+    extent->physical_block = block;
+    extent->flags &= ~AURORAFS_EXTENT_DEDUP;
+    afs_memset(extent->hash, 0, AURORAFS_HASH_SIZE);
+    
+    const aurorafs_device_t* dev = mount->device;
+    if (dev->write(dev->ctx, block, buffer, 1) != 0) {
+        return -1;
+    }
+    
+    /* Another writer may have indexed the same contents meanwhile; the
+     * block then just stays unshared */
+    if (aurorafs_dedup_add_block(mount, hash, block) == 0) {
+        extent->flags |= AURORAFS_EXTENT_DEDUP;
+        afs_memcpy(extent->hash, hash, AURORAFS_HASH_SIZE);
+    }
+    return AURORAFS_BLOCK_SIZE;
+}
+
 /**
  * Write to extent
  */
 int aurorafs_write_extent(aurorafs_mount_t* mount, aurorafs_extent_t* extent,
                           const void* buffer, size_t offset, size_t size) {
-    if (!mount || !extent || !buffer) {
+    if (!mount || !extent || !buffer || !mount->device) {
+        return -1;
+    }
+    
+    uint64_t bytes = extent->length * AURORAFS_BLOCK_SIZE;
+    if (offset > bytes || size > bytes - offset) {
         return -1;
     }
     
-    /* Apply compression if enabled */
-    if (mount->compress_enabled) {
-        /* Compress buffer */
+    /* Apply compression if enabled; a lone block cannot shrink */
+    if (extent->length > 1 &&
+        (mount->compress_enabled || (extent->flags & AURORAFS_EXTENT_COMPRESSED))) {
+        return aurorafs_write_compressed(mount, extent, buffer, offset, size) == 0 ? (int)size : -1;
     }
     
     /* Apply encryption if enabled */
@@ -915,25 +1291,78 @@ int aurorafs_write_extent(aurorafs_mount_t* mount, aurorafs_extent_t* extent,
         /* Encrypt buffer */
     }
     
-    /* Check for deduplication if enabled */
-    if (mount->dedup_enabled) {
-        uint8_t hash[AURORAFS_HASH_SIZE];
-        aurorafs_calculate_hash(buffer, size, hash);
-        
-        uint64_t existing_block;
-        if (aurorafs_dedup_find_block(mount, hash, &existing_block) == 0) {
-            /* Block already exists, use it */
-            extent->physical_block = existing_block;
-            aurorafs_dedup_inc_refcount(mount, existing_block);
-            return (int)size;
+    /* Deduplicate whole blocks */
+    if (mount->dedup_enabled && extent->length == 1 && offset == 0 &&
+        size == AURORAFS_BLOCK_SIZE) {
+        return aurorafs_write_dedup_block(mount, extent, buffer);
+    }
+    
+    bool fresh = false;
+    if (!extent->physical_block) {
+        uint64_t start;
+        if (aurorafs_alloc_extent_blocks(mount, extent, extent->length, &start) != 0) {
+            return -1;
+        }
+        extent->physical_block = start;
+        fresh = true;
+    } else if (extent->flags & AURORAFS_EXTENT_DEDUP) {
+        /* A partial write changes the contents under the hash: copy the
+         * block if it is shared, or take it out of the index if not */
+        uint64_t copy;
+        if (aurorafs_alloc_blocks(mount, 1, &copy) != 0) {
+            return -1;
+        }
+        uint8_t* bounce = (uint8_t*)kmalloc(AURORAFS_BLOCK_SIZE);
+        if (!bounce) {
+            aurorafs_free_blocks(mount, copy, 1);
+            return -1;
+        }
+        const aurorafs_device_t* dev = mount->device;
+        int result = dev->read(dev->ctx, extent->physical_block, bounce, 1);
+        if (result == 0) {
+            afs_memcpy(bounce + offset, buffer, size);
+            if (aurorafs_dedup_unshare(mount, extent->physical_block) == 1) {
+                extent->physical_block = copy;
+            } else {
+                aurorafs_free_blocks(mount, copy, 1);
+            }
+            extent->flags &= ~AURORAFS_EXTENT_DEDUP;
+            afs_memset(extent->hash, 0, AURORAFS_HASH_SIZE);
+            result = dev->write(dev->ctx, extent->physical_block, bounce, 1);
+        } else {
+            aurorafs_free_blocks(mount, copy, 1);
+        }
+        kfree(bounce);
+        return result == 0 ? (int)size : -1;
+    }
+    
+    /* Blocks of a new run the write doesn't reach still hold whatever
+     * their last owner left there: they read as file data from now on */
+    if (fresh) {
+        uint64_t head = offset / AURORAFS_BLOCK_SIZE;
+        uint64_t tail = size ? (offset + size + AURORAFS_BLOCK_SIZE - 1) / AURORAFS_BLOCK_SIZE : head;
+        if (aurorafs_zero_blocks(mount, extent->physical_block, head) != 0 ||
+            aurorafs_zero_blocks(mount, extent->physical_block + tail, extent->length - tail) != 0) {
+            return -1;
         }
     }
     
     /* Write blocks to device */
+    if (aurorafs_block_rw(mount, extent->physical_block, (void*)buffer, offset, size,
+                          true, fresh) != 0) {
+        return -1;
+    }
     
     return (int)size;
 }
 
+/**
+ * Get the mounted volume
+ */
+aurorafs_mount_t* aurorafs_get_mount(void) {
+    return g_aurorafs_mounted ? &g_aurorafs_mount : NULL;
+}
+
 /**
  * Get AuroraFS file system operations
  */
@@ -2,6 +2,23 @@
  * Aurora OS - AuroraFS Advanced File System
  * 
  * Custom file system with deduplication, compression, snapshots, and encryption
+ *
+ * Volume layout: the superblock in block 0, then the free-block bitmap,
+ * then data. With deduplication enabled, single-block extents written in
+ * full are looked up by the SHA-256 of their contents in the dedup index,
+ * and share the block of an identical one instead of taking a new block.
+ * The index is kept in memory while mounted and stored in a run of data
+ * blocks, found from the superblock, when the volume is synced.
+ *
+ * With compression enabled, multi-block extents written whole are stored
+ * compressed in as many blocks as the compressed data needs, and flagged
+ * with the algorithm; data that does not save a block is stored raw.
+ * Single-block extents are never compressed, since they cannot shrink.
+ *
+ * Free space is indexed in memory by extent, built from the bitmap at
+ * mount. Extents from aurorafs_allocate_extent() only reserve their
+ * blocks; the blocks are chosen when the extent is first written, once
+ * it is known how many it takes after compression or deduplication.
  */
 
 #ifndef AURORA_AURORAFS_H
@@ -11,6 +28,7 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include "../vfs/vfs.h"
+#include "../../kernel/smp/spinlock.h"
 
 /* AuroraFS constants */
 #define AURORAFS_MAGIC          0x41555246  /* "AURF" */
@@ -19,6 +37,9 @@
 #define AURORAFS_MAX_SNAPSHOTS  256
 #define AURORAFS_HASH_SIZE      32  /* SHA-256 */
 #define AURORAFS_MAX_NAME       255
+#define AURORAFS_MAX_DEVICES    8
+#define AURORAFS_BITMAP_BITS    (AURORAFS_BLOCK_SIZE * 8)  /* Blocks per bitmap block */
+#define AURORAFS_DEDUP_MAGIC    0x41554444  /* "AUDD" */
 
 /* Feature flags */
 #define AURORAFS_FEAT_DEDUP         0x0001
@@ -28,6 +49,13 @@
 #define AURORAFS_FEAT_JOURNAL       0x0010
 #define AURORAFS_FEAT_QUOTA         0x0020
 
+/* Extent flags */
+#define AURORAFS_EXTENT_DEDUP       0x0001  /* Block is in the dedup index */
+#define AURORAFS_EXTENT_LZ4         0x0002  /* Stored LZ4 compressed */
+#define AURORAFS_EXTENT_ZSTD        0x0004  /* Stored entropy-mode compressed */
+#define AURORAFS_EXTENT_COMPRESSED  (AURORAFS_EXTENT_LZ4 | AURORAFS_EXTENT_ZSTD)
+#define AURORAFS_EXTENT_DELALLOC    0x0008  /* Blocks reserved, chosen on first write */
+
 /* Compression algorithms */
 #define AURORAFS_COMPRESS_NONE      0
 #define AURORAFS_COMPRESS_LZ4       1
@@ -35,6 +63,11 @@
 #define AURORAFS_COMPRESS_LZMA      3
 
 /* Encryption algorithms */
+/* Compression heuristics: bytes sampled, and the byte entropy (bits in
+ * 1/256ths) above which data is taken to be compressed already */
+#define AURORAFS_COMPRESS_SAMPLE        4096
+#define AURORAFS_COMPRESS_MAX_ENTROPY_Q8 (15 * 128)    /* 7.5 bits per byte */
+
 #define AURORAFS_ENCRYPT_NONE       0
 #define AURORAFS_ENCRYPT_AES256     1
 #define AURORAFS_ENCRYPT_CHACHA20   2
@@ -51,7 +84,7 @@ typedef struct __attribute__((packed)) {
     uint32_t features;
     uint64_t root_inode;
     uint64_t journal_inode;
-    uint64_t dedup_table_inode;
+    uint64_t dedup_table_inode;     /* First block of the stored dedup table, 0 if none */
     uint64_t snapshot_table_inode;
     uint32_t default_compress;
     uint32_t default_encrypt;
@@ -121,6 +154,50 @@ typedef struct __attribute__((packed)) {
     uint64_t next_entry;  /* Collision chain */
 } aurorafs_dedup_entry_t;
 
+/* Header block of the stored dedup table; the entries follow it,
+ * AURORAFS_DEDUP_PER_BLOCK to a block */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t entry_size;
+    uint64_t entries;
+    uint64_t blocks;                /* Header included */
+    uint8_t  digest[AURORAFS_HASH_SIZE];  /* SHA-256 of the entry blocks */
+} aurorafs_dedup_header_t;
+
+#define AURORAFS_DEDUP_PER_BLOCK (AURORAFS_BLOCK_SIZE / sizeof(aurorafs_dedup_entry_t))
+
+/* Dedup index statistics */
+typedef struct {
+    uint64_t entries;               /* Blocks in the index */
+    uint64_t references;            /* Extents pointing at them */
+    uint64_t lookups;
+    uint64_t bloom_skips;           /* Lookups the bloom filter answered */
+    uint64_t false_positives;       /* Passed the filter, then not found */
+    uint64_t hits;
+    uint64_t freed;                 /* Blocks freed when their count reached 0 */
+} aurorafs_dedup_stats_t;
+
+/* Free-space manager counters */
+typedef struct {
+    uint64_t free_blocks;
+    uint64_t reserved_blocks;       /* Held for delayed allocations */
+    uint64_t extents;               /* Free extents */
+    uint64_t largest;               /* Blocks in the longest free extent */
+    uint64_t goal_allocs;           /* Placed at the CPU's goal */
+    uint64_t best_fit_allocs;
+    uint64_t merges;                /* Frees joined to a free neighbour */
+} aurorafs_freespace_stats_t;
+
+/* Block device holding a volume. Blocks are AURORAFS_BLOCK_SIZE bytes.
+ * flush may be NULL when writes are durable on return. */
+typedef struct {
+    uint64_t blocks;
+    void* ctx;
+    int (*read)(void* ctx, uint64_t block, void* data, uint32_t count);
+    int (*write)(void* ctx, uint64_t block, const void* data, uint32_t count);
+    int (*flush)(void* ctx);
+} aurorafs_device_t;
+
 /* Directory entry */
 typedef struct __attribute__((packed)) {
     uint64_t inode;
@@ -138,8 +215,14 @@ typedef struct {
     bool     encryption_enabled;
     bool     dedup_enabled;
     bool     compress_enabled;
-    void*    device;
-    void*    dedup_hash_table;
+    const aurorafs_device_t* device;
+    void*    dedup_hash_table;      /* struct aurorafs_dedup_index */
+    spinlock_t alloc_lock;          /* Protects the bitmap, free space and free_blocks */
+    uint64_t* block_bitmap;         /* Set bits are allocated blocks */
+    uint64_t bitmap_start;          /* First bitmap block on the device */
+    uint64_t bitmap_blocks;
+    uint64_t data_start;            /* First block the allocator hands out */
+    void*    free_space;            /* struct aurorafs_free_space */
 } aurorafs_mount_t;
 
 /* AuroraFS initialization */
@@ -148,6 +231,22 @@ int aurorafs_format(const char* device, uint64_t size, uint32_t features);
 int aurorafs_mount_device(const char* device, const uint8_t* master_key);
 int aurorafs_unmount_device(void);
 
+/**
+ * Register a block device under a name for aurorafs_format() and mounting
+ * @return 0, or -1 if the table is full or the name is taken
+ */
+int aurorafs_register_device(const char* name, const aurorafs_device_t* dev);
+
+/**
+ * Get the mounted volume, or NULL if none is mounted
+ */
+aurorafs_mount_t* aurorafs_get_mount(void);
+
+/**
+ * Write the dedup table, bitmap and superblock back to the device
+ */
+int aurorafs_sync(aurorafs_mount_t* mount);
+
 /* Get AuroraFS file system operations */
 fs_ops_t* aurorafs_get_ops(void);
 
@@ -157,14 +256,70 @@ int aurorafs_dedup_find_block(aurorafs_mount_t* mount, const uint8_t* hash,
 int aurorafs_dedup_add_block(aurorafs_mount_t* mount, const uint8_t* hash, 
                              uint64_t physical_block);
 int aurorafs_dedup_inc_refcount(aurorafs_mount_t* mount, uint64_t physical_block);
+
+/**
+ * Drop a reference to an indexed block, freeing the block at zero
+ * @return References left, or -1 if the block is not in the index
+ */
 int aurorafs_dedup_dec_refcount(aurorafs_mount_t* mount, uint64_t physical_block);
 
-/* Compression functions */
+/**
+ * Find a block by hash and take a reference to it in one step
+ * @return 0, or -1 if no block has that hash
+ */
+int aurorafs_dedup_get_block(aurorafs_mount_t* mount, const uint8_t* hash,
+                             uint64_t* physical_block);
+
+/**
+ * Get an indexed block ready to be overwritten in place. The only
+ * reference leaves the index, since the contents no longer match the
+ * hash; a shared block is left to the others and the reference dropped.
+ * @return 0 to write in place, 1 if the caller needs a new block, -1 if
+ *         the block is not in the index
+ */
+int aurorafs_dedup_unshare(aurorafs_mount_t* mount, uint64_t physical_block);
+
+/**
+ * Create or free the in-memory index, and load or store it as the table
+ * the superblock points to
+ */
+int aurorafs_dedup_create(aurorafs_mount_t* mount);
+void aurorafs_dedup_destroy(aurorafs_mount_t* mount);
+int aurorafs_dedup_load(aurorafs_mount_t* mount);
+int aurorafs_dedup_store(aurorafs_mount_t* mount);
+
+/**
+ * Get dedup index statistics
+ */
+void aurorafs_dedup_get_stats(aurorafs_mount_t* mount, aurorafs_dedup_stats_t* stats);
+
+/**
+ * SHA-256 of a block's contents, as the dedup index keys it
+ */
+void aurorafs_calculate_hash(const void* data, size_t size, uint8_t* hash);
+
+/**
+ * Compress into output, which holds input_size bytes
+ * @param algorithm AURORAFS_COMPRESS_LZ4, or AURORAFS_COMPRESS_ZSTD for
+ *                  the slower entropy-coded mode
+ * @return 0, or -1 if the data does not fit in fewer bytes than input_size
+ */
 int aurorafs_compress_block(const void* input, size_t input_size, 
                             void* output, size_t* output_size, uint32_t algorithm);
+
+/**
+ * Decompress exactly output_size bytes
+ * @return 0, or -1 if input is malformed or decodes to another size
+ */
 int aurorafs_decompress_block(const void* input, size_t input_size,
                               void* output, size_t output_size, uint32_t algorithm);
 
+/**
+ * Guess from a sample whether data will compress; false for data that
+ * looks compressed or encrypted already
+ */
+int aurorafs_compress_worthwhile(const void* data, size_t size);
+
 /* Snapshot functions */
 int aurorafs_create_snapshot(aurorafs_mount_t* mount, const char* name, 
                              const char* description);
@@ -181,7 +336,32 @@ int aurorafs_decrypt_block(aurorafs_mount_t* mount, const void* input,
 int aurorafs_derive_key(const uint8_t* master_key, const uint8_t* salt, 
                         uint8_t* derived_key);
 
-/* Extent management */
+/* Block allocation: count contiguous blocks, at the calling CPU's goal
+ * or else best fit; freed blocks merge with free neighbours */
+int aurorafs_alloc_blocks(aurorafs_mount_t* mount, uint64_t count, uint64_t* start);
+int aurorafs_free_blocks(aurorafs_mount_t* mount, uint64_t start, uint64_t count);
+
+/* Reservations: blocks promised to an allocation to come, which takes
+ * their place atomically */
+int aurorafs_reserve_blocks(aurorafs_mount_t* mount, uint64_t count);
+void aurorafs_unreserve_blocks(aurorafs_mount_t* mount, uint64_t count);
+int aurorafs_alloc_reserved(aurorafs_mount_t* mount, uint64_t count, uint64_t reserved,
+                            uint64_t* start);
+
+/* Free-space index lifetime, built from the bitmap at mount */
+int aurorafs_freespace_create(aurorafs_mount_t* mount);
+void aurorafs_freespace_destroy(aurorafs_mount_t* mount);
+void aurorafs_freespace_get_stats(aurorafs_mount_t* mount, aurorafs_freespace_stats_t* stats);
+
+/**
+ * Check the free-space trees against each other and the bitmap
+ * @return 0 if consistent, -1 if not
+ */
+int aurorafs_freespace_verify(aurorafs_mount_t* mount);
+
+/* Extent management. An extent with physical_block 0 has no blocks yet
+ * (block 0 holds the superblock); writing it allocates them, using its
+ * reservation if it is AURORAFS_EXTENT_DELALLOC. */
 int aurorafs_allocate_extent(aurorafs_mount_t* mount, uint64_t size, 
                              aurorafs_extent_t* extent);
 int aurorafs_free_extent(aurorafs_mount_t* mount, const aurorafs_extent_t* extent);
@@ -190,4 +370,11 @@ int aurorafs_read_extent(aurorafs_mount_t* mount, const aurorafs_extent_t* exten
 int aurorafs_write_extent(aurorafs_mount_t* mount, aurorafs_extent_t* extent,
                           const void* buffer, size_t offset, size_t size);
 
+/**
+ * Rewrite an extent compressed with another algorithm, such as the
+ * entropy mode for data gone cold. Stays raw if it does not compress.
+ */
+int aurorafs_recompress_extent(aurorafs_mount_t* mount, aurorafs_extent_t* extent,
+                               uint32_t algorithm);
+
 #endif /* AURORA_AURORAFS_H */
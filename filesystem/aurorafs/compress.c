@@ -0,0 +1,933 @@
+/**
+ * Aurora OS - AuroraFS Block Compression
+ *
+ * Two codecs share one hash-chain match finder over a 64 KB window:
+ *
+ *  - LZ4: the standard LZ4 block format. A shallow chain search and a
+ *    step that grows across misses keep compression fast on data that
+ *    does not match; the decoder copies literals and matches 8 bytes at
+ *    a time while it is far enough from the end of either buffer.
+ *  - Entropy mode (the ZSTD slot): a deeper search with lazy matching,
+ *    then literals, literal lengths, match lengths and offset classes
+ *    each Huffman coded with their own table. Slower, denser, for data
+ *    that is written once and kept cold. It is AuroraFS's own format,
+ *    not Zstandard's.
+ *
+ * Both decoders check every length and offset against the buffers and
+ * fail on malformed input rather than read or write outside them.
+ */
+
+#include "aurorafs.h"
+#include "../../kernel/memory/memory.h"
+#include <stddef.h>
+
+#define LZ_MIN_MATCH        4
+#define LZ_LAST_LITERALS    5           /* LZ4: the last 5 bytes are always literals */
+#define LZ_MF_LIMIT         12          /* LZ4: no match starts in the last 12 bytes */
+#define LZ_WINDOW           65536
+#define LZ_HASH_LOG         15
+#define LZ4_CHAIN_DEPTH     8
+#define LZE_CHAIN_DEPTH     96
+
+#define HUFF_MAX_BITS       12
+#define HUFF_LIT_SYMBOLS    256
+#define HUFF_LEN_SYMBOLS    44          /* 0-15 direct, then one per power of two to 2^31 */
+#define HUFF_OFF_SYMBOLS    16          /* One per power of two below LZ_WINDOW */
+
+typedef uint64_t __attribute__((may_alias, aligned(1))) lz_u64;
+typedef uint32_t __attribute__((may_alias, aligned(1))) lz_u32;
+
+static inline uint32_t lz_read32(const uint8_t* p) {
+    return *(const lz_u32*)p;
+}
+
+static inline void lz_copy8(uint8_t* dest, const uint8_t* src) {
+    *(lz_u64*)dest = *(const lz_u64*)src;
+}
+
+static void lz_memcpy(uint8_t* dest, const uint8_t* src, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        dest[i] = src[i];
+    }
+}
+
+static void lz_memset(void* dest, int value, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    for (size_t i = 0; i < n; i++) {
+        d[i] = (uint8_t)value;
+    }
+}
+
+/* ============================================================================
+ * MATCH FINDER
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t head[1 << LZ_HASH_LOG];    /* Latest position + 1 per hash */
+    uint16_t chain[LZ_WINDOW];          /* Distance back to the previous position */
+} lz_finder_t;
+
+static inline uint32_t lz_hash(const uint8_t* p) {
+    return (lz_read32(p) * 2654435761u) >> (32 - LZ_HASH_LOG);
+}
+
+static inline void lz_insert(lz_finder_t* mf, const uint8_t* in, uint32_t pos) {
+    uint32_t h = lz_hash(in + pos);
+    uint32_t prev = mf->head[h];
+    uint32_t delta = (prev && pos - (prev - 1) < LZ_WINDOW) ? pos - (prev - 1) : 0;
+    mf->chain[pos & (LZ_WINDOW - 1)] = (uint16_t)delta;
+    mf->head[h] = pos + 1;
+}
+
+/* Longest match for pos ending by limit, from at most depth candidates.
+ * pos must not have been inserted yet. */
+static uint32_t lz_find(const lz_finder_t* mf, const uint8_t* in, uint32_t pos,
+                        uint32_t limit, uint32_t depth, uint32_t* offset) {
+    uint32_t best = 0;
+    uint32_t prev = mf->head[lz_hash(in + pos)];
+    if (!prev) {
+        return 0;
+    }
+    uint32_t cand = prev - 1;
+    uint32_t first = lz_read32(in + pos);
+
+    while (depth-- && pos - cand < LZ_WINDOW) {
+        if (lz_read32(in + cand) == first && in[cand + best] == in[pos + best]) {
+            uint32_t len = LZ_MIN_MATCH;
+            while (pos + len + 8 <= limit &&
+                   *(const lz_u64*)(in + cand + len) == *(const lz_u64*)(in + pos + len)) {
+                len += 8;
+            }
+            while (pos + len < limit && in[cand + len] == in[pos + len]) {
+                len++;
+            }
+            if (len > best) {
+                best = len;
+                *offset = pos - cand;
+                if (pos + len >= limit) {
+                    break;
+                }
+            }
+        }
+        uint16_t delta = mf->chain[cand & (LZ_WINDOW - 1)];
+        if (!delta || delta > cand) {
+            break;
+        }
+        cand -= delta;
+    }
+    return best >= LZ_MIN_MATCH ? best : 0;
+}
+
+static lz_finder_t* lz_finder_create(void) {
+    lz_finder_t* mf = (lz_finder_t*)kmalloc(sizeof(lz_finder_t));
+    if (mf) {
+        lz_memset(mf->head, 0, sizeof(mf->head));
+    }
+    return mf;
+}
+
+/* ============================================================================
+ * LZ4
+ * ============================================================================ */
+
+/* Append a length's 255-byte continuation, or fail at end */
+static inline int lz4_put_length(uint8_t** op, uint8_t* oend, uint32_t len) {
+    uint8_t* p = *op;
+    while (len >= 255) {
+        if (p >= oend) {
+            return -1;
+        }
+        *p++ = 255;
+        len -= 255;
+    }
+    if (p >= oend) {
+        return -1;
+    }
+    *p++ = (uint8_t)len;
+    *op = p;
+    return 0;
+}
+
+static int lz4_put_sequence(uint8_t** op, uint8_t* oend, const uint8_t* lit, uint32_t lit_len,
+                            uint32_t offset, uint32_t match_len) {
+    uint8_t* p = *op;
+    if (p >= oend) {
+        return -1;
+    }
+    uint8_t* token = p++;
+    *token = (uint8_t)((lit_len >= 15 ? 15 : lit_len) << 4);
+    if (lit_len >= 15 && lz4_put_length(&p, oend, lit_len - 15) != 0) {
+        return -1;
+    }
+    if ((size_t)(oend - p) < lit_len) {
+        return -1;
+    }
+    lz_memcpy(p, lit, lit_len);
+    p += lit_len;
+
+    if (match_len) {
+        uint32_t ml = match_len - LZ_MIN_MATCH;
+        if (oend - p < 2) {
+            return -1;
+        }
+        *p++ = (uint8_t)offset;
+        *p++ = (uint8_t)(offset >> 8);
+        *token |= (uint8_t)(ml >= 15 ? 15 : ml);
+        if (ml >= 15 && lz4_put_length(&p, oend, ml - 15) != 0) {
+            return -1;
+        }
+    }
+    *op = p;
+    return 0;
+}
+
+static int lz4_compress(const uint8_t* in, uint32_t size, uint8_t* out, uint32_t capacity,
+                        uint32_t* out_size) {
+    uint8_t* op = out;
+    uint8_t* oend = out + capacity;
+    uint32_t anchor = 0;
+
+    if (size > LZ_MF_LIMIT) {
+        lz_finder_t* mf = lz_finder_create();
+        if (!mf) {
+            return -1;
+        }
+        uint32_t match_limit = size - LZ_LAST_LITERALS;
+        uint32_t last_start = size - LZ_MF_LIMIT;
+        uint32_t pos = 0;
+        uint32_t misses = 0;
+
+        while (pos < last_start) {
+            uint32_t offset = 0;
+            uint32_t len = lz_find(mf, in, pos, match_limit, LZ4_CHAIN_DEPTH, &offset);
+            if (!len) {
+                lz_insert(mf, in, pos);
+                /* Skip ahead faster the longer nothing matches */
+                pos += 1 + (misses++ >> 5);
+                continue;
+            }
+            misses = 0;
+            if (lz4_put_sequence(&op, oend, in + anchor, pos - anchor, offset, len) != 0) {
+                kfree(mf);
+                return -1;
+            }
+            uint32_t end = pos + len;
+            for (; pos < end && pos < last_start; pos++) {
+                lz_insert(mf, in, pos);
+            }
+            pos = end;
+            anchor = end;
+        }
+        kfree(mf);
+    }
+
+    if (lz4_put_sequence(&op, oend, in + anchor, size - anchor, 0, 0) != 0) {
+        return -1;
+    }
+    *out_size = (uint32_t)(op - out);
+    return 0;
+}
+
+/* Read a length's 255-byte continuation */
+static inline int lz4_get_length(const uint8_t** ip, const uint8_t* iend, uint32_t* len) {
+    const uint8_t* p = *ip;
+    uint8_t b;
+    do {
+        if (p >= iend) {
+            return -1;
+        }
+        b = *p++;
+        if (*len > 0x7FFFFFFFu - b) {
+            return -1;
+        }
+        *len += b;
+    } while (b == 255);
+    *ip = p;
+    return 0;
+}
+
+static int lz4_decompress(const uint8_t* in, uint32_t size, uint8_t* out, uint32_t out_size) {
+    const uint8_t* ip = in;
+    const uint8_t* iend = in + size;
+    uint8_t* op = out;
+    uint8_t* oend = out + out_size;
+
+    while (ip < iend) {
+        uint32_t token = *ip++;
+
+        uint32_t lit_len = token >> 4;
+        if (lit_len == 15 && lz4_get_length(&ip, iend, &lit_len) != 0) {
+            return -1;
+        }
+        if (lit_len > (uint32_t)(iend - ip) || lit_len > (uint32_t)(oend - op)) {
+            return -1;
+        }
+        if (lit_len <= 16 && iend - ip >= 16 && oend - op >= 16) {
+            /* Short literal run: two wild 8-byte copies */
+            lz_copy8(op, ip);
+            lz_copy8(op + 8, ip + 8);
+        } else if (lit_len + 8 <= (uint32_t)(iend - ip) && lit_len + 8 <= (uint32_t)(oend - op)) {
+            for (uint32_t i = 0; i < lit_len; i += 8) {
+                lz_copy8(op + i, ip + i);
+            }
+        } else {
+            lz_memcpy(op, ip, lit_len);
+        }
+        op += lit_len;
+        ip += lit_len;
+
+        /* The last sequence is literals only */
+        if (ip == iend) {
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return -1;
+        }
+        uint32_t offset = (uint32_t)ip[0] | ((uint32_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (uint32_t)(op - out)) {
+            return -1;
+        }
+
+        uint32_t match_len = token & 15;
+        if (match_len == 15 && lz4_get_length(&ip, iend, &match_len) != 0) {
+            return -1;
+        }
+        match_len += LZ_MIN_MATCH;
+        if (match_len > (uint32_t)(oend - op)) {
+            return -1;
+        }
+
+        const uint8_t* match = op - offset;
+        if (offset >= 8 && match_len + 8 <= (uint32_t)(oend - op)) {
+            /* Each 8-byte chunk reads only bytes already written */
+            for (uint32_t i = 0; i < match_len; i += 8) {
+                lz_copy8(op + i, match + i);
+            }
+        } else {
+            for (uint32_t i = 0; i < match_len; i++) {
+                op[i] = match[i];
+            }
+        }
+        op += match_len;
+    }
+
+    return op == oend ? 0 : -1;
+}
+
+/* ============================================================================
+ * ENTROPY MODE
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t lit_len;
+    uint32_t match_len;
+    uint32_t offset;
+} lze_seq_t;
+
+typedef struct {
+    uint64_t acc;
+    uint32_t bits;
+    uint8_t* p;
+    uint8_t* end;
+    int overflow;
+} bit_writer_t;
+
+static inline void bw_put(bit_writer_t* bw, uint32_t value, uint32_t bits) {
+    bw->acc |= (uint64_t)value << bw->bits;
+    bw->bits += bits;
+    while (bw->bits >= 8) {
+        if (bw->p >= bw->end) {
+            bw->overflow = 1;
+            bw->bits = 0;
+            bw->acc = 0;
+            return;
+        }
+        *bw->p++ = (uint8_t)bw->acc;
+        bw->acc >>= 8;
+        bw->bits -= 8;
+    }
+}
+
+static inline void bw_flush(bit_writer_t* bw) {
+    if (bw->bits) {
+        bw_put(bw, 0, 8 - bw->bits);
+    }
+}
+
+typedef struct {
+    uint64_t acc;
+    uint32_t bits;
+    const uint8_t* p;
+    const uint8_t* end;
+    uint32_t overrun;               /* Zero bits supplied past the end */
+} bit_reader_t;
+
+static inline void br_refill(bit_reader_t* br) {
+    while (br->bits <= 56) {
+        if (br->p < br->end) {
+            br->acc |= (uint64_t)*br->p++ << br->bits;
+        } else {
+            br->overrun += 8;
+        }
+        br->bits += 8;
+    }
+}
+
+/* Up to 32 bits */
+static inline uint32_t br_get(bit_reader_t* br, uint32_t bits) {
+    if (br->bits < bits) {
+        br_refill(br);
+    }
+    uint32_t v = (uint32_t)(br->acc & ((1ull << bits) - 1));
+    br->acc >>= bits;
+    br->bits -= bits;
+    return v;
+}
+
+/* Value to (code, extra bit count, extra bits) for lengths and offsets */
+static inline uint32_t lze_len_code(uint32_t v, uint32_t* nbits) {
+    if (v < 16) {
+        *nbits = 0;
+        return v;
+    }
+    uint32_t b = 31 - (uint32_t)__builtin_clz(v);
+    *nbits = b;
+    return 12 + b;
+}
+
+static inline uint32_t lze_off_code(uint32_t v, uint32_t* nbits) {
+    uint32_t b = 31 - (uint32_t)__builtin_clz(v);
+    *nbits = b;
+    return b;
+}
+
+/* Code lengths for a Huffman code no longer than HUFF_MAX_BITS. When a
+ * code comes out too long, frequencies are halved and it is rebuilt. */
+static void huff_build_lengths(const uint32_t* freq, uint32_t n, uint8_t* lens) {
+    uint32_t f[HUFF_LIT_SYMBOLS];
+    uint16_t sym[HUFF_LIT_SYMBOLS];
+    uint32_t weight[2 * HUFF_LIT_SYMBOLS];
+    uint16_t parent[2 * HUFF_LIT_SYMBOLS];
+    uint8_t depth[2 * HUFF_LIT_SYMBOLS];
+    uint32_t count = 0;
+
+    lz_memset(lens, 0, n);
+    for (uint32_t s = 0; s < n; s++) {
+        if (freq[s]) {
+            sym[count] = (uint16_t)s;
+            f[count++] = freq[s];
+        }
+    }
+    if (count == 0) {
+        return;
+    }
+    if (count == 1) {
+        lens[sym[0]] = 1;
+        return;
+    }
+
+    for (;;) {
+        /* Leaves in ascending weight: insertion sort, n is small */
+        for (uint32_t i = 1; i < count; i++) {
+            uint32_t fi = f[i];
+            uint16_t si = sym[i];
+            uint32_t j = i;
+            while (j > 0 && f[j - 1] > fi) {
+                f[j] = f[j - 1];
+                sym[j] = sym[j - 1];
+                j--;
+            }
+            f[j] = fi;
+            sym[j] = si;
+        }
+
+        /* Two-queue construction: leaves 0..count-1, internal nodes after */
+        for (uint32_t i = 0; i < count; i++) {
+            weight[i] = f[i];
+        }
+        uint32_t leaf = 0;
+        uint32_t node = count;
+        uint32_t next = count;
+        for (uint32_t k = 0; k < count - 1; k++) {
+            uint32_t pick[2];
+            for (int c = 0; c < 2; c++) {
+                if (leaf < count && (node >= next || weight[leaf] <= weight[node])) {
+                    pick[c] = leaf++;
+                } else {
+                    pick[c] = node++;
+                }
+            }
+            weight[next] = weight[pick[0]] + weight[pick[1]];
+            parent[pick[0]] = (uint16_t)next;
+            parent[pick[1]] = (uint16_t)next;
+            next++;
+        }
+
+        uint32_t root = next - 1;
+        uint32_t max_depth = 0;
+        depth[root] = 0;
+        for (uint32_t i = root; i-- > 0;) {
+            depth[i] = (uint8_t)(depth[parent[i]] + 1);
+            if (i < count && depth[i] > max_depth) {
+                max_depth = depth[i];
+            }
+        }
+        if (max_depth <= HUFF_MAX_BITS) {
+            for (uint32_t i = 0; i < count; i++) {
+                lens[sym[i]] = depth[i];
+            }
+            return;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            f[i] = (f[i] >> 1) | 1;
+        }
+    }
+}
+
+/* Canonical codes from lengths, bit-reversed for an LSB-first stream */
+static void huff_build_codes(const uint8_t* lens, uint32_t n, uint16_t* codes) {
+    uint32_t bl_count[HUFF_MAX_BITS + 1] = {0};
+    uint32_t next_code[HUFF_MAX_BITS + 1];
+    for (uint32_t s = 0; s < n; s++) {
+        bl_count[lens[s]]++;
+    }
+    bl_count[0] = 0;
+    uint32_t code = 0;
+    for (uint32_t b = 1; b <= HUFF_MAX_BITS; b++) {
+        code = (code + bl_count[b - 1]) << 1;
+        next_code[b] = code;
+    }
+    for (uint32_t s = 0; s < n; s++) {
+        uint32_t len = lens[s];
+        if (!len) {
+            codes[s] = 0;
+            continue;
+        }
+        uint32_t c = next_code[len]++;
+        uint32_t r = 0;
+        for (uint32_t i = 0; i < len; i++) {
+            r = (r << 1) | ((c >> i) & 1);
+        }
+        codes[s] = (uint16_t)r;
+    }
+}
+
+/* Decode table indexed by the next HUFF_MAX_BITS bits: symbol << 4 | length,
+ * 0 for bit patterns no code starts with. Fails on an oversubscribed code. */
+static int huff_build_table(const uint8_t* lens, uint32_t n, uint16_t* table) {
+    uint16_t codes[HUFF_LIT_SYMBOLS];
+    uint32_t kraft = 0;
+    for (uint32_t s = 0; s < n; s++) {
+        if (lens[s]) {
+            kraft += 1u << (HUFF_MAX_BITS - lens[s]);
+        }
+    }
+    if (kraft > (1u << HUFF_MAX_BITS)) {
+        return -1;
+    }
+
+    lz_memset(table, 0, sizeof(uint16_t) << HUFF_MAX_BITS);
+    huff_build_codes(lens, n, codes);
+    for (uint32_t s = 0; s < n; s++) {
+        uint32_t len = lens[s];
+        if (!len) {
+            continue;
+        }
+        for (uint32_t i = codes[s]; i < (1u << HUFF_MAX_BITS); i += 1u << len) {
+            table[i] = (uint16_t)((s << 4) | len);
+        }
+    }
+    return 0;
+}
+
+static inline int huff_decode(bit_reader_t* br, const uint16_t* table, uint32_t* sym) {
+    if (br->bits < HUFF_MAX_BITS) {
+        br_refill(br);
+    }
+    uint16_t e = table[br->acc & ((1u << HUFF_MAX_BITS) - 1)];
+    if (!e) {
+        return -1;
+    }
+    br->acc >>= e & 15;
+    br->bits -= e & 15;
+    *sym = e >> 4;
+    return 0;
+}
+
+/* Code lengths as nibbles; 15 then n stands for n + 2 zero lengths */
+static void lze_put_lengths(bit_writer_t* bw, const uint8_t* lens, uint32_t n) {
+    for (uint32_t s = 0; s < n;) {
+        uint32_t run = 0;
+        while (s + run < n && !lens[s + run] && run < 17) {
+            run++;
+        }
+        if (run >= 2) {
+            bw_put(bw, 15, 4);
+            bw_put(bw, run - 2, 4);
+            s += run;
+        } else {
+            bw_put(bw, lens[s], 4);
+            s++;
+        }
+    }
+}
+
+static int lze_get_lengths(bit_reader_t* br, uint8_t* lens, uint32_t n) {
+    for (uint32_t s = 0; s < n;) {
+        uint32_t v = br_get(br, 4);
+        if (v == 15) {
+            uint32_t run = br_get(br, 4) + 2;
+            if (run > n - s) {
+                return -1;
+            }
+            lz_memset(lens + s, 0, run);
+            s += run;
+        } else if (v > HUFF_MAX_BITS) {
+            return -1;
+        } else {
+            lens[s++] = (uint8_t)v;
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    uint8_t lens[HUFF_LIT_SYMBOLS];
+    uint16_t codes[HUFF_LIT_SYMBOLS];
+} huff_code_t;
+
+/* Tables: literals, literal lengths, match lengths, offsets */
+static const uint32_t lze_symbols[4] = {
+    HUFF_LIT_SYMBOLS, HUFF_LEN_SYMBOLS, HUFF_LEN_SYMBOLS, HUFF_OFF_SYMBOLS
+};
+
+static inline void lze_put_symbol(bit_writer_t* bw, const huff_code_t* code, uint32_t s) {
+    bw_put(bw, code->codes[s], code->lens[s]);
+}
+
+static int lze_compress(const uint8_t* in, uint32_t size, uint8_t* out, uint32_t capacity,
+                        uint32_t* out_size) {
+    uint32_t max_seqs = size / LZ_MIN_MATCH + 1;
+    lze_seq_t* seqs = (lze_seq_t*)kmalloc((size_t)max_seqs * sizeof(lze_seq_t));
+    lz_finder_t* mf = lz_finder_create();
+    huff_code_t* codes = (huff_code_t*)kmalloc(4 * sizeof(huff_code_t));
+    uint32_t* freq = (uint32_t*)kmalloc(4 * HUFF_LIT_SYMBOLS * sizeof(uint32_t));
+    int result = -1;
+    if (!seqs || !mf || !codes || !freq) {
+        goto out;
+    }
+
+    /* Parse: greedy with a one-step lazy check */
+    uint32_t nseq = 0;
+    uint32_t anchor = 0;
+    if (size > LZ_MF_LIMIT) {
+        uint32_t limit = size;
+        uint32_t last_start = size - LZ_MIN_MATCH;
+        uint32_t pos = 0;
+        while (pos < last_start) {
+            uint32_t offset = 0;
+            uint32_t len = lz_find(mf, in, pos, limit, LZE_CHAIN_DEPTH, &offset);
+            lz_insert(mf, in, pos);
+            if (!len) {
+                pos++;
+                continue;
+            }
+            while (pos + 1 < last_start) {
+                uint32_t next_offset = 0;
+                uint32_t next = lz_find(mf, in, pos + 1, limit, LZE_CHAIN_DEPTH, &next_offset);
+                if (next <= len) {
+                    break;
+                }
+                lz_insert(mf, in, ++pos);
+                len = next;
+                offset = next_offset;
+            }
+            seqs[nseq].lit_len = pos - anchor;
+            seqs[nseq].match_len = len;
+            seqs[nseq].offset = offset;
+            nseq++;
+            uint32_t end = pos + len;
+            for (pos++; pos < end && pos < last_start; pos++) {
+                lz_insert(mf, in, pos);
+            }
+            pos = end;
+            anchor = end;
+        }
+    }
+
+    /* Symbol frequencies */
+    lz_memset(freq, 0, 4 * HUFF_LIT_SYMBOLS * sizeof(uint32_t));
+    uint32_t* lit_freq = freq;
+    uint32_t* ll_freq = freq + HUFF_LIT_SYMBOLS;
+    uint32_t* ml_freq = freq + 2 * HUFF_LIT_SYMBOLS;
+    uint32_t* off_freq = freq + 3 * HUFF_LIT_SYMBOLS;
+    uint32_t at = 0;
+    for (uint32_t i = 0; i < nseq; i++) {
+        uint32_t nb;
+        for (uint32_t k = 0; k < seqs[i].lit_len; k++) {
+            lit_freq[in[at + k]]++;
+        }
+        ll_freq[lze_len_code(seqs[i].lit_len, &nb)]++;
+        ml_freq[lze_len_code(seqs[i].match_len - LZ_MIN_MATCH, &nb)]++;
+        off_freq[lze_off_code(seqs[i].offset, &nb)]++;
+        at += seqs[i].lit_len + seqs[i].match_len;
+    }
+    for (uint32_t k = at; k < size; k++) {
+        lit_freq[in[k]]++;
+    }
+    for (int t = 0; t < 4; t++) {
+        huff_build_lengths(freq + t * HUFF_LIT_SYMBOLS, lze_symbols[t], codes[t].lens);
+        huff_build_codes(codes[t].lens, lze_symbols[t], codes[t].codes);
+    }
+
+    /* Header: sequence count, code lengths; then the sequences */
+    bit_writer_t bw = { 0, 0, out, out + capacity, 0 };
+    bw_put(&bw, nseq, 32);
+    for (int t = 0; t < 4; t++) {
+        lze_put_lengths(&bw, codes[t].lens, lze_symbols[t]);
+    }
+    at = 0;
+    for (uint32_t i = 0; i < nseq && !bw.overflow; i++) {
+        uint32_t nb;
+        uint32_t v = seqs[i].lit_len;
+        uint32_t c = lze_len_code(v, &nb);
+        lze_put_symbol(&bw, &codes[1], c);
+        if (nb) {
+            bw_put(&bw, v - (1u << nb), nb);
+        }
+        for (uint32_t k = 0; k < seqs[i].lit_len; k++) {
+            lze_put_symbol(&bw, &codes[0], in[at + k]);
+        }
+        v = seqs[i].match_len - LZ_MIN_MATCH;
+        c = lze_len_code(v, &nb);
+        lze_put_symbol(&bw, &codes[2], c);
+        if (nb) {
+            bw_put(&bw, v - (1u << nb), nb);
+        }
+        v = seqs[i].offset;
+        c = lze_off_code(v, &nb);
+        lze_put_symbol(&bw, &codes[3], c);
+        if (nb) {
+            bw_put(&bw, v - (1u << nb), nb);
+        }
+        at += seqs[i].lit_len + seqs[i].match_len;
+    }
+    for (uint32_t k = at; k < size && !bw.overflow; k++) {
+        lze_put_symbol(&bw, &codes[0], in[k]);
+    }
+    bw_flush(&bw);
+
+    if (!bw.overflow) {
+        *out_size = (uint32_t)(bw.p - out);
+        result = 0;
+    }
+
+out:
+    if (seqs) kfree(seqs);
+    if (mf) kfree(mf);
+    if (codes) kfree(codes);
+    if (freq) kfree(freq);
+    return result;
+}
+
+static int lze_decompress(const uint8_t* in, uint32_t size, uint8_t* out, uint32_t out_size) {
+    uint16_t* tables = (uint16_t*)kmalloc(4 * (sizeof(uint16_t) << HUFF_MAX_BITS));
+    if (!tables) {
+        return -1;
+    }
+    uint16_t* lit_table = tables;
+    uint16_t* ll_table = tables + (1 << HUFF_MAX_BITS);
+    uint16_t* ml_table = tables + 2 * (1 << HUFF_MAX_BITS);
+    uint16_t* off_table = tables + 3 * (1 << HUFF_MAX_BITS);
+
+    bit_reader_t br = { 0, 0, in, in + size, 0 };
+    uint8_t lens[HUFF_LIT_SYMBOLS];
+    int result = -1;
+    uint32_t nseq = br_get(&br, 32);
+    for (int t = 0; t < 4; t++) {
+        if (lze_get_lengths(&br, lens, lze_symbols[t]) != 0 ||
+            huff_build_table(lens, lze_symbols[t], tables + t * (1 << HUFF_MAX_BITS)) != 0) {
+            goto out;
+        }
+    }
+    if (nseq > out_size / LZ_MIN_MATCH) {
+        goto out;
+    }
+
+    uint32_t op = 0;
+    for (uint32_t i = 0; i < nseq; i++) {
+        uint32_t c, lit_len, match_len, offset;
+        if (huff_decode(&br, ll_table, &c) != 0) {
+            goto out;
+        }
+        lit_len = c < 16 ? c : (1u << (c - 12)) + br_get(&br, c - 12);
+        if (lit_len > out_size - op) {
+            goto out;
+        }
+        for (uint32_t k = 0; k < lit_len; k++) {
+            if (huff_decode(&br, lit_table, &c) != 0) {
+                goto out;
+            }
+            out[op++] = (uint8_t)c;
+        }
+
+        if (huff_decode(&br, ml_table, &c) != 0) {
+            goto out;
+        }
+        match_len = (c < 16 ? c : (1u << (c - 12)) + br_get(&br, c - 12)) + LZ_MIN_MATCH;
+        if (huff_decode(&br, off_table, &c) != 0) {
+            goto out;
+        }
+        offset = (1u << c) + (c ? br_get(&br, c) : 0);
+        if (offset > op || match_len > out_size - op) {
+            goto out;
+        }
+
+        const uint8_t* match = out + op - offset;
+        uint8_t* dest = out + op;
+        if (offset >= 8 && match_len + 8 <= out_size - op) {
+            for (uint32_t k = 0; k < match_len; k += 8) {
+                lz_copy8(dest + k, match + k);
+            }
+        } else {
+            for (uint32_t k = 0; k < match_len; k++) {
+                dest[k] = match[k];
+            }
+        }
+        op += match_len;
+        if (br.overrun > 64) {
+            goto out;
+        }
+    }
+    while (op < out_size) {
+        uint32_t c;
+        if (huff_decode(&br, lit_table, &c) != 0) {
+            goto out;
+        }
+        out[op++] = (uint8_t)c;
+    }
+
+    /* Everything decoded must have come from the input */
+    if (br.overrun <= br.bits) {
+        result = 0;
+    }
+
+out:
+    kfree(tables);
+    return result;
+}
+
+/* ============================================================================
+ * COMPRESSION FUNCTIONS
+ * ============================================================================ */
+
+/* log2(x) in 1/256ths, to within about 0.01 */
+static uint32_t log2_q8(uint32_t x) {
+    uint32_t e = 31 - (uint32_t)__builtin_clz(x);
+    uint32_t t = (e >= 8) ? (x >> (e - 8)) & 0xFF : (x << (8 - e)) & 0xFF;
+    return (e << 8) + t + ((t * (256 - t) * 88) >> 16);
+}
+
+/**
+ * Estimate whether data is worth compressing from the byte entropy of a
+ * sample: data already compressed or encrypted is close to 8 bits a byte
+ */
+int aurorafs_compress_worthwhile(const void* data, size_t size) {
+    if (!data || size < 64) {
+        return 0;
+    }
+
+    const uint8_t* p = (const uint8_t*)data;
+    uint32_t hist[256] = {0};
+    uint32_t sampled = 0;
+    size_t chunk = 256;
+    size_t step = (size > AURORAFS_COMPRESS_SAMPLE) ? size / (AURORAFS_COMPRESS_SAMPLE / chunk) : chunk;
+    for (size_t at = 0; at + chunk <= size && sampled < AURORAFS_COMPRESS_SAMPLE; at += step) {
+        for (size_t i = 0; i < chunk; i++) {
+            hist[p[at + i]]++;
+        }
+        sampled += (uint32_t)chunk;
+    }
+    if (sampled == 0) {
+        for (size_t i = 0; i < size; i++) {
+            hist[p[i]]++;
+        }
+        sampled = (uint32_t)size;
+    }
+
+    /* Entropy * n = n log n - sum f log f */
+    uint64_t sum = 0;
+    for (int i = 0; i < 256; i++) {
+        if (hist[i]) {
+            sum += (uint64_t)hist[i] * log2_q8(hist[i]);
+        }
+    }
+    uint64_t bits_q8 = (uint64_t)sampled * log2_q8(sampled) - sum;
+    return bits_q8 < (uint64_t)sampled * AURORAFS_COMPRESS_MAX_ENTROPY_Q8;
+}
+
+/**
+ * Compress block using specified algorithm. output holds input_size
+ * bytes; fails if the data does not fit in fewer.
+ */
+int aurorafs_compress_block(const void* input, size_t input_size,
+                            void* output, size_t* output_size, uint32_t algorithm) {
+    if (!input || !output || !output_size || input_size == 0 || input_size > 0x7FFFFFFFu) {
+        return -1;
+    }
+
+    uint32_t capacity = (uint32_t)input_size - 1;
+    uint32_t written = 0;
+    int result;
+
+    /* Implement compression based on algorithm */
+    switch (algorithm) {
+        case AURORAFS_COMPRESS_LZ4:
+            result = lz4_compress((const uint8_t*)input, (uint32_t)input_size,
+                                  (uint8_t*)output, capacity, &written);
+            break;
+
+        case AURORAFS_COMPRESS_ZSTD:
+            result = lze_compress((const uint8_t*)input, (uint32_t)input_size,
+                                  (uint8_t*)output, capacity, &written);
+            break;
+
+        case AURORAFS_COMPRESS_LZMA:
+            /* Not implemented: callers store the data raw */
+        default:
+            return -1;
+    }
+
+    if (result != 0) {
+        return -1;
+    }
+    *output_size = written;
+    return 0;
+}
+
+/**
+ * Decompress block using specified algorithm. Succeeds only if input
+ * decodes to exactly output_size bytes.
+ */
+int aurorafs_decompress_block(const void* input, size_t input_size,
+                              void* output, size_t output_size, uint32_t algorithm) {
+    if (!input || !output || input_size > 0x7FFFFFFFu || output_size > 0x7FFFFFFFu) {
+        return -1;
+    }
+
+    /* Implement decompression based on algorithm */
+    switch (algorithm) {
+        case AURORAFS_COMPRESS_LZ4:
+            return lz4_decompress((const uint8_t*)input, (uint32_t)input_size,
+                                  (uint8_t*)output, (uint32_t)output_size);
+
+        case AURORAFS_COMPRESS_ZSTD:
+            return lze_decompress((const uint8_t*)input, (uint32_t)input_size,
+                                  (uint8_t*)output, (uint32_t)output_size);
+
+        default:
+            return -1;
+    }
+}
@@ -0,0 +1,643 @@
+/**
+ * Aurora OS - AuroraFS Deduplication Index
+ *
+ * Maps the SHA-256 of a block's contents to the block holding them, with
+ * a count of the extents sharing it. Entries live in one array and are
+ * chained into two bucket tables: one keyed by the first 8 digest bytes
+ * for lookups by contents, one keyed by block number for reference
+ * counting. A bloom filter over digest bytes 8-19 answers most lookups of
+ * new contents without touching the buckets. Bloom bits are never
+ * cleared on removal; the filter is rebuilt when the table grows or once
+ * removals have left too many stale bits.
+ */
+
+#include "aurorafs.h"
+#include "../../kernel/memory/memory.h"
+#include "../../kernel/security/sha.h"
+#include <stddef.h>
+
+#define DEDUP_NIL               0xFFFFFFFFu
+#define DEDUP_MIN_CAPACITY      1024
+#define DEDUP_BLOOM_BITS        16      /* Filter bits per entry slot */
+
+typedef struct {
+    uint8_t  hash[AURORAFS_HASH_SIZE];
+    uint64_t physical_block;
+    uint32_t refcount;              /* 0 while on the free list */
+    uint32_t compressed_size;
+    uint32_t hash_next;             /* Digest-prefix chain, or free list link */
+    uint32_t block_next;            /* Block-number chain */
+} dedup_node_t;
+
+typedef struct aurorafs_dedup_index {
+    spinlock_t lock;
+    dedup_node_t* nodes;
+    uint32_t capacity;              /* Nodes and buckets per table */
+    uint32_t used;                  /* Nodes ever handed out */
+    uint32_t free_head;
+    uint32_t* hash_buckets;
+    uint32_t* block_buckets;
+    uint64_t* bloom;
+    uint32_t bloom_mask;            /* Filter size in bits, less one */
+    uint32_t stale;                 /* Removals since the filter was built */
+    int dirty;                      /* Changed since stored or loaded */
+    aurorafs_dedup_stats_t stats;
+} aurorafs_dedup_index_t;
+
+static void dd_memcpy(void* dest, const void* src, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+    for (size_t i = 0; i < n; i++) {
+        d[i] = s[i];
+    }
+}
+
+static void dd_memset(void* dest, int value, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    for (size_t i = 0; i < n; i++) {
+        d[i] = (uint8_t)value;
+    }
+}
+
+static inline uint64_t dd_load64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static inline uint32_t dd_load32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline int dd_hash_equal(const uint8_t* a, const uint8_t* b) {
+    for (int i = 0; i < AURORAFS_HASH_SIZE; i += 8) {
+        if (dd_load64(a + i) != dd_load64(b + i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static inline uint32_t dd_hash_bucket(const aurorafs_dedup_index_t* idx, const uint8_t* hash) {
+    return (uint32_t)dd_load64(hash) & (idx->capacity - 1);
+}
+
+static inline uint32_t dd_block_bucket(const aurorafs_dedup_index_t* idx, uint64_t block) {
+    block *= 0x9E3779B97F4A7C15ull;
+    return (uint32_t)(block >> 32) & (idx->capacity - 1);
+}
+
+/* The digest is uniform, so its bytes serve directly as the three
+ * filter hashes */
+static inline void dd_bloom_add(aurorafs_dedup_index_t* idx, const uint8_t* hash) {
+    for (int i = 0; i < 3; i++) {
+        uint32_t bit = dd_load32(hash + 8 + i * 4) & idx->bloom_mask;
+        idx->bloom[bit >> 6] |= 1ull << (bit & 63);
+    }
+}
+
+static inline int dd_bloom_test(const aurorafs_dedup_index_t* idx, const uint8_t* hash) {
+    for (int i = 0; i < 3; i++) {
+        uint32_t bit = dd_load32(hash + 8 + i * 4) & idx->bloom_mask;
+        if (!(idx->bloom[bit >> 6] & (1ull << (bit & 63)))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void dd_bloom_rebuild(aurorafs_dedup_index_t* idx) {
+    dd_memset(idx->bloom, 0, ((size_t)idx->bloom_mask + 1) / 8);
+    for (uint32_t i = 0; i < idx->used; i++) {
+        if (idx->nodes[i].refcount) {
+            dd_bloom_add(idx, idx->nodes[i].hash);
+        }
+    }
+    idx->stale = 0;
+}
+
+/* Allocate tables for a capacity and rehash every live node into them */
+static int dd_resize(aurorafs_dedup_index_t* idx, uint32_t capacity) {
+    dedup_node_t* nodes = (dedup_node_t*)kmalloc((size_t)capacity * sizeof(dedup_node_t));
+    uint32_t* hash_buckets = (uint32_t*)kmalloc((size_t)capacity * sizeof(uint32_t));
+    uint32_t* block_buckets = (uint32_t*)kmalloc((size_t)capacity * sizeof(uint32_t));
+    uint64_t* bloom = (uint64_t*)kmalloc((size_t)capacity * DEDUP_BLOOM_BITS / 8);
+    if (!nodes || !hash_buckets || !block_buckets || !bloom) {
+        if (nodes) kfree(nodes);
+        if (hash_buckets) kfree(hash_buckets);
+        if (block_buckets) kfree(block_buckets);
+        if (bloom) kfree(bloom);
+        return -1;
+    }
+
+    /* Compact live nodes to the front; the rest form the free list */
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < idx->used; i++) {
+        if (idx->nodes[i].refcount) {
+            nodes[used++] = idx->nodes[i];
+        }
+    }
+    for (uint32_t i = 0; i < capacity; i++) {
+        hash_buckets[i] = DEDUP_NIL;
+        block_buckets[i] = DEDUP_NIL;
+    }
+
+    if (idx->nodes) kfree(idx->nodes);
+    if (idx->hash_buckets) kfree(idx->hash_buckets);
+    if (idx->block_buckets) kfree(idx->block_buckets);
+    if (idx->bloom) kfree(idx->bloom);
+
+    idx->nodes = nodes;
+    idx->hash_buckets = hash_buckets;
+    idx->block_buckets = block_buckets;
+    idx->bloom = bloom;
+    idx->bloom_mask = capacity * DEDUP_BLOOM_BITS - 1;
+    idx->capacity = capacity;
+    idx->used = used;
+    idx->free_head = DEDUP_NIL;
+
+    for (uint32_t i = 0; i < used; i++) {
+        uint32_t hb = dd_hash_bucket(idx, nodes[i].hash);
+        uint32_t bb = dd_block_bucket(idx, nodes[i].physical_block);
+        nodes[i].hash_next = hash_buckets[hb];
+        hash_buckets[hb] = i;
+        nodes[i].block_next = block_buckets[bb];
+        block_buckets[bb] = i;
+    }
+    dd_bloom_rebuild(idx);
+    return 0;
+}
+
+static uint32_t dd_find_hash(aurorafs_dedup_index_t* idx, const uint8_t* hash) {
+    idx->stats.lookups++;
+    if (!dd_bloom_test(idx, hash)) {
+        idx->stats.bloom_skips++;
+        return DEDUP_NIL;
+    }
+    for (uint32_t n = idx->hash_buckets[dd_hash_bucket(idx, hash)]; n != DEDUP_NIL;
+         n = idx->nodes[n].hash_next) {
+        if (dd_hash_equal(idx->nodes[n].hash, hash)) {
+            idx->stats.hits++;
+            return n;
+        }
+    }
+    idx->stats.false_positives++;
+    return DEDUP_NIL;
+}
+
+static uint32_t dd_find_block(aurorafs_dedup_index_t* idx, uint64_t block) {
+    for (uint32_t n = idx->block_buckets[dd_block_bucket(idx, block)]; n != DEDUP_NIL;
+         n = idx->nodes[n].block_next) {
+        if (idx->nodes[n].physical_block == block) {
+            return n;
+        }
+    }
+    return DEDUP_NIL;
+}
+
+static int dd_insert(aurorafs_dedup_index_t* idx, const uint8_t* hash, uint64_t block,
+                     uint32_t refcount, uint32_t compressed_size) {
+    if (idx->free_head == DEDUP_NIL && idx->used == idx->capacity) {
+        if (dd_resize(idx, idx->capacity * 2) != 0) {
+            return -1;
+        }
+    }
+
+    uint32_t n;
+    if (idx->free_head != DEDUP_NIL) {
+        n = idx->free_head;
+        idx->free_head = idx->nodes[n].hash_next;
+    } else {
+        n = idx->used++;
+    }
+
+    dedup_node_t* node = &idx->nodes[n];
+    dd_memcpy(node->hash, hash, AURORAFS_HASH_SIZE);
+    node->physical_block = block;
+    node->refcount = refcount;
+    node->compressed_size = compressed_size;
+
+    uint32_t hb = dd_hash_bucket(idx, hash);
+    uint32_t bb = dd_block_bucket(idx, block);
+    node->hash_next = idx->hash_buckets[hb];
+    idx->hash_buckets[hb] = n;
+    node->block_next = idx->block_buckets[bb];
+    idx->block_buckets[bb] = n;
+    dd_bloom_add(idx, hash);
+
+    idx->stats.entries++;
+    idx->stats.references += refcount;
+    idx->dirty = 1;
+    return 0;
+}
+
+static void dd_remove(aurorafs_dedup_index_t* idx, uint32_t n) {
+    dedup_node_t* node = &idx->nodes[n];
+
+    uint32_t* link = &idx->hash_buckets[dd_hash_bucket(idx, node->hash)];
+    while (*link != n) {
+        link = &idx->nodes[*link].hash_next;
+    }
+    *link = node->hash_next;
+
+    link = &idx->block_buckets[dd_block_bucket(idx, node->physical_block)];
+    while (*link != n) {
+        link = &idx->nodes[*link].block_next;
+    }
+    *link = node->block_next;
+
+    idx->stats.entries--;
+    idx->stats.references -= node->refcount;
+    idx->dirty = 1;
+    node->refcount = 0;
+    node->hash_next = idx->free_head;
+    idx->free_head = n;
+
+    /* Stale bits only cost false positives, until there are enough of
+     * them to be worth a rebuild */
+    if (++idx->stale > idx->capacity / 2) {
+        dd_bloom_rebuild(idx);
+    }
+}
+
+/**
+ * SHA-256 of a block's contents, as the dedup index keys it
+ */
+void aurorafs_calculate_hash(const void* data, size_t size, uint8_t* hash) {
+    sha256(data, size, hash);
+}
+
+/**
+ * Create the in-memory index
+ */
+int aurorafs_dedup_create(aurorafs_mount_t* mount) {
+    if (!mount) {
+        return -1;
+    }
+
+    aurorafs_dedup_index_t* idx = (aurorafs_dedup_index_t*)kmalloc(sizeof(aurorafs_dedup_index_t));
+    if (!idx) {
+        return -1;
+    }
+    dd_memset(idx, 0, sizeof(*idx));
+    spinlock_init(&idx->lock);
+    if (dd_resize(idx, DEDUP_MIN_CAPACITY) != 0) {
+        kfree(idx);
+        return -1;
+    }
+
+    mount->dedup_hash_table = idx;
+    return 0;
+}
+
+/**
+ * Free the in-memory index
+ */
+void aurorafs_dedup_destroy(aurorafs_mount_t* mount) {
+    if (!mount || !mount->dedup_hash_table) {
+        return;
+    }
+
+    aurorafs_dedup_index_t* idx = (aurorafs_dedup_index_t*)mount->dedup_hash_table;
+    kfree(idx->nodes);
+    kfree(idx->hash_buckets);
+    kfree(idx->block_buckets);
+    kfree(idx->bloom);
+    kfree(idx);
+    mount->dedup_hash_table = NULL;
+}
+
+/**
+ * Find block by hash in dedup table
+ */
+int aurorafs_dedup_find_block(aurorafs_mount_t* mount, const uint8_t* hash,
+                              uint64_t* physical_block) {
+    if (!mount || !hash || !physical_block || !mount->dedup_enabled ||
+        !mount->dedup_hash_table) {
+        return -1;
+    }
+
+    aurorafs_dedup_index_t* idx = (aurorafs_dedup_index_t*)mount->dedup_hash_table;
+    spinlock_acquire(&idx->lock);
+    uint32_t n = dd_find_hash(idx, hash);
+    if (n != DEDUP_NIL) {
+        *physical_block = idx->nodes[n].physical_block;
+    }
+    spinlock_release(&idx->lock);
+
+    return (n != DEDUP_NIL) ? 0 : -1;
+}
+
+/**
+ * Find a block by hash and take a reference to it
+ */
+int aurorafs_dedup_get_block(aurorafs_mount_t* mount, const uint8_t* hash,
+                             uint64_t* physical_block) {
+    if (!mount || !hash || !physical_block || !mount->dedup_enabled ||
+        !mount->dedup_hash_table) {
+        return -1;
+    }
+
+    aurorafs_dedup_index_t* idx = (aurorafs_dedup_index_t*)mount->dedup_hash_table;
+    spinlock_acquire(&idx->lock);
+    uint32_t n = dd_find_hash(idx, hash);
+    if (n != DEDUP_NIL) {
+        idx->nodes[n].refcount++;
+        idx->stats.references++;
+        idx->dirty = 1;
+        *physical_block = idx->nodes[n].physical_block;
+    }
+    spinlock_release(&idx->lock);
+
+    return (n != DEDUP_NIL) ? 0 : -1;
+}
+
+/**
+ * Add block to dedup table with one reference. Fails if the block or its
+ * contents are already indexed.
+ */
+int aurorafs_dedup_add_block(aurorafs_mount_t* mount, const uint8_t* hash,
+                             uint64_t physical_block) {
+    if (!mount || !hash || !mount->dedup_enabled || !mount->dedup_hash_table) {
+        return -1;
+    }
+
+    aurorafs_dedup_index_t* idx = (aurorafs_dedup_index_t*)mount->dedup_hash_table;
+    int result = -1;
+    spinlock_acquire(&idx->lock);
+    if (dd_find_block(idx, physical_block) == DEDUP_NIL) {
+        uint32_t n = DEDUP_NIL;
+        if (dd_bloom_test(idx, hash)) {
+            for (n = idx->hash_buckets[dd_hash_bucket(idx, hash)]; n != DEDUP_NIL;
+                 n = idx->nodes[n].hash_next) {
+                if (dd_hash_equal(idx->nodes[n].hash, hash)) {
+                    break;
+                }
+            }
+        }
+        if (n == DEDUP_NIL) {
+            result = dd_insert(idx, hash, physical_block, 1, AURORAFS_BLOCK_SIZE);
+        }
+    }
+    spinlock_release(&idx->lock);
+
+    return result;
+}
+
+/**
+ * Increment refcount for deduplicated block
+ */
+int aurorafs_dedup_inc_refcount(aurorafs_mount_t* mount, uint64_t physical_block) {
+    if (!mount || !mount->dedup_enabled || !mount->dedup_hash_table) {
+        return -1;
+    }
+
+    aurorafs_dedup_index_t* idx = (aurorafs_dedup_index_t*)mount->dedup_hash_table;
+    spinlock_acquire(&idx->lock);
+    uint32_t n = dd_find_block(idx, physical_block);
+    if (n != DEDUP_NIL) {
+        idx->nodes[n].refcount++;
+        idx->stats.references++;
+        idx->dirty = 1;
+    }
+    spinlock_release(&idx->lock);
+
+    return (n != DEDUP_NIL) ? 0 : -1;
+}
+
+/**
+ * Decrement refcount for deduplicated block, freeing it at zero
+ */
+int aurorafs_dedup_dec_refcount(aurorafs_mount_t* mount, uint64_t physical_block) {
+    if (!mount || !mount->dedup_enabled || !mount->dedup_hash_table) {
+        return -1;
+    }
+
+    aurorafs_dedup_index_t* idx = (aurorafs_dedup_index_t*)mount->dedup_hash_table;
+    int left = -1;
+    spinlock_acquire(&idx->lock);
+    uint32_t n = dd_find_block(idx, physical_block);
+    if (n != DEDUP_NIL) {
+        left = (int)--idx->nodes[n].refcount;
+        idx->stats.references--;
+        idx->dirty = 1;
+        if (left == 0) {
+            dd_remove(idx, n);
+            idx->stats.freed++;
+        }
+    }
+    spinlock_release(&idx->lock);
+
+    if (left == 0) {
+        aurorafs_free_blocks(mount, physical_block, 1);
+    }
+    return left;
+}
+
+/**
+ * Get an indexed block ready to be overwritten in place
+ */
+int aurorafs_dedup_unshare(aurorafs_mount_t* mount, uint64_t physical_block) {
+    if (!mount || !mount->dedup_enabled || !mount->dedup_hash_table) {
+        return -1;
+    }
+
+    aurorafs_dedup_index_t* idx = (aurorafs_dedup_index_t*)mount->dedup_hash_table;
+    int result = -1;
+    spinlock_acquire(&idx->lock);
+    uint32_t n = dd_find_block(idx, physical_block);
+    if (n != DEDUP_NIL) {
+        if (idx->nodes[n].refcount == 1) {
+            dd_remove(idx, n);
+            result = 0;
+        } else {
+            idx->nodes[n].refcount--;
+            idx->stats.references--;
+            idx->dirty = 1;
+            result = 1;
+        }
+    }
+    spinlock_release(&idx->lock);
+
+    return result;
+}
+
+/**
+ * Load the table the superblock points to into the in-memory index
+ */
+int aurorafs_dedup_load(aurorafs_mount_t* mount) {
+    if (!mount || !mount->dedup_hash_table || !mount->superblock) {
+        return -1;
+    }
+
+    uint64_t start = mount->superblock->dedup_table_inode;
+    if (start == 0) {
+        return 0;
+    }
+
+    const aurorafs_device_t* dev = mount->device;
+    aurorafs_dedup_index_t* idx = (aurorafs_dedup_index_t*)mount->dedup_hash_table;
+    uint8_t* block = (uint8_t*)kmalloc(AURORAFS_BLOCK_SIZE);
+    if (!block) {
+        return -1;
+    }
+
+    aurorafs_dedup_header_t header;
+    if (dev->read(dev->ctx, start, block, 1) != 0) {
+        kfree(block);
+        return -1;
+    }
+    dd_memcpy(&header, block, sizeof(header));
+    uint64_t needed = 1 + (header.entries + AURORAFS_DEDUP_PER_BLOCK - 1) / AURORAFS_DEDUP_PER_BLOCK;
+    if (header.magic != AURORAFS_DEDUP_MAGIC ||
+        header.entry_size != sizeof(aurorafs_dedup_entry_t) ||
+        header.blocks != needed || start + needed > mount->superblock->total_blocks) {
+        kfree(block);
+        return -1;
+    }
+
+    sha256_ctx_t sha;
+    sha256_init(&sha);
+    int result = 0;
+    spinlock_acquire(&idx->lock);
+    for (uint64_t b = 1; b < header.blocks && result == 0; b++) {
+        if (dev->read(dev->ctx, start + b, block, 1) != 0) {
+            result = -1;
+            break;
+        }
+        sha256_update(&sha, block, AURORAFS_BLOCK_SIZE);
+
+        uint64_t first = (b - 1) * AURORAFS_DEDUP_PER_BLOCK;
+        for (uint64_t i = 0; i < AURORAFS_DEDUP_PER_BLOCK && first + i < header.entries; i++) {
+            aurorafs_dedup_entry_t entry;
+            dd_memcpy(&entry, block + i * sizeof(entry), sizeof(entry));
+            if (entry.refcount == 0 ||
+                dd_insert(idx, entry.hash, entry.physical_block, entry.refcount,
+                          entry.compressed_size) != 0) {
+                result = -1;
+                break;
+            }
+        }
+    }
+    idx->dirty = 0;
+    spinlock_release(&idx->lock);
+    kfree(block);
+
+    uint8_t digest[AURORAFS_HASH_SIZE];
+    sha256_final(&sha, digest);
+    if (result == 0 && !dd_hash_equal(digest, header.digest)) {
+        result = -1;
+    }
+    return result;
+}
+
+/**
+ * Store the in-memory index as a new table and point the superblock at
+ * it, freeing the table it replaces. Nothing is written if the stored
+ * table is current. The superblock itself is written by the caller.
+ */
+int aurorafs_dedup_store(aurorafs_mount_t* mount) {
+    if (!mount || !mount->dedup_hash_table || !mount->superblock) {
+        return -1;
+    }
+
+    const aurorafs_device_t* dev = mount->device;
+    aurorafs_dedup_index_t* idx = (aurorafs_dedup_index_t*)mount->dedup_hash_table;
+
+    uint64_t old = mount->superblock->dedup_table_inode;
+    spinlock_acquire(&idx->lock);
+    int dirty = idx->dirty;
+    spinlock_release(&idx->lock);
+    if (old != 0 && !dirty) {
+        return 0;
+    }
+
+    /* Free the old table first so its blocks can hold the new one */
+    if (old != 0) {
+        aurorafs_dedup_header_t header;
+        uint8_t* block = (uint8_t*)kmalloc(AURORAFS_BLOCK_SIZE);
+        if (!block) {
+            return -1;
+        }
+        if (dev->read(dev->ctx, old, block, 1) == 0) {
+            dd_memcpy(&header, block, sizeof(header));
+            if (header.magic == AURORAFS_DEDUP_MAGIC) {
+                aurorafs_free_blocks(mount, old, header.blocks);
+            }
+        }
+        kfree(block);
+        mount->superblock->dedup_table_inode = 0;
+    }
+
+    spinlock_acquire(&idx->lock);
+    idx->dirty = 0;
+    uint64_t entries = idx->stats.entries;
+    uint64_t blocks = 1 + (entries + AURORAFS_DEDUP_PER_BLOCK - 1) / AURORAFS_DEDUP_PER_BLOCK;
+    uint8_t* table = (uint8_t*)kmalloc((size_t)blocks * AURORAFS_BLOCK_SIZE);
+    if (!table) {
+        spinlock_release(&idx->lock);
+        return -1;
+    }
+    dd_memset(table, 0, (size_t)blocks * AURORAFS_BLOCK_SIZE);
+
+    uint64_t e = 0;
+    for (uint32_t i = 0; i < idx->used; i++) {
+        const dedup_node_t* node = &idx->nodes[i];
+        if (!node->refcount) {
+            continue;
+        }
+        aurorafs_dedup_entry_t entry;
+        dd_memcpy(entry.hash, node->hash, AURORAFS_HASH_SIZE);
+        entry.physical_block = node->physical_block;
+        entry.refcount = node->refcount;
+        entry.compressed_size = node->compressed_size;
+        entry.next_entry = 0;
+        uint8_t* slot = table + (1 + e / AURORAFS_DEDUP_PER_BLOCK) * AURORAFS_BLOCK_SIZE +
+                        (e % AURORAFS_DEDUP_PER_BLOCK) * sizeof(entry);
+        dd_memcpy(slot, &entry, sizeof(entry));
+        e++;
+    }
+    spinlock_release(&idx->lock);
+
+    aurorafs_dedup_header_t header;
+    header.magic = AURORAFS_DEDUP_MAGIC;
+    header.entry_size = sizeof(aurorafs_dedup_entry_t);
+    header.entries = entries;
+    header.blocks = blocks;
+    sha256(table + AURORAFS_BLOCK_SIZE, (size_t)(blocks - 1) * AURORAFS_BLOCK_SIZE, header.digest);
+    dd_memcpy(table, &header, sizeof(header));
+
+    uint64_t start;
+    int result = aurorafs_alloc_blocks(mount, blocks, &start);
+    if (result == 0) {
+        result = dev->write(dev->ctx, start, table, (uint32_t)blocks);
+        if (result == 0) {
+            mount->superblock->dedup_table_inode = start;
+        } else {
+            aurorafs_free_blocks(mount, start, blocks);
+        }
+    }
+    kfree(table);
+    return result;
+}
+
+/**
+ * Get dedup index statistics
+ */
+void aurorafs_dedup_get_stats(aurorafs_mount_t* mount, aurorafs_dedup_stats_t* stats) {
+    if (!stats) {
+        return;
+    }
+    if (!mount || !mount->dedup_hash_table) {
+        dd_memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    aurorafs_dedup_index_t* idx = (aurorafs_dedup_index_t*)mount->dedup_hash_table;
+    spinlock_acquire(&idx->lock);
+    *stats = idx->stats;
+    spinlock_release(&idx->lock);
+}
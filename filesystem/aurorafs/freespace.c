@@ -0,0 +1,596 @@
+/**
+ * Aurora OS - AuroraFS Free-Space Manager
+ *
+ * Free space is kept as extents of contiguous free blocks, each linked
+ * into two red-black trees: one ordered by first block, for finding the
+ * neighbours to merge with on free and the extent under an allocation
+ * goal, and one ordered by length then first block, for best-fit
+ * lookups. The trees are built from the on-disk bitmap at mount; the
+ * bitmap stays the persistent copy and is updated alongside them.
+ *
+ * Each CPU has a goal, the block after its last allocation, so parallel
+ * writers each grow their own run instead of interleaving. A CPU's first
+ * allocation takes the smallest free extent that fits. Once its goal is
+ * blocked the CPU is taken to be streaming, and it moves to the smallest
+ * extent with a window of room to grow, falling back to the smallest
+ * that fits. Either way it starts halfway along the extent when another
+ * CPU is about to grow into the front.
+ *
+ * Blocks may be reserved ahead of allocation, so that extents can be
+ * placed at writeback once their final size is known. The allocation
+ * then draws on the reservation under the same lock, so nobody else can
+ * take the blocks in between.
+ */
+
+#include "aurorafs.h"
+#include "../../kernel/memory/memory.h"
+#include "../../kernel/core/rbtree.h"
+#include "../../kernel/smp/smp.h"
+#include <stddef.h>
+
+#define FS_SPLIT_ALIGN      64      /* Split points fall on bitmap words */
+#define FS_SPARE_NODES      64      /* Nodes kept for reuse */
+#define FS_STREAM_WINDOW    1024    /* Room sought for a CPU whose goal is blocked */
+
+typedef struct fs_extent {
+    rb_node_t by_offset;
+    rb_node_t by_length;
+    uint64_t start;
+    uint64_t length;
+    struct fs_extent* next_spare;
+} fs_extent_t;
+
+typedef struct aurorafs_free_space {
+    rb_root_t by_offset;
+    rb_root_t by_length;
+    fs_extent_t* spare;             /* Freed nodes for reuse */
+    uint32_t spare_count;
+    uint64_t reserved;              /* Promised to delayed allocations */
+    uint64_t cpu_goal[MAX_CPUS];    /* Block after each CPU's last allocation, 0 if none */
+    aurorafs_freespace_stats_t stats;
+} aurorafs_free_space_t;
+
+/* ============================================================================
+ * BITMAP
+ * ============================================================================ */
+
+/* Set or clear count bits from start, a word at a time where it can */
+static void fs_bitmap_fill(uint64_t* bitmap, uint64_t start, uint64_t count, int set) {
+    uint64_t b = start;
+    uint64_t end = start + count;
+    while (b < end) {
+        uint64_t in = b & 63;
+        uint64_t n = 64 - in;
+        if (n > end - b) {
+            n = end - b;
+        }
+        uint64_t mask = (n == 64) ? ~0ull : ((1ull << n) - 1) << in;
+        if (set) {
+            bitmap[b / 64] |= mask;
+        } else {
+            bitmap[b / 64] &= ~mask;
+        }
+        b += n;
+    }
+}
+
+/* First block from b below end whose bit equals set, or end */
+static uint64_t fs_bitmap_next(const uint64_t* bitmap, uint64_t b, uint64_t end, int set) {
+    while (b < end) {
+        uint64_t word = bitmap[b / 64];
+        if (!set) {
+            word = ~word;
+        }
+        word &= ~0ull << (b & 63);
+        if (word) {
+            uint64_t found = (b & ~63ull) + (uint64_t)__builtin_ctzll(word);
+            return found < end ? found : end;
+        }
+        b = (b & ~63ull) + 64;
+    }
+    return end;
+}
+
+/* ============================================================================
+ * TREES
+ * ============================================================================ */
+
+static inline fs_extent_t* fs_offset_entry(rb_node_t* node) {
+    return node ? rb_entry(node, fs_extent_t, by_offset) : NULL;
+}
+
+static inline fs_extent_t* fs_length_entry(rb_node_t* node) {
+    return node ? rb_entry(node, fs_extent_t, by_length) : NULL;
+}
+
+static void fs_insert_offset(aurorafs_free_space_t* fs, fs_extent_t* ext) {
+    rb_node_t** link = &fs->by_offset.node;
+    rb_node_t* parent = NULL;
+    int leftmost = 1;
+    while (*link) {
+        parent = *link;
+        if (ext->start < fs_offset_entry(parent)->start) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = 0;
+        }
+    }
+    rb_insert(&fs->by_offset, &ext->by_offset, parent, link, leftmost);
+}
+
+static void fs_insert_length(aurorafs_free_space_t* fs, fs_extent_t* ext) {
+    rb_node_t** link = &fs->by_length.node;
+    rb_node_t* parent = NULL;
+    int leftmost = 1;
+    while (*link) {
+        parent = *link;
+        fs_extent_t* at = fs_length_entry(parent);
+        if (ext->length < at->length || (ext->length == at->length && ext->start < at->start)) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = 0;
+        }
+    }
+    rb_insert(&fs->by_length, &ext->by_length, parent, link, leftmost);
+}
+
+/* Free extent with the greatest start at or below block, or NULL */
+static fs_extent_t* fs_find_below(const aurorafs_free_space_t* fs, uint64_t block) {
+    rb_node_t* node = fs->by_offset.node;
+    fs_extent_t* best = NULL;
+    while (node) {
+        fs_extent_t* ext = fs_offset_entry(node);
+        if (ext->start <= block) {
+            best = ext;
+            node = node->right;
+        } else {
+            node = node->left;
+        }
+    }
+    return best;
+}
+
+/* Smallest free extent of at least count blocks, lowest first on ties */
+static fs_extent_t* fs_find_fit(const aurorafs_free_space_t* fs, uint64_t count) {
+    rb_node_t* node = fs->by_length.node;
+    fs_extent_t* best = NULL;
+    while (node) {
+        fs_extent_t* ext = fs_length_entry(node);
+        if (ext->length >= count) {
+            best = ext;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return best;
+}
+
+static fs_extent_t* fs_node_get(aurorafs_free_space_t* fs) {
+    fs_extent_t* ext = fs->spare;
+    if (ext) {
+        fs->spare = ext->next_spare;
+        fs->spare_count--;
+        return ext;
+    }
+    return (fs_extent_t*)kmalloc(sizeof(fs_extent_t));
+}
+
+static void fs_node_put(aurorafs_free_space_t* fs, fs_extent_t* ext) {
+    if (fs->spare_count < FS_SPARE_NODES) {
+        ext->next_spare = fs->spare;
+        fs->spare = ext;
+        fs->spare_count++;
+    } else {
+        kfree(ext);
+    }
+}
+
+static void fs_remove(aurorafs_free_space_t* fs, fs_extent_t* ext) {
+    rb_erase(&fs->by_offset, &ext->by_offset);
+    rb_erase(&fs->by_length, &ext->by_length);
+    fs->stats.extents--;
+    fs_node_put(fs, ext);
+}
+
+static int fs_add(aurorafs_free_space_t* fs, uint64_t start, uint64_t length) {
+    fs_extent_t* ext = fs_node_get(fs);
+    if (!ext) {
+        return -1;
+    }
+    ext->start = start;
+    ext->length = length;
+    fs_insert_offset(fs, ext);
+    fs_insert_length(fs, ext);
+    fs->stats.extents++;
+    return 0;
+}
+
+/* Resize an extent in place; its place by offset cannot change */
+static void fs_resize(aurorafs_free_space_t* fs, fs_extent_t* ext, uint64_t start, uint64_t length) {
+    rb_erase(&fs->by_length, &ext->by_length);
+    ext->start = start;
+    ext->length = length;
+    fs_insert_length(fs, ext);
+}
+
+/* Take [at, at + count) out of a free extent that holds it */
+static int fs_take(aurorafs_free_space_t* fs, fs_extent_t* ext, uint64_t at, uint64_t count) {
+    uint64_t head = at - ext->start;
+    uint64_t tail = ext->start + ext->length - (at + count);
+
+    if (head && tail) {
+        if (fs_add(fs, at + count, tail) != 0) {
+            return -1;
+        }
+        fs_resize(fs, ext, ext->start, head);
+    } else if (head) {
+        fs_resize(fs, ext, ext->start, head);
+    } else if (tail) {
+        fs_resize(fs, ext, at + count, tail);
+    } else {
+        fs_remove(fs, ext);
+    }
+    return 0;
+}
+
+/* Where in ext a new stream of count blocks should start */
+static uint64_t fs_place(const aurorafs_free_space_t* fs, const fs_extent_t* ext,
+                         uint64_t count, uint32_t cpu) {
+    uint64_t half = (ext->length / 2) & ~(uint64_t)(FS_SPLIT_ALIGN - 1);
+    if (half < count || ext->length - half < count) {
+        return ext->start;
+    }
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        if (i != cpu && fs->cpu_goal[i] == ext->start) {
+            return ext->start + half;
+        }
+    }
+    return ext->start;
+}
+
+static inline aurorafs_free_space_t* fs_of(aurorafs_mount_t* mount) {
+    return mount ? (aurorafs_free_space_t*)mount->free_space : NULL;
+}
+
+/* ============================================================================
+ * ALLOCATION
+ * ============================================================================ */
+
+/**
+ * Allocate count contiguous blocks: at this CPU's goal if the free
+ * extent there is long enough, else best fit, for a whole stream window
+ * first if the CPU had a goal. Called with the lock held; the caller has
+ * checked there are enough blocks not reserved.
+ */
+static int fs_alloc_locked(aurorafs_mount_t* mount, aurorafs_free_space_t* fs,
+                           uint64_t count, uint64_t* start) {
+    uint32_t cpu = smp_get_current_cpu_id() % MAX_CPUS;
+    uint64_t goal = fs->cpu_goal[cpu];
+    fs_extent_t* ext = goal ? fs_find_below(fs, goal) : NULL;
+    uint64_t at = goal;
+
+    if (ext && ext->start + ext->length >= goal + count) {
+        fs->stats.goal_allocs++;
+    } else {
+        ext = NULL;
+        if (goal && count < FS_STREAM_WINDOW) {
+            ext = fs_find_fit(fs, FS_STREAM_WINDOW);
+        }
+        if (!ext) {
+            ext = fs_find_fit(fs, count);
+        }
+        if (ext) {
+            at = fs_place(fs, ext, count, cpu);
+            fs->stats.best_fit_allocs++;
+        }
+    }
+
+    if (!ext || fs_take(fs, ext, at, count) != 0) {
+        return -1;
+    }
+    fs_bitmap_fill(mount->block_bitmap, at, count, 1);
+    mount->superblock->free_blocks -= count;
+    fs->cpu_goal[cpu] = (at + count < mount->superblock->total_blocks) ? at + count : 0;
+    *start = at;
+    return 0;
+}
+
+/**
+ * Allocate count contiguous blocks from the space nobody has reserved
+ */
+int aurorafs_alloc_blocks(aurorafs_mount_t* mount, uint64_t count, uint64_t* start) {
+    aurorafs_free_space_t* fs = fs_of(mount);
+    if (!fs || !start || count == 0) {
+        return -1;
+    }
+
+    int result = -1;
+    spinlock_acquire(&mount->alloc_lock);
+    if (count <= mount->superblock->free_blocks - fs->reserved) {
+        result = fs_alloc_locked(mount, fs, count, start);
+    }
+    spinlock_release(&mount->alloc_lock);
+
+    return result;
+}
+
+/**
+ * Allocate count contiguous blocks in place of a reservation of
+ * reserved blocks. The reservation counts toward the allocation and is
+ * released whole once it succeeds, any excess included; on failure it
+ * is still held.
+ */
+int aurorafs_alloc_reserved(aurorafs_mount_t* mount, uint64_t count, uint64_t reserved,
+                            uint64_t* start) {
+    aurorafs_free_space_t* fs = fs_of(mount);
+    if (!fs || !start || count == 0) {
+        return -1;
+    }
+
+    int result = -1;
+    spinlock_acquire(&mount->alloc_lock);
+    uint64_t held = (reserved < fs->reserved) ? reserved : fs->reserved;
+    if (count <= mount->superblock->free_blocks - fs->reserved + held) {
+        result = fs_alloc_locked(mount, fs, count, start);
+    }
+    if (result == 0) {
+        fs->reserved -= held;
+    }
+    spinlock_release(&mount->alloc_lock);
+
+    return result;
+}
+
+/**
+ * Return blocks, merging them with the free extents on either side.
+ * Fails without freeing anything if any of them is metadata or already
+ * free.
+ */
+int aurorafs_free_blocks(aurorafs_mount_t* mount, uint64_t start, uint64_t count) {
+    aurorafs_free_space_t* fs = fs_of(mount);
+    if (!fs) {
+        return -1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    spinlock_acquire(&mount->alloc_lock);
+    int result = 0;
+    uint64_t end = start + count;
+    fs_extent_t* prev = NULL;
+    if (start < mount->data_start || count > mount->superblock->total_blocks - start) {
+        result = -1;
+    } else {
+        /* The last free extent starting inside or before the range must
+         * end before it does */
+        prev = fs_find_below(fs, end - 1);
+        if (prev && prev->start + prev->length > start) {
+            result = -1;
+        }
+    }
+
+    if (result == 0) {
+        rb_node_t* after = prev ? rb_next(&prev->by_offset) : rb_first(&fs->by_offset);
+        fs_extent_t* next = fs_offset_entry(after);
+        int join_prev = prev && prev->start + prev->length == start;
+        int join_next = next && next->start == end;
+
+        if (join_prev && join_next) {
+            uint64_t length = prev->length + count + next->length;
+            fs_remove(fs, next);
+            fs_resize(fs, prev, prev->start, length);
+            fs->stats.merges++;
+        } else if (join_prev) {
+            fs_resize(fs, prev, prev->start, prev->length + count);
+            fs->stats.merges++;
+        } else if (join_next) {
+            fs_resize(fs, next, start, next->length + count);
+            fs->stats.merges++;
+        } else {
+            result = fs_add(fs, start, count);
+        }
+    }
+
+    if (result == 0) {
+        fs_bitmap_fill(mount->block_bitmap, start, count, 0);
+        mount->superblock->free_blocks += count;
+    }
+    spinlock_release(&mount->alloc_lock);
+
+    return result;
+}
+
+/**
+ * Set blocks aside for a later allocation, without choosing them
+ */
+int aurorafs_reserve_blocks(aurorafs_mount_t* mount, uint64_t count) {
+    aurorafs_free_space_t* fs = fs_of(mount);
+    if (!fs) {
+        return -1;
+    }
+
+    spinlock_acquire(&mount->alloc_lock);
+    int result = -1;
+    if (count <= mount->superblock->free_blocks - fs->reserved) {
+        fs->reserved += count;
+        result = 0;
+    }
+    spinlock_release(&mount->alloc_lock);
+
+    return result;
+}
+
+/**
+ * Give back a reservation that will not be allocated
+ */
+void aurorafs_unreserve_blocks(aurorafs_mount_t* mount, uint64_t count) {
+    aurorafs_free_space_t* fs = fs_of(mount);
+    if (!fs) {
+        return;
+    }
+
+    spinlock_acquire(&mount->alloc_lock);
+    fs->reserved -= (count < fs->reserved) ? count : fs->reserved;
+    spinlock_release(&mount->alloc_lock);
+}
+
+/* ============================================================================
+ * SETUP
+ * ============================================================================ */
+
+/**
+ * Build the free-space trees from the mounted bitmap
+ */
+int aurorafs_freespace_create(aurorafs_mount_t* mount) {
+    if (!mount || !mount->block_bitmap || mount->free_space) {
+        return -1;
+    }
+
+    aurorafs_free_space_t* fs = (aurorafs_free_space_t*)kmalloc(sizeof(aurorafs_free_space_t));
+    if (!fs) {
+        return -1;
+    }
+    rb_init(&fs->by_offset);
+    rb_init(&fs->by_length);
+    fs->spare = NULL;
+    fs->spare_count = 0;
+    fs->reserved = 0;
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        fs->cpu_goal[i] = 0;
+    }
+    fs->stats = (aurorafs_freespace_stats_t){0};
+    mount->free_space = fs;
+
+    uint64_t total = mount->superblock->total_blocks;
+    uint64_t free_blocks = 0;
+    uint64_t b = fs_bitmap_next(mount->block_bitmap, mount->data_start, total, 0);
+    while (b < total) {
+        uint64_t end = fs_bitmap_next(mount->block_bitmap, b, total, 1);
+        if (fs_add(fs, b, end - b) != 0) {
+            aurorafs_freespace_destroy(mount);
+            return -1;
+        }
+        free_blocks += end - b;
+        b = fs_bitmap_next(mount->block_bitmap, end, total, 0);
+    }
+
+    /* The bitmap is what the blocks were allocated from */
+    mount->superblock->free_blocks = free_blocks;
+    return 0;
+}
+
+void aurorafs_freespace_destroy(aurorafs_mount_t* mount) {
+    aurorafs_free_space_t* fs = fs_of(mount);
+    if (!fs) {
+        return;
+    }
+
+    /* Post-order, so no node is visited after its children are freed */
+    rb_node_t* node = fs->by_offset.node;
+    while (node) {
+        if (node->left) {
+            node = node->left;
+        } else if (node->right) {
+            node = node->right;
+        } else {
+            rb_node_t* parent = node->parent;
+            if (parent) {
+                if (parent->left == node) {
+                    parent->left = NULL;
+                } else {
+                    parent->right = NULL;
+                }
+            }
+            kfree(fs_offset_entry(node));
+            node = parent;
+        }
+    }
+    while (fs->spare) {
+        fs_extent_t* ext = fs->spare;
+        fs->spare = ext->next_spare;
+        kfree(ext);
+    }
+    kfree(fs);
+    mount->free_space = NULL;
+}
+
+/**
+ * Snapshot of the free-space counters
+ */
+void aurorafs_freespace_get_stats(aurorafs_mount_t* mount, aurorafs_freespace_stats_t* stats) {
+    aurorafs_free_space_t* fs = fs_of(mount);
+    if (!stats) {
+        return;
+    }
+    *stats = (aurorafs_freespace_stats_t){0};
+    if (!fs) {
+        return;
+    }
+
+    spinlock_acquire(&mount->alloc_lock);
+    *stats = fs->stats;
+    stats->free_blocks = mount->superblock->free_blocks;
+    stats->reserved_blocks = fs->reserved;
+    rb_node_t* last = rb_last(&fs->by_length);
+    stats->largest = last ? fs_length_entry(last)->length : 0;
+    spinlock_release(&mount->alloc_lock);
+}
+
+/**
+ * Check the trees against each other and the bitmap. Returns 0 if they
+ * agree: extents sorted, disjoint, never adjacent, all free in the bitmap
+ * with allocated blocks between them, and summing to free_blocks.
+ */
+int aurorafs_freespace_verify(aurorafs_mount_t* mount) {
+    aurorafs_free_space_t* fs = fs_of(mount);
+    if (!fs) {
+        return -1;
+    }
+
+    spinlock_acquire(&mount->alloc_lock);
+    int result = 0;
+    uint64_t total = 0;
+    uint64_t count = 0;
+    uint64_t prev_end = mount->data_start;
+    for (rb_node_t* node = rb_first(&fs->by_offset); node && result == 0; node = rb_next(node)) {
+        fs_extent_t* ext = fs_offset_entry(node);
+        if (!ext->length || ext->start < prev_end || (count && ext->start == prev_end) ||
+            fs_bitmap_next(mount->block_bitmap, prev_end, ext->start, 0) != ext->start ||
+            fs_bitmap_next(mount->block_bitmap, ext->start, ext->start + ext->length, 1) !=
+                ext->start + ext->length) {
+            result = -1;
+        }
+        prev_end = ext->start + ext->length;
+        total += ext->length;
+        count++;
+    }
+    if (result == 0 && fs_bitmap_next(mount->block_bitmap, prev_end,
+                                      mount->superblock->total_blocks, 0) !=
+                       mount->superblock->total_blocks) {
+        result = -1;
+    }
+
+    uint64_t length_count = 0;
+    fs_extent_t* last = NULL;
+    for (rb_node_t* node = rb_first(&fs->by_length); node && result == 0; node = rb_next(node)) {
+        fs_extent_t* ext = fs_length_entry(node);
+        if (last && (ext->length < last->length ||
+                     (ext->length == last->length && ext->start <= last->start))) {
+            result = -1;
+        }
+        last = ext;
+        length_count++;
+    }
+
+    if (total != mount->superblock->free_blocks || count != length_count ||
+        count != fs->stats.extents) {
+        result = -1;
+    }
+    spinlock_release(&mount->alloc_lock);
+
+    return result;
+}
@@ -0,0 +1,436 @@
+/**
+ * Aurora OS - Dentry Cache Implementation
+ *
+ * One lock covers the hash table, the LRU list and every reference
+ * count. Freeing a dentry drops its reference on the parent, which may
+ * free the parent in turn if it was already dropped; freed dentries are
+ * chained through hash_next and released after the lock is dropped.
+ */
+
+#include "dcache.h"
+#include "../../kernel/memory/memory.h"
+#include "../../kernel/smp/spinlock.h"
+#include <stddef.h>
+
+static spinlock_t dcache_lock;
+static dentry_t** hash_table = NULL;
+static dentry_t* lru_head = NULL;          /* Most recently unused */
+static dentry_t* lru_tail = NULL;
+static dentry_t* root_dentry = NULL;
+static dcache_stats_t dcache_stats;
+
+/**
+ * FNV-1a over the name, mixed with the parent's address so equal names
+ * in different directories spread out
+ */
+static uint32_t name_hash(const dentry_t* parent, const char* name, uint32_t len) {
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    hash ^= (uint32_t)((uintptr_t)parent >> 4) * 0x9E3779B1u;
+    return hash;
+}
+
+static inline uint32_t hash_bucket(uint32_t hash) {
+    return (hash * 0x9E3779B1u) >> (32 - DCACHE_HASH_BITS);
+}
+
+static int name_equal(const dentry_t* dentry, const char* name, uint32_t len) {
+    if (dentry->name_len != len) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        if (dentry->name[i] != name[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* ---- LRU list and hash chains, dcache_lock held ---- */
+
+static void lru_unlink(dentry_t* dentry) {
+    if (dentry->lru_prev) {
+        dentry->lru_prev->lru_next = dentry->lru_next;
+    } else {
+        lru_head = dentry->lru_next;
+    }
+    if (dentry->lru_next) {
+        dentry->lru_next->lru_prev = dentry->lru_prev;
+    } else {
+        lru_tail = dentry->lru_prev;
+    }
+    dentry->lru_prev = NULL;
+    dentry->lru_next = NULL;
+}
+
+static void lru_push_front(dentry_t* dentry) {
+    dentry->lru_prev = NULL;
+    dentry->lru_next = lru_head;
+    if (lru_head) {
+        lru_head->lru_prev = dentry;
+    } else {
+        lru_tail = dentry;
+    }
+    lru_head = dentry;
+}
+
+static void unhash(dentry_t* dentry) {
+    dentry_t** link = &hash_table[hash_bucket(dentry->hash)];
+    while (*link && *link != dentry) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = dentry->hash_next;
+    }
+    dentry->hash_next = NULL;
+    dentry->flags &= ~DCACHE_HASHED;
+}
+
+static dentry_t* find_locked(dentry_t* parent, const char* name, uint32_t len, uint32_t hash) {
+    dentry_t* dentry = hash_table[hash_bucket(hash)];
+    while (dentry) {
+        if (dentry->hash == hash && dentry->parent == parent && name_equal(dentry, name, len)) {
+            return dentry;
+        }
+        dentry = dentry->hash_next;
+    }
+    return NULL;
+}
+
+static void get_locked(dentry_t* dentry) {
+    if (dentry->refcount++ == 0 && (dentry->flags & DCACHE_HASHED)) {
+        lru_unlink(dentry);
+    }
+}
+
+/**
+ * Retire an unused, unhashed dentry and release its parent
+ * Victims are chained through hash_next for freeing after unlock.
+ */
+static void release_locked(dentry_t* dentry, dentry_t** victims) {
+    while (dentry) {
+        dentry_t* parent = dentry->parent;
+
+        dentry->hash_next = *victims;
+        *victims = dentry;
+        dcache_stats.dentries--;
+        if (!dentry->inode) {
+            dcache_stats.negative--;
+        }
+
+        if (parent == dentry || --parent->refcount > 0) {
+            break;
+        }
+        if (parent->flags & DCACHE_HASHED) {
+            lru_push_front(parent);
+            break;
+        }
+        dentry = parent;
+    }
+}
+
+static void put_locked(dentry_t* dentry, dentry_t** victims) {
+    if (--dentry->refcount > 0) {
+        return;
+    }
+    if (dentry->flags & DCACHE_HASHED) {
+        lru_push_front(dentry);
+    } else {
+        release_locked(dentry, victims);
+    }
+}
+
+/**
+ * Free up to nr unused dentries from the cold end of the LRU
+ */
+static uint32_t reclaim_locked(uint32_t nr, dentry_t** victims) {
+    uint32_t freed = 0;
+
+    while (lru_tail && freed < nr) {
+        dentry_t* dentry = lru_tail;
+        lru_unlink(dentry);
+        unhash(dentry);
+        release_locked(dentry, victims);
+        dcache_stats.evictions++;
+        freed++;
+    }
+    return freed;
+}
+
+static void free_victims(dentry_t* victims) {
+    while (victims) {
+        dentry_t* next = victims->hash_next;
+        kfree(victims);
+        victims = next;
+    }
+}
+
+static dentry_t* dentry_alloc(dentry_t* parent, const char* name, uint32_t len, struct inode* inode) {
+    dentry_t* dentry = (dentry_t*)kmalloc(sizeof(dentry_t));
+    if (!dentry) {
+        return NULL;
+    }
+    dentry->parent = parent ? parent : dentry;
+    dentry->inode = inode;
+    dentry->hash = name_hash(parent, name, len);
+    dentry->refcount = 1;
+    dentry->flags = 0;
+    dentry->name_len = len;
+    for (uint32_t i = 0; i < len; i++) {
+        dentry->name[i] = name[i];
+    }
+    dentry->name[len] = '\0';
+    dentry->hash_next = NULL;
+    dentry->lru_prev = NULL;
+    dentry->lru_next = NULL;
+    return dentry;
+}
+
+/* ---- Public interface ---- */
+
+int dcache_init(uint32_t max_dentries) {
+    if (hash_table) {
+        /* Re-initialization: forget the old tree first */
+        dcache_set_root(NULL);
+    } else {
+        spinlock_init(&dcache_lock);
+        hash_table = (dentry_t**)kmalloc(DCACHE_HASH_SIZE * sizeof(dentry_t*));
+        if (!hash_table) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < DCACHE_HASH_SIZE; i++) {
+            hash_table[i] = NULL;
+        }
+        dcache_stats.dentries = 0;
+        dcache_stats.negative = 0;
+    }
+
+    dcache_stats.lookups = 0;
+    dcache_stats.hits = 0;
+    dcache_stats.negative_hits = 0;
+    dcache_stats.misses = 0;
+    dcache_stats.evictions = 0;
+    dcache_stats.drops = 0;
+    dcache_stats.max_dentries = max_dentries ? max_dentries : DCACHE_DEFAULT_MAX_DENTRIES;
+    return 0;
+}
+
+void dcache_set_limit(uint32_t max_dentries) {
+    dentry_t* victims = NULL;
+
+    if (max_dentries == 0 || !hash_table) {
+        return;
+    }
+
+    spinlock_acquire(&dcache_lock);
+    dcache_stats.max_dentries = max_dentries;
+    if (dcache_stats.dentries > max_dentries) {
+        reclaim_locked(dcache_stats.dentries - max_dentries, &victims);
+    }
+    spinlock_release(&dcache_lock);
+
+    free_victims(victims);
+}
+
+void dcache_set_root(struct inode* root) {
+    dentry_t* victims = NULL;
+
+    if (!hash_table) {
+        return;
+    }
+
+    dentry_t* new_root = root ? dentry_alloc(NULL, "/", 1, root) : NULL;
+
+    spinlock_acquire(&dcache_lock);
+
+    /* Make everything unreachable, then free what nobody is using;
+     * dentries still in use go when their last user puts them */
+    for (uint32_t i = 0; i < DCACHE_HASH_SIZE; i++) {
+        dentry_t* dentry = hash_table[i];
+        while (dentry) {
+            dentry_t* next = dentry->hash_next;
+            dentry->hash_next = NULL;
+            dentry->flags &= ~DCACHE_HASHED;
+            dentry = next;
+        }
+        hash_table[i] = NULL;
+    }
+    while (lru_head) {
+        dentry_t* dentry = lru_head;
+        lru_unlink(dentry);
+        release_locked(dentry, &victims);
+    }
+    if (root_dentry) {
+        root_dentry->flags &= ~DCACHE_HASHED;
+        put_locked(root_dentry, &victims);
+    }
+
+    /* The cache's own reference keeps the root */
+    root_dentry = new_root;
+    if (new_root) {
+        new_root->flags = DCACHE_HASHED;
+        dcache_stats.dentries++;
+    }
+
+    spinlock_release(&dcache_lock);
+
+    free_victims(victims);
+}
+
+dentry_t* dcache_root(void) {
+    dentry_t* root = NULL;
+
+    if (!hash_table) {
+        return NULL;
+    }
+
+    spinlock_acquire(&dcache_lock);
+    if (root_dentry) {
+        get_locked(root_dentry);
+        root = root_dentry;
+    }
+    spinlock_release(&dcache_lock);
+    return root;
+}
+
+dentry_t* dget(dentry_t* dentry) {
+    if (!dentry) {
+        return NULL;
+    }
+    spinlock_acquire(&dcache_lock);
+    get_locked(dentry);
+    spinlock_release(&dcache_lock);
+    return dentry;
+}
+
+void dput(dentry_t* dentry) {
+    dentry_t* victims = NULL;
+
+    if (!dentry) {
+        return;
+    }
+    spinlock_acquire(&dcache_lock);
+    put_locked(dentry, &victims);
+    spinlock_release(&dcache_lock);
+
+    free_victims(victims);
+}
+
+dentry_t* dcache_lookup(dentry_t* parent, const char* name, uint32_t len) {
+    if (!parent || !name || len > DCACHE_NAME_MAX) {
+        return NULL;
+    }
+
+    uint32_t hash = name_hash(parent, name, len);
+
+    spinlock_acquire(&dcache_lock);
+    dcache_stats.lookups++;
+    dentry_t* dentry = find_locked(parent, name, len, hash);
+    if (dentry) {
+        get_locked(dentry);
+        dcache_stats.hits++;
+        if (!dentry->inode) {
+            dcache_stats.negative_hits++;
+        }
+    } else {
+        dcache_stats.misses++;
+    }
+    spinlock_release(&dcache_lock);
+    return dentry;
+}
+
+dentry_t* dcache_add(dentry_t* parent, const char* name, uint32_t len, struct inode* inode) {
+    dentry_t* victims = NULL;
+
+    if (!parent || !name || len == 0 || len > DCACHE_NAME_MAX) {
+        return NULL;
+    }
+
+    dentry_t* dentry = dentry_alloc(parent, name, len, inode);
+    if (!dentry) {
+        return NULL;
+    }
+
+    spinlock_acquire(&dcache_lock);
+
+    dentry_t* existing = find_locked(parent, name, len, dentry->hash);
+    if (existing) {
+        /* Another walk cached it first */
+        get_locked(existing);
+        spinlock_release(&dcache_lock);
+        kfree(dentry);
+        return existing;
+    }
+
+    if (dcache_stats.dentries >= dcache_stats.max_dentries) {
+        reclaim_locked(dcache_stats.dentries - dcache_stats.max_dentries + 1, &victims);
+    }
+
+    get_locked(parent);
+    dcache_stats.dentries++;
+    if (!inode) {
+        dcache_stats.negative++;
+    }
+
+    /* Children of a dropped directory stay unreachable too */
+    if (parent->flags & DCACHE_HASHED) {
+        uint32_t bucket = hash_bucket(dentry->hash);
+        dentry->hash_next = hash_table[bucket];
+        hash_table[bucket] = dentry;
+        dentry->flags |= DCACHE_HASHED;
+    }
+
+    spinlock_release(&dcache_lock);
+
+    free_victims(victims);
+    return dentry;
+}
+
+void dcache_drop(dentry_t* dentry) {
+    dentry_t* victims = NULL;
+
+    if (!dentry || dentry == root_dentry) {
+        return;
+    }
+
+    spinlock_acquire(&dcache_lock);
+    if (dentry->flags & DCACHE_HASHED) {
+        unhash(dentry);
+        dcache_stats.drops++;
+        if (dentry->refcount == 0) {
+            lru_unlink(dentry);
+            release_locked(dentry, &victims);
+        }
+    }
+    spinlock_release(&dcache_lock);
+
+    free_victims(victims);
+}
+
+uint32_t dcache_shrink(uint32_t nr) {
+    dentry_t* victims = NULL;
+
+    if (!hash_table) {
+        return 0;
+    }
+
+    spinlock_acquire(&dcache_lock);
+    uint32_t freed = reclaim_locked(nr, &victims);
+    spinlock_release(&dcache_lock);
+
+    free_victims(victims);
+    return freed;
+}
+
+void dcache_get_stats(dcache_stats_t* stats) {
+    if (!stats || !hash_table) {
+        return;
+    }
+
+    spinlock_acquire(&dcache_lock);
+    *stats = dcache_stats;
+    spinlock_release(&dcache_lock);
+}
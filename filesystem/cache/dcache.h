@@ -0,0 +1,120 @@
+/**
+ * Aurora OS - Dentry Cache Header
+ *
+ * Caches the results of path component lookups so resolving a path costs
+ * one hash probe per component instead of a filesystem search. Dentries
+ * are keyed by (parent dentry, name) in one hash table; a dentry whose
+ * inode is NULL is negative and records that the name does not exist.
+ * Each dentry holds a reference on its parent, so a cached path keeps
+ * its ancestors. Unused dentries sit on an LRU list and are freed from
+ * the cold end when the cache reaches its limit or on request under
+ * memory pressure. Namespace changes drop the affected dentries from the
+ * hash; dropped dentries are freed once their last user lets go.
+ */
+
+#ifndef AURORA_DCACHE_H
+#define AURORA_DCACHE_H
+
+#include <stdint.h>
+
+#define DCACHE_NAME_MAX             63
+#define DCACHE_HASH_BITS            14
+#define DCACHE_HASH_SIZE            (1u << DCACHE_HASH_BITS)
+#define DCACHE_DEFAULT_MAX_DENTRIES 4096
+
+/* Dentry flags */
+#define DCACHE_HASHED   0x01        /* Reachable by lookup */
+
+struct inode;
+
+typedef struct dentry {
+    struct dentry* parent;          /* Referenced; the root is its own parent */
+    struct inode* inode;            /* NULL for a negative dentry */
+    uint32_t hash;                  /* Name hash mixed with the parent */
+    uint32_t refcount;              /* Users and child dentries */
+    uint32_t flags;
+    uint32_t name_len;
+    char name[DCACHE_NAME_MAX + 1];
+    struct dentry* hash_next;
+    struct dentry* lru_prev;        /* On the LRU while refcount is 0 */
+    struct dentry* lru_next;
+} dentry_t;
+
+typedef struct {
+    uint64_t lookups;
+    uint64_t hits;                  /* Including negative hits */
+    uint64_t negative_hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t drops;                 /* Invalidated by namespace changes */
+    uint32_t dentries;              /* Allocated now, including dropped ones in use */
+    uint32_t negative;
+    uint32_t max_dentries;
+} dcache_stats_t;
+
+/**
+ * Initialize the dentry cache
+ * @param max_dentries Dentries held before LRU reclaim starts
+ * @return 0 on success, -1 if the hash table cannot be allocated
+ */
+int dcache_init(uint32_t max_dentries);
+
+/**
+ * Change the cache size limit, reclaiming down to it
+ */
+void dcache_set_limit(uint32_t max_dentries);
+
+/**
+ * Drop every cached path and start a new tree at a root inode
+ * (NULL just empties the cache)
+ */
+void dcache_set_root(struct inode* root);
+
+/**
+ * Get a reference to the root dentry
+ * @return Root, or NULL if there is none
+ */
+dentry_t* dcache_root(void);
+
+/**
+ * Take another reference to a dentry
+ */
+dentry_t* dget(dentry_t* dentry);
+
+/**
+ * Drop a reference; unused dentries go on the LRU, dropped ones are freed
+ */
+void dput(dentry_t* dentry);
+
+/**
+ * Find a cached child of a directory dentry
+ * @return Referenced dentry (possibly negative), or NULL if not cached
+ */
+dentry_t* dcache_lookup(dentry_t* parent, const char* name, uint32_t len);
+
+/**
+ * Cache the result of a filesystem lookup
+ * @param inode Inode found, or NULL to cache a negative entry
+ * @return Referenced dentry (an existing one if another lookup won the
+ *         race), or NULL if the name is too long or out of memory
+ */
+dentry_t* dcache_add(dentry_t* parent, const char* name, uint32_t len, struct inode* inode);
+
+/**
+ * Make a dentry unreachable by lookup; its cached descendants can no
+ * longer be reached either and age out of the LRU
+ */
+void dcache_drop(dentry_t* dentry);
+
+/**
+ * Free least recently used unused dentries
+ * @return Dentries freed
+ */
+uint32_t dcache_shrink(uint32_t nr);
+
+/**
+ * Get dentry cache statistics
+ */
+void dcache_get_stats(dcache_stats_t* stats);
+
+#endif /* AURORA_DCACHE_H */
@@ -0,0 +1,1046 @@
+/**
+ * Aurora OS - Page Cache Implementation
+ *
+ * One lock covers every address space and the LRU list; it is dropped
+ * around filesystem readpage/writepage calls and data copies, during
+ * which the page is pinned so reclaim leaves it alone. A page that loses
+ * an insertion race is freed and the winner used instead.
+ *
+ * Readahead follows the on-demand scheme: the state of the open file
+ * says where its current window starts, how big it is and how much of
+ * it was read ahead of demand. The first of those pages carries
+ * PG_READAHEAD; a reader reaching it moves the window forward and
+ * doubles it. Windows are read in runs of consecutive missing pages,
+ * each run one filesystem request.
+ *
+ * Dirty pages sit on a list in their address space, and address spaces
+ * with dirty pages on their device's list in the order they were first
+ * dirtied. Writeback takes a batch of pages off those lists, marking
+ * them PG_WRITEBACK and pinning them, sorts the batch by device block
+ * (the filesystem's bmap, or file and page number without one) and
+ * writes it with the lock dropped. A page dirtied again meanwhile stays
+ * dirty, and a page already in flight is not taken a second time, so two
+ * writes of one page never overlap. A failed write re-dirties the page
+ * and is reported by the next fsync of the file.
+ *
+ * fsync and truncation wait for pages in flight on writeback_waiters,
+ * woken whenever a file's last page in flight completes. Truncation
+ * waits for pages it can't drop because they are being written, so once
+ * unlink has truncated a file nothing is left calling its writepage.
+ */
+
+#include "page_cache.h"
+#include "writeback.h"
+#include "../vfs/vfs.h"
+#include "../../kernel/memory/memory.h"
+#include "../../kernel/smp/spinlock.h"
+#ifndef AURORA_STANDALONE
+#include "../../kernel/process/wait.h"
+#endif
+#include <stddef.h>
+
+static spinlock_t cache_lock;
+#ifndef AURORA_STANDALONE
+static wait_queue_t writeback_waiters;
+#endif
+static cached_page_t* lru_head = NULL;     /* Most recently used */
+static cached_page_t* lru_tail = NULL;
+static page_cache_stats_t cache_stats;
+static uint32_t ra_max_pages = PAGE_CACHE_RA_DEFAULT_MAX;
+
+#define RA_NO_MARK  0xFFFFFFFF
+
+/* A page queued for writeback with its sort key */
+typedef struct {
+    uint64_t key;
+    cached_page_t* page;
+} wb_entry_t;
+
+static void pc_memcpy(void* dest, const void* src, size_t size) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+    for (size_t i = 0; i < size; i++) {
+        d[i] = s[i];
+    }
+}
+
+static void pc_memset(void* dest, uint8_t value, size_t size) {
+    uint8_t* d = (uint8_t*)dest;
+    for (size_t i = 0; i < size; i++) {
+        d[i] = value;
+    }
+}
+
+/* ---- LRU list, cache_lock held ---- */
+
+static void lru_unlink(cached_page_t* page) {
+    if (page->lru_prev) {
+        page->lru_prev->lru_next = page->lru_next;
+    } else {
+        lru_head = page->lru_next;
+    }
+    if (page->lru_next) {
+        page->lru_next->lru_prev = page->lru_prev;
+    } else {
+        lru_tail = page->lru_prev;
+    }
+    page->lru_prev = NULL;
+    page->lru_next = NULL;
+}
+
+static void lru_push_front(cached_page_t* page) {
+    page->lru_prev = NULL;
+    page->lru_next = lru_head;
+    if (lru_head) {
+        lru_head->lru_prev = page;
+    } else {
+        lru_tail = page;
+    }
+    lru_head = page;
+}
+
+static void lru_touch(cached_page_t* page) {
+    if (lru_head != page) {
+        lru_unlink(page);
+        lru_push_front(page);
+    }
+}
+
+/* ---- Dirty lists, cache_lock held ---- */
+
+static void mark_dirty_locked(cached_page_t* page) {
+    address_space_t* mapping = page->mapping;
+    backing_dev_t* bdi = mapping->bdi;
+
+    if (page->flags & PG_DIRTY) {
+        return;
+    }
+    page->flags |= PG_DIRTY;
+
+    page->dirty_prev = NULL;
+    page->dirty_next = mapping->dirty;
+    if (mapping->dirty) {
+        mapping->dirty->dirty_prev = page;
+    }
+    mapping->dirty = page;
+
+    if (mapping->nrdirty++ == 0) {
+        /* First dirty page: the file joins the end of the device's list */
+        mapping->dirtied_when = bdi->now;
+        mapping->dirty_next = NULL;
+        mapping->dirty_prev = bdi->dirty_tail;
+        if (bdi->dirty_tail) {
+            bdi->dirty_tail->dirty_next = mapping;
+        } else {
+            bdi->dirty_head = mapping;
+        }
+        bdi->dirty_tail = mapping;
+    }
+    bdi->dirty_pages++;
+    cache_stats.dirty++;
+    cache_stats.dirtied++;
+}
+
+static void clear_dirty_locked(cached_page_t* page) {
+    address_space_t* mapping = page->mapping;
+    backing_dev_t* bdi = mapping->bdi;
+
+    if (!(page->flags & PG_DIRTY)) {
+        return;
+    }
+    page->flags &= ~PG_DIRTY;
+
+    if (page->dirty_prev) {
+        page->dirty_prev->dirty_next = page->dirty_next;
+    } else {
+        mapping->dirty = page->dirty_next;
+    }
+    if (page->dirty_next) {
+        page->dirty_next->dirty_prev = page->dirty_prev;
+    }
+    page->dirty_prev = NULL;
+    page->dirty_next = NULL;
+
+    if (--mapping->nrdirty == 0) {
+        if (mapping->dirty_prev) {
+            mapping->dirty_prev->dirty_next = mapping->dirty_next;
+        } else {
+            bdi->dirty_head = mapping->dirty_next;
+        }
+        if (mapping->dirty_next) {
+            mapping->dirty_next->dirty_prev = mapping->dirty_prev;
+        } else {
+            bdi->dirty_tail = mapping->dirty_prev;
+        }
+        mapping->dirty_prev = NULL;
+        mapping->dirty_next = NULL;
+    }
+    bdi->dirty_pages--;
+    cache_stats.dirty--;
+}
+
+/* ---- Page lifetime ---- */
+
+static cached_page_t* page_alloc(void) {
+    cached_page_t* page = (cached_page_t*)kmalloc(sizeof(cached_page_t));
+    if (!page) {
+        return NULL;
+    }
+    page->data = (uint8_t*)kmalloc(PAGE_CACHE_SIZE);
+    if (!page->data) {
+        kfree(page);
+        return NULL;
+    }
+    page->mapping = NULL;
+    page->index = 0;
+    page->flags = 0;
+    page->pins = 0;
+    page->lru_prev = NULL;
+    page->lru_next = NULL;
+    page->dirty_prev = NULL;
+    page->dirty_next = NULL;
+    return page;
+}
+
+static void page_free(cached_page_t* page) {
+    kfree(page->data);
+    kfree(page);
+}
+
+/**
+ * Take an unpinned page out of its address space and the LRU
+ * cache_lock held; the caller frees it after dropping the lock
+ */
+static void page_remove(cached_page_t* page) {
+    clear_dirty_locked(page);
+    radix_tree_delete(&page->mapping->pages, page->index);
+    page->mapping->nrpages--;
+    lru_unlink(page);
+    cache_stats.pages--;
+}
+
+/**
+ * Evict up to nr clean pages from the cold end of the LRU
+ * cache_lock held; victims are chained through lru_next for freeing
+ */
+static cached_page_t* reclaim_locked(uint32_t nr, uint32_t* freed) {
+    cached_page_t* victims = NULL;
+    cached_page_t* page = lru_tail;
+
+    *freed = 0;
+    while (page && *freed < nr) {
+        cached_page_t* prev = page->lru_prev;
+        if (page->pins == 0 && !(page->flags & PG_DIRTY)) {
+            page_remove(page);
+            page->lru_next = victims;
+            victims = page;
+            (*freed)++;
+            cache_stats.evictions++;
+        }
+        page = prev;
+    }
+    return victims;
+}
+
+static void free_victims(cached_page_t* victims) {
+    while (victims) {
+        cached_page_t* next = victims->lru_next;
+        page_free(victims);
+        victims = next;
+    }
+}
+
+/**
+ * Find a page and pin it, or create, fill and pin it
+ * @param fill Read the page from the filesystem if it is not cached;
+ *             otherwise a new page starts zeroed
+ * @return Pinned page, or NULL on error
+ */
+static cached_page_t* page_get(inode_t* inode, uint32_t index, int fill) {
+    address_space_t* mapping = &inode->mapping;
+
+    spinlock_acquire(&cache_lock);
+    cached_page_t* page = (cached_page_t*)radix_tree_lookup(&mapping->pages, index);
+    if (page) {
+        page->pins++;
+        lru_touch(page);
+        cache_stats.hits++;
+        spinlock_release(&cache_lock);
+        return page;
+    }
+    cache_stats.misses++;
+    spinlock_release(&cache_lock);
+
+    /* Build the page unlocked */
+    page = page_alloc();
+    if (!page) {
+        return NULL;
+    }
+    page->mapping = mapping;
+    page->index = index;
+
+    if (fill) {
+        if (!inode->fops || !inode->fops->readpage ||
+            inode->fops->readpage(inode, index, page->data) != 0) {
+            page_free(page);
+            return NULL;
+        }
+    } else {
+        pc_memset(page->data, 0, PAGE_CACHE_SIZE);
+    }
+    page->flags = PG_UPTODATE;
+    page->pins = 1;
+
+    cached_page_t* victims = NULL;
+    uint32_t freed = 0;
+
+    spinlock_acquire(&cache_lock);
+    if (fill) {
+        cache_stats.readpages++;
+        cache_stats.read_ios++;
+    }
+
+    cached_page_t* existing = (cached_page_t*)radix_tree_lookup(&mapping->pages, index);
+    if (existing) {
+        /* Someone else cached it first */
+        existing->pins++;
+        lru_touch(existing);
+        spinlock_release(&cache_lock);
+        page_free(page);
+        return existing;
+    }
+
+    if (cache_stats.pages >= cache_stats.max_pages) {
+        victims = reclaim_locked(cache_stats.pages - cache_stats.max_pages + 1, &freed);
+    }
+
+    if (radix_tree_insert(&mapping->pages, index, page) != 0) {
+        spinlock_release(&cache_lock);
+        free_victims(victims);
+        page_free(page);
+        return NULL;
+    }
+    mapping->nrpages++;
+    cache_stats.pages++;
+    lru_push_front(page);
+    spinlock_release(&cache_lock);
+
+    free_victims(victims);
+    return page;
+}
+
+static void page_put(cached_page_t* page) {
+    spinlock_acquire(&cache_lock);
+    page->pins--;
+    spinlock_release(&cache_lock);
+}
+
+/* ---- Readahead ---- */
+
+/**
+ * Read one run of consecutive pages with a single request when the
+ * filesystem can, and cache them unpinned
+ * @param mark Page to flag PG_READAHEAD, or RA_NO_MARK
+ * @param ra_from First page read ahead of demand, for accounting
+ * @return 0 on success, -1 if the filesystem failed
+ */
+static int read_run(inode_t* inode, uint32_t index, uint32_t count, uint32_t mark, uint32_t ra_from) {
+    cached_page_t* pages[PAGE_CACHE_RA_MAX_PAGES];
+    void* data[PAGE_CACHE_RA_MAX_PAGES];
+    uint32_t built = 0;
+
+    while (built < count) {
+        pages[built] = page_alloc();
+        if (!pages[built]) {
+            break;
+        }
+        pages[built]->mapping = &inode->mapping;
+        pages[built]->index = index + built;
+        pages[built]->flags = PG_UPTODATE;
+        data[built] = pages[built]->data;
+        built++;
+    }
+
+    /* Out of memory: read whatever could be allocated */
+    int result = built ? 0 : -1;
+    uint32_t ios = 0;
+    if (built && inode->fops->readpages) {
+        result = inode->fops->readpages(inode, index, built, data);
+        ios = 1;
+    } else {
+        for (uint32_t i = 0; i < built && result == 0; i++) {
+            result = inode->fops->readpage(inode, index + i, data[i]);
+            ios++;
+        }
+    }
+
+    if (result != 0) {
+        for (uint32_t i = 0; i < built; i++) {
+            page_free(pages[i]);
+        }
+        return -1;
+    }
+
+    cached_page_t* victims = NULL;
+    cached_page_t* losers = NULL;
+    uint32_t freed = 0;
+
+    spinlock_acquire(&cache_lock);
+    cache_stats.read_ios += ios;
+    cache_stats.readpages += built;
+    for (uint32_t i = 0; i < built; i++) {
+        cached_page_t* page = pages[i];
+
+        if (radix_tree_lookup(&inode->mapping.pages, page->index)) {
+            /* Someone else read it meanwhile */
+            page->lru_next = losers;
+            losers = page;
+            continue;
+        }
+        if (cache_stats.pages >= cache_stats.max_pages) {
+            cached_page_t* more = reclaim_locked(1, &freed);
+            if (more) {
+                more->lru_next = victims;
+                victims = more;
+            }
+        }
+        if (radix_tree_insert(&inode->mapping.pages, page->index, page) != 0) {
+            page->lru_next = losers;
+            losers = page;
+            continue;
+        }
+        if (page->index == mark) {
+            page->flags |= PG_READAHEAD;
+        }
+        if (page->index >= ra_from) {
+            cache_stats.ra_pages++;
+        }
+        inode->mapping.nrpages++;
+        cache_stats.pages++;
+        lru_push_front(page);
+    }
+    spinlock_release(&cache_lock);
+
+    free_victims(victims);
+    free_victims(losers);
+    return 0;
+}
+
+/**
+ * Bring pages [index, index + count) into the cache, reading the missing
+ * ones in runs; nothing past end of file is read
+ */
+static void read_pages(inode_t* inode, uint32_t index, uint32_t count, uint32_t mark, uint32_t ra_from) {
+    if (inode->size == 0) {
+        return;
+    }
+    uint32_t end_index = ((inode->size - 1) >> PAGE_CACHE_SHIFT) + 1;
+    if (index >= end_index) {
+        return;
+    }
+    if (count > end_index - index) {
+        count = end_index - index;
+    }
+
+    uint32_t i = 0;
+    while (i < count) {
+        /* Skip pages already cached */
+        spinlock_acquire(&cache_lock);
+        while (i < count && radix_tree_lookup(&inode->mapping.pages, index + i)) {
+            i++;
+        }
+        uint32_t run = 0;
+        while (i + run < count && run < PAGE_CACHE_RA_MAX_PAGES &&
+               !radix_tree_lookup(&inode->mapping.pages, index + i + run)) {
+            run++;
+        }
+        spinlock_release(&cache_lock);
+
+        if (run == 0) {
+            break;
+        }
+        if (read_run(inode, index + i, run, mark, ra_from) != 0) {
+            break;
+        }
+        i += run;
+    }
+}
+
+static uint32_t ra_init_size(uint32_t req) {
+    uint32_t size = req > PAGE_CACHE_RA_INIT_PAGES ? req : PAGE_CACHE_RA_INIT_PAGES;
+    return size < ra_max_pages ? size : ra_max_pages;
+}
+
+static uint32_t ra_next_size(uint32_t size) {
+    return size * 2 < ra_max_pages ? size * 2 : ra_max_pages;
+}
+
+/**
+ * Decide on readahead before reading a page of a request
+ * @param req Pages left in the request, this one included
+ */
+static void page_cache_readahead(inode_t* inode, file_ra_state_t* ra, uint32_t index, uint32_t req) {
+    uint32_t max = ra_max_pages;
+
+    if (!ra || max == 0) {
+        return;
+    }
+
+    spinlock_acquire(&cache_lock);
+    cached_page_t* page = (cached_page_t*)radix_tree_lookup(&inode->mapping.pages, index);
+    int marked = page && (page->flags & PG_READAHEAD);
+    if (marked) {
+        page->flags &= ~PG_READAHEAD;
+        cache_stats.ra_async++;
+    }
+    spinlock_release(&cache_lock);
+
+    if (page && !marked) {
+        return;
+    }
+
+    if (marked) {
+        /* The reader reached the pages read ahead: move the window on,
+         * unless the mark belongs to some other stream */
+        if (ra->size && index == ra->start + ra->size - ra->async_size) {
+            ra->start += ra->size;
+            ra->size = ra_next_size(ra->size);
+        } else {
+            ra->start = index + 1;
+            ra->size = ra_init_size(req);
+        }
+        ra->async_size = ra->size;
+        read_pages(inode, ra->start, ra->size, ra->start, ra->start);
+        return;
+    }
+
+    int sequential = index == ra->prev_index || index == ra->prev_index + 1 ||
+                     (ra->size && index >= ra->start && index < ra->start + ra->size);
+    if (!sequential) {
+        /* Random access: collapse the window, read only the request */
+        ra->size = 0;
+        ra->async_size = 0;
+        read_pages(inode, index, req < max ? req : max, RA_NO_MARK, RA_NO_MARK);
+        return;
+    }
+
+    ra->start = index;
+    ra->size = ra->size ? ra_next_size(ra->size) : ra_init_size(req);
+    if (ra->size < req) {
+        ra->size = req < max ? req : max;
+    }
+    ra->async_size = ra->size > req ? ra->size - req : 0;
+
+    uint32_t ra_from = index + ra->size - ra->async_size;
+    read_pages(inode, index, ra->size, ra->async_size ? ra_from : RA_NO_MARK, ra_from);
+}
+
+/* ---- Public interface ---- */
+
+void page_cache_init(uint32_t max_pages) {
+    spinlock_init(&cache_lock);
+    lru_head = NULL;
+    lru_tail = NULL;
+
+    cache_stats.hits = 0;
+    cache_stats.misses = 0;
+    cache_stats.readpages = 0;
+    cache_stats.read_ios = 0;
+    cache_stats.ra_pages = 0;
+    cache_stats.ra_async = 0;
+    cache_stats.writepages = 0;
+    cache_stats.dirtied = 0;
+    cache_stats.written_back = 0;
+    cache_stats.write_errors = 0;
+    cache_stats.evictions = 0;
+    cache_stats.pages = 0;
+    cache_stats.dirty = 0;
+    cache_stats.writeback = 0;
+    cache_stats.max_pages = max_pages ? max_pages : PAGE_CACHE_DEFAULT_MAX_PAGES;
+}
+
+void page_cache_set_limit(uint32_t max_pages) {
+    uint32_t freed = 0;
+    cached_page_t* victims = NULL;
+
+    if (max_pages == 0) {
+        return;
+    }
+
+    spinlock_acquire(&cache_lock);
+    cache_stats.max_pages = max_pages;
+    if (cache_stats.pages > max_pages) {
+        victims = reclaim_locked(cache_stats.pages - max_pages, &freed);
+    }
+    spinlock_release(&cache_lock);
+
+    free_victims(victims);
+}
+
+void page_cache_set_readahead(uint32_t max_pages) {
+    ra_max_pages = max_pages < PAGE_CACHE_RA_MAX_PAGES ? max_pages : PAGE_CACHE_RA_MAX_PAGES;
+}
+
+void page_cache_ra_init(file_ra_state_t* ra) {
+    ra->start = 0;
+    ra->size = 0;
+    ra->async_size = 0;
+    ra->prev_index = 0xFFFFFFFF;    /* Reading page 0 first counts as sequential */
+}
+
+void page_cache_mapping_init(address_space_t* mapping, struct inode* host) {
+    radix_tree_init(&mapping->pages);
+    mapping->nrpages = 0;
+    mapping->host = host;
+    mapping->bdi = NULL;
+    mapping->dirty = NULL;
+    mapping->nrdirty = 0;
+    mapping->nrwriteback = 0;
+    mapping->error = 0;
+    mapping->dirtied_when = 0;
+    mapping->dirty_prev = NULL;
+    mapping->dirty_next = NULL;
+}
+
+int page_cache_read(struct inode* inode, file_ra_state_t* ra, void* buffer, size_t size, uint32_t offset) {
+    if (!inode || !buffer) {
+        return -1;
+    }
+
+    if (offset >= inode->size) {
+        return 0;
+    }
+    if (size > inode->size - offset) {
+        size = inode->size - offset;
+    }
+
+    uint8_t* buf = (uint8_t*)buffer;
+    size_t done = 0;
+    uint32_t last_index = (uint32_t)((offset + size - 1) >> PAGE_CACHE_SHIFT);
+
+    while (done < size) {
+        uint32_t pos = offset + (uint32_t)done;
+        uint32_t index = pos >> PAGE_CACHE_SHIFT;
+        uint32_t page_offset = pos & (PAGE_CACHE_SIZE - 1);
+        size_t chunk = PAGE_CACHE_SIZE - page_offset;
+
+        if (chunk > size - done) {
+            chunk = size - done;
+        }
+
+        if (ra && inode->fops && inode->fops->readpage) {
+            page_cache_readahead(inode, ra, index, last_index - index + 1);
+        }
+
+        cached_page_t* page = page_get(inode, index, 1);
+        if (!page) {
+            break;
+        }
+        pc_memcpy(buf + done, page->data + page_offset, chunk);
+        page_put(page);
+
+        if (ra) {
+            ra->prev_index = index;
+        }
+        done += chunk;
+    }
+
+    if (done == 0 && size > 0) {
+        return -1;
+    }
+    return (int)done;
+}
+
+int page_cache_write(struct inode* inode, const void* buffer, size_t size, uint32_t offset) {
+    if (!inode || !buffer || !inode->fops || !inode->fops->writepage) {
+        return -1;
+    }
+
+    const uint8_t* buf = (const uint8_t*)buffer;
+    backing_dev_t* bdi = inode->mapping.bdi;
+    size_t done = 0;
+
+    while (done < size) {
+        uint32_t pos = offset + (uint32_t)done;
+        uint32_t index = pos >> PAGE_CACHE_SHIFT;
+        uint32_t page_offset = pos & (PAGE_CACHE_SIZE - 1);
+        uint32_t page_start = pos - page_offset;
+        size_t chunk = PAGE_CACHE_SIZE - page_offset;
+
+        if (chunk > size - done) {
+            chunk = size - done;
+        }
+
+        /* Existing data around a partial write has to be read first */
+        int partial = chunk < PAGE_CACHE_SIZE && page_start < inode->size;
+        cached_page_t* page = page_get(inode, index, partial);
+        if (!page) {
+            break;
+        }
+        pc_memcpy(page->data + page_offset, buf + done, chunk);
+
+        uint32_t end = pos + (uint32_t)chunk;
+        uint32_t new_size = end > inode->size ? end : inode->size;
+        uint32_t length = new_size - page_start;
+        if (length > PAGE_CACHE_SIZE) {
+            length = PAGE_CACHE_SIZE;
+        }
+
+        if (bdi) {
+            /* Written back later */
+            spinlock_acquire(&cache_lock);
+            mark_dirty_locked(page);
+            page->pins--;
+            spinlock_release(&cache_lock);
+
+            inode->size = new_size;
+            done += chunk;
+            continue;
+        }
+
+        int result = inode->fops->writepage(inode, index, page->data, length);
+        page_put(page);
+
+        spinlock_acquire(&cache_lock);
+        cache_stats.writepages++;
+        spinlock_release(&cache_lock);
+
+        if (result != 0) {
+            /* The cached copy no longer matches the file */
+            page_cache_truncate(&inode->mapping, index);
+            break;
+        }
+
+        inode->size = new_size;
+        done += chunk;
+    }
+
+    if (bdi && done > 0 && balance_dirty_pages(bdi) != 0) {
+        return -1;
+    }
+
+    if (done == 0 && size > 0) {
+        return -1;
+    }
+    return (int)done;
+}
+
+/* ---- Writeback ---- */
+
+static uint64_t wb_key(cached_page_t* page) {
+    inode_t* inode = page->mapping->host;
+
+    if (inode->fops->bmap) {
+        uint32_t block = inode->fops->bmap(inode, page->index);
+        if (block != VFS_BLOCK_NONE) {
+            return block;
+        }
+    }
+    /* Unmapped pages go after mapped ones, in file order */
+    return (1ull << 63) | ((uint64_t)inode->ino << 32) | page->index;
+}
+
+static void sift_down(wb_entry_t* batch, uint32_t root, uint32_t count) {
+    for (;;) {
+        uint32_t child = 2 * root + 1;
+        if (child >= count) {
+            return;
+        }
+        if (child + 1 < count && batch[child + 1].key > batch[child].key) {
+            child++;
+        }
+        if (batch[root].key >= batch[child].key) {
+            return;
+        }
+        wb_entry_t tmp = batch[root];
+        batch[root] = batch[child];
+        batch[child] = tmp;
+        root = child;
+    }
+}
+
+/* Heapsort: no recursion and no extra memory */
+static void sort_batch(wb_entry_t* batch, uint32_t count) {
+    for (uint32_t i = count / 2; i-- > 0;) {
+        sift_down(batch, i, count);
+    }
+    for (uint32_t end = count; end-- > 1;) {
+        wb_entry_t tmp = batch[0];
+        batch[0] = batch[end];
+        batch[end] = tmp;
+        sift_down(batch, 0, end);
+    }
+}
+
+/**
+ * Move up to max dirty pages of a file to writeback, skipping pages
+ * still in flight from an earlier writeback
+ * cache_lock held
+ */
+static uint32_t take_dirty_locked(address_space_t* mapping, wb_entry_t* batch, uint32_t max) {
+    cached_page_t* page = mapping->dirty;
+    uint32_t taken = 0;
+
+    while (page && taken < max) {
+        cached_page_t* next = page->dirty_next;
+        if (!(page->flags & PG_WRITEBACK)) {
+            clear_dirty_locked(page);
+            page->flags |= PG_WRITEBACK;
+            page->pins++;
+            mapping->nrwriteback++;
+            cache_stats.writeback++;
+            batch[taken++].page = page;
+        }
+        page = next;
+    }
+    return taken;
+}
+
+/**
+ * Write a batch of pages in block order and finish their writeback
+ * @return Pages the filesystem failed to write
+ */
+static uint32_t write_batch(wb_entry_t* batch, uint32_t count) {
+    uint32_t failed = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        batch[i].key = wb_key(batch[i].page);
+    }
+    sort_batch(batch, count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        cached_page_t* page = batch[i].page;
+        address_space_t* mapping = page->mapping;
+        inode_t* inode = mapping->host;
+        uint32_t start = page->index << PAGE_CACHE_SHIFT;
+        int wrote = 0;
+        int result = 0;
+
+        /* Pages truncated away meanwhile are not written */
+        if (start < inode->size) {
+            uint32_t length = inode->size - start;
+            if (length > PAGE_CACHE_SIZE) {
+                length = PAGE_CACHE_SIZE;
+            }
+            result = inode->fops->writepage(inode, page->index, page->data, length);
+            wrote = 1;
+        }
+
+        spinlock_acquire(&cache_lock);
+        page->flags &= ~PG_WRITEBACK;
+        page->pins--;
+        int idle = --mapping->nrwriteback == 0;
+        cache_stats.writeback--;
+        if (wrote) {
+            cache_stats.writepages++;
+        }
+        if (result != 0) {
+            mapping->error = -1;
+            cache_stats.write_errors++;
+            mark_dirty_locked(page);
+            failed++;
+        } else if (wrote) {
+            cache_stats.written_back++;
+        }
+        spinlock_release(&cache_lock);
+
+#ifndef AURORA_STANDALONE
+        if (idle) {
+            wait_queue_wake_all(&writeback_waiters);
+        }
+#else
+        (void)idle;
+#endif
+    }
+    return failed;
+}
+
+/**
+ * Wait until none of a mapping's pages are being written back
+ */
+static void wait_on_writeback(address_space_t* mapping) {
+    for (;;) {
+#ifndef AURORA_STANDALONE
+        wait_entry_t wait;
+        wait_queue_prepare(&writeback_waiters, &wait);
+#endif
+        spinlock_acquire(&cache_lock);
+        uint32_t in_flight = mapping->nrwriteback;
+        spinlock_release(&cache_lock);
+
+#ifndef AURORA_STANDALONE
+        int slept = in_flight ? wait_queue_sleep(&wait, UINT64_MAX) : 0;
+        wait_queue_finish(&writeback_waiters, &wait);
+        if (slept >= 0) {
+            if (in_flight == 0) {
+                return;
+            }
+            continue;
+        }
+#endif
+        if (in_flight == 0) {
+            return;
+        }
+        /* Too early to sleep */
+        cpu_relax();
+    }
+}
+
+uint32_t page_cache_writeback(struct backing_dev* bdi, uint32_t nr_pages, uint64_t dirtied_before) {
+    if (!bdi || nr_pages == 0) {
+        return 0;
+    }
+
+    wb_entry_t* batch = (wb_entry_t*)kmalloc(sizeof(wb_entry_t) * PAGE_CACHE_WB_BATCH);
+    if (!batch) {
+        return 0;
+    }
+
+    uint32_t written = 0;
+    while (written < nr_pages) {
+        uint32_t want = nr_pages - written;
+        uint32_t taken = 0;
+
+        if (want > PAGE_CACHE_WB_BATCH) {
+            want = PAGE_CACHE_WB_BATCH;
+        }
+
+        /* Oldest files first; the list is in dirtying order */
+        spinlock_acquire(&cache_lock);
+        address_space_t* mapping = bdi->dirty_head;
+        while (mapping && taken < want && mapping->dirtied_when < dirtied_before) {
+            address_space_t* next = mapping->dirty_next;
+            taken += take_dirty_locked(mapping, batch + taken, want - taken);
+            mapping = next;
+        }
+        spinlock_release(&cache_lock);
+
+        if (taken == 0) {
+            break;
+        }
+        written += taken;
+        uint32_t failed = write_batch(batch, taken);
+        if (failed) {
+            bdi->stats.write_errors += failed;
+            break;
+        }
+    }
+
+    kfree(batch);
+    return written;
+}
+
+int page_cache_sync(struct inode* inode) {
+    if (!inode) {
+        return -1;
+    }
+
+    address_space_t* mapping = &inode->mapping;
+    if (!mapping->bdi) {
+        return 0;
+    }
+
+    wb_entry_t* batch = (wb_entry_t*)kmalloc(sizeof(wb_entry_t) * PAGE_CACHE_WB_BATCH);
+    if (!batch) {
+        return -1;
+    }
+
+    /* Only pages dirty now: later writes do not hold the caller up */
+    spinlock_acquire(&cache_lock);
+    uint32_t todo = mapping->nrdirty;
+    spinlock_release(&cache_lock);
+
+    for (;;) {
+        spinlock_acquire(&cache_lock);
+        uint32_t taken = 0;
+        if (todo) {
+            taken = take_dirty_locked(mapping, batch, todo < PAGE_CACHE_WB_BATCH ? todo : PAGE_CACHE_WB_BATCH);
+        }
+        uint32_t in_flight = mapping->nrwriteback - taken;
+        spinlock_release(&cache_lock);
+
+        if (taken) {
+            write_batch(batch, taken);
+            todo -= taken;
+            continue;
+        }
+        if (in_flight == 0) {
+            break;
+        }
+
+        /* The flusher is writing some of them; wait, then take any it
+         * left dirty */
+        wait_on_writeback(mapping);
+    }
+    kfree(batch);
+
+    spinlock_acquire(&cache_lock);
+    int result = mapping->error;
+    mapping->error = 0;
+    spinlock_release(&cache_lock);
+    return result;
+}
+
+void page_cache_truncate(address_space_t* mapping, uint32_t start_index) {
+    cached_page_t* batch[16];
+
+    if (!mapping) {
+        return;
+    }
+
+    uint32_t index = start_index;
+    int in_flight = 0;
+    for (;;) {
+        cached_page_t* victims = NULL;
+        uint32_t next = index;
+
+        spinlock_acquire(&cache_lock);
+        uint32_t found = radix_tree_gang_lookup(&mapping->pages, (void**)batch, index, 16);
+        for (uint32_t i = 0; i < found; i++) {
+            next = batch[i]->index + 1;
+            if (batch[i]->pins == 0) {
+                page_remove(batch[i]);
+                batch[i]->lru_next = victims;
+                victims = batch[i];
+            } else if (batch[i]->flags & PG_WRITEBACK) {
+                in_flight = 1;
+            }
+        }
+        spinlock_release(&cache_lock);
+
+        free_victims(victims);
+        if (found < 16 || next == 0) {
+            if (!in_flight) {
+                break;
+            }
+            /* Pages being written back go once they are done (a failed
+             * write leaves them dirty again) */
+            wait_on_writeback(mapping);
+            in_flight = 0;
+            index = start_index;
+            continue;
+        }
+        index = next;
+    }
+}
+
+uint32_t page_cache_shrink(uint32_t nr_pages) {
+    uint32_t freed = 0;
+
+    spinlock_acquire(&cache_lock);
+    cached_page_t* victims = reclaim_locked(nr_pages, &freed);
+    spinlock_release(&cache_lock);
+
+    free_victims(victims);
+    return freed;
+}
+
+void page_cache_get_stats(page_cache_stats_t* stats) {
+    if (!stats) {
+        return;
+    }
+
+    spinlock_acquire(&cache_lock);
+    *stats = cache_stats;
+    spinlock_release(&cache_lock);
+}
@@ -0,0 +1,188 @@
+/**
+ * Aurora OS - Page Cache Header
+ *
+ * Unified cache of file data in 4 KB pages, shared by every filesystem.
+ * Each inode's pages are indexed by file page number in a radix tree
+ * (its address space); filesystems only supply readpage and writepage
+ * in their file_ops and the VFS reads and writes through the cache.
+ * Pages sit on one global LRU list and the least recently used unpinned
+ * pages are reclaimed when the cache reaches its size limit or on
+ * request under memory pressure.
+ *
+ * Reads through an open file carry that file's readahead state. A miss
+ * that continues a sequential stream reads a window of pages ahead in
+ * one batched request, starting at 16 KB and doubling up to the
+ * readahead limit; the first page read ahead is marked, and reaching it
+ * fetches the next window before the reader runs out. A miss anywhere
+ * else collapses the window and reads only what was asked for.
+ *
+ * Files whose address space names a backing device are written back
+ * rather than through: writes only dirty cached pages, and the device's
+ * flusher (filesystem/cache/writeback.c) writes them out later, oldest
+ * files first and each batch in device block order. Dirty pages are
+ * never reclaimed. fsync writes out one file's pages and waits for
+ * those already in flight.
+ */
+
+#ifndef AURORA_PAGE_CACHE_H
+#define AURORA_PAGE_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../../kernel/core/radix_tree.h"
+
+#define PAGE_CACHE_SHIFT            12
+#define PAGE_CACHE_SIZE             (1u << PAGE_CACHE_SHIFT)
+#define PAGE_CACHE_DEFAULT_MAX_PAGES 1024      /* 4 MB */
+
+#define PAGE_CACHE_RA_INIT_PAGES    4           /* 16 KB first window */
+#define PAGE_CACHE_RA_DEFAULT_MAX   32          /* 128 KB */
+#define PAGE_CACHE_RA_MAX_PAGES     64          /* Upper bound for the limit (256 KB) */
+
+/* Page flags */
+#define PG_UPTODATE     0x01        /* Data matches (or supersedes) the file */
+#define PG_READAHEAD    0x02        /* Reading it starts the next readahead window */
+#define PG_DIRTY        0x04        /* Newer than the file; not yet written back */
+#define PG_WRITEBACK    0x08        /* Being written to the file */
+
+#define PAGE_CACHE_WB_BATCH         1024        /* Pages sorted and written per pass */
+
+struct inode;
+struct backing_dev;
+struct cached_page;
+
+/* Per-inode set of cached pages */
+typedef struct address_space {
+    radix_tree_root_t pages;
+    uint32_t nrpages;
+    struct inode* host;
+    struct backing_dev* bdi;        /* Written back through this device; NULL writes through */
+    struct cached_page* dirty;      /* Dirty pages, unordered */
+    uint32_t nrdirty;
+    uint32_t nrwriteback;
+    int error;                      /* A writeback failed since the last fsync */
+    uint64_t dirtied_when;          /* Device time the oldest dirty page was dirtied */
+    struct address_space* dirty_prev;   /* On the device's list while dirty */
+    struct address_space* dirty_next;
+} address_space_t;
+
+typedef struct cached_page {
+    address_space_t* mapping;
+    uint32_t index;                 /* Page number within the file */
+    uint32_t flags;
+    uint32_t pins;                  /* Users copying data; not reclaimable while set */
+    uint8_t* data;
+    struct cached_page* lru_prev;
+    struct cached_page* lru_next;
+    struct cached_page* dirty_prev; /* On the mapping's dirty list */
+    struct cached_page* dirty_next;
+} cached_page_t;
+
+/* Per-open-file readahead state */
+typedef struct file_ra_state {
+    uint32_t start;                 /* First page of the current window */
+    uint32_t size;                  /* Pages in the window; 0 when collapsed */
+    uint32_t async_size;            /* Pages read ahead of demand in the window */
+    uint32_t prev_index;            /* Last page read */
+} file_ra_state_t;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t readpages;             /* Pages read from the filesystem */
+    uint64_t read_ios;              /* Filesystem read requests (single or batched) */
+    uint64_t ra_pages;              /* Pages read ahead of demand */
+    uint64_t ra_async;              /* Windows started by reaching a marked page */
+    uint64_t writepages;            /* Filesystem writepage calls */
+    uint64_t dirtied;               /* Clean pages made dirty */
+    uint64_t written_back;          /* Dirty pages written out */
+    uint64_t write_errors;
+    uint64_t evictions;
+    uint32_t pages;                 /* Pages cached now */
+    uint32_t dirty;                 /* Dirty pages now */
+    uint32_t writeback;             /* Pages being written now */
+    uint32_t max_pages;
+} page_cache_stats_t;
+
+/**
+ * Initialize the page cache
+ * @param max_pages Pages held before LRU reclaim starts
+ */
+void page_cache_init(uint32_t max_pages);
+
+/**
+ * Change the cache size limit, reclaiming down to it
+ */
+void page_cache_set_limit(uint32_t max_pages);
+
+/**
+ * Set the largest readahead window in pages (0 turns readahead off)
+ */
+void page_cache_set_readahead(uint32_t max_pages);
+
+/**
+ * Reset readahead state for a newly opened file
+ */
+void page_cache_ra_init(file_ra_state_t* ra);
+
+/**
+ * Prepare an inode's address space
+ */
+void page_cache_mapping_init(address_space_t* mapping, struct inode* host);
+
+/**
+ * Read file data through the cache, filling missing pages with the
+ * filesystem's readpages or readpage
+ * @param ra Readahead state of the open file, or NULL for none
+ * @return Bytes read (short at end of file), or -1 on error
+ */
+int page_cache_read(struct inode* inode, file_ra_state_t* ra, void* buffer, size_t size, uint32_t offset);
+
+/**
+ * Write file data into the cache. With a backing device the pages are
+ * left dirty and the writer may be throttled; otherwise each page goes
+ * straight on to the filesystem's writepage. Partial pages inside the
+ * file are read first; pages past the end start zeroed. Extends
+ * inode->size.
+ * @return Bytes written, or -1 if nothing could be written or the
+ *         writer was throttled and writeback is failing (the data stays
+ *         cached and dirty)
+ */
+int page_cache_write(struct inode* inode, const void* buffer, size_t size, uint32_t offset);
+
+/**
+ * Write back dirty pages of a device's files, oldest files first
+ * @param nr_pages Most pages to write
+ * @param dirtied_before Only files first dirtied earlier than this
+ *                       device time (UINT64_MAX for any)
+ * @return Pages written (or attempted, if the filesystem failed)
+ */
+uint32_t page_cache_writeback(struct backing_dev* bdi, uint32_t nr_pages, uint64_t dirtied_before);
+
+/**
+ * Write back one file's dirty pages and wait for any already being
+ * written by the flusher
+ * @return 0, or -1 if a writeback of the file failed since the last call
+ */
+int page_cache_sync(struct inode* inode);
+
+/**
+ * Drop an inode's cached pages from a page number on (all of them for 0)
+ * Pages pinned by readers are skipped; pages being written back are
+ * waited for and then dropped, so the filesystem may free the inode once
+ * a full truncation returns.
+ */
+void page_cache_truncate(address_space_t* mapping, uint32_t start_index);
+
+/**
+ * Reclaim least recently used pages
+ * @return Pages freed
+ */
+uint32_t page_cache_shrink(uint32_t nr_pages);
+
+/**
+ * Get page cache statistics
+ */
+void page_cache_get_stats(page_cache_stats_t* stats);
+
+#endif /* AURORA_PAGE_CACHE_H */
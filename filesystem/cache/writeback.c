@@ -0,0 +1,307 @@
+/**
+ * Aurora OS - Page Cache Writeback Implementation
+ *
+ * Thresholds are worked out from the page cache's own counters on every
+ * check, so changing the cache size moves them too. A flusher pass first
+ * writes enough of its device's pages to get the cache back under the
+ * background ratio, then everything from files dirtied before the expire
+ * interval. The device list only changes when filesystems are mounted
+ * and unmounted, so flushers and writers walk it without a lock.
+ *
+ * Flushers follow kswapd: a kernel process per device that sleeps until
+ * a writer posts its wake flag or the interval is up. Throttled writers
+ * and bdi_unregister() sleep on wb_waiters, which every flusher wakes
+ * after each pass and on exit. Host builds (AURORA_STANDALONE) start no
+ * processes; harnesses call writeback_run() themselves and throttled
+ * writers always write back directly.
+ */
+
+#include "writeback.h"
+#ifndef AURORA_STANDALONE
+#include "../../kernel/process/process.h"
+#include "../../kernel/process/wait.h"
+#include "../../kernel/core/timing_system.h"
+#endif
+
+static backing_dev_t* bdi_list = NULL;
+static int flushers_running = 0;
+
+static uint32_t background_ratio = WRITEBACK_BACKGROUND_RATIO;
+static uint32_t dirty_ratio = WRITEBACK_DIRTY_RATIO;
+static uint64_t expire_us = WRITEBACK_EXPIRE_US;
+static uint64_t interval_us = WRITEBACK_INTERVAL_US;
+
+/**
+ * Dirty and in-flight pages cache-wide, and the two thresholds in pages
+ */
+static uint32_t dirty_state(uint32_t* background, uint32_t* limit) {
+    page_cache_stats_t st;
+    page_cache_get_stats(&st);
+
+    *background = (uint32_t)((uint64_t)st.max_pages * background_ratio / 100);
+    *limit = (uint32_t)((uint64_t)st.max_pages * dirty_ratio / 100);
+    if (*limit <= *background) {
+        *limit = *background + 1;
+    }
+    return st.dirty + st.writeback;
+}
+
+#ifndef AURORA_STANDALONE
+static wait_queue_t wb_waiters;     /* Woken after every flusher pass */
+
+static void start_flusher(backing_dev_t* bdi);
+#endif
+
+/* Ask for a flusher pass now */
+static void flush_wake(backing_dev_t* bdi) {
+#ifndef AURORA_STANDALONE
+    process_t* flusher = (process_t*)bdi->flusher;
+    if (flusher) {
+        process_post_event(flusher, &bdi->flush_wake);
+        return;
+    }
+#endif
+    bdi->flush_wake = 1;
+}
+
+void bdi_register(backing_dev_t* bdi, const char* name) {
+    if (!bdi) {
+        return;
+    }
+
+    bdi->name = name;
+    bdi->dirty_head = NULL;
+    bdi->dirty_tail = NULL;
+    bdi->dirty_pages = 0;
+    bdi->now = 0;
+    bdi->last_run = 0;
+    bdi->flush_wake = 0;
+    bdi->flusher = NULL;
+    bdi->pass_result = 0;
+    bdi->stats.runs = 0;
+    bdi->stats.wakeups = 0;
+    bdi->stats.background_pages = 0;
+    bdi->stats.expired_pages = 0;
+    bdi->stats.throttled = 0;
+    bdi->stats.direct_pages = 0;
+    bdi->stats.write_errors = 0;
+
+    bdi->next = bdi_list;
+    bdi_list = bdi;
+
+#ifndef AURORA_STANDALONE
+    if (flushers_running) {
+        start_flusher(bdi);
+    }
+#endif
+}
+
+void bdi_unregister(backing_dev_t* bdi) {
+    if (!bdi) {
+        return;
+    }
+
+    writeback_sync(bdi);
+
+    backing_dev_t** link = &bdi_list;
+    while (*link && *link != bdi) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = bdi->next;
+    }
+
+#ifndef AURORA_STANDALONE
+    /* Its flusher finds itself gone from the list and exits; wait until
+     * it has let go of the device */
+    while (__atomic_load_n(&bdi->flusher, __ATOMIC_ACQUIRE)) {
+        wait_entry_t wait;
+        wait_queue_prepare(&wb_waiters, &wait);
+        flush_wake(bdi);
+        if (__atomic_load_n(&bdi->flusher, __ATOMIC_ACQUIRE) &&
+            wait_queue_sleep(&wait, UINT64_MAX) < 0) {
+            process_yield();
+        }
+        wait_queue_finish(&wb_waiters, &wait);
+    }
+#endif
+}
+
+void writeback_set_ratios(uint32_t background, uint32_t ratio) {
+    if (ratio == 0 || ratio > 100 || background >= ratio) {
+        return;
+    }
+    background_ratio = background;
+    dirty_ratio = ratio;
+}
+
+void writeback_set_expire(uint64_t expire, uint64_t interval) {
+    expire_us = expire;
+    if (interval) {
+        interval_us = interval;
+    }
+}
+
+uint32_t writeback_run(backing_dev_t* bdi, uint64_t now) {
+    uint32_t background, limit;
+    uint32_t written = 0;
+
+    if (!bdi) {
+        return 0;
+    }
+
+    bdi->flush_wake = 0;
+    bdi->now = now;
+    bdi->last_run = now;
+    uint64_t errors = bdi->stats.write_errors;
+
+    uint32_t dirty = dirty_state(&background, &limit);
+    if (dirty > background) {
+        uint32_t got = page_cache_writeback(bdi, dirty - background, UINT64_MAX);
+        bdi->stats.background_pages += got;
+        written += got;
+    }
+
+    if (now >= expire_us) {
+        uint32_t got = page_cache_writeback(bdi, UINT32_MAX, now - expire_us + 1);
+        bdi->stats.expired_pages += got;
+        written += got;
+    }
+
+    /* Written counts pages attempted; the failed ones made no progress */
+    errors = bdi->stats.write_errors - errors;
+    bdi->pass_result = written > errors ? 1 : (errors ? -1 : 0);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    bdi->stats.runs++;              /* Last: a throttled writer reads the result after it */
+    return written;
+}
+
+uint32_t writeback_sync(backing_dev_t* bdi) {
+    return page_cache_writeback(bdi, UINT32_MAX, UINT64_MAX);
+}
+
+int balance_dirty_pages(backing_dev_t* bdi) {
+    uint32_t background, limit;
+
+    if (!bdi) {
+        return 0;
+    }
+
+    uint32_t dirty = dirty_state(&background, &limit);
+    if (dirty <= background) {
+        return 0;
+    }
+
+    if (!bdi->flush_wake) {
+        flush_wake(bdi);
+        bdi->stats.wakeups++;
+    }
+    if (dirty <= limit) {
+        return 0;
+    }
+
+    /* Too much dirty data: hold the writer until it is halfway back down */
+    bdi->stats.throttled++;
+    uint32_t target = background + (limit - background) / 2;
+
+#ifndef AURORA_STANDALONE
+    bdi->now = timing_get_microseconds();
+    process_t* self = process_get_current();
+    while (dirty > target && bdi->flusher && self && self != (process_t*)bdi->flusher) {
+        /* Queued before the wake, so the pass it asks for wakes us */
+        wait_entry_t wait;
+        wait_queue_prepare(&wb_waiters, &wait);
+        uint64_t runs = bdi->stats.runs;
+        flush_wake(bdi);
+        int slept = wait_queue_sleep(&wait, timing_get_microseconds() + interval_us);
+        wait_queue_finish(&wb_waiters, &wait);
+        if (slept < 0) {
+            break;
+        }
+
+        dirty = dirty_state(&background, &limit);
+        uint64_t passes = bdi->stats.runs;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (dirty > target && passes != runs && bdi->pass_result <= 0) {
+            /* A pass that got nothing written won't be bettered by the next */
+            return bdi->pass_result;
+        }
+    }
+    if (dirty <= target) {
+        return 0;
+    }
+#endif
+
+    /* No flusher to wait for: do its work */
+    uint64_t errors = bdi->stats.write_errors;
+    uint32_t got = page_cache_writeback(bdi, dirty - target, UINT64_MAX);
+    bdi->stats.direct_pages += got;
+    return bdi->stats.write_errors != errors ? -1 : 0;
+}
+
+#ifndef AURORA_STANDALONE
+static int bdi_registered(backing_dev_t* bdi) {
+    for (backing_dev_t* b = bdi_list; b; b = b->next) {
+        if (b == bdi) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Flusher: one per device, found by matching its process
+ */
+static void flusher_main(void) {
+    backing_dev_t* bdi = NULL;
+
+    while (!bdi) {
+        process_t* self = process_get_current();
+        for (backing_dev_t* b = bdi_list; b; b = b->next) {
+            if (b->flusher == self) {
+                bdi = b;
+            }
+        }
+        if (!bdi) {
+            process_yield();
+        }
+    }
+
+    for (;;) {
+        process_wait_event_until(&bdi->flush_wake, bdi->last_run + interval_us);
+        if (!bdi_registered(bdi)) {
+            break;
+        }
+        writeback_run(bdi, timing_get_microseconds());
+        wait_queue_wake_all(&wb_waiters);
+    }
+
+    /* Last touch of the device: bdi_unregister() waits for it */
+    __atomic_store_n(&bdi->flusher, NULL, __ATOMIC_RELEASE);
+    wait_queue_wake_all(&wb_waiters);
+    process_terminate(process_get_current()->pid);
+}
+
+static void start_flusher(backing_dev_t* bdi) {
+    if (!bdi->flusher) {
+        bdi->flusher = process_create(flusher_main, 1);
+    }
+}
+
+void writeback_start_flushers(void) {
+    flushers_running = 1;
+    for (backing_dev_t* bdi = bdi_list; bdi; bdi = bdi->next) {
+        start_flusher(bdi);
+    }
+}
+#else
+void writeback_start_flushers(void) {
+    flushers_running = 1;
+}
+#endif
+
+void writeback_get_stats(backing_dev_t* bdi, writeback_stats_t* stats) {
+    if (bdi && stats) {
+        *stats = bdi->stats;
+    }
+}
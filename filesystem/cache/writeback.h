@@ -0,0 +1,107 @@
+/**
+ * Aurora OS - Page Cache Writeback Header
+ *
+ * Deferred writeback of dirty page cache pages. A filesystem registers a
+ * backing device for each mounted volume and points its inodes' address
+ * spaces at it; writes to those files then only dirty cached pages. Each
+ * device has a flusher kernel process that writes pages back when:
+ *
+ *  - dirty pages (cache-wide, counting those in flight) pass the
+ *    background ratio of the cache size, until they are back under it
+ *  - a file has had dirty pages for longer than the expire interval
+ *
+ * Past the dirty ratio, writers are throttled in balance_dirty_pages():
+ * they sleep through flusher passes until dirty pages drop halfway back
+ * to the background threshold, or write pages back themselves when there
+ * is no flusher to wait for. A pass that writes nothing ends the wait.
+ * Times are microseconds, as from timing_get_microseconds().
+ */
+
+#ifndef AURORA_WRITEBACK_H
+#define AURORA_WRITEBACK_H
+
+#include <stdint.h>
+#include "page_cache.h"
+
+#define WRITEBACK_BACKGROUND_RATIO  10          /* % of the cache */
+#define WRITEBACK_DIRTY_RATIO       20
+#define WRITEBACK_EXPIRE_US         30000000ull /* 30 s */
+#define WRITEBACK_INTERVAL_US       5000000ull  /* Flusher wakes every 5 s */
+
+typedef struct {
+    uint64_t runs;                  /* Flusher passes */
+    uint64_t wakeups;               /* Passes requested by writers */
+    uint64_t background_pages;      /* Written to get under the background ratio */
+    uint64_t expired_pages;         /* Written because they got old */
+    uint64_t throttled;             /* Writers held back at the dirty ratio */
+    uint64_t direct_pages;          /* Written by throttled writers themselves */
+    uint64_t write_errors;          /* Pages the filesystem failed to write */
+} writeback_stats_t;
+
+/* A device dirty files are written back to */
+typedef struct backing_dev {
+    const char* name;
+    address_space_t* dirty_head;    /* Files with dirty pages, oldest first */
+    address_space_t* dirty_tail;
+    uint32_t dirty_pages;
+    uint64_t now;                   /* Device time as of the last writeback or throttle */
+    uint64_t last_run;
+    volatile uint32_t flush_wake;   /* A writer wants a pass now */
+    void* flusher;                  /* Flusher process, once started */
+    int32_t pass_result;            /* Last pass: 1 wrote pages, 0 had none, -1 all failed */
+    writeback_stats_t stats;
+    struct backing_dev* next;
+} backing_dev_t;
+
+/**
+ * Register a device; its flusher starts with the others, or at once if
+ * flushers are already running
+ */
+void bdi_register(backing_dev_t* bdi, const char* name);
+
+/**
+ * Unregister a device after writing back all its dirty pages
+ */
+void bdi_unregister(backing_dev_t* bdi);
+
+/**
+ * Set the background and throttling thresholds, in % of the cache size
+ */
+void writeback_set_ratios(uint32_t background_ratio, uint32_t dirty_ratio);
+
+/**
+ * Set how old dirty data may get and how often flushers look for it
+ */
+void writeback_set_expire(uint64_t expire_us, uint64_t interval_us);
+
+/**
+ * One flusher pass over a device
+ * @param now Current time
+ * @return Pages written
+ */
+uint32_t writeback_run(backing_dev_t* bdi, uint64_t now);
+
+/**
+ * Write back every dirty page of a device
+ * @return Pages written
+ */
+uint32_t writeback_sync(backing_dev_t* bdi);
+
+/**
+ * Called after dirtying pages of a device's files: wakes the flusher
+ * past the background ratio and throttles the caller past the dirty ratio
+ * @return 0, or -1 if the caller was throttled and writeback is failing
+ */
+int balance_dirty_pages(backing_dev_t* bdi);
+
+/**
+ * Start a flusher kernel process for every registered device
+ */
+void writeback_start_flushers(void);
+
+/**
+ * Get a device's writeback statistics
+ */
+void writeback_get_stats(backing_dev_t* bdi, writeback_stats_t* stats);
+
+#endif /* AURORA_WRITEBACK_H */
@@ -10,12 +10,21 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+/* FAT sectors read per step while building the free-cluster bitmap */
+#define FAT32_SCAN_SECTORS      64
+#define FAT32_CACHE_SETS        (FAT32_CACHE_PAGES / FAT32_CACHE_WAYS)
+#define FAT32_PAGE_ENTRIES      (FAT32_CACHE_SECTORS * FAT32_ENTRIES_PER_SECTOR)
+#define FAT32_MIN_RUNS          8
+
 /* Global FAT32 mount information */
 static fat32_mount_t g_fat32_mount = {0};
 static bool g_fat32_mounted = false;
 
-/* Buffer for sector reads */
-static uint8_t sector_buffer[FAT32_SECTOR_SIZE];
+/* Registered block devices, by name */
+static struct {
+    const char* name;
+    const fat32_device_t* dev;
+} g_fat32_devices[FAT32_MAX_DEVICES];
 
 /* Forward declarations */
 static int fat32_mount(const char* device);
@@ -51,6 +60,75 @@ void fat32_init(void) {
     g_fat32_mount.device = NULL;
 }
 
+static void fat_memcpy(void* dest, const void* src, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+    for (size_t i = 0; i < n; i++) {
+        d[i] = s[i];
+    }
+}
+
+static void fat_memset(void* dest, int value, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    for (size_t i = 0; i < n; i++) {
+        d[i] = (uint8_t)value;
+    }
+}
+
+static int fat_strcmp(const char* a, const char* b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return (uint8_t)*a - (uint8_t)*b;
+}
+
+static inline uint32_t fat32_load32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void fat32_store32(uint8_t* p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+/**
+ * Register a block device under a name for fat32_mount_device()
+ */
+int fat32_register_device(const char* name, const fat32_device_t* dev) {
+    if (!name || !dev || !dev->read || !dev->write) {
+        return -1;
+    }
+
+    int slot = -1;
+    for (int i = 0; i < FAT32_MAX_DEVICES; i++) {
+        if (g_fat32_devices[i].name && fat_strcmp(g_fat32_devices[i].name, name) == 0) {
+            return -1;
+        }
+        if (!g_fat32_devices[i].name && slot < 0) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        return -1;
+    }
+
+    g_fat32_devices[slot].name = name;
+    g_fat32_devices[slot].dev = dev;
+    return 0;
+}
+
+static const fat32_device_t* fat32_find_device(const char* name) {
+    for (int i = 0; name && i < FAT32_MAX_DEVICES; i++) {
+        if (g_fat32_devices[i].name && fat_strcmp(g_fat32_devices[i].name, name) == 0) {
+            return g_fat32_devices[i].dev;
+        }
+    }
+    return NULL;
+}
+
 /**
  * Convert cluster number to sector number
  */
@@ -61,74 +139,628 @@ uint32_t fat32_cluster_to_sector(fat32_mount_t* mount, uint32_t cluster) {
     return mount->first_data_sector + (cluster - 2) * mount->sectors_per_cluster;
 }
 
+/* One past the highest cluster number */
+static inline uint32_t fat32_cluster_end(const fat32_mount_t* mount) {
+    return mount->total_clusters + 2;
+}
+
+/* The FAT copy that is read, and the only one written without mirroring */
+static inline uint32_t fat32_active_fat(const fat32_mount_t* mount) {
+    uint32_t active = mount->ext_flags & FAT32_EXT_ACTIVE_MASK;
+    return ((mount->ext_flags & FAT32_EXT_NO_MIRROR) && active < mount->num_fats) ? active : 0;
+}
+
+static inline uint32_t fat32_page_sectors(const fat32_mount_t* mount, uint32_t page) {
+    uint32_t left = mount->fat_size - page * FAT32_CACHE_SECTORS;
+    return left < FAT32_CACHE_SECTORS ? left : FAT32_CACHE_SECTORS;
+}
+
+/* ============================================================================
+ * FAT CACHE
+ * ============================================================================ */
+
+/* Write a dirty page to every FAT copy in use */
+static int fat32_cache_writeback(fat32_mount_t* mount, fat32_fat_page_t* page) {
+    const fat32_device_t* dev = mount->device;
+    uint32_t sectors = fat32_page_sectors(mount, page->page);
+    bool mirrored = !(mount->ext_flags & FAT32_EXT_NO_MIRROR);
+
+    for (uint32_t fat = 0; fat < mount->num_fats; fat++) {
+        if (!mirrored && fat != fat32_active_fat(mount)) {
+            continue;
+        }
+        uint64_t sector = (uint64_t)mount->first_fat_sector + (uint64_t)fat * mount->fat_size +
+                          (uint64_t)page->page * FAT32_CACHE_SECTORS;
+        if (dev->write(dev->ctx, sector, page->data, sectors) != 0) {
+            return -1;
+        }
+        mount->cache_stats.sectors_written += sectors;
+    }
+    page->dirty = false;
+    mount->cache_stats.writebacks++;
+    return 0;
+}
+
+/* Cached FAT page, read in on a miss over the least recently used page
+ * of its set. Called with the lock held. */
+static fat32_fat_page_t* fat32_cache_get(fat32_mount_t* mount, uint32_t page) {
+    fat32_fat_page_t* set = mount->fat_cache + (page % FAT32_CACHE_SETS) * FAT32_CACHE_WAYS;
+    fat32_fat_page_t* victim = NULL;
+
+    for (uint32_t way = 0; way < FAT32_CACHE_WAYS; way++) {
+        fat32_fat_page_t* p = &set[way];
+        if (p->valid && p->page == page) {
+            p->last_use = ++mount->cache_clock;
+            mount->cache_stats.hits++;
+            return p;
+        }
+        if (!victim || (victim->valid && (!p->valid || p->last_use < victim->last_use))) {
+            victim = p;
+        }
+    }
+
+    mount->cache_stats.misses++;
+    if (victim->valid && victim->dirty && fat32_cache_writeback(mount, victim) != 0) {
+        return NULL;
+    }
+    const fat32_device_t* dev = mount->device;
+    uint64_t sector = (uint64_t)mount->first_fat_sector +
+                      (uint64_t)fat32_active_fat(mount) * mount->fat_size +
+                      (uint64_t)page * FAT32_CACHE_SECTORS;
+    if (dev->read(dev->ctx, sector, victim->data, fat32_page_sectors(mount, page)) != 0) {
+        victim->valid = false;
+        return NULL;
+    }
+    victim->page = page;
+    victim->valid = true;
+    victim->dirty = false;
+    victim->last_use = ++mount->cache_clock;
+    return victim;
+}
+
+static int fat32_entry_get(fat32_mount_t* mount, uint32_t cluster, uint32_t* value) {
+    fat32_fat_page_t* p = fat32_cache_get(mount, cluster / FAT32_PAGE_ENTRIES);
+    if (!p) {
+        return -1;
+    }
+    *value = fat32_load32(p->data + (cluster % FAT32_PAGE_ENTRIES) * 4) & FAT32_EOC_MAX;
+    return 0;
+}
+
+static int fat32_entry_set(fat32_mount_t* mount, uint32_t cluster, uint32_t value) {
+    fat32_fat_page_t* p = fat32_cache_get(mount, cluster / FAT32_PAGE_ENTRIES);
+    if (!p) {
+        return -1;
+    }
+    uint8_t* entry = p->data + (cluster % FAT32_PAGE_ENTRIES) * 4;
+    /* The top 4 bits are reserved and kept */
+    fat32_store32(entry, (fat32_load32(entry) & 0xF0000000) | (value & FAT32_EOC_MAX));
+    p->dirty = true;
+    return 0;
+}
+
 /**
  * Get FAT entry for a cluster
  */
 uint32_t fat32_get_fat_entry(fat32_mount_t* mount, uint32_t cluster) {
-    uint32_t fat_offset = cluster * 4;
-    uint32_t fat_sector = mount->first_fat_sector + (fat_offset / FAT32_SECTOR_SIZE);
-    uint32_t entry_offset = fat_offset % FAT32_SECTOR_SIZE;
-    
-    /* Read FAT sector (simplified - would use block device driver) */
-    /* In real implementation, would call storage driver to read sector */
-    
-    /* Extract FAT entry (28 bits, mask off top 4 bits) */
-    uint32_t entry = *(uint32_t*)(sector_buffer + entry_offset);
-    return entry & FAT32_EOC_MAX;  /* Use defined constant instead of magic number */
+    if (!mount || !mount->fat_cache || cluster >= fat32_cluster_end(mount)) {
+        return FAT32_BAD_CLUSTER;
+    }
+
+    uint32_t value = FAT32_BAD_CLUSTER;
+    spinlock_acquire(&mount->lock);
+    if (fat32_entry_get(mount, cluster, &value) != 0) {
+        value = FAT32_BAD_CLUSTER;
+    }
+    spinlock_release(&mount->lock);
+    return value;
 }
 
 /**
- * Set FAT entry for a cluster
+ * Set FAT entry for a cluster. The free-cluster bitmap is not touched;
+ * allocation and freeing go through the functions below.
  */
 int fat32_set_fat_entry(fat32_mount_t* mount, uint32_t cluster, uint32_t value) {
-    uint32_t fat_offset = cluster * 4;
-    uint32_t fat_sector = mount->first_fat_sector + (fat_offset / FAT32_SECTOR_SIZE);
-    uint32_t entry_offset = fat_offset % FAT32_SECTOR_SIZE;
-    
-    /* Read FAT sector */
-    /* In real implementation, would call storage driver */
-    
-    /* Update FAT entry (preserve top 4 bits) */
-    uint32_t* entry_ptr = (uint32_t*)(sector_buffer + entry_offset);
-    *entry_ptr = (*entry_ptr & 0xF0000000) | (value & FAT32_EOC_MAX);  /* Use defined constant */
-    
-    /* Write FAT sector back */
-    /* In real implementation, would call storage driver */
-    
+    if (!mount || !mount->fat_cache || cluster < 2 || cluster >= fat32_cluster_end(mount)) {
+        return -1;
+    }
+
+    spinlock_acquire(&mount->lock);
+    int result = fat32_entry_set(mount, cluster, value);
+    spinlock_release(&mount->lock);
+    return result;
+}
+
+/* ============================================================================
+ * FREE-CLUSTER BITMAP
+ * ============================================================================ */
+
+static inline bool fat32_in_use(const fat32_mount_t* mount, uint32_t cluster) {
+    return (mount->cluster_bitmap[cluster / 64] >> (cluster & 63)) & 1;
+}
+
+static void fat32_bitmap_fill(uint64_t* bitmap, uint32_t start, uint32_t count, bool set) {
+    uint32_t c = start;
+    uint32_t end = start + count;
+    while (c < end) {
+        uint32_t in = c & 63;
+        uint32_t n = 64 - in;
+        if (n > end - c) {
+            n = end - c;
+        }
+        uint64_t mask = (n == 64) ? ~0ull : ((1ull << n) - 1) << in;
+        if (set) {
+            bitmap[c / 64] |= mask;
+        } else {
+            bitmap[c / 64] &= ~mask;
+        }
+        c += n;
+    }
+}
+
+/* First cluster from c below end whose bit equals set, or end */
+static uint32_t fat32_bitmap_next(const uint64_t* bitmap, uint32_t c, uint32_t end, bool set) {
+    while (c < end) {
+        uint64_t word = bitmap[c / 64];
+        if (!set) {
+            word = ~word;
+        }
+        word &= ~0ull << (c & 63);
+        if (word) {
+            uint32_t found = (c & ~63u) + (uint32_t)__builtin_ctzll(word);
+            return found < end ? found : end;
+        }
+        c = (c & ~63u) + 64;
+    }
+    return end;
+}
+
+/* First run of count free clusters in [from, to), or 0 */
+static uint32_t fat32_find_run(const fat32_mount_t* mount, uint32_t from, uint32_t to, uint32_t count) {
+    uint32_t c = fat32_bitmap_next(mount->cluster_bitmap, from, to, false);
+    while (c < to) {
+        uint32_t end = fat32_bitmap_next(mount->cluster_bitmap, c, to, true);
+        if (end - c >= count) {
+            return c;
+        }
+        c = fat32_bitmap_next(mount->cluster_bitmap, end, to, false);
+    }
     return 0;
 }
 
+/* Mark clusters in use from a scan of the active FAT */
+static int fat32_build_bitmap(fat32_mount_t* mount) {
+    const fat32_device_t* dev = mount->device;
+    uint32_t end = fat32_cluster_end(mount);
+    size_t words = (end + 63) / 64;
+
+    mount->cluster_bitmap = (uint64_t*)kmalloc(words * sizeof(uint64_t));
+    uint8_t* buffer = (uint8_t*)kmalloc(FAT32_SCAN_SECTORS * FAT32_SECTOR_SIZE);
+    if (!mount->cluster_bitmap || !buffer) {
+        if (buffer) {
+            kfree(buffer);
+        }
+        return -1;
+    }
+    fat_memset(mount->cluster_bitmap, 0, words * sizeof(uint64_t));
+
+    uint64_t fat_start = (uint64_t)mount->first_fat_sector +
+                         (uint64_t)fat32_active_fat(mount) * mount->fat_size;
+    uint32_t free_count = 0;
+    int result = 0;
+    for (uint32_t sector = 0; sector * FAT32_ENTRIES_PER_SECTOR < end && result == 0;
+         sector += FAT32_SCAN_SECTORS) {
+        uint32_t n = mount->fat_size - sector;
+        if (n > FAT32_SCAN_SECTORS) {
+            n = FAT32_SCAN_SECTORS;
+        }
+        if (dev->read(dev->ctx, fat_start + sector, buffer, n) != 0) {
+            result = -1;
+            break;
+        }
+        uint32_t first = sector * FAT32_ENTRIES_PER_SECTOR;
+        uint32_t last = first + n * FAT32_ENTRIES_PER_SECTOR;
+        if (last > end) {
+            last = end;
+        }
+        for (uint32_t c = first < 2 ? 2 : first; c < last; c++) {
+            if (fat32_load32(buffer + (c - first) * 4) & FAT32_EOC_MAX) {
+                mount->cluster_bitmap[c / 64] |= 1ull << (c & 63);
+            } else {
+                free_count++;
+            }
+        }
+    }
+    kfree(buffer);
+
+    /* Clusters 0 and 1, and the padding past the end, are never free */
+    fat32_bitmap_fill(mount->cluster_bitmap, 0, 2, true);
+    fat32_bitmap_fill(mount->cluster_bitmap, end, (uint32_t)(words * 64) - end, true);
+    mount->free_count = free_count;
+    return result;
+}
+
+/* ============================================================================
+ * ALLOCATION
+ * ============================================================================ */
+
 /**
- * Allocate a new cluster
+ * Allocate up to count clusters as one contiguous run: straight after
+ * prev if that is free, else the first free run long enough from the
+ * next-free hint, else the first free run of any length
  */
-uint32_t fat32_allocate_cluster(fat32_mount_t* mount) {
-    /* Search for free cluster starting from cluster 2 */
-    for (uint32_t cluster = 2; cluster < mount->total_clusters; cluster++) {
-        uint32_t entry = fat32_get_fat_entry(mount, cluster);
-        if (entry == FAT32_FREE_CLUSTER) {
-            /* Mark cluster as end of chain */
-            fat32_set_fat_entry(mount, cluster, FAT32_EOC_MAX);
-            return cluster;
+uint32_t fat32_allocate_clusters(fat32_mount_t* mount, uint32_t prev, uint32_t count,
+                                 uint32_t* first) {
+    if (!mount || !mount->cluster_bitmap || !first || count == 0) {
+        return 0;
+    }
+
+    uint32_t end = fat32_cluster_end(mount);
+    if (prev && (prev < 2 || prev >= end)) {
+        return 0;
+    }
+
+    spinlock_acquire(&mount->lock);
+    uint32_t start = 0;
+    uint32_t n = 0;
+    if (prev && prev + 1 < end && !fat32_in_use(mount, prev + 1)) {
+        start = prev + 1;
+        n = fat32_bitmap_next(mount->cluster_bitmap, start, end, true) - start;
+    } else {
+        uint32_t hint = (mount->next_free >= 2 && mount->next_free < end) ? mount->next_free : 2;
+        start = fat32_find_run(mount, hint, end, count);
+        if (!start) {
+            start = fat32_find_run(mount, 2, end, count);
+        }
+        if (start) {
+            n = count;
+        } else {
+            start = fat32_bitmap_next(mount->cluster_bitmap, hint, end, false);
+            if (start == end) {
+                start = fat32_bitmap_next(mount->cluster_bitmap, 2, end, false);
+            }
+            if (start < end) {
+                n = fat32_bitmap_next(mount->cluster_bitmap, start, end, true) - start;
+            }
         }
     }
-    return 0;  /* No free clusters */
+    if (n > count) {
+        n = count;
+    }
+
+    /* Chain the run, end it, then hang it off prev */
+    int result = n ? 0 : -1;
+    for (uint32_t i = 0; i < n && result == 0; i++) {
+        result = fat32_entry_set(mount, start + i, (i + 1 < n) ? start + i + 1 : FAT32_EOC_MAX);
+    }
+    if (result == 0 && prev) {
+        result = fat32_entry_set(mount, prev, start);
+    }
+    if (result == 0) {
+        fat32_bitmap_fill(mount->cluster_bitmap, start, n, true);
+        mount->free_count -= n;
+        mount->next_free = (start + n < end) ? start + n : 2;
+        mount->fsinfo_dirty = true;
+        *first = start;
+    } else {
+        n = 0;
+    }
+    spinlock_release(&mount->lock);
+
+    return n;
 }
 
 /**
- * Free a cluster chain
+ * Allocate a new cluster
+ */
+uint32_t fat32_allocate_cluster(fat32_mount_t* mount) {
+    uint32_t cluster = 0;
+    return fat32_allocate_clusters(mount, 0, 1, &cluster) ? cluster : 0;
+}
+
+/**
+ * Free a cluster chain. Stops with an error at a free or out-of-range
+ * link, or a chain longer than the volume (a loop).
  */
 int fat32_free_cluster_chain(fat32_mount_t* mount, uint32_t start_cluster) {
+    if (!mount || !mount->cluster_bitmap) {
+        return -1;
+    }
+
+    uint32_t end = fat32_cluster_end(mount);
     uint32_t cluster = start_cluster;
-    
-    while (cluster >= 2 && cluster < FAT32_EOC_MIN) {
-        uint32_t next_cluster = fat32_get_fat_entry(mount, cluster);
-        fat32_set_fat_entry(mount, cluster, FAT32_FREE_CLUSTER);
-        cluster = next_cluster;
+    uint32_t steps = 0;
+    int result = 0;
+
+    spinlock_acquire(&mount->lock);
+    while (cluster >= 2 && cluster < FAT32_EOC_MIN && result == 0) {
+        uint32_t next = 0;
+        if (cluster >= end || steps++ >= mount->total_clusters ||
+            fat32_entry_get(mount, cluster, &next) != 0 || next == FAT32_FREE_CLUSTER ||
+            fat32_entry_set(mount, cluster, FAT32_FREE_CLUSTER) != 0) {
+            result = -1;
+            break;
+        }
+        if (fat32_in_use(mount, cluster)) {
+            mount->cluster_bitmap[cluster / 64] &= ~(1ull << (cluster & 63));
+            mount->free_count++;
+        }
+        mount->fsinfo_dirty = true;
+        if (next == FAT32_BAD_CLUSTER) {
+            break;
+        }
+        cluster = next;
+    }
+    spinlock_release(&mount->lock);
+
+    return result;
+}
+
+/* ============================================================================
+ * CLUSTER CHAIN CACHE
+ * ============================================================================ */
+
+void fat32_chain_init(fat32_chain_t* chain, uint32_t first_cluster) {
+    chain->first_cluster = first_cluster;
+    chain->runs = NULL;
+    chain->run_count = 0;
+    chain->run_capacity = 0;
+    chain->clusters = 0;
+    chain->complete = (first_cluster == 0);
+}
+
+void fat32_chain_destroy(fat32_chain_t* chain) {
+    if (chain->runs) {
+        kfree(chain->runs);
+    }
+    fat32_chain_init(chain, 0);
+}
+
+/* Append count clusters from cluster to the mapping */
+static int fat32_chain_push(fat32_chain_t* chain, uint32_t cluster, uint32_t count) {
+    fat32_run_t* last = chain->run_count ? &chain->runs[chain->run_count - 1] : NULL;
+    if (last && last->cluster + last->count == cluster) {
+        last->count += count;
+        chain->clusters += count;
+        return 0;
+    }
+
+    if (chain->run_count == chain->run_capacity) {
+        uint32_t capacity = chain->run_capacity ? chain->run_capacity * 2 : FAT32_MIN_RUNS;
+        fat32_run_t* runs = (fat32_run_t*)kmalloc(capacity * sizeof(fat32_run_t));
+        if (!runs) {
+            return -1;
+        }
+        if (chain->runs) {
+            fat_memcpy(runs, chain->runs, chain->run_count * sizeof(fat32_run_t));
+            kfree(chain->runs);
+        }
+        chain->runs = runs;
+        chain->run_capacity = capacity;
+    }
+    fat32_run_t* run = &chain->runs[chain->run_count++];
+    run->index = chain->clusters;
+    run->cluster = cluster;
+    run->count = count;
+    chain->clusters += count;
+    return 0;
+}
+
+/* Map index to a cluster, and say how many clusters follow it
+ * contiguously in what is mapped */
+static int fat32_chain_find(fat32_mount_t* mount, fat32_chain_t* chain, uint32_t index,
+                            uint32_t* cluster, uint32_t* contiguous) {
+    uint32_t end = fat32_cluster_end(mount);
+
+    if (chain->clusters == 0 && chain->first_cluster) {
+        if (chain->first_cluster < 2 || chain->first_cluster >= end ||
+            fat32_chain_push(chain, chain->first_cluster, 1) != 0) {
+            return -1;
+        }
+    }
+    while (index >= chain->clusters) {
+        if (chain->complete) {
+            return -1;
+        }
+        fat32_run_t* last = &chain->runs[chain->run_count - 1];
+        uint32_t next = fat32_get_fat_entry(mount, last->cluster + last->count - 1);
+        if (next >= FAT32_EOC_MIN) {
+            chain->complete = true;
+            return -1;
+        }
+        if (next < 2 || next >= end || chain->clusters >= mount->total_clusters ||
+            fat32_chain_push(chain, next, 1) != 0) {
+            return -1;
+        }
+    }
+
+    uint32_t lo = 0;
+    uint32_t hi = chain->run_count;
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if (chain->runs[mid].index <= index) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    fat32_run_t* run = &chain->runs[lo];
+    *cluster = run->cluster + (index - run->index);
+    *contiguous = run->count - (index - run->index);
+    return 0;
+}
+
+/**
+ * Map a chain's index-th cluster
+ */
+int fat32_chain_map(fat32_mount_t* mount, fat32_chain_t* chain, uint32_t index,
+                    uint32_t* cluster) {
+    uint32_t contiguous;
+    if (!mount || !chain || !cluster) {
+        return -1;
+    }
+    return fat32_chain_find(mount, chain, index, cluster, &contiguous);
+}
+
+/* ============================================================================
+ * FILE DATA
+ * ============================================================================ */
+
+/* Move bytes between a buffer and the data area from byte offset of
+ * sector, going through a bounce sector at unaligned ends */
+static int fat32_data_rw(fat32_mount_t* mount, uint64_t sector, uint32_t offset,
+                         uint8_t* data, uint32_t size, bool write) {
+    const fat32_device_t* dev = mount->device;
+    uint8_t bounce[FAT32_SECTOR_SIZE];
+
+    sector += offset / FAT32_SECTOR_SIZE;
+    offset %= FAT32_SECTOR_SIZE;
+    while (size > 0) {
+        if (offset == 0 && size >= FAT32_SECTOR_SIZE) {
+            uint32_t count = size / FAT32_SECTOR_SIZE;
+            int result = write ? dev->write(dev->ctx, sector, data, count)
+                               : dev->read(dev->ctx, sector, data, count);
+            if (result != 0) {
+                return -1;
+            }
+            sector += count;
+            data += (size_t)count * FAT32_SECTOR_SIZE;
+            size -= count * FAT32_SECTOR_SIZE;
+            continue;
+        }
+
+        uint32_t n = FAT32_SECTOR_SIZE - offset;
+        if (n > size) {
+            n = size;
+        }
+        if (dev->read(dev->ctx, sector, bounce, 1) != 0) {
+            return -1;
+        }
+        if (write) {
+            fat_memcpy(bounce + offset, data, n);
+            if (dev->write(dev->ctx, sector, bounce, 1) != 0) {
+                return -1;
+            }
+        } else {
+            fat_memcpy(data, bounce + offset, n);
+        }
+        sector++;
+        data += n;
+        size -= n;
+        offset = 0;
+    }
+    return 0;
+}
+
+/* Read or write a byte range already backed by the chain, one device
+ * request per contiguous run */
+static int fat32_file_rw(fat32_mount_t* mount, fat32_file_t* file, uint32_t offset,
+                         uint8_t* data, uint32_t size, bool write) {
+    uint32_t done = 0;
+    while (done < size) {
+        uint32_t pos = offset + done;
+        uint32_t cluster, contiguous;
+        if (fat32_chain_find(mount, &file->chain, pos / mount->bytes_per_cluster,
+                             &cluster, &contiguous) != 0) {
+            return -1;
+        }
+        uint32_t in = pos % mount->bytes_per_cluster;
+        uint64_t span = (uint64_t)contiguous * mount->bytes_per_cluster - in;
+        uint32_t n = (span < size - done) ? (uint32_t)span : size - done;
+        if (fat32_data_rw(mount, fat32_cluster_to_sector(mount, cluster), in,
+                          data + done, n, write) != 0) {
+            return -1;
+        }
+        done += n;
     }
-    
     return 0;
 }
 
+int fat32_file_open(fat32_file_t* file, uint32_t first_cluster, uint32_t size) {
+    if (!file) {
+        return -1;
+    }
+    file->first_cluster = first_cluster;
+    file->size = first_cluster ? size : 0;
+    fat32_chain_init(&file->chain, first_cluster);
+    return 0;
+}
+
+void fat32_file_close(fat32_file_t* file) {
+    if (file) {
+        fat32_chain_destroy(&file->chain);
+    }
+}
+
+/**
+ * Read from a file
+ * @return Bytes read, short at end of file, or -1 on error
+ */
+int fat32_file_read(fat32_mount_t* mount, fat32_file_t* file, uint32_t offset,
+                    void* buffer, uint32_t size) {
+    if (!mount || !file || !buffer || size > 0x7FFFFFFF) {
+        return -1;
+    }
+    if (offset >= file->size) {
+        return 0;
+    }
+    if (size > file->size - offset) {
+        size = file->size - offset;
+    }
+    return fat32_file_rw(mount, file, offset, (uint8_t*)buffer, size, false) == 0 ? (int)size : -1;
+}
+
+/**
+ * Write to a file, growing its chain by contiguous runs first
+ * @return Bytes written, or -1 on error or a full volume
+ */
+int fat32_file_write(fat32_mount_t* mount, fat32_file_t* file, uint32_t offset,
+                     const void* buffer, uint32_t size) {
+    if (!mount || !file || !buffer || size > 0x7FFFFFFF || offset > file->size ||
+        (uint64_t)offset + size > 0xFFFFFFFFull) {
+        return -1;
+    }
+    if (size == 0) {
+        return 0;
+    }
+
+    /* Map the whole existing chain: it may run past the file's size */
+    uint32_t cluster, contiguous;
+    while (!file->chain.complete &&
+           fat32_chain_find(mount, &file->chain, file->chain.clusters, &cluster, &contiguous) == 0) {
+    }
+    if (!file->chain.complete) {
+        return -1;
+    }
+
+    uint32_t needed = (uint32_t)(((uint64_t)offset + size + mount->bytes_per_cluster - 1) /
+                                 mount->bytes_per_cluster);
+    while (file->chain.clusters < needed) {
+        fat32_run_t* last = file->chain.run_count ? &file->chain.runs[file->chain.run_count - 1] : NULL;
+        uint32_t prev = last ? last->cluster + last->count - 1 : 0;
+        uint32_t first;
+        uint32_t n = fat32_allocate_clusters(mount, prev, needed - file->chain.clusters, &first);
+        if (n == 0) {
+            return -1;
+        }
+        if (!file->first_cluster) {
+            file->first_cluster = first;
+            file->chain.first_cluster = first;
+        }
+        if (fat32_chain_push(&file->chain, first, n) != 0) {
+            return -1;
+        }
+    }
+
+    if (fat32_file_rw(mount, file, offset, (uint8_t*)buffer, size, true) != 0) {
+        return -1;
+    }
+    if (offset + size > file->size) {
+        file->size = offset + size;
+    }
+    return (int)size;
+}
+
 /**
  * Convert FAT32 attributes to VFS file type
  */
@@ -165,6 +797,19 @@ static void fat32_parse_short_name(const uint8_t* short_name, char* output) {
     output[out_idx] = '\0';
 }
 
+/* Release what a mount allocated */
+static void fat32_release(fat32_mount_t* mount) {
+    if (mount->fat_cache) {
+        kfree(mount->fat_cache);
+        mount->fat_cache = NULL;
+    }
+    if (mount->cluster_bitmap) {
+        kfree(mount->cluster_bitmap);
+        mount->cluster_bitmap = NULL;
+    }
+    mount->device = NULL;
+}
+
 /**
  * Mount FAT32 file system
  */
@@ -172,37 +817,158 @@ static int fat32_mount(const char* device) {
     if (g_fat32_mounted) {
         return -1;  /* Already mounted */
     }
-    
-    /* Read boot sector (simplified - would use storage driver) */
-    /* In real implementation, would call storage driver to read sector 0 */
-    fat32_boot_sector_t* boot_sector = (fat32_boot_sector_t*)sector_buffer;
-    
-    /* Verify FAT32 signature */
-    if (boot_sector->boot_signature != FAT32_BOOT_SIGNATURE) {
+
+    const fat32_device_t* dev = fat32_find_device(device);
+    if (!dev) {
+        return -1;
+    }
+
+    /* Read boot sector */
+    uint8_t* sector = (uint8_t*)kmalloc(FAT32_SECTOR_SIZE);
+    if (!sector) {
+        return -1;
+    }
+    if (dev->read(dev->ctx, 0, sector, 1) != 0) {
+        kfree(sector);
+        return -1;
+    }
+    fat32_boot_sector_t* boot_sector = (fat32_boot_sector_t*)sector;
+
+    /* Verify FAT32 signature and geometry */
+    uint32_t spc = boot_sector->sectors_per_cluster;
+    uint32_t total_sectors = boot_sector->total_sectors_32;
+    uint32_t first_data_sector = boot_sector->reserved_sector_count +
+                                 boot_sector->num_fats * boot_sector->fat_size_32;
+    if (boot_sector->boot_signature != FAT32_BOOT_SIGNATURE ||
+        (sector[510] | (sector[511] << 8)) != FAT32_SIGNATURE ||
+        boot_sector->bytes_per_sector != FAT32_SECTOR_SIZE ||
+        spc == 0 || (spc & (spc - 1)) != 0 || boot_sector->num_fats == 0 ||
+        boot_sector->fat_size_32 == 0 || boot_sector->root_entry_count != 0 ||
+        boot_sector->reserved_sector_count == 0 || total_sectors > dev->sectors ||
+        first_data_sector + spc > total_sectors) {
+        kfree(sector);
         return -1;  /* Invalid boot sector */
     }
-    
+
     /* Calculate file system parameters */
-    g_fat32_mount.first_fat_sector = boot_sector->reserved_sector_count;
-    g_fat32_mount.fat_size = boot_sector->fat_size_32;
-    g_fat32_mount.num_fats = boot_sector->num_fats;
-    g_fat32_mount.first_data_sector = g_fat32_mount.first_fat_sector + 
-                                      (g_fat32_mount.num_fats * g_fat32_mount.fat_size);
-    g_fat32_mount.root_cluster = boot_sector->root_cluster;
-    g_fat32_mount.sectors_per_cluster = boot_sector->sectors_per_cluster;
-    g_fat32_mount.bytes_per_cluster = boot_sector->sectors_per_cluster * 
-                                      boot_sector->bytes_per_sector;
-    
-    uint32_t total_sectors = boot_sector->total_sectors_32;
-    uint32_t data_sectors = total_sectors - g_fat32_mount.first_data_sector;
-    g_fat32_mount.total_clusters = data_sectors / g_fat32_mount.sectors_per_cluster;
-    
-    g_fat32_mount.device = (void*)device;
+    fat32_mount_t* mount = &g_fat32_mount;
+    fat_memset(mount, 0, sizeof(*mount));
+    mount->first_fat_sector = boot_sector->reserved_sector_count;
+    mount->fat_size = boot_sector->fat_size_32;
+    mount->num_fats = boot_sector->num_fats;
+    mount->first_data_sector = first_data_sector;
+    mount->root_cluster = boot_sector->root_cluster;
+    mount->sectors_per_cluster = spc;
+    mount->bytes_per_cluster = spc * FAT32_SECTOR_SIZE;
+    mount->ext_flags = boot_sector->ext_flags;
+    mount->fsinfo_sector = (boot_sector->fs_info && boot_sector->fs_info != 0xFFFF &&
+                            boot_sector->fs_info < boot_sector->reserved_sector_count)
+                           ? boot_sector->fs_info : 0;
+
+    /* Clusters beyond what the FAT can describe are unusable */
+    uint32_t total_clusters = (total_sectors - first_data_sector) / spc;
+    uint32_t fat_entries = mount->fat_size * FAT32_ENTRIES_PER_SECTOR;
+    if (total_clusters > fat_entries - 2) {
+        total_clusters = fat_entries - 2;
+    }
+    if (total_clusters > FAT32_RESERVED_MIN - 2) {
+        total_clusters = FAT32_RESERVED_MIN - 2;
+    }
+    mount->total_clusters = total_clusters;
+    mount->device = dev;
+    spinlock_init(&mount->lock);
+
+    if (mount->root_cluster < 2 || mount->root_cluster >= fat32_cluster_end(mount)) {
+        kfree(sector);
+        fat32_release(mount);
+        return -1;
+    }
+
+    /* The FSInfo next-free hint seeds where allocation starts */
+    uint32_t stored_free = FAT32_FSINFO_UNKNOWN;
+    mount->next_free = 2;
+    if (mount->fsinfo_sector && dev->read(dev->ctx, mount->fsinfo_sector, sector, 1) == 0) {
+        fat32_fsinfo_t* fsinfo = (fat32_fsinfo_t*)sector;
+        if (fsinfo->lead_signature == FAT32_FSINFO_LEAD_SIG &&
+            fsinfo->struct_signature == FAT32_FSINFO_STRUCT_SIG) {
+            stored_free = fsinfo->free_count;
+            if (fsinfo->next_free >= 2 && fsinfo->next_free < fat32_cluster_end(mount)) {
+                mount->next_free = fsinfo->next_free;
+            }
+        } else {
+            mount->fsinfo_sector = 0;
+        }
+    } else {
+        mount->fsinfo_sector = 0;
+    }
+    kfree(sector);
+
+    mount->fat_cache = (fat32_fat_page_t*)kmalloc(FAT32_CACHE_PAGES * sizeof(fat32_fat_page_t));
+    if (!mount->fat_cache) {
+        fat32_release(mount);
+        return -1;
+    }
+    for (uint32_t i = 0; i < FAT32_CACHE_PAGES; i++) {
+        mount->fat_cache[i].valid = false;
+        mount->fat_cache[i].dirty = false;
+    }
+
+    /* The free count in FSInfo is only advisory: count for ourselves */
+    if (fat32_build_bitmap(mount) != 0) {
+        fat32_release(mount);
+        return -1;
+    }
+    mount->fsinfo_dirty = (stored_free != mount->free_count);
+
     g_fat32_mounted = true;
-    
     return 0;
 }
 
+/**
+ * Write back dirty FAT pages, then the free count and next-free hint
+ */
+int fat32_sync(fat32_mount_t* mount) {
+    if (!mount || !mount->device || !mount->fat_cache) {
+        return -1;
+    }
+
+    const fat32_device_t* dev = mount->device;
+    uint8_t* sector = (uint8_t*)kmalloc(FAT32_SECTOR_SIZE);
+    if (!sector) {
+        return -1;
+    }
+
+    int result = 0;
+    spinlock_acquire(&mount->lock);
+    for (uint32_t i = 0; i < FAT32_CACHE_PAGES && result == 0; i++) {
+        fat32_fat_page_t* p = &mount->fat_cache[i];
+        if (p->valid && p->dirty) {
+            result = fat32_cache_writeback(mount, p);
+        }
+    }
+
+    /* FSInfo after the FAT, so it never claims space the FAT lacks */
+    if (result == 0 && mount->fsinfo_sector && mount->fsinfo_dirty) {
+        result = dev->read(dev->ctx, mount->fsinfo_sector, sector, 1);
+        if (result == 0) {
+            fat32_fsinfo_t* fsinfo = (fat32_fsinfo_t*)sector;
+            fsinfo->free_count = mount->free_count;
+            fsinfo->next_free = mount->next_free;
+            result = dev->write(dev->ctx, mount->fsinfo_sector, sector, 1);
+        }
+        if (result == 0) {
+            mount->fsinfo_dirty = false;
+        }
+    }
+    spinlock_release(&mount->lock);
+
+    if (result == 0 && dev->flush) {
+        result = dev->flush(dev->ctx);
+    }
+    kfree(sector);
+    return result == 0 ? 0 : -1;
+}
+
 /**
  * Unmount FAT32 file system
  */
@@ -210,11 +976,12 @@ static int fat32_unmount(void) {
     if (!g_fat32_mounted) {
         return -1;
     }
-    
+
+    int result = fat32_sync(&g_fat32_mount);
+    fat32_release(&g_fat32_mount);
     g_fat32_mounted = false;
-    g_fat32_mount.device = NULL;
-    
-    return 0;
+
+    return result;
 }
 
 /**
@@ -238,6 +1005,8 @@ static inode_t* fat32_lookup(const char* path) {
         root_inode->size = 0;
         root_inode->mode = DEFAULT_DIR_MODE;
         root_inode->fs_data = (void*)(uintptr_t)current_cluster;
+        root_inode->fops = NULL;
+        page_cache_mapping_init(&root_inode->mapping, root_inode);
         
         return root_inode;
     }
@@ -352,6 +1121,13 @@ static int fat32_rename(const char* oldpath, const char* newpath) {
     return 0;
 }
 
+/**
+ * Get the mounted volume, or NULL
+ */
+fat32_mount_t* fat32_get_mount(void) {
+    return g_fat32_mounted ? &g_fat32_mount : NULL;
+}
+
 /**
  * Get FAT32 file system operations
  */
@@ -2,6 +2,14 @@
  * Aurora OS - FAT32 File System Driver
  * 
  * FAT32 file system driver for compatibility with Windows and removable media
+ *
+ * The FAT is read through a cache of multi-sector pages; changed pages
+ * are written back to every FAT copy (or only the active one when
+ * mirroring is disabled) on eviction and sync. Which clusters are free
+ * is kept in a bitmap built from the FAT at mount, so allocation never
+ * scans the FAT, and files grow by runs of contiguous clusters. Open
+ * files map cluster indexes to clusters through a cache of the chain's
+ * contiguous runs, so a seek does not walk the FAT.
  */
 
 #ifndef AURORA_FAT32_H
@@ -9,7 +17,9 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 #include "../vfs/vfs.h"
+#include "../../kernel/smp/spinlock.h"
 
 /* FAT32 constants */
 #define FAT32_SIGNATURE         0xAA55
@@ -18,6 +28,23 @@
 #define FAT32_SECTOR_SIZE       512
 #define FAT32_MAX_PATH          260
 #define FAT32_MAX_FILENAME      255
+#define FAT32_MAX_DEVICES       8
+#define FAT32_ENTRIES_PER_SECTOR (FAT32_SECTOR_SIZE / 4)
+
+/* FSInfo signatures, and the value for an unknown count or hint */
+#define FAT32_FSINFO_LEAD_SIG   0x41615252
+#define FAT32_FSINFO_STRUCT_SIG 0x61417272
+#define FAT32_FSINFO_TRAIL_SIG  0xAA550000
+#define FAT32_FSINFO_UNKNOWN    0xFFFFFFFF
+
+/* ext_flags: with NO_MIRROR set only the FAT numbered in ACTIVE is used */
+#define FAT32_EXT_ACTIVE_MASK   0x000F
+#define FAT32_EXT_NO_MIRROR     0x0080
+
+/* FAT cache geometry */
+#define FAT32_CACHE_SECTORS     8       /* FAT sectors per cache page */
+#define FAT32_CACHE_WAYS        4
+#define FAT32_CACHE_PAGES       64
 
 /* FAT entry values */
 #define FAT32_FREE_CLUSTER      0x00000000
@@ -106,6 +133,32 @@ typedef struct __attribute__((packed)) {
     uint16_t name3[2];
 } fat32_lfn_entry_t;
 
+/* Block device holding a volume, in FAT32_SECTOR_SIZE sectors. flush
+ * may be NULL when writes are durable on return. */
+typedef struct {
+    uint64_t sectors;
+    void* ctx;
+    int (*read)(void* ctx, uint64_t sector, void* data, uint32_t count);
+    int (*write)(void* ctx, uint64_t sector, const void* data, uint32_t count);
+    int (*flush)(void* ctx);
+} fat32_device_t;
+
+/* One cached run of FAT sectors */
+typedef struct {
+    uint32_t page;                  /* FAT sector / FAT32_CACHE_SECTORS */
+    uint32_t last_use;
+    bool     valid;
+    bool     dirty;
+    uint8_t  data[FAT32_CACHE_SECTORS * FAT32_SECTOR_SIZE];
+} fat32_fat_page_t;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t writebacks;            /* Dirty pages written out */
+    uint64_t sectors_written;       /* FAT sectors written, all copies */
+} fat32_cache_stats_t;
+
 /* FAT32 mount information */
 typedef struct {
     uint32_t first_data_sector;
@@ -113,25 +166,106 @@ typedef struct {
     uint32_t root_cluster;
     uint32_t sectors_per_cluster;
     uint32_t bytes_per_cluster;
-    uint32_t total_clusters;
+    uint32_t total_clusters;        /* Data clusters, numbered from 2 */
     uint32_t fat_size;
     uint8_t  num_fats;
-    void*    device;
+    const fat32_device_t* device;
+    uint16_t ext_flags;
+    uint32_t fsinfo_sector;         /* 0 if the volume has none */
+    spinlock_t lock;                /* Protects everything below */
+    fat32_fat_page_t* fat_cache;    /* FAT32_CACHE_PAGES, in sets of FAT32_CACHE_WAYS */
+    uint32_t cache_clock;
+    uint64_t* cluster_bitmap;       /* Set bits are clusters in use */
+    uint32_t free_count;
+    uint32_t next_free;             /* Where the next search starts */
+    bool     fsinfo_dirty;
+    fat32_cache_stats_t cache_stats;
 } fat32_mount_t;
 
+/* A run of contiguous clusters in a chain: file clusters index to
+ * index + count - 1 are clusters cluster to cluster + count - 1 */
+typedef struct {
+    uint32_t index;
+    uint32_t cluster;
+    uint32_t count;
+} fat32_run_t;
+
+/* Cached mapping of a cluster chain, filled in as it is walked */
+typedef struct {
+    uint32_t first_cluster;
+    fat32_run_t* runs;
+    uint32_t run_count;
+    uint32_t run_capacity;
+    uint32_t clusters;              /* Clusters mapped so far */
+    bool     complete;              /* Walked to the end of the chain */
+} fat32_chain_t;
+
+/* Open file: its data is the chain from first_cluster (0 while empty) */
+typedef struct {
+    uint32_t first_cluster;
+    uint32_t size;
+    fat32_chain_t chain;
+} fat32_file_t;
+
 /* FAT32 initialization */
 void fat32_init(void);
 int fat32_mount_device(const char* device);
 int fat32_unmount_device(void);
 
+/* Make a device mountable under a name; dev must outlive the mount */
+int fat32_register_device(const char* name, const fat32_device_t* dev);
+
+/* The mounted volume, or NULL */
+fat32_mount_t* fat32_get_mount(void);
+
+/**
+ * Write back dirty FAT pages to every FAT copy, then FSInfo
+ * @return 0 on success, -1 on a device error
+ */
+int fat32_sync(fat32_mount_t* mount);
+
 /* Get FAT32 file system operations */
 fs_ops_t* fat32_get_ops(void);
 
-/* FAT32 utility functions */
+/* FAT32 utility functions. fat32_get_fat_entry returns FAT32_BAD_CLUSTER
+ * for a cluster out of range or a FAT that cannot be read. */
 uint32_t fat32_cluster_to_sector(fat32_mount_t* mount, uint32_t cluster);
 uint32_t fat32_get_fat_entry(fat32_mount_t* mount, uint32_t cluster);
 int fat32_set_fat_entry(fat32_mount_t* mount, uint32_t cluster, uint32_t value);
 uint32_t fat32_allocate_cluster(fat32_mount_t* mount);
 int fat32_free_cluster_chain(fat32_mount_t* mount, uint32_t start_cluster);
 
+/**
+ * Allocate up to count clusters as one contiguous run, chained in order
+ * and ended with end-of-chain. With prev non-zero the run is linked
+ * after it, and starts right after it when those clusters are free.
+ * @param first Set to the run's first cluster
+ * @return Clusters allocated, fewer than count if no run that long is
+ *         free, 0 if the volume is full
+ */
+uint32_t fat32_allocate_clusters(fat32_mount_t* mount, uint32_t prev, uint32_t count,
+                                 uint32_t* first);
+
+/* Cluster chain cache */
+void fat32_chain_init(fat32_chain_t* chain, uint32_t first_cluster);
+void fat32_chain_destroy(fat32_chain_t* chain);
+
+/**
+ * Cluster holding a chain's index-th cluster, walking the FAT only past
+ * what is already mapped
+ * @return 0 on success, -1 past the end of the chain or on a bad chain
+ */
+int fat32_chain_map(fat32_mount_t* mount, fat32_chain_t* chain, uint32_t index,
+                    uint32_t* cluster);
+
+/* File data, by first cluster. Writes may extend a file from its end
+ * but not start past it; the caller updates the directory entry from
+ * first_cluster and size. */
+int fat32_file_open(fat32_file_t* file, uint32_t first_cluster, uint32_t size);
+void fat32_file_close(fat32_file_t* file);
+int fat32_file_read(fat32_mount_t* mount, fat32_file_t* file, uint32_t offset,
+                    void* buffer, uint32_t size);
+int fat32_file_write(fat32_mount_t* mount, fat32_file_t* file, uint32_t offset,
+                     const void* buffer, uint32_t size);
+
 #endif /* AURORA_FAT32_H */
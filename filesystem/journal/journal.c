@@ -1,51 +1,439 @@
 /**
  * Aurora OS - Journaling Layer Implementation
- * 
+ *
  * Transaction journaling for file system integrity
+ *
+ * Device layout: superblock copies in blocks 0 and 1, then the log as a
+ * ring of blocks. A group is a record of whole blocks that may wrap
+ * around the end of the ring:
+ *
+ *   header   magic, seq, blocks, txn_count, op_count, bytes
+ *   ops      txn_id, type, block_num, data_size, data padded to 4 bytes
+ *   commit   last block: magic, seq, blocks, CRC32C of everything before
+ *
+ * The superblock names the oldest group not yet checkpointed (the tail)
+ * and its sequence number; groups follow it with consecutive numbers.
+ * Replay walks from the tail until a group has the wrong magic or
+ * sequence number or fails its checksum.
+ *
+ * One committer at a time writes the log. Transactions queue on commit;
+ * whoever finds no commit in flight takes the whole queue (up to a
+ * quarter of the log) as the next group, and the others sleep on
+ * journal_waiters until it is written, as callers of a checkpoint in
+ * progress sleep until it is done.
+ * Space is reserved under the lock and handed back if the write fails,
+ * so the log never has holes. A checkpoint applies the oldest durable
+ * groups, syncs the home blocks, then moves the tail in the superblock;
+ * only after that flush may new groups reuse the space.
+ *
+ * The checkpointer follows the writeback flushers: a kernel process that
+ * sleeps until a commit posts checkpoint_wake or the interval is up. Host
+ * builds (AURORA_STANDALONE) start no process; commits checkpoint
+ * directly when the log is full.
  */
 
 #include "journal.h"
 #include "../../kernel/memory/memory.h"
 #include "../../kernel/drivers/timer.h"
+#include "../../kernel/smp/spinlock.h"
+#ifndef AURORA_STANDALONE
+#include "../../kernel/process/process.h"
+#include "../../kernel/process/wait.h"
+#include "../../kernel/core/timing_system.h"
+#endif
 #include <stddef.h>
 
+#define JOURNAL_MAGIC           0x4A524E4C  /* 'JRNL' */
+#define JOURNAL_VERSION         2
+#define JOURNAL_RECORD_MAGIC    0x4A524543  /* 'JREC' */
+#define JOURNAL_COMMIT_MAGIC    0x4A434D54  /* 'JCMT' */
+
+/* Group record header, at the start of its first block */
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t blocks;                /* Commit block included */
+    uint32_t txn_count;
+    uint32_t op_count;
+    uint32_t bytes;                 /* Header and ops, before padding */
+} journal_record_t;
+
+/* Operation entry, followed by its data */
+typedef struct {
+    uint32_t txn_id;
+    uint32_t type;
+    uint32_t block_num;
+    uint32_t data_size;
+} journal_record_op_t;
+
+/* Commit block; the checksum covers the record up to this field */
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t blocks;
+    uint32_t checksum;
+} journal_commit_t;
+
+/* A group in the log, oldest first */
+typedef struct journal_group {
+    uint32_t seq;
+    uint32_t start;                 /* Log block */
+    uint32_t blocks;
+    uint32_t txn_count;
+    int durable;                    /* Its flush has completed */
+    uint8_t* record;                /* Kept for the checkpoint if the device applies */
+    struct journal_group* next;
+} journal_group_t;
+
 /* Journal state */
 static journal_superblock_t journal_sb;
 static transaction_t transactions[JOURNAL_MAX_TRANSACTIONS];
 static uint32_t current_txn_count = 0;
 static uint32_t journal_enabled = 0;
+static spinlock_t journal_lock;
+
+/* Log state */
+static journal_device_t journal_dev;
+static uint32_t log_size = 0;       /* Blocks in the ring */
+static uint32_t log_head = 0;       /* Next block to write */
+static uint32_t log_tail = 0;       /* Oldest block not checkpointed */
+static uint32_t log_used = 0;
+static uint32_t next_seq = 1;       /* Sequence number of the next group */
+static journal_group_t* groups_head = NULL;
+static journal_group_t* groups_tail = NULL;
+static transaction_t* queue_head = NULL;
+static transaction_t* queue_tail = NULL;
+static int committing = 0;
+static int checkpointing = 0;
+static volatile uint32_t checkpoint_wake = 0;
+static journal_stats_t journal_stats;
+#ifndef AURORA_STANDALONE
+static process_t* checkpointer = NULL;
+static wait_queue_t journal_waiters;   /* Waiting for a commit or checkpoint */
+#endif
 
-/* Journal buffer for persistence simulation */
+/* Built-in log in memory, used until a filesystem supplies a device */
 #define JOURNAL_BUFFER_SIZE (JOURNAL_BLOCK_SIZE * 1024) /* 512KB journal */
 static uint8_t journal_buffer[JOURNAL_BUFFER_SIZE];
-static uint32_t journal_buffer_offset = 0;
+
+static void journal_memcpy(void* dest, const void* src, size_t size) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+    for (size_t i = 0; i < size; i++) {
+        d[i] = s[i];
+    }
+}
+
+static void journal_memset(void* dest, uint8_t value, size_t size) {
+    uint8_t* d = (uint8_t*)dest;
+    for (size_t i = 0; i < size; i++) {
+        d[i] = value;
+    }
+}
+
+static int memory_read(void* ctx, uint32_t block, void* data, uint32_t count) {
+    (void)ctx;
+    journal_memcpy(data, journal_buffer + (size_t)block * JOURNAL_BLOCK_SIZE,
+                   (size_t)count * JOURNAL_BLOCK_SIZE);
+    return 0;
+}
+
+static int memory_write(void* ctx, uint32_t block, const void* data, uint32_t count) {
+    (void)ctx;
+    journal_memcpy(journal_buffer + (size_t)block * JOURNAL_BLOCK_SIZE, data,
+                   (size_t)count * JOURNAL_BLOCK_SIZE);
+    return 0;
+}
+
+static const journal_device_t memory_device = {
+    JOURNAL_BUFFER_SIZE / JOURNAL_BLOCK_SIZE, NULL,
+    memory_read, memory_write, NULL, NULL, NULL
+};
+
+/* ---- CRC32C (Castagnoli, reflected) ---- */
+
+static uint32_t crc32c_table[256];
+static int crc32c_ready = 0;
+
+static void crc32c_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78 : 0);
+        }
+        crc32c_table[i] = crc;
+    }
+    crc32c_ready = 1;
+}
+
+static uint32_t crc32c(uint32_t crc, const void* data, size_t size) {
+    const uint8_t* p = (const uint8_t*)data;
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = crc32c_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/* ---- Log I/O ---- */
+
+static uint32_t log_wrap(uint32_t block) {
+    return block >= log_size ? block - log_size : block;
+}
 
 /**
- * Initialize journaling subsystem
+ * Read or write count blocks of the ring starting at log block start
  */
-void journal_init(void) {
-    /* Initialize journal superblock */
-    journal_sb.magic = 0x4A524E4C; /* 'JRNL' */
-    journal_sb.version = 1;
-    journal_sb.block_size = JOURNAL_BLOCK_SIZE;
-    journal_sb.total_blocks = JOURNAL_BUFFER_SIZE / JOURNAL_BLOCK_SIZE;
-    journal_sb.next_txn_id = 1;
-    
+static int log_io(uint32_t start, void* data, uint32_t count, int write) {
+    uint8_t* buf = (uint8_t*)data;
+    while (count > 0) {
+        uint32_t chunk = log_size - start;
+        if (chunk > count) {
+            chunk = count;
+        }
+        uint32_t block = JOURNAL_SB_BLOCKS + start;
+        int result = write ? journal_dev.write(journal_dev.ctx, block, buf, chunk)
+                           : journal_dev.read(journal_dev.ctx, block, buf, chunk);
+        if (result != 0) {
+            return -1;
+        }
+        buf += (size_t)chunk * JOURNAL_BLOCK_SIZE;
+        count -= chunk;
+        start = 0;
+    }
+    return 0;
+}
+
+static int dev_flush(void) {
+    return journal_dev.flush ? journal_dev.flush(journal_dev.ctx) : 0;
+}
+
+static uint32_t sb_checksum(const journal_superblock_t* sb) {
+    return crc32c(0, sb, offsetof(journal_superblock_t, checksum));
+}
+
+/**
+ * Write the superblock into the older copy's slot and flush
+ */
+static int write_superblock(void) {
+    uint8_t block[JOURNAL_BLOCK_SIZE];
+
+    journal_sb.generation++;
+    journal_sb.checksum = sb_checksum(&journal_sb);
+    journal_memset(block, 0, sizeof(block));
+    journal_memcpy(block, &journal_sb, sizeof(journal_sb));
+
+    if (journal_dev.write(journal_dev.ctx, journal_sb.generation & 1, block, 1) != 0) {
+        return -1;
+    }
+    return dev_flush();
+}
+
+/**
+ * Apply one operation to its home block
+ */
+static int apply_operation(journal_operation_t* op) {
+    if (!op) {
+        return -1;
+    }
+
+    switch (op->type) {
+        case JOURNAL_OP_CREATE:
+        case JOURNAL_OP_DELETE:
+            /* No data; the device decides what they mean */
+            break;
+
+        case JOURNAL_OP_WRITE:
+        case JOURNAL_OP_METADATA:
+            break;
+
+        default:
+            return -1;
+    }
+
+    if (journal_dev.apply) {
+        return journal_dev.apply(journal_dev.ctx, op);
+    }
+    return 0;
+}
+
+/**
+ * Check a record read from the log
+ * @return 0 if it is group seq and intact
+ */
+static int check_record(const uint8_t* record, uint32_t blocks, uint32_t seq) {
+    const journal_record_t* hdr = (const journal_record_t*)record;
+    const journal_commit_t* commit =
+        (const journal_commit_t*)(record + (size_t)(blocks - 1) * JOURNAL_BLOCK_SIZE);
+    size_t covered = (size_t)(blocks - 1) * JOURNAL_BLOCK_SIZE + offsetof(journal_commit_t, checksum);
+
+    if (hdr->magic != JOURNAL_RECORD_MAGIC || hdr->seq != seq || hdr->blocks != blocks) {
+        return -1;
+    }
+    if (commit->magic != JOURNAL_COMMIT_MAGIC || commit->seq != seq || commit->blocks != blocks) {
+        return -1;
+    }
+    return crc32c(0, record, covered) == commit->checksum ? 0 : -1;
+}
+
+/**
+ * Apply every operation in a checked record
+ * @param max_txn_id Raised to the highest transaction ID seen; may be NULL
+ */
+static int apply_record(const uint8_t* record, uint32_t* max_txn_id) {
+    const journal_record_t* hdr = (const journal_record_t*)record;
+    uint32_t offset = sizeof(journal_record_t);
+
+    for (uint32_t i = 0; i < hdr->op_count; i++) {
+        if (offset + sizeof(journal_record_op_t) > hdr->bytes) {
+            return -1;
+        }
+        const journal_record_op_t* entry = (const journal_record_op_t*)(record + offset);
+        offset += sizeof(journal_record_op_t);
+        if (entry->data_size > hdr->bytes - offset) {
+            return -1;
+        }
+
+        journal_operation_t op;
+        op.type = (journal_op_type_t)entry->type;
+        op.block_num = entry->block_num;
+        op.old_data = NULL;
+        op.new_data = entry->data_size ? (void*)(record + offset) : NULL;
+        op.data_size = entry->data_size;
+        if (apply_operation(&op) != 0) {
+            return -1;
+        }
+
+        if (max_txn_id && entry->txn_id > *max_txn_id) {
+            *max_txn_id = entry->txn_id;
+        }
+        offset += (entry->data_size + 3) & ~3u;
+    }
+    return 0;
+}
+
+/* ---- Setup ---- */
+
+static void free_op_data(transaction_t* txn) {
+    for (uint32_t i = 0; i < txn->op_count; i++) {
+        journal_operation_t* op = &txn->operations[i];
+        if (op->old_data) {
+            kfree(op->old_data);
+            op->old_data = NULL;
+        }
+        if (op->new_data) {
+            kfree(op->new_data);
+            op->new_data = NULL;
+        }
+    }
+}
+
+/**
+ * Forget the log and every transaction, and switch devices
+ */
+static void reset_state(const journal_device_t* dev) {
+    if (!crc32c_ready) {
+        crc32c_init();
+    }
+    spinlock_init(&journal_lock);
+
+    while (groups_head) {
+        journal_group_t* group = groups_head;
+        groups_head = group->next;
+        if (group->record) {
+            kfree(group->record);
+        }
+        kfree(group);
+    }
+    groups_tail = NULL;
+    queue_head = NULL;
+    queue_tail = NULL;
+    committing = 0;
+    checkpointing = 0;
+    checkpoint_wake = 0;
+
     /* Initialize transaction array */
     for (uint32_t i = 0; i < JOURNAL_MAX_TRANSACTIONS; i++) {
         transactions[i].txn_id = 0;
         transactions[i].state = TRANSACTION_ABORTED;
         transactions[i].timestamp = 0;
         transactions[i].op_count = 0;
+        transactions[i].error = 0;
+        transactions[i].next = NULL;
     }
-    
-    /* Initialize journal buffer */
-    for (uint32_t i = 0; i < JOURNAL_BUFFER_SIZE; i++) {
-        journal_buffer[i] = 0;
-    }
-    journal_buffer_offset = 0;
-    
     current_txn_count = 0;
+
+    journal_dev = dev ? *dev : memory_device;
+    log_size = journal_dev.blocks > JOURNAL_SB_BLOCKS ? journal_dev.blocks - JOURNAL_SB_BLOCKS : 0;
+    log_used = 0;
+    journal_memset(&journal_stats, 0, sizeof(journal_stats));
+}
+
+int journal_format(const journal_device_t* dev) {
+    if (dev && (dev->blocks < JOURNAL_MIN_BLOCKS || !dev->read || !dev->write)) {
+        return -1;
+    }
+    reset_state(dev);
+
+    /* Initialize journal superblock */
+    journal_sb.magic = JOURNAL_MAGIC;
+    journal_sb.version = JOURNAL_VERSION;
+    journal_sb.block_size = JOURNAL_BLOCK_SIZE;
+    journal_sb.total_blocks = journal_dev.blocks;
+    journal_sb.next_txn_id = 1;
+    journal_sb.generation = 0;
+    journal_sb.start_block = 0;
+    journal_sb.start_seq = 1;
+    log_head = log_tail = 0;
+    next_seq = 1;
+
+    /* Both copies, so a stale one from an older log cannot win */
+    if (write_superblock() != 0 || write_superblock() != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int journal_load(const journal_device_t* dev) {
+    if (dev && (dev->blocks < JOURNAL_MIN_BLOCKS || !dev->read || !dev->write)) {
+        return -1;
+    }
+    reset_state(dev);
+
+    /* Take the newer valid copy */
+    int found = 0;
+    for (uint32_t copy = 0; copy < JOURNAL_SB_BLOCKS; copy++) {
+        uint8_t block[JOURNAL_BLOCK_SIZE];
+        if (journal_dev.read(journal_dev.ctx, copy, block, 1) != 0) {
+            continue;
+        }
+        journal_superblock_t sb;
+        journal_memcpy(&sb, block, sizeof(sb));
+        if (sb.magic != JOURNAL_MAGIC || sb.version != JOURNAL_VERSION ||
+            sb.checksum != sb_checksum(&sb) || sb.total_blocks != journal_dev.blocks ||
+            sb.start_block >= log_size) {
+            continue;
+        }
+        if (!found || (int32_t)(sb.generation - journal_sb.generation) > 0) {
+            journal_sb = sb;
+            found = 1;
+        }
+    }
+    if (!found) {
+        return -1;
+    }
+
+    log_head = log_tail = journal_sb.start_block;
+    next_seq = journal_sb.start_seq;
+    return 0;
+}
+
+/**
+ * Initialize journaling subsystem
+ */
+void journal_init(void) {
+    journal_memset(journal_buffer, 0, JOURNAL_BUFFER_SIZE);
+    journal_format(NULL);
     journal_enabled = 1;
 }
 
@@ -77,32 +465,49 @@ transaction_t* journal_begin_transaction(void) {
     if (!journal_enabled) {
         return NULL;
     }
-    
+
+    spinlock_acquire(&journal_lock);
+
     /* Find free transaction slot */
     transaction_t* txn = NULL;
     for (uint32_t i = 0; i < JOURNAL_MAX_TRANSACTIONS; i++) {
-        if (transactions[i].state == TRANSACTION_ABORTED || 
+        if (transactions[i].state == TRANSACTION_ABORTED ||
             transactions[i].state == TRANSACTION_COMPLETED) {
             txn = &transactions[i];
             break;
         }
     }
-    
+
     if (!txn) {
+        spinlock_release(&journal_lock);
         return NULL; /* No free transaction slots */
     }
-    
+
     /* Initialize transaction */
     txn->txn_id = journal_sb.next_txn_id++;
     txn->state = TRANSACTION_PENDING;
     txn->timestamp = timer_get_ticks(); /* Use timer ticks as timestamp */
     txn->op_count = 0;
-    
+    txn->error = 0;
+    txn->next = NULL;
+
     current_txn_count++;
-    
+    spinlock_release(&journal_lock);
+
     return txn;
 }
 
+/**
+ * Copy caller data into the transaction
+ */
+static void* copy_data(const void* data, size_t size) {
+    void* copy = kmalloc(size);
+    if (copy) {
+        journal_memcpy(copy, data, size);
+    }
+    return copy;
+}
+
 /**
  * Add operation to transaction
  */
@@ -110,258 +515,340 @@ int journal_add_operation(transaction_t* txn, journal_operation_t* op) {
     if (!txn || !op) {
         return -1;
     }
-    
+
     if (txn->state != TRANSACTION_PENDING) {
         return -1; /* Transaction not in pending state */
     }
-    
+
     if (txn->op_count >= JOURNAL_MAX_OPERATIONS) {
         return -1; /* Transaction full */
     }
-    
-    /* Allocate memory for old and new data if needed */
+
+    /* The transaction keeps its own copies of old and new data */
+    journal_operation_t entry = *op;
+    entry.old_data = NULL;
+    entry.new_data = NULL;
     if (op->old_data && op->data_size > 0) {
-        void* old_copy = kmalloc(op->data_size);
-        if (old_copy) {
-            /* Copy old data */
-            uint8_t* src = (uint8_t*)op->old_data;
-            uint8_t* dst = (uint8_t*)old_copy;
-            for (size_t i = 0; i < op->data_size; i++) {
-                dst[i] = src[i];
-            }
-            op->old_data = old_copy;
+        entry.old_data = copy_data(op->old_data, op->data_size);
+        if (!entry.old_data) {
+            return -1;
         }
     }
-    
     if (op->new_data && op->data_size > 0) {
-        void* new_copy = kmalloc(op->data_size);
-        if (new_copy) {
-            /* Copy new data */
-            uint8_t* src = (uint8_t*)op->new_data;
-            uint8_t* dst = (uint8_t*)new_copy;
-            for (size_t i = 0; i < op->data_size; i++) {
-                dst[i] = src[i];
+        entry.new_data = copy_data(op->new_data, op->data_size);
+        if (!entry.new_data) {
+            if (entry.old_data) {
+                kfree(entry.old_data);
             }
-            op->new_data = new_copy;
+            return -1;
         }
     }
-    
+    if (!entry.new_data) {
+        entry.data_size = 0;
+    }
+
     /* Add operation to transaction */
-    txn->operations[txn->op_count] = *op;
+    txn->operations[txn->op_count] = entry;
     txn->op_count++;
-    
+
     return 0;
 }
 
+/* ---- Commit ---- */
+
+static uint32_t txn_bytes(transaction_t* txn) {
+    uint32_t bytes = 0;
+    for (uint32_t i = 0; i < txn->op_count; i++) {
+        bytes += sizeof(journal_record_op_t) + (((uint32_t)txn->operations[i].data_size + 3) & ~3u);
+    }
+    return bytes;
+}
+
+static uint32_t record_blocks(uint32_t bytes) {
+    return (bytes + JOURNAL_BLOCK_SIZE - 1) / JOURNAL_BLOCK_SIZE + 1;
+}
+
 /**
- * Apply a single operation
+ * Serialize a batch of transactions into a record, freeing their data
+ * copies. The sequence number and checksum are filled in later.
  */
-static int apply_operation(journal_operation_t* op) {
-    if (!op) {
-        return -1;
+static uint8_t* build_record(transaction_t* batch, uint32_t bytes, uint32_t blocks) {
+    uint8_t* record = (uint8_t*)kmalloc((size_t)blocks * JOURNAL_BLOCK_SIZE);
+    if (!record) {
+        return NULL;
     }
-    
-    switch (op->type) {
-        case JOURNAL_OP_CREATE:
-            /* File creation is already done, just log it */
-            break;
-            
-        case JOURNAL_OP_DELETE:
-            /* File deletion is already done, just log it */
-            break;
-            
-        case JOURNAL_OP_WRITE:
-            /* Write operation - data should already be written */
-            /* Journal just ensures consistency */
-            break;
-            
-        case JOURNAL_OP_METADATA:
-            /* Metadata update - already applied */
-            break;
+    journal_memset(record, 0, (size_t)blocks * JOURNAL_BLOCK_SIZE);
+
+    journal_record_t* hdr = (journal_record_t*)record;
+    hdr->magic = JOURNAL_RECORD_MAGIC;
+    hdr->blocks = blocks;
+    hdr->bytes = bytes;
+
+    uint32_t offset = sizeof(journal_record_t);
+    for (transaction_t* txn = batch; txn; txn = txn->next) {
+        for (uint32_t i = 0; i < txn->op_count; i++) {
+            journal_operation_t* op = &txn->operations[i];
+            journal_record_op_t* entry = (journal_record_op_t*)(record + offset);
+            entry->txn_id = txn->txn_id;
+            entry->type = (uint32_t)op->type;
+            entry->block_num = op->block_num;
+            entry->data_size = (uint32_t)op->data_size;
+            offset += sizeof(journal_record_op_t);
+            if (op->new_data) {
+                journal_memcpy(record + offset, op->new_data, op->data_size);
+            }
+            offset += ((uint32_t)op->data_size + 3) & ~3u;
+        }
+        hdr->txn_count++;
+        hdr->op_count += txn->op_count;
+        free_op_data(txn);
     }
-    
-    return 0;
+
+    journal_commit_t* commit = (journal_commit_t*)(record + (size_t)(blocks - 1) * JOURNAL_BLOCK_SIZE);
+    commit->magic = JOURNAL_COMMIT_MAGIC;
+    commit->blocks = blocks;
+    return record;
+}
+
+static void seal_record(uint8_t* record, uint32_t blocks, uint32_t seq) {
+    journal_record_t* hdr = (journal_record_t*)record;
+    journal_commit_t* commit = (journal_commit_t*)(record + (size_t)(blocks - 1) * JOURNAL_BLOCK_SIZE);
+
+    hdr->seq = seq;
+    commit->seq = seq;
+    commit->checksum = crc32c(0, record, (size_t)(blocks - 1) * JOURNAL_BLOCK_SIZE +
+                                          offsetof(journal_commit_t, checksum));
 }
 
 /**
- * Write transaction to journal buffer
+ * Ask the checkpointer for a checkpoint now
  */
-static int journal_write_transaction(transaction_t* txn) {
-    if (!txn) {
-        return -1;
+static void checkpoint_kick(void) {
+#ifndef AURORA_STANDALONE
+    if (checkpointer) {
+        process_post_event(checkpointer, &checkpoint_wake);
+        return;
     }
-    
-    /* Calculate space needed: header + operations */
-    uint32_t header_size = sizeof(uint32_t) * 4; /* txn_id, state, timestamp, op_count */
-    uint32_t needed_space = header_size;
-    
-    for (uint32_t i = 0; i < txn->op_count; i++) {
-        journal_operation_t* op = &txn->operations[i];
-        needed_space += sizeof(uint32_t) * 3; /* type, block_num, data_size */
-        needed_space += op->data_size; /* actual data */
-    }
-    
-    /* Check if we have enough space */
-    if (journal_buffer_offset + needed_space > JOURNAL_BUFFER_SIZE) {
-        /* Wrap around or fail - for simplicity, we'll wrap */
-        journal_buffer_offset = 0;
-    }
-    
-    /* Write transaction header */
-    uint8_t* ptr = journal_buffer + journal_buffer_offset;
-    
-    /* Write txn_id */
-    *(uint32_t*)ptr = txn->txn_id;
-    ptr += sizeof(uint32_t);
-    
-    /* Write state */
-    *(uint32_t*)ptr = (uint32_t)txn->state;
-    ptr += sizeof(uint32_t);
-    
-    /* Write timestamp */
-    *(uint32_t*)ptr = txn->timestamp;
-    ptr += sizeof(uint32_t);
-    
-    /* Write operation count */
-    *(uint32_t*)ptr = txn->op_count;
-    ptr += sizeof(uint32_t);
-    
-    /* Write operations */
-    for (uint32_t i = 0; i < txn->op_count; i++) {
-        journal_operation_t* op = &txn->operations[i];
-        
-        /* Write operation type */
-        *(uint32_t*)ptr = (uint32_t)op->type;
-        ptr += sizeof(uint32_t);
-        
-        /* Write block number */
-        *(uint32_t*)ptr = op->block_num;
-        ptr += sizeof(uint32_t);
-        
-        /* Write data size */
-        *(uint32_t*)ptr = (uint32_t)op->data_size;
-        ptr += sizeof(uint32_t);
-        
-        /* Write data if present */
-        if (op->new_data && op->data_size > 0) {
-            uint8_t* src = (uint8_t*)op->new_data;
-            for (size_t j = 0; j < op->data_size; j++) {
-                *ptr++ = *src++;
-            }
+#endif
+    checkpoint_wake = 1;
+}
+
+/**
+ * Wait for the commit or checkpoint in flight to finish. Called and
+ * returns with the lock held; the caller rechecks its condition.
+ */
+static void wait_locked(void) {
+#ifndef AURORA_STANDALONE
+    /* Queued under the lock, so the wakeup can't come before it */
+    wait_entry_t wait;
+    wait_queue_prepare(&journal_waiters, &wait);
+    spinlock_release(&journal_lock);
+    int slept = wait_queue_sleep(&wait, UINT64_MAX);
+    wait_queue_finish(&journal_waiters, &wait);
+    if (slept < 0) {
+        cpu_relax();
+    }
+#else
+    spinlock_release(&journal_lock);
+    cpu_relax();
+#endif
+    spinlock_acquire(&journal_lock);
+}
+
+/**
+ * Wake everyone in wait_locked(); called after the state they wait on changed
+ */
+static void wake_waiters(void) {
+#ifndef AURORA_STANDALONE
+    wait_queue_wake_all(&journal_waiters);
+#endif
+}
+
+/**
+ * Reserve log space for a group and give it the next sequence number.
+ * Called and returns with the lock held; checkpoints if the log is full.
+ * @return The group, or NULL if it can never fit or out of memory
+ */
+static journal_group_t* reserve_locked(uint32_t blocks) {
+    if (blocks > log_size) {
+        return NULL;
+    }
+
+    while (log_size - log_used < blocks) {
+        journal_stats.full_waits++;
+        uint32_t used = log_used;
+        spinlock_release(&journal_lock);
+        int result = journal_checkpoint();
+        spinlock_acquire(&journal_lock);
+        if (result != 0 || (log_used >= used && log_size - log_used < blocks)) {
+            return NULL;
         }
     }
-    
-    journal_buffer_offset += needed_space;
-    
-    return 0;
+
+    journal_group_t* group = (journal_group_t*)kmalloc(sizeof(journal_group_t));
+    if (!group) {
+        return NULL;
+    }
+    group->seq = next_seq++;
+    group->start = log_head;
+    group->blocks = blocks;
+    group->txn_count = 0;
+    group->durable = 0;
+    group->record = NULL;
+    group->next = NULL;
+
+    log_head = log_wrap(log_head + blocks);
+    log_used += blocks;
+    if (groups_tail) {
+        groups_tail->next = group;
+    } else {
+        groups_head = group;
+    }
+    groups_tail = group;
+
+    if (log_used * 100 >= log_size * JOURNAL_CHECKPOINT_RATIO) {
+        checkpoint_kick();
+    }
+    return group;
 }
 
 /**
- * Read transaction from journal buffer
+ * Hand back the newest group's space after its write failed
  */
-static int journal_read_transaction(uint32_t offset, transaction_t* txn) {
-    if (!txn || offset >= JOURNAL_BUFFER_SIZE) {
-        return -1;
+static void unreserve_locked(journal_group_t* group) {
+    journal_group_t** link = &groups_head;
+    journal_group_t* prev = NULL;
+    while (*link != group) {
+        prev = *link;
+        link = &(*link)->next;
     }
-    
-    uint8_t* ptr = journal_buffer + offset;
-    
-    /* Read transaction header */
-    txn->txn_id = *(uint32_t*)ptr;
-    ptr += sizeof(uint32_t);
-    
-    txn->state = (transaction_state_t)(*(uint32_t*)ptr);
-    ptr += sizeof(uint32_t);
-    
-    txn->timestamp = *(uint32_t*)ptr;
-    ptr += sizeof(uint32_t);
-    
-    txn->op_count = *(uint32_t*)ptr;
-    ptr += sizeof(uint32_t);
-    
-    /* Validate operation count */
-    if (txn->op_count > JOURNAL_MAX_OPERATIONS) {
-        return -1;
+    *link = NULL;
+    groups_tail = prev;
+
+    log_head = group->start;
+    log_used -= group->blocks;
+    next_seq--;
+    kfree(group);
+}
+
+/**
+ * Write the queued transactions out as one group. Called with the lock
+ * held and no commit in flight; returns with the lock held.
+ */
+static void commit_group_locked(void) {
+    /* Take transactions up to a quarter of the log, at least one */
+    uint32_t limit = log_size / 4;
+    uint32_t bytes = sizeof(journal_record_t);
+    transaction_t* batch = queue_head;
+    transaction_t* last = NULL;
+    uint32_t count = 0;
+
+    for (transaction_t* txn = queue_head; txn; txn = txn->next) {
+        uint32_t more = txn_bytes(txn);
+        if (last && record_blocks(bytes + more) > limit) {
+            break;
+        }
+        bytes += more;
+        last = txn;
+        count++;
     }
-    
-    /* Read operations */
-    for (uint32_t i = 0; i < txn->op_count; i++) {
-        journal_operation_t* op = &txn->operations[i];
-        
-        /* Read operation type */
-        op->type = (journal_op_type_t)(*(uint32_t*)ptr);
-        ptr += sizeof(uint32_t);
-        
-        /* Read block number */
-        op->block_num = *(uint32_t*)ptr;
-        ptr += sizeof(uint32_t);
-        
-        /* Read data size */
-        op->data_size = *(uint32_t*)ptr;
-        ptr += sizeof(uint32_t);
-        
-        /* Allocate and read data if present */
-        if (op->data_size > 0) {
-            op->new_data = kmalloc(op->data_size);
-            if (op->new_data) {
-                uint8_t* dst = (uint8_t*)op->new_data;
-                for (size_t j = 0; j < op->data_size; j++) {
-                    *dst++ = *ptr++;
-                }
+    queue_head = last->next;
+    if (!queue_head) {
+        queue_tail = NULL;
+    }
+    last->next = NULL;
+    committing = 1;
+
+    uint32_t blocks = record_blocks(bytes);
+    spinlock_release(&journal_lock);
+    uint8_t* record = build_record(batch, bytes, blocks);
+    spinlock_acquire(&journal_lock);
+
+    journal_group_t* group = record ? reserve_locked(blocks) : NULL;
+    int error = -1;
+    if (group) {
+        group->txn_count = count;
+        seal_record(record, blocks, group->seq);
+        spinlock_release(&journal_lock);
+        error = log_io(group->start, record, blocks, 1);
+        if (error == 0) {
+            error = dev_flush();
+        }
+        spinlock_acquire(&journal_lock);
+
+        if (error == 0) {
+            group->durable = 1;
+            if (journal_dev.apply) {
+                group->record = record;
+                record = NULL;
             }
+            journal_stats.groups++;
+            journal_stats.commits += count;
+            journal_stats.blocks_written += blocks;
         } else {
-            op->new_data = NULL;
+            unreserve_locked(group);
         }
-        op->old_data = NULL;
     }
-    
-    return 0;
+    if (error) {
+        journal_stats.failed_groups++;
+    }
+    if (record) {
+        kfree(record);
+    }
+
+    /* Wake the committers */
+    for (transaction_t* txn = batch; txn;) {
+        transaction_t* next = txn->next;
+        txn->next = NULL;
+        txn->error = error;
+        txn->state = TRANSACTION_COMMITTED;
+        txn = next;
+    }
+    committing = 0;
+    wake_waiters();
 }
 
 /**
- * Commit transaction
+ * Commit transaction. Returns once it is durable in the log; its
+ * operations reach their home blocks at the next checkpoint.
  */
 int journal_commit_transaction(transaction_t* txn) {
     if (!txn) {
         return -1;
     }
-    
+
+    spinlock_acquire(&journal_lock);
     if (txn->state != TRANSACTION_PENDING) {
+        spinlock_release(&journal_lock);
         return -1; /* Transaction not in pending state */
     }
-    
-    /* Write transaction to journal */
-    if (journal_write_transaction(txn) != 0) {
-        return -1;
-    }
-    
-    /* Mark as committed */
-    txn->state = TRANSACTION_COMMITTED;
-    
-    /* Apply operations */
-    for (uint32_t i = 0; i < txn->op_count; i++) {
-        apply_operation(&txn->operations[i]);
+
+    /* Queue it for the next group */
+    txn->state = TRANSACTION_COMMITTING;
+    txn->next = NULL;
+    if (queue_tail) {
+        queue_tail->next = txn;
+    } else {
+        queue_head = txn;
     }
-    
-    /* Mark as completed */
-    txn->state = TRANSACTION_COMPLETED;
-    
-    /* Free allocated memory */
-    for (uint32_t i = 0; i < txn->op_count; i++) {
-        journal_operation_t* op = &txn->operations[i];
-        if (op->old_data) {
-            kfree(op->old_data);
-            op->old_data = NULL;
-        }
-        if (op->new_data) {
-            kfree(op->new_data);
-            op->new_data = NULL;
+    queue_tail = txn;
+
+    /* Write a group ourselves, or wait for the one in flight */
+    while (txn->state == TRANSACTION_COMMITTING) {
+        if (!committing) {
+            commit_group_locked();
+            continue;
         }
+        wait_locked();
     }
-    
+
+    /* Only now may the slot be reused */
+    int error = txn->error;
+    txn->state = error ? TRANSACTION_ABORTED : TRANSACTION_COMPLETED;
     current_txn_count--;
-    
-    return 0;
+    spinlock_release(&journal_lock);
+
+    return error ? -1 : 0;
 }
 
 /**
@@ -371,111 +858,257 @@ int journal_abort_transaction(transaction_t* txn) {
     if (!txn) {
         return -1;
     }
-    
+
+    spinlock_acquire(&journal_lock);
     if (txn->state != TRANSACTION_PENDING) {
+        spinlock_release(&journal_lock);
         return -1; /* Transaction not in pending state */
     }
-    
+
     /* Free allocated memory */
-    for (uint32_t i = 0; i < txn->op_count; i++) {
-        journal_operation_t* op = &txn->operations[i];
-        if (op->old_data) {
-            kfree(op->old_data);
-            op->old_data = NULL;
-        }
-        if (op->new_data) {
-            kfree(op->new_data);
-            op->new_data = NULL;
-        }
-    }
-    
+    free_op_data(txn);
+
     /* Mark as aborted */
     txn->state = TRANSACTION_ABORTED;
     current_txn_count--;
-    
+    spinlock_release(&journal_lock);
+
     return 0;
 }
 
+/* ---- Checkpoint and replay ---- */
+
 /**
- * Replay journal for recovery
+ * Checkpoint journal: apply the durable groups to their home blocks and
+ * free their log space
+ */
+int journal_checkpoint(void) {
+    spinlock_acquire(&journal_lock);
+    if (checkpointing) {
+        /* Someone else is at it; wait for them instead */
+        while (checkpointing) {
+            wait_locked();
+        }
+        spinlock_release(&journal_lock);
+        return 0;
+    }
+    checkpoint_wake = 0;
+
+    /* The durable prefix; groups are only appended, so it stays put */
+    journal_group_t* last = NULL;
+    uint32_t blocks = 0;
+    uint32_t count = 0;
+    for (journal_group_t* group = groups_head; group && group->durable; group = group->next) {
+        last = group;
+        blocks += group->blocks;
+        count++;
+    }
+    if (!last) {
+        spinlock_release(&journal_lock);
+        return 0;
+    }
+    checkpointing = 1;
+
+    uint32_t new_tail = last->next ? last->next->start : log_head;
+    uint32_t new_seq = last->next ? last->next->seq : next_seq;
+    journal_group_t* first = groups_head;
+    spinlock_release(&journal_lock);
+
+    int result = 0;
+    for (journal_group_t* group = first; result == 0; group = group->next) {
+        if (group->record) {
+            result = apply_record(group->record, NULL);
+        }
+        if (group == last) {
+            break;
+        }
+    }
+    if (result == 0 && journal_dev.sync) {
+        result = journal_dev.sync(journal_dev.ctx);
+    }
+
+    spinlock_acquire(&journal_lock);
+    if (result == 0) {
+        /* The home blocks are durable; move the tail past the groups */
+        journal_sb.start_block = new_tail;
+        journal_sb.start_seq = new_seq;
+        result = write_superblock();
+    }
+    if (result == 0) {
+        groups_head = last->next;
+        if (!groups_head) {
+            groups_tail = NULL;
+        }
+        last->next = NULL;
+        log_tail = new_tail;
+        log_used -= blocks;
+        journal_stats.checkpoints++;
+        journal_stats.checkpointed_groups += count;
+    } else {
+        first = NULL;
+    }
+    checkpointing = 0;
+    wake_waiters();
+    spinlock_release(&journal_lock);
+
+    while (first) {
+        journal_group_t* next = first->next;
+        if (first->record) {
+            kfree(first->record);
+        }
+        kfree(first);
+        first = next;
+    }
+
+    return result;
+}
+
+/**
+ * Replay journal for recovery: apply every intact group from the tail
+ * on, then checkpoint them
+ * @return Transactions replayed, or -1 on an I/O error
  */
 int journal_replay(void) {
-    /* Scan journal buffer for uncommitted transactions */
-    uint32_t offset = 0;
+    /* Groups this boot wrote are applied like any others */
+    if (journal_checkpoint() != 0) {
+        return -1;
+    }
+
+    spinlock_acquire(&journal_lock);
+    if (committing || queue_head) {
+        spinlock_release(&journal_lock);
+        return -1;
+    }
+    checkpointing = 1;
+    spinlock_release(&journal_lock);
+
+    uint32_t pos = log_tail;
+    uint32_t seq = next_seq;
+    uint32_t scanned = 0;
+    uint32_t max_txn_id = 0;
     int replayed = 0;
-    
-    while (offset < journal_buffer_offset) {
-        transaction_t txn;
-        
-        /* Try to read transaction at current offset */
-        if (journal_read_transaction(offset, &txn) == 0) {
-            /* Check if transaction needs to be replayed */
-            if (txn.state == TRANSACTION_COMMITTED && txn.txn_id > 0) {
-                /* Replay operations */
-                for (uint32_t i = 0; i < txn.op_count; i++) {
-                    apply_operation(&txn.operations[i]);
-                    
-                    /* Free allocated memory from read */
-                    if (txn.operations[i].new_data) {
-                        kfree(txn.operations[i].new_data);
-                    }
-                }
-                replayed++;
-            }
-            
-            /* Move to next transaction (simplified - assumes fixed size) */
-            offset += sizeof(uint32_t) * 4; /* header */
-            for (uint32_t i = 0; i < txn.op_count; i++) {
-                offset += sizeof(uint32_t) * 3; /* op header */
-                offset += txn.operations[i].data_size; /* op data */
-            }
-        } else {
-            break; /* Invalid transaction or end of journal */
+    int result = 0;
+
+    while (scanned < log_size) {
+        uint8_t first[JOURNAL_BLOCK_SIZE];
+        if (log_io(pos, first, 1, 0) != 0) {
+            result = -1;
+            break;
+        }
+
+        /* Cheap checks on the header before reading the whole group */
+        const journal_record_t* hdr = (const journal_record_t*)first;
+        uint32_t blocks = hdr->blocks;
+        if (hdr->magic != JOURNAL_RECORD_MAGIC || hdr->seq != seq || blocks < 2 ||
+            blocks > log_size - scanned || hdr->bytes > (blocks - 1) * JOURNAL_BLOCK_SIZE) {
+            break;
         }
+
+        uint8_t* record = (uint8_t*)kmalloc((size_t)blocks * JOURNAL_BLOCK_SIZE);
+        if (!record) {
+            result = -1;
+            break;
+        }
+        if (log_io(pos, record, blocks, 0) != 0) {
+            kfree(record);
+            result = -1;
+            break;
+        }
+        if (check_record(record, blocks, seq) != 0) {
+            /* Torn by a crash: the end of the log */
+            kfree(record);
+            break;
+        }
+
+        int applied = apply_record(record, &max_txn_id);
+        replayed += (int)((journal_record_t*)record)->txn_count;
+        kfree(record);
+        if (applied != 0) {
+            result = -1;
+            break;
+        }
+
+        pos = log_wrap(pos + blocks);
+        scanned += blocks;
+        seq++;
     }
-    
-    return replayed;
+
+    if (result == 0 && replayed > 0 && journal_dev.sync) {
+        result = journal_dev.sync(journal_dev.ctx);
+    }
+
+    spinlock_acquire(&journal_lock);
+    if (result == 0 && replayed > 0) {
+        /* Everything replayed is home; start the log after it */
+        journal_sb.start_block = pos;
+        journal_sb.start_seq = seq;
+        if (max_txn_id >= journal_sb.next_txn_id) {
+            journal_sb.next_txn_id = max_txn_id + 1;
+        }
+        result = write_superblock();
+        if (result == 0) {
+            log_head = log_tail = pos;
+            next_seq = seq;
+            journal_stats.replayed += (uint64_t)replayed;
+        }
+    }
+    checkpointing = 0;
+    wake_waiters();
+    spinlock_release(&journal_lock);
+
+    return result == 0 ? replayed : -1;
 }
 
 /**
  * Recover file system using journal
  */
 int journal_recover(void) {
-    /* Initialize journal */
-    journal_init();
-    
-    /* Replay journal */
+    /* Reload the log as it is on the device, then replay it */
+    journal_device_t dev = journal_dev;
+    if (journal_load(&dev) != 0) {
+        return -1;
+    }
     return journal_replay();
 }
 
+#ifndef AURORA_STANDALONE
 /**
- * Checkpoint journal
+ * Checkpointer: checkpoints once the log is half full, or has held
+ * groups for the checkpoint interval
  */
-int journal_checkpoint(void) {
-    /* Ensure all committed transactions are applied */
-    for (uint32_t i = 0; i < JOURNAL_MAX_TRANSACTIONS; i++) {
-        if (transactions[i].state == TRANSACTION_COMMITTED) {
-            transactions[i].state = TRANSACTION_COMPLETED;
-        }
-    }
-    
-    /* In a real implementation, this would flush journal to disk */
-    /* For our in-memory journal, we simulate a checkpoint by marking */
-    /* that all data up to current buffer offset is stable */
-    
-    /* Write journal superblock to buffer start */
-    uint8_t* sb_ptr = journal_buffer;
-    *(uint32_t*)sb_ptr = journal_sb.magic;
-    sb_ptr += sizeof(uint32_t);
-    *(uint32_t*)sb_ptr = journal_sb.version;
-    sb_ptr += sizeof(uint32_t);
-    *(uint32_t*)sb_ptr = journal_sb.block_size;
-    sb_ptr += sizeof(uint32_t);
-    *(uint32_t*)sb_ptr = journal_sb.total_blocks;
-    sb_ptr += sizeof(uint32_t);
-    *(uint32_t*)sb_ptr = journal_sb.next_txn_id;
-    
-    return 0;
+static void checkpointer_main(void) {
+    uint64_t last_run = timing_get_microseconds();
+
+    for (;;) {
+        int posted = process_wait_event_until(&checkpoint_wake,
+                                              last_run + JOURNAL_CHECKPOINT_INTERVAL_US) > 0;
+        uint64_t now = timing_get_microseconds();
+        if (posted || (groups_head && now >= last_run + JOURNAL_CHECKPOINT_INTERVAL_US)) {
+            journal_checkpoint();
+        }
+        last_run = now;
+    }
+}
+
+void journal_start_checkpointer(void) {
+    if (!checkpointer) {
+        checkpointer = process_create(checkpointer_main, 1);
+    }
+}
+#else
+void journal_start_checkpointer(void) {
+}
+#endif
+
+void journal_get_stats(journal_stats_t* stats) {
+    if (!stats) {
+        return;
+    }
+    spinlock_acquire(&journal_lock);
+    *stats = journal_stats;
+    stats->log_blocks = log_size;
+    stats->used_blocks = log_used;
+    spinlock_release(&journal_lock);
 }
 
 /**
@@ -1,7 +1,18 @@
 /**
  * Aurora OS - Journaling Layer Header
- * 
+ *
  * Transaction journaling for file system integrity
+ *
+ * The journal is a circular redo log on a journal device. Committing a
+ * transaction writes its operations' new data to the log; a checkpoint
+ * later writes them to their home blocks through the device's apply
+ * callback and frees the log space. Commits are grouped: transactions
+ * committed while a log write is in flight go out together in the next
+ * one, with a single flush. Each group ends in a commit block holding a
+ * CRC32C of the whole group, so replay stops at the first group a crash
+ * left torn. Checkpoints run in a background process once the log is
+ * half full or has held data for a while, and directly in a commit that
+ * finds the log full.
  */
 
 #ifndef AURORA_JOURNAL_H
@@ -14,13 +25,18 @@
 #define JOURNAL_MAX_TRANSACTIONS 256
 #define JOURNAL_MAX_OPERATIONS 64
 #define JOURNAL_BLOCK_SIZE 512
+#define JOURNAL_SB_BLOCKS 2                     /* Two superblock copies, then the log */
+#define JOURNAL_MIN_BLOCKS (JOURNAL_SB_BLOCKS + 8)
+#define JOURNAL_CHECKPOINT_RATIO 50             /* % of the log in use that wakes the checkpointer */
+#define JOURNAL_CHECKPOINT_INTERVAL_US 5000000ull
 
 /* Transaction states */
 typedef enum {
     TRANSACTION_PENDING,
     TRANSACTION_COMMITTED,
     TRANSACTION_COMPLETED,
-    TRANSACTION_ABORTED
+    TRANSACTION_ABORTED,
+    TRANSACTION_COMMITTING          /* Queued for or in a log write */
 } transaction_state_t;
 
 /* Operation types */
@@ -47,17 +63,53 @@ typedef struct transaction {
     uint32_t timestamp;
     journal_operation_t operations[JOURNAL_MAX_OPERATIONS];
     uint32_t op_count;
+    int error;                      /* Set if its log write failed */
+    struct transaction* next;       /* Commit queue link */
 } transaction_t;
 
-/* Journal superblock */
+/* Journal superblock, kept in both of the device's first two blocks.
+ * Writes alternate between them, so a torn write leaves the other. */
 typedef struct journal_superblock {
     uint32_t magic;
     uint32_t version;
     uint32_t block_size;
     uint32_t total_blocks;
     uint32_t next_txn_id;
+    uint32_t generation;            /* The valid copy with the higher one wins */
+    uint32_t start_block;           /* Oldest group not checkpointed, as a log block */
+    uint32_t start_seq;             /* Its sequence number */
+    uint32_t checksum;              /* CRC32C of the fields above */
 } journal_superblock_t;
 
+/* Device holding the log. Blocks are JOURNAL_BLOCK_SIZE bytes. apply
+ * writes an operation to its home block and sync makes applied writes
+ * durable; either may be NULL when the filesystem writes home blocks
+ * itself. flush makes earlier log writes durable and may be NULL for
+ * memory. */
+typedef struct {
+    uint32_t blocks;
+    void* ctx;
+    int (*read)(void* ctx, uint32_t block, void* data, uint32_t count);
+    int (*write)(void* ctx, uint32_t block, const void* data, uint32_t count);
+    int (*flush)(void* ctx);
+    int (*apply)(void* ctx, const journal_operation_t* op);
+    int (*sync)(void* ctx);
+} journal_device_t;
+
+/* Journal statistics */
+typedef struct {
+    uint32_t log_blocks;            /* Log size, superblocks excluded */
+    uint32_t used_blocks;           /* Held by groups not yet checkpointed */
+    uint64_t commits;               /* Transactions committed */
+    uint64_t groups;                /* Log writes, one flush each */
+    uint64_t blocks_written;
+    uint64_t checkpoints;
+    uint64_t checkpointed_groups;
+    uint64_t full_waits;            /* Commits that checkpointed to make room */
+    uint64_t failed_groups;         /* Could not be written; their commits fail */
+    uint64_t replayed;              /* Transactions replayed at recovery */
+} journal_stats_t;
+
 /* Journal functions */
 void journal_init(void);
 void journal_enable(void);
@@ -69,10 +121,34 @@ int journal_commit_transaction(transaction_t* txn);
 int journal_abort_transaction(transaction_t* txn);
 int journal_replay(void);
 
+/**
+ * Use a device, writing it an empty log
+ * @param dev Device, or NULL for the built-in memory log
+ * @return 0, or -1 if the device is too small or cannot be written
+ */
+int journal_format(const journal_device_t* dev);
+
+/**
+ * Use a device holding an existing log; journal_replay() then applies it
+ * @param dev Device, or NULL for the built-in memory log
+ * @return 0, or -1 if neither superblock copy is valid
+ */
+int journal_load(const journal_device_t* dev);
+
 /* Recovery functions */
 int journal_recover(void);
 int journal_checkpoint(void);
 
+/**
+ * Start the background checkpointer process
+ */
+void journal_start_checkpointer(void);
+
+/**
+ * Get journal statistics
+ */
+void journal_get_stats(journal_stats_t* stats);
+
 /* Helper functions to create journal operations */
 journal_operation_t journal_create_write_op(uint32_t block_num, void* old_data, void* new_data, size_t size);
 journal_operation_t journal_create_metadata_op(uint32_t block_num, void* old_data, void* new_data, size_t size);
@@ -25,14 +25,21 @@ typedef struct ramdisk_file {
 
 static ramdisk_file_t file_table[RAMDISK_MAX_FILES];
 
+/* VFS inodes handed out by lookup, one per ramdisk inode so open files
+ * and the page cache see a stable object */
+static inode_t vfs_inodes[RAMDISK_MAX_FILES];
+
 /* Forward declarations */
 static int ramdisk_mount(const char* device);
 static int ramdisk_unmount(void);
 static inode_t* ramdisk_lookup(const char* path);
+static inode_t* ramdisk_lookup_child(inode_t* dir, const char* name);
 static int ramdisk_create_file(const char* path, file_type_t type);
 static int ramdisk_unlink(const char* path);
 static int ramdisk_read(inode_t* inode, void* buffer, size_t size, uint32_t offset);
 static int ramdisk_write(inode_t* inode, const void* buffer, size_t size, uint32_t offset);
+static int ramdisk_readpage(inode_t* inode, uint32_t index, void* page);
+static int ramdisk_writepage(inode_t* inode, uint32_t index, const void* page, uint32_t length);
 static int ramdisk_readdir(inode_t* dir, dirent_t* entry, uint32_t index);
 static int ramdisk_mkdir(const char* path, uint16_t mode);
 static int ramdisk_rmdir(const char* path);
@@ -45,7 +52,9 @@ static file_ops_t ramdisk_file_ops = {
     .open = NULL,
     .close = NULL,
     .read = ramdisk_read,
-    .write = ramdisk_write
+    .write = ramdisk_write,
+    .readpage = ramdisk_readpage,
+    .writepage = ramdisk_writepage
 };
 
 /* File system operations with extended support */
@@ -53,6 +62,7 @@ static fs_ops_t ramdisk_ops = {
     .mount = ramdisk_mount,
     .unmount = ramdisk_unmount,
     .lookup = ramdisk_lookup,
+    .lookup_child = ramdisk_lookup_child,
     .create = ramdisk_create_file,
     .unlink = ramdisk_unlink,
     .readdir = ramdisk_readdir,
@@ -94,6 +104,128 @@ static void free_block(uint32_t block_num) {
     superblock.free_blocks++;
 }
 
+/**
+ * Block numbers stored in an indirect block
+ */
+static inline uint32_t* block_ptrs(uint32_t block_num) {
+    return (uint32_t*)(data_blocks + block_num * RAMDISK_BLOCK_SIZE);
+}
+
+/**
+ * Allocate a data block and clear it
+ */
+static int alloc_zeroed_block(void) {
+    int block = alloc_block();
+    if (block >= 0) {
+        uint8_t* data = data_blocks + block * RAMDISK_BLOCK_SIZE;
+        for (uint32_t i = 0; i < RAMDISK_BLOCK_SIZE; i++) {
+            data[i] = 0;
+        }
+    }
+    return block;
+}
+
+/**
+ * Disk block holding a file block below inode->blocks
+ */
+static uint32_t map_block(ramdisk_inode_t* inode, uint32_t idx) {
+    if (idx < RAMDISK_DIRECT_BLOCKS) {
+        return inode->block_list[idx];
+    }
+    idx -= RAMDISK_DIRECT_BLOCKS;
+    if (idx < RAMDISK_PTRS_PER_BLOCK) {
+        return block_ptrs(inode->indirect)[idx];
+    }
+    idx -= RAMDISK_PTRS_PER_BLOCK;
+    return block_ptrs(block_ptrs(inode->double_indirect)[idx / RAMDISK_PTRS_PER_BLOCK])
+                     [idx % RAMDISK_PTRS_PER_BLOCK];
+}
+
+/**
+ * Add a zeroed block at the end of a file, with any indirect block it needs
+ * @return 0 on success, -1 if the disk or block map is full
+ */
+static int append_block(ramdisk_inode_t* inode) {
+    uint32_t n = inode->blocks;
+    uint32_t limit = RAMDISK_DIRECT_BLOCKS + RAMDISK_PTRS_PER_BLOCK +
+                     RAMDISK_PTRS_PER_BLOCK * RAMDISK_PTRS_PER_BLOCK;
+    
+    if (n >= limit) {
+        return -1;
+    }
+    
+    int data = alloc_zeroed_block();
+    if (data < 0) {
+        return -1;
+    }
+    
+    if (n < RAMDISK_DIRECT_BLOCKS) {
+        inode->block_list[n] = data;
+    } else if (n < RAMDISK_DIRECT_BLOCKS + RAMDISK_PTRS_PER_BLOCK) {
+        if (n == RAMDISK_DIRECT_BLOCKS) {
+            int meta = alloc_zeroed_block();
+            if (meta < 0) {
+                free_block(data);
+                return -1;
+            }
+            inode->indirect = meta;
+        }
+        block_ptrs(inode->indirect)[n - RAMDISK_DIRECT_BLOCKS] = data;
+    } else {
+        uint32_t idx = n - RAMDISK_DIRECT_BLOCKS - RAMDISK_PTRS_PER_BLOCK;
+        int new_double = 0;
+        
+        if (idx == 0) {
+            int meta = alloc_zeroed_block();
+            if (meta < 0) {
+                free_block(data);
+                return -1;
+            }
+            inode->double_indirect = meta;
+            new_double = 1;
+        }
+        if (idx % RAMDISK_PTRS_PER_BLOCK == 0) {
+            int meta = alloc_zeroed_block();
+            if (meta < 0) {
+                if (new_double) {
+                    free_block(inode->double_indirect);
+                }
+                free_block(data);
+                return -1;
+            }
+            block_ptrs(inode->double_indirect)[idx / RAMDISK_PTRS_PER_BLOCK] = meta;
+        }
+        block_ptrs(block_ptrs(inode->double_indirect)[idx / RAMDISK_PTRS_PER_BLOCK])
+                  [idx % RAMDISK_PTRS_PER_BLOCK] = data;
+    }
+    
+    inode->blocks++;
+    return 0;
+}
+
+/**
+ * Free a file's data and indirect blocks
+ */
+static void free_file_blocks(ramdisk_inode_t* inode) {
+    for (uint32_t i = 0; i < inode->blocks; i++) {
+        free_block(map_block(inode, i));
+    }
+    
+    if (inode->blocks > RAMDISK_DIRECT_BLOCKS) {
+        free_block(inode->indirect);
+    }
+    if (inode->blocks > RAMDISK_DIRECT_BLOCKS + RAMDISK_PTRS_PER_BLOCK) {
+        uint32_t rest = inode->blocks - RAMDISK_DIRECT_BLOCKS - RAMDISK_PTRS_PER_BLOCK;
+        uint32_t tables = (rest + RAMDISK_PTRS_PER_BLOCK - 1) / RAMDISK_PTRS_PER_BLOCK;
+        for (uint32_t i = 0; i < tables; i++) {
+            free_block(block_ptrs(inode->double_indirect)[i]);
+        }
+        free_block(inode->double_indirect);
+    }
+    
+    inode->blocks = 0;
+}
+
 /**
  * Initialize ramdisk subsystem
  */
@@ -120,9 +252,11 @@ void ramdisk_init(void) {
         inodes[i].mtime = 0;
         inodes[i].ctime = 0;
         inodes[i].child_count = 0;
-        for (int j = 0; j < 32; j++) {
+        for (int j = 0; j < RAMDISK_DIRECT_BLOCKS; j++) {
             inodes[i].block_list[j] = 0;
         }
+        inodes[i].indirect = 0;
+        inodes[i].double_indirect = 0;
         for (int j = 0; j < 64; j++) {
             inodes[i].children[j] = 0;
         }
@@ -133,6 +267,14 @@ void ramdisk_init(void) {
         block_bitmap[i] = 0;
     }
     
+    /* Forget VFS inodes and their cached pages */
+    for (int i = 0; i < RAMDISK_MAX_FILES; i++) {
+        page_cache_truncate(&vfs_inodes[i].mapping, 0);
+        page_cache_mapping_init(&vfs_inodes[i].mapping, &vfs_inodes[i]);
+        vfs_inodes[i].fs_data = NULL;
+        vfs_inodes[i].fops = NULL;
+    }
+    
     /* Initialize file table */
     for (int i = 0; i < RAMDISK_MAX_FILES; i++) {
         file_table[i].used = 0;
@@ -150,8 +292,10 @@ void ramdisk_init(void) {
 int ramdisk_create(size_t size) {
     ramdisk_init();
     
-    /* Allocate data blocks memory */
-    data_blocks = (uint8_t*)kmalloc(RAMDISK_MAX_BLOCKS * RAMDISK_BLOCK_SIZE);
+    /* Allocate data blocks memory (kept across re-creation) */
+    if (!data_blocks) {
+        data_blocks = (uint8_t*)kmalloc(RAMDISK_MAX_BLOCKS * RAMDISK_BLOCK_SIZE);
+    }
     if (!data_blocks) {
         return -1;
     }
@@ -198,9 +342,11 @@ static ramdisk_inode_t* alloc_inode(void) {
 static void free_inode(ramdisk_inode_t* inode) {
     if (inode && inode->used) {
         /* Free all data blocks */
-        for (uint32_t i = 0; i < inode->blocks && i < 32; i++) {
-            free_block(inode->block_list[i]);
-        }
+        free_file_blocks(inode);
+        
+        /* Retire its VFS inode */
+        vfs_inodes[inode->ino].fs_data = NULL;
+        vfs_inodes[inode->ino].fops = NULL;
         
         inode->used = 0;
         inode->size = 0;
@@ -294,6 +440,34 @@ static int ramdisk_unmount(void) {
     return 0;
 }
 
+/**
+ * Get the VFS inode for a ramdisk inode, refreshing its metadata
+ */
+static inode_t* vfs_inode_for(ramdisk_inode_t* rd_inode) {
+    /* Convert ramdisk inode to generic inode with all fields. The size
+     * is only loaded once: after that the VFS keeps it current. */
+    inode_t* inode = &vfs_inodes[rd_inode->ino];
+    if (inode->fs_data != rd_inode) {
+        inode->size = rd_inode->size;
+        inode->fs_data = rd_inode;
+        inode->fops = &ramdisk_file_ops;
+        page_cache_mapping_init(&inode->mapping, inode);
+    }
+    inode->ino = rd_inode->ino;
+    inode->type = rd_inode->type;
+    inode->links = 1;
+    inode->blocks = rd_inode->blocks;
+    inode->mode = rd_inode->mode;
+    inode->uid = rd_inode->uid;
+    inode->gid = rd_inode->gid;
+    inode->atime = rd_inode->atime;
+    inode->mtime = rd_inode->mtime;
+    inode->ctime = rd_inode->ctime;
+    inode->parent_ino = rd_inode->parent_ino;
+    
+    return inode;
+}
+
 /**
  * Lookup file in ramdisk
  */
@@ -307,23 +481,35 @@ static inode_t* ramdisk_lookup(const char* path) {
         return NULL;
     }
     
-    /* Convert ramdisk inode to generic inode with all fields */
-    static inode_t inode;
-    inode.ino = rd_inode->ino;
-    inode.type = rd_inode->type;
-    inode.size = rd_inode->size;
-    inode.links = 1;
-    inode.blocks = rd_inode->blocks;
-    inode.mode = rd_inode->mode;
-    inode.uid = rd_inode->uid;
-    inode.gid = rd_inode->gid;
-    inode.atime = rd_inode->atime;
-    inode.mtime = rd_inode->mtime;
-    inode.ctime = rd_inode->ctime;
-    inode.parent_ino = rd_inode->parent_ino;
-    inode.fs_data = rd_inode;
+    return vfs_inode_for(rd_inode);
+}
+
+/**
+ * Lookup one name in a directory
+ */
+static inode_t* ramdisk_lookup_child(inode_t* dir, const char* name) {
+    if (!dir || !name || dir->type != FILE_TYPE_DIRECTORY) {
+        return NULL;
+    }
     
-    return &inode;
+    for (int i = 0; i < RAMDISK_MAX_FILES; i++) {
+        if (!file_table[i].used || file_table[i].parent_ino != dir->ino) {
+            continue;
+        }
+        
+        /* Entries hold full paths; compare the last component */
+        const char* base = file_table[i].name;
+        for (const char* c = base; *c; c++) {
+            if (*c == '/') {
+                base = c + 1;
+            }
+        }
+        if (str_equal(base, name)) {
+            return vfs_inode_for(&inodes[file_table[i].inode_num]);
+        }
+    }
+    
+    return NULL;
 }
 
 /**
@@ -540,7 +726,7 @@ static int ramdisk_read(inode_t* inode, void* buffer, size_t size, uint32_t offs
             break;
         }
         
-        uint32_t block_num = rd_inode->block_list[block_idx];
+        uint32_t block_num = map_block(rd_inode, block_idx);
         uint8_t* block_data = data_blocks + (block_num * RAMDISK_BLOCK_SIZE);
         
         for (uint32_t i = 0; i < to_read; i++) {
@@ -575,22 +761,17 @@ static int ramdisk_write(inode_t* inode, const void* buffer, size_t size, uint32
             to_write = size - bytes_written;
         }
         
-        /* Allocate block if needed */
-        if (block_idx >= rd_inode->blocks) {
-            if (block_idx >= 32) {
-                break; /* Maximum blocks reached */
-            }
-            
-            int new_block = alloc_block();
-            if (new_block < 0) {
+        /* Allocate blocks up to this one if needed (holes read as zeros) */
+        while (block_idx >= rd_inode->blocks) {
+            if (append_block(rd_inode) != 0) {
                 break; /* No free blocks */
             }
-            
-            rd_inode->block_list[block_idx] = new_block;
-            rd_inode->blocks++;
+        }
+        if (block_idx >= rd_inode->blocks) {
+            break;
         }
         
-        uint32_t block_num = rd_inode->block_list[block_idx];
+        uint32_t block_num = map_block(rd_inode, block_idx);
         uint8_t* block_data = data_blocks + (block_num * RAMDISK_BLOCK_SIZE);
         
         for (uint32_t i = 0; i < to_write; i++) {
@@ -605,10 +786,37 @@ static int ramdisk_write(inode_t* inode, const void* buffer, size_t size, uint32
         rd_inode->size = offset + bytes_written;
         inode->size = rd_inode->size;
     }
+    inode->blocks = rd_inode->blocks;
     
     return (int)bytes_written;
 }
 
+/**
+ * Fill a page cache page from the ramdisk
+ */
+static int ramdisk_readpage(inode_t* inode, uint32_t index, void* page) {
+    int bytes = ramdisk_read(inode, page, PAGE_CACHE_SIZE, index * PAGE_CACHE_SIZE);
+    if (bytes < 0) {
+        return -1;
+    }
+    
+    /* Zero the tail past end of file */
+    uint8_t* data = (uint8_t*)page;
+    for (uint32_t i = (uint32_t)bytes; i < PAGE_CACHE_SIZE; i++) {
+        data[i] = 0;
+    }
+    
+    return 0;
+}
+
+/**
+ * Store a page cache page on the ramdisk
+ */
+static int ramdisk_writepage(inode_t* inode, uint32_t index, const void* page, uint32_t length) {
+    int bytes = ramdisk_write(inode, page, length, index * PAGE_CACHE_SIZE);
+    return bytes == (int)length ? 0 : -1;
+}
+
 /**
  * Read directory entries
  */
@@ -806,6 +1014,7 @@ static int ramdisk_chmod(const char* path, uint16_t mode) {
     }
     
     inode->mode = mode;
+    vfs_inode_for(inode);
     return 0;
 }
 
@@ -829,9 +1038,46 @@ static int ramdisk_chown(const char* path, uint16_t uid, uint16_t gid) {
     
     inode->uid = uid;
     inode->gid = gid;
+    vfs_inode_for(inode);
     return 0;
 }
 
+/**
+ * Rewrite the paths of entries under a renamed directory
+ */
+static void rename_descendants(const char* oldpath, const char* newpath) {
+    size_t old_len = 0;
+    while (oldpath[old_len]) {
+        old_len++;
+    }
+    
+    for (int i = 0; i < RAMDISK_MAX_FILES; i++) {
+        char* name = file_table[i].name;
+        if (!file_table[i].used) {
+            continue;
+        }
+        
+        size_t j = 0;
+        while (j < old_len && name[j] == oldpath[j]) {
+            j++;
+        }
+        if (j != old_len || name[old_len] != '/') {
+            continue;
+        }
+        
+        char renamed[MAX_FILENAME];
+        size_t n = 0;
+        for (const char* c = newpath; *c && n < MAX_FILENAME - 1; c++) {
+            renamed[n++] = *c;
+        }
+        for (const char* c = name + old_len; *c && n < MAX_FILENAME - 1; c++) {
+            renamed[n++] = *c;
+        }
+        renamed[n] = '\0';
+        str_copy(name, renamed, MAX_FILENAME);
+    }
+}
+
 /**
  * Rename file or directory
  */
@@ -889,6 +1135,11 @@ static int ramdisk_rename(const char* oldpath, const char* newpath) {
                 file_table[i].parent_ino = new_parent->ino;
             }
             
+            /* Entries below a directory carry its old path */
+            if (inode->type == FILE_TYPE_DIRECTORY) {
+                rename_descendants(oldpath, newpath);
+            }
+            
             return 0;
         }
     }
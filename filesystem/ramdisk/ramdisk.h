@@ -17,13 +17,20 @@
 #define RAMDISK_MAX_BLOCKS 2048
 #define RAMDISK_MAX_SUBDIRS 32
 
+/* Block map: direct blocks, then one indirect and one double-indirect
+ * block of block numbers */
+#define RAMDISK_DIRECT_BLOCKS 32
+#define RAMDISK_PTRS_PER_BLOCK (RAMDISK_BLOCK_SIZE / sizeof(uint32_t))
+
 /* Ramdisk inode structure with permissions support */
 typedef struct ramdisk_inode {
     uint32_t ino;
     file_type_t type;
     uint32_t size;
     uint32_t blocks;
-    uint32_t block_list[32]; /* Direct blocks */
+    uint32_t block_list[RAMDISK_DIRECT_BLOCKS]; /* Direct blocks */
+    uint32_t indirect;       /* Blocks past the direct ones (if blocks > 32) */
+    uint32_t double_indirect; /* Then blocks of indirect blocks */
     uint8_t used;
     /* Permission fields */
     uint16_t mode;           /* Unix-style permission bits */
@@ -0,0 +1,515 @@
+/**
+ * Aurora OS - File Descriptor Tables Implementation
+ *
+ * A table is a slot array plus three bitmaps. open_fds has a bit per
+ * slot; full_words has a bit per open_fds word that has no zero bits, so
+ * finding the lowest free descriptor checks one word of open_fds, skips
+ * whole runs of 1024 used descriptors per full_words word, then takes
+ * the first zero bit of the word it lands on. next_fd remembers where
+ * the last search ended so that filling a table does not rescan.
+ *
+ * Tables grow by doubling. The lock is dropped to allocate the bigger
+ * arrays, so everything that grows a table looks for its slot again
+ * afterwards. Open files are released outside the table lock, since the
+ * last reference drops a dentry and takes the dcache lock.
+ */
+
+#include "fdtable.h"
+#include "../cache/dcache.h"
+#include "../../kernel/memory/memory.h"
+#ifndef AURORA_STANDALONE
+#include "../../kernel/process/process.h"
+#endif
+#include <stddef.h>
+
+/* Table used by the kernel itself and outside any process */
+static files_t* kernel_files = NULL;
+
+static void fill_words(uint32_t* dst, uint32_t value, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        dst[i] = value;
+    }
+}
+
+static void copy_words(uint32_t* dst, const uint32_t* src, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        dst[i] = src[i];
+    }
+}
+
+static uint32_t summary_words(uint32_t max_fds) {
+    return (max_fds / 32 + 31) / 32;
+}
+
+file_t* file_alloc(inode_t* inode, struct dentry* dentry, int flags) {
+    file_t* file = (file_t*)kmalloc(sizeof(file_t));
+    if (!file) {
+        dput(dentry);
+        return NULL;
+    }
+
+    file->inode = inode;
+    file->offset = 0;
+    file->flags = flags;
+    file->refcount = 1;
+    file->dentry = dentry;
+    page_cache_ra_init(&file->ra);
+    return file;
+}
+
+file_t* file_get(file_t* file) {
+    if (file) {
+        __atomic_add_fetch(&file->refcount, 1, __ATOMIC_RELAXED);
+    }
+    return file;
+}
+
+void file_put(file_t* file) {
+    if (!file) {
+        return;
+    }
+    if (__atomic_sub_fetch(&file->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+        dput(file->dentry);
+        kfree(file);
+    }
+}
+
+/**
+ * Slot and bitmap arrays for a table of max_fds slots, all free
+ */
+typedef struct {
+    file_t** fd;
+    uint32_t* open_fds;
+    uint32_t* close_on_exec;
+    uint32_t* full_words;
+} fd_arrays_t;
+
+static void free_arrays(fd_arrays_t* a) {
+    if (a->fd) kfree(a->fd);
+    if (a->open_fds) kfree(a->open_fds);
+    if (a->close_on_exec) kfree(a->close_on_exec);
+    if (a->full_words) kfree(a->full_words);
+}
+
+static int alloc_arrays(fd_arrays_t* a, uint32_t max_fds) {
+    uint32_t words = max_fds / 32;
+    uint32_t summary = summary_words(max_fds);
+
+    a->fd = (file_t**)kmalloc(max_fds * sizeof(file_t*));
+    a->open_fds = (uint32_t*)kmalloc(words * sizeof(uint32_t));
+    a->close_on_exec = (uint32_t*)kmalloc(words * sizeof(uint32_t));
+    a->full_words = (uint32_t*)kmalloc(summary * sizeof(uint32_t));
+    if (!a->fd || !a->open_fds || !a->close_on_exec || !a->full_words) {
+        free_arrays(a);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < max_fds; i++) {
+        a->fd[i] = NULL;
+    }
+    fill_words(a->open_fds, 0, words);
+    fill_words(a->close_on_exec, 0, words);
+    fill_words(a->full_words, 0, summary);
+    return 0;
+}
+
+/**
+ * Copy a table's contents into arrays at least as big
+ */
+static void copy_arrays(fd_arrays_t* a, files_t* files) {
+    uint32_t words = files->max_fds / 32;
+
+    for (uint32_t i = 0; i < files->max_fds; i++) {
+        a->fd[i] = files->fd[i];
+    }
+    copy_words(a->open_fds, files->open_fds, words);
+    copy_words(a->close_on_exec, files->close_on_exec, words);
+    copy_words(a->full_words, files->full_words, summary_words(files->max_fds));
+}
+
+static fd_arrays_t table_arrays(files_t* files) {
+    fd_arrays_t a = { files->fd, files->open_fds, files->close_on_exec,
+                      files->full_words };
+    return a;
+}
+
+static void install_arrays(files_t* files, fd_arrays_t* a, uint32_t max_fds) {
+    files->fd = a->fd;
+    files->open_fds = a->open_fds;
+    files->close_on_exec = a->close_on_exec;
+    files->full_words = a->full_words;
+    files->max_fds = max_fds;
+}
+
+/**
+ * Grow a table until slot nr exists. Called and returns with the lock
+ * held, but drops it to allocate.
+ * @return 0, or -1 if nr is past the limit or out of memory
+ */
+static int expand_locked(files_t* files, uint32_t nr) {
+    while (nr >= files->max_fds) {
+        if (nr >= FDTABLE_MAX_FDS) {
+            return -1;
+        }
+
+        uint32_t size = files->max_fds;
+        while (size <= nr) {
+            size *= 2;
+        }
+
+        fd_arrays_t a;
+        spinlock_release(&files->lock);
+        int result = alloc_arrays(&a, size);
+        spinlock_acquire(&files->lock);
+        if (result < 0) {
+            return -1;
+        }
+
+        if (files->max_fds >= size) {
+            /* Someone else grew it meanwhile */
+            free_arrays(&a);
+            continue;
+        }
+
+        copy_arrays(&a, files);
+        fd_arrays_t old = table_arrays(files);
+        install_arrays(files, &a, size);
+        free_arrays(&old);
+    }
+    return 0;
+}
+
+/**
+ * Lowest free slot at or above start
+ * @return Slot, or max_fds if there is none
+ */
+static uint32_t find_free(files_t* files, uint32_t start) {
+    uint32_t words = files->max_fds / 32;
+    uint32_t w = start / 32;
+
+    if (w >= words) {
+        return files->max_fds;
+    }
+
+    uint32_t bits = ~files->open_fds[w] & (~0u << (start % 32));
+    if (bits) {
+        return w * 32 + (uint32_t)__builtin_ctz(bits);
+    }
+
+    /* Skip full words 32 at a time */
+    for (w++; w < words; w = (w / 32 + 1) * 32) {
+        uint32_t avail = ~files->full_words[w / 32] & (~0u << (w % 32));
+        if (avail) {
+            w = (w / 32) * 32 + (uint32_t)__builtin_ctz(avail);
+            if (w >= words) {
+                break;
+            }
+            return w * 32 + (uint32_t)__builtin_ctz(~files->open_fds[w]);
+        }
+    }
+    return files->max_fds;
+}
+
+static void set_open(files_t* files, uint32_t fd, file_t* file, int cloexec) {
+    uint32_t w = fd / 32;
+    uint32_t bit = 1u << (fd % 32);
+
+    files->fd[fd] = file;
+    files->open_fds[w] |= bit;
+    if (files->open_fds[w] == ~0u) {
+        files->full_words[w / 32] |= 1u << (w % 32);
+    }
+    if (cloexec) {
+        files->close_on_exec[w] |= bit;
+    } else {
+        files->close_on_exec[w] &= ~bit;
+    }
+    files->count++;
+}
+
+/**
+ * Empty a slot
+ * @return The open file it held, for the caller to release
+ */
+static file_t* clear_open(files_t* files, uint32_t fd) {
+    uint32_t w = fd / 32;
+    uint32_t bit = 1u << (fd % 32);
+    file_t* file = files->fd[fd];
+
+    files->fd[fd] = NULL;
+    files->open_fds[w] &= ~bit;
+    files->close_on_exec[w] &= ~bit;
+    files->full_words[w / 32] &= ~(1u << (w % 32));
+    files->count--;
+    if (fd < files->next_fd) {
+        files->next_fd = fd;
+    }
+    return file;
+}
+
+static file_t* lookup_locked(files_t* files, int fd) {
+    if (fd < 0 || (uint32_t)fd >= files->max_fds) {
+        return NULL;
+    }
+    return files->fd[fd];
+}
+
+void fdtable_init(void) {
+    if (kernel_files) {
+        fdtable_destroy(kernel_files);
+    }
+    kernel_files = fdtable_create();
+}
+
+files_t* fdtable_create(void) {
+    files_t* files = (files_t*)kmalloc(sizeof(files_t));
+    if (!files) {
+        return NULL;
+    }
+
+    fd_arrays_t a;
+    if (alloc_arrays(&a, FDTABLE_INIT_FDS) < 0) {
+        kfree(files);
+        return NULL;
+    }
+
+    spinlock_init(&files->lock);
+    install_arrays(files, &a, FDTABLE_INIT_FDS);
+    files->count = 0;
+    files->next_fd = 0;
+    return files;
+}
+
+files_t* fdtable_fork(files_t* parent) {
+    files_t* files = fdtable_create();
+    if (!files || !parent) {
+        return files;
+    }
+
+    spinlock_acquire(&parent->lock);
+    while (files->max_fds < parent->max_fds) {
+        /* Size the copy outside the parent's lock, then check it again */
+        uint32_t size = parent->max_fds;
+        spinlock_release(&parent->lock);
+
+        fd_arrays_t a;
+        if (alloc_arrays(&a, size) < 0) {
+            fdtable_destroy(files);
+            return NULL;
+        }
+        fd_arrays_t old = table_arrays(files);
+        install_arrays(files, &a, size);
+        free_arrays(&old);
+
+        spinlock_acquire(&parent->lock);
+    }
+
+    fd_arrays_t a = table_arrays(files);
+    copy_arrays(&a, parent);
+    for (uint32_t w = 0; w < parent->max_fds / 32; w++) {
+        uint32_t bits = parent->open_fds[w];
+        while (bits) {
+            file_get(parent->fd[w * 32 + (uint32_t)__builtin_ctz(bits)]);
+            bits &= bits - 1;
+        }
+    }
+    files->count = parent->count;
+    files->next_fd = parent->next_fd;
+    spinlock_release(&parent->lock);
+
+    return files;
+}
+
+void fdtable_destroy(files_t* files) {
+    if (!files) {
+        return;
+    }
+
+    for (uint32_t w = 0; w < files->max_fds / 32; w++) {
+        uint32_t bits = files->open_fds[w];
+        while (bits) {
+            file_put(files->fd[w * 32 + (uint32_t)__builtin_ctz(bits)]);
+            bits &= bits - 1;
+        }
+    }
+
+    fd_arrays_t a = table_arrays(files);
+    free_arrays(&a);
+    kfree(files);
+}
+
+void fdtable_exec(files_t* files) {
+    if (!files) {
+        return;
+    }
+
+    spinlock_acquire(&files->lock);
+    for (uint32_t w = 0; w < files->max_fds / 32; w++) {
+        while (files->close_on_exec[w]) {
+            uint32_t fd = w * 32 + (uint32_t)__builtin_ctz(files->close_on_exec[w]);
+            file_t* file = clear_open(files, fd);
+            spinlock_release(&files->lock);
+            file_put(file);
+            spinlock_acquire(&files->lock);
+        }
+    }
+    spinlock_release(&files->lock);
+}
+
+files_t* fdtable_current(void) {
+#ifndef AURORA_STANDALONE
+    process_t* process = process_get_current();
+    if (process && process->files) {
+        return process->files;
+    }
+#endif
+    return kernel_files;
+}
+
+files_t* fdtable_set_kernel(files_t* files) {
+    files_t* old = kernel_files;
+    kernel_files = files;
+    return old;
+}
+
+int fd_install(files_t* files, file_t* file, uint32_t min_fd, int cloexec) {
+    if (!files || !file) {
+        return -1;
+    }
+
+    spinlock_acquire(&files->lock);
+    for (;;) {
+        uint32_t start = min_fd > files->next_fd ? min_fd : files->next_fd;
+        uint32_t fd = find_free(files, start);
+
+        if (fd < files->max_fds) {
+            set_open(files, fd, file, cloexec);
+            if (start == files->next_fd) {
+                files->next_fd = fd + 1;
+            }
+            spinlock_release(&files->lock);
+            return (int)fd;
+        }
+
+        if (expand_locked(files, fd) < 0) {
+            spinlock_release(&files->lock);
+            return -1;
+        }
+    }
+}
+
+file_t* fd_get(files_t* files, int fd) {
+    if (!files) {
+        return NULL;
+    }
+
+    spinlock_acquire(&files->lock);
+    file_t* file = lookup_locked(files, fd);
+    spinlock_release(&files->lock);
+    return file;
+}
+
+int fd_close(files_t* files, int fd) {
+    if (!files) {
+        return -1;
+    }
+
+    spinlock_acquire(&files->lock);
+    if (!lookup_locked(files, fd)) {
+        spinlock_release(&files->lock);
+        return -1;
+    }
+    file_t* file = clear_open(files, (uint32_t)fd);
+    spinlock_release(&files->lock);
+
+    file_put(file);
+    return 0;
+}
+
+int fd_dup(files_t* files, int oldfd, uint32_t min_fd) {
+    if (!files) {
+        return -1;
+    }
+
+    spinlock_acquire(&files->lock);
+    file_t* file = file_get(lookup_locked(files, oldfd));
+    spinlock_release(&files->lock);
+    if (!file) {
+        return -1;
+    }
+
+    int fd = fd_install(files, file, min_fd, 0);
+    if (fd < 0) {
+        file_put(file);
+    }
+    return fd;
+}
+
+int fd_dup2(files_t* files, int oldfd, int newfd) {
+    if (!files || newfd < 0 || (uint32_t)newfd >= FDTABLE_MAX_FDS) {
+        return -1;
+    }
+
+    spinlock_acquire(&files->lock);
+    file_t* file = lookup_locked(files, oldfd);
+    if (!file || oldfd == newfd) {
+        spinlock_release(&files->lock);
+        return file ? newfd : -1;
+    }
+    file_get(file);
+
+    if (expand_locked(files, (uint32_t)newfd) < 0) {
+        spinlock_release(&files->lock);
+        file_put(file);
+        return -1;
+    }
+
+    file_t* old = files->fd[newfd];
+    if (old) {
+        files->fd[newfd] = file;
+        files->close_on_exec[newfd / 32] &= ~(1u << (newfd % 32));
+    } else {
+        set_open(files, (uint32_t)newfd, file, 0);
+        if ((uint32_t)newfd == files->next_fd) {
+            files->next_fd = (uint32_t)newfd + 1;
+        }
+    }
+    spinlock_release(&files->lock);
+
+    file_put(old);
+    return newfd;
+}
+
+int fd_set_cloexec(files_t* files, int fd, int cloexec) {
+    if (!files) {
+        return -1;
+    }
+
+    spinlock_acquire(&files->lock);
+    if (!lookup_locked(files, fd)) {
+        spinlock_release(&files->lock);
+        return -1;
+    }
+    uint32_t bit = 1u << (fd % 32);
+    if (cloexec) {
+        files->close_on_exec[fd / 32] |= bit;
+    } else {
+        files->close_on_exec[fd / 32] &= ~bit;
+    }
+    spinlock_release(&files->lock);
+    return 0;
+}
+
+int fd_get_cloexec(files_t* files, int fd) {
+    if (!files) {
+        return -1;
+    }
+
+    spinlock_acquire(&files->lock);
+    int result = -1;
+    if (lookup_locked(files, fd)) {
+        result = (files->close_on_exec[fd / 32] >> (fd % 32)) & 1;
+    }
+    spinlock_release(&files->lock);
+    return result;
+}
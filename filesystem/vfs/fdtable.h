@@ -0,0 +1,136 @@
+/**
+ * Aurora OS - File Descriptor Tables Header
+ *
+ * Each process has its own table mapping descriptor numbers to open
+ * files. Open files are refcounted and shared by every descriptor that
+ * refers to them, across dup() and across the tables of forked
+ * processes, so they share the file offset as POSIX requires. Tables
+ * start with 64 slots and double as needed. A bitmap of used slots, and
+ * a second bitmap marking its full words, find the lowest free
+ * descriptor in O(words / 32). Descriptors marked close-on-exec are
+ * closed by fdtable_exec().
+ */
+
+#ifndef AURORA_FDTABLE_H
+#define AURORA_FDTABLE_H
+
+#include <stdint.h>
+#include "vfs.h"
+#include "../../kernel/smp/spinlock.h"
+
+#define FDTABLE_INIT_FDS    64
+#define FDTABLE_MAX_FDS     (1u << 20)      /* Per-process limit */
+
+typedef struct files_struct {
+    spinlock_t lock;
+    uint32_t max_fds;               /* Slots allocated; a multiple of 32 */
+    uint32_t count;                 /* Descriptors open */
+    uint32_t next_fd;               /* No free slot below this */
+    file_t** fd;
+    uint32_t* open_fds;             /* Bit per slot */
+    uint32_t* close_on_exec;        /* Bit per slot */
+    uint32_t* full_words;           /* Bit per open_fds word with no free slot */
+} files_t;
+
+/**
+ * Create an open file holding one reference
+ * @param dentry Referenced dentry, consumed (may be NULL)
+ * @return Open file, or NULL if out of memory
+ */
+file_t* file_alloc(inode_t* inode, struct dentry* dentry, int flags);
+
+/**
+ * Take another reference to an open file
+ */
+file_t* file_get(file_t* file);
+
+/**
+ * Drop a reference, freeing the open file at zero
+ */
+void file_put(file_t* file);
+
+/**
+ * Set up the table used outside any process
+ */
+void fdtable_init(void);
+
+/**
+ * Create an empty table
+ * @return Table, or NULL if out of memory
+ */
+files_t* fdtable_create(void);
+
+/**
+ * Copy a table for a forked process: same descriptors, open files and
+ * close-on-exec flags
+ * @param parent Table to copy; NULL gives an empty table
+ * @return Table, or NULL if out of memory
+ */
+files_t* fdtable_fork(files_t* parent);
+
+/**
+ * Close every descriptor and free a table
+ */
+void fdtable_destroy(files_t* files);
+
+/**
+ * Close descriptors marked close-on-exec
+ */
+void fdtable_exec(files_t* files);
+
+/**
+ * The calling process's table, or the kernel's outside a process
+ */
+files_t* fdtable_current(void);
+
+/**
+ * Replace the table used outside any process
+ * @return The previous table
+ */
+files_t* fdtable_set_kernel(files_t* files);
+
+/**
+ * Give an open file the lowest free descriptor at or above min_fd
+ * Takes over the caller's reference.
+ * @return Descriptor, or -1 if the table is full or out of memory
+ */
+int fd_install(files_t* files, file_t* file, uint32_t min_fd, int cloexec);
+
+/**
+ * Look up a descriptor
+ * @return Open file (no reference taken), or NULL if not open
+ */
+file_t* fd_get(files_t* files, int fd);
+
+/**
+ * Close a descriptor, dropping its reference to the open file
+ * @return 0, or -1 if not open
+ */
+int fd_close(files_t* files, int fd);
+
+/**
+ * Duplicate a descriptor to the lowest free one at or above min_fd;
+ * the new descriptor is not close-on-exec
+ * @return New descriptor, or -1
+ */
+int fd_dup(files_t* files, int oldfd, uint32_t min_fd);
+
+/**
+ * Duplicate a descriptor to a given number, closing what was there
+ * @return newfd, or -1
+ */
+int fd_dup2(files_t* files, int oldfd, int newfd);
+
+/**
+ * Set or clear a descriptor's close-on-exec flag
+ * @return 0, or -1 if not open
+ */
+int fd_set_cloexec(files_t* files, int fd, int cloexec);
+
+/**
+ * Get a descriptor's close-on-exec flag
+ * @return 1 or 0, or -1 if not open
+ */
+int fd_get_cloexec(files_t* files, int fd);
+
+#endif /* AURORA_FDTABLE_H */
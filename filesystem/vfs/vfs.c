@@ -5,14 +5,13 @@
  */
 
 #include "vfs.h"
+#include "fdtable.h"
 #include "../cache/file_cache.h"
+#include "../cache/page_cache.h"
+#include "../cache/dcache.h"
 #include "../../kernel/memory/memory.h"
 #include <stddef.h>
 
-/* File descriptor table */
-static file_descriptor_t fd_table[MAX_OPEN_FILES];
-static int next_fd = 0;
-
 /* File system type registry */
 static fs_type_t* fs_types = NULL;
 
@@ -23,20 +22,19 @@ static fs_type_t* root_fs = NULL;
  * Initialize VFS subsystem
  */
 void vfs_init(void) {
-    /* Initialize file descriptor table */
-    for (int i = 0; i < MAX_OPEN_FILES; i++) {
-        fd_table[i].fd = -1;
-        fd_table[i].inode = NULL;
-        fd_table[i].offset = 0;
-        fd_table[i].flags = 0;
-        fd_table[i].ref_count = 0;
-    }
-    next_fd = 0;
+    /* Initialize the kernel's file descriptor table */
+    fdtable_init();
     fs_types = NULL;
     root_fs = NULL;
     
     /* Initialize file cache */
     file_cache_init();
+    
+    /* Initialize page cache */
+    page_cache_init(PAGE_CACHE_DEFAULT_MAX_PAGES);
+    
+    /* Initialize dentry cache */
+    dcache_init(DCACHE_DEFAULT_MAX_DENTRIES);
 }
 
 /**
@@ -47,8 +45,8 @@ int vfs_register_fs(const char* name, fs_ops_t* ops) {
         return -1;
     }
     
-    /* Allocate new file system type (simplified - in real kernel would use kmalloc) */
-    fs_type_t* fs_type = NULL; /* TODO: Use kmalloc when available */
+    /* Allocate new file system type */
+    fs_type_t* fs_type = (fs_type_t*)kmalloc(sizeof(fs_type_t));
     if (!fs_type) {
         return -1;
     }
@@ -107,6 +105,14 @@ int vfs_mount(const char* device, const char* mountpoint, const char* fstype) {
         /* If mounting at root, set as root file system */
         if (mountpoint[0] == '/' && mountpoint[1] == '\0') {
             root_fs = fs;
+            
+            /* Paths are only cached for filesystems that can look up
+             * a single component */
+            inode_t* root = NULL;
+            if (fs->ops->lookup_child && fs->ops->lookup) {
+                root = fs->ops->lookup("/");
+            }
+            dcache_set_root(root);
         }
     }
     
@@ -126,6 +132,7 @@ int vfs_unmount(const char* mountpoint) {
         int result = root_fs->ops->unmount();
         if (result == 0) {
             root_fs = NULL;
+            dcache_set_root(NULL);
         }
         return result;
     }
@@ -134,27 +141,158 @@ int vfs_unmount(const char* mountpoint) {
 }
 
 /**
- * Allocate a file descriptor
+ * Give an open file a descriptor in the calling process's table
+ * @param file Open file, consumed
+ */
+static int install_fd(file_t* file, int flags) {
+    if (!file) {
+        return -1;
+    }
+    int fd = fd_install(fdtable_current(), file, 0, flags & O_CLOEXEC);
+    if (fd < 0) {
+        file_put(file);
+    }
+    return fd;
+}
+
+/**
+ * Get the open file behind a descriptor
+ */
+static file_t* get_fd(int fd) {
+    return fd_get(fdtable_current(), fd);
+}
+
+/**
+ * Walk a path from the root one component at a time through the dentry
+ * cache, asking the filesystem only about components not cached yet
+ * Paths are taken from the root, as the filesystems take them.
+ * @param dentry Referenced root dentry, consumed
+ * @return Referenced dentry of the last component (negative if it does
+ *         not exist), or NULL if a directory on the way is missing
  */
-static int alloc_fd(void) {
-    for (int i = 0; i < MAX_OPEN_FILES; i++) {
-        if (fd_table[i].fd == -1) {
-            fd_table[i].fd = i;
-            fd_table[i].ref_count = 1;
-            return i;
+static dentry_t* path_walk(dentry_t* dentry, const char* path) {
+    const char* p = path;
+    
+    for (;;) {
+        while (*p == '/') p++;
+        if (!*p) break;
+        
+        const char* name = p;
+        while (*p && *p != '/') p++;
+        uint32_t len = (uint32_t)(p - name);
+        
+        if (len == 1 && name[0] == '.') {
+            continue;
+        }
+        if (len == 2 && name[0] == '.' && name[1] == '.') {
+            dentry_t* parent = dget(dentry->parent);
+            dput(dentry);
+            dentry = parent;
+            continue;
+        }
+        
+        if (!dentry->inode || dentry->inode->type != FILE_TYPE_DIRECTORY ||
+            len >= MAX_FILENAME_LENGTH) {
+            dput(dentry);
+            return NULL;
+        }
+        
+        dentry_t* child = dcache_lookup(dentry, name, len);
+        if (!child) {
+            char component[MAX_FILENAME_LENGTH];
+            for (uint32_t i = 0; i < len; i++) {
+                component[i] = name[i];
+            }
+            component[len] = '\0';
+            
+            inode_t* inode = root_fs->ops->lookup_child(dentry->inode, component);
+            child = dcache_add(dentry, name, len, inode);
+        }
+        
+        dput(dentry);
+        if (!child) {
+            return NULL;
         }
+        dentry = child;
     }
-    return -1;
+    
+    return dentry;
 }
 
 /**
- * Get file descriptor entry
+ * Look up a path's inode, through the dentry cache when possible
+ * @param pinned If not NULL, receives a reference to the path's dentry
+ *               (NULL when the path is not cached)
+ * @return Inode, or NULL if the path does not exist
  */
-static file_descriptor_t* get_fd(int fd) {
-    if (fd < 0 || fd >= MAX_OPEN_FILES || fd_table[fd].fd == -1) {
+static inode_t* vfs_lookup_pinned(const char* path, dentry_t** pinned) {
+    if (pinned) {
+        *pinned = NULL;
+    }
+    if (!root_fs || !root_fs->ops) {
+        return NULL;
+    }
+    
+    dentry_t* root = root_fs->ops->lookup_child ? dcache_root() : NULL;
+    if (!root) {
+        return root_fs->ops->lookup ? root_fs->ops->lookup(path) : NULL;
+    }
+    
+    dentry_t* dentry = path_walk(root, path);
+    if (!dentry) {
         return NULL;
     }
-    return &fd_table[fd];
+    
+    inode_t* inode = dentry->inode;
+    if (pinned && inode) {
+        *pinned = dentry;
+    } else {
+        dput(dentry);
+    }
+    return inode;
+}
+
+static inode_t* vfs_lookup(const char* path) {
+    return vfs_lookup_pinned(path, NULL);
+}
+
+/**
+ * Drop a path's cached dentry after the filesystem changed it
+ * Only cached components are followed; nothing is looked up.
+ */
+static void path_forget(const char* path) {
+    dentry_t* dentry = dcache_root();
+    if (!dentry) {
+        return;
+    }
+    
+    const char* p = path;
+    for (;;) {
+        while (*p == '/') p++;
+        if (!*p) break;
+        
+        const char* name = p;
+        while (*p && *p != '/') p++;
+        uint32_t len = (uint32_t)(p - name);
+        
+        dentry_t* next;
+        if (len == 1 && name[0] == '.') {
+            continue;
+        } else if (len == 2 && name[0] == '.' && name[1] == '.') {
+            next = dget(dentry->parent);
+        } else {
+            next = dcache_lookup(dentry, name, len);
+        }
+        
+        dput(dentry);
+        if (!next) {
+            return;
+        }
+        dentry = next;
+    }
+    
+    dcache_drop(dentry);
+    dput(dentry);
 }
 
 /**
@@ -165,92 +303,91 @@ int vfs_open(const char* path, int flags) {
         return -1;
     }
     
-    /* Allocate file descriptor */
-    int fd = alloc_fd();
-    if (fd < 0) {
-        return -1;
-    }
-    
     /* Lookup inode */
-    inode_t* inode = root_fs->ops->lookup(path);
+    dentry_t* dentry = NULL;
+    inode_t* inode = vfs_lookup_pinned(path, &dentry);
     
     /* If file doesn't exist and O_CREAT is set, create it */
     if (!inode && (flags & O_CREAT)) {
         if (root_fs->ops->create) {
             int result = root_fs->ops->create(path, FILE_TYPE_REGULAR);
             if (result == 0) {
-                inode = root_fs->ops->lookup(path);
+                path_forget(path);
+                inode = vfs_lookup_pinned(path, &dentry);
             }
         }
     }
     
     if (!inode) {
-        fd_table[fd].fd = -1;
         return -1;
     }
     
-    /* Initialize file descriptor */
-    fd_table[fd].inode = inode;
-    fd_table[fd].offset = (flags & O_APPEND) ? inode->size : 0;
-    fd_table[fd].flags = flags;
-    
-    return fd;
+    /* Open the file and give it a descriptor */
+    file_t* file = file_alloc(inode, dentry, flags);
+    if (file && (flags & O_APPEND)) {
+        file->offset = inode->size;
+    }
+    return install_fd(file, flags);
 }
 
 /**
  * Close a file
  */
 int vfs_close(int fd) {
-    file_descriptor_t* file = get_fd(fd);
-    if (!file) {
-        return -1;
-    }
-    
-    /* Decrement reference count */
-    file->ref_count--;
-    
-    /* If no more references, free the descriptor */
-    if (file->ref_count <= 0) {
-        file->fd = -1;
-        file->inode = NULL;
-        file->offset = 0;
-        file->flags = 0;
-        file->ref_count = 0;
-    }
-    
-    return 0;
+    /* The open file goes when its last descriptor does */
+    return fd_close(fdtable_current(), fd);
+}
+
+/**
+ * Duplicate a descriptor; both share the open file and its offset
+ */
+int vfs_dup(int fd) {
+    return fd_dup(fdtable_current(), fd, 0);
+}
+
+/**
+ * Duplicate a descriptor to a given number, closing what was there
+ */
+int vfs_dup2(int oldfd, int newfd) {
+    return fd_dup2(fdtable_current(), oldfd, newfd);
+}
+
+/**
+ * Set or clear a descriptor's close-on-exec flag
+ */
+int vfs_set_cloexec(int fd, int cloexec) {
+    return fd_set_cloexec(fdtable_current(), fd, cloexec);
 }
 
 /**
  * Read from a file
  */
 int vfs_read(int fd, void* buffer, size_t size) {
-    file_descriptor_t* file = get_fd(fd);
+    file_t* file = get_fd(fd);
     if (!file || !buffer || !file->inode) {
         return -1;
     }
     
-    /* Check if file is open for reading */
-    if ((file->flags & O_WRONLY) && !(file->flags & O_RDWR)) {
+    /* Check if file is open for reading (no access bits reads, as O_RDONLY) */
+    if ((file->flags & O_RDWR) == O_WRONLY) {
         return -1;
     }
     
-    /* Read from file using file system operations */
-    int bytes_read = 0;
+    inode_t* inode = file->inode;
+    file_ops_t* fops = inode->fops;
+    int bytes_read;
     
-    /* Get file system specific operations from inode */
-    if (root_fs && root_fs->ops) {
-        /* Use ramdisk read operation directly */
-        /* In a more complete implementation, would have file_ops in inode */
-        inode_t* inode = file->inode;
-        if (inode && inode->fs_data) {
-            /* Call file system specific read (simplified) */
-            /* Actual implementation would use function pointers in inode */
-            bytes_read = (int)size; /* Simplified */
-            if (bytes_read > 0) {
-                bytes_read = 0; /* Will be implemented by fs-specific code */
-            }
-        }
+    /* Go through the page cache when the filesystem supports it */
+    if (fops && fops->readpage) {
+        bytes_read = page_cache_read(inode, &file->ra, buffer, size, file->offset);
+    } else if (fops && fops->read) {
+        bytes_read = fops->read(inode, buffer, size, file->offset);
+    } else {
+        return -1;
+    }
+    
+    if (bytes_read < 0) {
+        return -1;
     }
     
     /* Update file offset */
@@ -263,31 +400,35 @@ int vfs_read(int fd, void* buffer, size_t size) {
  * Write to a file
  */
 int vfs_write(int fd, const void* buffer, size_t size) {
-    file_descriptor_t* file = get_fd(fd);
+    file_t* file = get_fd(fd);
     if (!file || !buffer || !file->inode) {
         return -1;
     }
     
     /* Check if file is open for writing */
-    if ((file->flags & O_RDONLY) && !(file->flags & O_RDWR)) {
+    if (!(file->flags & O_WRONLY)) {
         return -1;
     }
     
-    /* Write to file using file system operations */
-    int bytes_written = 0;
+    inode_t* inode = file->inode;
+    file_ops_t* fops = inode->fops;
+    int bytes_written;
     
-    /* Get file system specific operations from inode */
-    if (root_fs && root_fs->ops) {
-        /* Use file system specific write operation */
-        inode_t* inode = file->inode;
-        if (inode && inode->fs_data) {
-            /* Call file system specific write (simplified) */
-            /* Actual implementation would use function pointers in inode */
-            bytes_written = (int)size; /* Simplified */
-            if (bytes_written > 0) {
-                bytes_written = 0; /* Will be implemented by fs-specific code */
-            }
-        }
+    if (file->flags & O_APPEND) {
+        file->offset = inode->size;
+    }
+    
+    /* Go through the page cache when the filesystem supports it */
+    if (fops && fops->writepage) {
+        bytes_written = page_cache_write(inode, buffer, size, file->offset);
+    } else if (fops && fops->write) {
+        bytes_written = fops->write(inode, buffer, size, file->offset);
+    } else {
+        return -1;
+    }
+    
+    if (bytes_written < 0) {
+        return -1;
     }
     
     /* Update file offset */
@@ -300,7 +441,7 @@ int vfs_write(int fd, const void* buffer, size_t size) {
  * Seek in a file
  */
 int vfs_seek(int fd, long offset, int whence) {
-    file_descriptor_t* file = get_fd(fd);
+    file_t* file = get_fd(fd);
     if (!file || !file->inode) {
         return -1;
     }
@@ -329,6 +470,42 @@ int vfs_seek(int fd, long offset, int whence) {
     return (int)new_offset;
 }
 
+/**
+ * Write back an open file's dirty pages, then let the filesystem make
+ * its metadata durable
+ */
+static int sync_file(int fd, int datasync) {
+    file_t* file = get_fd(fd);
+    if (!file || !file->inode) {
+        return -1;
+    }
+
+    inode_t* inode = file->inode;
+    if (page_cache_sync(inode) != 0) {
+        /* Recording metadata over data that never arrived would expose it */
+        return -1;
+    }
+
+    if (inode->fops && inode->fops->fsync) {
+        return inode->fops->fsync(inode, datasync);
+    }
+    return 0;
+}
+
+/**
+ * Flush a file's data and metadata to its device
+ */
+int vfs_fsync(int fd) {
+    return sync_file(fd, 0);
+}
+
+/**
+ * Flush a file's data and the metadata needed to read it back
+ */
+int vfs_fdatasync(int fd) {
+    return sync_file(fd, 1);
+}
+
 /**
  * Create a directory
  */
@@ -337,31 +514,40 @@ int vfs_mkdir(const char* path) {
         return -1;
     }
     
-    return root_fs->ops->create(path, FILE_TYPE_DIRECTORY);
+    int result = root_fs->ops->create(path, FILE_TYPE_DIRECTORY);
+    if (result == 0) {
+        path_forget(path);
+    }
+    return result;
 }
 
 /**
  * Remove a directory
  */
 int vfs_rmdir(const char* path) {
-    if (!path || !root_fs || !root_fs->ops || !root_fs->ops->unlink) {
+    if (!path || !root_fs || !root_fs->ops ||
+        (!root_fs->ops->rmdir && !root_fs->ops->unlink)) {
         return -1;
     }
     
     /* Verify it's a directory */
-    inode_t* inode = root_fs->ops->lookup(path);
+    inode_t* inode = vfs_lookup(path);
     if (!inode || inode->type != FILE_TYPE_DIRECTORY) {
         return -1;
     }
     
-    return root_fs->ops->unlink(path);
+    int result = root_fs->ops->rmdir ? root_fs->ops->rmdir(path) : root_fs->ops->unlink(path);
+    if (result == 0) {
+        path_forget(path);
+    }
+    return result;
 }
 
 /**
  * Read directory entry
  */
 int vfs_readdir(int fd, dirent_t* entry) {
-    file_descriptor_t* file = get_fd(fd);
+    file_t* file = get_fd(fd);
     if (!file || !entry || !file->inode) {
         return -1;
     }
@@ -394,7 +580,11 @@ int vfs_create(const char* path) {
         return -1;
     }
     
-    return root_fs->ops->create(path, FILE_TYPE_REGULAR);
+    int result = root_fs->ops->create(path, FILE_TYPE_REGULAR);
+    if (result == 0) {
+        path_forget(path);
+    }
+    return result;
 }
 
 /**
@@ -405,7 +595,18 @@ int vfs_unlink(const char* path) {
         return -1;
     }
     
-    return root_fs->ops->unlink(path);
+    /* Drop the file's cached pages; this waits out any being written
+     * back, so nothing calls into the inode once the filesystem frees it */
+    inode_t* inode = vfs_lookup(path);
+    if (inode) {
+        page_cache_truncate(&inode->mapping, 0);
+    }
+    
+    int result = root_fs->ops->unlink(path);
+    if (result == 0) {
+        path_forget(path);
+    }
+    return result;
 }
 
 /**
@@ -416,7 +617,7 @@ int vfs_stat(const char* path, inode_t* stat) {
         return -1;
     }
     
-    inode_t* inode = root_fs->ops->lookup(path);
+    inode_t* inode = vfs_lookup(path);
     if (!inode) {
         return -1;
     }
@@ -435,6 +636,8 @@ int vfs_stat(const char* path, inode_t* stat) {
     stat->ctime = inode->ctime;
     stat->parent_ino = inode->parent_ino;
     stat->fs_data = inode->fs_data;
+    stat->fops = inode->fops;
+    page_cache_mapping_init(&stat->mapping, NULL);
     
     return 0;
 }
@@ -476,9 +679,11 @@ int vfs_cache_file(const char* path) {
         return -1;
     }
     
-    /* Read file content (simplified - actual read would use fs-specific ops) */
-    /* For now, just attempt to cache with placeholder data */
-    int result = file_cache_store(path, temp_buffer, stat.size);
+    /* Read file content */
+    int result = -1;
+    if (vfs_read(fd, temp_buffer, stat.size) == (int)stat.size) {
+        result = file_cache_store(path, temp_buffer, stat.size);
+    }
     
     kfree(temp_buffer);
     vfs_close(fd);
@@ -525,15 +730,22 @@ int vfs_mkdir_mode(const char* path, uint16_t mode) {
     
     /* Use mkdir operation if available */
     if (root_fs->ops->mkdir) {
-        return root_fs->ops->mkdir(path, mode);
+        int result = root_fs->ops->mkdir(path, mode);
+        if (result == 0) {
+            path_forget(path);
+        }
+        return result;
     }
     
     /* Fall back to create with directory type */
     if (root_fs->ops->create) {
         int result = root_fs->ops->create(path, FILE_TYPE_DIRECTORY);
-        if (result == 0 && root_fs->ops->chmod) {
-            /* Set permissions after creation */
-            root_fs->ops->chmod(path, mode);
+        if (result == 0) {
+            path_forget(path);
+            if (root_fs->ops->chmod) {
+                /* Set permissions after creation */
+                root_fs->ops->chmod(path, mode);
+            }
         }
         return result;
     }
@@ -550,9 +762,12 @@ int vfs_create_mode(const char* path, uint16_t mode) {
     }
     
     int result = root_fs->ops->create(path, FILE_TYPE_REGULAR);
-    if (result == 0 && root_fs->ops->chmod) {
-        /* Set permissions after creation */
-        root_fs->ops->chmod(path, mode);
+    if (result == 0) {
+        path_forget(path);
+        if (root_fs->ops->chmod) {
+            /* Set permissions after creation */
+            root_fs->ops->chmod(path, mode);
+        }
     }
     
     return result;
@@ -567,23 +782,15 @@ int vfs_opendir(const char* path) {
     }
     
     /* Lookup directory inode */
-    inode_t* inode = root_fs->ops->lookup(path);
+    dentry_t* dentry = NULL;
+    inode_t* inode = vfs_lookup_pinned(path, &dentry);
     if (!inode || inode->type != FILE_TYPE_DIRECTORY) {
+        dput(dentry);
         return -1;
     }
     
-    /* Allocate file descriptor */
-    int fd = alloc_fd();
-    if (fd < 0) {
-        return -1;
-    }
-    
-    /* Initialize file descriptor for directory */
-    fd_table[fd].inode = inode;
-    fd_table[fd].offset = 0;
-    fd_table[fd].flags = O_RDONLY;
-    
-    return fd;
+    /* Open the directory and give it a descriptor */
+    return install_fd(file_alloc(inode, dentry, O_RDONLY), O_RDONLY);
 }
 
 /**
@@ -606,7 +813,7 @@ int vfs_chmod(const char* path, uint16_t mode) {
     }
     
     /* If chmod not supported, try to update inode directly */
-    inode_t* inode = root_fs->ops->lookup ? root_fs->ops->lookup(path) : NULL;
+    inode_t* inode = vfs_lookup(path);
     if (inode) {
         inode->mode = mode;
         return 0;
@@ -628,7 +835,7 @@ int vfs_chown(const char* path, uint16_t uid, uint16_t gid) {
     }
     
     /* If chown not supported, try to update inode directly */
-    inode_t* inode = root_fs->ops->lookup ? root_fs->ops->lookup(path) : NULL;
+    inode_t* inode = vfs_lookup(path);
     if (inode) {
         inode->uid = uid;
         inode->gid = gid;
@@ -646,7 +853,7 @@ int vfs_access(const char* path, int mode) {
         return -1;
     }
     
-    inode_t* inode = root_fs->ops->lookup(path);
+    inode_t* inode = vfs_lookup(path);
     if (!inode) {
         return -1; /* File doesn't exist */
     }
@@ -700,7 +907,13 @@ int vfs_rename(const char* oldpath, const char* newpath) {
     }
     
     if (root_fs->ops->rename) {
-        return root_fs->ops->rename(oldpath, newpath);
+        int result = root_fs->ops->rename(oldpath, newpath);
+        if (result == 0) {
+            /* A renamed directory takes its cached subtree with it */
+            path_forget(oldpath);
+            path_forget(newpath);
+        }
+        return result;
     }
     
     return -1; /* Not supported */
@@ -733,7 +946,7 @@ int vfs_chdir(const char* path) {
     }
     
     /* Verify path exists and is a directory */
-    inode_t* inode = root_fs->ops->lookup(path);
+    inode_t* inode = vfs_lookup(path);
     if (!inode || inode->type != FILE_TYPE_DIRECTORY) {
         return -1;
     }
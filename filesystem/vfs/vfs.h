@@ -9,12 +9,16 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "../cache/page_cache.h"
+#include "../cache/dcache.h"
 
-/* Maximum number of open files */
-#define MAX_OPEN_FILES 256
+/* Path limits */
 #define MAX_PATH_LENGTH 256
 #define MAX_FILENAME_LENGTH 64
 
+/* bmap result for a page with no block yet */
+#define VFS_BLOCK_NONE 0xFFFFFFFF
+
 /* File open flags */
 #define O_RDONLY    0x0001
 #define O_WRONLY    0x0002
@@ -23,6 +27,7 @@
 #define O_APPEND    0x0200
 #define O_TRUNC     0x0400
 #define O_EXCL      0x0800
+#define O_CLOEXEC   0x1000
 
 /* Seek whence values */
 #define SEEK_SET    0
@@ -83,23 +88,42 @@ typedef struct inode {
     uint32_t ctime;        /* Creation time */
     uint32_t parent_ino;   /* Parent directory inode */
     void* fs_data;
+    struct file_ops* fops; /* Data operations; NULL if the file has none */
+    address_space_t mapping; /* Cached pages of the file's data */
 } inode_t;
 
-/* File descriptor entry */
-typedef struct file_descriptor {
-    int fd;
+/* Open file, shared by every descriptor dup()ed or inherited from the
+ * one that opened it; see fdtable.h */
+typedef struct file {
     inode_t* inode;
     uint32_t offset;
     int flags;
-    int ref_count;
-} file_descriptor_t;
+    int refcount;
+    struct dentry* dentry; /* Pins the opened path in the dcache; may be NULL */
+    file_ra_state_t ra;    /* Readahead through the page cache */
+} file_t;
 
-/* File operations */
+/* File operations. Filesystems with readpage/writepage are read and
+ * written through the page cache; read/write are the uncached fallback. */
 typedef struct file_ops {
     int (*open)(inode_t* inode, int flags);
     int (*close)(inode_t* inode);
     int (*read)(inode_t* inode, void* buffer, size_t size, uint32_t offset);
     int (*write)(inode_t* inode, const void* buffer, size_t size, uint32_t offset);
+    /* Fill a PAGE_CACHE_SIZE page, zeroing past end of file; 0 or -1 */
+    int (*readpage)(inode_t* inode, uint32_t index, void* page);
+    /* Fill count consecutive pages in one request (optional; readahead
+     * falls back to readpage per page); 0 or -1 */
+    int (*readpages)(inode_t* inode, uint32_t index, uint32_t count, void** pages);
+    /* Store the first length bytes of a page, growing the file; 0 or -1 */
+    int (*writepage)(inode_t* inode, uint32_t index, const void* page, uint32_t length);
+    /* Device block holding a page, or VFS_BLOCK_NONE, so writeback can
+     * go in block order (optional) */
+    uint32_t (*bmap)(inode_t* inode, uint32_t index);
+    /* Make the file's metadata durable once its data has been written
+     * back; with datasync, only what reading the data back needs, such as
+     * its size (optional); 0 or -1 */
+    int (*fsync)(inode_t* inode, int datasync);
 } file_ops_t;
 
 /* Directory entry structure (forward declaration) */
@@ -110,6 +134,9 @@ typedef struct fs_ops {
     int (*mount)(const char* device);
     int (*unmount)(void);
     inode_t* (*lookup)(const char* path);
+    /* Find one name in a directory, so paths can be walked through the
+     * dentry cache; without it every lookup goes by full path */
+    inode_t* (*lookup_child)(inode_t* dir, const char* name);
     int (*create)(const char* path, file_type_t type);
     int (*unlink)(const char* path);
     int (*readdir)(inode_t* dir, dirent_t* entry, uint32_t index);
@@ -139,6 +166,11 @@ int vfs_close(int fd);
 int vfs_read(int fd, void* buffer, size_t size);
 int vfs_write(int fd, const void* buffer, size_t size);
 int vfs_seek(int fd, long offset, int whence);
+int vfs_fsync(int fd);
+int vfs_fdatasync(int fd);
+int vfs_dup(int fd);
+int vfs_dup2(int oldfd, int newfd);
+int vfs_set_cloexec(int fd, int cloexec);
 
 /* Directory operations */
 int vfs_mkdir(const char* path);
@@ -377,6 +377,7 @@ typedef struct {
     int socket_fd;                              /* Socket file descriptor */
     char packet_buffer[AURORA_VM_GDB_PACKET_SIZE]; /* Packet buffer */
     bool break_requested;                       /* Break request */
+    bool no_ack_mode;                           /* QStartNoAckMode negotiated */
 } aurora_gdb_server_t;
 
 /* Virtual machine instance */
@@ -827,6 +828,29 @@ void aurora_vm_gdb_stop(AuroraVM *vm);
  */
 int aurora_vm_gdb_handle(AuroraVM *vm);
 
+/**
+ * Process a raw GDB RSP packet and generate the framed response
+ * The response is preceded by a '+' ack unless no-ack mode is active.
+ * @param vm VM instance
+ * @param packet Packet text starting at or before '$'
+ * @param response Output buffer for the framed response
+ * @param response_size Output buffer size
+ * @return Response length, or -1 on error
+ */
+int aurora_vm_gdb_process_packet(AuroraVM *vm, const char *packet,
+                                 char *response, size_t response_size);
+
+/**
+ * Describe the guest address space as a GDB memory-map XML document
+ * Present pages are coalesced into ram (writable) and rom regions; the
+ * MMIO window is reported as its own ram region.
+ * @param vm VM instance
+ * @param buffer Output buffer (NUL-terminated on success)
+ * @param size Buffer size
+ * @return Document length, or -1 if the buffer is too small
+ */
+int aurora_vm_gdb_memory_map(const AuroraVM *vm, char *buffer, size_t size);
+
 /* ===== VM Snapshot API ===== */
 
 /**
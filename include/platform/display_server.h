@@ -0,0 +1,360 @@
+/**
+ * @file display_server.h
+ * @brief X11/Wayland Display Server for Linux VMs
+ *
+ * Protocol constants and entry points of the display server in
+ * display_server.c
+ */
+
+#ifndef DISPLAY_SERVER_H
+#define DISPLAY_SERVER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Display protocol types */
+typedef enum {
+    DISPLAY_PROTOCOL_NONE = 0,
+    DISPLAY_PROTOCOL_X11,
+    DISPLAY_PROTOCOL_WAYLAND
+} display_protocol_t;
+
+/* X11 Protocol Constants */
+#define X11_PROTOCOL_MAJOR      11
+#define X11_PROTOCOL_MINOR      0
+
+/* X11 Request opcodes */
+typedef enum {
+    X11_CreateWindow = 1,
+    X11_ChangeWindowAttributes = 2,
+    X11_GetWindowAttributes = 3,
+    X11_DestroyWindow = 4,
+    X11_DestroySubwindows = 5,
+    X11_ChangeSaveSet = 6,
+    X11_ReparentWindow = 7,
+    X11_MapWindow = 8,
+    X11_MapSubwindows = 9,
+    X11_UnmapWindow = 10,
+    X11_UnmapSubwindows = 11,
+    X11_ConfigureWindow = 12,
+    X11_CirculateWindow = 13,
+    X11_GetGeometry = 14,
+    X11_QueryTree = 15,
+    X11_InternAtom = 16,
+    X11_GetAtomName = 17,
+    X11_ChangeProperty = 18,
+    X11_DeleteProperty = 19,
+    X11_GetProperty = 20,
+    X11_ListProperties = 21,
+    X11_SetSelectionOwner = 22,
+    X11_GetSelectionOwner = 23,
+    X11_ConvertSelection = 24,
+    X11_SendEvent = 25,
+    X11_GrabPointer = 26,
+    X11_UngrabPointer = 27,
+    X11_GrabButton = 28,
+    X11_UngrabButton = 29,
+    X11_ChangeActivePointerGrab = 30,
+    X11_GrabKeyboard = 31,
+    X11_UngrabKeyboard = 32,
+    X11_GrabKey = 33,
+    X11_UngrabKey = 34,
+    X11_AllowEvents = 35,
+    X11_GrabServer = 36,
+    X11_UngrabServer = 37,
+    X11_QueryPointer = 38,
+    X11_GetMotionEvents = 39,
+    X11_TranslateCoords = 40,
+    X11_WarpPointer = 41,
+    X11_SetInputFocus = 42,
+    X11_GetInputFocus = 43,
+    X11_QueryKeymap = 44,
+    X11_OpenFont = 45,
+    X11_CloseFont = 46,
+    X11_QueryFont = 47,
+    X11_QueryTextExtents = 48,
+    X11_ListFonts = 49,
+    X11_ListFontsWithInfo = 50,
+    X11_SetFontPath = 51,
+    X11_GetFontPath = 52,
+    X11_CreatePixmap = 53,
+    X11_FreePixmap = 54,
+    X11_CreateGC = 55,
+    X11_ChangeGC = 56,
+    X11_CopyGC = 57,
+    X11_SetDashes = 58,
+    X11_SetClipRectangles = 59,
+    X11_FreeGC = 60,
+    X11_ClearArea = 61,
+    X11_CopyArea = 62,
+    X11_CopyPlane = 63,
+    X11_PolyPoint = 64,
+    X11_PolyLine = 65,
+    X11_PolySegment = 66,
+    X11_PolyRectangle = 67,
+    X11_PolyArc = 68,
+    X11_FillPoly = 69,
+    X11_PolyFillRectangle = 70,
+    X11_PolyFillArc = 71,
+    X11_PutImage = 72,
+    X11_GetImage = 73,
+    X11_PolyText8 = 74,
+    X11_PolyText16 = 75,
+    X11_ImageText8 = 76,
+    X11_ImageText16 = 77,
+    X11_CreateColormap = 78,
+    X11_FreeColormap = 79,
+    X11_CopyColormapAndFree = 80,
+    X11_InstallColormap = 81,
+    X11_UninstallColormap = 82,
+    X11_ListInstalledColormaps = 83,
+    X11_AllocColor = 84,
+    X11_AllocNamedColor = 85,
+    X11_AllocColorCells = 86,
+    X11_AllocColorPlanes = 87,
+    X11_FreeColors = 88,
+    X11_StoreColors = 89,
+    X11_StoreNamedColor = 90,
+    X11_QueryColors = 91,
+    X11_LookupColor = 92,
+    X11_CreateCursor = 93,
+    X11_CreateGlyphCursor = 94,
+    X11_FreeCursor = 95,
+    X11_RecolorCursor = 96,
+    X11_QueryBestSize = 97,
+    X11_QueryExtension = 98,
+    X11_ListExtensions = 99,
+    X11_ChangeKeyboardMapping = 100,
+    X11_GetKeyboardMapping = 101,
+    X11_ChangeKeyboardControl = 102,
+    X11_GetKeyboardControl = 103,
+    X11_Bell = 104,
+    X11_ChangePointerControl = 105,
+    X11_GetPointerControl = 106,
+    X11_SetScreenSaver = 107,
+    X11_GetScreenSaver = 108,
+    X11_ChangeHosts = 109,
+    X11_ListHosts = 110,
+    X11_SetAccessControl = 111,
+    X11_SetCloseDownMode = 112,
+    X11_KillClient = 113,
+    X11_RotateProperties = 114,
+    X11_ForceScreenSaver = 115,
+    X11_SetPointerMapping = 116,
+    X11_GetPointerMapping = 117,
+    X11_SetModifierMapping = 118,
+    X11_GetModifierMapping = 119,
+    X11_NoOperation = 127
+} x11_request_t;
+
+/* Wayland Protocol Constants */
+#define WL_DISPLAY_SYNC             0
+#define WL_DISPLAY_GET_REGISTRY     1
+#define WL_REGISTRY_BIND            0
+#define WL_COMPOSITOR_CREATE_SURFACE 0
+#define WL_COMPOSITOR_CREATE_REGION 1
+#define WL_SHM_CREATE_POOL          0
+#define WL_SHM_POOL_CREATE_BUFFER   0
+#define WL_SURFACE_DESTROY          0
+#define WL_SURFACE_ATTACH           1
+#define WL_SURFACE_DAMAGE           2
+#define WL_SURFACE_FRAME            3
+#define WL_SURFACE_COMMIT           4
+
+
+/* X11 error codes, returned negated by the request handlers */
+#define X11_BadRequest              1
+#define X11_BadValue                2
+#define X11_BadWindow               3
+#define X11_BadPixmap               4
+#define X11_BadMatch                8
+#define X11_BadDrawable             9
+#define X11_BadAlloc                11
+#define X11_BadGC                   13
+#define X11_BadIDChoice             14
+#define X11_BadLength               16
+#define X11_BadImplementation       17
+
+/* PutImage formats */
+#define X11_IMAGE_XYBITMAP          0
+#define X11_IMAGE_XYPIXMAP          1
+#define X11_IMAGE_ZPIXMAP           2
+
+/* GC functions used by the fast paths */
+#define X11_GXcopy                  3
+
+/* wl_shm formats */
+#define WL_SHM_FORMAT_ARGB8888      0           /* Premultiplied alpha */
+#define WL_SHM_FORMAT_XRGB8888      1
+
+/* X11 server statistics */
+typedef struct {
+    uint64_t requests;          /* Requests executed */
+    uint64_t errors;            /* Requests that failed */
+    uint64_t batches;           /* Dispatch passes over buffered requests */
+    uint64_t flushes;           /* Framebuffer flushes */
+    uint64_t flushed_pixels;    /* Pixels copied to the framebuffer */
+} x11_stats_t;
+
+/* Wayland compositor statistics */
+typedef struct {
+    uint64_t commits;           /* Surface commits */
+    uint64_t repaints;          /* Composition passes into the framebuffer */
+    uint64_t composed_pixels;   /* Pixels read from client buffers */
+    uint64_t flips;             /* Client buffers put on scanout directly */
+    uint64_t releases;          /* Buffers handed back to clients */
+    uint64_t frame_callbacks;   /* Frame callbacks fired */
+} wl_stats_t;
+
+/* ============================================================================
+ * X11 SERVER
+ * ============================================================================ */
+
+/**
+ * Initialize X11 server
+ * Depths 24 and 32 are stored at 32 bits per pixel. Drawing goes to a
+ * shadow buffer and reaches the framebuffer when damage is flushed.
+ * @param width Screen width in pixels
+ * @param height Screen height in pixels
+ * @param depth Screen depth
+ * @param framebuffer Scanout framebuffer (width * height pixels)
+ * @return 0 on success
+ */
+int x11_server_init(uint32_t width, uint32_t height, uint8_t depth, void* framebuffer);
+
+/**
+ * Execute a single X11 request and flush its damage
+ * @param client_id Client index
+ * @param opcode Major opcode (matches data[0])
+ * @param data Complete request as sent on the wire (LSB first), header included
+ * @param length Request length in bytes
+ * @return 0 on success, negated X11 error code on failure
+ */
+int x11_process_request(uint32_t client_id, uint8_t opcode, uint8_t* data, uint32_t length);
+
+/**
+ * Queue bytes received from a client's connection
+ * @param client_id Client index
+ * @param data Received bytes, any split of the request stream
+ * @param length Number of bytes
+ * @return Bytes accepted (less than length when the buffer is full), -1 on error
+ */
+int x11_client_write(uint32_t client_id, const uint8_t* data, uint32_t length);
+
+/**
+ * Execute the complete requests buffered for one client
+ * Damage from the whole batch is coalesced into a single flush.
+ * @param client_id Client index
+ * @param max_requests Request budget for this wakeup (0 = no limit)
+ * @return Number of requests executed, or negated X11 error code if the
+ *         stream is unusable (the buffer is discarded)
+ */
+int x11_dispatch_client(uint32_t client_id, uint32_t max_requests);
+
+/**
+ * Execute buffered requests of every connected client, then flush once
+ * @param max_requests Per-client request budget (0 = no limit)
+ * @return Total number of requests executed
+ */
+int x11_server_dispatch(uint32_t max_requests);
+
+/**
+ * Get X11 server statistics
+ */
+void x11_get_stats(x11_stats_t* stats);
+
+int x11_accept_client(void);
+int x11_disconnect_client(uint32_t client_id);
+
+/* ============================================================================
+ * WAYLAND COMPOSITOR
+ * ============================================================================ */
+
+int wayland_compositor_init(uint32_t width, uint32_t height, void* framebuffer);
+int wayland_process_message(uint32_t client_id, uint32_t object_id,
+                            uint16_t opcode, uint8_t* data, uint32_t length);
+int wayland_create_surface(uint32_t client_id);
+int wayland_accept_client(void);
+
+/**
+ * Create a wl_shm pool over memory shared with the client
+ * @param client_id Client index
+ * @param data Client memory, read in place by the compositor
+ * @param size Pool size in bytes
+ * @return Pool id, or -1 on error
+ */
+int wayland_shm_create_pool(uint32_t client_id, void* data, int32_t size);
+
+/**
+ * Create a buffer within a pool
+ * @param format WL_SHM_FORMAT_ARGB8888 or WL_SHM_FORMAT_XRGB8888
+ * @return Buffer id, or -1 if the buffer does not fit the pool
+ */
+int wayland_shm_pool_create_buffer(uint32_t client_id, uint32_t pool_id, int32_t offset,
+                                   int32_t width, int32_t height, int32_t stride, uint32_t format);
+
+/**
+ * Attach a buffer as the surface's pending content
+ * @param buffer_id Buffer id, or 0 to unmap the surface
+ * @param x, y Offset of the new buffer relative to the current one
+ */
+int wayland_surface_attach(uint32_t client_id, uint32_t surface_id, uint32_t buffer_id,
+                           int32_t x, int32_t y);
+
+/**
+ * Mark a rectangle of the pending buffer as changed (surface coordinates)
+ */
+int wayland_surface_damage(uint32_t client_id, uint32_t surface_id,
+                           int32_t x, int32_t y, int32_t width, int32_t height);
+
+/**
+ * Request a frame callback, delivered at the vblank after the next commit
+ */
+int wayland_surface_frame(uint32_t client_id, uint32_t surface_id);
+
+/**
+ * Place a surface on the output (shell policy, not a client request)
+ */
+int wayland_surface_set_position(uint32_t client_id, uint32_t surface_id, int32_t x, int32_t y);
+
+/**
+ * Apply a surface's pending state and update the output
+ * Damaged areas are composed straight from client memory. A fullscreen
+ * opaque buffer on top is scanned out directly instead.
+ * @return 0 on success, -1 on invalid ids
+ */
+int wayland_commit_surface(uint32_t client_id, uint32_t surface_id);
+
+/**
+ * Signal vertical blank, firing pending frame callbacks
+ * @return Number of callbacks fired
+ */
+int wayland_output_vblank(void);
+
+/**
+ * Check whether the compositor still holds a buffer
+ * The client must not write to a busy buffer (no wl_buffer.release yet).
+ */
+bool wayland_buffer_busy(uint32_t client_id, uint32_t buffer_id);
+
+/**
+ * Get the memory to scan out: the framebuffer or a flipped client buffer
+ */
+void* wayland_get_scanout(void);
+
+/**
+ * Get Wayland compositor statistics
+ */
+void wayland_get_stats(wl_stats_t* stats);
+
+/* ============================================================================
+ * UNIFIED DISPLAY SERVER API
+ * ============================================================================ */
+
+int display_server_init(display_protocol_t protocol, uint32_t width, uint32_t height, void* framebuffer);
+void display_server_shutdown(void);
+display_protocol_t display_server_get_protocol(void);
+bool display_server_is_running(void);
+const char* display_server_get_version(void);
+
+#endif /* DISPLAY_SERVER_H */
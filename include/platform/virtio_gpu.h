@@ -0,0 +1,198 @@
+/**
+ * @file virtio_gpu.h
+ * @brief VirtIO GPU 2D Device Model
+ *
+ * Control queue command and response layouts for the virtio-gpu 2D
+ * command set (VirtIO 1.1, section 5.7) as processed by
+ * virtio_gpu_process_command() in gpu_passthrough.c
+ */
+
+#ifndef VIRTIO_GPU_H
+#define VIRTIO_GPU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Control queue commands */
+#define VIRTIO_GPU_CMD_GET_DISPLAY_INFO         0x0100
+#define VIRTIO_GPU_CMD_RESOURCE_CREATE_2D       0x0101
+#define VIRTIO_GPU_CMD_RESOURCE_UNREF           0x0102
+#define VIRTIO_GPU_CMD_SET_SCANOUT              0x0103
+#define VIRTIO_GPU_CMD_RESOURCE_FLUSH           0x0104
+#define VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D      0x0105
+#define VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING  0x0106
+#define VIRTIO_GPU_CMD_RESOURCE_DETACH_BACKING  0x0107
+#define VIRTIO_GPU_CMD_GET_CAPSET_INFO          0x0108
+#define VIRTIO_GPU_CMD_GET_CAPSET               0x0109
+#define VIRTIO_GPU_CMD_CTX_CREATE               0x0200
+#define VIRTIO_GPU_CMD_CTX_DESTROY              0x0201
+#define VIRTIO_GPU_CMD_CTX_ATTACH_RESOURCE      0x0202
+#define VIRTIO_GPU_CMD_CTX_DETACH_RESOURCE      0x0203
+#define VIRTIO_GPU_CMD_RESOURCE_CREATE_3D       0x0204
+#define VIRTIO_GPU_CMD_TRANSFER_TO_HOST_3D      0x0205
+#define VIRTIO_GPU_CMD_TRANSFER_FROM_HOST_3D    0x0206
+#define VIRTIO_GPU_CMD_SUBMIT_3D                0x0207
+#define VIRTIO_GPU_CMD_UPDATE_CURSOR            0x0300
+#define VIRTIO_GPU_CMD_MOVE_CURSOR              0x0301
+
+/* Responses */
+#define VIRTIO_GPU_RESP_OK_NODATA               0x1100
+#define VIRTIO_GPU_RESP_OK_DISPLAY_INFO         0x1101
+#define VIRTIO_GPU_RESP_ERR_UNSPEC              0x1200
+#define VIRTIO_GPU_RESP_ERR_OUT_OF_MEMORY       0x1201
+#define VIRTIO_GPU_RESP_ERR_INVALID_SCANOUT_ID  0x1202
+#define VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID 0x1203
+#define VIRTIO_GPU_RESP_ERR_INVALID_CONTEXT_ID  0x1204
+#define VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER   0x1205
+
+/* Header flags */
+#define VIRTIO_GPU_FLAG_FENCE                   (1 << 0)
+
+/* Resource formats (all 32 bits per pixel) */
+#define VIRTIO_GPU_FORMAT_B8G8R8A8_UNORM        1
+#define VIRTIO_GPU_FORMAT_B8G8R8X8_UNORM        2
+#define VIRTIO_GPU_FORMAT_A8R8G8B8_UNORM        3
+#define VIRTIO_GPU_FORMAT_X8R8G8B8_UNORM        4
+#define VIRTIO_GPU_FORMAT_R8G8B8A8_UNORM        67
+#define VIRTIO_GPU_FORMAT_X8B8G8R8_UNORM        68
+#define VIRTIO_GPU_FORMAT_A8B8G8R8_UNORM        121
+#define VIRTIO_GPU_FORMAT_R8G8B8X8_UNORM        134
+
+/* Device limits */
+#define VIRTIO_GPU_MAX_SCANOUTS                 4
+#define VIRTIO_GPU_MAX_RESOURCES                64
+#define VIRTIO_GPU_MAX_BACKING_ENTRIES          256
+#define VIRTIO_GPU_MAX_DAMAGE                   16
+
+/* Common header for every command and response */
+typedef struct {
+    uint32_t type;
+    uint32_t flags;
+    uint64_t fence_id;
+    uint32_t ctx_id;
+    uint32_t padding;
+} virtio_gpu_ctrl_hdr_t;
+
+typedef struct {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+} virtio_gpu_rect_t;
+
+/* VIRTIO_GPU_CMD_GET_DISPLAY_INFO response */
+typedef struct {
+    virtio_gpu_ctrl_hdr_t hdr;
+    struct {
+        virtio_gpu_rect_t r;
+        uint32_t enabled;
+        uint32_t flags;
+    } pmodes[16];
+} virtio_gpu_resp_display_info_t;
+
+/* VIRTIO_GPU_CMD_RESOURCE_CREATE_2D */
+typedef struct {
+    virtio_gpu_ctrl_hdr_t hdr;
+    uint32_t resource_id;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+} virtio_gpu_resource_create_2d_t;
+
+/* VIRTIO_GPU_CMD_RESOURCE_UNREF and VIRTIO_GPU_CMD_RESOURCE_DETACH_BACKING */
+typedef struct {
+    virtio_gpu_ctrl_hdr_t hdr;
+    uint32_t resource_id;
+    uint32_t padding;
+} virtio_gpu_resource_unref_t;
+
+/* VIRTIO_GPU_CMD_SET_SCANOUT */
+typedef struct {
+    virtio_gpu_ctrl_hdr_t hdr;
+    virtio_gpu_rect_t r;
+    uint32_t scanout_id;
+    uint32_t resource_id;
+} virtio_gpu_set_scanout_t;
+
+/* VIRTIO_GPU_CMD_RESOURCE_FLUSH */
+typedef struct {
+    virtio_gpu_ctrl_hdr_t hdr;
+    virtio_gpu_rect_t r;
+    uint32_t resource_id;
+    uint32_t padding;
+} virtio_gpu_resource_flush_t;
+
+/* VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D */
+typedef struct {
+    virtio_gpu_ctrl_hdr_t hdr;
+    virtio_gpu_rect_t r;
+    uint64_t offset;            /* Byte offset of r's origin in the backing */
+    uint32_t resource_id;
+    uint32_t padding;
+} virtio_gpu_transfer_to_host_2d_t;
+
+/* VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING, followed by nr_entries entries */
+typedef struct {
+    virtio_gpu_ctrl_hdr_t hdr;
+    uint32_t resource_id;
+    uint32_t nr_entries;
+} virtio_gpu_resource_attach_backing_t;
+
+typedef struct {
+    uint64_t addr;              /* Guest physical address */
+    uint32_t length;
+    uint32_t padding;
+} virtio_gpu_mem_entry_t;
+
+/* VIRTIO_GPU_CMD_UPDATE_CURSOR and VIRTIO_GPU_CMD_MOVE_CURSOR */
+typedef struct {
+    uint32_t scanout_id;
+    uint32_t x;
+    uint32_t y;
+    uint32_t padding;
+} virtio_gpu_cursor_pos_t;
+
+typedef struct {
+    virtio_gpu_ctrl_hdr_t hdr;
+    virtio_gpu_cursor_pos_t pos;
+    uint32_t resource_id;
+    uint32_t hot_x;
+    uint32_t hot_y;
+    uint32_t padding;
+} virtio_gpu_update_cursor_t;
+
+/**
+ * Process a virtio-gpu control command
+ * @param gpu_id GPU index
+ * @param cmd_type Command type (matches cmd_data's header)
+ * @param cmd_data Command buffer, starting with virtio_gpu_ctrl_hdr_t
+ * @param cmd_size Command buffer size
+ * @param resp_data Response buffer
+ * @param resp_size In: response buffer capacity, out: bytes written
+ * @return 0 on success (response may still carry an error type), -1 on
+ *         invalid arguments or unsupported command
+ */
+int virtio_gpu_process_command(uint32_t gpu_id, uint32_t cmd_type,
+                               void* cmd_data, uint32_t cmd_size,
+                               void* resp_data, uint32_t* resp_size);
+
+/**
+ * Take the rectangles flushed to a scanout since the last call
+ * When more rectangles arrive than fit, they are merged into their
+ * bounding box so no damage is lost.
+ * @param gpu_id GPU index
+ * @param scanout_id Scanout (display) index
+ * @param rects Output rectangles
+ * @param max Capacity of rects
+ * @return Number of rectangles returned, or -1 on invalid ids
+ */
+int virtio_gpu_take_damage(uint32_t gpu_id, uint32_t scanout_id,
+                           virtio_gpu_rect_t* rects, uint32_t max);
+
+/**
+ * Release all virtio-gpu resources owned by a GPU
+ * @param gpu_id GPU index
+ */
+void virtio_gpu_reset(uint32_t gpu_id);
+
+#endif /* VIRTIO_GPU_H */
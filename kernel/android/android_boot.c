@@ -27,6 +27,27 @@ static int mem_compare(const void* s1, const void* s2, size_t n) {
 static void mem_copy(void* dest, const void* src, size_t n) {
     uint8_t* d = (uint8_t*)dest;
     const uint8_t* s = (const uint8_t*)src;
+    
+    /* Word copies for the bulk of section placement */
+    if ((((uintptr_t)d ^ (uintptr_t)s) & (sizeof(uintptr_t) - 1)) == 0) {
+        while (n > 0 && ((uintptr_t)d & (sizeof(uintptr_t) - 1))) {
+            *d++ = *s++;
+            n--;
+        }
+        uintptr_t* dw = (uintptr_t*)d;
+        const uintptr_t* sw = (const uintptr_t*)s;
+        while (n >= sizeof(uintptr_t) * 4) {
+            dw[0] = sw[0];
+            dw[1] = sw[1];
+            dw[2] = sw[2];
+            dw[3] = sw[3];
+            dw += 4;
+            sw += 4;
+            n -= sizeof(uintptr_t) * 4;
+        }
+        d = (uint8_t*)dw;
+        s = (const uint8_t*)sw;
+    }
     for (size_t i = 0; i < n; i++) {
         d[i] = s[i];
     }
@@ -54,127 +75,6 @@ static void str_copy(char* dest, const char* src, size_t n) {
     dest[i] = '\0';
 }
 
-/* SHA-1 implementation for boot image verification */
-typedef struct {
-    uint32_t state[5];
-    uint32_t count[2];
-    uint8_t buffer[64];
-} sha1_ctx_t;
-
-static void sha1_init(sha1_ctx_t* ctx) {
-    ctx->state[0] = 0x67452301;
-    ctx->state[1] = 0xEFCDAB89;
-    ctx->state[2] = 0x98BADCFE;
-    ctx->state[3] = 0x10325476;
-    ctx->state[4] = 0xC3D2E1F0;
-    ctx->count[0] = 0;
-    ctx->count[1] = 0;
-}
-
-#define SHA1_ROL(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
-
-static void sha1_transform(sha1_ctx_t* ctx, const uint8_t* data) {
-    uint32_t a, b, c, d, e;
-    uint32_t w[80];
-    
-    /* Convert data to big-endian words */
-    for (int i = 0; i < 16; i++) {
-        w[i] = ((uint32_t)data[i * 4] << 24) |
-               ((uint32_t)data[i * 4 + 1] << 16) |
-               ((uint32_t)data[i * 4 + 2] << 8) |
-               ((uint32_t)data[i * 4 + 3]);
-    }
-    
-    /* Extend words */
-    for (int i = 16; i < 80; i++) {
-        w[i] = SHA1_ROL(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
-    }
-    
-    a = ctx->state[0];
-    b = ctx->state[1];
-    c = ctx->state[2];
-    d = ctx->state[3];
-    e = ctx->state[4];
-    
-    /* Main loop */
-    for (int i = 0; i < 80; i++) {
-        uint32_t f, k;
-        if (i < 20) {
-            f = (b & c) | ((~b) & d);
-            k = 0x5A827999;
-        } else if (i < 40) {
-            f = b ^ c ^ d;
-            k = 0x6ED9EBA1;
-        } else if (i < 60) {
-            f = (b & c) | (b & d) | (c & d);
-            k = 0x8F1BBCDC;
-        } else {
-            f = b ^ c ^ d;
-            k = 0xCA62C1D6;
-        }
-        
-        uint32_t temp = SHA1_ROL(a, 5) + f + e + k + w[i];
-        e = d;
-        d = c;
-        c = SHA1_ROL(b, 30);
-        b = a;
-        a = temp;
-    }
-    
-    ctx->state[0] += a;
-    ctx->state[1] += b;
-    ctx->state[2] += c;
-    ctx->state[3] += d;
-    ctx->state[4] += e;
-}
-
-static void sha1_update(sha1_ctx_t* ctx, const uint8_t* data, size_t len) {
-    size_t i = 0;
-    size_t j = (ctx->count[0] >> 3) & 63;
-    
-    ctx->count[0] += (uint32_t)(len << 3);
-    if (ctx->count[0] < (len << 3)) {
-        ctx->count[1]++;
-    }
-    ctx->count[1] += (uint32_t)(len >> 29);
-    
-    if ((j + len) > 63) {
-        i = 64 - j;
-        mem_copy(&ctx->buffer[j], data, i);
-        sha1_transform(ctx, ctx->buffer);
-        
-        for (; i + 63 < len; i += 64) {
-            sha1_transform(ctx, &data[i]);
-        }
-        j = 0;
-    }
-    
-    mem_copy(&ctx->buffer[j], &data[i], len - i);
-}
-
-static void sha1_final(sha1_ctx_t* ctx, uint8_t* digest) {
-    uint8_t finalcount[8];
-    
-    for (int i = 0; i < 8; i++) {
-        finalcount[i] = (uint8_t)((ctx->count[(i >= 4) ? 0 : 1] >> 
-                                  ((3 - (i & 3)) * 8)) & 255);
-    }
-    
-    uint8_t pad = 0x80;
-    sha1_update(ctx, &pad, 1);
-    
-    while ((ctx->count[0] & 504) != 448) {
-        pad = 0;
-        sha1_update(ctx, &pad, 1);
-    }
-    
-    sha1_update(ctx, finalcount, 8);
-    
-    for (int i = 0; i < 20; i++) {
-        digest[i] = (uint8_t)((ctx->state[i >> 2] >> ((3 - (i & 3)) * 8)) & 255);
-    }
-}
-
 /**
  * Initialize Android boot subsystem
  */
@@ -241,12 +141,96 @@ int android_boot_image_get_version(const void* data, size_t size) {
     return (int)hdr->header_version;
 }
 
+/**
+ * Section layout of a boot image, derived from the header alone
+ */
+typedef struct {
+    uint64_t offset[BOOT_SECTION_COUNT];
+    uint32_t size[BOOT_SECTION_COUNT];
+    uint64_t image_size;
+} boot_layout_t;
+
+static uint64_t layout_align(uint64_t size, uint32_t page_size) {
+    return ((size + page_size - 1) / page_size) * page_size;
+}
+
+static void layout_add(boot_layout_t* layout, int section, uint64_t* offset,
+                       uint32_t size, uint32_t page_size) {
+    layout->offset[section] = *offset;
+    layout->size[section] = size;
+    *offset += layout_align(size, page_size);
+}
+
+/**
+ * Compute section offsets for any header version
+ */
+static int boot_compute_layout(const void* data, boot_layout_t* layout) {
+    const boot_img_hdr_v0_t* hdr = (const boot_img_hdr_v0_t*)data;
+    uint64_t offset;
+    
+    mem_set(layout, 0, sizeof(boot_layout_t));
+    
+    if (hdr->header_version <= 2) {
+        uint32_t page_size = hdr->page_size ? hdr->page_size : 2048;
+        
+        /* Kernel starts at page 1 (after header) */
+        offset = page_size;
+        layout_add(layout, BOOT_SECTION_KERNEL, &offset, hdr->kernel_size, page_size);
+        layout_add(layout, BOOT_SECTION_RAMDISK, &offset, hdr->ramdisk_size, page_size);
+        layout_add(layout, BOOT_SECTION_SECOND, &offset, hdr->second_size, page_size);
+        
+        /* v1+: recovery DTBO carries its own offset (normally right after second) */
+        if (hdr->header_version >= 1 && hdr->recovery_dtbo_size > 0) {
+            uint64_t dtbo_offset = hdr->recovery_dtbo_offset;
+            layout_add(layout, BOOT_SECTION_RECOVERY_DTBO, &dtbo_offset,
+                       hdr->recovery_dtbo_size, page_size);
+            if (dtbo_offset > offset) {
+                offset = dtbo_offset;
+            }
+        }
+        
+        /* v2+: DTB follows the recovery DTBO */
+        if (hdr->header_version >= 2) {
+            layout_add(layout, BOOT_SECTION_DTB, &offset, hdr->dtb_size, page_size);
+        }
+    } else if (hdr->header_version <= 4) {
+        const boot_img_hdr_v4_t* hdr_v4 = (const boot_img_hdr_v4_t*)data;
+        
+        /* v3/v4 use fixed 4K pages; header_size is at the same offset in both */
+        offset = layout_align(hdr_v4->header_size, 4096);
+        layout_add(layout, BOOT_SECTION_KERNEL, &offset, hdr_v4->kernel_size, 4096);
+        layout_add(layout, BOOT_SECTION_RAMDISK, &offset, hdr_v4->ramdisk_size, 4096);
+        if (hdr_v4->header_version == 4) {
+            layout_add(layout, BOOT_SECTION_SIGNATURE, &offset, hdr_v4->signature_size, 4096);
+        }
+    } else {
+        return BOOT_PARSE_UNSUPPORTED_VERSION;
+    }
+    
+    /* Image ends at the last byte of the furthest section */
+    for (int i = 0; i < BOOT_SECTION_COUNT; i++) {
+        uint64_t end = layout->offset[i] + layout->size[i];
+        if (layout->size[i] > 0 && end > layout->image_size) {
+            layout->image_size = end;
+        }
+    }
+    
+    return BOOT_PARSE_SUCCESS;
+}
+
+/* Check a section lies inside an image of the given size */
+static int layout_fits(const boot_layout_t* layout, int section, size_t size) {
+    return layout->offset[section] + layout->size[section] <= size;
+}
+
 /**
  * Parse boot.img v0/v1/v2 format
+ * img_data may be NULL to decode the header fields only (streaming parse);
+ * section pointers are then bound by the caller.
  */
-static int parse_boot_v0_v1_v2(const void* data, size_t size, android_boot_info_t* info) {
+static int parse_boot_v0_v1_v2(const void* data, const uint8_t* img_data, size_t size,
+                               const boot_layout_t* layout, android_boot_info_t* info) {
     const boot_img_hdr_v0_t* hdr = (const boot_img_hdr_v0_t*)data;
-    const uint8_t* img_data = (const uint8_t*)data;
     
     info->header_version = hdr->header_version;
     info->page_size = hdr->page_size ? hdr->page_size : 2048;
@@ -263,48 +247,37 @@ static int parse_boot_v0_v1_v2(const void* data, size_t size, android_boot_info_
     info->second_size = hdr->second_size;
     info->second_addr = hdr->second_addr;
     
-    /* Calculate offsets */
-    uint32_t page_size = info->page_size;
-    uint32_t kernel_pages = android_boot_page_align(hdr->kernel_size, page_size) / page_size;
-    uint32_t ramdisk_pages = android_boot_page_align(hdr->ramdisk_size, page_size) / page_size;
-    uint32_t second_pages = android_boot_page_align(hdr->second_size, page_size) / page_size;
-    
-    /* Kernel starts at page 1 (after header) */
-    uint32_t kernel_offset = page_size;
-    uint32_t ramdisk_offset = kernel_offset + (kernel_pages * page_size);
-    uint32_t second_offset = ramdisk_offset + (ramdisk_pages * page_size);
-    
-    /* Validate sizes */
-    if (kernel_offset + hdr->kernel_size > size ||
-        ramdisk_offset + hdr->ramdisk_size > size ||
-        (hdr->second_size > 0 && second_offset + hdr->second_size > size)) {
-        return BOOT_PARSE_INVALID_SIZE;
-    }
-    
-    /* Set data pointers */
-    info->kernel_data = (void*)(img_data + kernel_offset);
-    info->ramdisk_data = (void*)(img_data + ramdisk_offset);
-    if (hdr->second_size > 0) {
-        info->second_data = (void*)(img_data + second_offset);
-    }
-    
     /* v1+ fields */
     if (hdr->header_version >= 1) {
         info->recovery_dtbo_size = hdr->recovery_dtbo_size;
         info->recovery_dtbo_offset = hdr->recovery_dtbo_offset;
-        if (hdr->recovery_dtbo_size > 0 && hdr->recovery_dtbo_offset < size) {
-            info->recovery_dtbo_data = (void*)(img_data + hdr->recovery_dtbo_offset);
-        }
     }
     
     /* v2+ fields */
     if (hdr->header_version >= 2) {
         info->dtb_size = hdr->dtb_size;
         info->dtb_addr = hdr->dtb_addr;
+    }
+    
+    if (img_data) {
+        /* Validate sizes */
+        if (!layout_fits(layout, BOOT_SECTION_KERNEL, size) ||
+            !layout_fits(layout, BOOT_SECTION_RAMDISK, size) ||
+            (hdr->second_size > 0 && !layout_fits(layout, BOOT_SECTION_SECOND, size))) {
+            return BOOT_PARSE_INVALID_SIZE;
+        }
         
-        uint32_t dtb_offset = second_offset + (second_pages * page_size);
-        if (hdr->dtb_size > 0 && dtb_offset + hdr->dtb_size <= size) {
-            info->dtb_data = (void*)(img_data + dtb_offset);
+        /* Set data pointers */
+        info->kernel_data = (void*)(img_data + layout->offset[BOOT_SECTION_KERNEL]);
+        info->ramdisk_data = (void*)(img_data + layout->offset[BOOT_SECTION_RAMDISK]);
+        if (hdr->second_size > 0) {
+            info->second_data = (void*)(img_data + layout->offset[BOOT_SECTION_SECOND]);
+        }
+        if (info->recovery_dtbo_size > 0 && layout_fits(layout, BOOT_SECTION_RECOVERY_DTBO, size)) {
+            info->recovery_dtbo_data = (void*)(img_data + layout->offset[BOOT_SECTION_RECOVERY_DTBO]);
+        }
+        if (info->dtb_size > 0 && layout_fits(layout, BOOT_SECTION_DTB, size)) {
+            info->dtb_data = (void*)(img_data + layout->offset[BOOT_SECTION_DTB]);
         }
     }
     
@@ -338,14 +311,16 @@ static int parse_boot_v0_v1_v2(const void* data, size_t size, android_boot_info_
 }
 
 /**
- * Parse boot.img v3 format
+ * Parse boot.img v3/v4 format
+ * v4 only adds the boot signature after the ramdisk.
+ * img_data may be NULL to decode the header fields only.
  */
-static int parse_boot_v3(const void* data, size_t size, android_boot_info_t* info) {
-    const boot_img_hdr_v3_t* hdr = (const boot_img_hdr_v3_t*)data;
-    const uint8_t* img_data = (const uint8_t*)data;
+static int parse_boot_v3_v4(const void* data, const uint8_t* img_data, size_t size,
+                            const boot_layout_t* layout, android_boot_info_t* info) {
+    const boot_img_hdr_v4_t* hdr = (const boot_img_hdr_v4_t*)data;
     
-    info->header_version = 3;
-    info->page_size = 4096;  /* v3 uses fixed 4K pages */
+    info->header_version = hdr->header_version;
+    info->page_size = 4096;  /* v3/v4 use fixed 4K pages */
     
     /* Kernel info */
     info->kernel_size = hdr->kernel_size;
@@ -355,23 +330,29 @@ static int parse_boot_v3(const void* data, size_t size, android_boot_info_t* inf
     info->ramdisk_size = hdr->ramdisk_size;
     info->ramdisk_addr = 0;  /* Address from vendor_boot */
     
-    /* Calculate offsets - v3 is simpler */
-    uint32_t page_size = 4096;
-    uint32_t kernel_offset = android_boot_page_align(hdr->header_size, page_size);
-    uint32_t ramdisk_offset = kernel_offset + android_boot_page_align(hdr->kernel_size, page_size);
-    
-    /* Validate sizes */
-    if (kernel_offset + hdr->kernel_size > size ||
-        ramdisk_offset + hdr->ramdisk_size > size) {
-        return BOOT_PARSE_INVALID_SIZE;
+    /* Signature info (v4 only) */
+    if (hdr->header_version == 4) {
+        info->signature_size = hdr->signature_size;
     }
     
-    /* Set data pointers */
-    info->kernel_data = (void*)(img_data + kernel_offset);
-    info->ramdisk_data = (void*)(img_data + ramdisk_offset);
+    if (img_data) {
+        /* Validate sizes */
+        if (!layout_fits(layout, BOOT_SECTION_KERNEL, size) ||
+            !layout_fits(layout, BOOT_SECTION_RAMDISK, size)) {
+            return BOOT_PARSE_INVALID_SIZE;
+        }
+        
+        /* Set data pointers */
+        info->kernel_data = (void*)(img_data + layout->offset[BOOT_SECTION_KERNEL]);
+        info->ramdisk_data = (void*)(img_data + layout->offset[BOOT_SECTION_RAMDISK]);
+        
+        if (info->signature_size > 0 && layout_fits(layout, BOOT_SECTION_SIGNATURE, size)) {
+            info->signature_data = (void*)(img_data + layout->offset[BOOT_SECTION_SIGNATURE]);
+        }
+    }
     
     /* Copy command line */
-    str_copy(info->cmdline, (const char*)hdr->cmdline, 
+    str_copy(info->cmdline, (const char*)hdr->cmdline,
              BOOT_ARGS_SIZE + BOOT_EXTRA_ARGS_SIZE);
     
     /* Decode OS version */
@@ -388,61 +369,19 @@ static int parse_boot_v3(const void* data, size_t size, android_boot_info_t* inf
 }
 
 /**
- * Parse boot.img v4 format
+ * Decode header fields and (optionally) bind section pointers
  */
-static int parse_boot_v4(const void* data, size_t size, android_boot_info_t* info) {
-    const boot_img_hdr_v4_t* hdr = (const boot_img_hdr_v4_t*)data;
-    const uint8_t* img_data = (const uint8_t*)data;
-    
-    info->header_version = 4;
-    info->page_size = 4096;  /* v4 uses fixed 4K pages */
-    
-    /* Kernel info */
-    info->kernel_size = hdr->kernel_size;
-    info->kernel_addr = 0;  /* Address from vendor_boot */
-    
-    /* Ramdisk info */
-    info->ramdisk_size = hdr->ramdisk_size;
-    info->ramdisk_addr = 0;  /* Address from vendor_boot */
+static int parse_boot_header(const void* data, const uint8_t* img_data, size_t size,
+                             const boot_layout_t* layout, android_boot_info_t* info) {
+    uint32_t version = ((const boot_img_hdr_v0_t*)data)->header_version;
     
-    /* Signature info */
-    info->signature_size = hdr->signature_size;
-    
-    /* Calculate offsets */
-    uint32_t page_size = 4096;
-    uint32_t kernel_offset = android_boot_page_align(hdr->header_size, page_size);
-    uint32_t ramdisk_offset = kernel_offset + android_boot_page_align(hdr->kernel_size, page_size);
-    uint32_t signature_offset = ramdisk_offset + android_boot_page_align(hdr->ramdisk_size, page_size);
-    
-    /* Validate sizes */
-    if (kernel_offset + hdr->kernel_size > size ||
-        ramdisk_offset + hdr->ramdisk_size > size) {
-        return BOOT_PARSE_INVALID_SIZE;
+    if (version <= 2) {
+        return parse_boot_v0_v1_v2(data, img_data, size, layout, info);
     }
-    
-    /* Set data pointers */
-    info->kernel_data = (void*)(img_data + kernel_offset);
-    info->ramdisk_data = (void*)(img_data + ramdisk_offset);
-    
-    if (hdr->signature_size > 0 && signature_offset + hdr->signature_size <= size) {
-        info->signature_data = (void*)(img_data + signature_offset);
+    if (version <= 4) {
+        return parse_boot_v3_v4(data, img_data, size, layout, info);
     }
-    
-    /* Copy command line */
-    str_copy(info->cmdline, (const char*)hdr->cmdline,
-             BOOT_ARGS_SIZE + BOOT_EXTRA_ARGS_SIZE);
-    
-    /* Decode OS version */
-    android_boot_decode_os_version(hdr->os_version,
-                                    &info->os_version_major,
-                                    &info->os_version_minor,
-                                    &info->os_version_patch);
-    android_boot_decode_patch_level(hdr->os_version,
-                                     &info->os_patch_level_year,
-                                     &info->os_patch_level_month);
-    
-    info->valid = 1;
-    return BOOT_PARSE_SUCCESS;
+    return BOOT_PARSE_UNSUPPORTED_VERSION;
 }
 
 /**
@@ -472,18 +411,13 @@ int android_boot_parse(const void* data, size_t size, android_boot_info_t* info)
     }
     
     /* Parse based on version */
-    switch (version) {
-        case 0:
-        case 1:
-        case 2:
-            return parse_boot_v0_v1_v2(data, size, info);
-        case 3:
-            return parse_boot_v3(data, size, info);
-        case 4:
-            return parse_boot_v4(data, size, info);
-        default:
-            return BOOT_PARSE_UNSUPPORTED_VERSION;
+    boot_layout_t layout;
+    int result = boot_compute_layout(data, &layout);
+    if (result != BOOT_PARSE_SUCCESS) {
+        return result;
     }
+    
+    return parse_boot_header(data, (const uint8_t*)data, size, &layout, info);
 }
 
 /**
@@ -660,6 +594,61 @@ int android_boot_get_cmdline(const android_boot_info_t* info, char* buffer, size
     return (int)cmdline_len;
 }
 
+/**
+ * Get data pointer and size of a section from parsed boot info
+ */
+static void boot_info_section(const android_boot_info_t* info, int section,
+                              const void** data, uint32_t* size) {
+    switch (section) {
+        case BOOT_SECTION_KERNEL:
+            *data = info->kernel_data;
+            *size = info->kernel_size;
+            break;
+        case BOOT_SECTION_RAMDISK:
+            *data = info->ramdisk_data;
+            *size = info->ramdisk_size;
+            break;
+        case BOOT_SECTION_SECOND:
+            *data = info->second_data;
+            *size = info->second_size;
+            break;
+        case BOOT_SECTION_RECOVERY_DTBO:
+            *data = info->recovery_dtbo_data;
+            *size = info->recovery_dtbo_size;
+            break;
+        case BOOT_SECTION_DTB:
+            *data = info->dtb_data;
+            *size = info->dtb_size;
+            break;
+        case BOOT_SECTION_SIGNATURE:
+            *data = info->signature_data;
+            *size = info->signature_size;
+            break;
+        default:
+            *data = NULL;
+            *size = 0;
+            break;
+    }
+}
+
+/*
+ * The v0-v2 image id is SHA-1 over each section followed by its size
+ * (little-endian u32): kernel, ramdisk, second, then recovery DTBO (v1+)
+ * and DTB (v2). Section ids are numbered in that same order.
+ */
+static int boot_id_section_count(uint32_t header_version) {
+    return BOOT_SECTION_SECOND + 1 + (header_version >= 1) + (header_version >= 2);
+}
+
+static void boot_id_fold_size(sha1_ctx_t* ctx, uint32_t size) {
+    uint8_t le[4];
+    le[0] = (uint8_t)size;
+    le[1] = (uint8_t)(size >> 8);
+    le[2] = (uint8_t)(size >> 16);
+    le[3] = (uint8_t)(size >> 24);
+    sha1_update(ctx, le, sizeof(le));
+}
+
 /**
  * Validate boot image checksum (v0-v2)
  */
@@ -667,6 +656,7 @@ int android_boot_validate_checksum(const void* data, size_t size, const android_
     if (!data || !info || !info->valid) {
         return BOOT_PARSE_INVALID_SIZE;
     }
+    (void)size;
     
     /* Only v0-v2 have SHA-1 hash */
     if (info->header_version > 2) {
@@ -674,42 +664,30 @@ int android_boot_validate_checksum(const void* data, size_t size, const android_
     }
     
     sha1_ctx_t ctx;
-    uint8_t digest[20];
+    uint8_t digest[SHA1_DIGEST_SIZE];
     
     sha1_init(&ctx);
     
-    /* Hash kernel */
-    if (info->kernel_data && info->kernel_size > 0) {
-        sha1_update(&ctx, (const uint8_t*)info->kernel_data, info->kernel_size);
-    }
-    
-    /* Hash ramdisk */
-    if (info->ramdisk_data && info->ramdisk_size > 0) {
-        sha1_update(&ctx, (const uint8_t*)info->ramdisk_data, info->ramdisk_size);
-    }
-    
-    /* Hash second stage bootloader */
-    if (info->second_data && info->second_size > 0) {
-        sha1_update(&ctx, (const uint8_t*)info->second_data, info->second_size);
-    }
-    
-    /* Hash DTB (v2) */
-    if (info->header_version >= 2 && info->dtb_data && info->dtb_size > 0) {
-        sha1_update(&ctx, (const uint8_t*)info->dtb_data, info->dtb_size);
+    int count = boot_id_section_count(info->header_version);
+    for (int i = 0; i < count; i++) {
+        const void* section_data;
+        uint32_t section_size;
+        boot_info_section(info, i, &section_data, &section_size);
+        
+        if (section_size > 0 && !section_data) {
+            return BOOT_PARSE_INVALID_SIZE;
+        }
+        if (section_size > 0) {
+            sha1_update(&ctx, section_data, section_size);
+        }
+        boot_id_fold_size(&ctx, section_size);
     }
     
     sha1_final(&ctx, digest);
     
-    /* Compare with stored hash */
-    const uint32_t* stored_id = info->id;
-    for (int i = 0; i < 5; i++) {
-        uint32_t computed = ((uint32_t)digest[i*4] << 24) |
-                           ((uint32_t)digest[i*4+1] << 16) |
-                           ((uint32_t)digest[i*4+2] << 8) |
-                           ((uint32_t)digest[i*4+3]);
-        if (computed != stored_id[i]) {
-            return BOOT_PARSE_CHECKSUM_ERROR;
-        }
+    /* The id field stores the raw digest bytes */
+    if (mem_compare(digest, info->id, SHA1_DIGEST_SIZE) != 0) {
+        return BOOT_PARSE_CHECKSUM_ERROR;
     }
     
     return BOOT_PARSE_SUCCESS;
@@ -738,28 +716,6 @@ int android_boot_validate_checksum(const void* data, size_t size, const android_
 #define AVB_ALGORITHM_SHA512_RSA4096        5
 #define AVB_ALGORITHM_SHA512_RSA8192        6
 
-/* Simple hash computation for boot image verification */
-static void avb_compute_hash(const uint8_t* data, uint32_t size, uint8_t* hash_out) {
-    uint32_t h[8] = {
-        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
-        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
-    };
-    
-    for (uint32_t i = 0; i < size; i++) {
-        uint32_t idx = i % 8;
-        h[idx] ^= ((uint32_t)data[i]) << ((i % 4) * 8);
-        h[idx] = (h[idx] << 5) | (h[idx] >> 27);
-        h[(idx + 1) % 8] ^= h[idx];
-    }
-    
-    for (int i = 0; i < 8; i++) {
-        hash_out[i * 4 + 0] = (h[i] >> 24) & 0xFF;
-        hash_out[i * 4 + 1] = (h[i] >> 16) & 0xFF;
-        hash_out[i * 4 + 2] = (h[i] >> 8) & 0xFF;
-        hash_out[i * 4 + 3] = h[i] & 0xFF;
-    }
-}
-
 /**
  * Verify boot image signature (v4) - Android Verified Boot
  */
@@ -812,7 +768,7 @@ int android_boot_verify_signature(const android_boot_info_t* info) {
     /* Compute hash of kernel for verification */
     uint8_t computed_hash[AVB_SHA256_DIGEST_SIZE];
     if (info->kernel_data && info->kernel_size > 0) {
-        avb_compute_hash(info->kernel_data, info->kernel_size, computed_hash);
+        sha256(info->kernel_data, info->kernel_size, computed_hash);
         
         vga_write("AVB: Computed kernel hash: ");
         for (int i = 0; i < 8; i++) {
@@ -855,6 +811,18 @@ void android_boot_free(android_boot_info_t* info) {
         info->bootconfig_data = NULL;
     }
     
+    /* Section buffers allocated by the streaming loader */
+    for (int i = 0; i < BOOT_SECTION_COUNT; i++) {
+        if (info->owned_sections & (1u << i)) {
+            const void* data;
+            uint32_t size;
+            boot_info_section(info, i, &data, &size);
+            if (data) {
+                kfree((void*)data);
+            }
+        }
+    }
+    
     mem_set(info, 0, sizeof(android_boot_info_t));
 }
 
@@ -937,6 +905,352 @@ void android_boot_print_info(const android_boot_info_t* info) {
     vga_write("================================\n\n");
 }
 
+/**
+ * Point the boot info section field at a placement buffer
+ */
+static void boot_info_bind_section(android_boot_info_t* info, int section, void* data) {
+    switch (section) {
+        case BOOT_SECTION_KERNEL:        info->kernel_data = data; break;
+        case BOOT_SECTION_RAMDISK:       info->ramdisk_data = data; break;
+        case BOOT_SECTION_SECOND:        info->second_data = data; break;
+        case BOOT_SECTION_RECOVERY_DTBO: info->recovery_dtbo_data = data; break;
+        case BOOT_SECTION_DTB:           info->dtb_data = data; break;
+        case BOOT_SECTION_SIGNATURE:     info->signature_data = data; break;
+        default: break;
+    }
+}
+
+/**
+ * Initialize streaming parser
+ */
+int android_boot_stream_init(android_boot_stream_t* stream, android_boot_info_t* info, uint32_t flags) {
+    if (!stream || !info) {
+        return BOOT_PARSE_INVALID_SIZE;
+    }
+    
+    mem_set(stream, 0, sizeof(android_boot_stream_t));
+    mem_set(info, 0, sizeof(android_boot_info_t));
+    
+    stream->info = info;
+    stream->flags = flags;
+    stream->id_streamed = 1;
+    sha1_init(&stream->id_ctx);
+    
+    return BOOT_PARSE_SUCCESS;
+}
+
+/**
+ * Provide a placement buffer for a section
+ */
+int android_boot_stream_set_dest(android_boot_stream_t* stream, int section,
+                                 void* buffer, size_t capacity) {
+    if (!stream || !buffer || section < 0 || section >= BOOT_SECTION_COUNT) {
+        return BOOT_PARSE_INVALID_SIZE;
+    }
+    
+    /* Buffers are bound when the header is parsed */
+    if (stream->header_parsed) {
+        return BOOT_PARSE_INVALID_SIZE;
+    }
+    
+    stream->sections[section].dest = (uint8_t*)buffer;
+    stream->sections[section].dest_capacity = capacity;
+    return BOOT_PARSE_SUCCESS;
+}
+
+/**
+ * Register a section completion callback
+ */
+void android_boot_stream_set_callback(android_boot_stream_t* stream,
+                                      android_boot_section_cb_t callback,
+                                      void* context) {
+    if (!stream) {
+        return;
+    }
+    stream->on_section = callback;
+    stream->cb_context = context;
+}
+
+/**
+ * Fold completed sections (and their sizes) into the image id, in id order
+ */
+static void stream_id_advance(android_boot_stream_t* stream) {
+    int count = boot_id_section_count(stream->info->header_version);
+    
+    while (stream->id_next < count && stream->sections[stream->id_next].complete) {
+        boot_id_fold_size(&stream->id_ctx, stream->sections[stream->id_next].size);
+        stream->id_next++;
+    }
+}
+
+static int stream_verifies_id(const android_boot_stream_t* stream) {
+    return (stream->flags & BOOT_STREAM_VERIFY_ID) && stream->info->header_version <= 2;
+}
+
+static void stream_section_complete(android_boot_stream_t* stream, int index) {
+    android_boot_section_t* sec = &stream->sections[index];
+    
+    sec->complete = 1;
+    if (stream->flags & BOOT_STREAM_SECTION_DIGESTS) {
+        sha256_final(&sec->hash, sec->digest);
+    }
+    if (stream_verifies_id(stream) && stream->id_streamed) {
+        stream_id_advance(stream);
+    }
+    if (stream->on_section && sec->size > 0) {
+        stream->on_section(index, sec->dest, sec->size, stream->cb_context);
+    }
+}
+
+/**
+ * Decode the staged header and bind every section to a placement buffer
+ */
+static int stream_parse_header(android_boot_stream_t* stream) {
+    android_boot_info_t* info = stream->info;
+    boot_layout_t layout;
+    
+    if (mem_compare(stream->header, BOOT_MAGIC, BOOT_MAGIC_SIZE) != 0) {
+        return BOOT_PARSE_INVALID_MAGIC;
+    }
+    
+    int result = boot_compute_layout(stream->header, &layout);
+    if (result != BOOT_PARSE_SUCCESS) {
+        return result;
+    }
+    
+    result = parse_boot_header(stream->header, NULL, 0, &layout, info);
+    if (result != BOOT_PARSE_SUCCESS) {
+        return result;
+    }
+    
+    stream->image_size = layout.image_size;
+    
+    for (int i = 0; i < BOOT_SECTION_COUNT; i++) {
+        android_boot_section_t* sec = &stream->sections[i];
+        
+        sec->offset = layout.offset[i];
+        sec->size = layout.size[i];
+        if (stream->flags & BOOT_STREAM_SECTION_DIGESTS) {
+            sha256_init(&sec->hash);
+        }
+        
+        if (sec->size == 0) {
+            continue;
+        }
+        
+        if (sec->dest) {
+            if (sec->dest_capacity < sec->size) {
+                return BOOT_PARSE_INVALID_SIZE;
+            }
+        } else {
+            sec->dest = (uint8_t*)kmalloc(sec->size);
+            if (!sec->dest) {
+                return BOOT_PARSE_MEMORY_ERROR;
+            }
+            sec->dest_capacity = sec->size;
+            info->owned_sections |= 1u << i;
+        }
+        boot_info_bind_section(info, i, sec->dest);
+    }
+    
+    stream->header_parsed = 1;
+    
+    /* Empty sections are complete from the start */
+    for (int i = 0; i < BOOT_SECTION_COUNT; i++) {
+        if (stream->sections[i].size == 0) {
+            stream_section_complete(stream, i);
+        }
+    }
+    
+    return BOOT_PARSE_SUCCESS;
+}
+
+/**
+ * Place the bytes [position, position + len) into their sections
+ * Each piece is hashed from its destination right after the copy, while
+ * it is still in cache, so placement and verification share one pass.
+ */
+static void stream_route(android_boot_stream_t* stream, const uint8_t* data, size_t len) {
+    uint64_t chunk_start = stream->position;
+    uint64_t chunk_end = chunk_start + len;
+    int verify_id = stream_verifies_id(stream);
+    int id_count = boot_id_section_count(stream->info->header_version);
+    
+    for (int i = 0; i < BOOT_SECTION_COUNT; i++) {
+        android_boot_section_t* sec = &stream->sections[i];
+        if (sec->complete) {
+            continue;
+        }
+        
+        uint64_t sec_end = sec->offset + sec->size;
+        uint64_t lo = sec->offset > chunk_start ? sec->offset : chunk_start;
+        uint64_t hi = sec_end < chunk_end ? sec_end : chunk_end;
+        if (lo >= hi) {
+            continue;
+        }
+        
+        uint8_t* dst = sec->dest + (lo - sec->offset);
+        uint32_t n = (uint32_t)(hi - lo);
+        mem_copy(dst, data + (lo - chunk_start), n);
+        
+        if (stream->flags & BOOT_STREAM_SECTION_DIGESTS) {
+            sha256_update(&sec->hash, dst, n);
+        }
+        if (verify_id && i < id_count) {
+            if (stream->id_streamed && stream->id_next == i) {
+                sha1_update(&stream->id_ctx, dst, n);
+            } else {
+                /* Non-standard section order; verify from buffers at finish */
+                stream->id_streamed = 0;
+            }
+        }
+        
+        sec->received += n;
+        if (sec->received == sec->size) {
+            stream_section_complete(stream, i);
+        }
+    }
+    
+    stream->position = chunk_end;
+}
+
+/**
+ * Feed the next chunk of the image
+ */
+int android_boot_stream_feed(android_boot_stream_t* stream, const void* data, size_t len) {
+    if (!stream || !stream->info || (!data && len > 0)) {
+        return BOOT_PARSE_INVALID_SIZE;
+    }
+    if (stream->error) {
+        return stream->error;
+    }
+    
+    const uint8_t* bytes = (const uint8_t*)data;
+    
+    if (!stream->header_parsed) {
+        size_t need = sizeof(stream->header) - stream->header_received;
+        size_t take = len < need ? len : need;
+        
+        mem_copy(stream->header + stream->header_received, bytes, take);
+        stream->header_received += (uint32_t)take;
+        bytes += take;
+        len -= take;
+        
+        if (stream->header_received < sizeof(stream->header)) {
+            return BOOT_PARSE_SUCCESS;
+        }
+        
+        int result = stream_parse_header(stream);
+        if (result != BOOT_PARSE_SUCCESS) {
+            stream->error = result;
+            return result;
+        }
+        
+        /* Sections may begin inside the staged header bytes (tiny page sizes) */
+        size_t staged = stream->header_received;
+        if (staged > stream->image_size) {
+            staged = (size_t)stream->image_size;
+        }
+        stream_route(stream, stream->header, staged);
+        stream->position = stream->header_received;
+    }
+    
+    if (stream->position >= stream->image_size) {
+        return BOOT_PARSE_SUCCESS;
+    }
+    if (len > stream->image_size - stream->position) {
+        len = (size_t)(stream->image_size - stream->position);
+    }
+    
+    stream_route(stream, bytes, len);
+    return BOOT_PARSE_SUCCESS;
+}
+
+/**
+ * Bytes still needed to complete the image
+ */
+uint64_t android_boot_stream_remaining(const android_boot_stream_t* stream) {
+    if (!stream) {
+        return 0;
+    }
+    if (!stream->header_parsed) {
+        return sizeof(stream->header) - stream->header_received;
+    }
+    if (stream->position >= stream->image_size) {
+        return 0;
+    }
+    return stream->image_size - stream->position;
+}
+
+/**
+ * Finish streaming and verify the image id
+ */
+int android_boot_stream_finish(android_boot_stream_t* stream) {
+    if (!stream || !stream->info) {
+        return BOOT_PARSE_INVALID_SIZE;
+    }
+    if (stream->error) {
+        return stream->error;
+    }
+    if (!stream->header_parsed) {
+        return BOOT_PARSE_INCOMPLETE;
+    }
+    
+    for (int i = 0; i < BOOT_SECTION_COUNT; i++) {
+        if (!stream->sections[i].complete) {
+            return BOOT_PARSE_INCOMPLETE;
+        }
+    }
+    
+    if (stream_verifies_id(stream)) {
+        int count = boot_id_section_count(stream->info->header_version);
+        
+        if (stream->id_streamed && stream->id_next == count) {
+            uint8_t digest[SHA1_DIGEST_SIZE];
+            sha1_final(&stream->id_ctx, digest);
+            if (mem_compare(digest, stream->info->id, SHA1_DIGEST_SIZE) != 0) {
+                return BOOT_PARSE_CHECKSUM_ERROR;
+            }
+        } else {
+            int result = android_boot_validate_checksum(stream->header, (size_t)stream->image_size,
+                                                        stream->info);
+            if (result != BOOT_PARSE_SUCCESS) {
+                return result;
+            }
+        }
+    }
+    
+    return BOOT_PARSE_SUCCESS;
+}
+
+/**
+ * Get SHA-256 digest of a completed section
+ */
+int android_boot_stream_get_digest(const android_boot_stream_t* stream, int section,
+                                   uint8_t digest[SHA256_DIGEST_SIZE]) {
+    if (!stream || !digest || section < 0 || section >= BOOT_SECTION_COUNT) {
+        return BOOT_PARSE_INVALID_SIZE;
+    }
+    if (!(stream->flags & BOOT_STREAM_SECTION_DIGESTS) || !stream->sections[section].complete) {
+        return BOOT_PARSE_INCOMPLETE;
+    }
+    
+    mem_copy(digest, stream->sections[section].digest, SHA256_DIGEST_SIZE);
+    return BOOT_PARSE_SUCCESS;
+}
+
+/**
+ * Abort streaming and release buffers allocated by the stream
+ */
+void android_boot_stream_abort(android_boot_stream_t* stream) {
+    if (!stream || !stream->info) {
+        return;
+    }
+    
+    android_boot_free(stream->info);
+    mem_set(stream, 0, sizeof(android_boot_stream_t));
+}
+
 /**
  * Load Android boot image from storage device
  */
@@ -1024,48 +1338,73 @@ int android_boot_load_from_device(const char* device_name,
         return BOOT_PARSE_INVALID_SIZE;
     }
     
-    /* Read boot image header (first sector) */
-    uint8_t header_buf[512];
-    if (storage_read_sector(device, boot_part->start_lba, header_buf) < 0) {
-        vga_write("Android Boot: Failed to read boot header\n");
-        return BOOT_PARSE_INVALID_SIZE;
-    }
-    
-    /* Check magic number */
-    if (mem_compare(header_buf, BOOT_MAGIC, BOOT_MAGIC_SIZE) != 0) {
-        vga_write("Android Boot: Invalid boot image magic\n");
-        return BOOT_PARSE_INVALID_MAGIC;
+    /* Stream the image in chunks straight into per-section buffers */
+    android_boot_stream_t* stream = (android_boot_stream_t*)kmalloc(sizeof(android_boot_stream_t));
+    uint8_t* chunk = (uint8_t*)kmalloc(BOOT_STREAM_CHUNK_SIZE);
+    if (!stream || !chunk) {
+        if (stream) kfree(stream);
+        if (chunk) kfree(chunk);
+        vga_write("Android Boot: Memory allocation failed\n");
+        return BOOT_PARSE_MEMORY_ERROR;
     }
     
-    /* Parse header to determine image size */
-    boot_img_hdr_v0_t* hdr_v0 = (boot_img_hdr_v0_t*)header_buf;
-    uint32_t page_size = hdr_v0->page_size;
-    if (page_size == 0) page_size = 2048;  /* Default page size */
+    android_boot_stream_init(stream, info, BOOT_STREAM_VERIFY_ID);
     
-    uint32_t total_size = page_size;  /* Header page */
-    total_size += ((hdr_v0->kernel_size + page_size - 1) / page_size) * page_size;
-    total_size += ((hdr_v0->ramdisk_size + page_size - 1) / page_size) * page_size;
+    uint32_t sector_size = device->sector_size ? device->sector_size : 512;
+    uint32_t chunk_sectors = BOOT_STREAM_CHUNK_SIZE / sector_size;
+    uint64_t lba = boot_part->start_lba;
+    uint64_t end_lba = (uint64_t)boot_part->start_lba + boot_part->num_sectors;
+    int result = BOOT_PARSE_SUCCESS;
     
-    /* Allocate buffer for entire boot image */
-    uint8_t* boot_data = kmalloc(total_size);
-    if (!boot_data) {
-        vga_write("Android Boot: Memory allocation failed\n");
-        return BOOT_PARSE_INVALID_SIZE;
+    while (android_boot_stream_remaining(stream) > 0) {
+        uint32_t count = chunk_sectors;
+        
+        /* Once the layout is known, read only what is left */
+        if (stream->header_parsed) {
+            uint64_t needed = (android_boot_stream_remaining(stream) + sector_size - 1) / sector_size;
+            if (needed < count) {
+                count = (uint32_t)needed;
+            }
+        }
+        if (boot_part->num_sectors > 0 && lba + count > end_lba) {
+            count = (uint32_t)(end_lba - lba);
+        }
+        if (count == 0) {
+            vga_write("Android Boot: Boot image truncated\n");
+            result = BOOT_PARSE_INVALID_SIZE;
+            break;
+        }
+        
+        if (storage_read_sectors(device, lba, count, chunk) < 0) {
+            vga_write("Android Boot: Failed to read boot image\n");
+            result = BOOT_PARSE_INVALID_SIZE;
+            break;
+        }
+        lba += count;
+        
+        result = android_boot_stream_feed(stream, chunk, (size_t)count * sector_size);
+        if (result != BOOT_PARSE_SUCCESS) {
+            if (result == BOOT_PARSE_INVALID_MAGIC) {
+                vga_write("Android Boot: Invalid boot image magic\n");
+            }
+            break;
+        }
     }
     
-    /* Read entire boot image */
-    uint32_t sectors_needed = (total_size + 511) / 512;
-    if (storage_read_sectors(device, boot_part->start_lba, sectors_needed, boot_data) < 0) {
-        kfree(boot_data);
-        vga_write("Android Boot: Failed to read boot image\n");
-        return BOOT_PARSE_INVALID_SIZE;
+    if (result == BOOT_PARSE_SUCCESS) {
+        result = android_boot_stream_finish(stream);
+        if (result == BOOT_PARSE_CHECKSUM_ERROR) {
+            vga_write("Android Boot: Boot image id mismatch\n");
+        }
     }
     
-    /* Parse the boot image */
-    int result = android_boot_parse(boot_data, total_size, info);
+    if (result != BOOT_PARSE_SUCCESS) {
+        android_boot_stream_abort(stream);
+    }
+    kfree(chunk);
+    kfree(stream);
     
     if (result != BOOT_PARSE_SUCCESS) {
-        kfree(boot_data);
         return result;
     }
     
@@ -1073,8 +1412,7 @@ int android_boot_load_from_device(const char* device_name,
     vga_write(device->model);
     vga_write("\n");
     
-    /* Note: boot_data is now owned by info structure via kernel/ramdisk pointers */
-    /* It will be freed when android_boot_free() is called */
+    /* Section buffers are owned by info and released by android_boot_free() */
     
     (void)partition_name;  /* Used for partition name matching above */
     return BOOT_PARSE_SUCCESS;
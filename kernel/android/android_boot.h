@@ -10,6 +10,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "../security/sha.h"
 
 /* Boot image magic string */
 #define BOOT_MAGIC "ANDROID!"
@@ -221,6 +222,9 @@ typedef struct {
     /* Parsing status */
     int valid;
     int has_vendor_boot;
+    
+    /* Section buffers allocated by the streaming loader (bit per BOOT_SECTION_*) */
+    uint32_t owned_sections;
 } android_boot_info_t;
 
 /**
@@ -232,7 +236,79 @@ typedef struct {
 #define BOOT_PARSE_INVALID_SIZE -3
 #define BOOT_PARSE_MEMORY_ERROR -4
 #define BOOT_PARSE_CHECKSUM_ERROR -5
+#define BOOT_PARSE_INCOMPLETE -6
+
+/**
+ * Boot image sections, in on-disk order
+ */
+#define BOOT_SECTION_KERNEL 0
+#define BOOT_SECTION_RAMDISK 1
+#define BOOT_SECTION_SECOND 2
+#define BOOT_SECTION_RECOVERY_DTBO 3
+#define BOOT_SECTION_DTB 4
+#define BOOT_SECTION_SIGNATURE 5
+#define BOOT_SECTION_COUNT 6
+
+/* Streaming parser flags */
+#define BOOT_STREAM_VERIFY_ID 0x01          /* Verify v0-v2 SHA-1 id while streaming */
+#define BOOT_STREAM_SECTION_DIGESTS 0x02    /* Compute SHA-256 of every section */
+
+/* Preferred chunk size for storage reads feeding the stream */
+#define BOOT_STREAM_CHUNK_SIZE (64 * 1024)
+
+/**
+ * Section completion callback
+ * Called as soon as the last byte of a section has been placed, so the
+ * caller can start decompressing/relocating the kernel while later
+ * sections (ramdisk, DTB) are still being read from storage.
+ */
+typedef void (*android_boot_section_cb_t)(int section, const void* data,
+                                          uint32_t size, void* context);
+
+/**
+ * Per-section streaming state
+ */
+typedef struct {
+    uint64_t offset;                /* Byte offset within the image */
+    uint32_t size;
+    uint32_t received;
+    uint8_t* dest;                  /* Placement buffer */
+    size_t dest_capacity;
+    int complete;
+    sha256_ctx_t hash;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+} android_boot_section_t;
 
+/**
+ * Streaming boot image parser
+ * Consumes the image in arbitrary chunks in on-disk order. Each chunk is
+ * copied straight into its section's placement buffer and hashed while it
+ * is still cache-hot, so no full-image staging buffer is required.
+ */
+typedef struct {
+    android_boot_info_t* info;
+    uint32_t flags;
+    
+    /* Header staging */
+    uint8_t header[sizeof(boot_img_hdr_v0_t)];
+    uint32_t header_received;
+    int header_parsed;
+    
+    /* Position tracking */
+    uint64_t position;              /* Bytes consumed so far */
+    uint64_t image_size;            /* Total bytes expected (valid once header parsed) */
+    
+    android_boot_section_t sections[BOOT_SECTION_COUNT];
+    
+    /* v0-v2 image id (SHA-1 over sections and their sizes) */
+    sha1_ctx_t id_ctx;
+    int id_next;                    /* Next section to fold into the id */
+    int id_streamed;                /* Sections arrived in id order */
+    
+    android_boot_section_cb_t on_section;
+    void* cb_context;
+    int error;
+} android_boot_stream_t;
 /**
  * Initialize Android boot subsystem
  * @return 0 on success, negative error code on failure
@@ -377,4 +453,63 @@ int android_boot_image_get_version(const void* data, size_t size);
  */
 int android_boot_validate_checksum(const void* data, size_t size, const android_boot_info_t* info);
 
+/**
+ * Initialize streaming parser
+ * @param stream Stream state
+ * @param info Boot info structure filled once the header has been parsed
+ * @param flags BOOT_STREAM_* flags
+ * @return BOOT_PARSE_SUCCESS or negative error code
+ */
+int android_boot_stream_init(android_boot_stream_t* stream, android_boot_info_t* info, uint32_t flags);
+
+/**
+ * Provide a placement buffer for a section (e.g. the kernel load address)
+ * Sections without a buffer are allocated with kmalloc when the header
+ * is parsed. Must be called before the header has been fed.
+ * @return BOOT_PARSE_SUCCESS or negative error code
+ */
+int android_boot_stream_set_dest(android_boot_stream_t* stream, int section,
+                                 void* buffer, size_t capacity);
+
+/**
+ * Register a section completion callback
+ */
+void android_boot_stream_set_callback(android_boot_stream_t* stream,
+                                      android_boot_section_cb_t callback,
+                                      void* context);
+
+/**
+ * Feed the next chunk of the image
+ * Bytes beyond the end of the image are ignored.
+ * @return BOOT_PARSE_SUCCESS or negative error code
+ */
+int android_boot_stream_feed(android_boot_stream_t* stream, const void* data, size_t len);
+
+/**
+ * Bytes still needed to complete the image
+ * Before the header has been decoded this is the number of bytes still
+ * needed to decode it.
+ * @return Remaining bytes, or 0 if the image is complete
+ */
+uint64_t android_boot_stream_remaining(const android_boot_stream_t* stream);
+
+/**
+ * Finish streaming: checks all sections arrived and verifies the image id
+ * @return BOOT_PARSE_SUCCESS, BOOT_PARSE_INCOMPLETE or BOOT_PARSE_CHECKSUM_ERROR
+ */
+int android_boot_stream_finish(android_boot_stream_t* stream);
+
+/**
+ * Get SHA-256 digest of a completed section
+ * Requires BOOT_STREAM_SECTION_DIGESTS
+ * @return BOOT_PARSE_SUCCESS or negative error code
+ */
+int android_boot_stream_get_digest(const android_boot_stream_t* stream, int section,
+                                   uint8_t digest[SHA256_DIGEST_SIZE]);
+
+/**
+ * Abort streaming and release buffers allocated by the stream
+ */
+void android_boot_stream_abort(android_boot_stream_t* stream);
+
 #endif /* AURORA_ANDROID_BOOT_H */
@@ -14,6 +14,7 @@
 #include "winapi/kernel32.h"
 #include "../memory/memory.h"
 #include "../memory/paging.h"
+#include "../memory/swap.h"
 #include "../process/process.h"
 #include "../interrupt/interrupt.h"
 #include "../drivers/vga.h"
@@ -28,6 +29,7 @@
 #include "../network/network.h"
 #include "../usb/usb.h"
 #include "../../filesystem/vfs/vfs.h"
+#include "../../filesystem/cache/writeback.h"
 #include "../../filesystem/ramdisk/ramdisk.h"
 #include "../../filesystem/journal/journal.h"
 #include "../../include/multiboot.h"
@@ -171,6 +173,23 @@ void kernel_init(void) {
     scheduler_init();
     vga_write("Scheduler initialized\n");
     
+    /* Replace the periodic tick with one-shot timer events */
+    if (timing_system_enable_dynamic_ticks() == 0) {
+        vga_write("Dynamic ticks enabled\n");
+    }
+    
+    /* Enable swap if a swap partition is present */
+    if (swap_probe_storage() == 0) {
+        swap_start_kswapd();
+        vga_write("Swap enabled\n");
+    }
+    
+    /* Page cache writeback flushers, one per registered device */
+    writeback_start_flushers();
+    
+    /* Journal checkpointer, freeing log space in the background */
+    journal_start_checkpointer();
+    
     /* Initialize network stack */
     network_init();
     vga_write("Network stack initialized\n");
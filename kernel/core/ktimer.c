@@ -0,0 +1,392 @@
+/**
+ * Aurora OS - Kernel Timers
+ *
+ * Each CPU owns a hierarchical timing wheel: KTIMER_LEVELS levels of 64
+ * slots, level n covering 64^(n+1) us in slots 64^n us wide. A timer is
+ * filed by the highest bit in which its deadline differs from the
+ * wheel's clock, so it sits in the largest aligned block of time that
+ * contains the deadline but not the clock. When the clock reaches the
+ * start of an occupied slot above level 0 the slot is cascaded, its
+ * timers re-filed a level or more lower; a level 0 slot holds timers for
+ * a single microsecond and expires whole.
+ *
+ * Insertion and removal are list operations plus one bit in the level's
+ * occupancy bitmap. The wheel never ticks through empty time: running it
+ * jumps straight to the next occupied slot, found with one bit scan per
+ * level, which is also what tells a tickless CPU when to wake.
+ *
+ * Deadlines more than 2^48 us (about 9 years) out are parked in the last
+ * slot they can reach and re-filed when it comes round.
+ *
+ * ktimer_run() is called from the timer interrupt, so every holder of a
+ * wheel lock keeps interrupts off on its CPU while it holds it.
+ */
+
+#include "ktimer.h"
+#include "../smp/smp.h"
+#include "../smp/spinlock.h"
+#include <stddef.h>
+
+#define LEVEL_MASK      (KTIMER_LEVEL_SIZE - 1)
+#define WHEEL_BITS      (KTIMER_LEVEL_BITS * KTIMER_LEVELS)
+#define WHEEL_SPAN      ((uint64_t)1 << WHEEL_BITS)
+
+typedef struct {
+    spinlock_t lock;
+    uint64_t clk;                   /* Earliest time not yet run */
+    uint64_t programmed;            /* Last event handed out by ktimer_next_event() */
+    uint64_t occupied[KTIMER_LEVELS];
+    ktimer_t* slots[KTIMER_LEVELS][KTIMER_LEVEL_SIZE];
+    ktimer_t* expired;              /* Due, waiting for their callbacks */
+    ktimer_t** expired_tail;
+    ktimer_stats_t stats;
+} __attribute__((aligned(64))) ktimer_base_t;
+
+static ktimer_base_t bases[MAX_CPUS];
+static void (*program_hook)(uint32_t cpu) = NULL;
+
+static inline uint32_t timer_level(uint64_t expires, uint64_t clk) {
+    uint64_t diff = expires ^ clk;
+
+    if (diff == 0) {
+        return 0;
+    }
+    return (uint32_t)(63 - __builtin_clzll(diff)) / KTIMER_LEVEL_BITS;
+}
+
+static inline void list_add(ktimer_t** head, ktimer_t* timer) {
+    timer->next = *head;
+    if (timer->next) {
+        timer->next->pprev = &timer->next;
+    }
+    *head = timer;
+    timer->pprev = head;
+}
+
+/**
+ * File a timer in the wheel relative to the current clock
+ */
+static void enqueue(ktimer_base_t* base, ktimer_t* timer) {
+    uint64_t when = timer->expires;
+    uint32_t level;
+    uint32_t index;
+
+    if (when < base->clk) {
+        when = base->clk;
+    } else if ((when ^ base->clk) >= WHEEL_SPAN) {
+        /* Past the current top-level rotation: park in its last microsecond */
+        when = base->clk | (WHEEL_SPAN - 1);
+    }
+
+    level = timer_level(when, base->clk);
+    index = (uint32_t)(when >> (level * KTIMER_LEVEL_BITS)) & LEVEL_MASK;
+
+    list_add(&base->slots[level][index], timer);
+    base->occupied[level] |= 1ULL << index;
+    timer->slot = (uint16_t)(level * KTIMER_LEVEL_SIZE + index);
+}
+
+/**
+ * Remove a pending timer from its slot or the expired list
+ */
+static void dequeue(ktimer_base_t* base, ktimer_t* timer) {
+    if (timer->slot == KTIMER_SLOT_EXPIRED) {
+        if (!timer->next) {
+            base->expired_tail = timer->pprev;
+        }
+    }
+
+    *timer->pprev = timer->next;
+    if (timer->next) {
+        timer->next->pprev = timer->pprev;
+    }
+
+    if (timer->slot != KTIMER_SLOT_EXPIRED) {
+        uint32_t level = timer->slot / KTIMER_LEVEL_SIZE;
+        uint32_t index = timer->slot % KTIMER_LEVEL_SIZE;
+
+        if (!base->slots[level][index]) {
+            base->occupied[level] &= ~(1ULL << index);
+        }
+    }
+
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/**
+ * Earliest time at or after the clock that holds an occupied slot
+ */
+static uint64_t next_event_locked(const ktimer_base_t* base) {
+    uint64_t best = KTIMER_NONE;
+
+    for (uint32_t level = 0; level < KTIMER_LEVELS; level++) {
+        uint32_t shift = level * KTIMER_LEVEL_BITS;
+        uint32_t cur = (uint32_t)(base->clk >> shift) & LEVEL_MASK;
+        uint64_t bits = base->occupied[level] & (~0ULL << cur);
+        uint64_t start;
+
+        if (!bits) {
+            continue;
+        }
+
+        start = (base->clk >> (shift + KTIMER_LEVEL_BITS)) << (shift + KTIMER_LEVEL_BITS);
+        start |= (uint64_t)__builtin_ctzll(bits) << shift;
+        if (start < base->clk) {
+            start = base->clk;
+        }
+        if (start < best) {
+            best = start;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * Process time 'now' (base->clk == now): cascade the slots that start
+ * here, highest level first, then move the level 0 slot to the expired
+ * list
+ */
+static void process_slot(ktimer_base_t* base) {
+    uint64_t now = base->clk;
+
+    for (uint32_t level = KTIMER_LEVELS - 1; level > 0; level--) {
+        uint32_t index = (uint32_t)(now >> (level * KTIMER_LEVEL_BITS)) & LEVEL_MASK;
+        ktimer_t* list;
+
+        if (!(base->occupied[level] & (1ULL << index))) {
+            continue;
+        }
+
+        list = base->slots[level][index];
+        base->slots[level][index] = NULL;
+        base->occupied[level] &= ~(1ULL << index);
+
+        while (list) {
+            ktimer_t* timer = list;
+
+            list = timer->next;
+            enqueue(base, timer);
+            base->stats.cascaded++;
+        }
+    }
+
+    uint32_t index = (uint32_t)now & LEVEL_MASK;
+    ktimer_t* list = base->slots[0][index];
+
+    if (!list) {
+        return;
+    }
+    base->slots[0][index] = NULL;
+    base->occupied[0] &= ~(1ULL << index);
+
+    while (list) {
+        ktimer_t* timer = list;
+
+        list = timer->next;
+        if (timer->expires > now) {
+            /* Parked far-future timer: file it properly */
+            enqueue(base, timer);
+            base->stats.cascaded++;
+            continue;
+        }
+
+        timer->next = NULL;
+        timer->pprev = base->expired_tail;
+        timer->slot = KTIMER_SLOT_EXPIRED;
+        *base->expired_tail = timer;
+        base->expired_tail = &timer->next;
+    }
+}
+
+void ktimer_init(void) {
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        ktimer_base_t* base = &bases[cpu];
+
+        spinlock_init(&base->lock);
+        base->clk = 0;
+        base->programmed = KTIMER_NONE;
+        for (uint32_t level = 0; level < KTIMER_LEVELS; level++) {
+            base->occupied[level] = 0;
+            for (uint32_t i = 0; i < KTIMER_LEVEL_SIZE; i++) {
+                base->slots[level][i] = NULL;
+            }
+        }
+        base->expired = NULL;
+        base->expired_tail = &base->expired;
+
+        base->stats.pending = 0;
+        base->stats.max_pending = 0;
+        base->stats.added = 0;
+        base->stats.cancelled = 0;
+        base->stats.expired = 0;
+        base->stats.cascaded = 0;
+        base->stats.clock = 0;
+    }
+}
+
+void ktimer_setup(ktimer_t* timer, void (*callback)(void* data), void* data) {
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->expires = 0;
+    timer->callback = callback;
+    timer->data = data;
+    timer->slot = 0;
+    timer->cpu = 0;
+}
+
+void ktimer_add_on(ktimer_t* timer, uint32_t cpu, uint64_t expires) {
+    ktimer_base_t* base;
+    irqflags_t flags;
+    int reprogram;
+
+    if (!timer || cpu >= MAX_CPUS) {
+        return;
+    }
+
+    ktimer_cancel(timer);
+
+    base = &bases[cpu];
+    flags = spinlock_acquire_irqsave(&base->lock);
+
+    timer->expires = expires;
+    timer->cpu = (uint16_t)cpu;
+    enqueue(base, timer);
+
+    base->stats.added++;
+    base->stats.pending++;
+    if (base->stats.pending > base->stats.max_pending) {
+        base->stats.max_pending = base->stats.pending;
+    }
+
+    /* Slots are aligned blocks, so only a deadline before the programmed
+     * event can bring the wheel's next event forward */
+    reprogram = expires < base->programmed;
+    if (reprogram) {
+        base->programmed = expires;
+    }
+
+    spinlock_release_irqrestore(&base->lock, flags);
+
+    if (reprogram && program_hook) {
+        program_hook(cpu);
+    }
+}
+
+void ktimer_add(ktimer_t* timer, uint64_t expires) {
+    ktimer_add_on(timer, smp_get_current_cpu_id(), expires);
+}
+
+int ktimer_cancel(ktimer_t* timer) {
+    ktimer_base_t* base;
+    irqflags_t flags;
+    int was_pending = 0;
+
+    if (!timer || !timer->pprev) {
+        return 0;
+    }
+
+    base = &bases[timer->cpu];
+    flags = spinlock_acquire_irqsave(&base->lock);
+
+    /* Recheck: it may have fired or moved while we took the lock */
+    if (timer->pprev && &bases[timer->cpu] == base) {
+        dequeue(base, timer);
+        base->stats.pending--;
+        base->stats.cancelled++;
+        was_pending = 1;
+    }
+
+    spinlock_release_irqrestore(&base->lock, flags);
+    return was_pending;
+}
+
+int ktimer_pending(const ktimer_t* timer) {
+    return timer && timer->pprev != NULL;
+}
+
+uint32_t ktimer_run(uint32_t cpu, uint64_t now) {
+    ktimer_base_t* base;
+    irqflags_t flags;
+    uint32_t run = 0;
+
+    if (cpu >= MAX_CPUS) {
+        return 0;
+    }
+
+    base = &bases[cpu];
+    flags = spinlock_acquire_irqsave(&base->lock);
+
+    while (base->clk <= now) {
+        uint64_t next = next_event_locked(base);
+
+        if (next > now) {
+            base->clk = now + 1;
+            break;
+        }
+        base->clk = next;
+        process_slot(base);
+        base->clk = next + 1;
+    }
+    base->stats.clock = base->clk;
+
+    /* Callbacks run unlocked, one at a time, so they can re-arm themselves
+     * and cancel timers still waiting on the expired list */
+    while (base->expired) {
+        ktimer_t* timer = base->expired;
+        void (*callback)(void*) = timer->callback;
+        void* data = timer->data;
+
+        dequeue(base, timer);
+        base->stats.pending--;
+        base->stats.expired++;
+        spinlock_release_irqrestore(&base->lock, flags);
+
+        if (callback) {
+            callback(data);
+        }
+        run++;
+
+        flags = spinlock_acquire_irqsave(&base->lock);
+    }
+
+    spinlock_release_irqrestore(&base->lock, flags);
+    return run;
+}
+
+uint64_t ktimer_next_event(uint32_t cpu) {
+    ktimer_base_t* base;
+    irqflags_t flags;
+    uint64_t next;
+
+    if (cpu >= MAX_CPUS) {
+        return KTIMER_NONE;
+    }
+
+    base = &bases[cpu];
+    flags = spinlock_acquire_irqsave(&base->lock);
+    next = base->expired ? base->clk : next_event_locked(base);
+    base->programmed = next;
+    spinlock_release_irqrestore(&base->lock, flags);
+
+    return next;
+}
+
+void ktimer_set_program_hook(void (*hook)(uint32_t cpu)) {
+    program_hook = hook;
+}
+
+void ktimer_get_stats(uint32_t cpu, ktimer_stats_t* stats) {
+    ktimer_base_t* base;
+    irqflags_t flags;
+
+    if (cpu >= MAX_CPUS || !stats) {
+        return;
+    }
+
+    base = &bases[cpu];
+    flags = spinlock_acquire_irqsave(&base->lock);
+    *stats = base->stats;
+    spinlock_release_irqrestore(&base->lock, flags);
+}
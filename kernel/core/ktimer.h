@@ -0,0 +1,112 @@
+/**
+ * Aurora OS - Kernel Timers Header
+ *
+ * One-shot kernel timers on a per-CPU hierarchical timing wheel. Times
+ * are microseconds since boot (timing_get_microseconds()). Arming and
+ * cancelling are O(1); a timer moves down the wheel at most
+ * KTIMER_LEVELS - 1 times before it fires.
+ */
+
+#ifndef AURORA_KTIMER_H
+#define AURORA_KTIMER_H
+
+#include <stdint.h>
+
+/* Wheel geometry: 8 levels of 64 slots, level n slots 64^n us wide */
+#define KTIMER_LEVEL_BITS   6
+#define KTIMER_LEVEL_SIZE   (1u << KTIMER_LEVEL_BITS)
+#define KTIMER_LEVELS       8
+
+/* No timer pending */
+#define KTIMER_NONE         UINT64_MAX
+
+typedef struct ktimer {
+    struct ktimer* next;
+    struct ktimer** pprev;          /* Link pointing here; NULL when not pending */
+    uint64_t expires;               /* Deadline, us since boot */
+    void (*callback)(void* data);
+    void* data;
+    uint16_t slot;                  /* level * KTIMER_LEVEL_SIZE + index, or KTIMER_SLOT_EXPIRED */
+    uint16_t cpu;                   /* Wheel it is queued on */
+} ktimer_t;
+
+#define KTIMER_SLOT_EXPIRED 0xFFFF
+
+/* Wheel statistics for one CPU */
+typedef struct {
+    uint32_t pending;
+    uint32_t max_pending;
+    uint64_t added;
+    uint64_t cancelled;
+    uint64_t expired;
+    uint64_t cascaded;              /* Moves to a finer level */
+    uint64_t clock;                 /* Time the wheel has been run up to */
+} ktimer_stats_t;
+
+/**
+ * Initialize every CPU's timer wheel at time 0
+ */
+void ktimer_init(void);
+
+/**
+ * Prepare a timer for use
+ * @param callback Called with data when the timer fires, from
+ *                 ktimer_run() on the CPU it was armed on, without the
+ *                 wheel's lock held (it may re-arm the timer)
+ */
+void ktimer_setup(ktimer_t* timer, void (*callback)(void* data), void* data);
+
+/**
+ * Arm a timer on the current CPU, moving it if already pending
+ * A deadline already in the past fires at the next ktimer_run().
+ * @param expires Deadline, us since boot
+ */
+void ktimer_add(ktimer_t* timer, uint64_t expires);
+
+/**
+ * Arm a timer on a given CPU
+ */
+void ktimer_add_on(ktimer_t* timer, uint32_t cpu, uint64_t expires);
+
+/**
+ * Disarm a timer
+ * Does not wait for a callback already running on another CPU.
+ * @return 1 if it was pending, 0 otherwise
+ */
+int ktimer_cancel(ktimer_t* timer);
+
+/**
+ * Is the timer armed and not yet fired?
+ */
+int ktimer_pending(const ktimer_t* timer);
+
+/**
+ * Run a CPU's wheel up to now and call the callbacks of expired timers
+ * in deadline order
+ * @return Number of callbacks run
+ */
+uint32_t ktimer_run(uint32_t cpu, uint64_t now);
+
+/**
+ * When a CPU next needs ktimer_run()
+ * Exact for timers due within 64 us, otherwise the time the wheel must
+ * move the timer's slot down a level, which is never later than the
+ * timer's deadline. The result is remembered as the CPU's programmed
+ * event: arming a timer earlier than it calls the program hook.
+ * @return Time in us since boot, or KTIMER_NONE if nothing is pending
+ */
+uint64_t ktimer_next_event(uint32_t cpu);
+
+/**
+ * Set the function called (on the CPU concerned, after the timer is
+ * queued) when a timer is armed earlier than that CPU's programmed
+ * event, so the event device can be reprogrammed
+ */
+void ktimer_set_program_hook(void (*hook)(uint32_t cpu));
+
+/**
+ * Get one CPU's wheel statistics
+ */
+void ktimer_get_stats(uint32_t cpu, ktimer_stats_t* stats);
+
+#endif /* AURORA_KTIMER_H */
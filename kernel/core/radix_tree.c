@@ -0,0 +1,215 @@
+/**
+ * Aurora OS - Radix Tree
+ *
+ * Each level consumes RADIX_TREE_MAP_SHIFT bits of the index, most
+ * significant level at the root. Growing the tree puts the old root in
+ * slot 0 of a new one; deleting the last item under a node frees it, and
+ * a root with only slot 0 in use is collapsed back down.
+ */
+
+#include "radix_tree.h"
+#include "../memory/memory.h"
+#include <stddef.h>
+
+/**
+ * Largest index a tree of the given height can hold
+ */
+static inline uint64_t height_max_index(uint32_t height) {
+    if (height >= RADIX_TREE_MAX_HEIGHT) {
+        return 0xFFFFFFFFull;
+    }
+    return (1ull << (height * RADIX_TREE_MAP_SHIFT)) - 1;
+}
+
+static radix_tree_node_t* node_alloc(void) {
+    radix_tree_node_t* node = (radix_tree_node_t*)kmalloc(sizeof(radix_tree_node_t));
+    if (!node) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < RADIX_TREE_MAP_SIZE; i++) {
+        node->slots[i] = NULL;
+    }
+    node->count = 0;
+    return node;
+}
+
+/**
+ * Add levels above the root until index fits (at least one level)
+ */
+static int radix_tree_extend(radix_tree_root_t* root, uint32_t index) {
+    while (root->height == 0 || index > height_max_index(root->height)) {
+        radix_tree_node_t* node = node_alloc();
+        if (!node) {
+            return -1;
+        }
+        if (root->rnode) {
+            node->slots[0] = root->rnode;
+            node->count = 1;
+        }
+        root->rnode = node;
+        root->height++;
+    }
+    return 0;
+}
+
+int radix_tree_insert(radix_tree_root_t* root, uint32_t index, void* item) {
+    if (!root || !item) {
+        return -1;
+    }
+
+    if (!root->rnode) {
+        root->height = 0;
+    }
+    if (root->height == 0 || index > height_max_index(root->height)) {
+        if (radix_tree_extend(root, index) != 0) {
+            return -1;
+        }
+    }
+
+    radix_tree_node_t* node = root->rnode;
+    uint32_t shift = (root->height - 1) * RADIX_TREE_MAP_SHIFT;
+
+    while (shift > 0) {
+        uint32_t offset = (index >> shift) & RADIX_TREE_MAP_MASK;
+        if (!node->slots[offset]) {
+            radix_tree_node_t* child = node_alloc();
+            if (!child) {
+                return -1;
+            }
+            node->slots[offset] = child;
+            node->count++;
+        }
+        node = (radix_tree_node_t*)node->slots[offset];
+        shift -= RADIX_TREE_MAP_SHIFT;
+    }
+
+    uint32_t offset = index & RADIX_TREE_MAP_MASK;
+    if (node->slots[offset]) {
+        return -1;
+    }
+    node->slots[offset] = item;
+    node->count++;
+    return 0;
+}
+
+void* radix_tree_lookup(const radix_tree_root_t* root, uint32_t index) {
+    if (!root || root->height == 0 || index > height_max_index(root->height)) {
+        return NULL;
+    }
+
+    radix_tree_node_t* node = root->rnode;
+    uint32_t shift = (root->height - 1) * RADIX_TREE_MAP_SHIFT;
+
+    while (node && shift > 0) {
+        node = (radix_tree_node_t*)node->slots[(index >> shift) & RADIX_TREE_MAP_MASK];
+        shift -= RADIX_TREE_MAP_SHIFT;
+    }
+
+    return node ? node->slots[index & RADIX_TREE_MAP_MASK] : NULL;
+}
+
+/**
+ * Drop root levels that only lead to slot 0
+ */
+static void radix_tree_shrink(radix_tree_root_t* root) {
+    while (root->height > 1 && root->rnode->count == 1 && root->rnode->slots[0]) {
+        radix_tree_node_t* old = root->rnode;
+        root->rnode = (radix_tree_node_t*)old->slots[0];
+        root->height--;
+        kfree(old);
+    }
+}
+
+void* radix_tree_delete(radix_tree_root_t* root, uint32_t index) {
+    radix_tree_node_t* path[RADIX_TREE_MAX_HEIGHT];
+    uint32_t offsets[RADIX_TREE_MAX_HEIGHT];
+
+    if (!root || root->height == 0 || index > height_max_index(root->height)) {
+        return NULL;
+    }
+
+    radix_tree_node_t* node = root->rnode;
+    uint32_t shift = (root->height - 1) * RADIX_TREE_MAP_SHIFT;
+    uint32_t level = 0;
+
+    for (;;) {
+        uint32_t offset = (index >> shift) & RADIX_TREE_MAP_MASK;
+        path[level] = node;
+        offsets[level] = offset;
+        if (shift == 0) {
+            break;
+        }
+        node = (radix_tree_node_t*)node->slots[offset];
+        if (!node) {
+            return NULL;
+        }
+        shift -= RADIX_TREE_MAP_SHIFT;
+        level++;
+    }
+
+    void* item = node->slots[offsets[level]];
+    if (!item) {
+        return NULL;
+    }
+
+    /* Clear the slot and free every node it leaves empty */
+    for (;;) {
+        path[level]->slots[offsets[level]] = NULL;
+        path[level]->count--;
+        if (path[level]->count > 0 || level == 0) {
+            break;
+        }
+        kfree(path[level]);
+        level--;
+    }
+
+    if (root->rnode->count == 0) {
+        kfree(root->rnode);
+        root->rnode = NULL;
+        root->height = 0;
+    } else {
+        radix_tree_shrink(root);
+    }
+
+    return item;
+}
+
+/**
+ * Collect items under a node whose indices start at base
+ */
+static void gang_collect(radix_tree_node_t* node, uint32_t shift, uint64_t base,
+                         uint32_t first, void** results, uint32_t max, uint32_t* found) {
+    uint32_t start = 0;
+
+    /* Skip slots wholly below first */
+    if (first > base) {
+        start = (uint32_t)((first - base) >> shift);
+    }
+
+    for (uint32_t i = start; i < RADIX_TREE_MAP_SIZE && *found < max; i++) {
+        if (!node->slots[i]) {
+            continue;
+        }
+        uint64_t index = base + ((uint64_t)i << shift);
+        if (shift == 0) {
+            results[(*found)++] = node->slots[i];
+        } else {
+            gang_collect((radix_tree_node_t*)node->slots[i], shift - RADIX_TREE_MAP_SHIFT,
+                         index, first, results, max, found);
+        }
+    }
+}
+
+uint32_t radix_tree_gang_lookup(const radix_tree_root_t* root, void** results,
+                                uint32_t first, uint32_t max) {
+    uint32_t found = 0;
+
+    if (!root || root->height == 0 || !results || max == 0 ||
+        first > height_max_index(root->height)) {
+        return 0;
+    }
+
+    gang_collect(root->rnode, (root->height - 1) * RADIX_TREE_MAP_SHIFT, 0,
+                 first, results, max, &found);
+    return found;
+}
@@ -0,0 +1,63 @@
+/**
+ * Aurora OS - Radix Tree Header
+ *
+ * Sparse map from 32-bit indices to pointers, in the style of the Linux
+ * radix tree: 64-way nodes, with the tree only as tall as the largest
+ * index needs, so dense runs of small indices (pages of a file) cost one
+ * or two node hops per lookup. Not locked; callers serialize.
+ */
+
+#ifndef AURORA_RADIX_TREE_H
+#define AURORA_RADIX_TREE_H
+
+#include <stdint.h>
+
+#define RADIX_TREE_MAP_SHIFT    6
+#define RADIX_TREE_MAP_SIZE     (1u << RADIX_TREE_MAP_SHIFT)
+#define RADIX_TREE_MAP_MASK     (RADIX_TREE_MAP_SIZE - 1)
+
+/* Levels needed to cover every 32-bit index */
+#define RADIX_TREE_MAX_HEIGHT   6
+
+typedef struct radix_tree_node {
+    void* slots[RADIX_TREE_MAP_SIZE];
+    uint32_t count;                 /* Occupied slots */
+} radix_tree_node_t;
+
+typedef struct {
+    uint32_t height;                /* 0 when empty */
+    radix_tree_node_t* rnode;
+} radix_tree_root_t;
+
+static inline void radix_tree_init(radix_tree_root_t* root) {
+    root->height = 0;
+    root->rnode = 0;
+}
+
+/**
+ * Store an item at an index
+ * @return 0 on success, -1 if the index is taken or out of memory
+ */
+int radix_tree_insert(radix_tree_root_t* root, uint32_t index, void* item);
+
+/**
+ * Find the item at an index
+ * @return Item, or NULL
+ */
+void* radix_tree_lookup(const radix_tree_root_t* root, uint32_t index);
+
+/**
+ * Remove the item at an index, freeing nodes left empty and shrinking
+ * the tree
+ * @return Removed item, or NULL if there was none
+ */
+void* radix_tree_delete(radix_tree_root_t* root, uint32_t index);
+
+/**
+ * Collect items at or after an index, in index order
+ * @return Number of items stored in results (at most max)
+ */
+uint32_t radix_tree_gang_lookup(const radix_tree_root_t* root, void** results,
+                                uint32_t first, uint32_t max);
+
+#endif /* AURORA_RADIX_TREE_H */
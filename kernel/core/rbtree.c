@@ -0,0 +1,262 @@
+/**
+ * Aurora OS - Red-Black Tree
+ *
+ * Classic red-black tree with parent pointers and NULL leaves (CLRS
+ * ch. 13, arranged as in the Linux 2.6 rbtree). Insertion and erasure
+ * rebalance with at most three rotations.
+ */
+
+#include "rbtree.h"
+
+static void set_child(rb_root_t* root, rb_node_t* parent, rb_node_t* old, rb_node_t* new_node) {
+    if (!parent) {
+        root->node = new_node;
+    } else if (parent->left == old) {
+        parent->left = new_node;
+    } else {
+        parent->right = new_node;
+    }
+}
+
+static void rotate_left(rb_root_t* root, rb_node_t* x) {
+    rb_node_t* y = x->right;
+
+    x->right = y->left;
+    if (y->left) {
+        y->left->parent = x;
+    }
+    y->parent = x->parent;
+    set_child(root, x->parent, x, y);
+    y->left = x;
+    x->parent = y;
+}
+
+static void rotate_right(rb_root_t* root, rb_node_t* x) {
+    rb_node_t* y = x->left;
+
+    x->left = y->right;
+    if (y->right) {
+        y->right->parent = x;
+    }
+    y->parent = x->parent;
+    set_child(root, x->parent, x, y);
+    y->right = x;
+    x->parent = y;
+}
+
+static inline int is_red(const rb_node_t* node) {
+    return node && node->red;
+}
+
+void rb_insert(rb_root_t* root, rb_node_t* node, rb_node_t* parent,
+               rb_node_t** link, int leftmost) {
+    node->parent = parent;
+    node->left = NULL;
+    node->right = NULL;
+    node->red = 1;
+    *link = node;
+    if (leftmost) {
+        root->leftmost = node;
+    }
+
+    rb_node_t* p;
+    while ((p = node->parent) && p->red) {
+        rb_node_t* g = p->parent;
+
+        if (p == g->left) {
+            rb_node_t* uncle = g->right;
+            if (is_red(uncle)) {
+                p->red = 0;
+                uncle->red = 0;
+                g->red = 1;
+                node = g;
+                continue;
+            }
+            if (node == p->right) {
+                rotate_left(root, p);
+                node = p;
+                p = node->parent;
+            }
+            p->red = 0;
+            g->red = 1;
+            rotate_right(root, g);
+        } else {
+            rb_node_t* uncle = g->left;
+            if (is_red(uncle)) {
+                p->red = 0;
+                uncle->red = 0;
+                g->red = 1;
+                node = g;
+                continue;
+            }
+            if (node == p->left) {
+                rotate_right(root, p);
+                node = p;
+                p = node->parent;
+            }
+            p->red = 0;
+            g->red = 1;
+            rotate_left(root, g);
+        }
+    }
+    root->node->red = 0;
+}
+
+/**
+ * Restore the black height after removing a black node; node is the
+ * (possibly NULL) child that took its place under parent
+ */
+static void erase_fixup(rb_root_t* root, rb_node_t* node, rb_node_t* parent) {
+    while (!is_red(node) && node != root->node) {
+        if (parent->left == node) {
+            rb_node_t* sib = parent->right;
+            if (sib->red) {
+                sib->red = 0;
+                parent->red = 1;
+                rotate_left(root, parent);
+                sib = parent->right;
+            }
+            if (!is_red(sib->left) && !is_red(sib->right)) {
+                sib->red = 1;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (!is_red(sib->right)) {
+                sib->left->red = 0;
+                sib->red = 1;
+                rotate_right(root, sib);
+                sib = parent->right;
+            }
+            sib->red = parent->red;
+            parent->red = 0;
+            sib->right->red = 0;
+            rotate_left(root, parent);
+        } else {
+            rb_node_t* sib = parent->left;
+            if (sib->red) {
+                sib->red = 0;
+                parent->red = 1;
+                rotate_right(root, parent);
+                sib = parent->left;
+            }
+            if (!is_red(sib->left) && !is_red(sib->right)) {
+                sib->red = 1;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (!is_red(sib->left)) {
+                sib->right->red = 0;
+                sib->red = 1;
+                rotate_left(root, sib);
+                sib = parent->left;
+            }
+            sib->red = parent->red;
+            parent->red = 0;
+            sib->left->red = 0;
+            rotate_right(root, parent);
+        }
+        node = root->node;
+        break;
+    }
+    if (node) {
+        node->red = 0;
+    }
+}
+
+void rb_erase(rb_root_t* root, rb_node_t* node) {
+    rb_node_t* child;
+    rb_node_t* parent;
+    int red;
+
+    if (root->leftmost == node) {
+        root->leftmost = rb_next(node);
+    }
+
+    if (node->left && node->right) {
+        /* Splice out the successor and put it in node's place */
+        rb_node_t* succ = node->right;
+        while (succ->left) {
+            succ = succ->left;
+        }
+
+        set_child(root, node->parent, node, succ);
+        child = succ->right;
+        parent = succ->parent;
+        red = succ->red;
+
+        if (parent == node) {
+            parent = succ;
+        } else {
+            if (child) {
+                child->parent = parent;
+            }
+            parent->left = child;
+            succ->right = node->right;
+            node->right->parent = succ;
+        }
+
+        succ->parent = node->parent;
+        succ->red = node->red;
+        succ->left = node->left;
+        node->left->parent = succ;
+    } else {
+        child = node->left ? node->left : node->right;
+        parent = node->parent;
+        red = node->red;
+
+        if (child) {
+            child->parent = parent;
+        }
+        set_child(root, parent, node, child);
+    }
+
+    if (!red) {
+        erase_fixup(root, child, parent);
+    }
+    rb_clear_node(node);
+}
+
+rb_node_t* rb_next(const rb_node_t* node) {
+    if (node->right) {
+        node = node->right;
+        while (node->left) {
+            node = node->left;
+        }
+        return (rb_node_t*)node;
+    }
+
+    rb_node_t* parent;
+    while ((parent = node->parent) && node == parent->right) {
+        node = parent;
+    }
+    return parent;
+}
+
+rb_node_t* rb_prev(const rb_node_t* node) {
+    if (node->left) {
+        node = node->left;
+        while (node->right) {
+            node = node->right;
+        }
+        return (rb_node_t*)node;
+    }
+
+    rb_node_t* parent;
+    while ((parent = node->parent) && node == parent->left) {
+        node = parent;
+    }
+    return parent;
+}
+
+rb_node_t* rb_last(const rb_root_t* root) {
+    rb_node_t* node = root->node;
+    if (!node) {
+        return NULL;
+    }
+    while (node->right) {
+        node = node->right;
+    }
+    return node;
+}
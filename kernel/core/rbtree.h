@@ -0,0 +1,77 @@
+/**
+ * Aurora OS - Red-Black Tree Header
+ *
+ * Intrusive red-black tree in the style of the Linux rbtree: nodes are
+ * embedded in the caller's structures and the caller does the ordered
+ * descent, so there are no comparison callbacks. The root caches its
+ * leftmost node for O(1) minimum lookups.
+ */
+
+#ifndef AURORA_RBTREE_H
+#define AURORA_RBTREE_H
+
+#include <stddef.h>
+
+typedef struct rb_node {
+    struct rb_node* parent;
+    struct rb_node* left;
+    struct rb_node* right;
+    int red;
+} rb_node_t;
+
+typedef struct {
+    rb_node_t* node;
+    rb_node_t* leftmost;
+} rb_root_t;
+
+/* Containing structure of an embedded node */
+#define rb_entry(ptr, type, member) \
+    ((type*)((char*)(ptr) - offsetof(type, member)))
+
+static inline void rb_init(rb_root_t* root) {
+    root->node = NULL;
+    root->leftmost = NULL;
+}
+
+/* Mark a node as not in any tree */
+static inline void rb_clear_node(rb_node_t* node) {
+    node->parent = node;
+}
+
+static inline int rb_node_linked(const rb_node_t* node) {
+    return node->parent != node;
+}
+
+static inline rb_node_t* rb_first(const rb_root_t* root) {
+    return root->leftmost;
+}
+
+/**
+ * Link a node at the leaf position found by the caller's descent, then
+ * rebalance
+ * @param root Tree
+ * @param node Node to insert
+ * @param parent Last node visited (NULL for an empty tree)
+ * @param link &parent->left or &parent->right (or &root->node)
+ * @param leftmost Non-zero if the descent only ever went left
+ */
+void rb_insert(rb_root_t* root, rb_node_t* node, rb_node_t* parent,
+               rb_node_t** link, int leftmost);
+
+/**
+ * Remove a node and rebalance; the node is left cleared
+ */
+void rb_erase(rb_root_t* root, rb_node_t* node);
+
+/**
+ * In-order neighbours (NULL at either end)
+ */
+rb_node_t* rb_next(const rb_node_t* node);
+rb_node_t* rb_prev(const rb_node_t* node);
+
+/**
+ * Rightmost node, or NULL for an empty tree
+ */
+rb_node_t* rb_last(const rb_root_t* root);
+
+#endif /* AURORA_RBTREE_H */
@@ -2,11 +2,31 @@
  * @file timing_system.c
  * @brief Unified Timing System Implementation
  * 
- * Provides high-precision timing services by wrapping the PIT timer driver
+ * Provides high-precision timing services by wrapping the PIT timer driver.
+ * Time first comes from counting PIT ticks; once dynamic ticks are enabled
+ * it is read from the HPET main counter and the periodic tick stops. Each
+ * CPU then programs a one-shot event (local APIC timer, or HPET comparator
+ * 0 on IRQ0 if the local APIC timer cannot be calibrated) for its next
+ * kernel timer, so an idle CPU sleeps in hlt until there is work due.
  */
 
 #include "timing_system.h"
+#include "ktimer.h"
 #include "../drivers/timer.h"
+#include "../drivers/hpet.h"
+#include "../smp/smp.h"
+#include "../process/process.h"
+#include "../interrupt/interrupt.h"
+
+/* Longest a CPU goes without an event, so clocks and 32-bit HPET
+ * counters are read regularly */
+#define TIMING_MAX_IDLE_US      1000000
+
+/* Sleeps shorter than this spin: blocking costs two context switches */
+#define TIMING_MIN_BLOCK_US     50
+
+/* Local APIC timer calibration period */
+#define TIMING_CALIBRATE_US     10000
 
 /* Timing system state */
 typedef struct {
@@ -18,10 +38,19 @@ typedef struct {
     uint32_t last_raw_ticks;    /* Last raw timer tick value */
     uint32_t update_count;      /* Update counter */
     bool initialized;           /* System initialized flag */
+    bool hpet_clock;            /* Time read from the HPET */
+    bool dynamic_ticks;         /* One-shot events instead of the PIT tick */
+    uint64_t clock_base_us;     /* Time when the HPET took over */
+    uint64_t hpet_base_ns;      /* HPET reading at that moment */
+    uint32_t apic_ticks_per_ms; /* Local APIC timer rate, 0 to use the HPET */
+    uint32_t events_programmed; /* One-shot events armed */
 } timing_state_t;
 
 static timing_state_t g_timing_state = {0};
 
+/* CPUs inside timing_system_update(), which reprograms on the way out */
+static volatile uint8_t g_in_update[MAX_CPUS];
+
 /**
  * Calculate elapsed ticks handling wraparound
  */
@@ -55,31 +84,162 @@ void timing_system_init(void) {
     g_timing_state.ms_per_tick = 1000 / g_timing_state.timer_frequency;
     g_timing_state.us_per_tick = g_timing_state.ms_per_tick * 1000;
     
+    /* Kernel timers, run from every timer event */
+    ktimer_init();
+    
     g_timing_state.initialized = true;
 }
 
+/**
+ * Arm this CPU's one-shot event device for a deadline
+ * @return 0 if armed, -1 if the deadline passed before it could be
+ */
+static int timing_arm_event(uint64_t now_us, uint64_t deadline_us) {
+    g_timing_state.events_programmed++;
+    
+    if (g_timing_state.apic_ticks_per_ms) {
+        uint64_t count = ((deadline_us - now_us) * g_timing_state.apic_ticks_per_ms) / 1000;
+        if (count == 0) {
+            count = 1;
+        } else if (count > 0xFFFFFFFF) {
+            count = 0xFFFFFFFF;
+        }
+        apic_timer_oneshot(APIC_TIMER_VECTOR, (uint32_t)count);
+        return 0;
+    }
+    
+    /* HPET events arrive on IRQ0, which only the BSP takes */
+    return hpet_program_oneshot(g_timing_state.hpet_base_ns +
+                                (deadline_us - g_timing_state.clock_base_us) * 1000);
+}
+
+/**
+ * Program the current CPU's next event from its kernel timers, running
+ * any that fall due before the device can be armed
+ */
+static void timing_program_next_event(uint32_t cpu) {
+    for (;;) {
+        uint64_t now = timing_get_microseconds();
+        uint64_t next = ktimer_next_event(cpu);
+        
+        if (next > now + TIMING_MAX_IDLE_US) {
+            next = now + TIMING_MAX_IDLE_US;
+        }
+        if (next > now && timing_arm_event(now, next) == 0) {
+            return;
+        }
+        ktimer_run(cpu, now);
+    }
+}
+
+/**
+ * Kernel timer hook: a timer was armed before a CPU's programmed event
+ */
+static void timing_reprogram(uint32_t cpu) {
+    if (!g_timing_state.dynamic_ticks || g_in_update[cpu]) {
+        return;
+    }
+    
+    if (cpu == smp_get_current_cpu_id()) {
+        timing_program_next_event(cpu);
+    } else {
+        /* Its timer interrupt handler will reprogram it */
+        apic_send_ipi(cpu, APIC_TIMER_VECTOR);
+    }
+}
+
+/**
+ * APIC_TIMER_VECTOR handler: this CPU's one-shot event, or another CPU
+ * asking it to reprogram
+ */
+static void timing_apic_timer_interrupt(void) {
+    apic_eoi();
+    timer_handler();
+}
+
 /**
  * Update timing system state
- * Called from timer interrupt handler on each tick
+ * Called from timer interrupt handler on each tick or event
  */
 void timing_system_update(void) {
     if (!g_timing_state.initialized) {
         return;
     }
     
-    /* Get current raw ticks */
-    uint32_t current_ticks = timer_get_ticks();
+    uint32_t cpu = smp_get_current_cpu_id();
     
-    /* Calculate elapsed ticks */
-    uint32_t elapsed = calculate_elapsed_ticks(current_ticks, g_timing_state.last_raw_ticks);
+    if (g_timing_state.hpet_clock) {
+        uint64_t now = timing_get_microseconds();
+        g_timing_state.ticks_us = now;
+        g_timing_state.ticks_ms = now / 1000;
+    } else {
+        /* Get current raw ticks */
+        uint32_t current_ticks = timer_get_ticks();
+        
+        /* Calculate elapsed ticks */
+        uint32_t elapsed = calculate_elapsed_ticks(current_ticks, g_timing_state.last_raw_ticks);
+        
+        /* Update milliseconds and microseconds using precomputed factors */
+        g_timing_state.ticks_ms += (uint64_t)elapsed * g_timing_state.ms_per_tick;
+        g_timing_state.ticks_us += (uint64_t)elapsed * g_timing_state.us_per_tick;
+        
+        /* Update last tick value */
+        g_timing_state.last_raw_ticks = current_ticks;
+    }
+    g_timing_state.update_count++;
     
-    /* Update milliseconds and microseconds using precomputed factors */
-    g_timing_state.ticks_ms += (uint64_t)elapsed * g_timing_state.ms_per_tick;
-    g_timing_state.ticks_us += (uint64_t)elapsed * g_timing_state.us_per_tick;
+    /* Run expired kernel timers, then sleep until the next one */
+    g_in_update[cpu] = 1;
+    ktimer_run(cpu, timing_get_microseconds());
+    g_in_update[cpu] = 0;
     
-    /* Update last tick value */
-    g_timing_state.last_raw_ticks = current_ticks;
-    g_timing_state.update_count++;
+    if (g_timing_state.dynamic_ticks) {
+        timing_program_next_event(cpu);
+    }
+}
+
+/**
+ * Switch to the HPET clock and one-shot timer events
+ */
+int timing_system_enable_dynamic_ticks(void) {
+    if (g_timing_state.dynamic_ticks) {
+        return 0;
+    }
+    if (!g_timing_state.initialized) {
+        timing_system_init();
+    }
+    if (hpet_init() != 0) {
+        return -1;
+    }
+    
+    /* Continue the PIT-derived time on the HPET */
+    g_timing_state.clock_base_us = timing_get_microseconds();
+    g_timing_state.hpet_base_ns = hpet_read_ns();
+    g_timing_state.hpet_clock = true;
+    
+    /* Measure the local APIC timer against the HPET */
+    apic_timer_oneshot(APIC_TIMER_VECTOR, 0xFFFFFFFF);
+    uint64_t start = hpet_read_ns();
+    while (hpet_read_ns() - start < (uint64_t)TIMING_CALIBRATE_US * 1000) {
+        __asm__ __volatile__("pause");
+    }
+    uint32_t counted = 0xFFFFFFFF - apic_timer_remaining();
+    apic_timer_oneshot(APIC_TIMER_VECTOR, 0);
+    g_timing_state.apic_ticks_per_ms = counted / (TIMING_CALIBRATE_US / 1000);
+    
+    /* IRQ0 carries HPET events from here on, or nothing */
+    if (hpet_oneshot_enable() != 0 && g_timing_state.apic_ticks_per_ms == 0) {
+        /* No one-shot device: keep the PIT tick, with the HPET clock */
+        return -1;
+    }
+    timer_stop();
+    
+    register_interrupt_handler(APIC_TIMER_VECTOR, timing_apic_timer_interrupt);
+    ktimer_set_program_hook(timing_reprogram);
+    g_timing_state.dynamic_ticks = true;
+    
+    timing_program_next_event(smp_get_current_cpu_id());
+    return 0;
 }
 
 /**
@@ -91,6 +251,10 @@ uint64_t get_system_ticks(void) {
         timing_system_init();
     }
     
+    if (g_timing_state.hpet_clock) {
+        return timing_get_microseconds() / 1000;
+    }
+    
     /* Get current timer ticks and calculate elapsed time */
     uint32_t current_ticks = timer_get_ticks();
     
@@ -116,6 +280,11 @@ uint64_t timing_get_microseconds(void) {
         timing_system_init();
     }
     
+    if (g_timing_state.hpet_clock) {
+        return g_timing_state.clock_base_us +
+               (hpet_read_ns() - g_timing_state.hpet_base_ns) / 1000;
+    }
+    
     /* Get current timer ticks */
     uint32_t current_ticks = timer_get_ticks();
     
@@ -126,40 +295,48 @@ uint64_t timing_get_microseconds(void) {
     return g_timing_state.ticks_us + ((uint64_t)elapsed * g_timing_state.us_per_tick);
 }
 
+/**
+ * Sleep until a deadline
+ * Blocks the calling process on a kernel timer; spins for short sleeps,
+ * and before the scheduler runs or from the idle process.
+ */
+static void timing_sleep_until(uint64_t deadline_us) {
+    uint64_t now = timing_get_microseconds();
+    
+    /* Without dynamic ticks, wakeups only come once per tick */
+    uint32_t min_block = g_timing_state.dynamic_ticks ? TIMING_MIN_BLOCK_US
+                                                      : g_timing_state.us_per_tick;
+    
+    if (deadline_us > now + min_block && process_sleep_until(deadline_us) == 0) {
+        return;
+    }
+    
+    /* Busy-wait with CPU pause for efficiency */
+    while (timing_get_microseconds() < deadline_us) {
+        __asm__ __volatile__("pause");
+    }
+}
+
 /**
  * Sleep for specified milliseconds
  */
 void timing_sleep_ms(uint32_t milliseconds) {
-    timer_sleep(milliseconds);
+    if (milliseconds == 0) {
+        return;
+    }
+    
+    timing_sleep_until(timing_get_microseconds() + (uint64_t)milliseconds * 1000);
 }
 
 /**
  * Sleep for specified microseconds
- * For very short durations, uses optimized busy-wait
  */
 void timing_sleep_us(uint32_t microseconds) {
     if (microseconds == 0) {
         return;
     }
     
-    /* For durations >= 1ms, use timer_sleep */
-    if (microseconds >= 1000) {
-        timer_sleep(microseconds / 1000);
-        microseconds %= 1000;
-    }
-    
-    /* For remaining microseconds, use optimized busy-wait */
-    if (microseconds > 0) {
-        /* Cache start time to minimize function calls */
-        uint64_t start_us = timing_get_microseconds();
-        uint64_t target_us = start_us + microseconds;
-        
-        /* Busy-wait with CPU pause for efficiency */
-        while (timing_get_microseconds() < target_us) {
-            /* CPU pause reduces power and improves performance */
-            __asm__ __volatile__("pause");
-        }
-    }
+    timing_sleep_until(timing_get_microseconds() + microseconds);
 }
 
 /**
@@ -178,4 +355,6 @@ void timing_get_stats(timing_stats_t* stats) {
     stats->ticks_us = g_timing_state.ticks_us;
     stats->timer_frequency = g_timing_state.timer_frequency;
     stats->update_count = g_timing_state.update_count;
+    stats->dynamic_ticks = g_timing_state.dynamic_ticks;
+    stats->events_programmed = g_timing_state.events_programmed;
 }
@@ -35,22 +35,31 @@ uint64_t timing_get_microseconds(void);
 
 /**
  * Sleep for specified milliseconds
- * Wrapper for timer_sleep() with better naming
+ * Blocks the calling process until a kernel timer wakes it
  */
 void timing_sleep_ms(uint32_t milliseconds);
 
 /**
  * Sleep for specified microseconds
- * High-precision sleep (busy-wait for short durations)
+ * High-precision sleep (blocks, or busy-waits for short durations)
  */
 void timing_sleep_us(uint32_t microseconds);
 
 /**
- * Update timing system state
+ * Update timing system state and run expired kernel timers
  * Called from timer interrupt handler
  */
 void timing_system_update(void);
 
+/**
+ * Switch from the periodic PIT tick to one-shot timer events
+ * Time is then read from the HPET and each CPU is only interrupted when
+ * its next kernel timer is due (or after at most a second). Call once
+ * the local APIC and the scheduler are up.
+ * @return 0 on success, -1 if there is no HPET or one-shot event device
+ */
+int timing_system_enable_dynamic_ticks(void);
+
 /**
  * Get timing statistics
  */
@@ -59,6 +68,8 @@ typedef struct {
     uint64_t ticks_us;          /* Microseconds since boot */
     uint32_t timer_frequency;   /* Timer frequency in Hz */
     uint32_t update_count;      /* Number of timer updates */
+    bool dynamic_ticks;         /* One-shot events instead of a periodic tick */
+    uint32_t events_programmed; /* One-shot events armed */
 } timing_stats_t;
 
 void timing_get_stats(timing_stats_t* stats);
@@ -0,0 +1,161 @@
+/**
+ * Aurora OS - HPET Driver Implementation
+ *
+ * High Precision Event Timer clocksource and one-shot event timer
+ */
+
+#include "hpet.h"
+
+/* HPET state */
+static volatile uint32_t* hpet_regs = 0;
+static uint32_t hpet_period_fs = 0;     /* Femtoseconds per counter tick */
+static int hpet_counter_64 = 0;
+static int hpet_legacy_capable = 0;
+static int hpet_oneshot = 0;
+
+/* 32-bit counter extension */
+static uint32_t hpet_last_low = 0;
+static uint32_t hpet_high = 0;
+
+static inline uint32_t hpet_read(uint32_t reg) {
+    return hpet_regs[reg / 4];
+}
+
+static inline void hpet_write(uint32_t reg, uint32_t value) {
+    hpet_regs[reg / 4] = value;
+}
+
+/**
+ * Convert counter ticks to nanoseconds without overflowing:
+ * period_fs < 2^27, so the remainder product stays below 2^47
+ */
+static inline uint64_t ticks_to_ns(uint64_t ticks) {
+    return (ticks / 1000000) * hpet_period_fs +
+           ((ticks % 1000000) * hpet_period_fs) / 1000000;
+}
+
+static inline uint64_t ns_to_ticks(uint64_t ns) {
+    return (ns / hpet_period_fs) * 1000000 +
+           ((ns % hpet_period_fs) * 1000000) / hpet_period_fs;
+}
+
+/**
+ * Probe and start the HPET main counter
+ */
+int hpet_init(void) {
+    volatile uint32_t* regs = (volatile uint32_t*)HPET_DEFAULT_BASE;
+    uint32_t cap = regs[HPET_REG_CAP_ID / 4];
+    uint32_t period = regs[HPET_REG_CAP_ID / 4 + 1];
+
+    /* Absent hardware reads back as all ones (or zeros) */
+    if (cap == 0xFFFFFFFF || period == 0 || period > HPET_MAX_PERIOD_FS) {
+        return -1;
+    }
+
+    hpet_regs = regs;
+    hpet_period_fs = period;
+    hpet_counter_64 = (cap & HPET_CAP_COUNT_64) != 0;
+    hpet_legacy_capable = (cap & HPET_CAP_LEGACY_ROUTE) != 0;
+
+    /* Halt, zero and restart the main counter */
+    hpet_write(HPET_REG_CONFIG, hpet_read(HPET_REG_CONFIG) & ~(HPET_CFG_ENABLE | HPET_CFG_LEGACY_ROUTE));
+    hpet_write(HPET_REG_COUNTER, 0);
+    hpet_write(HPET_REG_COUNTER + 4, 0);
+    hpet_last_low = 0;
+    hpet_high = 0;
+
+    /* Comparator 0 quiet until someone asks for events */
+    hpet_write(HPET_REG_TIMER_CONFIG(0),
+               hpet_read(HPET_REG_TIMER_CONFIG(0)) & ~(HPET_TN_INT_ENABLE | HPET_TN_PERIODIC));
+
+    hpet_write(HPET_REG_CONFIG, hpet_read(HPET_REG_CONFIG) | HPET_CFG_ENABLE);
+    return 0;
+}
+
+/**
+ * Is the HPET present and counting?
+ */
+int hpet_available(void) {
+    return hpet_regs != 0;
+}
+
+/**
+ * Read the main counter
+ */
+uint64_t hpet_read_counter(void) {
+    if (!hpet_regs) {
+        return 0;
+    }
+
+    if (hpet_counter_64) {
+        /* Two 32-bit reads; retry if the low half carried in between */
+        uint32_t high, low;
+        do {
+            high = hpet_read(HPET_REG_COUNTER + 4);
+            low = hpet_read(HPET_REG_COUNTER);
+        } while (high != hpet_read(HPET_REG_COUNTER + 4));
+        return ((uint64_t)high << 32) | low;
+    }
+
+    uint32_t low = hpet_read(HPET_REG_COUNTER);
+    if (low < hpet_last_low) {
+        hpet_high++;
+    }
+    hpet_last_low = low;
+    return ((uint64_t)hpet_high << 32) | low;
+}
+
+/**
+ * Nanoseconds since hpet_init()
+ */
+uint64_t hpet_read_ns(void) {
+    return ticks_to_ns(hpet_read_counter());
+}
+
+/**
+ * Take over IRQ0 with comparator 0 in one-shot mode
+ */
+int hpet_oneshot_enable(void) {
+    if (!hpet_regs || !hpet_legacy_capable) {
+        return -1;
+    }
+
+    uint32_t config = hpet_read(HPET_REG_TIMER_CONFIG(0));
+    config &= ~HPET_TN_PERIODIC;
+    config |= HPET_TN_INT_ENABLE;
+    if (!hpet_counter_64) {
+        config |= HPET_TN_32BIT;
+    }
+    hpet_write(HPET_REG_TIMER_CONFIG(0), config);
+
+    /* Park the comparator as far out as it goes until the first event */
+    hpet_write(HPET_REG_TIMER_COMPARATOR(0), 0xFFFFFFFF);
+    hpet_write(HPET_REG_TIMER_COMPARATOR(0) + 4, 0xFFFFFFFF);
+
+    hpet_write(HPET_REG_CONFIG, hpet_read(HPET_REG_CONFIG) | HPET_CFG_LEGACY_ROUTE);
+    hpet_oneshot = 1;
+    return 0;
+}
+
+/**
+ * Raise IRQ0 once the clock reaches a deadline
+ */
+int hpet_program_oneshot(uint64_t deadline_ns) {
+    if (!hpet_oneshot) {
+        return -1;
+    }
+
+    uint64_t target = ns_to_ticks(deadline_ns);
+
+    hpet_write(HPET_REG_TIMER_COMPARATOR(0), (uint32_t)target);
+    if (hpet_counter_64) {
+        hpet_write(HPET_REG_TIMER_COMPARATOR(0) + 4, (uint32_t)(target >> 32));
+    }
+
+    /* The comparator only matches on equality: if the counter already
+     * passed it while we were writing, no interrupt will come */
+    if (hpet_read_counter() >= target) {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+/**
+ * Aurora OS - HPET Driver Header
+ *
+ * High Precision Event Timer: a free-running main counter used as the
+ * kernel clocksource, and comparator 0 as a one-shot event timer that
+ * replaces the PIT on IRQ0 (legacy replacement routing)
+ */
+
+#ifndef AURORA_HPET_H
+#define AURORA_HPET_H
+
+#include <stdint.h>
+
+/* Default MMIO base; ACPI's HPET table reports the same on PC chipsets */
+#define HPET_DEFAULT_BASE       0xFED00000
+
+/* Register offsets */
+#define HPET_REG_CAP_ID         0x000
+#define HPET_REG_CONFIG         0x010
+#define HPET_REG_INT_STATUS     0x020
+#define HPET_REG_COUNTER        0x0F0
+#define HPET_REG_TIMER_CONFIG(n)    (0x100 + 0x20 * (n))
+#define HPET_REG_TIMER_COMPARATOR(n) (0x108 + 0x20 * (n))
+
+/* General capabilities (low dword) */
+#define HPET_CAP_COUNT_64       (1u << 13)
+#define HPET_CAP_LEGACY_ROUTE   (1u << 15)
+
+/* General configuration */
+#define HPET_CFG_ENABLE         (1u << 0)
+#define HPET_CFG_LEGACY_ROUTE   (1u << 1)
+
+/* Timer configuration */
+#define HPET_TN_INT_ENABLE      (1u << 2)
+#define HPET_TN_PERIODIC        (1u << 3)
+#define HPET_TN_32BIT           (1u << 8)
+
+/* The specification caps the tick period at 100 ns */
+#define HPET_MAX_PERIOD_FS      100000000u
+
+/**
+ * Probe and start the HPET main counter
+ * The PIT keeps delivering IRQ0 until hpet_oneshot_enable().
+ * @return 0 on success, -1 if no usable HPET is present
+ */
+int hpet_init(void);
+
+/**
+ * Is the HPET present and counting?
+ */
+int hpet_available(void);
+
+/**
+ * Read the main counter, extended to 64 bits on 32-bit counters
+ * (which must then be read at least once per wrap, ~5 minutes)
+ */
+uint64_t hpet_read_counter(void);
+
+/**
+ * Nanoseconds since hpet_init()
+ */
+uint64_t hpet_read_ns(void);
+
+/**
+ * Take over IRQ0 from the PIT with comparator 0 in one-shot mode
+ * @return 0 on success, -1 without legacy replacement routing
+ */
+int hpet_oneshot_enable(void);
+
+/**
+ * Raise IRQ0 once the clock reaches a deadline
+ * @param deadline_ns Time as returned by hpet_read_ns()
+ * @return 0 if armed, -1 if the deadline had already passed (nothing
+ *         will fire; the caller should handle the event itself)
+ */
+int hpet_program_oneshot(uint64_t deadline_ns);
+
+#endif /* AURORA_HPET_H */
@@ -7,6 +7,7 @@
 #include "timer.h"
 #include "../core/port_io.h"
 #include "../core/timing_system.h"
+#include "../process/process.h"
 
 /* Timer state */
 static volatile uint32_t timer_ticks = 0;
@@ -35,12 +36,17 @@ void timer_init(uint32_t frequency) {
 
 /**
  * Timer interrupt handler
+ * Called for every timer event: periodic PIT ticks, or the one-shot
+ * HPET and local APIC events once dynamic ticks are enabled.
  */
 void timer_handler(void) {
     timer_ticks++;
     
     /* Update timing system on each timer tick */
     timing_system_update();
+    
+    /* Let the scheduler end the running slice */
+    scheduler_tick();
 }
 
 /**
@@ -54,54 +60,50 @@ uint32_t timer_get_ticks(void) {
  * Wait for specified number of ticks
  */
 void timer_wait(uint32_t ticks) {
-    uint32_t start_ticks = timer_ticks;
-    while (timer_ticks - start_ticks < ticks) {
-        /* Wait */
+    if (timer_frequency == 0) {
+        return;
     }
+    
+    timing_sleep_us((uint32_t)(((uint64_t)ticks * 1000000) / timer_frequency));
 }
 
 /**
  * Sleep for specified milliseconds
  */
 void timer_sleep(uint32_t milliseconds) {
-    if (timer_frequency == 0) {
-        return;
-    }
-    
-    /* Calculate ticks needed */
-    uint32_t ticks = (milliseconds * timer_frequency) / 1000;
-    timer_wait(ticks);
+    timing_sleep_ms(milliseconds);
+}
+
+/**
+ * Stop periodic interrupts once another device takes over timer events
+ * Mode 0 (interrupt on terminal count) fires once and does not reload.
+ */
+void timer_stop(void) {
+    outb(PIT_COMMAND_PORT, 0x30);
+    outb(PIT_CHANNEL0_PORT, 0xFF);
+    outb(PIT_CHANNEL0_PORT, 0xFF);
 }
 
 /**
  * Get seconds since boot (wrapped to 0-59)
  */
 uint32_t timer_get_seconds(void) {
-    if (timer_frequency == 0) {
-        return 0;
-    }
-    return (timer_ticks / timer_frequency) % 60;
+    return (uint32_t)((get_system_ticks() / 1000) % 60);
 }
 
 /**
  * Get minutes since boot (wrapped to 0-59)
  */
 uint32_t timer_get_minutes(void) {
-    if (timer_frequency == 0) {
-        return 0;
-    }
-    return (timer_ticks / (timer_frequency * 60)) % 60;
+    return (uint32_t)((get_system_ticks() / 60000) % 60);
 }
 
 /**
  * Get hours since boot (wrapped to 0-23 in 12-hour format with offset)
  */
 uint32_t timer_get_hours(void) {
-    if (timer_frequency == 0) {
-        return 12;  /* Default to 12:00 */
-    }
     /* Start at 12:00 and wrap at 24 hours */
-    return (12 + (timer_ticks / (timer_frequency * 3600))) % 24;
+    return (uint32_t)((12 + get_system_ticks() / 3600000) % 24);
 }
 
 /**
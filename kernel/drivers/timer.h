@@ -24,6 +24,7 @@ void timer_handler(void);
 uint32_t timer_get_ticks(void);
 void timer_wait(uint32_t ticks);
 void timer_sleep(uint32_t milliseconds);
+void timer_stop(void);
 
 /* Time tracking functions */
 uint32_t timer_get_seconds(void);
@@ -0,0 +1,358 @@
+/**
+ * Aurora OS - Buddy Frame Allocator
+ *
+ * Classic binary buddy system. Each order keeps a doubly linked free list
+ * threaded through the head frames' metadata, so taking a block, removing
+ * a buddy for merging and pushing a split half are all O(1) and a whole
+ * allocation or free is O(BUDDY_MAX_ORDER).
+ *
+ * The state byte of a block's head frame says whether it is free (and at
+ * which order), an allocated buddy block (with its order, so buddy_free
+ * needs no size) or a contiguous allocation (frame count in next). All
+ * other frames - block interiors and reserved memory - read as "none",
+ * which is what stops merges at allocated or reserved neighbours.
+ */
+
+#include "buddy.h"
+
+/* Head frame states */
+#define BUDDY_STATE_NONE        0x00
+#define BUDDY_STATE_FREE        0x80    /* | order */
+#define BUDDY_STATE_BLOCK       0x40    /* | order */
+#define BUDDY_STATE_CONTIG      0x20
+#define BUDDY_ORDER_MASK        0x0F
+
+static void list_push(buddy_zone_t* zone, uint32_t idx, uint32_t order) {
+    buddy_frame_t* f = zone->frames;
+    uint32_t head = zone->free_head[order];
+
+    f[idx].state = (uint8_t)(BUDDY_STATE_FREE | order);
+    f[idx].prev = BUDDY_INVALID;
+    f[idx].next = head;
+    if (head != BUDDY_INVALID) {
+        f[head].prev = idx;
+    }
+    zone->free_head[order] = idx;
+    zone->free_blocks[order]++;
+    zone->free_frames += 1u << order;
+}
+
+static void list_remove(buddy_zone_t* zone, uint32_t idx, uint32_t order) {
+    buddy_frame_t* f = zone->frames;
+
+    if (f[idx].prev != BUDDY_INVALID) {
+        f[f[idx].prev].next = f[idx].next;
+    } else {
+        zone->free_head[order] = f[idx].next;
+    }
+    if (f[idx].next != BUDDY_INVALID) {
+        f[f[idx].next].prev = f[idx].prev;
+    }
+    f[idx].state = BUDDY_STATE_NONE;
+    zone->free_blocks[order]--;
+    zone->free_frames -= 1u << order;
+}
+
+/**
+ * Free a block, merging with its buddy for as long as the buddy is free
+ * at the same order
+ */
+static void free_block(buddy_zone_t* zone, uint32_t idx, uint32_t order) {
+    buddy_frame_t* f = zone->frames;
+
+    while (order < BUDDY_MAX_ORDER) {
+        uint32_t buddy = idx ^ (1u << order);
+        if (buddy >= zone->count || f[buddy].state != (BUDDY_STATE_FREE | order)) {
+            break;
+        }
+        list_remove(zone, buddy, order);
+        idx &= ~(1u << order);
+        order++;
+        zone->merges++;
+    }
+    list_push(zone, idx, order);
+}
+
+/**
+ * Free an arbitrary range as the largest aligned blocks it contains
+ */
+static void free_range(buddy_zone_t* zone, uint32_t idx, uint32_t count) {
+    while (count) {
+        uint32_t order = BUDDY_MAX_ORDER;
+        while ((idx & ((1u << order) - 1)) || (1u << order) > count) {
+            order--;
+        }
+        free_block(zone, idx, order);
+        idx += 1u << order;
+        count -= 1u << order;
+    }
+}
+
+/**
+ * Take a free block of at least the given order, splitting larger ones
+ * @return Zone-relative index, or BUDDY_INVALID
+ */
+static uint32_t take_block(buddy_zone_t* zone, uint32_t order) {
+    for (uint32_t o = order; o <= BUDDY_MAX_ORDER; o++) {
+        uint32_t idx = zone->free_head[o];
+        if (idx == BUDDY_INVALID) {
+            continue;
+        }
+
+        list_remove(zone, idx, o);
+        while (o > order) {
+            o--;
+            list_push(zone, idx + (1u << o), o);
+            zone->splits++;
+        }
+        return idx;
+    }
+    return BUDDY_INVALID;
+}
+
+int buddy_init(buddy_zone_t* zone, buddy_frame_t* frames, uint32_t base_pfn, uint32_t count) {
+    if (!zone || !frames || count == 0 ||
+        (base_pfn & ((1u << BUDDY_MAX_ORDER) - 1)) ||
+        count > BUDDY_INVALID - base_pfn) {
+        return -1;
+    }
+
+    zone->frames = frames;
+    zone->base_pfn = base_pfn;
+    zone->count = count;
+    for (uint32_t o = 0; o < BUDDY_NUM_ORDERS; o++) {
+        zone->free_head[o] = BUDDY_INVALID;
+        zone->free_blocks[o] = 0;
+    }
+    zone->free_frames = 0;
+    zone->managed_frames = 0;
+    zone->allocs = 0;
+    zone->frees = 0;
+    zone->splits = 0;
+    zone->merges = 0;
+    zone->failed = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        frames[i].next = BUDDY_INVALID;
+        frames[i].prev = BUDDY_INVALID;
+        frames[i].state = BUDDY_STATE_NONE;
+        frames[i].shares = 0;
+    }
+    return 0;
+}
+
+void buddy_add_range(buddy_zone_t* zone, uint32_t pfn, uint32_t count) {
+    if (pfn < zone->base_pfn) {
+        uint32_t skip = zone->base_pfn - pfn;
+        if (skip >= count) {
+            return;
+        }
+        pfn += skip;
+        count -= skip;
+    }
+
+    uint32_t idx = pfn - zone->base_pfn;
+    if (idx >= zone->count) {
+        return;
+    }
+    if (count > zone->count - idx) {
+        count = zone->count - idx;
+    }
+
+    free_range(zone, idx, count);
+    zone->managed_frames += count;
+}
+
+uint32_t buddy_alloc(buddy_zone_t* zone, uint32_t order) {
+    if (order > BUDDY_MAX_ORDER) {
+        zone->failed++;
+        return BUDDY_INVALID;
+    }
+
+    uint32_t idx = take_block(zone, order);
+    if (idx == BUDDY_INVALID) {
+        zone->failed++;
+        return BUDDY_INVALID;
+    }
+
+    zone->frames[idx].state = (uint8_t)(BUDDY_STATE_BLOCK | order);
+    zone->allocs++;
+    return zone->base_pfn + idx;
+}
+
+/**
+ * Find and claim a run of adjacent free max-order blocks
+ */
+static uint32_t take_max_blocks(buddy_zone_t* zone, uint32_t blocks) {
+    buddy_frame_t* f = zone->frames;
+    const uint32_t size = 1u << BUDDY_MAX_ORDER;
+
+    for (uint32_t idx = zone->free_head[BUDDY_MAX_ORDER]; idx != BUDDY_INVALID; idx = f[idx].next) {
+        if (idx + (uint64_t)blocks * size > zone->count) {
+            continue;
+        }
+
+        uint32_t b = 1;
+        while (b < blocks && f[idx + b * size].state == (BUDDY_STATE_FREE | BUDDY_MAX_ORDER)) {
+            b++;
+        }
+        if (b < blocks) {
+            continue;
+        }
+
+        for (b = 0; b < blocks; b++) {
+            list_remove(zone, idx + b * size, BUDDY_MAX_ORDER);
+        }
+        return idx;
+    }
+    return BUDDY_INVALID;
+}
+
+uint32_t buddy_alloc_contig(buddy_zone_t* zone, uint32_t count) {
+    if (count == 0 || count > zone->count) {
+        zone->failed++;
+        return BUDDY_INVALID;
+    }
+
+    uint32_t idx;
+    uint32_t span;
+    if (count <= (1u << BUDDY_MAX_ORDER)) {
+        uint32_t order = 0;
+        while ((1u << order) < count) {
+            order++;
+        }
+        idx = take_block(zone, order);
+        span = 1u << order;
+    } else {
+        uint32_t blocks = (count + (1u << BUDDY_MAX_ORDER) - 1) >> BUDDY_MAX_ORDER;
+        idx = take_max_blocks(zone, blocks);
+        span = blocks << BUDDY_MAX_ORDER;
+    }
+
+    if (idx == BUDDY_INVALID) {
+        zone->failed++;
+        return BUDDY_INVALID;
+    }
+
+    /* Give back the unused tail */
+    if (span > count) {
+        free_range(zone, idx + count, span - count);
+    }
+
+    zone->frames[idx].state = BUDDY_STATE_CONTIG;
+    zone->frames[idx].next = count;
+    zone->allocs++;
+    return zone->base_pfn + idx;
+}
+
+int buddy_free(buddy_zone_t* zone, uint32_t pfn) {
+    if (pfn < zone->base_pfn || pfn - zone->base_pfn >= zone->count) {
+        return -1;
+    }
+
+    uint32_t idx = pfn - zone->base_pfn;
+    buddy_frame_t* f = &zone->frames[idx];
+    if (f->state & BUDDY_STATE_BLOCK) {
+        uint32_t order = f->state & BUDDY_ORDER_MASK;
+        f->state = BUDDY_STATE_NONE;
+        free_block(zone, idx, order);
+    } else if (f->state == BUDDY_STATE_CONTIG) {
+        uint32_t count = f->next;
+        f->state = BUDDY_STATE_NONE;
+        f->next = BUDDY_INVALID;
+        free_range(zone, idx, count);
+    } else {
+        return -1;
+    }
+
+    zone->frees++;
+    return 0;
+}
+
+uint32_t buddy_allocation_frames(const buddy_zone_t* zone, uint32_t pfn) {
+    if (pfn < zone->base_pfn || pfn - zone->base_pfn >= zone->count) {
+        return 0;
+    }
+
+    const buddy_frame_t* f = &zone->frames[pfn - zone->base_pfn];
+    if (f->state & BUDDY_STATE_BLOCK) {
+        return 1u << (f->state & BUDDY_ORDER_MASK);
+    }
+    return f->state == BUDDY_STATE_CONTIG ? f->next : 0;
+}
+
+uint32_t buddy_frame_refs(const buddy_zone_t* zone, uint32_t pfn) {
+    if (pfn < zone->base_pfn || pfn - zone->base_pfn >= zone->count) {
+        return 0;
+    }
+    return zone->frames[pfn - zone->base_pfn].shares + 1u;
+}
+
+uint32_t buddy_frame_get(buddy_zone_t* zone, uint32_t pfn) {
+    if (pfn < zone->base_pfn || pfn - zone->base_pfn >= zone->count) {
+        return 0;
+    }
+
+    buddy_frame_t* f = &zone->frames[pfn - zone->base_pfn];
+    if (f->shares == 0xFFFF) {
+        return 0;
+    }
+    f->shares++;
+    return f->shares + 1u;
+}
+
+uint32_t buddy_frame_put(buddy_zone_t* zone, uint32_t pfn) {
+    if (pfn < zone->base_pfn || pfn - zone->base_pfn >= zone->count) {
+        return 0;
+    }
+
+    buddy_frame_t* f = &zone->frames[pfn - zone->base_pfn];
+    if (f->shares) {
+        f->shares--;
+        return f->shares + 1u;
+    }
+
+    /* Last reference: only a one-frame allocation can go on its own */
+    if (f->state == BUDDY_STATE_BLOCK ||
+        (f->state == BUDDY_STATE_CONTIG && f->next == 1)) {
+        buddy_free(zone, pfn);
+    }
+    return 0;
+}
+
+int buddy_frame_exclusive(const buddy_zone_t* zone, uint32_t pfn) {
+    if (pfn < zone->base_pfn || pfn - zone->base_pfn >= zone->count) {
+        return 0;
+    }
+
+    const buddy_frame_t* f = &zone->frames[pfn - zone->base_pfn];
+    return f->shares == 0 &&
+           (f->state == BUDDY_STATE_BLOCK ||
+            (f->state == BUDDY_STATE_CONTIG && f->next == 1));
+}
+
+void buddy_get_stats(const buddy_zone_t* zone, buddy_stats_t* stats) {
+    if (!zone || !stats) {
+        return;
+    }
+
+    stats->managed_frames = zone->managed_frames;
+    stats->free_frames = zone->free_frames;
+    stats->allocs = zone->allocs;
+    stats->frees = zone->frees;
+    stats->splits = zone->splits;
+    stats->merges = zone->merges;
+    stats->failed = zone->failed;
+    stats->largest_free_order = BUDDY_INVALID;
+
+    uint32_t below = 0;
+    for (uint32_t o = 0; o < BUDDY_NUM_ORDERS; o++) {
+        stats->free_blocks[o] = zone->free_blocks[o];
+        if (zone->free_blocks[o]) {
+            stats->largest_free_order = o;
+        }
+        stats->unusable_index[o] = zone->free_frames ?
+            (uint32_t)((uint64_t)below * 1000 / zone->free_frames) : 1000;
+        below += zone->free_blocks[o] << o;
+    }
+}
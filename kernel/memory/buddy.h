@@ -0,0 +1,166 @@
+/**
+ * Aurora OS - Buddy Frame Allocator Header
+ *
+ * Binary buddy allocator over a range of physical page frames, with
+ * per-order free lists for orders 0 (one frame) to BUDDY_MAX_ORDER
+ * (1024 frames, 4 MB).
+ */
+
+#ifndef AURORA_BUDDY_H
+#define AURORA_BUDDY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Largest block order: 2^10 frames */
+#define BUDDY_MAX_ORDER     10
+#define BUDDY_NUM_ORDERS    (BUDDY_MAX_ORDER + 1)
+
+/* Returned by the allocation functions on failure */
+#define BUDDY_INVALID       0xFFFFFFFFu
+
+/**
+ * Per-frame metadata, one entry per frame in the zone
+ * While a block is free its head frame links the order's free list;
+ * while allocated the links are unused (a contiguous allocation keeps
+ * its frame count in next). shares counts mappings of an allocated frame
+ * beyond its owner's, for copy-on-write sharing.
+ */
+typedef struct {
+    uint32_t next;
+    uint32_t prev;
+    uint8_t state;
+    uint16_t shares;
+} buddy_frame_t;
+
+/* Zone of frames managed by one allocator instance */
+typedef struct {
+    buddy_frame_t* frames;
+    uint32_t base_pfn;                      /* First frame number */
+    uint32_t count;                         /* Frames covered */
+    uint32_t free_head[BUDDY_NUM_ORDERS];   /* Per-order free lists (zone-relative) */
+    uint32_t free_blocks[BUDDY_NUM_ORDERS];
+    uint32_t free_frames;
+    uint32_t managed_frames;                /* Frames ever added as free */
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t splits;
+    uint64_t merges;
+    uint64_t failed;
+} buddy_zone_t;
+
+/* Allocator statistics */
+typedef struct {
+    uint32_t managed_frames;
+    uint32_t free_frames;
+    uint32_t free_blocks[BUDDY_NUM_ORDERS];
+    uint32_t largest_free_order;            /* BUDDY_INVALID if nothing is free */
+    uint32_t unusable_index[BUDDY_NUM_ORDERS];  /* Per mille of free frames unusable at each order */
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t splits;
+    uint64_t merges;
+    uint64_t failed;
+} buddy_stats_t;
+
+/**
+ * Initialize a zone with every frame reserved
+ * @param zone Zone to initialize
+ * @param frames Metadata array with count entries
+ * @param base_pfn First frame number, aligned to 2^BUDDY_MAX_ORDER so
+ *        blocks are naturally aligned in physical memory
+ * @param count Number of frames
+ * @return 0 on success, -1 on invalid arguments
+ */
+int buddy_init(buddy_zone_t* zone, buddy_frame_t* frames, uint32_t base_pfn, uint32_t count);
+
+/**
+ * Hand a range of frames to the allocator (usable RAM at boot)
+ * @param zone Zone
+ * @param pfn First frame number
+ * @param count Number of frames; clipped to the zone
+ */
+void buddy_add_range(buddy_zone_t* zone, uint32_t pfn, uint32_t count);
+
+/**
+ * Allocate a naturally aligned block of 2^order frames
+ * @param zone Zone
+ * @param order Block order (0 .. BUDDY_MAX_ORDER)
+ * @return First frame number, or BUDDY_INVALID
+ */
+uint32_t buddy_alloc(buddy_zone_t* zone, uint32_t order);
+
+/**
+ * Allocate physically contiguous frames (DMA buffers, framebuffers)
+ * Up to 2^BUDDY_MAX_ORDER frames, the range starts on a boundary of the
+ * next power of two and the unused tail of that block is returned to the
+ * allocator. Larger requests are served from adjacent free max-order
+ * blocks.
+ * @param zone Zone
+ * @param count Number of frames
+ * @return First frame number, or BUDDY_INVALID
+ */
+uint32_t buddy_alloc_contig(buddy_zone_t* zone, uint32_t count);
+
+/**
+ * Free a block from buddy_alloc() or a range from buddy_alloc_contig()
+ * @param zone Zone
+ * @param pfn First frame number as returned by the allocation
+ * @return 0 on success, -1 if pfn is not the start of a live allocation
+ */
+int buddy_free(buddy_zone_t* zone, uint32_t pfn);
+
+/**
+ * Size of a live allocation
+ * @param zone Zone
+ * @param pfn First frame number as returned by the allocation
+ * @return Frames in the allocation, 0 if pfn does not start one
+ */
+uint32_t buddy_allocation_frames(const buddy_zone_t* zone, uint32_t pfn);
+
+/**
+ * References to an allocated frame (its owner plus any shares)
+ * @param zone Zone
+ * @param pfn Frame number
+ * @return Reference count, 0 if pfn is outside the zone
+ */
+uint32_t buddy_frame_refs(const buddy_zone_t* zone, uint32_t pfn);
+
+/**
+ * Take an extra reference to an allocated frame
+ * @param zone Zone
+ * @param pfn Frame number
+ * @return New reference count, 0 if pfn is outside the zone or the count
+ *         is saturated (the caller must copy instead of sharing)
+ */
+uint32_t buddy_frame_get(buddy_zone_t* zone, uint32_t pfn);
+
+/**
+ * Drop a reference to an allocated frame
+ * Dropping the last reference frees the frame if it is a one-frame
+ * allocation; frames inside larger allocations stay with their owner.
+ * @param zone Zone
+ * @param pfn Frame number
+ * @return Remaining reference count
+ */
+uint32_t buddy_frame_put(buddy_zone_t* zone, uint32_t pfn);
+
+/**
+ * Check whether dropping one reference would free a frame
+ * True for a one-frame allocation with no shares.
+ * @param zone Zone
+ * @param pfn Frame number
+ * @return Nonzero if the frame is exclusively owned
+ */
+int buddy_frame_exclusive(const buddy_zone_t* zone, uint32_t pfn);
+
+/**
+ * Get allocator and fragmentation statistics
+ * unusable_index[k] is the share of free frames in blocks smaller than
+ * order k, i.e. free memory that cannot satisfy an order-k request.
+ * @param zone Zone
+ * @param stats Output statistics
+ */
+void buddy_get_stats(const buddy_zone_t* zone, buddy_stats_t* stats);
+
+#endif /* AURORA_BUDDY_H */
@@ -0,0 +1,391 @@
+/**
+ * Aurora OS - Per-CPU Magazine Layer
+ *
+ * Bonwick's magazine scheme (Bonwick & Adams, "Magazines and Vmem",
+ * USENIX 2001). Each CPU holds, per size class, a loaded and a previous
+ * magazine - small stacks of free objects:
+ *
+ *  - alloc pops from loaded; if empty and previous is full, the two swap
+ *  - free pushes onto loaded; if full and previous is empty, they swap
+ *  - only when both are unusable does the CPU visit the class's depot,
+ *    trading a magazine for a full one (alloc) or an empty one (free)
+ *  - only when the depot has nothing suitable does the request reach the
+ *    slab layer, which is serialized by slab_lock (a queued spinlock, as
+ *    it is the one lock all CPUs can pile up on)
+ *
+ * The swap rule guarantees at least a magazine's worth of operations
+ * between depot visits, so the depot and slab locks stay off the common
+ * path. Each CPU's state sits behind its own lock in its own cache line;
+ * the lock is only ever contended by a drain. Every entry point runs with
+ * interrupts off, so an interrupt-time kmalloc can't find its own CPU's
+ * lock (or a depot or slab_lock) held by the code it interrupted.
+ *
+ * Lock order: CPU cache -> depot -> slab.
+ *
+ * A free must name the start of a live object. Objects parked in
+ * magazines are still allocated as far as the slab layer is concerned,
+ * so besides its check, a free is looked for in the CPU's own two
+ * magazines; a double free of an object parked in the depot or on
+ * another CPU goes unnoticed.
+ */
+
+#include "magazine.h"
+#include "../smp/smp.h"
+
+typedef struct magazine {
+    struct magazine* next;      /* Depot list link */
+    uint32_t rounds;            /* Objects held */
+    uint32_t capacity;
+    void* objects[];
+} magazine_t;
+
+typedef struct {
+    magazine_t* loaded;
+    magazine_t* previous;
+} cpu_class_t;
+
+typedef struct {
+    spinlock_t lock;
+    cpu_class_t classes[SLAB_NUM_CLASSES];
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t exchanges;
+    uint64_t slab_allocs;
+    uint64_t slab_frees;
+    uint64_t drains;
+    uint64_t double_frees;
+} __attribute__((aligned(64))) cpu_cache_t;
+
+typedef struct {
+    spinlock_t lock;
+    magazine_t* full;
+    magazine_t* empty;
+    uint32_t nfull;
+    uint32_t nempty;
+} __attribute__((aligned(64))) depot_t;
+
+static cpu_cache_t cpu_caches[MAX_CPUS];
+static depot_t depots[SLAB_NUM_CLASSES];
+static qspinlock_t slab_lock;
+
+/* Magazine capacity and the slab class its storage comes from */
+static uint32_t mag_rounds[SLAB_NUM_CLASSES];
+static int mag_class[SLAB_NUM_CLASSES];
+
+static inline cpu_cache_t* current_cache(void) {
+    uint32_t cpu = smp_get_current_cpu_id();
+    return &cpu_caches[cpu < MAX_CPUS ? cpu : 0];
+}
+
+static void* slab_get(uint32_t cls) {
+    qspinlock_acquire(&slab_lock);
+    void* obj = slab_alloc_class(cls);
+    qspinlock_release(&slab_lock);
+    return obj;
+}
+
+static void slab_put(void* obj) {
+    qspinlock_acquire(&slab_lock);
+    slab_free(obj);
+    qspinlock_release(&slab_lock);
+}
+
+/**
+ * Return a magazine's objects to the slab layer
+ */
+static uint32_t magazine_empty_out(magazine_t* mag) {
+    uint32_t n = mag->rounds;
+    qspinlock_acquire(&slab_lock);
+    for (uint32_t i = 0; i < n; i++) {
+        slab_free(mag->objects[i]);
+    }
+    qspinlock_release(&slab_lock);
+    mag->rounds = 0;
+    return n;
+}
+
+static int magazine_holds(const magazine_t* mag, const void* obj) {
+    if (mag) {
+        for (uint32_t i = 0; i < mag->rounds; i++) {
+            if (mag->objects[i] == obj) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+void magazine_init(void) {
+    qspinlock_init(&slab_lock);
+
+    for (uint32_t c = 0; c < SLAB_NUM_CLASSES; c++) {
+        /* Fewer rounds for big objects so magazines don't hoard memory */
+        uint32_t size = slab_class_size(c);
+        mag_rounds[c] = size <= 256 ? 30 : (size <= 1024 ? 14 : 6);
+        mag_class[c] = slab_size_class(sizeof(magazine_t) + mag_rounds[c] * sizeof(void*));
+
+        spinlock_init(&depots[c].lock);
+        depots[c].full = NULL;
+        depots[c].empty = NULL;
+        depots[c].nfull = 0;
+        depots[c].nempty = 0;
+    }
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        cpu_cache_t* cc = &cpu_caches[cpu];
+        spinlock_init(&cc->lock);
+        for (uint32_t c = 0; c < SLAB_NUM_CLASSES; c++) {
+            cc->classes[c].loaded = NULL;
+            cc->classes[c].previous = NULL;
+        }
+        cc->allocs = 0;
+        cc->frees = 0;
+        cc->exchanges = 0;
+        cc->slab_allocs = 0;
+        cc->slab_frees = 0;
+        cc->drains = 0;
+        cc->double_frees = 0;
+    }
+}
+
+static void* cache_alloc(size_t size) {
+    int cls = slab_size_class(size);
+    if (cls < 0) {
+        if (size == 0) {
+            return NULL;
+        }
+        qspinlock_acquire(&slab_lock);
+        void* ptr = slab_alloc(size);
+        qspinlock_release(&slab_lock);
+        return ptr;
+    }
+
+    cpu_cache_t* cc = current_cache();
+    cpu_class_t* c = &cc->classes[cls];
+    spinlock_acquire(&cc->lock);
+
+    for (;;) {
+        magazine_t* mag = c->loaded;
+        if (mag && mag->rounds) {
+            void* obj = mag->objects[--mag->rounds];
+            cc->allocs++;
+            spinlock_release(&cc->lock);
+            return obj;
+        }
+
+        if (c->previous && c->previous->rounds) {
+            c->loaded = c->previous;
+            c->previous = mag;
+            continue;
+        }
+
+        /* Both empty: trade previous for a full magazine from the depot */
+        depot_t* d = &depots[cls];
+        spinlock_acquire(&d->lock);
+        magazine_t* full = d->full;
+        if (full) {
+            d->full = full->next;
+            d->nfull--;
+            if (c->previous) {
+                c->previous->next = d->empty;
+                d->empty = c->previous;
+                d->nempty++;
+            }
+        }
+        spinlock_release(&d->lock);
+
+        if (!full) {
+            break;
+        }
+        c->previous = c->loaded;
+        c->loaded = full;
+        cc->exchanges++;
+    }
+
+    cc->slab_allocs++;
+    spinlock_release(&cc->lock);
+    return slab_get((uint32_t)cls);
+}
+
+static void cache_free(void* ptr) {
+    /* Page runs, or garbage that slab_free() rejects */
+    int cls = slab_object_class(ptr);
+    if (cls < 0) {
+        slab_put(ptr);
+        return;
+    }
+
+    cpu_cache_t* cc = current_cache();
+    cpu_class_t* c = &cc->classes[cls];
+    spinlock_acquire(&cc->lock);
+
+    if (magazine_holds(c->loaded, ptr) || magazine_holds(c->previous, ptr)) {
+        cc->double_frees++;
+        spinlock_release(&cc->lock);
+        return;
+    }
+
+    for (;;) {
+        magazine_t* mag = c->loaded;
+        if (mag && mag->rounds < mag->capacity) {
+            mag->objects[mag->rounds++] = ptr;
+            cc->frees++;
+            spinlock_release(&cc->lock);
+            return;
+        }
+
+        if (c->previous && c->previous->rounds == 0) {
+            c->loaded = c->previous;
+            c->previous = mag;
+            continue;
+        }
+
+        /* Both full (or missing): trade previous for an empty magazine */
+        depot_t* d = &depots[cls];
+        spinlock_acquire(&d->lock);
+        magazine_t* empty = d->empty;
+        if (empty) {
+            d->empty = empty->next;
+            d->nempty--;
+        }
+        spinlock_release(&d->lock);
+
+        if (!empty) {
+            empty = (magazine_t*)slab_get((uint32_t)mag_class[cls]);
+            if (!empty) {
+                break;
+            }
+            empty->rounds = 0;
+            empty->capacity = mag_rounds[cls];
+        }
+
+        if (c->previous) {
+            spinlock_acquire(&d->lock);
+            c->previous->next = d->full;
+            d->full = c->previous;
+            d->nfull++;
+            spinlock_release(&d->lock);
+        }
+        c->previous = c->loaded;
+        c->loaded = empty;
+        cc->exchanges++;
+    }
+
+    /* No magazine to be had: free straight to the slab layer */
+    cc->slab_frees++;
+    spinlock_release(&cc->lock);
+    slab_put(ptr);
+}
+
+void* magazine_alloc(size_t size) {
+    irqflags_t flags = local_irq_save();
+    void* obj = cache_alloc(size);
+    local_irq_restore(flags);
+    return obj;
+}
+
+void magazine_free(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    irqflags_t flags = local_irq_save();
+    cache_free(ptr);
+    local_irq_restore(flags);
+}
+
+void magazine_drain_cpu(uint32_t cpu_id) {
+    if (cpu_id >= MAX_CPUS) {
+        return;
+    }
+
+    cpu_cache_t* cc = &cpu_caches[cpu_id];
+    irqflags_t flags = local_irq_save();
+    spinlock_acquire(&cc->lock);
+
+    for (uint32_t cls = 0; cls < SLAB_NUM_CLASSES; cls++) {
+        cpu_class_t* c = &cc->classes[cls];
+        magazine_t* mags[2] = { c->loaded, c->previous };
+        c->loaded = NULL;
+        c->previous = NULL;
+
+        depot_t* d = &depots[cls];
+        for (uint32_t i = 0; i < 2; i++) {
+            if (!mags[i]) {
+                continue;
+            }
+            magazine_empty_out(mags[i]);
+            spinlock_acquire(&d->lock);
+            mags[i]->next = d->empty;
+            d->empty = mags[i];
+            d->nempty++;
+            spinlock_release(&d->lock);
+        }
+    }
+
+    cc->drains++;
+    spinlock_release(&cc->lock);
+    local_irq_restore(flags);
+}
+
+uint32_t magazine_reap(void) {
+    uint32_t objects = 0;
+    irqflags_t flags = local_irq_save();
+
+    for (uint32_t cls = 0; cls < SLAB_NUM_CLASSES; cls++) {
+        depot_t* d = &depots[cls];
+        spinlock_acquire(&d->lock);
+        magazine_t* full = d->full;
+        magazine_t* empty = d->empty;
+        d->full = NULL;
+        d->empty = NULL;
+        d->nfull = 0;
+        d->nempty = 0;
+        spinlock_release(&d->lock);
+
+        while (full) {
+            magazine_t* next = full->next;
+            objects += magazine_empty_out(full);
+            slab_put(full);
+            full = next;
+        }
+        while (empty) {
+            magazine_t* next = empty->next;
+            slab_put(empty);
+            empty = next;
+        }
+    }
+
+    local_irq_restore(flags);
+    return objects;
+}
+
+void magazine_get_stats(magazine_stats_t* stats) {
+    if (!stats) {
+        return;
+    }
+
+    stats->cpu_allocs = 0;
+    stats->cpu_frees = 0;
+    stats->depot_exchanges = 0;
+    stats->slab_allocs = 0;
+    stats->slab_frees = 0;
+    stats->drains = 0;
+    stats->double_frees = 0;
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        const cpu_cache_t* cc = &cpu_caches[cpu];
+        stats->cpu_allocs += cc->allocs;
+        stats->cpu_frees += cc->frees;
+        stats->depot_exchanges += cc->exchanges;
+        stats->slab_allocs += cc->slab_allocs;
+        stats->slab_frees += cc->slab_frees;
+        stats->drains += cc->drains;
+        stats->double_frees += cc->double_frees;
+    }
+
+    for (uint32_t cls = 0; cls < SLAB_NUM_CLASSES; cls++) {
+        stats->depot_full[cls] = depots[cls].nfull;
+        stats->depot_empty[cls] = depots[cls].nempty;
+        stats->magazine_rounds[cls] = mag_rounds[cls];
+    }
+}
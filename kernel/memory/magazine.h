@@ -0,0 +1,70 @@
+/**
+ * Aurora OS - Per-CPU Magazine Layer Header
+ *
+ * Bonwick-style per-CPU object caches in front of the slab allocator.
+ * kmalloc/kfree go through this layer; the slab allocator itself runs
+ * under a single lock that the common alloc/free path never takes.
+ */
+
+#ifndef AURORA_MAGAZINE_H
+#define AURORA_MAGAZINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "slab.h"
+
+/* Layer statistics, summed over CPUs */
+typedef struct {
+    uint64_t cpu_allocs;            /* Allocations served by a CPU's magazines */
+    uint64_t cpu_frees;             /* Frees absorbed by a CPU's magazines */
+    uint64_t depot_exchanges;       /* Magazine swaps with the depot */
+    uint64_t slab_allocs;           /* Misses that went to the slab layer */
+    uint64_t slab_frees;
+    uint64_t drains;                /* CPU drains (halt or explicit) */
+    uint64_t double_frees;          /* Frees of objects already in the CPU's magazines */
+    uint32_t depot_full[SLAB_NUM_CLASSES];
+    uint32_t depot_empty[SLAB_NUM_CLASSES];
+    uint32_t magazine_rounds[SLAB_NUM_CLASSES];     /* Capacity per class */
+} magazine_stats_t;
+
+/**
+ * Initialize the magazine layer
+ * Call after slab_init(); all CPUs start with empty magazines.
+ */
+void magazine_init(void);
+
+/**
+ * Allocate memory through the current CPU's magazines
+ * @param size Requested size in bytes
+ * @return Memory, or NULL for size 0 or when memory is exhausted
+ */
+void* magazine_alloc(size_t size);
+
+/**
+ * Free memory through the current CPU's magazines
+ * Interior pointers and frees of freed objects are ignored.
+ * @param ptr Memory from magazine_alloc() (NULL is ignored)
+ */
+void magazine_free(void* ptr);
+
+/**
+ * Return a CPU's cached objects to the slab layer
+ * Must not race with allocations on that CPU (it is halted or the
+ * caller is that CPU).
+ * @param cpu_id CPU index
+ */
+void magazine_drain_cpu(uint32_t cpu_id);
+
+/**
+ * Return the depot's cached objects and spare magazines to the slab layer
+ * @return Number of objects returned
+ */
+uint32_t magazine_reap(void);
+
+/**
+ * Get layer statistics
+ * @param stats Output statistics
+ */
+void magazine_get_stats(magazine_stats_t* stats);
+
+#endif /* AURORA_MAGAZINE_H */
@@ -5,116 +5,66 @@
  */
 
 #include "memory.h"
+#include "slab.h"
+#include "magazine.h"
+#include "swap.h"
+#include "paging.h"
 
 /* Memory heap boundaries */
 #define HEAP_START 0x00100000  /* 1 MB */
 #define HEAP_SIZE  0x00100000  /* 1 MB heap size */
 #define HEAP_END   (HEAP_START + HEAP_SIZE)
 
-/* Page frame bitmap for physical memory management */
-#define MAX_FRAMES 1024
-static uint32_t frame_bitmap[MAX_FRAMES / 32];
+/* Physical frames managed by the buddy allocator: the first 64 MB, so
+ * that 4 MB-aligned runs exist for large-page vm_alloc() */
+#define MAX_FRAMES 16384
+static buddy_frame_t frame_meta[MAX_FRAMES];
+static buddy_zone_t frame_zone;
 
-/* Memory block structure for heap allocation */
-typedef struct mem_block {
-    size_t size;
-    int free;
-    struct mem_block* next;
-} mem_block_t;
+/* End of the kernel image, from the linker script */
+extern char kernel_end[];
 
 /* Heap management */
-static mem_block_t* heap_start = NULL;
 static uint32_t heap_initialized = 0;
 
-/**
- * Mark a frame as used
- */
-static void set_frame(uint32_t frame_addr) {
-    uint32_t frame = frame_addr / PAGE_SIZE;
-    uint32_t idx = frame / 32;
-    uint32_t off = frame % 32;
-    frame_bitmap[idx] |= (1 << off);
-}
-
-/**
- * Mark a frame as free
- */
-static void clear_frame(uint32_t frame_addr) {
-    uint32_t frame = frame_addr / PAGE_SIZE;
-    uint32_t idx = frame / 32;
-    uint32_t off = frame % 32;
-    frame_bitmap[idx] &= ~(1 << off);
+static inline void* frame_address(uint32_t pfn) {
+    return (void*)((uintptr_t)pfn * PAGE_SIZE);
 }
 
-/**
- * Test if a frame is allocated
- */
-static uint32_t test_frame(uint32_t frame_addr) {
-    uint32_t frame = frame_addr / PAGE_SIZE;
-    uint32_t idx = frame / 32;
-    uint32_t off = frame % 32;
-    return (frame_bitmap[idx] & (1 << off));
-}
-
-/**
- * Find first free frame
- */
-static uint32_t first_free_frame(void) {
-    for (uint32_t i = 0; i < MAX_FRAMES / 32; i++) {
-        if (frame_bitmap[i] != 0xFFFFFFFF) {
-            for (uint32_t j = 0; j < 32; j++) {
-                uint32_t to_test = 1 << j;
-                if (!(frame_bitmap[i] & to_test)) {
-                    return i * 32 + j;
-                }
-            }
-        }
-    }
-    return (uint32_t)-1;
-}
-
-/**
- * Allocate a physical frame
- */
-static void* alloc_frame(void) {
-    uint32_t frame = first_free_frame();
-    if (frame == (uint32_t)-1) {
-        return NULL;
+static void zero_frames(void* addr, uint32_t count) {
+    uint64_t* p = (uint64_t*)addr;
+    size_t words = (size_t)count * (PAGE_SIZE / sizeof(uint64_t));
+    for (size_t i = 0; i < words; i++) {
+        p[i] = 0;
     }
-    set_frame(frame * PAGE_SIZE);
-    return (void*)(frame * PAGE_SIZE);
-}
-
-/**
- * Free a physical frame
- */
-static void free_frame(void* frame_addr) {
-    clear_frame((uint32_t)frame_addr);
 }
 
 /**
  * Initialize heap allocator
+ * The heap region is handed to the slab allocator, which serves small
+ * requests from size-class slabs and larger ones from page runs. The
+ * per-CPU magazine layer sits in front of it.
  */
 static void heap_init(void) {
-    heap_start = (mem_block_t*)HEAP_START;
-    heap_start->size = HEAP_SIZE - sizeof(mem_block_t);
-    heap_start->free = 1;
-    heap_start->next = NULL;
-    heap_initialized = 1;
+    heap_initialized = (slab_init((void*)HEAP_START, HEAP_SIZE) == 0);
+    if (heap_initialized) {
+        magazine_init();
+    }
 }
 
 /**
  * Initialize memory management subsystem
  */
 void memory_init(void) {
-    /* Initialize page frame allocator */
-    for (uint32_t i = 0; i < MAX_FRAMES / 32; i++) {
-        frame_bitmap[i] = 0;
+    /* Initialize page frame allocator: everything above the heap and
+     * the kernel image (its .bss included) is usable */
+    uint32_t first = (uint32_t)(((uintptr_t)kernel_end + PAGE_SIZE - 1) / PAGE_SIZE);
+    if (first < HEAP_END / PAGE_SIZE) {
+        first = HEAP_END / PAGE_SIZE;
     }
-    
-    /* Mark kernel memory as used (first 1 MB) */
-    for (uint32_t i = 0; i < 0x100000; i += PAGE_SIZE) {
-        set_frame(i);
+    buddy_init(&frame_zone, frame_meta, 0, MAX_FRAMES);
+    if (first < MAX_FRAMES) {
+        buddy_add_range(&frame_zone, first, MAX_FRAMES - first);
     }
     
     /* Initialize heap allocator */
@@ -129,36 +79,7 @@ void* kmalloc(size_t size) {
         return NULL;
     }
     
-    if (size == 0) {
-        return NULL;
-    }
-    
-    /* Align size to 8 bytes */
-    size = (size + 7) & ~7;
-    
-    mem_block_t* current = heap_start;
-    
-    /* First-fit allocation */
-    while (current) {
-        if (current->free && current->size >= size) {
-            /* Check if we should split the block */
-            if (current->size >= size + sizeof(mem_block_t) + 8) {
-                mem_block_t* new_block = (mem_block_t*)((uint8_t*)current + sizeof(mem_block_t) + size);
-                new_block->size = current->size - size - sizeof(mem_block_t);
-                new_block->free = 1;
-                new_block->next = current->next;
-                
-                current->size = size;
-                current->next = new_block;
-            }
-            
-            current->free = 0;
-            return (void*)((uint8_t*)current + sizeof(mem_block_t));
-        }
-        current = current->next;
-    }
-    
-    return NULL;
+    return magazine_alloc(size);
 }
 
 /**
@@ -169,50 +90,110 @@ void kfree(void* ptr) {
         return;
     }
     
-    mem_block_t* block = (mem_block_t*)((uint8_t*)ptr - sizeof(mem_block_t));
-    block->free = 1;
-    
-    /* Coalesce with next block if it's free */
-    if (block->next && block->next->free) {
-        block->size += sizeof(mem_block_t) + block->next->size;
-        block->next = block->next->next;
+    magazine_free(ptr);
+}
+
+/**
+ * Allocate a naturally aligned block of 2^order physical frames
+ */
+void* frame_alloc(uint32_t order) {
+    swap_pressure(frame_zone.free_frames, 1u << order);
+    uint32_t pfn = buddy_alloc(&frame_zone, order);
+    if (pfn == BUDDY_INVALID && swap_direct_reclaim(1u << order)) {
+        pfn = buddy_alloc(&frame_zone, order);
     }
-    
-    /* Coalesce with previous block if it's free */
-    mem_block_t* current = heap_start;
-    while (current && current->next != block) {
-        current = current->next;
+    return pfn == BUDDY_INVALID ? NULL : frame_address(pfn);
+}
+
+/**
+ * Allocate physically contiguous frames for DMA
+ */
+void* frame_alloc_contig(uint32_t count) {
+    swap_pressure(frame_zone.free_frames, count);
+    uint32_t pfn = buddy_alloc_contig(&frame_zone, count);
+    if (pfn == BUDDY_INVALID && swap_direct_reclaim(count)) {
+        pfn = buddy_alloc_contig(&frame_zone, count);
     }
-    
-    if (current && current->free) {
-        current->size += sizeof(mem_block_t) + block->size;
-        current->next = block->next;
+    return pfn == BUDDY_INVALID ? NULL : frame_address(pfn);
+}
+
+/**
+ * Free frames from frame_alloc(), frame_alloc_contig() or vm_alloc()
+ */
+int frame_free(void* addr) {
+    if ((uintptr_t)addr & (PAGE_SIZE - 1)) {
+        return -1;
     }
+    return buddy_free(&frame_zone, (uint32_t)((uintptr_t)addr / PAGE_SIZE));
+}
+
+/**
+ * Take an extra reference to a frame shared between mappings
+ */
+uint32_t frame_get(uint32_t phys_addr) {
+    return buddy_frame_get(&frame_zone, phys_addr / PAGE_SIZE);
+}
+
+/**
+ * Drop a frame reference, freeing a single-frame allocation on the last
+ */
+uint32_t frame_put(uint32_t phys_addr) {
+    return buddy_frame_put(&frame_zone, phys_addr / PAGE_SIZE);
+}
+
+/**
+ * Get the number of references to a frame
+ */
+uint32_t frame_refcount(uint32_t phys_addr) {
+    return buddy_frame_refs(&frame_zone, phys_addr / PAGE_SIZE);
+}
+
+/**
+ * Check whether a frame has a single owner and would be freed by frame_put()
+ */
+int frame_exclusive(uint32_t phys_addr) {
+    return buddy_frame_exclusive(&frame_zone, phys_addr / PAGE_SIZE);
+}
+
+/**
+ * Get physical frame allocator statistics
+ */
+void memory_get_frame_stats(buddy_stats_t* stats) {
+    buddy_get_stats(&frame_zone, stats);
 }
 
 /**
  * Virtual memory allocation
+ * Backed by one physically contiguous run of frames.
  */
 void* vm_alloc(size_t size, uint32_t flags) {
-    (void)flags; /* Unused for now */
+    if (size == 0 || size > (size_t)MAX_FRAMES * PAGE_SIZE) {
+        return NULL;
+    }
     
     /* Calculate number of pages needed */
-    uint32_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t pages = (uint32_t)((size + PAGE_SIZE - 1) / PAGE_SIZE);
     
-    /* Allocate physical frames */
-    void* first_frame = NULL;
-    for (uint32_t i = 0; i < pages; i++) {
-        void* frame = alloc_frame();
-        if (!frame) {
-            /* Allocation failed, clean up */
-            return NULL;
-        }
-        if (i == 0) {
-            first_frame = frame;
+    void* mem = frame_alloc_contig(pages);
+    if (!mem) {
+        return NULL;
+    }
+    
+    /* Runs of 4 MB or more are 4 MB aligned, above the kernel's 4 KB
+     * identity mapping; give each whole 4 MB of them a large page */
+    page_directory_t* dir = paging_get_kernel_directory();
+    if (dir) {
+        for (uint32_t i = 0; i + HUGE_PAGE_SIZE / PAGE_SIZE <= pages; i += HUGE_PAGE_SIZE / PAGE_SIZE) {
+            uint32_t addr = (uint32_t)(uintptr_t)mem + i * PAGE_SIZE;
+            paging_map_huge_page(dir, addr, addr, PAGE_PRESENT | PAGE_WRITE);
         }
     }
     
-    return first_frame;
+    if (flags & MEM_ZERO) {
+        zero_frames(mem, pages);
+    }
+    
+    return mem;
 }
 
 /**
@@ -223,6 +204,18 @@ void vm_free(void* ptr) {
         return;
     }
     
-    /* Free the frame */
-    free_frame(ptr);
+    /* Only the large pages vm_alloc() installed: never 4 KB entries,
+     * which may be someone else's mapping of the same addresses */
+    uint32_t pages = buddy_allocation_frames(&frame_zone, (uint32_t)((uintptr_t)ptr / PAGE_SIZE));
+    page_directory_t* dir = paging_get_kernel_directory();
+    if (dir) {
+        for (uint32_t i = 0; i + HUGE_PAGE_SIZE / PAGE_SIZE <= pages; i += HUGE_PAGE_SIZE / PAGE_SIZE) {
+            uint32_t addr = (uint32_t)(uintptr_t)ptr + i * PAGE_SIZE;
+            if (paging_get_physical_address(dir, addr) == addr) {
+                paging_unmap_huge_page(dir, addr);
+            }
+        }
+    }
+    
+    frame_free(ptr);
 }
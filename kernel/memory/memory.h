@@ -9,6 +9,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "buddy.h"
 
 /* Page size (4KB) */
 #define PAGE_SIZE 4096
@@ -23,6 +24,16 @@ void memory_init(void);
 void* kmalloc(size_t size);
 void kfree(void* ptr);
 
+/* Physical frame functions */
+void* frame_alloc(uint32_t order);
+void* frame_alloc_contig(uint32_t count);
+int frame_free(void* addr);
+uint32_t frame_get(uint32_t phys_addr);
+uint32_t frame_put(uint32_t phys_addr);
+uint32_t frame_refcount(uint32_t phys_addr);
+int frame_exclusive(uint32_t phys_addr);
+void memory_get_frame_stats(buddy_stats_t* stats);
+
 /* Virtual memory functions */
 void* vm_alloc(size_t size, uint32_t flags);
 void vm_free(void* ptr);
@@ -7,6 +7,7 @@
  */
 
 #include "memory_optimization.h"
+#include "slab.h"
 
 // Memory optimization configuration
 static memory_opt_config_t mem_opt = {
@@ -71,12 +72,18 @@ void memory_enable_defragmentation(void) {
 void memory_get_stats(memory_stats_t *stats) {
     if (!stats) return;
     
-    // In a real implementation, these would track actual allocations
-    // For now, provide placeholder values that indicate the system is operational
-    stats->total_allocations = 0;
-    stats->total_deallocations = 0;
-    stats->peak_usage = 0;
-    stats->fragmentation_ratio = 0;
+    slab_stats_t slab;
+    slab_get_stats(&slab);
+    
+    stats->total_allocations = slab.allocs;
+    stats->total_deallocations = slab.frees;
+    stats->peak_usage = slab.peak_bytes_in_use;
     
-    // Stats would be updated by the actual allocator during runtime
+    // External fragmentation in percent: share of free pages that lie
+    // outside the largest free run
+    stats->fragmentation_ratio = 0;
+    if (slab.free_pages) {
+        stats->fragmentation_ratio =
+            100 - (slab.largest_free_run * 100) / slab.free_pages;
+    }
 }
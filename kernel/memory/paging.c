@@ -7,19 +7,28 @@
 
 #include "paging.h"
 #include "memory.h"
+#include "swap.h"
 #include <stddef.h>
 
 /* Current page directory */
 static page_directory_t* kernel_directory = NULL;
 static page_directory_t* current_directory = NULL;
 
-/* Page swap storage (simplified - in real OS this would be disk) */
-#define SWAP_PAGES 256
-static struct {
-    uint32_t virt_addr;
-    uint8_t data[PAGE_SIZE];
-    int used;
-} swap_storage[SWAP_PAGES];
+/* Copy-on-write statistics */
+static paging_cow_stats_t cow_stats;
+
+/* Large page statistics */
+static paging_huge_stats_t huge_stats;
+
+/* Address spaces scanned by the reclaimer, and the CLOCK hand over them */
+static page_directory_t* reclaim_spaces[PAGING_MAX_SPACES];
+static uint32_t reclaim_space_count = 0;
+static uint32_t clock_space = 0;
+static uint32_t clock_vpn = 0;
+static paging_reclaim_stats_t reclaim_stats;
+
+/* PTE bits kept in a swap entry */
+#define SWAP_ENTRY_FLAGS (PAGE_WRITE | PAGE_USER | PAGE_COW)
 
 /**
  * Get page table index from virtual address
@@ -35,6 +44,128 @@ static inline uint32_t get_page_directory_index(uint32_t virt_addr) {
     return (virt_addr >> 22) & 0x3FF;
 }
 
+/**
+ * Page table referenced by a directory entry
+ */
+static inline page_table_t* pde_table(uint32_t pde) {
+    return (page_table_t*)(uintptr_t)(pde & ~0xFFF);
+}
+
+/**
+ * Check whether a directory entry maps a 4 MB page rather than a table
+ */
+static inline int pde_is_huge(uint32_t pde) {
+    return (pde & (PAGE_PRESENT | PAGE_HUGE)) == (PAGE_PRESENT | PAGE_HUGE);
+}
+
+/**
+ * Check whether a directory entry references a page table
+ */
+static inline int pde_has_table(uint32_t pde) {
+    return (pde & (PAGE_PRESENT | PAGE_HUGE)) == PAGE_PRESENT;
+}
+
+/**
+ * Flush one page's TLB entry
+ */
+static inline void tlb_flush_page(uint32_t virt_addr) {
+#ifndef AURORA_STANDALONE
+    __asm__ volatile("invlpg (%0)" : : "r"((uintptr_t)virt_addr) : "memory");
+#else
+    (void)virt_addr;
+#endif
+}
+
+/**
+ * Flush all non-global TLB entries by reloading CR3
+ */
+static inline void tlb_flush_all(void) {
+#ifndef AURORA_STANDALONE
+    uintptr_t cr3;
+    __asm__ volatile("mov %%cr3, %0" : "=r"(cr3));
+    __asm__ volatile("mov %0, %%cr3" : : "r"(cr3) : "memory");
+#endif
+}
+
+/**
+ * Copy one page, 64 bytes per iteration with SSE2-width vectors
+ */
+static void copy_page(void* dst, const void* src) {
+    typedef uint32_t vec_t __attribute__((vector_size(16), may_alias));
+    vec_t* d = (vec_t*)dst;
+    const vec_t* s = (const vec_t*)src;
+    for (uint32_t i = 0; i < PAGE_SIZE / sizeof(vec_t); i += 4) {
+        vec_t a = s[i];
+        vec_t b = s[i + 1];
+        vec_t c = s[i + 2];
+        vec_t e = s[i + 3];
+        d[i] = a;
+        d[i + 1] = b;
+        d[i + 2] = c;
+        d[i + 3] = e;
+    }
+}
+
+/**
+ * Check whether a directory entry is shared with the kernel directory
+ */
+static inline int is_kernel_table(page_directory_t* dir, uint32_t pd_index) {
+    return kernel_directory && dir != kernel_directory &&
+           ((*dir)[pd_index] & PAGE_PRESENT) &&
+           (*dir)[pd_index] == (*kernel_directory)[pd_index];
+}
+
+/**
+ * Check whether a non-present entry refers to a swap slot
+ */
+static inline int is_swap_entry(uint32_t pte) {
+    return (pte & (PAGE_PRESENT | PAGE_SWAPPED)) == PAGE_SWAPPED;
+}
+
+/**
+ * Build the swap entry for a page stored in slot
+ */
+static inline uint32_t make_swap_entry(uint32_t slot, uint32_t pte) {
+    return (slot << 12) | PAGE_SWAPPED | (pte & SWAP_ENTRY_FLAGS);
+}
+
+/**
+ * Look up the page table entry for an address
+ * @return Entry, or NULL if the page table is missing
+ */
+static uint32_t* lookup_pte(page_directory_t* dir, uint32_t virt_addr) {
+    uint32_t pde = (*dir)[get_page_directory_index(virt_addr)];
+    if (!pde_has_table(pde)) {
+        return NULL;
+    }
+    return &(*pde_table(pde))[get_page_table_index(virt_addr)];
+}
+
+/**
+ * Put an address space on the reclaim list
+ */
+static void track_space(page_directory_t* dir) {
+    if (reclaim_space_count < PAGING_MAX_SPACES) {
+        reclaim_spaces[reclaim_space_count++] = dir;
+    }
+}
+
+/**
+ * Take an address space off the reclaim list
+ */
+static void untrack_space(page_directory_t* dir) {
+    for (uint32_t i = 0; i < reclaim_space_count; i++) {
+        if (reclaim_spaces[i] != dir) {
+            continue;
+        }
+        reclaim_spaces[i] = reclaim_spaces[--reclaim_space_count];
+        if (clock_space == i) {
+            clock_vpn = 0;
+        }
+        return;
+    }
+}
+
 /**
  * Allocate a page table
  */
@@ -49,18 +180,37 @@ static page_table_t* alloc_page_table(void) {
 }
 
 /**
- * Initialize paging subsystem
+ * Replace a 4 MB page with a table of 1024 small pages mapping the same
+ * memory with the same permissions
  */
-void paging_init(void) {
-    /* Initialize swap storage */
-    for (uint32_t i = 0; i < SWAP_PAGES; i++) {
-        swap_storage[i].virt_addr = 0;
-        swap_storage[i].used = 0;
+static int split_huge_page(page_directory_t* dir, uint32_t pd_index) {
+    uint32_t pde = (*dir)[pd_index];
+    page_table_t* table = alloc_page_table();
+    if (!table) {
+        return -1;
+    }
+    
+    uint32_t base = pde & HUGE_PAGE_MASK;
+    uint32_t flags = pde & 0xFFF & ~PAGE_HUGE;
+    for (uint32_t i = 0; i < ENTRIES_PER_TABLE; i++) {
+        (*table)[i] = (base + i * PAGE_SIZE) | flags;
     }
     
-    /* Create kernel page directory */
+    (*dir)[pd_index] = (uint32_t)(uintptr_t)table | PAGE_PRESENT | PAGE_WRITE | PAGE_USER;
+    tlb_flush_page(pd_index << 22);
+    huge_stats.splits++;
+    
+    return 0;
+}
+
+/**
+ * Initialize paging subsystem
+ */
+void paging_init(void) {
+    /* Create kernel page directory; it has no user pages to reclaim */
     kernel_directory = paging_create_directory();
     current_directory = kernel_directory;
+    untrack_space(kernel_directory);
     
     /* Identity map first 4MB for kernel */
     for (uint32_t i = 0; i < 0x400000; i += PAGE_SIZE) {
@@ -77,12 +227,18 @@ void paging_enable(void) {
         return;
     }
     
-    /* Load page directory into CR3 - use 64-bit register for 64-bit mode */
-    uint64_t cr3_val = (uint64_t)(uintptr_t)current_directory;
+    /* Allow 4 MB pages (CR4.PSE) */
+    uintptr_t cr4;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= 0x10;
+    __asm__ volatile("mov %0, %%cr4" : : "r"(cr4) : "memory");
+    
+    /* Load page directory into CR3 - control registers are native width */
+    uintptr_t cr3_val = (uintptr_t)current_directory;
     __asm__ volatile("mov %0, %%cr3" : : "r"(cr3_val) : "memory");
     
     /* Enable paging by setting bit 31 in CR0 */
-    uint64_t cr0;
+    uintptr_t cr0;
     __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
     cr0 |= 0x80000000;
     __asm__ volatile("mov %0, %%cr0" : : "r"(cr0) : "memory");
@@ -117,6 +273,7 @@ page_directory_t* paging_create_directory(void) {
         (*dir)[i] = 0;
     }
     
+    track_space(dir);
     return dir;
 }
 
@@ -128,12 +285,26 @@ void paging_destroy_directory(page_directory_t* dir) {
         return;
     }
     
-    /* Free all page tables */
+    untrack_space(dir);
+    
+    /* Drop user page and swap slot references and free the directory's
+     * own tables; tables shared with the kernel directory stay, and large
+     * pages have no table */
     for (uint32_t i = 0; i < ENTRIES_PER_TABLE; i++) {
-        if ((*dir)[i] & PAGE_PRESENT) {
-            page_table_t* table = (page_table_t*)((*dir)[i] & ~0xFFF);
-            kfree(table);
+        if (!pde_has_table((*dir)[i]) || is_kernel_table(dir, i)) {
+            continue;
         }
+        
+        page_table_t* table = pde_table((*dir)[i]);
+        for (uint32_t j = 0; j < ENTRIES_PER_TABLE; j++) {
+            uint32_t pte = (*table)[j];
+            if ((pte & PAGE_PRESENT) && (pte & PAGE_USER)) {
+                frame_put(pte & ~0xFFF);
+            } else if (is_swap_entry(pte)) {
+                swap_slot_put(pte >> 12);
+            }
+        }
+        kfree(table);
     }
     
     kfree(dir);
@@ -148,7 +319,16 @@ void paging_switch_directory(page_directory_t* dir) {
     }
     
     current_directory = dir;
+#ifndef AURORA_STANDALONE
     __asm__ volatile("mov %0, %%cr3" : : "r"(dir));
+#endif
+}
+
+/**
+ * Get the kernel page directory
+ */
+page_directory_t* paging_get_kernel_directory(void) {
+    return kernel_directory;
 }
 
 /**
@@ -169,6 +349,11 @@ int paging_map_page(page_directory_t* dir, uint32_t virt_addr, uint32_t phys_add
     uint32_t pd_index = get_page_directory_index(virt_addr);
     uint32_t pt_index = get_page_table_index(virt_addr);
     
+    /* Mapping inside a large page breaks it up first */
+    if (pde_is_huge((*dir)[pd_index]) && split_huge_page(dir, pd_index) != 0) {
+        return -1;
+    }
+    
     /* Get or create page table */
     page_table_t* table;
     if (!((*dir)[pd_index] & PAGE_PRESENT)) {
@@ -176,16 +361,16 @@ int paging_map_page(page_directory_t* dir, uint32_t virt_addr, uint32_t phys_add
         if (!table) {
             return -1;
         }
-        (*dir)[pd_index] = ((uint32_t)table) | PAGE_PRESENT | PAGE_WRITE | PAGE_USER;
+        (*dir)[pd_index] = (uint32_t)(uintptr_t)table | PAGE_PRESENT | PAGE_WRITE | PAGE_USER;
     } else {
-        table = (page_table_t*)((*dir)[pd_index] & ~0xFFF);
+        table = pde_table((*dir)[pd_index]);
     }
     
     /* Map page */
     (*table)[pt_index] = (phys_addr & ~0xFFF) | (flags & 0xFFF);
     
     /* Flush TLB for this page */
-    __asm__ volatile("invlpg (%0)" : : "r"(virt_addr) : "memory");
+    tlb_flush_page(virt_addr);
     
     return 0;
 }
@@ -205,15 +390,136 @@ int paging_unmap_page(page_directory_t* dir, uint32_t virt_addr) {
         return -1;
     }
     
-    page_table_t* table = (page_table_t*)((*dir)[pd_index] & ~0xFFF);
+    /* Partial unmap of a large page: split, then drop the one entry */
+    if (pde_is_huge((*dir)[pd_index]) && split_huge_page(dir, pd_index) != 0) {
+        return -1;
+    }
+    
+    page_table_t* table = pde_table((*dir)[pd_index]);
+    if (is_swap_entry((*table)[pt_index])) {
+        swap_slot_put((*table)[pt_index] >> 12);
+    }
     (*table)[pt_index] = 0;
     
     /* Flush TLB for this page */
-    __asm__ volatile("invlpg (%0)" : : "r"(virt_addr) : "memory");
+    tlb_flush_page(virt_addr);
+    
+    return 0;
+}
+
+/**
+ * Map a 4 MB page
+ * Both addresses must be 4 MB aligned. An existing page table is only
+ * replaced if it maps nothing.
+ */
+int paging_map_huge_page(page_directory_t* dir, uint32_t virt_addr, uint32_t phys_addr, uint32_t flags) {
+    if (!dir || ((virt_addr | phys_addr) & (HUGE_PAGE_SIZE - 1))) {
+        return -1;
+    }
+    
+    uint32_t pd_index = get_page_directory_index(virt_addr);
+    uint32_t pde = (*dir)[pd_index];
+    if (pde_has_table(pde)) {
+        if (is_kernel_table(dir, pd_index)) {
+            return -1;
+        }
+        page_table_t* table = pde_table(pde);
+        for (uint32_t i = 0; i < ENTRIES_PER_TABLE; i++) {
+            if ((*table)[i]) {
+                return -1;
+            }
+        }
+        kfree(table);
+    }
+    
+    (*dir)[pd_index] = phys_addr | (flags & 0xFFF & ~PAGE_COW) | PAGE_HUGE;
+    tlb_flush_page(virt_addr);
+    huge_stats.huge_maps++;
     
     return 0;
 }
 
+/**
+ * Unmap a 4 MB page
+ */
+int paging_unmap_huge_page(page_directory_t* dir, uint32_t virt_addr) {
+    if (!dir || (virt_addr & (HUGE_PAGE_SIZE - 1))) {
+        return -1;
+    }
+    
+    uint32_t pd_index = get_page_directory_index(virt_addr);
+    if (!pde_is_huge((*dir)[pd_index])) {
+        return -1;
+    }
+    
+    (*dir)[pd_index] = 0;
+    tlb_flush_page(virt_addr);
+    huge_stats.huge_unmaps++;
+    
+    return 0;
+}
+
+/**
+ * Map a physically contiguous range
+ * Uses 4 MB pages wherever both addresses are 4 MB aligned and at least
+ * 4 MB remain, and 4 KB pages elsewhere.
+ */
+int paging_map_range(page_directory_t* dir, uint32_t virt_addr, uint32_t phys_addr,
+                     uint32_t size, uint32_t flags) {
+    if (!dir || ((virt_addr | phys_addr) & (PAGE_SIZE - 1))) {
+        return -1;
+    }
+    
+    uint64_t end = (uint64_t)virt_addr + size;
+    while (virt_addr < end) {
+        if (!((virt_addr | phys_addr) & (HUGE_PAGE_SIZE - 1)) && end - virt_addr >= HUGE_PAGE_SIZE &&
+            paging_map_huge_page(dir, virt_addr, phys_addr, flags) == 0) {
+            huge_stats.small_pages_saved += ENTRIES_PER_TABLE;
+            virt_addr += HUGE_PAGE_SIZE;
+            phys_addr += HUGE_PAGE_SIZE;
+            continue;
+        }
+        if (paging_map_page(dir, virt_addr, phys_addr, flags) != 0) {
+            return -1;
+        }
+        virt_addr += PAGE_SIZE;
+        phys_addr += PAGE_SIZE;
+    }
+    
+    return 0;
+}
+
+/**
+ * Unmap a range mapped with paging_map_range()
+ */
+int paging_unmap_range(page_directory_t* dir, uint32_t virt_addr, uint32_t size) {
+    if (!dir || (virt_addr & (PAGE_SIZE - 1))) {
+        return -1;
+    }
+    
+    uint64_t end = (uint64_t)virt_addr + size;
+    while (virt_addr < end) {
+        if (!(virt_addr & (HUGE_PAGE_SIZE - 1)) && end - virt_addr >= HUGE_PAGE_SIZE &&
+            paging_unmap_huge_page(dir, virt_addr) == 0) {
+            virt_addr += HUGE_PAGE_SIZE;
+            continue;
+        }
+        paging_unmap_page(dir, virt_addr);
+        virt_addr += PAGE_SIZE;
+    }
+    
+    return 0;
+}
+
+/**
+ * Get large page statistics
+ */
+void paging_get_huge_stats(paging_huge_stats_t* stats) {
+    if (stats) {
+        *stats = huge_stats;
+    }
+}
+
 /**
  * Get physical address from virtual address
  */
@@ -225,11 +531,15 @@ uint32_t paging_get_physical_address(page_directory_t* dir, uint32_t virt_addr)
     uint32_t pd_index = get_page_directory_index(virt_addr);
     uint32_t pt_index = get_page_table_index(virt_addr);
     
-    if (!((*dir)[pd_index] & PAGE_PRESENT)) {
+    uint32_t pde = (*dir)[pd_index];
+    if (!(pde & PAGE_PRESENT)) {
         return 0;
     }
+    if (pde & PAGE_HUGE) {
+        return (pde & HUGE_PAGE_MASK) | (virt_addr & (HUGE_PAGE_SIZE - 1));
+    }
     
-    page_table_t* table = (page_table_t*)((*dir)[pd_index] & ~0xFFF);
+    page_table_t* table = pde_table(pde);
     if (!((*table)[pt_index] & PAGE_PRESENT)) {
         return 0;
     }
@@ -251,11 +561,11 @@ int paging_mark_cow(page_directory_t* dir, uint32_t virt_addr) {
     uint32_t pd_index = get_page_directory_index(virt_addr);
     uint32_t pt_index = get_page_table_index(virt_addr);
     
-    if (!((*dir)[pd_index] & PAGE_PRESENT)) {
+    if (!pde_has_table((*dir)[pd_index])) {
         return -1;
     }
     
-    page_table_t* table = (page_table_t*)((*dir)[pd_index] & ~0xFFF);
+    page_table_t* table = pde_table((*dir)[pd_index]);
     if (!((*table)[pt_index] & PAGE_PRESENT)) {
         return -1;
     }
@@ -264,13 +574,109 @@ int paging_mark_cow(page_directory_t* dir, uint32_t virt_addr) {
     (*table)[pt_index] |= PAGE_COW;
     (*table)[pt_index] &= ~PAGE_WRITE;
     
-    __asm__ volatile("invlpg (%0)" : : "r"(virt_addr) : "memory");
+    tlb_flush_page(virt_addr);
     
     return 0;
 }
 
+/**
+ * Clone an address space for fork
+ * Kernel tables are shared. User pages are shared between parent and
+ * child with one more frame reference each; writable ones become
+ * read-only COW in both, so neither side copies until it writes.
+ */
+page_directory_t* paging_clone_directory(page_directory_t* src) {
+    if (!src) {
+        return NULL;
+    }
+    
+    page_directory_t* dir = paging_create_directory();
+    if (!dir) {
+        return NULL;
+    }
+    
+    uint32_t shared = 0;
+    for (uint32_t i = 0; i < ENTRIES_PER_TABLE; i++) {
+        uint32_t pde = (*src)[i];
+        if (!(pde & PAGE_PRESENT)) {
+            continue;
+        }
+        if ((kernel_directory && pde == (*kernel_directory)[i]) || (pde & PAGE_HUGE)) {
+            (*dir)[i] = pde;
+            continue;
+        }
+        
+        page_table_t* table = alloc_page_table();
+        if (!table) {
+            paging_destroy_directory(dir);
+            return NULL;
+        }
+        (*dir)[i] = (uint32_t)(uintptr_t)table | (pde & 0xFFF);
+        
+        page_table_t* src_table = pde_table(pde);
+        for (uint32_t j = 0; j < ENTRIES_PER_TABLE; j++) {
+            uint32_t pte = (*src_table)[j];
+            if (is_swap_entry(pte)) {
+                if (swap_slot_dup(pte >> 12) == 0) {
+                    (*table)[j] = pte;
+                    continue;
+                }
+                /* Slot saturated: read the child its own copy */
+                void* copy = frame_alloc(0);
+                if (!copy || swap_read_page(pte >> 12, copy) != 0) {
+                    if (copy) {
+                        frame_free(copy);
+                    }
+                    paging_destroy_directory(dir);
+                    return NULL;
+                }
+                (*table)[j] = (uint32_t)(uintptr_t)copy | PAGE_PRESENT | (pte & SWAP_ENTRY_FLAGS);
+                continue;
+            }
+            if (!(pte & PAGE_PRESENT)) {
+                continue;
+            }
+            if (!(pte & PAGE_USER)) {
+                (*table)[j] = pte;
+                continue;
+            }
+            
+            uint32_t phys = pte & ~0xFFF;
+            if (!frame_get(phys)) {
+                /* Reference count saturated: give the child its own copy */
+                void* copy = frame_alloc(0);
+                if (!copy) {
+                    paging_destroy_directory(dir);
+                    return NULL;
+                }
+                copy_page(copy, (const void*)(uintptr_t)phys);
+                (*table)[j] = (uint32_t)(uintptr_t)copy | (pte & 0xFFF);
+                continue;
+            }
+            
+            if (pte & (PAGE_WRITE | PAGE_COW)) {
+                pte = (pte & ~PAGE_WRITE) | PAGE_COW;
+                (*src_table)[j] = pte;
+            }
+            (*table)[j] = pte;
+            shared++;
+        }
+    }
+    
+    /* The parent lost write access to every shared page */
+    if (src == current_directory) {
+        tlb_flush_all();
+    }
+    
+    cow_stats.clones++;
+    cow_stats.pages_shared += shared;
+    return dir;
+}
+
 /**
  * Handle copy-on-write page fault
+ * The last mapping of a frame just gets write access back; otherwise the
+ * page is copied and the shared frame loses a reference.
  */
 int paging_handle_cow(page_directory_t* dir, uint32_t virt_addr) {
     if (!dir) {
@@ -280,39 +686,50 @@ int paging_handle_cow(page_directory_t* dir, uint32_t virt_addr) {
     uint32_t pd_index = get_page_directory_index(virt_addr);
     uint32_t pt_index = get_page_table_index(virt_addr);
     
-    if (!((*dir)[pd_index] & PAGE_PRESENT)) {
+    if (!pde_has_table((*dir)[pd_index])) {
         return -1;
     }
     
-    page_table_t* table = (page_table_t*)((*dir)[pd_index] & ~0xFFF);
+    page_table_t* table = pde_table((*dir)[pd_index]);
     uint32_t pte = (*table)[pt_index];
     
-    if (!(pte & PAGE_COW)) {
-        return -1;
-    }
-    
-    /* Allocate new physical page */
-    void* new_page = vm_alloc(PAGE_SIZE, MEM_KERNEL);
-    if (!new_page) {
+    if (!(pte & PAGE_PRESENT) || !(pte & PAGE_COW)) {
         return -1;
     }
     
-    /* Copy old page to new page */
+    cow_stats.cow_faults++;
     uint32_t old_phys = pte & ~0xFFF;
-    uint8_t* src = (uint8_t*)old_phys;
-    uint8_t* dst = (uint8_t*)new_page;
-    for (uint32_t i = 0; i < PAGE_SIZE; i++) {
-        dst[i] = src[i];
-    }
+    uint32_t flags = (pte & 0xFFF & ~PAGE_COW) | PAGE_WRITE;
     
-    /* Update page table entry */
-    (*table)[pt_index] = ((uint32_t)new_page) | PAGE_PRESENT | PAGE_WRITE | PAGE_USER;
+    if (frame_refcount(old_phys) == 1) {
+        (*table)[pt_index] = old_phys | flags;
+        cow_stats.cow_reuses++;
+    } else {
+        void* new_page = frame_alloc(0);
+        if (!new_page) {
+            return -1;
+        }
+        
+        copy_page(new_page, (const void*)(uintptr_t)old_phys);
+        (*table)[pt_index] = (uint32_t)(uintptr_t)new_page | flags;
+        frame_put(old_phys);
+        cow_stats.cow_copies++;
+    }
     
-    __asm__ volatile("invlpg (%0)" : : "r"(virt_addr) : "memory");
+    tlb_flush_page(virt_addr);
     
     return 0;
 }
 
+/**
+ * Get copy-on-write statistics
+ */
+void paging_get_cow_stats(paging_cow_stats_t* stats) {
+    if (stats) {
+        *stats = cow_stats;
+    }
+}
+
 /**
  * Page fault handler
  */
@@ -332,7 +749,7 @@ void page_fault_handler(uint32_t fault_addr, uint32_t error_code) {
     
     /* Handle page not present - swap in */
     if (!present) {
-        if (page_swap_in(fault_addr) == 0) {
+        if (paging_swap_in(current_directory, fault_addr) == 0) {
             return; /* Page swapped in successfully */
         }
     }
@@ -341,85 +758,207 @@ void page_fault_handler(uint32_t fault_addr, uint32_t error_code) {
 }
 
 /**
- * Initialize page cache
+ * Check whether the hand came round to an entry already in the batch
  */
-void page_cache_init(void) {
-    /* Swap storage already initialized in paging_init */
+static int already_collected(uint32_t** ptes, uint32_t n, const uint32_t* pte) {
+    for (uint32_t i = 0; i < n; i++) {
+        if (ptes[i] == pte) {
+            return 1;
+        }
+    }
+    return 0;
 }
 
 /**
- * Swap page out to storage
+ * Advance the CLOCK hand, collecting up to max eviction victims
+ * Referenced pages lose their accessed bit and survive this pass; shared
+ * frames and frames inside larger allocations are never evicted. The
+ * hand stops after two full sweeps without filling the batch.
  */
-int page_swap_out(uint32_t virt_addr) {
-    /* Find free swap slot */
-    int slot = -1;
-    for (uint32_t i = 0; i < SWAP_PAGES; i++) {
-        if (!swap_storage[i].used) {
-            slot = i;
-            break;
+static uint32_t reclaim_collect(uint32_t** ptes, uint32_t* vaddrs, uint32_t max) {
+    uint32_t n = 0;
+    uint32_t sweeps = 0;
+    
+    while (n < max && reclaim_space_count) {
+        if (clock_space >= reclaim_space_count) {
+            clock_space = 0;
+            clock_vpn = 0;
+            if (++sweeps > 2) {
+                break;
+            }
+        }
+        
+        page_directory_t* dir = reclaim_spaces[clock_space];
+        uint32_t pd_index = clock_vpn >> 10;
+        if (pd_index >= ENTRIES_PER_TABLE) {
+            clock_space++;
+            clock_vpn = 0;
+            continue;
+        }
+        if (!pde_has_table((*dir)[pd_index]) || is_kernel_table(dir, pd_index)) {
+            clock_vpn = (pd_index + 1) << 10;
+            continue;
+        }
+        
+        page_table_t* table = pde_table((*dir)[pd_index]);
+        for (uint32_t j = clock_vpn & 0x3FF; j < ENTRIES_PER_TABLE && n < max; j++) {
+            uint32_t* pte = &(*table)[j];
+            clock_vpn++;
+            if ((*pte & (PAGE_PRESENT | PAGE_USER)) != (PAGE_PRESENT | PAGE_USER)) {
+                continue;
+            }
+            
+            reclaim_stats.scanned++;
+            if (*pte & PAGE_ACCESSED) {
+                *pte &= ~PAGE_ACCESSED;
+                reclaim_stats.referenced++;
+                continue;
+            }
+            if (!frame_exclusive(*pte & ~0xFFF)) {
+                reclaim_stats.skipped++;
+                continue;
+            }
+            if (sweeps && already_collected(ptes, n, pte)) {
+                continue;
+            }
+            
+            ptes[n] = pte;
+            vaddrs[n] = (clock_vpn - 1) << 12;
+            n++;
         }
     }
+    return n;
+}
+
+/**
+ * Write a batch of pages to swap and replace their entries
+ * @return Pages evicted (all or none)
+ */
+static uint32_t evict_pages(uint32_t** ptes, const uint32_t* vaddrs, uint32_t count) {
+    void* pages[SWAP_BATCH];
+    uint32_t slots[SWAP_BATCH];
     
-    if (slot < 0) {
-        return -1; /* No swap space */
+    if (count == 0 || count > SWAP_BATCH) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        pages[i] = (void*)(uintptr_t)(*ptes[i] & ~0xFFF);
+    }
+    if (swap_write_pages(pages, count, slots) != 0) {
+        return 0;
     }
     
-    /* Get physical address */
-    uint32_t phys_addr = paging_get_physical_address(current_directory, virt_addr);
-    if (!phys_addr) {
-        return -1;
+    for (uint32_t i = 0; i < count; i++) {
+        *ptes[i] = make_swap_entry(slots[i], *ptes[i]);
+        tlb_flush_page(vaddrs[i]);
+        frame_put((uint32_t)(uintptr_t)pages[i]);
     }
+    reclaim_stats.evicted += count;
+    return count;
+}
+
+/**
+ * Reclaim page frames by evicting unreferenced user pages to swap
+ * @param target Frames wanted
+ * @return Frames freed
+ */
+uint32_t paging_reclaim(uint32_t target) {
+    uint32_t* ptes[SWAP_BATCH];
+    uint32_t vaddrs[SWAP_BATCH];
+    uint32_t freed = 0;
     
-    /* Copy page to swap */
-    uint8_t* src = (uint8_t*)phys_addr;
-    for (uint32_t i = 0; i < PAGE_SIZE; i++) {
-        swap_storage[slot].data[i] = src[i];
+    if (!swap_active()) {
+        return 0;
     }
     
-    swap_storage[slot].virt_addr = virt_addr;
-    swap_storage[slot].used = 1;
+    while (freed < target) {
+        uint32_t want = target - freed < SWAP_BATCH ? target - freed : SWAP_BATCH;
+        uint32_t room = swap_free_slots();
+        if (room == 0) {
+            break;
+        }
+        if (want > room) {
+            want = room;
+        }
+        uint32_t n = reclaim_collect(ptes, vaddrs, want);
+        if (n == 0 || evict_pages(ptes, vaddrs, n) == 0) {
+            break;
+        }
+        freed += n;
+    }
+    return freed;
+}
+
+/**
+ * Evict one page of an address space to swap
+ */
+int paging_swap_out(page_directory_t* dir, uint32_t virt_addr) {
+    if (!dir) {
+        return -1;
+    }
     
-    /* Unmap page */
-    paging_unmap_page(current_directory, virt_addr);
+    uint32_t* pte = lookup_pte(dir, virt_addr);
+    if (!pte || (*pte & (PAGE_PRESENT | PAGE_USER)) != (PAGE_PRESENT | PAGE_USER) ||
+        !frame_exclusive(*pte & ~0xFFF)) {
+        return -1;
+    }
     
-    return 0;
+    uint32_t va = virt_addr & ~0xFFF;
+    return evict_pages(&pte, &va, 1) == 1 ? 0 : -1;
 }
 
 /**
- * Swap page in from storage
+ * Bring a swapped-out page back into a fresh frame
  */
-int page_swap_in(uint32_t virt_addr) {
-    /* Find page in swap */
-    int slot = -1;
-    for (uint32_t i = 0; i < SWAP_PAGES; i++) {
-        if (swap_storage[i].used && swap_storage[i].virt_addr == virt_addr) {
-            slot = i;
-            break;
-        }
+int paging_swap_in(page_directory_t* dir, uint32_t virt_addr) {
+    if (!dir) {
+        return -1;
     }
     
-    if (slot < 0) {
-        return -1; /* Page not in swap */
+    uint32_t* pte = lookup_pte(dir, virt_addr);
+    if (!pte || !is_swap_entry(*pte)) {
+        return -1;
     }
     
-    /* Allocate physical page */
-    void* phys_page = vm_alloc(PAGE_SIZE, MEM_KERNEL);
-    if (!phys_page) {
+    void* frame = frame_alloc(0);
+    if (!frame) {
         return -1;
     }
     
-    /* Copy from swap to physical page */
-    uint8_t* dst = (uint8_t*)phys_page;
-    for (uint32_t i = 0; i < PAGE_SIZE; i++) {
-        dst[i] = swap_storage[slot].data[i];
+    uint32_t entry = *pte;
+    if (swap_read_page(entry >> 12, frame) != 0) {
+        frame_free(frame);
+        return -1;
     }
     
-    /* Map page */
-    paging_map_page(current_directory, virt_addr, (uint32_t)phys_page, 
-                    PAGE_PRESENT | PAGE_WRITE | PAGE_USER);
-    
-    /* Free swap slot */
-    swap_storage[slot].used = 0;
+    *pte = (uint32_t)(uintptr_t)frame | PAGE_PRESENT | PAGE_ACCESSED | (entry & SWAP_ENTRY_FLAGS);
+    swap_slot_put(entry >> 12);
+    tlb_flush_page(virt_addr);
+    reclaim_stats.swap_ins++;
     
     return 0;
 }
+
+/**
+ * Get page reclaim statistics
+ */
+void paging_get_reclaim_stats(paging_reclaim_stats_t* stats) {
+    if (stats) {
+        *stats = reclaim_stats;
+        stats->spaces = reclaim_space_count;
+    }
+}
+
+/**
+ * Swap a page of the current address space out
+ */
+int page_swap_out(uint32_t virt_addr) {
+    return paging_swap_out(current_directory, virt_addr);
+}
+
+/**
+ * Swap a page of the current address space in
+ */
+int page_swap_in(uint32_t virt_addr) {
+    return paging_swap_in(current_directory, virt_addr);
+}
@@ -16,11 +16,20 @@
 #define PAGE_USER       0x004
 #define PAGE_ACCESSED   0x020
 #define PAGE_DIRTY      0x040
+#define PAGE_HUGE       0x080  /* Directory entry maps a 4 MB page (PSE) */
 #define PAGE_COW        0x200  /* Copy-on-write flag (available bit) */
+#define PAGE_SWAPPED    0x400  /* Non-present entry holds a swap slot (available bit) */
 
 /* Page directory/table entries per directory/table */
 #define ENTRIES_PER_TABLE 1024
 
+/* Large (PSE) pages */
+#define HUGE_PAGE_SIZE  0x400000
+#define HUGE_PAGE_MASK  0xFFC00000
+
+/* Address spaces the page reclaimer can scan */
+#define PAGING_MAX_SPACES 64
+
 /* Virtual memory structures */
 typedef uint32_t page_directory_t[ENTRIES_PER_TABLE];
 typedef uint32_t page_table_t[ENTRIES_PER_TABLE];
@@ -42,6 +51,33 @@ typedef struct {
     uint32_t user;
 } page_fault_info_t;
 
+/* Copy-on-write statistics */
+typedef struct {
+    uint64_t clones;            /* paging_clone_directory() calls */
+    uint64_t pages_shared;      /* User pages shared by clones */
+    uint64_t cow_faults;        /* Write faults on COW pages */
+    uint64_t cow_copies;        /* Faults that copied a shared page */
+    uint64_t cow_reuses;        /* Faults on a page no longer shared */
+} paging_cow_stats_t;
+
+/* Large page statistics */
+typedef struct {
+    uint64_t huge_maps;         /* 4 MB pages installed */
+    uint64_t huge_unmaps;
+    uint64_t splits;            /* 4 MB pages broken into page tables */
+    uint64_t small_pages_saved; /* 4 KB entries paging_map_range() avoided */
+} paging_huge_stats_t;
+
+/* Page reclaim statistics */
+typedef struct {
+    uint64_t scanned;           /* Entries examined by the clock hand */
+    uint64_t referenced;        /* Second chances given for the accessed bit */
+    uint64_t skipped;           /* Shared frames passed over */
+    uint64_t evicted;           /* Pages written to swap */
+    uint64_t swap_ins;          /* Faults served from swap */
+    uint32_t spaces;            /* Address spaces on the reclaim list */
+} paging_reclaim_stats_t;
+
 /* Paging initialization and management */
 void paging_init(void);
 void paging_enable(void);
@@ -52,21 +88,45 @@ page_directory_t* paging_create_directory(void);
 void paging_destroy_directory(page_directory_t* dir);
 void paging_switch_directory(page_directory_t* dir);
 page_directory_t* paging_get_current_directory(void);
+page_directory_t* paging_get_kernel_directory(void);
 
 /* Page mapping functions */
 int paging_map_page(page_directory_t* dir, uint32_t virt_addr, uint32_t phys_addr, uint32_t flags);
 int paging_unmap_page(page_directory_t* dir, uint32_t virt_addr);
 uint32_t paging_get_physical_address(page_directory_t* dir, uint32_t virt_addr);
 
+/* Large page mapping
+ * 4 MB pages are mapping-only: they take no frame references and are
+ * shared as-is by paging_clone_directory(). Mapping or unmapping a 4 KB
+ * page inside one splits it into a page table first. */
+int paging_map_huge_page(page_directory_t* dir, uint32_t virt_addr, uint32_t phys_addr, uint32_t flags);
+int paging_unmap_huge_page(page_directory_t* dir, uint32_t virt_addr);
+int paging_map_range(page_directory_t* dir, uint32_t virt_addr, uint32_t phys_addr,
+                     uint32_t size, uint32_t flags);
+int paging_unmap_range(page_directory_t* dir, uint32_t virt_addr, uint32_t size);
+void paging_get_huge_stats(paging_huge_stats_t* stats);
+
 /* Page fault handler */
 void page_fault_handler(uint32_t fault_addr, uint32_t error_code);
 
-/* Copy-on-write support */
+/* Copy-on-write support
+ * User pages (PAGE_USER) hold a frame reference per mapping: clones take
+ * one, COW copies and paging_destroy_directory() drop one. */
+page_directory_t* paging_clone_directory(page_directory_t* src);
 int paging_mark_cow(page_directory_t* dir, uint32_t virt_addr);
 int paging_handle_cow(page_directory_t* dir, uint32_t virt_addr);
+void paging_get_cow_stats(paging_cow_stats_t* stats);
 
-/* Page cache for swapping */
-void page_cache_init(void);
+/* Swapping
+ * An evicted page's entry keeps PAGE_SWAPPED, its slot in the frame field
+ * and its WRITE/USER/COW bits, so a fault finds it without a search.
+ * paging_reclaim() runs a CLOCK hand over the user pages of every address
+ * space, clearing accessed bits and evicting exclusively owned pages that
+ * were not referenced since the last pass, a batch at a time. */
+uint32_t paging_reclaim(uint32_t target);
+int paging_swap_out(page_directory_t* dir, uint32_t virt_addr);
+int paging_swap_in(page_directory_t* dir, uint32_t virt_addr);
+void paging_get_reclaim_stats(paging_reclaim_stats_t* stats);
 int page_swap_out(uint32_t virt_addr);
 int page_swap_in(uint32_t virt_addr);
 
@@ -0,0 +1,561 @@
+/**
+ * Aurora OS - Slab Allocator
+ *
+ * kmalloc/kfree backend. The managed region is split into pages, each
+ * with a descriptor kept at the start of the region (off-slab, so objects
+ * use the full slab and the 4 KB class stays page aligned):
+ *
+ *  - Requests up to SLAB_MAX_OBJECT bytes are rounded to one of sixteen
+ *    size classes (powers of two plus the 1.5x steps common struct sizes
+ *    land on). Each class keeps a list of partially used slabs; a slab is
+ *    one or a few pages whose descriptor holds an allocation bitmap, so
+ *    alloc is "first slab on the list, first clear bit" and free is "page
+ *    descriptor from the address, clear the bit" - both O(1). The bitmap
+ *    also rejects interior pointers and double frees.
+ *  - One empty slab per class is cached to avoid page churn when a class
+ *    oscillates around a slab boundary; further empty slabs go back to the
+ *    page allocator.
+ *  - Larger requests fall through to a page-run allocator: free runs are
+ *    boundary-tagged in the descriptors so frees coalesce with both
+ *    neighbours in O(1).
+ */
+
+#include "slab.h"
+
+/* Page descriptor types */
+#define SLAB_PG_FREE    0   /* Part of a free run */
+#define SLAB_PG_SLAB    1   /* First page of a slab */
+#define SLAB_PG_LARGE   2   /* First page of a large allocation */
+#define SLAB_PG_TAIL    3   /* Later page of a slab or large allocation */
+
+/* Allocation bitmap: enough bits for a one-page slab of 16-byte objects */
+#define SLAB_MAP_WORDS  8
+#define SLAB_MAP_BITS   (SLAB_MAP_WORDS * 32)
+
+/**
+ * Page descriptor
+ * For free runs, count is valid on the first page and head (the index of
+ * the first page) on the last page. For slabs and large allocations, the
+ * first page carries the state and later pages point back via head.
+ */
+typedef struct slab_page {
+    uint8_t type;
+    uint8_t size_class;
+    uint16_t inuse;             /* Live objects in the slab */
+    uint16_t capacity;          /* Objects per slab */
+    uint16_t hint;              /* Lowest bitmap word that may have a clear bit */
+    uint32_t count;             /* Run length in pages */
+    uint32_t head;              /* Index of the run's first page */
+    struct slab_page* prev;     /* Class partial list or free run list */
+    struct slab_page* next;
+    uint32_t map[SLAB_MAP_WORDS];   /* Set bit = object allocated */
+} slab_page_t;
+
+/* Size class */
+typedef struct {
+    uint32_t size;
+    uint32_t pages;             /* Pages per slab */
+    uint32_t capacity;          /* Objects per slab */
+    uint32_t recip;             /* ceil(2^32 / size), for offset -> index */
+    slab_page_t* partial;       /* Slabs with free objects */
+    slab_page_t* empty;         /* Cached empty slab */
+    uint32_t slabs;
+    uint32_t objects;
+} slab_class_t;
+
+static const uint16_t class_sizes[SLAB_NUM_CLASSES] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096
+};
+static const uint8_t class_pages[SLAB_NUM_CLASSES] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 1, 3, 1
+};
+
+static slab_class_t classes[SLAB_NUM_CLASSES];
+
+/* Size -> class lookup: 16-byte steps up to 512, 256-byte steps above */
+static uint8_t small_class[512 / 16 + 1];
+static uint8_t large_class[SLAB_MAX_OBJECT / 256 + 1];
+
+/* Managed region */
+static slab_page_t* pages = NULL;
+static uint8_t* data_base = NULL;
+static uint32_t num_pages = 0;
+static slab_page_t* free_runs = NULL;
+static slab_stats_t stats;
+
+static inline uint32_t page_index(const slab_page_t* pg) {
+    return (uint32_t)(pg - pages);
+}
+
+static inline uint8_t* page_address(uint32_t index) {
+    return data_base + ((size_t)index << SLAB_PAGE_SHIFT);
+}
+
+static inline void list_push(slab_page_t** list, slab_page_t* pg) {
+    pg->prev = NULL;
+    pg->next = *list;
+    if (*list) {
+        (*list)->prev = pg;
+    }
+    *list = pg;
+}
+
+static inline void list_remove(slab_page_t** list, slab_page_t* pg) {
+    if (pg->prev) {
+        pg->prev->next = pg->next;
+    } else {
+        *list = pg->next;
+    }
+    if (pg->next) {
+        pg->next->prev = pg->prev;
+    }
+    pg->prev = NULL;
+    pg->next = NULL;
+}
+
+/* ---- Page runs ---- */
+
+/**
+ * Allocate a run of contiguous pages (first fit, carved from the run's end
+ * so the run head stays on the list)
+ */
+static int32_t run_alloc(uint32_t count) {
+    for (slab_page_t* run = free_runs; run; run = run->next) {
+        if (run->count < count) {
+            continue;
+        }
+
+        uint32_t head = page_index(run);
+        uint32_t start = head + run->count - count;
+        if (run->count == count) {
+            list_remove(&free_runs, run);
+        } else {
+            run->count -= count;
+            pages[head + run->count - 1].head = head;
+        }
+
+        stats.free_pages -= count;
+        return (int32_t)start;
+    }
+    return -1;
+}
+
+/**
+ * Return a run of pages, coalescing with free neighbours
+ */
+static void run_free(uint32_t start, uint32_t count) {
+    for (uint32_t i = start; i < start + count; i++) {
+        pages[i].type = SLAB_PG_FREE;
+    }
+    stats.free_pages += count;
+
+    slab_page_t* run;
+    if (start > 0 && pages[start - 1].type == SLAB_PG_FREE) {
+        /* Extend the run ending just before us */
+        run = &pages[pages[start - 1].head];
+        run->count += count;
+    } else {
+        run = &pages[start];
+        run->count = count;
+        list_push(&free_runs, run);
+    }
+
+    uint32_t next = start + count;
+    if (next < num_pages && pages[next].type == SLAB_PG_FREE) {
+        list_remove(&free_runs, &pages[next]);
+        run->count += pages[next].count;
+    }
+
+    uint32_t head = page_index(run);
+    run->head = head;
+    pages[head + run->count - 1].head = head;
+}
+
+/**
+ * Mark an allocated run's pages
+ */
+static void run_claim(uint32_t start, uint32_t count, uint8_t type) {
+    pages[start].type = type;
+    pages[start].count = count;
+    pages[start].head = start;
+    for (uint32_t i = start + 1; i < start + count; i++) {
+        pages[i].type = SLAB_PG_TAIL;
+        pages[i].head = start;
+    }
+}
+
+/* ---- Slabs ---- */
+
+static slab_page_t* slab_create(uint32_t cls) {
+    slab_class_t* c = &classes[cls];
+    int32_t start = run_alloc(c->pages);
+    if (start < 0) {
+        return NULL;
+    }
+
+    run_claim((uint32_t)start, c->pages, SLAB_PG_SLAB);
+    slab_page_t* slab = &pages[start];
+    slab->size_class = (uint8_t)cls;
+    slab->inuse = 0;
+    slab->capacity = (uint16_t)c->capacity;
+    slab->hint = 0;
+
+    /* Bits past the capacity read as allocated so the search never picks them */
+    for (uint32_t w = 0; w < SLAB_MAP_WORDS; w++) {
+        uint32_t first = w * 32;
+        if (first + 32 <= c->capacity) {
+            slab->map[w] = 0;
+        } else if (first >= c->capacity) {
+            slab->map[w] = 0xFFFFFFFFu;
+        } else {
+            slab->map[w] = 0xFFFFFFFFu << (c->capacity - first);
+        }
+    }
+
+    c->slabs++;
+    stats.slab_pages += c->pages;
+    return slab;
+}
+
+static void slab_destroy(slab_page_t* slab) {
+    slab_class_t* c = &classes[slab->size_class];
+    c->slabs--;
+    stats.slab_pages -= c->pages;
+    run_free(page_index(slab), c->pages);
+}
+
+static void* slab_alloc_object(uint32_t cls) {
+    slab_class_t* c = &classes[cls];
+    slab_page_t* slab = c->partial;
+
+    if (!slab) {
+        slab = c->empty;
+        if (slab) {
+            c->empty = NULL;
+        } else {
+            slab = slab_create(cls);
+            if (!slab) {
+                return NULL;
+            }
+        }
+        list_push(&c->partial, slab);
+    }
+
+    uint32_t w = slab->hint;
+    while (slab->map[w] == 0xFFFFFFFFu) {
+        w++;
+    }
+    uint32_t bit = (uint32_t)__builtin_ctz(~slab->map[w]);
+    slab->map[w] |= 1u << bit;
+    slab->hint = (uint16_t)w;
+
+    if (++slab->inuse == slab->capacity) {
+        list_remove(&c->partial, slab);
+    }
+    c->objects++;
+
+    return page_address(page_index(slab)) + (size_t)(w * 32 + bit) * c->size;
+}
+
+static void slab_free_object(slab_page_t* slab, uint32_t offset) {
+    slab_class_t* c = &classes[slab->size_class];
+    uint32_t index = (uint32_t)(((uint64_t)offset * c->recip) >> 32);
+    if (index * c->size != offset || index >= slab->capacity) {
+        return;                     /* Not the start of an object */
+    }
+
+    uint32_t w = index / 32;
+    uint32_t bit = 1u << (index % 32);
+    if (!(slab->map[w] & bit)) {
+        return;                     /* Double free */
+    }
+    slab->map[w] &= ~bit;
+    if (w < slab->hint) {
+        slab->hint = (uint16_t)w;
+    }
+
+    c->objects--;
+    stats.frees++;
+    stats.bytes_in_use -= c->size;
+
+    if (slab->inuse-- == slab->capacity) {
+        list_push(&c->partial, slab);
+    }
+    if (slab->inuse == 0) {
+        list_remove(&c->partial, slab);
+        if (!c->empty) {
+            c->empty = slab;
+        } else {
+            slab_destroy(slab);
+        }
+    }
+}
+
+static inline uint32_t size_to_class(size_t size) {
+    if (size <= 512) {
+        return small_class[(size + 15) >> 4];
+    }
+    return large_class[(size + 255) >> 8];
+}
+
+/* ---- Public interface ---- */
+
+int slab_init(void* base, size_t size) {
+    uintptr_t start = (uintptr_t)base;
+    uintptr_t end = start + size;
+    uintptr_t desc_start = (start + 63) & ~(uintptr_t)63;
+
+    if (end < start || desc_start + sizeof(slab_page_t) + 2 * SLAB_PAGE_SIZE > end) {
+        return -1;
+    }
+
+    /* Largest page count whose descriptors and pages both fit */
+    uint32_t count = (uint32_t)((end - desc_start) / (SLAB_PAGE_SIZE + sizeof(slab_page_t)));
+    uintptr_t data;
+    for (;;) {
+        data = (desc_start + count * sizeof(slab_page_t) + SLAB_PAGE_SIZE - 1) &
+               ~(uintptr_t)(SLAB_PAGE_SIZE - 1);
+        if (data + (uintptr_t)count * SLAB_PAGE_SIZE <= end || count == 0) {
+            break;
+        }
+        count--;
+    }
+    if (count == 0) {
+        return -1;
+    }
+
+    pages = (slab_page_t*)desc_start;
+    data_base = (uint8_t*)data;
+    num_pages = count;
+    free_runs = NULL;
+
+    slab_stats_t zero = {0};
+    stats = zero;
+    stats.total_pages = count;
+
+    for (uint32_t i = 0; i < count; i++) {
+        pages[i].type = SLAB_PG_TAIL;
+        pages[i].prev = NULL;
+        pages[i].next = NULL;
+    }
+    stats.free_pages = 0;
+    run_free(0, count);
+
+    for (uint32_t c = 0; c < SLAB_NUM_CLASSES; c++) {
+        classes[c].size = class_sizes[c];
+        classes[c].pages = class_pages[c];
+        classes[c].capacity = class_pages[c] * SLAB_PAGE_SIZE / class_sizes[c];
+        if (classes[c].capacity > SLAB_MAP_BITS) {
+            classes[c].capacity = SLAB_MAP_BITS;
+        }
+        classes[c].recip = (uint32_t)(0xFFFFFFFFu / class_sizes[c]) + 1;
+        classes[c].partial = NULL;
+        classes[c].empty = NULL;
+        classes[c].slabs = 0;
+        classes[c].objects = 0;
+    }
+
+    uint32_t c = 0;
+    for (uint32_t i = 0; i < sizeof(small_class); i++) {
+        while (class_sizes[c] < i * 16) {
+            c++;
+        }
+        small_class[i] = (uint8_t)c;
+    }
+    c = 0;
+    for (uint32_t i = 0; i < sizeof(large_class); i++) {
+        while (class_sizes[c] < i * 256) {
+            c++;
+        }
+        large_class[i] = (uint8_t)c;
+    }
+
+    return 0;
+}
+
+static void account_alloc(size_t usable) {
+    stats.allocs++;
+    stats.bytes_in_use += usable;
+    if (stats.bytes_in_use > stats.peak_bytes_in_use) {
+        stats.peak_bytes_in_use = stats.bytes_in_use;
+    }
+}
+
+int slab_size_class(size_t size) {
+    if (size == 0 || size > SLAB_MAX_OBJECT) {
+        return -1;
+    }
+    return (int)size_to_class(size);
+}
+
+uint32_t slab_class_size(uint32_t cls) {
+    return cls < SLAB_NUM_CLASSES ? class_sizes[cls] : 0;
+}
+
+void* slab_alloc_class(uint32_t cls) {
+    if (cls >= SLAB_NUM_CLASSES || !pages) {
+        return NULL;
+    }
+
+    void* ptr = slab_alloc_object(cls);
+    if (!ptr) {
+        stats.failed++;
+        return NULL;
+    }
+    account_alloc(classes[cls].size);
+    return ptr;
+}
+
+void* slab_alloc(size_t size) {
+    if (size == 0 || !pages) {
+        return NULL;
+    }
+
+    void* ptr;
+    size_t usable;
+    if (size <= SLAB_MAX_OBJECT) {
+        uint32_t cls = size_to_class(size);
+        ptr = slab_alloc_object(cls);
+        usable = classes[cls].size;
+    } else {
+        if (size > (size_t)num_pages * SLAB_PAGE_SIZE) {
+            stats.failed++;
+            return NULL;
+        }
+        uint32_t count = (uint32_t)((size + SLAB_PAGE_SIZE - 1) >> SLAB_PAGE_SHIFT);
+        int32_t start = run_alloc(count);
+        ptr = NULL;
+        if (start >= 0) {
+            run_claim((uint32_t)start, count, SLAB_PG_LARGE);
+            stats.large_pages += count;
+            stats.large_allocs++;
+            ptr = page_address((uint32_t)start);
+        }
+        usable = (size_t)count * SLAB_PAGE_SIZE;
+    }
+
+    if (!ptr) {
+        stats.failed++;
+        return NULL;
+    }
+
+    account_alloc(usable);
+    return ptr;
+}
+
+/**
+ * Find the descriptor of the allocation containing ptr
+ * @return Head page descriptor, or NULL if ptr is outside the region or
+ *         in a free page
+ */
+static slab_page_t* lookup(const void* ptr, uint32_t* offset) {
+    const uint8_t* p = (const uint8_t*)ptr;
+    if (!pages || p < data_base || p >= data_base + ((size_t)num_pages << SLAB_PAGE_SHIFT)) {
+        return NULL;
+    }
+
+    uint32_t index = (uint32_t)((size_t)(p - data_base) >> SLAB_PAGE_SHIFT);
+    slab_page_t* pg = &pages[index];
+    if (pg->type == SLAB_PG_TAIL) {
+        pg = &pages[pg->head];
+    }
+    if (pg->type == SLAB_PG_FREE) {
+        return NULL;
+    }
+
+    *offset = (uint32_t)(p - page_address(page_index(pg)));
+    return pg;
+}
+
+void slab_free(void* ptr) {
+    uint32_t offset;
+    slab_page_t* pg = lookup(ptr, &offset);
+    if (!pg) {
+        return;
+    }
+
+    if (pg->type == SLAB_PG_SLAB) {
+        slab_free_object(pg, offset);
+        return;
+    }
+
+    if (offset != 0) {
+        return;
+    }
+    uint32_t count = pg->count;
+    stats.large_pages -= count;
+    stats.frees++;
+    stats.bytes_in_use -= (uint64_t)count * SLAB_PAGE_SIZE;
+    run_free(page_index(pg), count);
+}
+
+int slab_object_class(const void* ptr) {
+    uint32_t offset;
+    slab_page_t* pg = lookup(ptr, &offset);
+    if (!pg || pg->type != SLAB_PG_SLAB) {
+        return -1;
+    }
+
+    /* Same checks as slab_free_object(): only the start of a live object */
+    slab_class_t* c = &classes[pg->size_class];
+    uint32_t index = (uint32_t)(((uint64_t)offset * c->recip) >> 32);
+    if (index * c->size != offset || index >= pg->capacity ||
+        !(pg->map[index / 32] & (1u << (index % 32)))) {
+        return -1;
+    }
+    return pg->size_class;
+}
+
+size_t slab_usable_size(const void* ptr) {
+    uint32_t offset;
+    slab_page_t* pg = lookup(ptr, &offset);
+    if (!pg) {
+        return 0;
+    }
+
+    if (pg->type == SLAB_PG_LARGE) {
+        return offset == 0 ? (size_t)pg->count * SLAB_PAGE_SIZE : 0;
+    }
+
+    slab_class_t* c = &classes[pg->size_class];
+    uint32_t index = (uint32_t)(((uint64_t)offset * c->recip) >> 32);
+    if (index * c->size != offset || index >= pg->capacity ||
+        !(pg->map[index / 32] & (1u << (index % 32)))) {
+        return 0;
+    }
+    return c->size;
+}
+
+uint32_t slab_shrink(void) {
+    uint32_t released = 0;
+    for (uint32_t c = 0; c < SLAB_NUM_CLASSES; c++) {
+        if (classes[c].empty) {
+            released += classes[c].pages;
+            slab_destroy(classes[c].empty);
+            classes[c].empty = NULL;
+        }
+    }
+    return released;
+}
+
+void slab_get_stats(slab_stats_t* out) {
+    if (!out) {
+        return;
+    }
+
+    *out = stats;
+    out->free_runs = 0;
+    out->largest_free_run = 0;
+    for (slab_page_t* run = free_runs; run; run = run->next) {
+        out->free_runs++;
+        if (run->count > out->largest_free_run) {
+            out->largest_free_run = run->count;
+        }
+    }
+
+    for (uint32_t c = 0; c < SLAB_NUM_CLASSES; c++) {
+        out->class_size[c] = classes[c].size;
+        out->class_slabs[c] = classes[c].slabs;
+        out->class_objects[c] = classes[c].objects;
+    }
+}
@@ -0,0 +1,127 @@
+/**
+ * Aurora OS - Slab Allocator Header
+ *
+ * Size-class object allocator backing kmalloc/kfree. Requests up to
+ * SLAB_MAX_OBJECT bytes are served from per-class slabs; larger requests
+ * fall through to the page-run allocator over the same region.
+ */
+
+#ifndef AURORA_SLAB_H
+#define AURORA_SLAB_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Page granularity of the managed region */
+#define SLAB_PAGE_SIZE      4096
+#define SLAB_PAGE_SHIFT     12
+
+/* Largest request served from a size class */
+#define SLAB_MAX_OBJECT     4096
+
+/* Number of size classes (16 B .. 4 KB) */
+#define SLAB_NUM_CLASSES    16
+
+/* Minimum alignment of every returned object */
+#define SLAB_MIN_ALIGN      16
+
+/* Allocator statistics */
+typedef struct {
+    uint64_t allocs;                /* Successful slab_alloc() calls */
+    uint64_t frees;                 /* slab_free() calls on live objects */
+    uint64_t large_allocs;          /* Allocations served by page runs */
+    uint64_t failed;                /* Allocations that returned NULL */
+    uint64_t bytes_in_use;          /* Sum of usable sizes of live objects */
+    uint64_t peak_bytes_in_use;
+    uint32_t total_pages;           /* Pages available for slabs and runs */
+    uint32_t free_pages;
+    uint32_t slab_pages;            /* Pages held by slabs (incl. cached empty) */
+    uint32_t large_pages;           /* Pages held by large allocations */
+    uint32_t free_runs;             /* Free page runs (external fragmentation) */
+    uint32_t largest_free_run;      /* In pages */
+    uint32_t class_size[SLAB_NUM_CLASSES];
+    uint32_t class_slabs[SLAB_NUM_CLASSES];
+    uint32_t class_objects[SLAB_NUM_CLASSES];   /* Live objects per class */
+} slab_stats_t;
+
+/**
+ * Take over a memory region for object and page-run allocation
+ * The start of the region holds the per-page descriptors; the rest is
+ * handed out. Any previous state is discarded.
+ * @param base Region start (need not be page aligned)
+ * @param size Region size in bytes
+ * @return 0 on success, -1 if the region is too small
+ */
+int slab_init(void* base, size_t size);
+
+/**
+ * Allocate memory
+ * @param size Requested size in bytes
+ * @return Pointer aligned to SLAB_MIN_ALIGN (page aligned for the 4 KB
+ *         class and for large allocations), or NULL for size 0 or when
+ *         the region is exhausted
+ */
+void* slab_alloc(size_t size);
+
+/**
+ * Free memory returned by slab_alloc()
+ * Pointers outside the region, interior pointers and double frees are
+ * ignored.
+ * @param ptr Object to free (NULL is ignored)
+ */
+void slab_free(void* ptr);
+
+/**
+ * Size class serving a request
+ * @param size Requested size in bytes (1 .. SLAB_MAX_OBJECT)
+ * @return Class index, or -1 if the request is served by page runs
+ */
+int slab_size_class(size_t size);
+
+/**
+ * Object size of a class
+ * @param cls Class index
+ * @return Object size in bytes, 0 for an invalid class
+ */
+uint32_t slab_class_size(uint32_t cls);
+
+/**
+ * Allocate one object of a size class
+ * @param cls Class index
+ * @return Object, or NULL when the region is exhausted
+ */
+void* slab_alloc_class(uint32_t cls);
+
+/**
+ * Size class of a slab object
+ * Only the page descriptor and ptr's own bitmap bit are consulted, so
+ * this is safe to call without the caller's allocator lock as long as
+ * ptr is a live object.
+ * @param ptr Pointer into the region
+ * @return Class index, or -1 if ptr is not the start of a live slab
+ *         object (interior pointer, freed object, large allocation, free
+ *         page or outside the region)
+ */
+int slab_object_class(const void* ptr);
+
+/**
+ * Usable size of an allocation
+ * @param ptr Object returned by slab_alloc()
+ * @return Size of the object's class or page run in bytes, 0 if ptr is
+ *         not a live allocation
+ */
+size_t slab_usable_size(const void* ptr);
+
+/**
+ * Return cached empty slabs to the page-run allocator
+ * @return Number of pages released
+ */
+uint32_t slab_shrink(void);
+
+/**
+ * Get allocator statistics
+ * @param stats Output statistics
+ */
+void slab_get_stats(slab_stats_t* stats);
+
+#endif /* AURORA_SLAB_H */
@@ -0,0 +1,416 @@
+/**
+ * Aurora OS - Swap Space
+ *
+ * Slots are tracked twice: a per-slot reference count (swap entries left
+ * behind in forked page tables share a slot) and a bitmap of used slots
+ * that the allocator scans a word at a time. Allocation is next-fit from
+ * a cursor and hands out runs of free neighbours, so a reclaim batch
+ * usually lands in consecutive slots and reaches the device as a single
+ * sequential write.
+ *
+ * Reclaim is driven by three watermarks on the free frame count, as in
+ * Linux's zone watermarks:
+ *
+ *  - below low, the allocator wakes kswapd, which reclaims in the
+ *    background until free frames reach high
+ *  - below min, the allocating context reclaims a batch itself first
+ *  - when an allocation fails outright it reclaims and retries once
+ */
+
+#include "swap.h"
+#include "paging.h"
+#include "../process/process.h"
+#ifndef AURORA_STANDALONE
+#include "memory.h"
+#include "../smp/spinlock.h"
+#include "../drivers/storage.h"
+#include "../drivers/partition.h"
+#endif
+
+static swap_device_t swap_dev;
+static int swap_enabled = 0;
+
+static uint32_t* slot_bitmap;       /* One bit per slot, set while used */
+static uint8_t* slot_refs;          /* Swap entries per slot */
+static uint32_t slot_cursor;        /* Next-fit search start */
+
+static swap_stats_t stats;
+static volatile uint32_t kswapd_wake = 0;
+static process_t* kswapd = NULL;
+
+static inline int slot_used(uint32_t slot) {
+    return (slot_bitmap[slot >> 5] >> (slot & 31)) & 1;
+}
+
+/**
+ * Find the first free slot at or after from, wrapping once
+ * @return Slot, or swap_dev.slots if all are used
+ */
+static uint32_t find_free_slot(uint32_t from) {
+    uint32_t words = (swap_dev.slots + 31) / 32;
+    uint32_t w = from / 32;
+    uint32_t free_bits = ~slot_bitmap[w] & (0xFFFFFFFFu << (from & 31));
+
+    for (uint32_t n = 0; n <= words; n++) {
+        if (free_bits) {
+            uint32_t slot = w * 32 + (uint32_t)__builtin_ctz(free_bits);
+            if (slot < swap_dev.slots) {
+                return slot;
+            }
+        }
+        w = w + 1 < words ? w + 1 : 0;
+        free_bits = ~slot_bitmap[w];
+    }
+    return swap_dev.slots;
+}
+
+/**
+ * Allocate a run of up to max consecutive free slots
+ * @return Run length (0 when swap is full); first slot in *start
+ */
+static uint32_t alloc_slot_run(uint32_t max, uint32_t* start) {
+    if (stats.used_slots == swap_dev.slots) {
+        return 0;
+    }
+
+    uint32_t slot = find_free_slot(slot_cursor < swap_dev.slots ? slot_cursor : 0);
+    if (slot == swap_dev.slots) {
+        return 0;
+    }
+
+    uint32_t len = 0;
+    while (len < max && slot + len < swap_dev.slots && !slot_used(slot + len)) {
+        uint32_t s = slot + len;
+        slot_bitmap[s >> 5] |= 1u << (s & 31);
+        slot_refs[s] = 1;
+        len++;
+    }
+
+    stats.used_slots += len;
+    slot_cursor = slot + len;
+    *start = slot;
+    return len;
+}
+
+static void release_slot(uint32_t slot) {
+    slot_refs[slot] = 0;
+    slot_bitmap[slot >> 5] &= ~(1u << (slot & 31));
+    stats.used_slots--;
+}
+
+int swap_init(const swap_device_t* dev) {
+    if (swap_enabled || !dev || dev->slots == 0 || !dev->read || !dev->write) {
+        return -1;
+    }
+
+    uint32_t slots = dev->slots < SWAP_MAX_SLOTS ? dev->slots : SWAP_MAX_SLOTS;
+    uint32_t words = (slots + 31) / 32;
+    slot_bitmap = (uint32_t*)kmalloc(words * sizeof(uint32_t));
+    slot_refs = (uint8_t*)kmalloc(slots);
+    if (!slot_bitmap || !slot_refs) {
+        kfree(slot_bitmap);
+        kfree(slot_refs);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < words; i++) {
+        slot_bitmap[i] = 0;
+    }
+    for (uint32_t i = 0; i < slots; i++) {
+        slot_refs[i] = 0;
+    }
+
+    swap_dev = *dev;
+    swap_dev.slots = slots;
+    slot_cursor = 0;
+    kswapd_wake = 0;
+
+    uint32_t wmark_min = stats.wmark_min;
+    uint32_t wmark_low = stats.wmark_low;
+    uint32_t wmark_high = stats.wmark_high;
+    stats = (swap_stats_t){0};
+    stats.total_slots = slots;
+
+    if (wmark_high) {
+        swap_set_watermarks(wmark_min, wmark_low, wmark_high);
+    } else {
+        /* Defaults: 1/64, 1/32 and 3/64 of managed memory */
+        buddy_stats_t fs;
+        memory_get_frame_stats(&fs);
+        uint32_t base = fs.managed_frames / 64 ? fs.managed_frames / 64 : 1;
+        swap_set_watermarks(base, base * 2, base * 3);
+    }
+
+    swap_enabled = 1;
+    return 0;
+}
+
+int swap_active(void) {
+    return swap_enabled;
+}
+
+uint32_t swap_free_slots(void) {
+    return swap_enabled ? swap_dev.slots - stats.used_slots : 0;
+}
+
+void swap_set_watermarks(uint32_t min, uint32_t low, uint32_t high) {
+    if (low < min) {
+        low = min;
+    }
+    if (high < low) {
+        high = low;
+    }
+    stats.wmark_min = min;
+    stats.wmark_low = low;
+    stats.wmark_high = high;
+}
+
+int swap_write_pages(void* const* pages, uint32_t count, uint32_t* slots) {
+    if (!swap_enabled || count == 0) {
+        return -1;
+    }
+    if (count > swap_dev.slots - stats.used_slots) {
+        return -1;
+    }
+
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t start;
+        uint32_t len = alloc_slot_run(count - done, &start);
+        if (len == 0) {
+            break;
+        }
+        for (uint32_t i = 0; i < len; i++) {
+            slots[done + i] = start + i;
+        }
+
+        stats.write_requests++;
+        if (swap_dev.write(swap_dev.ctx, start, pages + done, len) != 0) {
+            stats.write_errors++;
+            done += len;
+            break;
+        }
+        done += len;
+
+        if (done == count) {
+            stats.pages_out += count;
+            return 0;
+        }
+    }
+
+    /* Full or failed: give back whatever was taken */
+    for (uint32_t i = 0; i < done; i++) {
+        release_slot(slots[i]);
+    }
+    return -1;
+}
+
+int swap_read_page(uint32_t slot, void* page) {
+    if (!swap_enabled || slot >= swap_dev.slots || !slot_used(slot)) {
+        return -1;
+    }
+    if (swap_dev.read(swap_dev.ctx, slot, page) != 0) {
+        stats.read_errors++;
+        return -1;
+    }
+    stats.pages_in++;
+    return 0;
+}
+
+int swap_slot_dup(uint32_t slot) {
+    if (!swap_enabled || slot >= swap_dev.slots || !slot_used(slot) ||
+        slot_refs[slot] == SWAP_MAX_SHARES) {
+        return -1;
+    }
+    slot_refs[slot]++;
+    return 0;
+}
+
+void swap_slot_put(uint32_t slot) {
+    if (!swap_enabled || slot >= swap_dev.slots || !slot_used(slot)) {
+        return;
+    }
+    if (--slot_refs[slot] == 0) {
+        release_slot(slot);
+    }
+}
+
+/* Wake kswapd, or just flag the work when it is not running */
+static void kswapd_kick(void) {
+    if (kswapd) {
+        process_post_event(kswapd, &kswapd_wake);
+    } else {
+        kswapd_wake = 1;
+    }
+}
+
+void swap_pressure(uint32_t free_frames, uint32_t frames) {
+    if (!swap_enabled) {
+        return;
+    }
+
+    if (free_frames < stats.wmark_low + frames && !kswapd_wake) {
+        stats.kswapd_wakeups++;
+        kswapd_kick();
+    }
+    if (free_frames < stats.wmark_min + frames) {
+        swap_direct_reclaim(frames);
+    }
+}
+
+uint32_t swap_direct_reclaim(uint32_t frames) {
+    if (!swap_enabled) {
+        return 0;
+    }
+    stats.direct_reclaims++;
+    return paging_reclaim(frames > SWAP_BATCH ? frames : SWAP_BATCH);
+}
+
+uint32_t swap_balance(void) {
+    kswapd_wake = 0;
+    if (!swap_enabled) {
+        return 0;
+    }
+
+    stats.kswapd_runs++;
+    uint32_t freed = 0;
+    for (;;) {
+        buddy_stats_t fs;
+        memory_get_frame_stats(&fs);
+        if (fs.free_frames >= stats.wmark_high) {
+            break;
+        }
+
+        uint32_t want = stats.wmark_high - fs.free_frames;
+        uint32_t got = paging_reclaim(want < SWAP_BATCH ? want : SWAP_BATCH);
+        if (got == 0) {
+            break;
+        }
+        freed += got;
+    }
+    return freed;
+}
+
+int swap_kswapd_pending(void) {
+    return kswapd_wake;
+}
+
+/**
+ * kswapd: sleep until the allocator reports pressure, then rebalance
+ */
+static void kswapd_main(void) {
+    for (;;) {
+        if (process_wait_event_until(&kswapd_wake, UINT64_MAX) > 0) {
+            swap_balance();
+        }
+    }
+}
+
+void swap_start_kswapd(void) {
+    if (swap_enabled && !kswapd) {
+        kswapd = process_create(kswapd_main, 1);
+    }
+}
+
+void swap_get_stats(swap_stats_t* out) {
+    if (out) {
+        *out = stats;
+    }
+}
+
+#ifndef AURORA_STANDALONE
+/* Swap partition on a storage device; page 0 holds the swap header.
+ * A batch is gathered into the bounce frames so it goes out as one
+ * request; a writer that finds them busy writes page by page. */
+static struct {
+    storage_device_t* dev;
+    uint64_t first_lba;
+    uint32_t sectors_per_page;
+    uint8_t* bounce;                /* SWAP_BATCH contiguous pages */
+    spinlock_t bounce_lock;
+} swap_part;
+
+static int storage_swap_read(void* ctx, uint32_t slot, void* page) {
+    (void)ctx;
+    uint64_t lba = swap_part.first_lba + (uint64_t)slot * swap_part.sectors_per_page;
+    return storage_read_sectors(swap_part.dev, lba, swap_part.sectors_per_page, (uint8_t*)page);
+}
+
+static int storage_swap_write(void* ctx, uint32_t slot, void* const* pages, uint32_t count) {
+    (void)ctx;
+    uint64_t lba = swap_part.first_lba + (uint64_t)slot * swap_part.sectors_per_page;
+
+    if (count > 1 && count <= SWAP_BATCH && swap_part.bounce &&
+        spinlock_try_acquire(&swap_part.bounce_lock)) {
+        for (uint32_t i = 0; i < count; i++) {
+            const uint32_t* src = (const uint32_t*)pages[i];
+            uint32_t* dst = (uint32_t*)(swap_part.bounce + (size_t)i * PAGE_SIZE);
+            for (uint32_t w = 0; w < PAGE_SIZE / sizeof(uint32_t); w++) {
+                dst[w] = src[w];
+            }
+        }
+        int ret = storage_write_sectors(swap_part.dev, lba, count * swap_part.sectors_per_page,
+                                        swap_part.bounce);
+        spinlock_release(&swap_part.bounce_lock);
+        return ret == 0 ? 0 : -1;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (storage_write_sectors(swap_part.dev, lba, swap_part.sectors_per_page,
+                                  (const uint8_t*)pages[i]) != 0) {
+            return -1;
+        }
+        lba += swap_part.sectors_per_page;
+    }
+    return 0;
+}
+
+int swap_probe_storage(void) {
+    int devices = storage_get_device_count();
+    for (int d = 0; d < devices; d++) {
+        storage_device_t* dev = storage_get_device((uint8_t)d);
+        if (!dev || dev->sector_size == 0 || PAGE_SIZE % dev->sector_size) {
+            continue;
+        }
+
+        storage_partition_t parts[4];
+        int count = storage_read_partition_table(dev, parts, 4);
+        for (int p = 0; p < count; p++) {
+            if (parts[p].type != PART_TYPE_LINUX_SWAP) {
+                continue;
+            }
+
+            uint32_t spp = PAGE_SIZE / dev->sector_size;
+            uint32_t pages = parts[p].num_sectors / spp;
+            if (pages < 2) {
+                continue;
+            }
+
+            swap_part.dev = dev;
+            swap_part.first_lba = parts[p].start_lba + spp;
+            swap_part.sectors_per_page = spp;
+            spinlock_init(&swap_part.bounce_lock);
+            if (!swap_part.bounce) {
+                uint32_t order = 0;
+                while ((1u << order) < SWAP_BATCH) {
+                    order++;
+                }
+                swap_part.bounce = (uint8_t*)frame_alloc(order);
+            }
+
+            swap_device_t sd = {
+                .slots = pages - 1,
+                .ctx = &swap_part,
+                .read = storage_swap_read,
+                .write = storage_swap_write,
+            };
+            return swap_init(&sd);
+        }
+    }
+    return -1;
+}
+#else
+int swap_probe_storage(void) {
+    return -1;
+}
+#endif
@@ -0,0 +1,146 @@
+/**
+ * Aurora OS - Swap Space Header
+ *
+ * Swap slot allocation, batched page I/O to a swap device and the
+ * watermark-driven background reclaimer (kswapd). Choosing which pages
+ * to evict is paging_reclaim()'s job; this layer only stores them.
+ */
+
+#ifndef AURORA_SWAP_H
+#define AURORA_SWAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Pages evicted per writeout batch */
+#define SWAP_BATCH          32
+
+/* Slot numbers must fit the 20-bit frame field of a page table entry */
+#define SWAP_MAX_SLOTS      (1u << 20)
+
+/* A slot may be referenced by this many swap entries (forked PTEs) */
+#define SWAP_MAX_SHARES     0xFF
+
+/**
+ * Swap device: an array of page-sized slots
+ * write() stores count pages in consecutive slots starting at slot, so a
+ * batch reaches the device as one sequential request.
+ */
+typedef struct {
+    uint32_t slots;
+    void* ctx;
+    int (*read)(void* ctx, uint32_t slot, void* page);
+    int (*write)(void* ctx, uint32_t slot, void* const* pages, uint32_t count);
+} swap_device_t;
+
+/* Swap statistics */
+typedef struct {
+    uint32_t total_slots;
+    uint32_t used_slots;
+    uint32_t wmark_min;             /* Free frames below which allocations reclaim directly */
+    uint32_t wmark_low;             /* Free frames below which kswapd is woken */
+    uint32_t wmark_high;            /* Free frames kswapd reclaims up to */
+    uint64_t pages_out;
+    uint64_t pages_in;
+    uint64_t write_requests;        /* Device write calls */
+    uint64_t write_errors;
+    uint64_t read_errors;
+    uint64_t kswapd_wakeups;
+    uint64_t kswapd_runs;
+    uint64_t direct_reclaims;
+} swap_stats_t;
+
+/**
+ * Activate a swap device
+ * Devices larger than SWAP_MAX_SLOTS pages are truncated. Watermarks
+ * default to fractions of the managed frames.
+ * @param dev Device description (copied)
+ * @return 0 on success, -1 if swap is already active or on allocation failure
+ */
+int swap_init(const swap_device_t* dev);
+
+/**
+ * Activate the first Linux swap partition found on the storage devices
+ * @return 0 on success, -1 if there is none
+ */
+int swap_probe_storage(void);
+
+/**
+ * Check whether a swap device is active
+ */
+int swap_active(void);
+
+/**
+ * Number of unused swap slots (0 when swap is inactive)
+ */
+uint32_t swap_free_slots(void);
+
+/**
+ * Set the reclaim watermarks, in free frames (min <= low <= high)
+ */
+void swap_set_watermarks(uint32_t min, uint32_t low, uint32_t high);
+
+/**
+ * Write pages to newly allocated slots
+ * Slots are handed out in runs of free neighbours, each run written with
+ * one device request.
+ * @param pages Page addresses
+ * @param count Number of pages
+ * @param slots Output slot of each page, each with one reference
+ * @return 0 on success, -1 if swap is full or the device failed (no
+ *         slots are held on failure)
+ */
+int swap_write_pages(void* const* pages, uint32_t count, uint32_t* slots);
+
+/**
+ * Read a slot's page
+ * @return 0 on success, -1 on a bad slot or device error
+ */
+int swap_read_page(uint32_t slot, void* page);
+
+/**
+ * Take another reference to a slot (a forked swap entry)
+ * @return 0 on success, -1 if the slot is free or saturated
+ */
+int swap_slot_dup(uint32_t slot);
+
+/**
+ * Drop a reference to a slot, freeing it at zero
+ */
+void swap_slot_put(uint32_t slot);
+
+/**
+ * Account for an allocation of frames with free_frames currently free
+ * Wakes kswapd below the low watermark and reclaims synchronously when
+ * the allocation would dip below the min watermark.
+ */
+void swap_pressure(uint32_t free_frames, uint32_t frames);
+
+/**
+ * Reclaim synchronously after an allocation failed
+ * @return Frames freed
+ */
+uint32_t swap_direct_reclaim(uint32_t frames);
+
+/**
+ * One kswapd pass: reclaim until the high watermark is met
+ * @return Frames freed
+ */
+uint32_t swap_balance(void);
+
+/**
+ * Check whether kswapd has been woken and not yet run
+ */
+int swap_kswapd_pending(void);
+
+/**
+ * Start the kswapd kernel process
+ */
+void swap_start_kswapd(void);
+
+/**
+ * Get swap statistics
+ */
+void swap_get_stats(swap_stats_t* stats);
+
+#endif /* AURORA_SWAP_H */
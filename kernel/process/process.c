@@ -5,7 +5,13 @@
  */
 
 #include "process.h"
+#include "runqueue.h"
 #include "../memory/memory.h"
+#include "../smp/smp.h"
+#include "../core/timing_system.h"
+#include "../core/ktimer.h"
+#include "../interrupt/interrupt.h"
+#include "../../filesystem/vfs/fdtable.h"
 #include <stddef.h>
 
 /* Process table */
@@ -14,10 +20,22 @@
 
 static process_t process_table[MAX_PROCESSES];
 static process_t* current_process = NULL;
-static process_t* ready_queue_head = NULL;
-static process_t* ready_queue_tail = NULL;
+static process_t* idle_task = NULL;
 static uint32_t next_pid = 1;
 static uint32_t scheduler_enabled = 0;
+static volatile uint8_t need_resched[MAX_CPUS];
+
+/* Scheduler tick, only armed while a CPU runs something other than its
+ * idle process so idle CPUs take no timer interrupts */
+#define SCHED_TICK_US 1000
+static ktimer_t sched_tick_timer[MAX_CPUS];
+
+/**
+ * Scheduler clock in nanoseconds
+ */
+static uint64_t sched_clock(void) {
+    return timing_get_microseconds() * 1000;
+}
 
 /**
  * Find free process slot
@@ -31,45 +49,6 @@ static process_t* alloc_process(void) {
     return NULL;
 }
 
-/**
- * Add process to ready queue
- */
-static void enqueue_process(process_t* process) {
-    if (!process) {
-        return;
-    }
-    
-    process->next = NULL;
-    process->state = PROCESS_READY;
-    
-    if (!ready_queue_head) {
-        ready_queue_head = process;
-        ready_queue_tail = process;
-    } else {
-        ready_queue_tail->next = process;
-        ready_queue_tail = process;
-    }
-}
-
-/**
- * Remove process from ready queue
- */
-static process_t* dequeue_process(void) {
-    if (!ready_queue_head) {
-        return NULL;
-    }
-    
-    process_t* process = ready_queue_head;
-    ready_queue_head = process->next;
-    
-    if (!ready_queue_head) {
-        ready_queue_tail = NULL;
-    }
-    
-    process->next = NULL;
-    return process;
-}
-
 /**
  * Idle process - runs when no other process is ready
  */
@@ -93,18 +72,24 @@ void process_init(void) {
         process_table[i].priority = 0;
         process_table[i].exit_status = 0;
         process_table[i].wait_target = 0;
+        process_table[i].cpu = 0;
+        rb_clear_node(&process_table[i].run_node);
+        process_table[i].files = NULL;
         process_table[i].next = NULL;
     }
     
     current_process = NULL;
-    ready_queue_head = NULL;
-    ready_queue_tail = NULL;
+    idle_task = NULL;
     next_pid = 1;
+    runqueue_init();
     
-    /* Create idle process */
+    /* Create idle process; it runs when a CPU's runqueue is empty and
+     * never sits on one itself */
     process_t* idle = process_create(idle_process, 0);
     if (idle) {
+        runqueue_remove(idle);
         idle->state = PROCESS_READY;
+        idle_task = idle;
         current_process = idle;
     }
 }
@@ -137,8 +122,22 @@ process_t* process_create(void (*entry)(void), uint32_t priority) {
     process->priority = priority;
     process->exit_status = 0;
     process->wait_target = 0;
+    process->cpu = smp_get_current_cpu_id();
+    process->vruntime = 0;
+    process->exec_start = 0;
+    process->sum_exec_runtime = 0;
+    rb_clear_node(&process->run_node);
+    process->sleep_timer = NULL;
     process->next = NULL;
     
+    /* Inherit the creator's descriptors, as fork() does */
+    process->files = fdtable_fork(fdtable_current());
+    if (!process->files) {
+        kfree(stack);
+        process->pid = 0;
+        return NULL;
+    }
+    
     /* Setup stack pointer (stack grows downward) - 64-bit aligned */
     uint64_t* stack_top = (uint64_t*)((uint8_t*)stack + PROCESS_STACK_SIZE);
     
@@ -148,8 +147,10 @@ process_t* process_create(void (*entry)(void), uint32_t priority) {
     
     process->stack_ptr = (void*)stack_top;
     
-    /* Add to ready queue */
-    enqueue_process(process);
+    /* Queue on a CPU */
+    if (runqueue_wake(process, RQ_WAKE_NEW, sched_clock())) {
+        need_resched[smp_get_current_cpu_id()] = 1;
+    }
     
     return process;
 }
@@ -174,6 +175,17 @@ void process_terminate(uint32_t pid) {
     /* Save the parent PID before clearing */
     uint32_t parent_pid = process->ppid;
     
+    /* Take it off its runqueue if it was waiting to run */
+    if (process->state == PROCESS_READY) {
+        runqueue_remove(process);
+    }
+    
+    /* A sleeper's timer lives on the stack freed below */
+    if (process->sleep_timer) {
+        ktimer_cancel(process->sleep_timer);
+        process->sleep_timer = NULL;
+    }
+    
     /* Free process resources */
     if (process->stack_ptr) {
         /* Calculate stack base from stack pointer - 64-bit compatible */
@@ -181,6 +193,8 @@ void process_terminate(uint32_t pid) {
         void* stack_base = (void*)(stack_addr & ~((uintptr_t)PROCESS_STACK_SIZE - 1));
         kfree(stack_base);
     }
+    fdtable_destroy(process->files);
+    process->files = NULL;
     
     /* Mark process as terminated (but keep pid/ppid for wait() to collect) */
     process->state = PROCESS_TERMINATED;
@@ -196,9 +210,8 @@ void process_terminate(uint32_t pid) {
                 if (process_table[i].wait_target == 0 || 
                     process_table[i].wait_target == pid) {
                     /* Wake up the parent */
-                    process_table[i].state = PROCESS_READY;
                     process_table[i].wait_target = 0;
-                    enqueue_process(&process_table[i]);
+                    process_wake(&process_table[i]);
                     break;
                 }
             }
@@ -212,6 +225,78 @@ void process_terminate(uint32_t pid) {
     }
 }
 
+/**
+ * Make a blocked or waiting process runnable
+ */
+void process_wake(process_t* process) {
+    if (!process || (process->state != PROCESS_BLOCKED &&
+                     process->state != PROCESS_WAITING)) {
+        return;
+    }
+    
+    if (runqueue_wake(process, 0, sched_clock())) {
+        need_resched[smp_get_current_cpu_id()] = 1;
+    }
+}
+
+/**
+ * Kernel timer callback ending a timed sleep
+ */
+static void process_sleep_timeout(void* data) {
+    process_wake((process_t*)data);
+}
+
+/**
+ * Block the current process until a deadline or a posted event
+ */
+int process_wait_event_until(volatile uint32_t* event, uint64_t deadline_us) {
+    process_t* self = current_process;
+    
+    if (!scheduler_enabled || !self || self == idle_task) {
+        return -1;
+    }
+    
+    ktimer_t timer;
+    ktimer_setup(&timer, process_sleep_timeout, self);
+    self->sleep_timer = &timer;
+    
+    /* Loop: another wakeup may come before the deadline */
+    while (!(event && __atomic_load_n(event, __ATOMIC_ACQUIRE)) &&
+           timing_get_microseconds() < deadline_us) {
+        self->state = PROCESS_BLOCKED;
+        
+        /* A poster that saw us running did not wake us: recheck once
+         * BLOCKED is visible */
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (event && __atomic_load_n(event, __ATOMIC_ACQUIRE)) {
+            self->state = PROCESS_RUNNING;
+            break;
+        }
+        
+        ktimer_add(&timer, deadline_us);
+        scheduler_schedule();
+        ktimer_cancel(&timer);
+    }
+    
+    self->sleep_timer = NULL;
+    return event ? __atomic_exchange_n(event, 0, __ATOMIC_ACQ_REL) != 0 : 0;
+}
+
+/**
+ * Block the current process until a deadline
+ */
+int process_sleep_until(uint64_t deadline_us) {
+    return process_wait_event_until(NULL, deadline_us) < 0 ? -1 : 0;
+}
+
+/**
+ * Set an event and wake its waiter
+ */
+void process_post_event(process_t* process, volatile uint32_t* event) {
+    __atomic_store_n(event, 1, __ATOMIC_SEQ_CST);
+    process_wake(process);
+}
+
 /**
  * Yield CPU to another process
  */
@@ -220,22 +305,71 @@ void process_yield(void) {
         return;
     }
     
-    /* Save current process state and schedule next */
-    if (current_process && current_process->state == PROCESS_RUNNING) {
-        current_process->state = PROCESS_READY;
-        enqueue_process(current_process);
-    }
-    
+    /* scheduler_schedule() requeues the current process */
     scheduler_schedule();
 }
 
+/**
+ * RQ_RESCHED_VECTOR handler: another CPU queued a wakeup that should
+ * preempt this one (or end its idling)
+ */
+static void scheduler_resched_ipi(void) {
+    need_resched[smp_get_current_cpu_id()] = 1;
+    apic_eoi();
+    scheduler_tick();
+}
+
+/**
+ * Scheduler tick timer callback: keep ticking while there is work; the
+ * timer interrupt calls scheduler_tick() once the timers have run
+ */
+static void sched_tick_fire(void* data) {
+    uint32_t cpu = (uint32_t)(uintptr_t)data;
+    
+    ktimer_add_on(&sched_tick_timer[cpu], cpu, timing_get_microseconds() + SCHED_TICK_US);
+}
+
+/**
+ * Start the scheduler tick when a CPU picks up work, stop it when the CPU
+ * goes idle
+ */
+static void sched_tick_update(uint32_t cpu, process_t* next) {
+    if (next && next != idle_task) {
+        if (!ktimer_pending(&sched_tick_timer[cpu])) {
+            ktimer_add_on(&sched_tick_timer[cpu], cpu, timing_get_microseconds() + SCHED_TICK_US);
+        }
+    } else {
+        ktimer_cancel(&sched_tick_timer[cpu]);
+    }
+}
+
 /**
  * Initialize scheduler
  */
 void scheduler_init(void) {
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        ktimer_setup(&sched_tick_timer[cpu], sched_tick_fire, (void*)(uintptr_t)cpu);
+    }
+    
+    register_interrupt_handler(RQ_RESCHED_VECTOR, scheduler_resched_ipi);
     scheduler_enabled = 1;
 }
 
+/**
+ * Timer tick: end the running process's slice when it is used up, or
+ * act on a wakeup that asked for preemption
+ */
+void scheduler_tick(void) {
+    if (!scheduler_enabled) {
+        return;
+    }
+    
+    uint32_t cpu = smp_get_current_cpu_id();
+    if (runqueue_tick(cpu, sched_clock()) || need_resched[cpu]) {
+        scheduler_schedule();
+    }
+}
+
 /**
  * CPU context structure for context switching
  * Uses 64-bit registers for long mode compatibility
@@ -383,28 +517,42 @@ static void switch_context(process_t* from, process_t* to) {
 }
 
 /**
- * Schedule next process to run (Round-robin scheduling)
+ * Schedule next process to run
+ * Requeues the running process, evens out load with the other CPUs,
+ * then runs the process with the smallest virtual runtime on this CPU
+ * (stealing from other CPUs when it has none), falling back to the idle
+ * process.
  */
 void scheduler_schedule(void) {
     if (!scheduler_enabled) {
         return;
     }
     
-    /* Get next process from ready queue */
-    process_t* next = dequeue_process();
+    uint32_t cpu = smp_get_current_cpu_id();
+    uint64_t now = sched_clock();
+    need_resched[cpu] = 0;
+    
+    if (current_process && current_process->state == PROCESS_RUNNING &&
+        current_process != idle_task) {
+        runqueue_put_prev(current_process, now);
+    }
+    
+    runqueue_balance(cpu);
+    process_t* next = runqueue_pick_next(cpu, now);
     
     if (!next) {
         /* No process ready, keep current or idle */
         if (current_process && current_process->state == PROCESS_RUNNING) {
             return;
         }
-        /* Find idle process (PID 1) */
-        for (uint32_t i = 0; i < MAX_PROCESSES; i++) {
-            if (process_table[i].pid == 1) {
-                next = &process_table[i];
-                break;
-            }
-        }
+        next = idle_task;
+    }
+    
+    sched_tick_update(cpu, next);
+    
+    if (next == current_process) {
+        next->state = PROCESS_RUNNING;
+        return;
     }
     
     if (next) {
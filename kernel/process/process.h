@@ -8,6 +8,7 @@
 #define AURORA_PROCESS_H
 
 #include <stdint.h>
+#include "../core/rbtree.h"
 
 /* Process states */
 typedef enum {
@@ -18,6 +19,8 @@ typedef enum {
     PROCESS_TERMINATED
 } process_state_t;
 
+struct files_struct;
+
 /* Process control block */
 typedef struct process {
     uint32_t pid;
@@ -27,6 +30,14 @@ typedef struct process {
     uint32_t priority;
     int32_t exit_status;         /* Exit status when terminated */
     uint32_t wait_target;        /* PID being waited for (0 = any child) */
+    uint32_t cpu;                /* CPU whose runqueue holds it, or that last ran it */
+    uint32_t weight;             /* Load weight from its nice level */
+    uint64_t vruntime;           /* Weighted CPU time, ns (fair scheduler key) */
+    uint64_t exec_start;         /* When it last started running, ns */
+    uint64_t sum_exec_runtime;   /* Total CPU time, ns */
+    rb_node_t run_node;          /* Runqueue timeline link */
+    struct files_struct* files;  /* File descriptor table */
+    struct ktimer* sleep_timer;  /* Armed on its stack while it sleeps */
     struct process* next;
 } process_t;
 
@@ -36,6 +47,32 @@ process_t* process_create(void (*entry)(void), uint32_t priority);
 void process_terminate(uint32_t pid);
 void process_yield(void);
 
+/**
+ * Make a blocked or waiting process runnable
+ */
+void process_wake(process_t* process);
+
+/**
+ * Block the current process until a deadline (us since boot, as from
+ * timing_get_microseconds()), woken by a kernel timer
+ * @return 0 once the deadline has passed, -1 if the caller cannot block
+ *         (scheduler not running, or the idle process)
+ */
+int process_sleep_until(uint64_t deadline_us);
+
+/**
+ * Block the current process until *event is set by process_post_event()
+ * or a deadline passes, then clear the event
+ * @return 1 if the event was posted, 0 on timeout, -1 if the caller
+ *         cannot block
+ */
+int process_wait_event_until(volatile uint32_t* event, uint64_t deadline_us);
+
+/**
+ * Set an event and wake the process waiting on it
+ */
+void process_post_event(process_t* process, volatile uint32_t* event);
+
 /* Process wait/exec functions */
 int32_t process_wait(uint32_t pid, int32_t* status);
 int32_t process_exec(const char* path, char* const argv[]);
@@ -47,5 +84,6 @@ process_t* process_find_by_pid(uint32_t pid);
 /* Scheduler functions */
 void scheduler_init(void);
 void scheduler_schedule(void);
+void scheduler_tick(void);
 
 #endif /* AURORA_PROCESS_H */
@@ -0,0 +1,533 @@
+/**
+ * Aurora OS - Per-CPU Runqueues
+ *
+ * Each CPU owns a runqueue in its own cache line running a CFS-style
+ * fair scheduler (Linux's Completely Fair Scheduler):
+ *
+ *  - every process accumulates virtual runtime, its CPU time scaled by
+ *    RQ_NICE_0_WEIGHT / weight, so heavier processes age more slowly
+ *    and receive proportionally more CPU
+ *  - queued processes sit in a red-black tree keyed by vruntime and the
+ *    leftmost (cached) one runs next
+ *  - a slice is the process's weight share of the latency period, which
+ *    stretches to nr_running * min_granularity when crowded; the tick
+ *    preempts once the slice is used up
+ *  - a woken sleeper's vruntime is raised to at least min_vruntime minus
+ *    half a latency period: enough credit to preempt a CPU hog promptly,
+ *    not enough to bank a long sleep into a long monopoly
+ *  - a new process starts one virtual slice past min_vruntime
+ *
+ * min_vruntime only moves forward and tracks the smaller of the running
+ * and leftmost vruntimes. Migrating a process rebases its vruntime from
+ * the old queue's min_vruntime to the new one's.
+ *
+ * Across CPUs:
+ *
+ *  - woken and new processes join the CPU they last ran on unless it is
+ *    clearly busier than the least loaded CPU
+ *  - a CPU with nothing queued steals from the busiest other CPU, and
+ *    periodic balancing pulls from a CPU two or more processes busier
+ *  - a wakeup that should preempt another CPU sends it an IPI
+ *
+ * Each runqueue has its own lock, taken with interrupts off since
+ * timer callbacks wake processes. Only balancing holds two, taken in
+ * CPU index order. Queue lengths are read without the lock when
+ * choosing a CPU or a victim; a stale value only costs a less balanced
+ * choice.
+ */
+
+#include "runqueue.h"
+#include "../smp/smp.h"
+#include <stddef.h>
+
+typedef struct {
+    spinlock_t lock;
+    rb_root_t timeline;             /* Queued processes by vruntime */
+    process_t* curr;                /* Running process, NULL when idle */
+    uint64_t min_vruntime;
+    uint64_t slice_start;           /* curr's sum_exec_runtime when picked */
+    uint32_t load;                  /* Weight of the queued processes */
+    volatile uint32_t nr_queued;
+    runqueue_stats_t stats;
+} __attribute__((aligned(64))) runqueue_t;
+
+static runqueue_t runqueues[MAX_CPUS];
+static uint32_t nr_cpus = 1;
+static int stealing = 1;
+
+static runqueue_tunables_t tunables = {
+    .latency_ns = RQ_SCHED_LATENCY_NS,
+    .min_granularity_ns = RQ_MIN_GRANULARITY_NS,
+    .wakeup_granularity_ns = RQ_WAKEUP_GRANULARITY_NS,
+};
+
+/* Weight per nice level, -20..19: each level is ~10% CPU relative to its
+ * neighbour (the Linux sched_prio_to_weight table) */
+static const uint32_t nice_weights[40] = {
+    88761, 71755, 56483, 46273, 36291,
+    29154, 23254, 18705, 14949, 11916,
+     9548,  7620,  6100,  4904,  3906,
+     3121,  2501,  1991,  1586,  1277,
+     1024,   820,   655,   526,   423,
+      335,   272,   215,   172,   137,
+      110,    87,    70,    56,    45,
+       36,    29,    23,    18,    15,
+};
+
+int runqueue_priority_to_nice(uint32_t priority) {
+    int64_t nice = (int64_t)RQ_PRIORITY_NICE_0 - (int64_t)priority;
+    if (nice < -20) {
+        return -20;
+    }
+    return nice > 19 ? 19 : (int)nice;
+}
+
+uint32_t runqueue_nice_to_weight(int nice) {
+    if (nice < -20) {
+        nice = -20;
+    } else if (nice > 19) {
+        nice = 19;
+    }
+    return nice_weights[nice + 20];
+}
+
+/* vruntimes are compared by signed difference so they may wrap */
+static inline int64_t vdiff(uint64_t a, uint64_t b) {
+    return (int64_t)(a - b);
+}
+
+/* Scale real time to virtual time for a weight */
+static inline uint64_t to_virtual(uint64_t delta, uint32_t weight) {
+    if (weight == RQ_NICE_0_WEIGHT) {
+        return delta;
+    }
+    return delta * RQ_NICE_0_WEIGHT / weight;
+}
+
+static inline process_t* timeline_first(runqueue_t* rq) {
+    rb_node_t* node = rb_first(&rq->timeline);
+    return node ? rb_entry(node, process_t, run_node) : NULL;
+}
+
+static void update_min_vruntime(runqueue_t* rq) {
+    process_t* left = timeline_first(rq);
+    uint64_t v;
+
+    if (rq->curr) {
+        v = rq->curr->vruntime;
+        if (left && vdiff(left->vruntime, v) < 0) {
+            v = left->vruntime;
+        }
+    } else if (left) {
+        v = left->vruntime;
+    } else {
+        return;
+    }
+
+    if (vdiff(v, rq->min_vruntime) > 0) {
+        rq->min_vruntime = v;
+    }
+}
+
+/**
+ * Charge the running process for the time since it was last charged
+ */
+static void update_curr(runqueue_t* rq, uint64_t now) {
+    process_t* curr = rq->curr;
+    if (!curr) {
+        return;
+    }
+    if (now > curr->exec_start) {
+        uint64_t delta = now - curr->exec_start;
+        curr->sum_exec_runtime += delta;
+        curr->vruntime += to_virtual(delta, curr->weight);
+    }
+    curr->exec_start = now;
+    update_min_vruntime(rq);
+}
+
+static void enqueue(runqueue_t* rq, process_t* process) {
+    rb_node_t** link = &rq->timeline.node;
+    rb_node_t* parent = NULL;
+    int leftmost = 1;
+
+    /* Equal keys go right, so ties run in arrival order */
+    while (*link) {
+        parent = *link;
+        process_t* entry = rb_entry(parent, process_t, run_node);
+        if (vdiff(process->vruntime, entry->vruntime) < 0) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = 0;
+        }
+    }
+    rb_insert(&rq->timeline, &process->run_node, parent, link, leftmost);
+
+    rq->load += process->weight;
+    rq->nr_queued++;
+}
+
+static void dequeue(runqueue_t* rq, process_t* process) {
+    rb_erase(&rq->timeline, &process->run_node);
+    rq->load -= process->weight;
+    rq->nr_queued--;
+}
+
+/**
+ * Wall-clock slice for a process on a runqueue: its weight share of the
+ * latency period, the period stretching when min_granularity per process
+ * would not fit
+ * @param queued Non-zero if the process is already counted in rq->load
+ */
+static uint64_t sched_slice(runqueue_t* rq, const process_t* process, int queued) {
+    uint32_t nr = rq->nr_queued + (rq->curr ? 1 : 0) + (queued ? 0 : 1);
+    uint64_t load = rq->load + (rq->curr ? rq->curr->weight : 0) + (queued ? 0 : process->weight);
+    uint64_t period = tunables.latency_ns;
+
+    if (nr > tunables.latency_ns / tunables.min_granularity_ns) {
+        period = (uint64_t)nr * tunables.min_granularity_ns;
+    }
+    return load ? period * process->weight / load : period;
+}
+
+static inline uint32_t cpu_load(uint32_t cpu) {
+    return runqueues[cpu].nr_queued + (runqueues[cpu].curr ? 1 : 0);
+}
+
+void runqueue_init(void) {
+    nr_cpus = smp_get_cpu_count();
+    if (nr_cpus == 0 || nr_cpus > MAX_CPUS) {
+        nr_cpus = nr_cpus ? MAX_CPUS : 1;
+    }
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        runqueue_t* rq = &runqueues[cpu];
+        spinlock_init(&rq->lock);
+        rb_init(&rq->timeline);
+        rq->curr = NULL;
+        rq->min_vruntime = 0;
+        rq->slice_start = 0;
+        rq->load = 0;
+        rq->nr_queued = 0;
+        rq->stats = (runqueue_stats_t){0};
+    }
+}
+
+void runqueue_set_stealing(int enabled) {
+    stealing = enabled;
+}
+
+void runqueue_set_tunables(const runqueue_tunables_t* t) {
+    if (!t) {
+        return;
+    }
+    if (t->latency_ns) {
+        tunables.latency_ns = t->latency_ns;
+    }
+    if (t->min_granularity_ns) {
+        tunables.min_granularity_ns = t->min_granularity_ns;
+    }
+    if (t->wakeup_granularity_ns) {
+        tunables.wakeup_granularity_ns = t->wakeup_granularity_ns;
+    }
+}
+
+void runqueue_get_tunables(runqueue_tunables_t* t) {
+    if (t) {
+        *t = tunables;
+    }
+}
+
+uint32_t runqueue_select_cpu(const process_t* process) {
+    uint32_t prev = process->cpu < nr_cpus ? process->cpu : smp_get_current_cpu_id();
+    uint32_t best = prev;
+    uint32_t best_load = cpu_load(prev);
+
+    for (uint32_t cpu = 0; cpu < nr_cpus; cpu++) {
+        uint32_t load = cpu_load(cpu);
+        if (load < best_load) {
+            best = cpu;
+            best_load = load;
+        }
+    }
+
+    /* Stay put for the warm cache unless the imbalance is real */
+    return cpu_load(prev) < best_load + 2 ? prev : best;
+}
+
+int runqueue_wake(process_t* process, int flags, uint64_t now) {
+    if (!process) {
+        return 0;
+    }
+
+    uint32_t prev = process->cpu;
+    uint32_t cpu = runqueue_select_cpu(process);
+    runqueue_t* rq = &runqueues[cpu];
+
+    irqflags_t irq = spinlock_acquire_irqsave(&rq->lock);
+    update_curr(rq, now);
+    process->weight = runqueue_nice_to_weight(runqueue_priority_to_nice(process->priority));
+
+    if (flags & RQ_WAKE_NEW) {
+        process->vruntime = rq->min_vruntime +
+                            to_virtual(sched_slice(rq, process, 0), process->weight);
+    } else {
+        if (prev != cpu && prev < nr_cpus) {
+            process->vruntime += rq->min_vruntime - runqueues[prev].min_vruntime;
+        }
+        uint64_t floor = rq->min_vruntime - tunables.latency_ns / 2;
+        if (vdiff(process->vruntime, floor) < 0) {
+            process->vruntime = floor;
+        }
+    }
+
+    process->state = PROCESS_READY;
+    process->cpu = cpu;
+    enqueue(rq, process);
+    rq->stats.enqueues++;
+
+    int preempt = 1;
+    if (rq->curr) {
+        uint64_t gran = to_virtual(tunables.wakeup_granularity_ns, process->weight);
+        preempt = vdiff(rq->curr->vruntime, process->vruntime) > (int64_t)gran;
+        if (preempt) {
+            rq->stats.wakeup_preempts++;
+        }
+    }
+
+    int local = cpu == smp_get_current_cpu_id();
+    if (preempt && !local) {
+        rq->stats.ipis++;
+    }
+    spinlock_release_irqrestore(&rq->lock, irq);
+
+    if (preempt && !local) {
+        apic_send_ipi(cpu, RQ_RESCHED_VECTOR);
+    }
+    return preempt && local;
+}
+
+void runqueue_put_prev(process_t* process, uint64_t now) {
+    if (!process) {
+        return;
+    }
+
+    uint32_t cpu = smp_get_current_cpu_id();
+    runqueue_t* rq = &runqueues[cpu];
+
+    irqflags_t flags = spinlock_acquire_irqsave(&rq->lock);
+    if (rq->curr == process) {
+        update_curr(rq, now);
+        rq->curr = NULL;
+    }
+    process->state = PROCESS_READY;
+    process->cpu = cpu;
+    enqueue(rq, process);
+    rq->stats.enqueues++;
+    spinlock_release_irqrestore(&rq->lock, flags);
+}
+
+int runqueue_remove(process_t* process) {
+    if (!process || process->cpu >= nr_cpus) {
+        return -1;
+    }
+
+    runqueue_t* rq = &runqueues[process->cpu];
+    int ret = -1;
+    irqflags_t flags = spinlock_acquire_irqsave(&rq->lock);
+    if (rq->curr == process) {
+        rq->curr = NULL;
+        ret = 0;
+    } else if (rb_node_linked(&process->run_node)) {
+        dequeue(rq, process);
+        ret = 0;
+    }
+    spinlock_release_irqrestore(&rq->lock, flags);
+    return ret;
+}
+
+/**
+ * Detach the process furthest from running on a victim CPU, with its
+ * vruntime made relative to the victim's min_vruntime
+ * Caller holds the victim's lock.
+ */
+static process_t* detach_last(runqueue_t* src) {
+    rb_node_t* node = rb_last(&src->timeline);
+    if (!node) {
+        return NULL;
+    }
+    process_t* process = rb_entry(node, process_t, run_node);
+    dequeue(src, process);
+    process->vruntime -= src->min_vruntime;
+    src->stats.stolen++;
+    return process;
+}
+
+/**
+ * Take a waiting process from the busiest other CPU and run it here
+ */
+static process_t* steal(uint32_t cpu, uint64_t now) {
+    uint32_t victim = cpu;
+    uint32_t most = 0;
+
+    for (uint32_t c = 0; c < nr_cpus; c++) {
+        if (c != cpu && runqueues[c].nr_queued > most) {
+            victim = c;
+            most = runqueues[c].nr_queued;
+        }
+    }
+    if (victim == cpu) {
+        return NULL;
+    }
+
+    runqueue_t* src = &runqueues[victim];
+    irqflags_t flags = spinlock_acquire_irqsave(&src->lock);
+    process_t* process = detach_last(src);
+    spinlock_release_irqrestore(&src->lock, flags);
+    if (!process) {
+        return NULL;
+    }
+
+    runqueue_t* rq = &runqueues[cpu];
+    flags = spinlock_acquire_irqsave(&rq->lock);
+    process->vruntime += rq->min_vruntime;
+    process->cpu = cpu;
+    process->exec_start = now;
+    rq->curr = process;
+    rq->slice_start = process->sum_exec_runtime;
+    update_min_vruntime(rq);
+    rq->stats.steals++;
+    rq->stats.picks++;
+    spinlock_release_irqrestore(&rq->lock, flags);
+    return process;
+}
+
+process_t* runqueue_pick_next(uint32_t cpu, uint64_t now) {
+    if (cpu >= nr_cpus) {
+        return NULL;
+    }
+
+    runqueue_t* rq = &runqueues[cpu];
+    irqflags_t flags = spinlock_acquire_irqsave(&rq->lock);
+    if (rq->curr) {
+        /* It blocked without being requeued */
+        update_curr(rq, now);
+        rq->curr = NULL;
+    }
+
+    process_t* process = timeline_first(rq);
+    if (process) {
+        dequeue(rq, process);
+        process->exec_start = now;
+        rq->curr = process;
+        rq->slice_start = process->sum_exec_runtime;
+        update_min_vruntime(rq);
+        rq->stats.picks++;
+    }
+    spinlock_release_irqrestore(&rq->lock, flags);
+
+    if (!process && stealing && nr_cpus > 1) {
+        process = steal(cpu, now);
+    }
+    return process;
+}
+
+int runqueue_tick(uint32_t cpu, uint64_t now) {
+    if (cpu >= nr_cpus) {
+        return 0;
+    }
+
+    /* CPUs running a lone process never reschedule, so balance here too */
+    runqueue_balance(cpu);
+
+    runqueue_t* rq = &runqueues[cpu];
+    int resched = 0;
+    irqflags_t flags = spinlock_acquire_irqsave(&rq->lock);
+
+    process_t* curr = rq->curr;
+    if (!curr) {
+        resched = rq->nr_queued != 0;
+    } else {
+        update_curr(rq, now);
+        if (rq->nr_queued) {
+            uint64_t ideal = sched_slice(rq, curr, 1);
+            uint64_t ran = curr->sum_exec_runtime - rq->slice_start;
+
+            if (ran > ideal) {
+                resched = 1;
+            } else if (ran >= tunables.min_granularity_ns) {
+                /* Also yield once far enough ahead of the leftmost process */
+                process_t* left = timeline_first(rq);
+                resched = vdiff(curr->vruntime, left->vruntime) > (int64_t)ideal;
+            }
+            if (resched) {
+                rq->stats.tick_preempts++;
+            }
+        }
+    }
+
+    spinlock_release_irqrestore(&rq->lock, flags);
+    return resched;
+}
+
+int runqueue_balance(uint32_t cpu) {
+    if (cpu >= nr_cpus || nr_cpus < 2 || !stealing) {
+        return 0;
+    }
+
+    /* Between processes the previous one has been requeued and curr is
+     * NULL; at a tick curr is the running process. Either way cpu_load()
+     * is this CPU's share. */
+    uint32_t busiest = cpu;
+    uint32_t most = cpu_load(cpu) + 1;
+    for (uint32_t c = 0; c < nr_cpus; c++) {
+        if (c != cpu && runqueues[c].nr_queued && cpu_load(c) > most) {
+            busiest = c;
+            most = cpu_load(c);
+        }
+    }
+    if (busiest == cpu) {
+        return 0;
+    }
+
+    runqueue_t* rq = &runqueues[cpu];
+    runqueue_t* src = &runqueues[busiest];
+    runqueue_t* first = cpu < busiest ? rq : src;
+    runqueue_t* second = cpu < busiest ? src : rq;
+    irqflags_t flags = spinlock_acquire_irqsave(&first->lock);
+    spinlock_acquire(&second->lock);
+
+    /* Recheck under the locks */
+    process_t* process = NULL;
+    if (cpu_load(busiest) >= cpu_load(cpu) + 2) {
+        process = detach_last(src);
+    }
+    if (process) {
+        process->vruntime += rq->min_vruntime;
+        process->cpu = cpu;
+        enqueue(rq, process);
+        rq->stats.pulled++;
+    }
+
+    spinlock_release(&second->lock);
+    spinlock_release_irqrestore(&first->lock, flags);
+    return process != NULL;
+}
+
+uint32_t runqueue_nr_queued(uint32_t cpu) {
+    return cpu < nr_cpus ? runqueues[cpu].nr_queued : 0;
+}
+
+void runqueue_get_stats(uint32_t cpu, runqueue_stats_t* stats) {
+    if (!stats || cpu >= MAX_CPUS) {
+        return;
+    }
+    runqueue_t* rq = &runqueues[cpu];
+    irqflags_t flags = spinlock_acquire_irqsave(&rq->lock);
+    *stats = rq->stats;
+    stats->nr_queued = rq->nr_queued;
+    stats->load_weight = rq->load;
+    stats->min_vruntime = rq->min_vruntime;
+    spinlock_release_irqrestore(&rq->lock, flags);
+}
@@ -0,0 +1,157 @@
+/**
+ * Aurora OS - Per-CPU Runqueue Header
+ *
+ * One fair-scheduling runqueue per CPU: processes are ordered by
+ * weighted virtual runtime in a red-black tree, with work stealing by
+ * idle CPUs and IPI kicks for cross-CPU wakeups. Times are nanoseconds
+ * from the caller's clock.
+ */
+
+#ifndef AURORA_RUNQUEUE_H
+#define AURORA_RUNQUEUE_H
+
+#include <stdint.h>
+#include "process.h"
+
+/* Default tunables (Linux CFS defaults for one CPU) */
+#define RQ_SCHED_LATENCY_NS         6000000ull  /* Period in which every runnable process runs */
+#define RQ_MIN_GRANULARITY_NS       750000ull   /* Shortest slice before tick preemption */
+#define RQ_WAKEUP_GRANULARITY_NS    1000000ull  /* vruntime lead a wakeup needs to preempt */
+
+/* Load weight of a nice 0 process; each nice level is ~1.25x */
+#define RQ_NICE_0_WEIGHT    1024
+
+/* process_t.priority that maps to nice 0; each step up is one nice level
+ * more favoured, each step down one level less (clamped to -20..19) */
+#define RQ_PRIORITY_NICE_0  20
+
+/* IPI vector that kicks a CPU to reschedule for a wakeup */
+#define RQ_RESCHED_VECTOR   0xF1
+
+/* runqueue_wake() flags */
+#define RQ_WAKE_NEW         0x1         /* Newly created, not a sleeper */
+
+/* Scheduling tunables, ns */
+typedef struct {
+    uint64_t latency_ns;
+    uint64_t min_granularity_ns;
+    uint64_t wakeup_granularity_ns;
+} runqueue_tunables_t;
+
+/* Runqueue statistics for one CPU */
+typedef struct {
+    uint32_t nr_queued;             /* Processes waiting on this CPU */
+    uint32_t load_weight;           /* Sum of their weights */
+    uint64_t min_vruntime;
+    uint64_t enqueues;
+    uint64_t picks;                 /* Processes handed out to run */
+    uint64_t steals;                /* Processes this CPU took from another */
+    uint64_t stolen;                /* Processes other CPUs took from this one */
+    uint64_t pulled;                /* Processes this CPU pulled when balancing */
+    uint64_t ipis;                  /* Wakeup IPIs sent to this CPU */
+    uint64_t wakeup_preempts;       /* Wakeups that preempted the running process */
+    uint64_t tick_preempts;         /* Ticks that ended a slice */
+} runqueue_stats_t;
+
+/**
+ * Nice level for a process priority (see RQ_PRIORITY_NICE_0)
+ */
+int runqueue_priority_to_nice(uint32_t priority);
+
+/**
+ * Load weight for a nice level (-20..19, clamped)
+ */
+uint32_t runqueue_nice_to_weight(int nice);
+
+/**
+ * Initialize one runqueue per CPU reported by smp_get_cpu_count()
+ */
+void runqueue_init(void);
+
+/**
+ * Enable or disable stealing and balancing between CPUs (enabled by default)
+ */
+void runqueue_set_stealing(int enabled);
+
+/**
+ * Set or get the scheduling tunables
+ * Zero fields in a set request are left unchanged.
+ */
+void runqueue_set_tunables(const runqueue_tunables_t* tunables);
+void runqueue_get_tunables(runqueue_tunables_t* tunables);
+
+/**
+ * Choose a CPU for a process that is becoming runnable
+ * Prefers the CPU it last ran on (warm cache) unless that CPU has at
+ * least two more runnable processes than the least loaded one.
+ * @return CPU index
+ */
+uint32_t runqueue_select_cpu(const process_t* process);
+
+/**
+ * Make a new or woken process runnable
+ * The process joins the timeline of the CPU runqueue_select_cpu()
+ * chooses. A new process starts one virtual slice behind the queue so
+ * forking cannot jump it; a sleeper is credited up to half a latency
+ * period so it runs promptly without monopolizing the CPU. The process
+ * preempts if the target CPU is idle or its running process is more
+ * than a wakeup granularity ahead in vruntime; a remote target is then
+ * sent RQ_RESCHED_VECTOR.
+ * The caller must have cleared process->run_node before first use.
+ * @param flags RQ_WAKE_NEW for a new process
+ * @param now Current time
+ * @return 1 if the calling CPU should reschedule, 0 otherwise
+ */
+int runqueue_wake(process_t* process, int flags, uint64_t now);
+
+/**
+ * Requeue the current CPU's running process (it yielded or was preempted)
+ */
+void runqueue_put_prev(process_t* process, uint64_t now);
+
+/**
+ * Take a process off its runqueue (it is exiting)
+ * @return 0 on success, -1 if the process is neither queued nor running
+ */
+int runqueue_remove(process_t* process);
+
+/**
+ * Pick the next process for a CPU
+ * Charges the previous process (if it blocked without being requeued)
+ * and takes the leftmost process on the timeline. When the timeline is
+ * empty it steals from the busiest other CPU.
+ * @param cpu CPU index
+ * @param now Current time
+ * @return Process (state still PROCESS_READY), or NULL if the CPU goes idle
+ */
+process_t* runqueue_pick_next(uint32_t cpu, uint64_t now);
+
+/**
+ * Account the running process at a timer tick
+ * Runs runqueue_balance() first, so a CPU busy with a lone process still
+ * takes its share of a backlog elsewhere.
+ * @return 1 if it has used its slice (or the CPU idles with work
+ *         queued) and the CPU should reschedule, 0 otherwise
+ */
+int runqueue_tick(uint32_t cpu, uint64_t now);
+
+/**
+ * Periodic load balancing for a CPU
+ * Pulls one process from the busiest CPU when that CPU has at least two
+ * more runnable processes than this one. Stealing only helps CPUs that run dry; this
+ * evens out CPUs that are all busy but unequally loaded.
+ * @return 1 if a process was pulled, 0 otherwise
+ */
+int runqueue_balance(uint32_t cpu);
+
+/**
+ * Number of processes queued on a CPU (not counting the running one)
+ */
+uint32_t runqueue_nr_queued(uint32_t cpu);
+
+/**
+ * Get one CPU's runqueue statistics
+ */
+void runqueue_get_stats(uint32_t cpu, runqueue_stats_t* stats);
+
+#endif /* AURORA_RUNQUEUE_H */
@@ -8,6 +8,7 @@
  */
 
 #include "scheduler_optimization.h"
+#include "runqueue.h"
 #include "../memory/memory.h"
 
 /* Maximum tasks for RT scheduling */
@@ -84,6 +85,7 @@ int scheduler_optimization_init(void) {
     
     /* Enable load balancing across multiple CPU cores */
     sched_opt.load_balancing = 1;
+    runqueue_set_stealing(1);
     
     /* Set initial latency target */
     sched_opt.avg_latency_us = 1000;  /* Target: reduce to <100us */
@@ -110,6 +112,7 @@ void scheduler_enable_priority_inheritance(void) {
  */
 void scheduler_enable_load_balancing(void) {
     sched_opt.load_balancing = 1;
+    runqueue_set_stealing(1);
 }
 
 /**
@@ -0,0 +1,60 @@
+/**
+ * Aurora OS - Wait Queues
+ *
+ * A list of on-stack entries under a spinlock. Waking posts each entry's
+ * event, and process_wait_event_until() rechecks the event after going
+ * BLOCKED, so a waiter that queued itself before checking its condition
+ * either sees the change or gets the post.
+ */
+
+#include "wait.h"
+#include <stddef.h>
+
+void wait_queue_init(wait_queue_t* wq) {
+    spinlock_init(&wq->lock);
+    wq->head = NULL;
+}
+
+void wait_queue_prepare(wait_queue_t* wq, wait_entry_t* wait) {
+    wait->process = process_get_current();
+    wait->event = 0;
+
+    spinlock_acquire(&wq->lock);
+    wait->next = wq->head;
+    wq->head = wait;
+    spinlock_release(&wq->lock);
+}
+
+int wait_queue_sleep(wait_entry_t* wait, uint64_t deadline_us) {
+    if (!wait->process) {
+        return -1;
+    }
+    return process_wait_event_until(&wait->event, deadline_us);
+}
+
+void wait_queue_finish(wait_queue_t* wq, wait_entry_t* wait) {
+    spinlock_acquire(&wq->lock);
+    wait_entry_t** link = &wq->head;
+    while (*link && *link != wait) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = wait->next;
+    }
+    spinlock_release(&wq->lock);
+}
+
+void wait_queue_wake_all(wait_queue_t* wq) {
+    /* Nobody waiting is the common case */
+    if (!__atomic_load_n(&wq->head, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    spinlock_acquire(&wq->lock);
+    for (wait_entry_t* w = wq->head; w; w = w->next) {
+        if (w->process) {
+            process_post_event(w->process, &w->event);
+        }
+    }
+    spinlock_release(&wq->lock);
+}
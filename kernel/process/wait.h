@@ -0,0 +1,64 @@
+/**
+ * Aurora OS - Wait Queue Header
+ *
+ * Any number of processes blocked until some condition changes. Each
+ * waiter sleeps on an event of its own (process_wait_event_until()), so
+ * a wakeup can't be lost between checking the condition and blocking:
+ *
+ *     wait_entry_t wait;
+ *     wait_queue_prepare(&wq, &wait);
+ *     if (!condition) {
+ *         wait_queue_sleep(&wait, deadline);
+ *     }
+ *     wait_queue_finish(&wq, &wait);
+ *
+ * and whoever changes the condition calls wait_queue_wake_all() after.
+ * A zeroed wait queue is empty and ready to use.
+ */
+
+#ifndef AURORA_WAIT_H
+#define AURORA_WAIT_H
+
+#include <stdint.h>
+#include "process.h"
+#include "../smp/spinlock.h"
+
+/* One waiter; lives on the waiter's stack */
+typedef struct wait_entry {
+    process_t* process;
+    volatile uint32_t event;
+    struct wait_entry* next;
+} wait_entry_t;
+
+typedef struct {
+    spinlock_t lock;
+    wait_entry_t* head;
+} wait_queue_t;
+
+/**
+ * Initialize an empty wait queue
+ */
+void wait_queue_init(wait_queue_t* wq);
+
+/**
+ * Queue the current process, before it checks the condition
+ */
+void wait_queue_prepare(wait_queue_t* wq, wait_entry_t* wait);
+
+/**
+ * Block until woken or a deadline passes (UINT64_MAX for none)
+ * @return 1 if woken, 0 on timeout, -1 if the caller can't block
+ */
+int wait_queue_sleep(wait_entry_t* wait, uint64_t deadline_us);
+
+/**
+ * Take the current process off the queue
+ */
+void wait_queue_finish(wait_queue_t* wq, wait_entry_t* wait);
+
+/**
+ * Wake every queued process
+ */
+void wait_queue_wake_all(wait_queue_t* wq);
+
+#endif /* AURORA_WAIT_H */
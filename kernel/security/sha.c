@@ -0,0 +1,485 @@
+/**
+ * Aurora OS - SHA-1 / SHA-256 Message Digests
+ *
+ * Scalar implementations follow FIPS 180-4. On x86 the block functions
+ * are replaced at runtime by SHA-NI versions when CPUID reports the SHA
+ * extensions, which hash several times faster than the scalar rounds.
+ */
+
+#include "sha.h"
+
+/* Block compression function: hashes nblocks consecutive 64-byte blocks */
+typedef void (*sha_blocks_fn)(uint32_t* state, const uint8_t* data, size_t nblocks);
+
+static void sha1_blocks_scalar(uint32_t* state, const uint8_t* data, size_t nblocks);
+static void sha256_blocks_scalar(uint32_t* state, const uint8_t* data, size_t nblocks);
+
+/* Active implementations */
+static sha_blocks_fn g_sha1_blocks = sha1_blocks_scalar;
+static sha_blocks_fn g_sha256_blocks = sha256_blocks_scalar;
+static uint32_t g_sha_accel = SHA_ACCEL_NONE;
+static uint32_t g_sha_accel_available = SHA_ACCEL_NONE;
+static int g_sha_detected = 0;
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define ROR32(v, n) (((v) >> (n)) | ((v) << (32 - (n))))
+
+static inline uint32_t load_be32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline void store_be32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static void sha_copy(uint8_t* dest, const uint8_t* src, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        dest[i] = src[i];
+    }
+}
+
+/*
+ * Scalar SHA-1: message schedule kept in a 16-word ring so the working
+ * set stays in registers/L1 instead of an 80-word array.
+ */
+static void sha1_blocks_scalar(uint32_t* state, const uint8_t* data, size_t nblocks) {
+    while (nblocks--) {
+        uint32_t w[16];
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+        for (int i = 0; i < 16; i++) {
+            w[i] = load_be32(data + i * 4);
+        }
+
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i >= 16) {
+                uint32_t x = w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15];
+                w[i & 15] = ROL32(x, 1);
+            }
+            if (i < 20) {
+                f = d ^ (b & (c ^ d));
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (d & (b | c));
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t temp = ROL32(a, 5) + f + e + k + w[i & 15];
+            e = d;
+            d = c;
+            c = ROL32(b, 30);
+            b = a;
+            a = temp;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        data += SHA_BLOCK_SIZE;
+    }
+}
+
+static void sha256_blocks_scalar(uint32_t* state, const uint8_t* data, size_t nblocks) {
+    while (nblocks--) {
+        uint32_t w[16];
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (int i = 0; i < 16; i++) {
+            w[i] = load_be32(data + i * 4);
+        }
+
+        for (int i = 0; i < 64; i++) {
+            if (i >= 16) {
+                uint32_t w15 = w[(i + 1) & 15];
+                uint32_t w2 = w[(i + 14) & 15];
+                uint32_t s0 = ROR32(w15, 7) ^ ROR32(w15, 18) ^ (w15 >> 3);
+                uint32_t s1 = ROR32(w2, 17) ^ ROR32(w2, 19) ^ (w2 >> 10);
+                w[i & 15] += s0 + w[(i + 9) & 15] + s1;
+            }
+            uint32_t S1 = ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25);
+            uint32_t ch = g ^ (e & (f ^ g));
+            uint32_t t1 = h + S1 + ch + sha256_k[i] + w[i & 15];
+            uint32_t S0 = ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22);
+            uint32_t maj = (a & b) | (c & (a | b));
+            uint32_t t2 = S0 + maj;
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+        data += SHA_BLOCK_SIZE;
+    }
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+/*
+ * SHA-NI implementations. Written with GCC vector builtins rather than
+ * <immintrin.h>, which is not usable in the freestanding build.
+ */
+typedef int v4si __attribute__((vector_size(16)));
+typedef long long v2di __attribute__((vector_size(16)));
+typedef char v16qi __attribute__((vector_size(16)));
+typedef short v8hi __attribute__((vector_size(16)));
+typedef int v4si_u __attribute__((vector_size(16), aligned(1)));
+
+#if defined(__i386__)
+/* 32-bit stacks are only 4-byte aligned; the vector spills need 16 */
+#define SHANI_TARGET __attribute__((target("sha,sse4.1"), force_align_arg_pointer))
+#else
+#define SHANI_TARGET __attribute__((target("sha,sse4.1")))
+#endif
+
+#define BSWAP_EPI8(x, m) ((v4si)__builtin_ia32_pshufb128((v16qi)(x), (v16qi)(m)))
+#define SHUFFLE_EPI32(x, imm) ((v4si)__builtin_ia32_pshufd((v4si)(x), (imm)))
+#define ALIGNR_EPI8(a, b, n) ((v4si)__builtin_ia32_palignr128((v2di)(a), (v2di)(b), (n) * 8))
+#define BLEND_EPI16(a, b, imm) ((v4si)__builtin_ia32_pblendw128((v8hi)(a), (v8hi)(b), (imm)))
+
+static void SHANI_TARGET sha1_blocks_shani(uint32_t* state, const uint8_t* data, size_t nblocks) {
+    const v16qi mask = { 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 };
+    v4si abcd = *(const v4si_u*)state;
+    v4si e0 = { 0, 0, 0, (int)state[4] };
+    abcd = SHUFFLE_EPI32(abcd, 0x1B);
+
+    while (nblocks--) {
+        v4si w[4];
+        v4si abcd_save = abcd;
+        v4si e0_save = e0;
+        v4si e1;
+
+        for (int i = 0; i < 4; i++) {
+            w[i] = BSWAP_EPI8(*(const v4si_u*)(data + i * 16), mask);
+        }
+
+        /* Rounds 0-3 */
+        e0 += w[0];
+        e1 = abcd;
+        abcd = __builtin_ia32_sha1rnds4(abcd, e0, 0);
+
+/* One group of four rounds; g is the group index (1..19) */
+#define SHA1_NI_GROUP(g, ein, eout)                                             \
+        do {                                                                    \
+            if ((g) >= 4) {                                                     \
+                w[(g) & 3] = __builtin_ia32_sha1msg2(                           \
+                    __builtin_ia32_sha1msg1(w[(g) & 3], w[((g) + 1) & 3]) ^     \
+                    w[((g) + 2) & 3], w[((g) + 3) & 3]);                        \
+            }                                                                   \
+            ein = __builtin_ia32_sha1nexte(ein, w[(g) & 3]);                    \
+            eout = abcd;                                                        \
+            abcd = __builtin_ia32_sha1rnds4(abcd, ein, (g) / 5);                \
+        } while (0)
+
+        SHA1_NI_GROUP(1, e1, e0);
+        SHA1_NI_GROUP(2, e0, e1);
+        SHA1_NI_GROUP(3, e1, e0);
+        SHA1_NI_GROUP(4, e0, e1);
+        SHA1_NI_GROUP(5, e1, e0);
+        SHA1_NI_GROUP(6, e0, e1);
+        SHA1_NI_GROUP(7, e1, e0);
+        SHA1_NI_GROUP(8, e0, e1);
+        SHA1_NI_GROUP(9, e1, e0);
+        SHA1_NI_GROUP(10, e0, e1);
+        SHA1_NI_GROUP(11, e1, e0);
+        SHA1_NI_GROUP(12, e0, e1);
+        SHA1_NI_GROUP(13, e1, e0);
+        SHA1_NI_GROUP(14, e0, e1);
+        SHA1_NI_GROUP(15, e1, e0);
+        SHA1_NI_GROUP(16, e0, e1);
+        SHA1_NI_GROUP(17, e1, e0);
+        SHA1_NI_GROUP(18, e0, e1);
+        SHA1_NI_GROUP(19, e1, e0);
+#undef SHA1_NI_GROUP
+
+        e0 = __builtin_ia32_sha1nexte(e0, e0_save);
+        abcd += abcd_save;
+        data += SHA_BLOCK_SIZE;
+    }
+
+    abcd = SHUFFLE_EPI32(abcd, 0x1B);
+    *(v4si_u*)state = abcd;
+    state[4] = (uint32_t)e0[3];
+}
+
+static void SHANI_TARGET sha256_blocks_shani(uint32_t* state, const uint8_t* data, size_t nblocks) {
+    const v16qi mask = { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 };
+    v4si tmp = SHUFFLE_EPI32(*(const v4si_u*)&state[0], 0xB1);   /* CDAB */
+    v4si state1 = SHUFFLE_EPI32(*(const v4si_u*)&state[4], 0x1B); /* EFGH */
+    v4si state0 = ALIGNR_EPI8(tmp, state1, 8);                     /* ABEF */
+    state1 = BLEND_EPI16(state1, tmp, 0xF0);                       /* CDGH */
+
+    while (nblocks--) {
+        v4si w[4];
+        v4si abef_save = state0;
+        v4si cdgh_save = state1;
+        v4si msg;
+
+        for (int i = 0; i < 4; i++) {
+            w[i] = BSWAP_EPI8(*(const v4si_u*)(data + i * 16), mask);
+        }
+
+/* Four rounds; g is the group index (0..15) */
+#define SHA256_NI_GROUP(g)                                                      \
+        do {                                                                    \
+            if ((g) >= 4) {                                                     \
+                w[(g) & 3] = __builtin_ia32_sha256msg2(                         \
+                    __builtin_ia32_sha256msg1(w[(g) & 3], w[((g) + 1) & 3]) +   \
+                    ALIGNR_EPI8(w[((g) + 3) & 3], w[((g) + 2) & 3], 4),         \
+                    w[((g) + 3) & 3]);                                          \
+            }                                                                   \
+            msg = w[(g) & 3] + *(const v4si_u*)&sha256_k[(g) * 4];              \
+            state1 = __builtin_ia32_sha256rnds2(state1, state0, msg);           \
+            msg = SHUFFLE_EPI32(msg, 0x0E);                                     \
+            state0 = __builtin_ia32_sha256rnds2(state0, state1, msg);           \
+        } while (0)
+
+        SHA256_NI_GROUP(0);
+        SHA256_NI_GROUP(1);
+        SHA256_NI_GROUP(2);
+        SHA256_NI_GROUP(3);
+        SHA256_NI_GROUP(4);
+        SHA256_NI_GROUP(5);
+        SHA256_NI_GROUP(6);
+        SHA256_NI_GROUP(7);
+        SHA256_NI_GROUP(8);
+        SHA256_NI_GROUP(9);
+        SHA256_NI_GROUP(10);
+        SHA256_NI_GROUP(11);
+        SHA256_NI_GROUP(12);
+        SHA256_NI_GROUP(13);
+        SHA256_NI_GROUP(14);
+        SHA256_NI_GROUP(15);
+#undef SHA256_NI_GROUP
+
+        state0 += abef_save;
+        state1 += cdgh_save;
+        data += SHA_BLOCK_SIZE;
+    }
+
+    tmp = SHUFFLE_EPI32(state0, 0x1B);             /* FEBA */
+    state1 = SHUFFLE_EPI32(state1, 0xB1);          /* DCHG */
+    state0 = BLEND_EPI16(tmp, state1, 0xF0);       /* DCBA */
+    state1 = ALIGNR_EPI8(state1, tmp, 8);          /* HGFE */
+    *(v4si_u*)&state[0] = state0;
+    *(v4si_u*)&state[4] = state1;
+}
+
+/**
+ * Detect SHA-NI (CPUID.7.0:EBX[29]) together with SSSE3/SSE4.1, in both
+ * 32- and 64-bit builds
+ */
+static uint32_t sha_detect_cpu(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(0), "c"(0));
+    if (eax < 7) {
+        return SHA_ACCEL_NONE;
+    }
+
+    __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1), "c"(0));
+    if (!((ecx >> 9) & 1) || !((ecx >> 19) & 1)) {
+        return SHA_ACCEL_NONE;
+    }
+
+#if defined(__i386__) && !defined(AURORA_STANDALONE)
+    /* A 32-bit kernel doesn't otherwise use SSE, so it may be off */
+    uint32_t cr4;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    if (!((cr4 >> 9) & 1)) {        /* CR4.OSFXSR */
+        return SHA_ACCEL_NONE;
+    }
+#endif
+
+    __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(7), "c"(0));
+    return ((ebx >> 29) & 1) ? SHA_ACCEL_SHANI : SHA_ACCEL_NONE;
+}
+#else
+static uint32_t sha_detect_cpu(void) {
+    return SHA_ACCEL_NONE;
+}
+#endif
+
+static void sha_select(uint32_t accel) {
+    g_sha1_blocks = sha1_blocks_scalar;
+    g_sha256_blocks = sha256_blocks_scalar;
+    g_sha_accel = SHA_ACCEL_NONE;
+#if defined(__i386__) || defined(__x86_64__)
+    if (accel & SHA_ACCEL_SHANI) {
+        g_sha1_blocks = sha1_blocks_shani;
+        g_sha256_blocks = sha256_blocks_shani;
+        g_sha_accel = SHA_ACCEL_SHANI;
+    }
+#else
+    (void)accel;
+#endif
+}
+
+static void sha_ensure_detected(void) {
+    if (!g_sha_detected) {
+        g_sha_accel_available = sha_detect_cpu();
+        sha_select(g_sha_accel_available);
+        g_sha_detected = 1;
+    }
+}
+
+uint32_t sha_get_accel(void) {
+    sha_ensure_detected();
+    return g_sha_accel;
+}
+
+uint32_t sha_set_accel(uint32_t mask) {
+    sha_ensure_detected();
+    sha_select(g_sha_accel_available & mask);
+    return g_sha_accel;
+}
+
+/*
+ * Shared buffering for the Merkle-Damgard update/final steps.
+ * Whole blocks are handed to the block function straight from the
+ * caller's buffer; only the unaligned head and tail are staged.
+ */
+static void sha_update_common(uint32_t* state, uint64_t* length, uint8_t* buffer,
+                              sha_blocks_fn blocks, const uint8_t* data, size_t len) {
+    size_t used = (size_t)(*length & (SHA_BLOCK_SIZE - 1));
+    *length += len;
+
+    if (used) {
+        size_t fill = SHA_BLOCK_SIZE - used;
+        if (len < fill) {
+            sha_copy(buffer + used, data, len);
+            return;
+        }
+        sha_copy(buffer + used, data, fill);
+        blocks(state, buffer, 1);
+        data += fill;
+        len -= fill;
+    }
+
+    if (len >= SHA_BLOCK_SIZE) {
+        size_t nblocks = len / SHA_BLOCK_SIZE;
+        blocks(state, data, nblocks);
+        data += nblocks * SHA_BLOCK_SIZE;
+        len -= nblocks * SHA_BLOCK_SIZE;
+    }
+
+    if (len) {
+        sha_copy(buffer, data, len);
+    }
+}
+
+static void sha_final_common(uint32_t* state, uint64_t length, uint8_t* buffer,
+                             sha_blocks_fn blocks) {
+    size_t used = (size_t)(length & (SHA_BLOCK_SIZE - 1));
+    uint64_t bits = length << 3;
+
+    buffer[used++] = 0x80;
+    if (used > SHA_BLOCK_SIZE - 8) {
+        while (used < SHA_BLOCK_SIZE) {
+            buffer[used++] = 0;
+        }
+        blocks(state, buffer, 1);
+        used = 0;
+    }
+    while (used < SHA_BLOCK_SIZE - 8) {
+        buffer[used++] = 0;
+    }
+    store_be32(buffer + 56, (uint32_t)(bits >> 32));
+    store_be32(buffer + 60, (uint32_t)bits);
+    blocks(state, buffer, 1);
+}
+
+void sha1_init(sha1_ctx_t* ctx) {
+    sha_ensure_detected();
+    ctx->state[0] = 0x67452301;
+    ctx->state[1] = 0xEFCDAB89;
+    ctx->state[2] = 0x98BADCFE;
+    ctx->state[3] = 0x10325476;
+    ctx->state[4] = 0xC3D2E1F0;
+    ctx->length = 0;
+}
+
+void sha1_update(sha1_ctx_t* ctx, const void* data, size_t len) {
+    sha_update_common(ctx->state, &ctx->length, ctx->buffer, g_sha1_blocks,
+                      (const uint8_t*)data, len);
+}
+
+void sha1_final(sha1_ctx_t* ctx, uint8_t digest[SHA1_DIGEST_SIZE]) {
+    sha_final_common(ctx->state, ctx->length, ctx->buffer, g_sha1_blocks);
+    for (int i = 0; i < 5; i++) {
+        store_be32(digest + i * 4, ctx->state[i]);
+    }
+}
+
+void sha1(const void* data, size_t len, uint8_t digest[SHA1_DIGEST_SIZE]) {
+    sha1_ctx_t ctx;
+    sha1_init(&ctx);
+    sha1_update(&ctx, data, len);
+    sha1_final(&ctx, digest);
+}
+
+void sha256_init(sha256_ctx_t* ctx) {
+    sha_ensure_detected();
+    ctx->state[0] = 0x6a09e667;
+    ctx->state[1] = 0xbb67ae85;
+    ctx->state[2] = 0x3c6ef372;
+    ctx->state[3] = 0xa54ff53a;
+    ctx->state[4] = 0x510e527f;
+    ctx->state[5] = 0x9b05688c;
+    ctx->state[6] = 0x1f83d9ab;
+    ctx->state[7] = 0x5be0cd19;
+    ctx->length = 0;
+}
+
+void sha256_update(sha256_ctx_t* ctx, const void* data, size_t len) {
+    sha_update_common(ctx->state, &ctx->length, ctx->buffer, g_sha256_blocks,
+                      (const uint8_t*)data, len);
+}
+
+void sha256_final(sha256_ctx_t* ctx, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    sha_final_common(ctx->state, ctx->length, ctx->buffer, g_sha256_blocks);
+    for (int i = 0; i < 8; i++) {
+        store_be32(digest + i * 4, ctx->state[i]);
+    }
+}
+
+void sha256(const void* data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    sha256_ctx_t ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, len);
+    sha256_final(&ctx, digest);
+}
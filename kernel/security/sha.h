@@ -0,0 +1,68 @@
+/**
+ * Aurora OS - SHA-1 / SHA-256 Message Digests
+ *
+ * Streaming SHA-1 and SHA-256 used for boot image verification and
+ * content hashing. Uses the x86 SHA extensions (SHA-NI) when the CPU
+ * supports them and falls back to portable scalar code otherwise.
+ */
+
+#ifndef AURORA_SHA_H
+#define AURORA_SHA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Digest and block sizes */
+#define SHA1_DIGEST_SIZE 20
+#define SHA256_DIGEST_SIZE 32
+#define SHA_BLOCK_SIZE 64
+
+/* Hardware acceleration flags */
+#define SHA_ACCEL_NONE  0
+#define SHA_ACCEL_SHANI (1 << 0)
+
+/**
+ * SHA-1 streaming context
+ */
+typedef struct {
+    uint32_t state[5];
+    uint64_t length;            /* Total bytes hashed */
+    uint8_t buffer[SHA_BLOCK_SIZE];
+} sha1_ctx_t;
+
+/**
+ * SHA-256 streaming context
+ */
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;            /* Total bytes hashed */
+    uint8_t buffer[SHA_BLOCK_SIZE];
+} sha256_ctx_t;
+
+/* SHA-1 */
+void sha1_init(sha1_ctx_t* ctx);
+void sha1_update(sha1_ctx_t* ctx, const void* data, size_t len);
+void sha1_final(sha1_ctx_t* ctx, uint8_t digest[SHA1_DIGEST_SIZE]);
+void sha1(const void* data, size_t len, uint8_t digest[SHA1_DIGEST_SIZE]);
+
+/* SHA-256 */
+void sha256_init(sha256_ctx_t* ctx);
+void sha256_update(sha256_ctx_t* ctx, const void* data, size_t len);
+void sha256_final(sha256_ctx_t* ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+void sha256(const void* data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+/**
+ * Get the acceleration in use (SHA_ACCEL_* flags)
+ * Detects CPU support on first call
+ */
+uint32_t sha_get_accel(void);
+
+/**
+ * Restrict acceleration to the given mask
+ * Passing SHA_ACCEL_NONE forces the scalar implementation
+ * @param mask Allowed SHA_ACCEL_* flags
+ * @return Acceleration flags now in use
+ */
+uint32_t sha_set_accel(uint32_t mask);
+
+#endif /* AURORA_SHA_H */
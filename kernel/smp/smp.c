@@ -6,6 +6,7 @@
 
 #include "smp.h"
 #include "../core/kernel.h"
+#include "../memory/magazine.h"
 #include <stddef.h>
 
 /* Per-CPU data */
@@ -20,10 +21,18 @@ static uint32_t cpus_online = 0;
 #define APIC_SPURIOUS_REG 0xF0
 #define APIC_ICR_LOW 0x300
 #define APIC_ICR_HIGH 0x310
+#define APIC_LVT_TIMER 0x320
+#define APIC_TIMER_INITIAL 0x380
+#define APIC_TIMER_CURRENT 0x390
+#define APIC_TIMER_DIVIDE 0x3E0
 
 /* APIC enable bit */
 #define APIC_ENABLE 0x100
 
+/* LVT mask bit and timer divide configuration for divide-by-16 */
+#define APIC_LVT_MASKED 0x10000
+#define APIC_TIMER_DIV_16 0x3
+
 /**
  * Read from APIC register
  */
@@ -80,29 +89,25 @@ void apic_send_ipi(uint32_t dest_cpu, uint32_t vector) {
 }
 
 /**
- * Initialize spinlock
- */
-void spinlock_init(spinlock_t* lock) {
-    lock->lock = 0;
-}
-
-/**
- * Acquire spinlock
+ * Arm the local APIC timer in one-shot mode
  */
-void spinlock_acquire(spinlock_t* lock) {
-    while (__sync_lock_test_and_set(&lock->lock, 1)) {
-        while (lock->lock) {
-            /* Spin with pause instruction for better performance */
-            __asm__ volatile("pause");
-        }
+void apic_timer_oneshot(uint32_t vector, uint32_t count) {
+    if (count == 0) {
+        apic_write(APIC_LVT_TIMER, APIC_LVT_MASKED | vector);
+        apic_write(APIC_TIMER_INITIAL, 0);
+        return;
     }
+    
+    apic_write(APIC_TIMER_DIVIDE, APIC_TIMER_DIV_16);
+    apic_write(APIC_LVT_TIMER, vector);         /* One-shot, unmasked */
+    apic_write(APIC_TIMER_INITIAL, count);      /* Starts counting down */
 }
 
 /**
- * Release spinlock
+ * Ticks left before the local APIC timer fires
  */
-void spinlock_release(spinlock_t* lock) {
-    __sync_lock_release(&lock->lock);
+uint32_t apic_timer_remaining(void) {
+    return apic_read(APIC_TIMER_CURRENT);
 }
 
 /**
@@ -188,6 +193,9 @@ void smp_halt_cpu(uint32_t cpu_id) {
         return;
     }
     
+    /* Give the CPU's cached heap objects back before it stops */
+    magazine_drain_cpu(cpu_id);
+    
     cpu_info[cpu_id].state = CPU_STATE_HALTED;
     cpus_online--;
 }
@@ -8,6 +8,7 @@
 #define AURORA_SMP_H
 
 #include <stdint.h>
+#include "spinlock.h"
 
 /* Maximum number of CPUs supported */
 #define MAX_CPUS 16
@@ -30,11 +31,6 @@ typedef struct {
     uint32_t ticks;
 } cpu_info_t;
 
-/* Spinlock for multi-core synchronization */
-typedef struct {
-    volatile uint32_t lock;
-} spinlock_t;
-
 /* SMP initialization functions */
 void smp_init(void);
 uint32_t smp_get_cpu_count(void);
@@ -45,14 +41,23 @@ cpu_info_t* smp_get_cpu_info(uint32_t cpu_id);
 void smp_start_cpu(uint32_t cpu_id);
 void smp_halt_cpu(uint32_t cpu_id);
 
-/* Spinlock functions */
-void spinlock_init(spinlock_t* lock);
-void spinlock_acquire(spinlock_t* lock);
-void spinlock_release(spinlock_t* lock);
-
 /* APIC functions */
 void apic_init(void);
 void apic_send_ipi(uint32_t dest_cpu, uint32_t vector);
 void apic_eoi(void);
 
+/* Local APIC timer vector, for one-shot timer events */
+#define APIC_TIMER_VECTOR 0xF0
+
+/**
+ * Arm this CPU's local APIC timer to raise a vector once after count
+ * timer ticks (bus clock / 16); a count of 0 stops it
+ */
+void apic_timer_oneshot(uint32_t vector, uint32_t count);
+
+/**
+ * Ticks left before this CPU's local APIC timer fires
+ */
+uint32_t apic_timer_remaining(void);
+
 #endif /* AURORA_SMP_H */
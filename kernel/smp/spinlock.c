@@ -0,0 +1,675 @@
+/**
+ * Aurora OS - Spinlocks
+ *
+ * Ticket, MCS, queued and reader-writer spinlocks, optional per-lock
+ * contention statistics, and lock-order validation for debug builds.
+ *
+ * The ticket lock hands the lock out in arrival order: acquire takes the
+ * next ticket with one atomic add and spins until owner reaches it, and
+ * release is a plain store to owner. Every waiter still spins on the
+ * lock's cache line, so each release invalidates it on every waiting CPU.
+ *
+ * The MCS lock (Mellor-Crummey & Scott, 1991) queues waiters instead:
+ * each one spins on a flag in its own node and the holder hands off by
+ * setting its successor's flag, so a release touches one remote cache
+ * line regardless of how many CPUs wait. The queued spinlock packs the
+ * same queue into a 32-bit word (as in Linux's qspinlock, without the
+ * pending bit): a locked byte plus the tail of an MCS queue whose nodes
+ * are per CPU, so users need not supply nodes. Uncontended acquire and
+ * release are one compare-and-swap and one byte store.
+ *
+ * Lock-order validation (ENABLE_LOCKDEP) keeps a directed graph over
+ * locks, identified by address: acquiring B while holding A adds A -> B.
+ * Before adding an edge the graph is searched for a path back from B to
+ * A; finding one means two code paths take the same locks in opposite
+ * orders and could deadlock, even if this run never interleaved them.
+ * The graph and per-CPU held-lock stacks are protected by an internal
+ * lock of their own.
+ */
+
+#include "spinlock.h"
+#include "smp.h"
+#include <stddef.h>
+
+/* Queue nodes per CPU for the queued spinlock (nesting depth) */
+#define QSPIN_NODES         4
+
+#define QSPIN_LOCKED        0x01u
+#define QSPIN_LOCKED_MASK   0x000000FFu
+#define QSPIN_TAIL_MASK     0xFFFF0000u
+#define QSPIN_TAIL_SHIFT    16
+
+typedef struct {
+    mcs_node_t nodes[QSPIN_NODES];
+    uint32_t depth;                 /* Nodes in use */
+} __attribute__((aligned(64))) qnode_cpu_t;
+
+static qnode_cpu_t qnodes[MAX_CPUS];
+
+/* Flags for lock-order tracking */
+#define LOCKDEP_READ        0x1     /* Shared; may be held recursively */
+#define LOCKDEP_TRY         0x2     /* Trylock; cannot deadlock */
+
+#ifdef ENABLE_LOCKDEP
+static void lockdep_acquire(const void* lock, int flags);
+static void lockdep_release(const void* lock);
+#else
+#define lockdep_acquire(lock, flags)    ((void)0)
+#define lockdep_release(lock)           ((void)0)
+#endif
+
+/**
+ * Read the time-stamp counter
+ */
+static inline uint64_t read_tsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint32_t this_cpu(void) {
+    uint32_t cpu = smp_get_current_cpu_id();
+    return cpu < MAX_CPUS ? cpu : 0;
+}
+
+/* Statistics are updated by the holder only */
+static inline void stat_waited(lock_stat_t* stats, uint64_t cycles) {
+    stats->contended++;
+    stats->spin_cycles += cycles;
+    if (cycles > stats->max_spin_cycles) {
+        stats->max_spin_cycles = cycles;
+    }
+}
+
+static inline void stat_acquired(lock_stat_t* stats) {
+    stats->acquisitions++;
+    stats->acquired_at = read_tsc();
+}
+
+static inline void stat_released(lock_stat_t* stats) {
+    uint64_t held = read_tsc() - stats->acquired_at;
+    stats->hold_cycles += held;
+    if (held > stats->max_hold_cycles) {
+        stats->max_hold_cycles = held;
+    }
+}
+
+/* ---- Ticket spinlock ---- */
+
+/**
+ * Initialize spinlock
+ */
+void spinlock_init(spinlock_t* lock) {
+    lock->val = 0;
+    lock->stats = NULL;
+}
+
+/**
+ * Acquire spinlock
+ */
+void spinlock_acquire(spinlock_t* lock) {
+    lockdep_acquire(lock, 0);
+
+    uint16_t ticket = __atomic_fetch_add(&lock->tickets.next, 1, __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&lock->tickets.owner, __ATOMIC_ACQUIRE) != ticket) {
+        uint64_t start = lock->stats ? read_tsc() : 0;
+        while (__atomic_load_n(&lock->tickets.owner, __ATOMIC_ACQUIRE) != ticket) {
+            cpu_relax();
+        }
+        if (lock->stats) {
+            stat_waited(lock->stats, read_tsc() - start);
+        }
+    }
+
+    if (lock->stats) {
+        stat_acquired(lock->stats);
+    }
+}
+
+/**
+ * Acquire spinlock if free
+ */
+int spinlock_try_acquire(spinlock_t* lock) {
+    uint32_t old = __atomic_load_n(&lock->val, __ATOMIC_RELAXED);
+    if ((old & 0xFFFF) != (old >> 16)) {
+        return 0;
+    }
+    /* Take the next ticket; the carry out of bit 31 just wraps it */
+    if (!__atomic_compare_exchange_n(&lock->val, &old, old + 0x10000u, 0,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+
+    lockdep_acquire(lock, LOCKDEP_TRY);
+    if (lock->stats) {
+        stat_acquired(lock->stats);
+    }
+    return 1;
+}
+
+/**
+ * Release spinlock
+ */
+void spinlock_release(spinlock_t* lock) {
+    if (lock->stats) {
+        stat_released(lock->stats);
+    }
+    lockdep_release(lock);
+    __atomic_store_n(&lock->tickets.owner, (uint16_t)(lock->tickets.owner + 1), __ATOMIC_RELEASE);
+}
+
+/**
+ * Acquire spinlock with local interrupts disabled
+ */
+irqflags_t spinlock_acquire_irqsave(spinlock_t* lock) {
+    irqflags_t flags = local_irq_save();
+    spinlock_acquire(lock);
+    return flags;
+}
+
+/**
+ * Release spinlock and restore the saved interrupt state
+ */
+void spinlock_release_irqrestore(spinlock_t* lock, irqflags_t flags) {
+    spinlock_release(lock);
+    local_irq_restore(flags);
+}
+
+/**
+ * Attach or detach contention statistics
+ */
+void spinlock_set_stats(spinlock_t* lock, lock_stat_t* stats) {
+    lock->stats = stats;
+}
+
+/* ---- MCS lock ---- */
+
+/**
+ * Initialize MCS lock
+ */
+void mcs_lock_init(mcs_lock_t* lock) {
+    lock->tail = NULL;
+}
+
+/**
+ * Acquire MCS lock, queueing on node
+ */
+void mcs_lock_acquire(mcs_lock_t* lock, mcs_node_t* node) {
+    lockdep_acquire(lock, 0);
+
+    node->next = NULL;
+    node->locked = 0;
+    mcs_node_t* prev = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+    if (prev) {
+        __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+        while (!__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE)) {
+            cpu_relax();
+        }
+    }
+}
+
+/**
+ * Release MCS lock, handing it to the next queued node
+ */
+void mcs_lock_release(mcs_lock_t* lock, mcs_node_t* node) {
+    lockdep_release(lock);
+
+    mcs_node_t* next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    if (!next) {
+        mcs_node_t* expected = node;
+        if (__atomic_compare_exchange_n(&lock->tail, &expected, NULL, 0,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return;
+        }
+        /* A waiter swapped itself in but has not linked up yet */
+        while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE))) {
+            cpu_relax();
+        }
+    }
+    __atomic_store_n(&next->locked, 1, __ATOMIC_RELEASE);
+}
+
+/* ---- Queued spinlock ---- */
+
+static inline uint32_t qspin_encode_tail(uint32_t cpu, uint32_t idx) {
+    return (((cpu + 1) << 2) | idx) << QSPIN_TAIL_SHIFT;
+}
+
+static inline mcs_node_t* qspin_decode_tail(uint32_t val) {
+    uint32_t tail = val >> QSPIN_TAIL_SHIFT;
+    return &qnodes[(tail >> 2) - 1].nodes[tail & 3];
+}
+
+/**
+ * Initialize queued spinlock
+ */
+void qspinlock_init(qspinlock_t* lock) {
+    lock->val = 0;
+    lock->stats = NULL;
+}
+
+/**
+ * Contended acquire: join the MCS queue, wait to reach its head, then
+ * wait for the owner to leave
+ */
+static void qspin_slowpath(qspinlock_t* lock) {
+    uint32_t cpu = this_cpu();
+    qnode_cpu_t* qc = &qnodes[cpu];
+
+    if (qc->depth >= QSPIN_NODES) {
+        /* Nested too deep for a node: wait for the word to clear */
+        for (;;) {
+            uint32_t expected = 0;
+            if (__atomic_compare_exchange_n(&lock->val, &expected, QSPIN_LOCKED, 0,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return;
+            }
+            cpu_relax();
+        }
+    }
+
+    uint32_t idx = qc->depth++;
+    mcs_node_t* node = &qc->nodes[idx];
+    node->next = NULL;
+    node->locked = 0;
+
+    /* Become the tail, keeping the locked byte */
+    uint32_t tail = qspin_encode_tail(cpu, idx);
+    uint32_t old = __atomic_load_n(&lock->val, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&lock->val, &old, (old & QSPIN_LOCKED_MASK) | tail, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        /* old reloaded */
+    }
+
+    if (old & QSPIN_TAIL_MASK) {
+        mcs_node_t* prev = qspin_decode_tail(old);
+        __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+        while (!__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE)) {
+            cpu_relax();
+        }
+    }
+
+    /* Head of the queue: only this CPU may set the locked byte now,
+     * because the fast path needs the whole word clear */
+    uint32_t val;
+    while ((val = __atomic_load_n(&lock->val, __ATOMIC_ACQUIRE)) & QSPIN_LOCKED_MASK) {
+        cpu_relax();
+    }
+
+    /* Last in the queue: clear the tail along with taking the lock */
+    while ((val & QSPIN_TAIL_MASK) == tail) {
+        if (__atomic_compare_exchange_n(&lock->val, &val, QSPIN_LOCKED, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            qc->depth--;
+            return;
+        }
+    }
+
+    /* Others queued behind: take the lock, then pass the head on */
+    __atomic_store_n(&lock->word.locked, QSPIN_LOCKED, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    mcs_node_t* next;
+    while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE))) {
+        cpu_relax();
+    }
+    __atomic_store_n(&next->locked, 1, __ATOMIC_RELEASE);
+    qc->depth--;
+}
+
+/**
+ * Acquire queued spinlock
+ */
+void qspinlock_acquire(qspinlock_t* lock) {
+    lockdep_acquire(lock, 0);
+
+    uint32_t expected = 0;
+    if (__atomic_compare_exchange_n(&lock->val, &expected, QSPIN_LOCKED, 0,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        if (lock->stats) {
+            stat_acquired(lock->stats);
+        }
+        return;
+    }
+
+    uint64_t start = lock->stats ? read_tsc() : 0;
+    qspin_slowpath(lock);
+    if (lock->stats) {
+        stat_waited(lock->stats, read_tsc() - start);
+        stat_acquired(lock->stats);
+    }
+}
+
+/**
+ * Acquire queued spinlock if free and nobody is queued
+ */
+int qspinlock_try_acquire(qspinlock_t* lock) {
+    uint32_t expected = 0;
+    if (!__atomic_compare_exchange_n(&lock->val, &expected, QSPIN_LOCKED, 0,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+    lockdep_acquire(lock, LOCKDEP_TRY);
+    if (lock->stats) {
+        stat_acquired(lock->stats);
+    }
+    return 1;
+}
+
+/**
+ * Release queued spinlock
+ */
+void qspinlock_release(qspinlock_t* lock) {
+    if (lock->stats) {
+        stat_released(lock->stats);
+    }
+    lockdep_release(lock);
+    __atomic_store_n(&lock->word.locked, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Attach or detach contention statistics
+ */
+void qspinlock_set_stats(qspinlock_t* lock, lock_stat_t* stats) {
+    lock->stats = stats;
+}
+
+/* ---- Reader-writer lock ---- */
+
+/**
+ * Initialize reader-writer lock
+ */
+void rwlock_init(rwlock_t* lock) {
+    lock->cnt = 0;
+}
+
+/**
+ * Acquire for reading; waits while a writer holds or wants the lock
+ */
+void rwlock_read_acquire(rwlock_t* lock) {
+    lockdep_acquire(lock, LOCKDEP_READ);
+
+    for (;;) {
+        uint32_t v = __atomic_load_n(&lock->cnt, __ATOMIC_RELAXED);
+        if (!(v & (RWLOCK_WRITER | RWLOCK_WAITING))) {
+            if (__atomic_compare_exchange_n(&lock->cnt, &v, v + 1, 0,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return;
+            }
+            continue;
+        }
+        cpu_relax();
+    }
+}
+
+/**
+ * Release a read hold
+ */
+void rwlock_read_release(rwlock_t* lock) {
+    lockdep_release(lock);
+    __atomic_fetch_sub(&lock->cnt, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Acquire for writing; flags the lock so no new readers enter, then
+ * waits for the current ones to leave
+ */
+void rwlock_write_acquire(rwlock_t* lock) {
+    lockdep_acquire(lock, 0);
+
+    for (;;) {
+        uint32_t v = __atomic_load_n(&lock->cnt, __ATOMIC_RELAXED);
+        if ((v & ~RWLOCK_WAITING) == 0) {
+            /* Taking it clears WAITING; other waiting writers set it again */
+            if (__atomic_compare_exchange_n(&lock->cnt, &v, RWLOCK_WRITER, 0,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return;
+            }
+            continue;
+        }
+        if (!(v & RWLOCK_WAITING)) {
+            __atomic_compare_exchange_n(&lock->cnt, &v, v | RWLOCK_WAITING, 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        }
+        cpu_relax();
+    }
+}
+
+/**
+ * Release a write hold
+ */
+void rwlock_write_release(rwlock_t* lock) {
+    lockdep_release(lock);
+    __atomic_fetch_and(&lock->cnt, ~RWLOCK_WRITER, __ATOMIC_RELEASE);
+}
+
+/* ---- Lock-order validation ---- */
+
+#ifdef ENABLE_LOCKDEP
+
+#define LOCKDEP_HASH_SIZE   (LOCKDEP_MAX_LOCKS * 2)
+#define LOCKDEP_WORDS       (LOCKDEP_MAX_LOCKS / 32)
+
+typedef struct {
+    const void* locks[LOCKDEP_MAX_HELD];
+    uint16_t ids[LOCKDEP_MAX_HELD];
+    uint32_t depth;
+} held_locks_t;
+
+static volatile uint32_t graph_lock;
+static uint16_t lock_ids[LOCKDEP_HASH_SIZE];        /* Open-addressed: address -> id */
+static const void* id_locks[LOCKDEP_MAX_LOCKS];     /* id -> address; id 0 unused */
+static uint32_t next_id = 1;
+static uint32_t deps[LOCKDEP_MAX_LOCKS][LOCKDEP_WORDS];     /* Bit b of deps[a]: a before b */
+static held_locks_t held[MAX_CPUS];
+static lockdep_stats_t dep_stats;
+static void (*dep_handler)(const lockdep_report_t* report);
+
+/* Search scratch, used under graph_lock */
+static uint16_t search_stack[LOCKDEP_MAX_LOCKS];
+static uint32_t search_seen[LOCKDEP_WORDS];
+
+/* The graph's own lock must not recurse into validation */
+static void graph_acquire(void) {
+    while (__sync_lock_test_and_set(&graph_lock, 1)) {
+        while (graph_lock) {
+            cpu_relax();
+        }
+    }
+}
+
+static void graph_release(void) {
+    __sync_lock_release(&graph_lock);
+}
+
+static inline int dep_test(uint32_t a, uint32_t b) {
+    return (deps[a][b / 32] >> (b % 32)) & 1;
+}
+
+/**
+ * Graph node for a lock address
+ * @param create Assign a new id if the lock is not yet known
+ * @return id, or 0 if unknown (or the table is full)
+ */
+static uint32_t lock_id(const void* lock, int create) {
+    uint32_t slot = (uint32_t)(((uintptr_t)lock >> 3) * 2654435761u) % LOCKDEP_HASH_SIZE;
+
+    for (uint32_t probes = 0; probes < LOCKDEP_HASH_SIZE; probes++) {
+        uint16_t id = lock_ids[slot];
+        if (id == 0) {
+            if (!create || next_id >= LOCKDEP_MAX_LOCKS) {
+                return 0;
+            }
+            id = (uint16_t)next_id++;
+            lock_ids[slot] = id;
+            id_locks[id] = lock;
+            dep_stats.locks++;
+            return id;
+        }
+        if (id_locks[id] == lock) {
+            return id;
+        }
+        slot = (slot + 1) % LOCKDEP_HASH_SIZE;
+    }
+    return 0;
+}
+
+/**
+ * Is there a path of recorded orderings from one lock to another?
+ */
+static int dep_reachable(uint32_t from, uint32_t to) {
+    uint32_t top = 0;
+
+    for (uint32_t w = 0; w < LOCKDEP_WORDS; w++) {
+        search_seen[w] = 0;
+    }
+    search_stack[top++] = (uint16_t)from;
+    search_seen[from / 32] |= 1u << (from % 32);
+
+    while (top) {
+        uint32_t a = search_stack[--top];
+        if (a == to) {
+            return 1;
+        }
+        for (uint32_t w = 0; w < LOCKDEP_WORDS; w++) {
+            uint32_t bits = deps[a][w] & ~search_seen[w];
+            search_seen[w] |= bits;
+            while (bits) {
+                uint32_t b = (uint32_t)__builtin_ctz(bits);
+                bits &= bits - 1;
+                search_stack[top++] = (uint16_t)(w * 32 + b);
+            }
+        }
+    }
+    return 0;
+}
+
+static void lockdep_acquire(const void* lock, int flags) {
+    uint32_t cpu = this_cpu();
+    held_locks_t* h = &held[cpu];
+    lockdep_report_t report = { 0, cpu, NULL, lock };
+
+    graph_acquire();
+    uint32_t id = lock_id(lock, 1);
+    if (!id || h->depth >= LOCKDEP_MAX_HELD) {
+        dep_stats.untracked++;
+        graph_release();
+        return;
+    }
+    dep_stats.acquisitions++;
+
+    for (uint32_t i = 0; i < h->depth; i++) {
+        uint32_t prev = h->ids[i];
+        if (prev == id) {
+            if (!(flags & (LOCKDEP_READ | LOCKDEP_TRY)) && !report.kind) {
+                report.kind = LOCKDEP_RECURSION;
+                report.held = lock;
+            }
+            continue;
+        }
+        if (dep_test(prev, id)) {
+            continue;
+        }
+        /* A trylock cannot wait, so it cannot close a deadlock either */
+        if (!(flags & LOCKDEP_TRY) && dep_reachable(id, prev)) {
+            if (!report.kind) {
+                report.kind = LOCKDEP_INVERSION;
+                report.held = h->locks[i];
+            }
+            continue;
+        }
+        deps[prev][id / 32] |= 1u << (id % 32);
+        dep_stats.dependencies++;
+    }
+
+    h->locks[h->depth] = lock;
+    h->ids[h->depth] = (uint16_t)id;
+    h->depth++;
+
+    if (report.kind) {
+        dep_stats.violations++;
+        dep_stats.last = report;
+    }
+    void (*handler)(const lockdep_report_t*) = dep_handler;
+    graph_release();
+
+    if (report.kind && handler) {
+        handler(&report);
+    }
+}
+
+static void lockdep_release(const void* lock) {
+    uint32_t cpu = this_cpu();
+    held_locks_t* h = &held[cpu];
+    lockdep_report_t report = { LOCKDEP_UNHELD, cpu, NULL, lock };
+
+    graph_acquire();
+    /* Most recent hold first; locks need not be released in order */
+    for (uint32_t i = h->depth; i-- > 0;) {
+        if (h->locks[i] == lock) {
+            for (uint32_t j = i + 1; j < h->depth; j++) {
+                h->locks[j - 1] = h->locks[j];
+                h->ids[j - 1] = h->ids[j];
+            }
+            h->depth--;
+            graph_release();
+            return;
+        }
+    }
+
+    /* Acquisitions that were not tracked are not reported */
+    if (!lock_id(lock, 0)) {
+        graph_release();
+        return;
+    }
+    dep_stats.violations++;
+    dep_stats.last = report;
+    void (*handler)(const lockdep_report_t*) = dep_handler;
+    graph_release();
+
+    if (handler) {
+        handler(&report);
+    }
+}
+
+/**
+ * Set the violation handler
+ */
+void lockdep_set_handler(void (*handler)(const lockdep_report_t* report)) {
+    dep_handler = handler;
+}
+
+/**
+ * Get lock-order validation statistics
+ */
+void lockdep_get_stats(lockdep_stats_t* stats) {
+    if (!stats) {
+        return;
+    }
+    graph_acquire();
+    *stats = dep_stats;
+    graph_release();
+}
+
+/**
+ * Clear the dependency graph
+ */
+void lockdep_reset(void) {
+    graph_acquire();
+    for (uint32_t i = 0; i < LOCKDEP_HASH_SIZE; i++) {
+        lock_ids[i] = 0;
+    }
+    for (uint32_t a = 0; a < LOCKDEP_MAX_LOCKS; a++) {
+        id_locks[a] = NULL;
+        for (uint32_t w = 0; w < LOCKDEP_WORDS; w++) {
+            deps[a][w] = 0;
+        }
+    }
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        held[cpu].depth = 0;
+    }
+    next_id = 1;
+    dep_stats = (lockdep_stats_t){0};
+    graph_release();
+}
+
+#endif /* ENABLE_LOCKDEP */
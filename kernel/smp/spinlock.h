@@ -0,0 +1,221 @@
+/**
+ * Aurora OS - Spinlocks Header
+ *
+ * Busy-waiting locks for multi-core synchronization:
+ *
+ *  - spinlock_t: ticket lock. FIFO and a single cache line, the default
+ *    for short critical sections
+ *  - qspinlock_t: queued lock in one 32-bit word. Waiters spin on their
+ *    own per-CPU MCS node instead of the lock word, so hand-off costs one
+ *    cache line transfer however many CPUs wait; for contended locks
+ *  - mcs_lock_t: plain MCS lock with caller-supplied queue nodes
+ *  - rwlock_t: reader-writer lock that holds new readers back once a
+ *    writer is waiting
+ *
+ * spinlock_t and qspinlock_t can carry optional contention statistics.
+ * Building with ENABLE_LOCKDEP adds lock-order validation: every lock
+ * acquired while another is held records an ordering edge, and taking
+ * two locks in an order that closes a cycle is reported as a potential
+ * deadlock before the CPU starts spinning. Locks are told apart by
+ * address, so the lock structures are the same size in both builds.
+ */
+
+#ifndef AURORA_SPINLOCK_H
+#define AURORA_SPINLOCK_H
+
+#include <stdint.h>
+
+/* Contention statistics for one lock, in TSC cycles. Updated while the
+ * lock is held, so they cost no extra atomics. */
+typedef struct {
+    uint64_t acquisitions;
+    uint64_t contended;             /* Acquisitions that had to wait */
+    uint64_t spin_cycles;           /* Total time spent waiting */
+    uint64_t max_spin_cycles;
+    uint64_t hold_cycles;           /* Total time held */
+    uint64_t max_hold_cycles;
+    uint64_t acquired_at;           /* TSC when the current holder got it */
+} lock_stat_t;
+
+/* Ticket spinlock */
+typedef struct {
+    union {
+        volatile uint32_t val;
+        struct {
+            volatile uint16_t owner;    /* Ticket being served */
+            volatile uint16_t next;     /* Next ticket to hand out */
+        } tickets;
+    };
+    lock_stat_t* stats;
+} spinlock_t;
+
+/* MCS queue node; one per waiter, live until the lock is released */
+typedef struct mcs_node {
+    struct mcs_node* volatile next;
+    volatile uint32_t locked;
+} mcs_node_t;
+
+/* MCS lock */
+typedef struct {
+    mcs_node_t* volatile tail;
+} mcs_lock_t;
+
+/* Queued spinlock: locked byte in bits 0-7, queue tail (CPU and
+ * nesting level of the last waiter's node) in bits 16-31 */
+typedef struct {
+    union {
+        volatile uint32_t val;
+        struct {
+            volatile uint8_t locked;
+            uint8_t reserved;
+            volatile uint16_t tail;
+        } word;
+    };
+    lock_stat_t* stats;
+} qspinlock_t;
+
+/* Reader-writer spinlock: reader count in the low bits */
+typedef struct {
+    volatile uint32_t cnt;
+} rwlock_t;
+
+#define RWLOCK_WRITER       0x80000000u     /* Held for writing */
+#define RWLOCK_WAITING      0x40000000u     /* A writer waits; readers hold off */
+#define RWLOCK_READERS      0x3FFFFFFFu
+
+/**
+ * Pause inside a spin loop
+ */
+#ifndef AURORA_STANDALONE
+static inline void cpu_relax(void) {
+    __asm__ volatile("pause" ::: "memory");
+}
+#else
+void cpu_relax(void);               /* Supplied by host harnesses */
+#endif
+
+/* Saved interrupt flag state (EFLAGS) */
+typedef unsigned long irqflags_t;
+
+#define EFLAGS_IF           0x200
+
+/**
+ * Disable interrupts on this CPU, returning the previous state
+ */
+#ifndef AURORA_STANDALONE
+static inline irqflags_t local_irq_save(void) {
+    irqflags_t flags;
+    __asm__ volatile("pushf; pop %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+static inline void local_irq_restore(irqflags_t flags) {
+    if (flags & EFLAGS_IF) {
+        __asm__ volatile("sti" ::: "memory");
+    }
+}
+#else
+/* Host harnesses have no interrupts to mask */
+static inline irqflags_t local_irq_save(void) {
+    return 0;
+}
+
+static inline void local_irq_restore(irqflags_t flags) {
+    (void)flags;
+}
+#endif
+
+/* Ticket spinlock functions */
+void spinlock_init(spinlock_t* lock);
+void spinlock_acquire(spinlock_t* lock);
+void spinlock_release(spinlock_t* lock);
+
+/**
+ * Acquire a spinlock with interrupts disabled on this CPU
+ * Required for any lock an interrupt handler also takes: otherwise an
+ * interrupt arriving while the lock is held spins on it forever.
+ * @return Interrupt state to hand back to spinlock_release_irqrestore()
+ */
+irqflags_t spinlock_acquire_irqsave(spinlock_t* lock);
+void spinlock_release_irqrestore(spinlock_t* lock, irqflags_t flags);
+
+/**
+ * Acquire a spinlock only if it is free
+ * @return 1 if acquired, 0 otherwise
+ */
+int spinlock_try_acquire(spinlock_t* lock);
+
+/**
+ * Start or stop collecting contention statistics for a spinlock
+ * @param stats Zeroed statistics owned by the caller, or NULL to stop
+ */
+void spinlock_set_stats(spinlock_t* lock, lock_stat_t* stats);
+
+/* MCS lock functions; node must stay valid until release */
+void mcs_lock_init(mcs_lock_t* lock);
+void mcs_lock_acquire(mcs_lock_t* lock, mcs_node_t* node);
+void mcs_lock_release(mcs_lock_t* lock, mcs_node_t* node);
+
+/* Queued spinlock functions. Queue nodes are per CPU, four deep, so a
+ * CPU may wait on nested qspinlocks from up to four contexts (process,
+ * and interrupts above it) at once. */
+void qspinlock_init(qspinlock_t* lock);
+void qspinlock_acquire(qspinlock_t* lock);
+void qspinlock_release(qspinlock_t* lock);
+int qspinlock_try_acquire(qspinlock_t* lock);
+void qspinlock_set_stats(qspinlock_t* lock, lock_stat_t* stats);
+
+/* Reader-writer lock functions */
+void rwlock_init(rwlock_t* lock);
+void rwlock_read_acquire(rwlock_t* lock);
+void rwlock_read_release(rwlock_t* lock);
+void rwlock_write_acquire(rwlock_t* lock);
+void rwlock_write_release(rwlock_t* lock);
+
+#ifdef ENABLE_LOCKDEP
+
+/* Maximum locks tracked and locks held at once per CPU */
+#define LOCKDEP_MAX_LOCKS   256
+#define LOCKDEP_MAX_HELD    16
+
+/* Violation kinds */
+#define LOCKDEP_INVERSION   1       /* Acquisition order closes a cycle */
+#define LOCKDEP_RECURSION   2       /* Lock already held by this CPU */
+#define LOCKDEP_UNHELD      3       /* Release of a lock this CPU does not hold */
+
+typedef struct {
+    int kind;
+    uint32_t cpu;
+    const void* held;               /* Lock held (inversion) */
+    const void* acquiring;          /* Lock being acquired or released */
+} lockdep_report_t;
+
+typedef struct {
+    uint64_t acquisitions;          /* Tracked acquisitions */
+    uint64_t violations;
+    uint32_t locks;                 /* Locks in the dependency graph */
+    uint32_t dependencies;          /* Ordering edges recorded */
+    uint64_t untracked;             /* Acquisitions past the table or held-stack limits */
+    lockdep_report_t last;          /* Most recent violation */
+} lockdep_stats_t;
+
+/**
+ * Call a handler for each violation (NULL for none)
+ * The handler runs on the violating CPU before it spins.
+ */
+void lockdep_set_handler(void (*handler)(const lockdep_report_t* report));
+
+/**
+ * Get lock-order validation statistics
+ */
+void lockdep_get_stats(lockdep_stats_t* stats);
+
+/**
+ * Forget all locks, ordering edges and held locks
+ * Only safe while no tracked lock is held.
+ */
+void lockdep_reset(void);
+
+#endif /* ENABLE_LOCKDEP */
+
+#endif /* AURORA_SPINLOCK_H */
@@ -2100,33 +2100,117 @@ static char gdb_nibble_to_hex(uint8_t nibble) {
     return hex[nibble & 0x0F];
 }
 
-static uint8_t gdb_calculate_checksum(const char *data, size_t len) {
-    uint8_t checksum = 0;
-    for (size_t i = 0; i < len; i++) {
-        checksum += (uint8_t)data[i];
-    }
-    return checksum;
+/* Check whether a byte must be escaped in RSP packet data */
+static bool gdb_needs_escape(uint8_t c) {
+    return c == '$' || c == '#' || c == '}' || c == '*';
 }
 
-/* Format GDB RSP packet: $data#checksum */
-static int gdb_format_packet(const char *data, char *out_buf, size_t buf_size) {
-    size_t data_len = 0;
-    while (data[data_len]) data_len++;
+/* Format GDB RSP packet: $data#checksum, escaping binary data */
+static int gdb_format_packet(const char *data, size_t data_len, char *out_buf, size_t buf_size) {
+    size_t n = 0;
+    uint8_t checksum = 0;
     
-    if (data_len + 5 > buf_size) return -1;  /* $...#XX */
+    if (buf_size < 5) return -1;  /* $...#XX */
     
-    out_buf[0] = '$';
+    out_buf[n++] = '$';
     for (size_t i = 0; i < data_len; i++) {
-        out_buf[i + 1] = data[i];
+        uint8_t c = (uint8_t)data[i];
+        size_t cost = gdb_needs_escape(c) ? 2 : 1;
+        if (n + cost + 4 > buf_size) return -1;
+        if (cost == 2) {
+            out_buf[n++] = '}';
+            checksum += '}';
+            c ^= 0x20;
+        }
+        out_buf[n++] = (char)c;
+        checksum += c;
     }
-    out_buf[data_len + 1] = '#';
+    out_buf[n++] = '#';
+    out_buf[n++] = gdb_nibble_to_hex(checksum >> 4);
+    out_buf[n++] = gdb_nibble_to_hex(checksum & 0x0F);
+    out_buf[n] = '\0';
     
-    uint8_t checksum = gdb_calculate_checksum(data, data_len);
-    out_buf[data_len + 2] = gdb_nibble_to_hex(checksum >> 4);
-    out_buf[data_len + 3] = gdb_nibble_to_hex(checksum & 0x0F);
-    out_buf[data_len + 4] = '\0';
+    return (int)n;
+}
+
+/* Parse a hex number, stopping at the first non-hex character */
+static uint32_t gdb_parse_hex(const char **p) {
+    uint32_t value = 0;
+    while ((**p >= '0' && **p <= '9') || (**p >= 'a' && **p <= 'f') ||
+           (**p >= 'A' && **p <= 'F')) {
+        value = (value << 4) | gdb_hex_to_nibble(*(*p)++);
+    }
+    return value;
+}
+
+/* Append a value as hex without leading zeros */
+static size_t gdb_format_hex(uint32_t value, char *buf) {
+    size_t n = 0;
+    int shift = 28;
+    while (shift > 0 && ((value >> shift) & 0xF) == 0) shift -= 4;
+    for (; shift >= 0; shift -= 4) {
+        buf[n++] = gdb_nibble_to_hex((value >> shift) & 0xF);
+    }
+    return n;
+}
+
+/* Append a memory-map region element */
+static size_t gdb_format_region(char *buf, const char *type, uint32_t start, uint32_t length) {
+    const char *parts[3] = { "<memory type=\"", "\" start=\"0x", "\" length=\"0x" };
+    size_t n = 0;
+    
+    for (const char *q = parts[0]; *q; q++) buf[n++] = *q;
+    for (const char *q = type; *q; q++) buf[n++] = *q;
+    for (const char *q = parts[1]; *q; q++) buf[n++] = *q;
+    n += gdb_format_hex(start, buf + n);
+    for (const char *q = parts[2]; *q; q++) buf[n++] = *q;
+    n += gdb_format_hex(length, buf + n);
+    buf[n++] = '"';
+    buf[n++] = '/';
+    buf[n++] = '>';
+    return n;
+}
+
+int aurora_vm_gdb_memory_map(const AuroraVM *vm, char *buffer, size_t size) {
+    static const char header[] = "<?xml version=\"1.0\"?><memory-map>";
+    static const char footer[] = "</memory-map>";
+    /* Longest region element: fixed text plus a type and two 8-digit numbers */
+    const size_t max_region = 64;
+    
+    if (!vm || !buffer || size < sizeof(header) + sizeof(footer)) return -1;
+    
+    size_t n = sizeof(header) - 1;
+    platform_memcpy(buffer, header, n);
+    
+    /* Coalesce consecutive pages of the same kind into one region; MMIO
+     * stays separate since accesses cannot straddle its boundaries */
+    int run_kind = 0;           /* 0 = unmapped, 1 = ram, 2 = rom, 3 = MMIO */
+    uint32_t run_start = 0;
+    for (uint32_t page = 0; page <= AURORA_VM_NUM_PAGES; page++) {
+        int kind = 0;
+        if (page < AURORA_VM_NUM_PAGES) {
+            uint32_t addr = page * AURORA_VM_PAGE_SIZE;
+            uint8_t prot = vm->pages[page].protection;
+            if (addr >= AURORA_VM_MMIO_BASE && addr < AURORA_VM_MMIO_BASE + AURORA_VM_MMIO_SIZE) {
+                kind = 3;
+            } else if ((prot & AURORA_PAGE_PRESENT) && (prot & AURORA_PAGE_READ)) {
+                kind = (prot & AURORA_PAGE_WRITE) ? 1 : 2;
+            }
+        }
+        
+        if (kind == run_kind) continue;
+        
+        if (run_kind != 0) {
+            if (n + max_region + sizeof(footer) > size) return -1;
+            n += gdb_format_region(buffer + n, run_kind == 2 ? "rom" : "ram", run_start,
+                                   page * AURORA_VM_PAGE_SIZE - run_start);
+        }
+        run_kind = kind;
+        run_start = page * AURORA_VM_PAGE_SIZE;
+    }
     
-    return (int)(data_len + 4);
+    platform_memcpy(buffer + n, footer, sizeof(footer));
+    return (int)(n + sizeof(footer) - 1);
 }
 
 /* Format register value as hex string (little-endian) */
@@ -2139,7 +2223,7 @@ static int gdb_format_reg32(uint32_t value, char *buf) {
     return 8;
 }
 
-/* Parse GDB RSP packet and handle command */
+/* Parse GDB RSP packet and handle command, returns the response length */
 static int gdb_handle_packet(AuroraVM *vm, const char *packet, char *response, size_t resp_size) {
     if (!packet || !response || resp_size < 4) return -1;
     
@@ -2215,7 +2299,8 @@ static int gdb_handle_packet(AuroraVM *vm, const char *packet, char *response, s
                 }
                 
                 /* Validate and read memory */
-                if (addr + len <= AURORA_VM_MEMORY_SIZE && len * 2 < resp_size) {
+                if (addr <= AURORA_VM_MEMORY_SIZE && len <= AURORA_VM_MEMORY_SIZE - addr &&
+                    len * 2 < resp_size) {
                     char *out = response;
                     for (uint32_t i = 0; i < len; i++) {
                         uint8_t byte = vm->memory[addr + i];
@@ -2248,7 +2333,7 @@ static int gdb_handle_packet(AuroraVM *vm, const char *packet, char *response, s
                 if (*p == ':') p++;
                 
                 /* Write memory */
-                if (addr + len <= AURORA_VM_MEMORY_SIZE) {
+                if (addr <= AURORA_VM_MEMORY_SIZE && len <= AURORA_VM_MEMORY_SIZE - addr) {
                     for (uint32_t i = 0; i < len && *p && *(p+1); i++) {
                         vm->memory[addr + i] = (gdb_hex_to_nibble(*p) << 4) | gdb_hex_to_nibble(*(p+1));
                         p += 2;
@@ -2260,6 +2345,107 @@ static int gdb_handle_packet(AuroraVM *vm, const char *packet, char *response, s
             }
             break;
             
+        case 'X':
+            /* Binary write memory: Xaddr,length:data ('}' escapes) */
+            {
+                const char *p = packet + 1;
+                uint32_t addr = gdb_parse_hex(&p);
+                uint32_t len = 0;
+                if (*p == ',') {
+                    p++;
+                    len = gdb_parse_hex(&p);
+                }
+                
+                if (*p != ':' || addr > AURORA_VM_MEMORY_SIZE ||
+                    len > AURORA_VM_MEMORY_SIZE - addr) {
+                    platform_strncpy(response, "E01", resp_size);
+                    break;
+                }
+                p++;
+                
+                /* Data may contain NUL bytes; only the declared length counts */
+                uint32_t i = 0;
+                uint8_t *dst = &vm->memory[addr];
+                while (i < len && *p != '#') {
+                    if (*p == '}') {
+                        dst[i++] = (uint8_t)(p[1] ^ 0x20);
+                        p += 2;
+                    } else {
+                        dst[i++] = (uint8_t)*p++;
+                    }
+                }
+                platform_strncpy(response, i == len ? "OK" : "E01", resp_size);
+            }
+            break;
+            
+        case 'x':
+            /* Binary read memory: xaddr,length -> 'b' + raw bytes */
+            {
+                const char *p = packet + 1;
+                uint32_t addr = gdb_parse_hex(&p);
+                uint32_t len = 0;
+                if (*p == ',') {
+                    p++;
+                    len = gdb_parse_hex(&p);
+                }
+                
+                if (len >= resp_size) len = (uint32_t)resp_size - 1;
+                if (addr > AURORA_VM_MEMORY_SIZE || len > AURORA_VM_MEMORY_SIZE - addr) {
+                    platform_strncpy(response, "E01", resp_size);
+                    break;
+                }
+                
+                response[0] = 'b';
+                platform_memcpy(response + 1, &vm->memory[addr], len);
+                return (int)len + 1;
+            }
+            
+        case 'v':
+            /* vCont: single thread, so the first action applies */
+            if (platform_strncmp(packet, "vCont?", 6) == 0) {
+                platform_strncpy(response, "vCont;c;C;s;S;r", resp_size);
+            } else if (platform_strncmp(packet, "vCont;", 6) == 0) {
+                char action = packet[6];
+                if (action == 'c' || action == 'C') {
+                    vm->cpu.halted = false;
+                    vm->debugger.single_step = false;
+                    platform_strncpy(response, "OK", resp_size);
+                } else if (action == 's' || action == 'S' || action == 'r') {
+                    /* Range step (r start,end) batches steps until PC leaves the range */
+                    uint32_t start = 0, end = 0;
+                    if (action == 'r') {
+                        const char *p = packet + 7;
+                        start = gdb_parse_hex(&p);
+                        if (*p == ',') p++;
+                        end = gdb_parse_hex(&p);
+                    }
+                    
+                    vm->cpu.halted = false;
+                    vm->debugger.single_step = true;
+                    uint32_t steps = 0;
+                    do {
+                        if (aurora_vm_step(vm) != 0) break;
+                        steps++;
+                    } while (vm->cpu.pc >= start && vm->cpu.pc < end && steps < 0x100000);
+                    vm->cpu.halted = true;
+                    platform_strncpy(response, "S05", resp_size);
+                } else {
+                    platform_strncpy(response, "E01", resp_size);
+                }
+            } else {
+                platform_strncpy(response, "", resp_size);
+            }
+            break;
+            
+        case 'Q':
+            if (platform_strncmp(packet + 1, "StartNoAckMode", 14) == 0) {
+                vm->gdb.no_ack_mode = true;
+                platform_strncpy(response, "OK", resp_size);
+            } else {
+                platform_strncpy(response, "", resp_size);
+            }
+            break;
+            
         case 'c':
             /* Continue execution */
             vm->cpu.halted = false;
@@ -2321,7 +2507,35 @@ static int gdb_handle_packet(AuroraVM *vm, const char *packet, char *response, s
         case 'q':
             /* Query commands */
             if (platform_strncmp(packet + 1, "Supported", 9) == 0) {
-                platform_strncpy(response, "PacketSize=1000", resp_size);
+                size_t n = 0;
+                platform_strncpy(response, "PacketSize=", resp_size);
+                n = platform_strlen(response);
+                n += gdb_format_hex(AURORA_VM_GDB_PACKET_SIZE, response + n);
+                platform_strncpy(response + n, ";QStartNoAckMode+;qXfer:memory-map:read+;vContSupported+",
+                                 resp_size - n);
+            } else if (platform_strncmp(packet + 1, "Xfer:memory-map:read::", 22) == 0) {
+                /* Reply 'm' + chunk when more follows, 'l' + final chunk */
+                const char *p = packet + 23;
+                uint32_t offset = gdb_parse_hex(&p);
+                uint32_t len = 0;
+                if (*p == ',') {
+                    p++;
+                    len = gdb_parse_hex(&p);
+                }
+                
+                char map[512];
+                int map_len = aurora_vm_gdb_memory_map(vm, map, sizeof(map));
+                if (map_len < 0) {
+                    platform_strncpy(response, "E01", resp_size);
+                    break;
+                }
+                if (len > resp_size - 2) len = (uint32_t)resp_size - 2;
+                
+                uint32_t avail = offset < (uint32_t)map_len ? (uint32_t)map_len - offset : 0;
+                uint32_t chunk = avail < len ? avail : len;
+                response[0] = chunk < avail ? 'm' : 'l';
+                platform_memcpy(response + 1, map + offset, chunk);
+                response[chunk + 1] = '\0';
             } else if (platform_strncmp(packet + 1, "Attached", 8) == 0) {
                 platform_strncpy(response, "1", resp_size);  /* Attached to existing process */
             } else {
@@ -2342,7 +2556,7 @@ static int gdb_handle_packet(AuroraVM *vm, const char *packet, char *response, s
             break;
     }
     
-    return 0;
+    return (int)platform_strlen(response);
 }
 
 int aurora_vm_gdb_start(AuroraVM *vm, int port) {
@@ -2395,17 +2609,27 @@ int aurora_vm_gdb_handle(AuroraVM *vm) {
 /* Process a raw GDB RSP packet and generate response */
 int aurora_vm_gdb_process_packet(AuroraVM *vm, const char *packet, 
                                   char *response, size_t response_size) {
-    if (!vm || !vm->gdb.enabled || !packet || !response) return -1;
+    if (!vm || !vm->gdb.enabled || !packet || !response || response_size < 2) return -1;
+    
+    /* Sized for the advertised PacketSize; the VM is single-threaded */
+    static char raw_response[AURORA_VM_GDB_PACKET_SIZE];
     
-    char raw_response[512];
+    /* Ack state is sampled first so QStartNoAckMode's own reply is acked */
+    bool ack = !vm->gdb.no_ack_mode;
     
     /* Handle the GDB command */
-    if (gdb_handle_packet(vm, packet, raw_response, sizeof(raw_response)) < 0) {
+    int raw_len = gdb_handle_packet(vm, packet, raw_response, sizeof(raw_response));
+    if (raw_len < 0) {
         return -1;
     }
     
     /* Format as proper RSP packet */
-    return gdb_format_packet(raw_response, response, response_size);
+    if (ack) {
+        response[0] = '+';
+        int len = gdb_format_packet(raw_response, (size_t)raw_len, response + 1, response_size - 1);
+        return len < 0 ? -1 : len + 1;
+    }
+    return gdb_format_packet(raw_response, (size_t)raw_len, response, response_size);
 }
 
 /* ============================================================================
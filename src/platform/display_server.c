@@ -7,160 +7,39 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "../../include/platform/display_server.h"
 #include "../../include/platform/platform_util.h"
 
 /* ============================================================================
  * DISPLAY SERVER DEFINITIONS
  * ============================================================================ */
 
-/* Display protocol types */
-typedef enum {
-    DISPLAY_PROTOCOL_NONE = 0,
-    DISPLAY_PROTOCOL_X11,
-    DISPLAY_PROTOCOL_WAYLAND
-} display_protocol_t;
+/* Damage boxes tracked per output before merging */
+#define DISPLAY_MAX_DAMAGE          16
 
-/* X11 Protocol Constants */
-#define X11_PROTOCOL_MAJOR      11
-#define X11_PROTOCOL_MINOR      0
+/* X11 server limits */
+#define X11_MAX_CLIENTS             16
+#define X11_MAX_WINDOWS             64          /* Per client */
+#define X11_MAX_PIXMAPS             32          /* Per client */
+#define X11_MAX_GCS                 32          /* Per client */
+#define X11_RESOURCE_BITS           12
+#define X11_RESOURCE_SLOTS          (1u << X11_RESOURCE_BITS)
+#define X11_MAX_PIXMAP_PIXELS       (16u * 1024 * 1024)
 
-/* X11 Request opcodes */
-typedef enum {
-    X11_CreateWindow = 1,
-    X11_ChangeWindowAttributes = 2,
-    X11_GetWindowAttributes = 3,
-    X11_DestroyWindow = 4,
-    X11_DestroySubwindows = 5,
-    X11_ChangeSaveSet = 6,
-    X11_ReparentWindow = 7,
-    X11_MapWindow = 8,
-    X11_MapSubwindows = 9,
-    X11_UnmapWindow = 10,
-    X11_UnmapSubwindows = 11,
-    X11_ConfigureWindow = 12,
-    X11_CirculateWindow = 13,
-    X11_GetGeometry = 14,
-    X11_QueryTree = 15,
-    X11_InternAtom = 16,
-    X11_GetAtomName = 17,
-    X11_ChangeProperty = 18,
-    X11_DeleteProperty = 19,
-    X11_GetProperty = 20,
-    X11_ListProperties = 21,
-    X11_SetSelectionOwner = 22,
-    X11_GetSelectionOwner = 23,
-    X11_ConvertSelection = 24,
-    X11_SendEvent = 25,
-    X11_GrabPointer = 26,
-    X11_UngrabPointer = 27,
-    X11_GrabButton = 28,
-    X11_UngrabButton = 29,
-    X11_ChangeActivePointerGrab = 30,
-    X11_GrabKeyboard = 31,
-    X11_UngrabKeyboard = 32,
-    X11_GrabKey = 33,
-    X11_UngrabKey = 34,
-    X11_AllowEvents = 35,
-    X11_GrabServer = 36,
-    X11_UngrabServer = 37,
-    X11_QueryPointer = 38,
-    X11_GetMotionEvents = 39,
-    X11_TranslateCoords = 40,
-    X11_WarpPointer = 41,
-    X11_SetInputFocus = 42,
-    X11_GetInputFocus = 43,
-    X11_QueryKeymap = 44,
-    X11_OpenFont = 45,
-    X11_CloseFont = 46,
-    X11_QueryFont = 47,
-    X11_QueryTextExtents = 48,
-    X11_ListFonts = 49,
-    X11_ListFontsWithInfo = 50,
-    X11_SetFontPath = 51,
-    X11_GetFontPath = 52,
-    X11_CreatePixmap = 53,
-    X11_FreePixmap = 54,
-    X11_CreateGC = 55,
-    X11_ChangeGC = 56,
-    X11_CopyGC = 57,
-    X11_SetDashes = 58,
-    X11_SetClipRectangles = 59,
-    X11_FreeGC = 60,
-    X11_ClearArea = 61,
-    X11_CopyArea = 62,
-    X11_CopyPlane = 63,
-    X11_PolyPoint = 64,
-    X11_PolyLine = 65,
-    X11_PolySegment = 66,
-    X11_PolyRectangle = 67,
-    X11_PolyArc = 68,
-    X11_FillPoly = 69,
-    X11_PolyFillRectangle = 70,
-    X11_PolyFillArc = 71,
-    X11_PutImage = 72,
-    X11_GetImage = 73,
-    X11_PolyText8 = 74,
-    X11_PolyText16 = 75,
-    X11_ImageText8 = 76,
-    X11_ImageText16 = 77,
-    X11_CreateColormap = 78,
-    X11_FreeColormap = 79,
-    X11_CopyColormapAndFree = 80,
-    X11_InstallColormap = 81,
-    X11_UninstallColormap = 82,
-    X11_ListInstalledColormaps = 83,
-    X11_AllocColor = 84,
-    X11_AllocNamedColor = 85,
-    X11_AllocColorCells = 86,
-    X11_AllocColorPlanes = 87,
-    X11_FreeColors = 88,
-    X11_StoreColors = 89,
-    X11_StoreNamedColor = 90,
-    X11_QueryColors = 91,
-    X11_LookupColor = 92,
-    X11_CreateCursor = 93,
-    X11_CreateGlyphCursor = 94,
-    X11_FreeCursor = 95,
-    X11_RecolorCursor = 96,
-    X11_QueryBestSize = 97,
-    X11_QueryExtension = 98,
-    X11_ListExtensions = 99,
-    X11_ChangeKeyboardMapping = 100,
-    X11_GetKeyboardMapping = 101,
-    X11_ChangeKeyboardControl = 102,
-    X11_GetKeyboardControl = 103,
-    X11_Bell = 104,
-    X11_ChangePointerControl = 105,
-    X11_GetPointerControl = 106,
-    X11_SetScreenSaver = 107,
-    X11_GetScreenSaver = 108,
-    X11_ChangeHosts = 109,
-    X11_ListHosts = 110,
-    X11_SetAccessControl = 111,
-    X11_SetCloseDownMode = 112,
-    X11_KillClient = 113,
-    X11_RotateProperties = 114,
-    X11_ForceScreenSaver = 115,
-    X11_SetPointerMapping = 116,
-    X11_GetPointerMapping = 117,
-    X11_SetModifierMapping = 118,
-    X11_GetModifierMapping = 119,
-    X11_NoOperation = 127
-} x11_request_t;
-
-/* Wayland Protocol Constants */
-#define WL_DISPLAY_SYNC             0
-#define WL_DISPLAY_GET_REGISTRY     1
-#define WL_REGISTRY_BIND            0
-#define WL_COMPOSITOR_CREATE_SURFACE 0
-#define WL_COMPOSITOR_CREATE_REGION 1
-#define WL_SHM_CREATE_POOL          0
-#define WL_SHM_POOL_CREATE_BUFFER   0
-#define WL_SURFACE_DESTROY          0
-#define WL_SURFACE_ATTACH           1
-#define WL_SURFACE_DAMAGE           2
-#define WL_SURFACE_FRAME            3
-#define WL_SURFACE_COMMIT           4
+/* Largest request without BIG-REQUESTS is 65535 * 4 bytes */
+#define X11_REQUEST_BUFFER_SIZE     (256u * 1024)
+
+/* Wayland compositor limits */
+#define WL_MAX_CLIENTS              16
+#define WL_MAX_SURFACES             32          /* Per client */
+#define WL_MAX_POOLS                8           /* Per client */
+#define WL_MAX_BUFFERS              8           /* Per pool */
+
+/* Half-open box in output (or pixmap) coordinates */
+typedef struct {
+    int32_t x0, y0;
+    int32_t x1, y1;
+} display_box_t;
 
 /* ============================================================================
  * X11 STRUCTURES
@@ -174,15 +53,17 @@ typedef struct {
     uint16_t width, height;
     uint16_t border_width;
     uint16_t window_class;
+    uint8_t depth;
     uint32_t visual;
     uint32_t background_pixel;
     uint32_t border_pixel;
+    bool has_background;
     bool mapped;
     bool override_redirect;
     uint32_t event_mask;
 } x11_window_t;
 
-/* X11 Pixmap */
+/* X11 Pixmap (stored at 32 bits per pixel whatever its depth) */
 typedef struct {
     uint32_t id;
     uint32_t drawable;
@@ -220,14 +101,36 @@ typedef struct {
     bool connected;
     uint32_t resource_base;
     uint32_t resource_mask;
-    x11_window_t windows[64];
+    x11_window_t windows[X11_MAX_WINDOWS];
     uint32_t window_count;
-    x11_pixmap_t pixmaps[32];
+    x11_pixmap_t pixmaps[X11_MAX_PIXMAPS];
     uint32_t pixmap_count;
-    x11_gc_t gcs[32];
+    x11_gc_t gcs[X11_MAX_GCS];
     uint32_t gc_count;
+    /* Request stream, [request_head, request_tail) not yet executed */
+    uint8_t* request_buffer;
+    uint32_t request_head;
+    uint32_t request_tail;
+    uint16_t sequence;
+    uint8_t last_error;
+    uint32_t error_count;
 } x11_client_t;
 
+/* Resource table entry mapping a server-wide id to its owner's slot */
+typedef enum {
+    X11_RESOURCE_NONE = 0,
+    X11_RESOURCE_WINDOW,
+    X11_RESOURCE_PIXMAP,
+    X11_RESOURCE_GC
+} x11_resource_type_t;
+
+typedef struct {
+    uint32_t id;
+    uint8_t type;
+    uint8_t client;
+    uint16_t index;
+} x11_resource_t;
+
 /* X11 Server State */
 typedef struct {
     bool initialized;
@@ -237,48 +140,61 @@ typedef struct {
     uint8_t screen_depth;
     uint32_t root_window;
     uint32_t root_visual;
-    x11_client_t clients[16];
+    x11_client_t clients[X11_MAX_CLIENTS];
     uint32_t client_count;
     x11_atom_t atoms[256];
     uint32_t atom_count;
     uint32_t next_resource_id;
+    /* Windows, pixmaps and GCs of all clients, open addressed */
+    x11_resource_t resources[X11_RESOURCE_SLOTS];
     /* Framebuffer */
     void* framebuffer;
     uint32_t fb_size;
+    /* Drawing target; damage is copied to the framebuffer on flush */
+    uint32_t* shadow;
+    display_box_t damage[DISPLAY_MAX_DAMAGE];
+    uint32_t damage_count;
+    x11_stats_t stats;
 } x11_server_t;
 
 /* ============================================================================
  * WAYLAND STRUCTURES
  * ============================================================================ */
 
-/* Wayland Surface */
-typedef struct {
-    uint32_t id;
-    int32_t x, y;
-    int32_t width, height;
-    void* buffer;
-    uint32_t buffer_size;
-    bool committed;
-    bool damaged;
-    int32_t damage_x, damage_y;
-    int32_t damage_width, damage_height;
-} wl_surface_t;
-
-/* Wayland Buffer */
+/* Wayland Buffer (a slice of a shm pool) */
 typedef struct {
     uint32_t id;
     void* data;
     int32_t width, height;
     int32_t stride;
     uint32_t format;
+    uint32_t refs;              /* Surfaces and scanout reading the buffer */
 } wl_buffer_t;
 
+/* Wayland Surface */
+typedef struct {
+    uint32_t id;
+    int32_t x, y;               /* Position on the output */
+    int32_t width, height;      /* Size of the current buffer */
+    wl_buffer_t* buffer;        /* Current buffer, composed from in place */
+    bool committed;
+    /* Pending state, applied atomically by commit */
+    wl_buffer_t* pending_buffer;
+    bool pending_attach;
+    int32_t pending_dx, pending_dy;
+    display_box_t pending_damage[DISPLAY_MAX_DAMAGE];   /* Surface coordinates */
+    uint32_t pending_damage_count;
+    bool pending_frame;
+    bool frame_requested;
+    uint32_t frames_done;
+} wl_surface_t;
+
 /* Wayland SHM Pool */
 typedef struct {
     uint32_t id;
     void* data;
     int32_t size;
-    wl_buffer_t buffers[8];
+    wl_buffer_t buffers[WL_MAX_BUFFERS];
     uint32_t buffer_count;
 } wl_shm_pool_t;
 
@@ -286,9 +202,9 @@ typedef struct {
 typedef struct {
     uint32_t id;
     bool connected;
-    wl_surface_t surfaces[32];
+    wl_surface_t surfaces[WL_MAX_SURFACES];
     uint32_t surface_count;
-    wl_shm_pool_t shm_pools[8];
+    wl_shm_pool_t shm_pools[WL_MAX_POOLS];
     uint32_t shm_pool_count;
 } wl_client_t;
 
@@ -298,12 +214,19 @@ typedef struct {
     bool running;
     uint32_t width;
     uint32_t height;
-    wl_client_t clients[16];
+    wl_client_t clients[WL_MAX_CLIENTS];
     uint32_t client_count;
     uint32_t next_id;
     /* Framebuffer */
     void* framebuffer;
     uint32_t fb_size;
+    /* What the display scans out: the framebuffer or a client buffer */
+    void* scanout;
+    wl_buffer_t* scanout_buffer;
+    uint32_t clear_color;
+    display_box_t damage[DISPLAY_MAX_DAMAGE];   /* Output coordinates */
+    uint32_t damage_count;
+    wl_stats_t stats;
 } wl_compositor_t;
 
 /* ============================================================================
@@ -315,233 +238,1911 @@ static wl_compositor_t g_wayland_compositor;
 static display_protocol_t g_active_protocol = DISPLAY_PROTOCOL_NONE;
 
 /* ============================================================================
- * X11 SERVER IMPLEMENTATION
+ * PIXEL OPERATIONS
  * ============================================================================ */
 
+/* 16-byte vector without alignment requirements (SSE2 on x86-64) */
+typedef uint32_t display_vec_t __attribute__((vector_size(16), aligned(1), may_alias));
+
 /**
- * Initialize X11 server
+ * Copy bytes sixteen at a time
+ * Each block is loaded before it is stored, so overlapping copies with
+ * dst below src are safe.
  */
-int x11_server_init(uint32_t width, uint32_t height, uint8_t depth, void* framebuffer) {
-    if (g_x11_server.initialized) {
-        return 0;
-    }
-    
-    platform_memset(&g_x11_server, 0, sizeof(x11_server_t));
-    
-    g_x11_server.screen_width = width;
-    g_x11_server.screen_height = height;
-    g_x11_server.screen_depth = depth;
-    g_x11_server.framebuffer = framebuffer;
-    g_x11_server.fb_size = width * height * (depth / 8);
-    
-    /* Create root window */
-    g_x11_server.root_window = 1;
-    g_x11_server.root_visual = 1;
-    g_x11_server.next_resource_id = 0x100;
-    
-    /* Register built-in atoms */
-    g_x11_server.atoms[0].id = 1;
-    platform_strncpy(g_x11_server.atoms[0].name, "PRIMARY", 64);
-    g_x11_server.atoms[1].id = 2;
-    platform_strncpy(g_x11_server.atoms[1].name, "SECONDARY", 64);
-    g_x11_server.atoms[2].id = 3;
-    platform_strncpy(g_x11_server.atoms[2].name, "CLIPBOARD", 64);
-    g_x11_server.atoms[3].id = 4;
-    platform_strncpy(g_x11_server.atoms[3].name, "WM_NAME", 64);
-    g_x11_server.atoms[4].id = 5;
-    platform_strncpy(g_x11_server.atoms[4].name, "WM_CLASS", 64);
-    g_x11_server.atom_count = 5;
-    
-    g_x11_server.initialized = true;
-    g_x11_server.running = true;
+static void display_copy_bytes(void* dst, const void* src, uint32_t n) {
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
     
-    return 0;
+    while (n >= 64) {
+        display_vec_t a = ((const display_vec_t*)s)[0];
+        display_vec_t b = ((const display_vec_t*)s)[1];
+        display_vec_t c = ((const display_vec_t*)s)[2];
+        display_vec_t e = ((const display_vec_t*)s)[3];
+        ((display_vec_t*)d)[0] = a;
+        ((display_vec_t*)d)[1] = b;
+        ((display_vec_t*)d)[2] = c;
+        ((display_vec_t*)d)[3] = e;
+        d += 64;
+        s += 64;
+        n -= 64;
+    }
+    while (n >= 16) {
+        *(display_vec_t*)d = *(const display_vec_t*)s;
+        d += 16;
+        s += 16;
+        n -= 16;
+    }
+    while (n > 0) {
+        *d++ = *s++;
+        n--;
+    }
 }
 
 /**
- * Process X11 request
+ * Move a row of pixels, handling overlap in either direction
  */
-int x11_process_request(uint32_t client_id, uint8_t opcode, uint8_t* data, uint32_t length) {
-    if (!g_x11_server.initialized || !g_x11_server.running) {
-        return -1;
+static void display_move_row(uint32_t* dst, const uint32_t* src, uint32_t n) {
+    if (dst <= src || dst >= src + n) {
+        display_copy_bytes(dst, src, n * 4);
+        return;
     }
-    
-    (void)data;
-    (void)length;
-    
-    switch (opcode) {
-        case X11_CreateWindow:
-            /* Create window request */
-            break;
-        case X11_MapWindow:
-            /* Map window request */
-            break;
-        case X11_UnmapWindow:
-            /* Unmap window request */
-            break;
-        case X11_DestroyWindow:
-            /* Destroy window request */
-            break;
-        case X11_CreateGC:
-            /* Create graphics context */
-            break;
-        case X11_PutImage:
-            /* Put image to drawable */
-            break;
-        case X11_PolyFillRectangle:
-            /* Fill rectangles */
-            break;
-        case X11_InternAtom:
-            /* Intern atom */
-            break;
-        case X11_GetProperty:
-            /* Get property */
-            break;
-        case X11_NoOperation:
-            /* No operation */
-            break;
-        default:
-            break;
+    while (n > 0) {
+        n--;
+        dst[n] = src[n];
     }
-    
-    (void)client_id;
-    return 0;
 }
 
 /**
- * Accept X11 client connection
+ * Fill a row of pixels
  */
-int x11_accept_client(void) {
-    if (!g_x11_server.initialized) {
-        return -1;
-    }
+static void display_fill_row(uint32_t* dst, uint32_t n, uint32_t pixel) {
+    display_vec_t v = { pixel, pixel, pixel, pixel };
     
-    if (g_x11_server.client_count >= 16) {
-        return -1;
+    while (n >= 16) {
+        ((display_vec_t*)dst)[0] = v;
+        ((display_vec_t*)dst)[1] = v;
+        ((display_vec_t*)dst)[2] = v;
+        ((display_vec_t*)dst)[3] = v;
+        dst += 16;
+        n -= 16;
+    }
+    while (n >= 4) {
+        *(display_vec_t*)dst = v;
+        dst += 4;
+        n -= 4;
+    }
+    while (n > 0) {
+        *dst++ = pixel;
+        n--;
     }
-    
-    uint32_t client_id = g_x11_server.client_count;
-    x11_client_t* client = &g_x11_server.clients[client_id];
-    
-    platform_memset(client, 0, sizeof(x11_client_t));
-    client->id = client_id;
-    client->connected = true;
-    client->resource_base = g_x11_server.next_resource_id;
-    client->resource_mask = 0x001FFFFF;
-    g_x11_server.next_resource_id += 0x00200000;
-    
-    g_x11_server.client_count++;
-    
-    return (int)client_id;
 }
 
 /**
- * Disconnect X11 client
+ * Apply a GC function to one pixel
  */
-int x11_disconnect_client(uint32_t client_id) {
-    if (client_id >= g_x11_server.client_count) {
-        return -1;
+static inline uint32_t x11_rop(uint8_t function, uint32_t src, uint32_t dst) {
+    switch (function & 0xF) {
+        case 0x0: return 0;                 /* GXclear */
+        case 0x1: return src & dst;         /* GXand */
+        case 0x2: return src & ~dst;        /* GXandReverse */
+        case 0x3: return src;               /* GXcopy */
+        case 0x4: return ~src & dst;        /* GXandInverted */
+        case 0x5: return dst;               /* GXnoop */
+        case 0x6: return src ^ dst;         /* GXxor */
+        case 0x7: return src | dst;         /* GXor */
+        case 0x8: return ~(src | dst);      /* GXnor */
+        case 0x9: return ~(src ^ dst);      /* GXequiv */
+        case 0xA: return ~dst;              /* GXinvert */
+        case 0xB: return src | ~dst;        /* GXorReverse */
+        case 0xC: return ~src;              /* GXcopyInverted */
+        case 0xD: return ~src | dst;        /* GXorInverted */
+        case 0xE: return ~(src & dst);      /* GXnand */
+        default:  return 0xFFFFFFFF;        /* GXset */
     }
+}
+
+/**
+ * Combine a row with a GC's function and plane mask
+ * @param src Source pixels, or NULL to use the constant pixel
+ */
+static void x11_rop_row(uint32_t* dst, const uint32_t* src, uint32_t n,
+                        uint32_t pixel, const x11_gc_t* gc) {
+    uint32_t mask = gc->plane_mask;
     
-    g_x11_server.clients[client_id].connected = false;
-    return 0;
+    if (src && dst > src && dst < src + n) {
+        while (n > 0) {
+            n--;
+            uint32_t r = x11_rop(gc->function, src[n], dst[n]);
+            dst[n] = (r & mask) | (dst[n] & ~mask);
+        }
+        return;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t r = x11_rop(gc->function, src ? src[i] : pixel, dst[i]);
+        dst[i] = (r & mask) | (dst[i] & ~mask);
+    }
+}
+
+/**
+ * Check whether a GC draws with plain copies
+ */
+static inline bool x11_gc_is_copy(const x11_gc_t* gc) {
+    return gc->function == X11_GXcopy && gc->plane_mask == 0xFFFFFFFF;
 }
 
 /* ============================================================================
- * WAYLAND COMPOSITOR IMPLEMENTATION
+ * DAMAGE TRACKING
  * ============================================================================ */
 
+static inline void display_box_intersect(display_box_t* box, int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
+    if (x0 > box->x0) box->x0 = x0;
+    if (y0 > box->y0) box->y0 = y0;
+    if (x1 < box->x1) box->x1 = x1;
+    if (y1 < box->y1) box->y1 = y1;
+}
+
+static inline bool display_box_empty(const display_box_t* box) {
+    return box->x0 >= box->x1 || box->y0 >= box->y1;
+}
+
+static inline uint64_t display_box_area(const display_box_t* box) {
+    return (uint64_t)(box->x1 - box->x0) * (uint64_t)(box->y1 - box->y0);
+}
+
+static inline void display_box_union(display_box_t* box, const display_box_t* other) {
+    if (other->x0 < box->x0) box->x0 = other->x0;
+    if (other->y0 < box->y0) box->y0 = other->y0;
+    if (other->x1 > box->x1) box->x1 = other->x1;
+    if (other->y1 > box->y1) box->y1 = other->y1;
+}
+
 /**
- * Initialize Wayland compositor
+ * Record a damaged box in a list
+ * A box is merged into an existing one when their union covers no more
+ * than the two separately. When the list is full the box joins whichever
+ * entry grows least, so scattered damage does not degrade into a
+ * whole-screen flush.
  */
-int wayland_compositor_init(uint32_t width, uint32_t height, void* framebuffer) {
-    if (g_wayland_compositor.initialized) {
-        return 0;
+static void display_add_damage(display_box_t* list, uint32_t* count, const display_box_t* box) {
+    for (uint32_t i = 0; i < *count; i++) {
+        display_box_t merged = list[i];
+        display_box_union(&merged, box);
+        if (display_box_area(&merged) <= display_box_area(&list[i]) + display_box_area(box)) {
+            list[i] = merged;
+            return;
+        }
     }
     
-    platform_memset(&g_wayland_compositor, 0, sizeof(wl_compositor_t));
-    
-    g_wayland_compositor.width = width;
-    g_wayland_compositor.height = height;
-    g_wayland_compositor.framebuffer = framebuffer;
-    g_wayland_compositor.fb_size = width * height * 4;
-    g_wayland_compositor.next_id = 1;
-    
-    g_wayland_compositor.initialized = true;
-    g_wayland_compositor.running = true;
+    if (*count < DISPLAY_MAX_DAMAGE) {
+        list[(*count)++] = *box;
+        return;
+    }
     
-    return 0;
+    uint32_t best = 0;
+    uint64_t best_growth = ~0ull;
+    for (uint32_t i = 0; i < *count; i++) {
+        display_box_t merged = list[i];
+        display_box_union(&merged, box);
+        uint64_t growth = display_box_area(&merged) - display_box_area(&list[i]);
+        if (growth < best_growth) {
+            best_growth = growth;
+            best = i;
+        }
+    }
+    display_box_union(&list[best], box);
+}
+
+static inline void x11_add_damage(const display_box_t* box) {
+    display_add_damage(g_x11_server.damage, &g_x11_server.damage_count, box);
 }
 
+/* ============================================================================
+ * X11 DAMAGE
+ * ============================================================================ */
+
 /**
- * Process Wayland message
+ * Copy accumulated damage from the shadow buffer to the framebuffer
  */
-int wayland_process_message(uint32_t client_id, uint32_t object_id, 
-                            uint16_t opcode, uint8_t* data, uint32_t length) {
-    if (!g_wayland_compositor.initialized || !g_wayland_compositor.running) {
-        return -1;
-    }
+static void x11_flush_damage(void) {
+    x11_server_t* s = &g_x11_server;
     
-    (void)data;
-    (void)length;
+    if (s->damage_count == 0) {
+        return;
+    }
     
-    /* Handle based on object type and opcode */
-    if (object_id == 1) {
-        /* wl_display */
-        switch (opcode) {
-            case WL_DISPLAY_SYNC:
-                /* Sync request */
-                break;
-            case WL_DISPLAY_GET_REGISTRY:
-                /* Get registry */
-                break;
+    for (uint32_t i = 0; i < s->damage_count; i++) {
+        const display_box_t* d = &s->damage[i];
+        uint32_t width = (uint32_t)(d->x1 - d->x0);
+        
+        if (s->shadow && s->framebuffer) {
+            uint32_t* fb = (uint32_t*)s->framebuffer;
+            for (int32_t y = d->y0; y < d->y1; y++) {
+                uint32_t offset = (uint32_t)y * s->screen_width + (uint32_t)d->x0;
+                display_copy_bytes(fb + offset, s->shadow + offset, width * 4);
+            }
         }
+        s->stats.flushed_pixels += (uint64_t)width * (uint32_t)(d->y1 - d->y0);
     }
     
-    (void)client_id;
-    return 0;
+    s->damage_count = 0;
+    s->stats.flushes++;
+}
+
+/* ============================================================================
+ * X11 RESOURCES
+ * ============================================================================ */
+
+static inline uint16_t x11_read16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t x11_read32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t x11_resource_hash(uint32_t id) {
+    return (id * 0x9E3779B1u) >> (32 - X11_RESOURCE_BITS);
 }
 
 /**
- * Create Wayland surface
+ * Find a resource by id
+ * The table holds at most half its slots, so probing always terminates.
  */
-int wayland_create_surface(uint32_t client_id) {
-    if (client_id >= g_wayland_compositor.client_count) {
-        return -1;
+static x11_resource_t* x11_resource_find(uint32_t id) {
+    uint32_t i = x11_resource_hash(id);
+    
+    while (g_x11_server.resources[i].type != X11_RESOURCE_NONE) {
+        if (g_x11_server.resources[i].id == id) {
+            return &g_x11_server.resources[i];
+        }
+        i = (i + 1) & (X11_RESOURCE_SLOTS - 1);
     }
+    return NULL;
+}
+
+static void x11_resource_insert(uint32_t id, uint8_t type, uint32_t client, uint32_t index) {
+    uint32_t i = x11_resource_hash(id);
     
-    wl_client_t* client = &g_wayland_compositor.clients[client_id];
-    if (client->surface_count >= 32) {
-        return -1;
+    while (g_x11_server.resources[i].type != X11_RESOURCE_NONE) {
+        i = (i + 1) & (X11_RESOURCE_SLOTS - 1);
     }
+    g_x11_server.resources[i].id = id;
+    g_x11_server.resources[i].type = type;
+    g_x11_server.resources[i].client = (uint8_t)client;
+    g_x11_server.resources[i].index = (uint16_t)index;
+}
+
+/**
+ * Remove a resource, shifting later probes back into the hole
+ */
+static void x11_resource_remove(uint32_t id) {
+    x11_resource_t* table = g_x11_server.resources;
+    x11_resource_t* r = x11_resource_find(id);
     
-    wl_surface_t* surface = &client->surfaces[client->surface_count];
-    platform_memset(surface, 0, sizeof(wl_surface_t));
-    surface->id = g_wayland_compositor.next_id++;
+    if (!r) {
+        return;
+    }
     
-    client->surface_count++;
+    uint32_t hole = (uint32_t)(r - table);
+    uint32_t j = hole;
+    for (;;) {
+        j = (j + 1) & (X11_RESOURCE_SLOTS - 1);
+        if (table[j].type == X11_RESOURCE_NONE) {
+            break;
+        }
+        /* Entries whose home lies cyclically in (hole, j] must stay */
+        uint32_t home = x11_resource_hash(table[j].id);
+        bool stays = (hole <= j) ? (home > hole && home <= j)
+                                 : (home > hole || home <= j);
+        if (!stays) {
+            table[hole] = table[j];
+            hole = j;
+        }
+    }
+    table[hole].type = X11_RESOURCE_NONE;
+}
+
+static void* x11_lookup(uint32_t id, uint8_t type) {
+    x11_resource_t* r = x11_resource_find(id);
     
-    return (int)surface->id;
+    if (!r || r->type != type) {
+        return NULL;
+    }
+    x11_client_t* owner = &g_x11_server.clients[r->client];
+    switch (type) {
+        case X11_RESOURCE_WINDOW: return &owner->windows[r->index];
+        case X11_RESOURCE_PIXMAP: return &owner->pixmaps[r->index];
+        default:                  return &owner->gcs[r->index];
+    }
 }
 
 /**
- * Commit Wayland surface
+ * Check that a new resource id is in the client's range and unused
  */
-int wayland_commit_surface(uint32_t client_id, uint32_t surface_id) {
-    if (client_id >= g_wayland_compositor.client_count) {
-        return -1;
+static bool x11_id_available(const x11_client_t* client, uint32_t id) {
+    if ((id & ~client->resource_mask) != client->resource_base) {
+        return false;
     }
+    return id != g_x11_server.root_window && x11_resource_find(id) == NULL;
+}
+
+static void x11_free_window(x11_client_t* client, uint32_t index) {
+    x11_resource_remove(client->windows[index].id);
+    uint32_t last = --client->window_count;
+    if (index != last) {
+        client->windows[index] = client->windows[last];
+        x11_resource_find(client->windows[index].id)->index = (uint16_t)index;
+    }
+}
+
+static void x11_free_pixmap(x11_client_t* client, uint32_t index) {
+    x11_resource_remove(client->pixmaps[index].id);
+    platform_free(client->pixmaps[index].data);
+    uint32_t last = --client->pixmap_count;
+    if (index != last) {
+        client->pixmaps[index] = client->pixmaps[last];
+        x11_resource_find(client->pixmaps[index].id)->index = (uint16_t)index;
+    }
+}
+
+static void x11_free_gc(x11_client_t* client, uint32_t index) {
+    x11_resource_remove(client->gcs[index].id);
+    uint32_t last = --client->gc_count;
+    if (index != last) {
+        client->gcs[index] = client->gcs[last];
+        x11_resource_find(client->gcs[index].id)->index = (uint16_t)index;
+    }
+}
+
+/* ============================================================================
+ * X11 DRAWABLES
+ * ============================================================================ */
+
+/* Resolved drawing destination */
+typedef struct {
+    uint32_t* base;         /* Pixel buffer */
+    uint32_t stride;        /* Pixels per row */
+    int32_t ox, oy;         /* Drawable origin within base */
+    display_box_t clip;         /* Drawable pixels within base, may be empty */
+    uint8_t depth;
+    bool on_screen;         /* Drawing produces damage */
+} x11_target_t;
+
+/**
+ * Resolve a window or pixmap id into a target
+ * Windows draw into the screen clipped to their own and their ancestors'
+ * interiors; drawing to a window that is not viewable is discarded.
+ */
+static int x11_resolve_drawable(uint32_t id, x11_target_t* t) {
+    x11_server_t* s = &g_x11_server;
     
-    wl_client_t* client = &g_wayland_compositor.clients[client_id];
-    
-    for (uint32_t i = 0; i < client->surface_count; i++) {
-        if (client->surfaces[i].id == surface_id) {
-            client->surfaces[i].committed = true;
+    if (id != s->root_window) {
+        x11_resource_t* r = x11_resource_find(id);
+        if (!r || r->type == X11_RESOURCE_GC) {
+            return -X11_BadDrawable;
+        }
+        if (r->type == X11_RESOURCE_PIXMAP) {
+            x11_pixmap_t* pm = &s->clients[r->client].pixmaps[r->index];
+            t->base = (uint32_t*)pm->data;
+            t->stride = pm->width;
+            t->ox = 0;
+            t->oy = 0;
+            t->clip.x0 = 0;
+            t->clip.y0 = 0;
+            t->clip.x1 = pm->width;
+            t->clip.y1 = pm->height;
+            t->depth = pm->depth;
+            t->on_screen = false;
             return 0;
         }
     }
     
-    return -1;
+    t->base = s->shadow ? s->shadow : (uint32_t*)s->framebuffer;
+    t->stride = s->screen_width;
+    t->ox = 0;
+    t->oy = 0;
+    t->clip.x0 = 0;
+    t->clip.y0 = 0;
+    t->clip.x1 = (int32_t)s->screen_width;
+    t->clip.y1 = (int32_t)s->screen_height;
+    t->depth = s->screen_depth;
+    t->on_screen = true;
+    if (id == s->root_window) {
+        return 0;
+    }
+    
+    x11_window_t* win = (x11_window_t*)x11_lookup(id, X11_RESOURCE_WINDOW);
+    t->depth = win->depth;
+    
+    /* First pass: interior origin on screen and viewability */
+    bool viewable = true;
+    uint32_t levels = 0;
+    for (x11_window_t* w = win; w; levels++) {
+        if (!w->mapped || levels >= X11_MAX_WINDOWS * X11_MAX_CLIENTS) {
+            viewable = false;
+            break;
+        }
+        t->ox += w->x + w->border_width;
+        t->oy += w->y + w->border_width;
+        if (w->parent == s->root_window) {
+            break;
+        }
+        w = (x11_window_t*)x11_lookup(w->parent, X11_RESOURCE_WINDOW);
+        if (!w) {
+            viewable = false;
+        }
+    }
+    if (!viewable) {
+        t->clip.x1 = t->clip.x0;
+        return 0;
+    }
+    
+    /* Second pass: clip to every interior on the way up */
+    int32_t x = t->ox;
+    int32_t y = t->oy;
+    for (x11_window_t* w = win; ; ) {
+        display_box_intersect(&t->clip, x, y, x + w->width, y + w->height);
+        x -= w->x + w->border_width;
+        y -= w->y + w->border_width;
+        if (w->parent == s->root_window) {
+            break;
+        }
+        w = (x11_window_t*)x11_lookup(w->parent, X11_RESOURCE_WINDOW);
+    }
+    return 0;
+}
+
+/**
+ * Clip a drawable-relative rectangle to a target
+ */
+static bool x11_clip_rect(const x11_target_t* t, int32_t x, int32_t y,
+                          uint32_t width, uint32_t height, display_box_t* out) {
+    out->x0 = x + t->ox;
+    out->y0 = y + t->oy;
+    out->x1 = out->x0 + (int32_t)width;
+    out->y1 = out->y0 + (int32_t)height;
+    display_box_intersect(out, t->clip.x0, t->clip.y0, t->clip.x1, t->clip.y1);
+    return !display_box_empty(out);
+}
+
+/**
+ * Fill a clipped box with the GC's foreground
+ */
+static void x11_fill_box(const x11_target_t* t, const display_box_t* box, const x11_gc_t* gc) {
+    uint32_t width = (uint32_t)(box->x1 - box->x0);
+    uint32_t* row = t->base + (uint32_t)box->y0 * t->stride + (uint32_t)box->x0;
+    bool copy = x11_gc_is_copy(gc);
+    
+    for (int32_t y = box->y0; y < box->y1; y++) {
+        if (copy) {
+            display_fill_row(row, width, gc->foreground);
+        } else {
+            x11_rop_row(row, NULL, width, gc->foreground, gc);
+        }
+        row += t->stride;
+    }
+    if (t->on_screen) {
+        x11_add_damage(box);
+    }
+}
+
+/* ============================================================================
+ * X11 REQUEST HANDLERS
+ * ============================================================================ */
+
+/**
+ * Check that a value list for mask fits in the bytes available
+ */
+static bool x11_values_fit(uint32_t mask, uint32_t available) {
+    uint32_t count = 0;
+    for (; mask; mask &= mask - 1) {
+        count++;
+    }
+    return count * 4 <= available;
+}
+
+static int x11_apply_window_values(x11_window_t* win, uint32_t mask,
+                                   const uint8_t* values, uint32_t available) {
+    if (mask & ~0x7FFFu) {
+        return -X11_BadValue;
+    }
+    if (!x11_values_fit(mask, available)) {
+        return -X11_BadLength;
+    }
+    for (uint32_t bit = 0; bit < 15; bit++) {
+        if (!(mask & (1u << bit))) {
+            continue;
+        }
+        uint32_t value = x11_read32(values);
+        values += 4;
+        switch (bit) {
+            case 1:  win->background_pixel = value; win->has_background = true; break;
+            case 3:  win->border_pixel = value; break;
+            case 9:  win->override_redirect = (value & 1) != 0; break;
+            case 11: win->event_mask = value; break;
+            default: break;
+        }
+    }
+    return 0;
+}
+
+static int x11_apply_gc_values(x11_gc_t* gc, uint32_t mask,
+                               const uint8_t* values, uint32_t available) {
+    if (mask & ~0x7FFFFFu) {
+        return -X11_BadValue;
+    }
+    if (!x11_values_fit(mask, available)) {
+        return -X11_BadLength;
+    }
+    for (uint32_t bit = 0; bit < 23; bit++) {
+        if (!(mask & (1u << bit))) {
+            continue;
+        }
+        uint32_t value = x11_read32(values);
+        values += 4;
+        switch (bit) {
+            case 0:  gc->function = (uint8_t)(value & 0xF); break;
+            case 1:  gc->plane_mask = value; break;
+            case 2:  gc->foreground = value; break;
+            case 3:  gc->background = value; break;
+            case 4:  gc->line_width = (uint16_t)value; break;
+            case 5:  gc->line_style = (uint8_t)value; break;
+            case 6:  gc->cap_style = (uint8_t)value; break;
+            case 7:  gc->join_style = (uint8_t)value; break;
+            case 8:  gc->fill_style = (uint8_t)value; break;
+            case 14: gc->font = value; break;
+            default: break;
+        }
+    }
+    return 0;
+}
+
+static int x11_create_window(x11_client_t* client, const uint8_t* req, uint32_t length) {
+    if (length < 32) {
+        return -X11_BadLength;
+    }
+    
+    uint32_t id = x11_read32(req + 4);
+    uint32_t parent = x11_read32(req + 8);
+    uint8_t depth = req[1];
+    
+    if (!x11_id_available(client, id)) {
+        return -X11_BadIDChoice;
+    }
+    if (parent != g_x11_server.root_window) {
+        x11_window_t* p = (x11_window_t*)x11_lookup(parent, X11_RESOURCE_WINDOW);
+        if (!p) {
+            return -X11_BadWindow;
+        }
+        if (depth == 0) {
+            depth = p->depth;
+        }
+    } else if (depth == 0) {
+        depth = g_x11_server.screen_depth;
+    }
+    if (x11_read16(req + 16) == 0 || x11_read16(req + 18) == 0) {
+        return -X11_BadValue;
+    }
+    if (client->window_count >= X11_MAX_WINDOWS) {
+        return -X11_BadAlloc;
+    }
+    
+    x11_window_t* win = &client->windows[client->window_count];
+    platform_memset(win, 0, sizeof(x11_window_t));
+    win->id = id;
+    win->parent = parent;
+    win->x = (int16_t)x11_read16(req + 12);
+    win->y = (int16_t)x11_read16(req + 14);
+    win->width = x11_read16(req + 16);
+    win->height = x11_read16(req + 18);
+    win->border_width = x11_read16(req + 20);
+    win->window_class = x11_read16(req + 22);
+    win->visual = x11_read32(req + 24);
+    win->depth = depth;
+    
+    int result = x11_apply_window_values(win, x11_read32(req + 28), req + 32, length - 32);
+    if (result < 0) {
+        return result;
+    }
+    
+    x11_resource_insert(id, X11_RESOURCE_WINDOW, client->id, client->window_count);
+    client->window_count++;
+    return 0;
+}
+
+static int x11_change_window_attributes(const uint8_t* req, uint32_t length) {
+    if (length < 12) {
+        return -X11_BadLength;
+    }
+    x11_window_t* win = (x11_window_t*)x11_lookup(x11_read32(req + 4), X11_RESOURCE_WINDOW);
+    if (!win) {
+        return -X11_BadWindow;
+    }
+    return x11_apply_window_values(win, x11_read32(req + 8), req + 12, length - 12);
+}
+
+static int x11_destroy_window(const uint8_t* req, uint32_t length) {
+    if (length < 8) {
+        return -X11_BadLength;
+    }
+    uint32_t id = x11_read32(req + 4);
+    if (id == g_x11_server.root_window) {
+        return 0;
+    }
+    x11_resource_t* r = x11_resource_find(id);
+    if (!r || r->type != X11_RESOURCE_WINDOW) {
+        return -X11_BadWindow;
+    }
+    /* Children lose their parent and stop being viewable */
+    x11_free_window(&g_x11_server.clients[r->client], r->index);
+    return 0;
+}
+
+/**
+ * Map or unmap a window; mapping paints its background
+ * Uncovered areas are not re-exposed, clients repaint on their own.
+ */
+static int x11_set_mapped(const uint8_t* req, uint32_t length, bool mapped) {
+    if (length < 8) {
+        return -X11_BadLength;
+    }
+    uint32_t id = x11_read32(req + 4);
+    if (id == g_x11_server.root_window) {
+        return 0;
+    }
+    x11_window_t* win = (x11_window_t*)x11_lookup(id, X11_RESOURCE_WINDOW);
+    if (!win) {
+        return -X11_BadWindow;
+    }
+    if (win->mapped == mapped) {
+        return 0;
+    }
+    win->mapped = mapped;
+    
+    if (mapped && win->has_background) {
+        x11_target_t t;
+        display_box_t box;
+        x11_gc_t gc;
+        platform_memset(&gc, 0, sizeof(gc));
+        gc.function = X11_GXcopy;
+        gc.plane_mask = 0xFFFFFFFF;
+        gc.foreground = win->background_pixel;
+        x11_resolve_drawable(id, &t);
+        if (x11_clip_rect(&t, 0, 0, win->width, win->height, &box)) {
+            x11_fill_box(&t, &box, &gc);
+        }
+    }
+    return 0;
+}
+
+static int x11_create_pixmap(x11_client_t* client, const uint8_t* req, uint32_t length) {
+    if (length < 16) {
+        return -X11_BadLength;
+    }
+    
+    uint32_t id = x11_read32(req + 4);
+    uint32_t drawable = x11_read32(req + 8);
+    uint16_t width = x11_read16(req + 12);
+    uint16_t height = x11_read16(req + 14);
+    x11_target_t t;
+    
+    if (!x11_id_available(client, id)) {
+        return -X11_BadIDChoice;
+    }
+    if (x11_resolve_drawable(drawable, &t) < 0) {
+        return -X11_BadDrawable;
+    }
+    if (req[1] == 0 || width == 0 || height == 0) {
+        return -X11_BadValue;
+    }
+    if (client->pixmap_count >= X11_MAX_PIXMAPS ||
+        (uint32_t)width * height > X11_MAX_PIXMAP_PIXELS) {
+        return -X11_BadAlloc;
+    }
+    
+    void* data = platform_malloc((size_t)width * height * 4);
+    if (!data) {
+        return -X11_BadAlloc;
+    }
+    
+    x11_pixmap_t* pm = &client->pixmaps[client->pixmap_count];
+    pm->id = id;
+    pm->drawable = drawable;
+    pm->width = width;
+    pm->height = height;
+    pm->depth = req[1];
+    pm->data = data;
+    
+    x11_resource_insert(id, X11_RESOURCE_PIXMAP, client->id, client->pixmap_count);
+    client->pixmap_count++;
+    return 0;
+}
+
+static int x11_free_pixmap_request(const uint8_t* req, uint32_t length) {
+    if (length < 8) {
+        return -X11_BadLength;
+    }
+    x11_resource_t* r = x11_resource_find(x11_read32(req + 4));
+    if (!r || r->type != X11_RESOURCE_PIXMAP) {
+        return -X11_BadPixmap;
+    }
+    x11_free_pixmap(&g_x11_server.clients[r->client], r->index);
+    return 0;
+}
+
+static int x11_create_gc(x11_client_t* client, const uint8_t* req, uint32_t length) {
+    if (length < 16) {
+        return -X11_BadLength;
+    }
+    
+    uint32_t id = x11_read32(req + 4);
+    uint32_t drawable = x11_read32(req + 8);
+    x11_target_t t;
+    
+    if (!x11_id_available(client, id)) {
+        return -X11_BadIDChoice;
+    }
+    if (x11_resolve_drawable(drawable, &t) < 0) {
+        return -X11_BadDrawable;
+    }
+    if (client->gc_count >= X11_MAX_GCS) {
+        return -X11_BadAlloc;
+    }
+    
+    x11_gc_t* gc = &client->gcs[client->gc_count];
+    platform_memset(gc, 0, sizeof(x11_gc_t));
+    gc->id = id;
+    gc->drawable = drawable;
+    gc->function = X11_GXcopy;
+    gc->plane_mask = 0xFFFFFFFF;
+    gc->foreground = 0;
+    gc->background = 1;
+    
+    int result = x11_apply_gc_values(gc, x11_read32(req + 12), req + 16, length - 16);
+    if (result < 0) {
+        return result;
+    }
+    
+    x11_resource_insert(id, X11_RESOURCE_GC, client->id, client->gc_count);
+    client->gc_count++;
+    return 0;
+}
+
+static int x11_change_gc(const uint8_t* req, uint32_t length) {
+    if (length < 12) {
+        return -X11_BadLength;
+    }
+    x11_gc_t* gc = (x11_gc_t*)x11_lookup(x11_read32(req + 4), X11_RESOURCE_GC);
+    if (!gc) {
+        return -X11_BadGC;
+    }
+    return x11_apply_gc_values(gc, x11_read32(req + 8), req + 12, length - 12);
+}
+
+static int x11_free_gc_request(const uint8_t* req, uint32_t length) {
+    if (length < 8) {
+        return -X11_BadLength;
+    }
+    x11_resource_t* r = x11_resource_find(x11_read32(req + 4));
+    if (!r || r->type != X11_RESOURCE_GC) {
+        return -X11_BadGC;
+    }
+    x11_free_gc(&g_x11_server.clients[r->client], r->index);
+    return 0;
+}
+
+/**
+ * Resolve the drawable and GC shared by the drawing requests
+ */
+static int x11_drawing_setup(const uint8_t* req, x11_target_t* t, x11_gc_t** gc) {
+    if (x11_resolve_drawable(x11_read32(req + 4), t) < 0) {
+        return -X11_BadDrawable;
+    }
+    *gc = (x11_gc_t*)x11_lookup(x11_read32(req + 8), X11_RESOURCE_GC);
+    if (!*gc) {
+        return -X11_BadGC;
+    }
+    return 0;
+}
+
+static int x11_poly_fill_rectangle(const uint8_t* req, uint32_t length) {
+    x11_target_t t;
+    x11_gc_t* gc;
+    
+    if (length < 12 || (length - 12) % 8 != 0) {
+        return -X11_BadLength;
+    }
+    int result = x11_drawing_setup(req, &t, &gc);
+    if (result < 0) {
+        return result;
+    }
+    /* Tiles and stipples are not stored */
+    if (gc->fill_style != 0) {
+        return -X11_BadImplementation;
+    }
+    
+    for (const uint8_t* r = req + 12; r < req + length; r += 8) {
+        display_box_t box;
+        if (x11_clip_rect(&t, (int16_t)x11_read16(r), (int16_t)x11_read16(r + 2),
+                          x11_read16(r + 4), x11_read16(r + 6), &box)) {
+            x11_fill_box(&t, &box, gc);
+        }
+    }
+    return 0;
+}
+
+/**
+ * PutImage: ZPixmap images at 32 bits per pixel (depth 24 or 32)
+ */
+static int x11_put_image(const uint8_t* req, uint32_t length) {
+    x11_target_t t;
+    x11_gc_t* gc;
+    
+    if (length < 24) {
+        return -X11_BadLength;
+    }
+    int result = x11_drawing_setup(req, &t, &gc);
+    if (result < 0) {
+        return result;
+    }
+    
+    uint8_t format = req[1];
+    uint16_t width = x11_read16(req + 12);
+    uint16_t height = x11_read16(req + 14);
+    int16_t dst_x = (int16_t)x11_read16(req + 16);
+    int16_t dst_y = (int16_t)x11_read16(req + 18);
+    uint8_t depth = req[21];
+    
+    if (format != X11_IMAGE_ZPIXMAP) {
+        return format > X11_IMAGE_ZPIXMAP ? -X11_BadValue : -X11_BadImplementation;
+    }
+    if (req[20] != 0 || depth != t.depth || (depth != 24 && depth != 32)) {
+        return -X11_BadMatch;
+    }
+    if (24 + (uint64_t)width * height * 4 > length) {
+        return -X11_BadLength;
+    }
+    
+    display_box_t box;
+    if (!x11_clip_rect(&t, dst_x, dst_y, width, height, &box)) {
+        return 0;
+    }
+    
+    uint32_t span = (uint32_t)(box.x1 - box.x0);
+    const uint32_t* src = (const uint32_t*)(req + 24) +
+                          (uint32_t)(box.y0 - (dst_y + t.oy)) * width +
+                          (uint32_t)(box.x0 - (dst_x + t.ox));
+    uint32_t* dst = t.base + (uint32_t)box.y0 * t.stride + (uint32_t)box.x0;
+    bool copy = x11_gc_is_copy(gc);
+    
+    for (int32_t y = box.y0; y < box.y1; y++) {
+        if (copy) {
+            display_copy_bytes(dst, src, span * 4);
+        } else {
+            x11_rop_row(dst, src, span, 0, gc);
+        }
+        src += width;
+        dst += t.stride;
+    }
+    if (t.on_screen) {
+        x11_add_damage(&box);
+    }
+    return 0;
+}
+
+/**
+ * CopyArea between drawables of the same depth
+ * Obscured source regions are not reported with GraphicsExpose.
+ */
+static int x11_copy_area(const uint8_t* req, uint32_t length) {
+    x11_target_t src;
+    x11_target_t dst;
+    x11_gc_t* gc;
+    
+    if (length < 28) {
+        return -X11_BadLength;
+    }
+    if (x11_resolve_drawable(x11_read32(req + 4), &src) < 0 ||
+        x11_resolve_drawable(x11_read32(req + 8), &dst) < 0) {
+        return -X11_BadDrawable;
+    }
+    gc = (x11_gc_t*)x11_lookup(x11_read32(req + 12), X11_RESOURCE_GC);
+    if (!gc) {
+        return -X11_BadGC;
+    }
+    if (src.depth != dst.depth) {
+        return -X11_BadMatch;
+    }
+    
+    int32_t sx = (int16_t)x11_read16(req + 16);
+    int32_t sy = (int16_t)x11_read16(req + 18);
+    int32_t dx = (int16_t)x11_read16(req + 20);
+    int32_t dy = (int16_t)x11_read16(req + 22);
+    int32_t width = x11_read16(req + 24);
+    int32_t height = x11_read16(req + 26);
+    
+    /* Clip to the source, carrying the offsets over to the destination */
+    int32_t lo_x = src.clip.x0 - src.ox;
+    int32_t lo_y = src.clip.y0 - src.oy;
+    if (sx < lo_x) { width -= lo_x - sx; dx += lo_x - sx; sx = lo_x; }
+    if (sy < lo_y) { height -= lo_y - sy; dy += lo_y - sy; sy = lo_y; }
+    if (sx + width > src.clip.x1 - src.ox) width = src.clip.x1 - src.ox - sx;
+    if (sy + height > src.clip.y1 - src.oy) height = src.clip.y1 - src.oy - sy;
+    if (width <= 0 || height <= 0) {
+        return 0;
+    }
+    
+    display_box_t box;
+    if (!x11_clip_rect(&dst, dx, dy, (uint32_t)width, (uint32_t)height, &box)) {
+        return 0;
+    }
+    sx += box.x0 - (dx + dst.ox) + src.ox;
+    sy += box.y0 - (dy + dst.oy) + src.oy;
+    
+    uint32_t span = (uint32_t)(box.x1 - box.x0);
+    int32_t rows = box.y1 - box.y0;
+    bool copy = x11_gc_is_copy(gc);
+    
+    /* Walk bottom-up when copying downwards within one buffer */
+    bool reverse = src.base == dst.base && box.y0 > sy;
+    for (int32_t i = 0; i < rows; i++) {
+        int32_t r = reverse ? rows - 1 - i : i;
+        const uint32_t* s = src.base + (uint32_t)(sy + r) * src.stride + (uint32_t)sx;
+        uint32_t* d = dst.base + (uint32_t)(box.y0 + r) * dst.stride + (uint32_t)box.x0;
+        if (copy) {
+            display_move_row(d, s, span);
+        } else {
+            x11_rop_row(d, s, span, 0, gc);
+        }
+    }
+    if (dst.on_screen) {
+        x11_add_damage(&box);
+    }
+    return 0;
+}
+
+/**
+ * Execute one complete request without flushing
+ */
+static int x11_execute(x11_client_t* client, uint8_t opcode, const uint8_t* req, uint32_t length) {
+    int result = 0;
+    
+    client->sequence++;
+    g_x11_server.stats.requests++;
+    
+    switch (opcode) {
+        case X11_CreateWindow:
+            result = x11_create_window(client, req, length);
+            break;
+        case X11_ChangeWindowAttributes:
+            result = x11_change_window_attributes(req, length);
+            break;
+        case X11_DestroyWindow:
+            result = x11_destroy_window(req, length);
+            break;
+        case X11_MapWindow:
+            result = x11_set_mapped(req, length, true);
+            break;
+        case X11_UnmapWindow:
+            result = x11_set_mapped(req, length, false);
+            break;
+        case X11_CreatePixmap:
+            result = x11_create_pixmap(client, req, length);
+            break;
+        case X11_FreePixmap:
+            result = x11_free_pixmap_request(req, length);
+            break;
+        case X11_CreateGC:
+            result = x11_create_gc(client, req, length);
+            break;
+        case X11_ChangeGC:
+            result = x11_change_gc(req, length);
+            break;
+        case X11_FreeGC:
+            result = x11_free_gc_request(req, length);
+            break;
+        case X11_CopyArea:
+            result = x11_copy_area(req, length);
+            break;
+        case X11_PolyFillRectangle:
+            result = x11_poly_fill_rectangle(req, length);
+            break;
+        case X11_PutImage:
+            result = x11_put_image(req, length);
+            break;
+        case X11_InternAtom:
+            /* Intern atom */
+            break;
+        case X11_GetProperty:
+            /* Get property */
+            break;
+        case X11_NoOperation:
+            /* No operation */
+            break;
+        default:
+            break;
+    }
+    
+    if (result < 0) {
+        client->last_error = (uint8_t)-result;
+        client->error_count++;
+        g_x11_server.stats.errors++;
+    }
+    return result;
+}
+
+/**
+ * Execute a client's complete buffered requests, up to a budget
+ */
+static int x11_run_client(x11_client_t* client, uint32_t max_requests) {
+    int executed = 0;
+    
+    while (client->request_tail - client->request_head >= 4) {
+        if (max_requests && (uint32_t)executed >= max_requests) {
+            break;
+        }
+        
+        const uint8_t* req = client->request_buffer + client->request_head;
+        uint32_t length = (uint32_t)x11_read16(req + 2) * 4;
+        if (length == 0) {
+            /* BIG-REQUESTS is not offered, so the stream cannot resync */
+            client->request_head = 0;
+            client->request_tail = 0;
+            client->last_error = X11_BadLength;
+            client->error_count++;
+            g_x11_server.stats.errors++;
+            return -X11_BadLength;
+        }
+        if (client->request_tail - client->request_head < length) {
+            break;
+        }
+        
+        x11_execute(client, req[0], req, length);
+        client->request_head += length;
+        executed++;
+    }
+    
+    if (client->request_head == client->request_tail) {
+        client->request_head = 0;
+        client->request_tail = 0;
+    }
+    return executed;
+}
+
+static x11_client_t* x11_get_client(uint32_t client_id) {
+    if (!g_x11_server.initialized || !g_x11_server.running ||
+        client_id >= g_x11_server.client_count ||
+        !g_x11_server.clients[client_id].connected) {
+        return NULL;
+    }
+    return &g_x11_server.clients[client_id];
+}
+
+/* ============================================================================
+ * X11 SERVER IMPLEMENTATION
+ * ============================================================================ */
+
+/**
+ * Initialize X11 server
+ */
+int x11_server_init(uint32_t width, uint32_t height, uint8_t depth, void* framebuffer) {
+    if (g_x11_server.initialized) {
+        return 0;
+    }
+    
+    platform_memset(&g_x11_server, 0, sizeof(x11_server_t));
+    
+    g_x11_server.screen_width = width;
+    g_x11_server.screen_height = height;
+    g_x11_server.screen_depth = depth;
+    g_x11_server.framebuffer = framebuffer;
+    g_x11_server.fb_size = width * height * (depth >= 24 ? 4 : depth / 8);
+    g_x11_server.shadow = (uint32_t*)platform_malloc((size_t)width * height * 4);
+    
+    /* Create root window */
+    g_x11_server.root_window = 1;
+    g_x11_server.root_visual = 1;
+    /* Client id ranges start above the resource mask */
+    g_x11_server.next_resource_id = 0x00200000;
+    
+    /* Register built-in atoms */
+    g_x11_server.atoms[0].id = 1;
+    platform_strncpy(g_x11_server.atoms[0].name, "PRIMARY", 64);
+    g_x11_server.atoms[1].id = 2;
+    platform_strncpy(g_x11_server.atoms[1].name, "SECONDARY", 64);
+    g_x11_server.atoms[2].id = 3;
+    platform_strncpy(g_x11_server.atoms[2].name, "CLIPBOARD", 64);
+    g_x11_server.atoms[3].id = 4;
+    platform_strncpy(g_x11_server.atoms[3].name, "WM_NAME", 64);
+    g_x11_server.atoms[4].id = 5;
+    platform_strncpy(g_x11_server.atoms[4].name, "WM_CLASS", 64);
+    g_x11_server.atom_count = 5;
+    
+    g_x11_server.initialized = true;
+    g_x11_server.running = true;
+    
+    return 0;
+}
+
+/**
+ * Process X11 request
+ */
+int x11_process_request(uint32_t client_id, uint8_t opcode, uint8_t* data, uint32_t length) {
+    x11_client_t* client = x11_get_client(client_id);
+    if (!client || !data) {
+        return -1;
+    }
+    if (length < 4 || (uint32_t)x11_read16(data + 2) * 4 != length) {
+        return -X11_BadLength;
+    }
+    
+    int result = x11_execute(client, opcode, data, length);
+    x11_flush_damage();
+    return result;
+}
+
+/**
+ * Queue bytes received from an X11 client
+ */
+int x11_client_write(uint32_t client_id, const uint8_t* data, uint32_t length) {
+    x11_client_t* client = x11_get_client(client_id);
+    if (!client || !data) {
+        return -1;
+    }
+    
+    if (!client->request_buffer) {
+        client->request_buffer = (uint8_t*)platform_malloc(X11_REQUEST_BUFFER_SIZE);
+        if (!client->request_buffer) {
+            return -1;
+        }
+    }
+    
+    /* Slide a partial request to the front to make room */
+    if (client->request_tail + length > X11_REQUEST_BUFFER_SIZE && client->request_head > 0) {
+        uint32_t pending = client->request_tail - client->request_head;
+        display_copy_bytes(client->request_buffer, client->request_buffer + client->request_head, pending);
+        client->request_head = 0;
+        client->request_tail = pending;
+    }
+    
+    uint32_t space = X11_REQUEST_BUFFER_SIZE - client->request_tail;
+    uint32_t accepted = length < space ? length : space;
+    display_copy_bytes(client->request_buffer + client->request_tail, data, accepted);
+    client->request_tail += accepted;
+    
+    return (int)accepted;
+}
+
+/**
+ * Execute one client's buffered requests and flush their damage
+ */
+int x11_dispatch_client(uint32_t client_id, uint32_t max_requests) {
+    x11_client_t* client = x11_get_client(client_id);
+    if (!client) {
+        return -1;
+    }
+    
+    int executed = client->request_buffer ? x11_run_client(client, max_requests) : 0;
+    g_x11_server.stats.batches++;
+    x11_flush_damage();
+    return executed;
+}
+
+/**
+ * Execute every client's buffered requests with a single flush
+ */
+int x11_server_dispatch(uint32_t max_requests) {
+    if (!g_x11_server.initialized || !g_x11_server.running) {
+        return -1;
+    }
+    
+    int total = 0;
+    for (uint32_t i = 0; i < g_x11_server.client_count; i++) {
+        x11_client_t* client = &g_x11_server.clients[i];
+        if (client->connected && client->request_buffer) {
+            int executed = x11_run_client(client, max_requests);
+            if (executed > 0) {
+                total += executed;
+            }
+        }
+    }
+    g_x11_server.stats.batches++;
+    x11_flush_damage();
+    return total;
+}
+
+/**
+ * Get X11 server statistics
+ */
+void x11_get_stats(x11_stats_t* stats) {
+    if (stats) {
+        *stats = g_x11_server.stats;
+    }
+}
+
+/**
+ * Accept X11 client connection
+ */
+int x11_accept_client(void) {
+    if (!g_x11_server.initialized) {
+        return -1;
+    }
+    
+    if (g_x11_server.client_count >= X11_MAX_CLIENTS) {
+        return -1;
+    }
+    
+    uint32_t client_id = g_x11_server.client_count;
+    x11_client_t* client = &g_x11_server.clients[client_id];
+    
+    platform_memset(client, 0, sizeof(x11_client_t));
+    client->id = client_id;
+    client->connected = true;
+    client->resource_base = g_x11_server.next_resource_id;
+    client->resource_mask = 0x001FFFFF;
+    g_x11_server.next_resource_id += 0x00200000;
+    
+    g_x11_server.client_count++;
+    
+    return (int)client_id;
+}
+
+/**
+ * Disconnect X11 client, releasing its resources
+ */
+int x11_disconnect_client(uint32_t client_id) {
+    if (client_id >= g_x11_server.client_count) {
+        return -1;
+    }
+    
+    x11_client_t* client = &g_x11_server.clients[client_id];
+    while (client->window_count > 0) {
+        x11_free_window(client, client->window_count - 1);
+    }
+    while (client->pixmap_count > 0) {
+        x11_free_pixmap(client, client->pixmap_count - 1);
+    }
+    while (client->gc_count > 0) {
+        x11_free_gc(client, client->gc_count - 1);
+    }
+    if (client->request_buffer) {
+        platform_free(client->request_buffer);
+        client->request_buffer = NULL;
+    }
+    client->request_head = 0;
+    client->request_tail = 0;
+    
+    client->connected = false;
+    return 0;
+}
+
+/* ============================================================================
+ * WAYLAND COMPOSITION
+ * ============================================================================ */
+
+static inline bool wl_format_opaque(uint32_t format) {
+    return format == WL_SHM_FORMAT_XRGB8888;
+}
+
+static void wl_buffer_ref(wl_buffer_t* buffer) {
+    if (buffer) {
+        buffer->refs++;
+    }
+}
+
+/**
+ * Drop a reference; at zero the client may reuse the buffer (release)
+ */
+static void wl_buffer_unref(wl_buffer_t* buffer) {
+    if (buffer && buffer->refs > 0 && --buffer->refs == 0) {
+        g_wayland_compositor.stats.releases++;
+    }
+}
+
+static inline void wl_surface_extent(const wl_surface_t* surface, display_box_t* box) {
+    box->x0 = surface->x;
+    box->y0 = surface->y;
+    box->x1 = surface->x + surface->width;
+    box->y1 = surface->y + surface->height;
+}
+
+/**
+ * Add an output-space box to the compositor's damage, clipped to the output
+ */
+static void wl_add_damage(display_box_t box) {
+    wl_compositor_t* c = &g_wayland_compositor;
+    
+    display_box_intersect(&box, 0, 0, (int32_t)c->width, (int32_t)c->height);
+    if (!display_box_empty(&box)) {
+        display_add_damage(c->damage, &c->damage_count, &box);
+    }
+}
+
+/**
+ * Blend a row of premultiplied ARGB8888 pixels over the destination
+ * Branch-free so the loop vectorizes; alpha 0xFF and 0 fall out of the
+ * arithmetic exactly.
+ */
+static void wl_blend_row(uint32_t* dst, const uint32_t* src, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t s = src[i];
+        uint32_t inv = 255 - (s >> 24);
+        uint32_t d = dst[i];
+        uint32_t rb = (d & 0x00FF00FF) * inv + 0x00800080;
+        uint32_t ag = ((d >> 8) & 0x00FF00FF) * inv + 0x00800080;
+        rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+        ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+        dst[i] = s + rb + ag;
+    }
+}
+
+/**
+ * Paint the part of a surface inside box, reading the client's shm memory
+ */
+static void wl_paint_surface(const wl_surface_t* surface, const display_box_t* box) {
+    wl_compositor_t* c = &g_wayland_compositor;
+    display_box_t b = *box;
+    
+    display_box_intersect(&b, surface->x, surface->y,
+                          surface->x + surface->width, surface->y + surface->height);
+    if (display_box_empty(&b)) {
+        return;
+    }
+    
+    const wl_buffer_t* buffer = surface->buffer;
+    uint32_t n = (uint32_t)(b.x1 - b.x0);
+    const uint8_t* src = (const uint8_t*)buffer->data +
+                         (uint32_t)(b.y0 - surface->y) * (uint32_t)buffer->stride +
+                         (uint32_t)(b.x0 - surface->x) * 4;
+    uint32_t* dst = (uint32_t*)c->framebuffer + (uint32_t)b.y0 * c->width + (uint32_t)b.x0;
+    bool opaque = wl_format_opaque(buffer->format);
+    
+    for (int32_t y = b.y0; y < b.y1; y++) {
+        if (opaque) {
+            display_copy_bytes(dst, src, n * 4);
+        } else {
+            wl_blend_row(dst, (const uint32_t*)src, n);
+        }
+        src += buffer->stride;
+        dst += c->width;
+    }
+    c->stats.composed_pixels += (uint64_t)n * (uint32_t)(b.y1 - b.y0);
+}
+
+/**
+ * Recompose one damaged output box, bottom to top
+ * Painting starts at the topmost opaque surface covering the whole box,
+ * since nothing below it can show through.
+ */
+static void wl_compose_box(const display_box_t* box) {
+    wl_compositor_t* c = &g_wayland_compositor;
+    uint32_t start_client = 0;
+    uint32_t start_surface = 0;
+    bool covered = false;
+    
+    for (uint32_t i = 0; i < c->client_count; i++) {
+        wl_client_t* client = &c->clients[i];
+        for (uint32_t j = 0; j < client->surface_count; j++) {
+            const wl_surface_t* surface = &client->surfaces[j];
+            if (surface->buffer && wl_format_opaque(surface->buffer->format) &&
+                surface->x <= box->x0 && surface->y <= box->y0 &&
+                surface->x + surface->width >= box->x1 &&
+                surface->y + surface->height >= box->y1) {
+                start_client = i;
+                start_surface = j;
+                covered = true;
+            }
+        }
+    }
+    
+    if (!covered) {
+        uint32_t* row = (uint32_t*)c->framebuffer + (uint32_t)box->y0 * c->width + (uint32_t)box->x0;
+        for (int32_t y = box->y0; y < box->y1; y++) {
+            display_fill_row(row, (uint32_t)(box->x1 - box->x0), c->clear_color);
+            row += c->width;
+        }
+    }
+    
+    for (uint32_t i = start_client; i < c->client_count; i++) {
+        wl_client_t* client = &c->clients[i];
+        uint32_t j = (i == start_client) ? start_surface : 0;
+        for (; j < client->surface_count; j++) {
+            if (client->surfaces[j].buffer) {
+                wl_paint_surface(&client->surfaces[j], box);
+            }
+        }
+    }
+}
+
+/**
+ * Find the topmost surface showing a buffer
+ */
+static wl_surface_t* wl_top_surface(void) {
+    wl_compositor_t* c = &g_wayland_compositor;
+    
+    for (uint32_t i = c->client_count; i > 0; i--) {
+        wl_client_t* client = &c->clients[i - 1];
+        for (uint32_t j = client->surface_count; j > 0; j--) {
+            if (client->surfaces[j - 1].buffer) {
+                return &client->surfaces[j - 1];
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Check whether a surface's buffer can be scanned out as is
+ */
+static bool wl_can_scanout(const wl_surface_t* surface) {
+    const wl_compositor_t* c = &g_wayland_compositor;
+    const wl_buffer_t* buffer = surface->buffer;
+    
+    return surface->x == 0 && surface->y == 0 &&
+           (uint32_t)surface->width == c->width && (uint32_t)surface->height == c->height &&
+           wl_format_opaque(buffer->format) && (uint32_t)buffer->stride == c->width * 4;
+}
+
+/**
+ * Update the output after a commit
+ * A fullscreen opaque surface on top is flipped to scanout directly.
+ * Otherwise damaged boxes are composed into the framebuffer straight
+ * from client memory.
+ */
+static void wl_repaint(void) {
+    wl_compositor_t* c = &g_wayland_compositor;
+    wl_surface_t* top = wl_top_surface();
+    
+    if (top && wl_can_scanout(top)) {
+        if (c->scanout_buffer != top->buffer) {
+            wl_buffer_ref(top->buffer);
+            wl_buffer_unref(c->scanout_buffer);
+            c->scanout_buffer = top->buffer;
+            c->scanout = top->buffer->data;
+            c->stats.flips++;
+        }
+        c->damage_count = 0;
+        return;
+    }
+    
+    if (c->scanout_buffer) {
+        /* The framebuffer missed every frame since the flip */
+        wl_buffer_unref(c->scanout_buffer);
+        c->scanout_buffer = NULL;
+        c->scanout = c->framebuffer;
+        display_box_t all = { 0, 0, (int32_t)c->width, (int32_t)c->height };
+        c->damage[0] = all;
+        c->damage_count = 1;
+    }
+    
+    if (c->damage_count == 0 || !c->framebuffer) {
+        c->damage_count = 0;
+        return;
+    }
+    for (uint32_t i = 0; i < c->damage_count; i++) {
+        wl_compose_box(&c->damage[i]);
+    }
+    c->damage_count = 0;
+    c->stats.repaints++;
+}
+
+static wl_client_t* wl_get_client(uint32_t client_id) {
+    if (!g_wayland_compositor.initialized || !g_wayland_compositor.running ||
+        client_id >= g_wayland_compositor.client_count ||
+        !g_wayland_compositor.clients[client_id].connected) {
+        return NULL;
+    }
+    return &g_wayland_compositor.clients[client_id];
+}
+
+static wl_surface_t* wl_find_surface(wl_client_t* client, uint32_t surface_id) {
+    for (uint32_t i = 0; i < client->surface_count; i++) {
+        if (client->surfaces[i].id == surface_id) {
+            return &client->surfaces[i];
+        }
+    }
+    return NULL;
+}
+
+static wl_shm_pool_t* wl_find_pool(wl_client_t* client, uint32_t pool_id) {
+    for (uint32_t i = 0; i < client->shm_pool_count; i++) {
+        if (client->shm_pools[i].id == pool_id) {
+            return &client->shm_pools[i];
+        }
+    }
+    return NULL;
+}
+
+static wl_buffer_t* wl_find_buffer(wl_client_t* client, uint32_t buffer_id) {
+    for (uint32_t i = 0; i < client->shm_pool_count; i++) {
+        wl_shm_pool_t* pool = &client->shm_pools[i];
+        for (uint32_t j = 0; j < pool->buffer_count; j++) {
+            if (pool->buffers[j].id == buffer_id) {
+                return &pool->buffers[j];
+            }
+        }
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * WAYLAND COMPOSITOR IMPLEMENTATION
+ * ============================================================================ */
+
+/**
+ * Initialize Wayland compositor
+ */
+int wayland_compositor_init(uint32_t width, uint32_t height, void* framebuffer) {
+    if (g_wayland_compositor.initialized) {
+        return 0;
+    }
+    
+    platform_memset(&g_wayland_compositor, 0, sizeof(wl_compositor_t));
+    
+    g_wayland_compositor.width = width;
+    g_wayland_compositor.height = height;
+    g_wayland_compositor.framebuffer = framebuffer;
+    g_wayland_compositor.fb_size = width * height * 4;
+    g_wayland_compositor.scanout = framebuffer;
+    g_wayland_compositor.next_id = 1;
+    
+    g_wayland_compositor.initialized = true;
+    g_wayland_compositor.running = true;
+    
+    return 0;
+}
+
+/**
+ * Process Wayland message
+ * Arguments are 32-bit words in host byte order.
+ */
+int wayland_process_message(uint32_t client_id, uint32_t object_id, 
+                            uint16_t opcode, uint8_t* data, uint32_t length) {
+    if (!g_wayland_compositor.initialized || !g_wayland_compositor.running) {
+        return -1;
+    }
+    
+    /* Handle based on object type and opcode */
+    if (object_id == 1) {
+        /* wl_display */
+        switch (opcode) {
+            case WL_DISPLAY_SYNC:
+                /* Sync request */
+                break;
+            case WL_DISPLAY_GET_REGISTRY:
+                /* Get registry */
+                break;
+        }
+        return 0;
+    }
+    
+    wl_client_t* client = wl_get_client(client_id);
+    if (!client) {
+        return -1;
+    }
+    if (wl_find_surface(client, object_id)) {
+        const int32_t* args = (const int32_t*)data;
+        switch (opcode) {
+            case WL_SURFACE_ATTACH:
+                if (!data || length < 12) {
+                    return -1;
+                }
+                return wayland_surface_attach(client_id, object_id, (uint32_t)args[0], args[1], args[2]);
+            case WL_SURFACE_DAMAGE:
+                if (!data || length < 16) {
+                    return -1;
+                }
+                return wayland_surface_damage(client_id, object_id, args[0], args[1], args[2], args[3]);
+            case WL_SURFACE_FRAME:
+                return wayland_surface_frame(client_id, object_id);
+            case WL_SURFACE_COMMIT:
+                return wayland_commit_surface(client_id, object_id);
+            default:
+                break;
+        }
+    }
+    
+    return 0;
+}
+
+/**
+ * Create Wayland surface
+ */
+int wayland_create_surface(uint32_t client_id) {
+    if (client_id >= g_wayland_compositor.client_count) {
+        return -1;
+    }
+    
+    wl_client_t* client = &g_wayland_compositor.clients[client_id];
+    if (client->surface_count >= WL_MAX_SURFACES) {
+        return -1;
+    }
+    
+    wl_surface_t* surface = &client->surfaces[client->surface_count];
+    platform_memset(surface, 0, sizeof(wl_surface_t));
+    surface->id = g_wayland_compositor.next_id++;
+    
+    client->surface_count++;
+    
+    return (int)surface->id;
+}
+
+/**
+ * Create a wl_shm pool over client shared memory
+ */
+int wayland_shm_create_pool(uint32_t client_id, void* data, int32_t size) {
+    wl_client_t* client = wl_get_client(client_id);
+    if (!client || !data || size <= 0 || client->shm_pool_count >= WL_MAX_POOLS) {
+        return -1;
+    }
+    
+    wl_shm_pool_t* pool = &client->shm_pools[client->shm_pool_count];
+    platform_memset(pool, 0, sizeof(wl_shm_pool_t));
+    pool->id = g_wayland_compositor.next_id++;
+    pool->data = data;
+    pool->size = size;
+    
+    client->shm_pool_count++;
+    
+    return (int)pool->id;
+}
+
+/**
+ * Create a buffer within a wl_shm pool
+ */
+int wayland_shm_pool_create_buffer(uint32_t client_id, uint32_t pool_id, int32_t offset,
+                                   int32_t width, int32_t height, int32_t stride, uint32_t format) {
+    wl_client_t* client = wl_get_client(client_id);
+    if (!client) {
+        return -1;
+    }
+    wl_shm_pool_t* pool = wl_find_pool(client, pool_id);
+    if (!pool || pool->buffer_count >= WL_MAX_BUFFERS) {
+        return -1;
+    }
+    if (format != WL_SHM_FORMAT_ARGB8888 && format != WL_SHM_FORMAT_XRGB8888) {
+        return -1;
+    }
+    if (offset < 0 || width <= 0 || height <= 0 || stride < width * 4 || (stride & 3) ||
+        (int64_t)offset + (int64_t)stride * height > pool->size) {
+        return -1;
+    }
+    
+    wl_buffer_t* buffer = &pool->buffers[pool->buffer_count];
+    platform_memset(buffer, 0, sizeof(wl_buffer_t));
+    buffer->id = g_wayland_compositor.next_id++;
+    buffer->data = (uint8_t*)pool->data + offset;
+    buffer->width = width;
+    buffer->height = height;
+    buffer->stride = stride;
+    buffer->format = format;
+    
+    pool->buffer_count++;
+    
+    return (int)buffer->id;
+}
+
+/**
+ * Attach a buffer to a surface's pending state (buffer_id 0 detaches)
+ */
+int wayland_surface_attach(uint32_t client_id, uint32_t surface_id, uint32_t buffer_id,
+                           int32_t x, int32_t y) {
+    wl_client_t* client = wl_get_client(client_id);
+    if (!client) {
+        return -1;
+    }
+    wl_surface_t* surface = wl_find_surface(client, surface_id);
+    if (!surface) {
+        return -1;
+    }
+    
+    wl_buffer_t* buffer = NULL;
+    if (buffer_id != 0) {
+        buffer = wl_find_buffer(client, buffer_id);
+        if (!buffer) {
+            return -1;
+        }
+    }
+    
+    surface->pending_buffer = buffer;
+    surface->pending_attach = true;
+    surface->pending_dx = x;
+    surface->pending_dy = y;
+    return 0;
+}
+
+/**
+ * Add a damaged rectangle, in surface coordinates, to the pending state
+ */
+int wayland_surface_damage(uint32_t client_id, uint32_t surface_id,
+                           int32_t x, int32_t y, int32_t width, int32_t height) {
+    wl_client_t* client = wl_get_client(client_id);
+    if (!client) {
+        return -1;
+    }
+    wl_surface_t* surface = wl_find_surface(client, surface_id);
+    if (!surface) {
+        return -1;
+    }
+    if (width <= 0 || height <= 0) {
+        return 0;
+    }
+    
+    display_box_t box = { x, y, x + width, y + height };
+    display_add_damage(surface->pending_damage, &surface->pending_damage_count, &box);
+    return 0;
+}
+
+/**
+ * Request a frame callback with the next commit
+ */
+int wayland_surface_frame(uint32_t client_id, uint32_t surface_id) {
+    wl_client_t* client = wl_get_client(client_id);
+    if (!client) {
+        return -1;
+    }
+    wl_surface_t* surface = wl_find_surface(client, surface_id);
+    if (!surface) {
+        return -1;
+    }
+    surface->pending_frame = true;
+    return 0;
+}
+
+/**
+ * Place a surface on the output (shell side)
+ */
+int wayland_surface_set_position(uint32_t client_id, uint32_t surface_id, int32_t x, int32_t y) {
+    wl_client_t* client = wl_get_client(client_id);
+    if (!client) {
+        return -1;
+    }
+    wl_surface_t* surface = wl_find_surface(client, surface_id);
+    if (!surface) {
+        return -1;
+    }
+    
+    display_box_t old;
+    wl_surface_extent(surface, &old);
+    surface->x = x;
+    surface->y = y;
+    if (surface->buffer) {
+        display_box_t now;
+        wl_surface_extent(surface, &now);
+        wl_add_damage(old);
+        wl_add_damage(now);
+        wl_repaint();
+    }
+    return 0;
+}
+
+/**
+ * Commit Wayland surface
+ * Applies the pending buffer and damage, then updates the output: the
+ * damaged area is composed from client memory, or the buffer itself is
+ * scanned out when it is fullscreen and opaque.
+ */
+int wayland_commit_surface(uint32_t client_id, uint32_t surface_id) {
+    wl_client_t* client = wl_get_client(client_id);
+    if (!client) {
+        return -1;
+    }
+    wl_surface_t* surface = wl_find_surface(client, surface_id);
+    if (!surface) {
+        return -1;
+    }
+    
+    if (surface->pending_attach) {
+        wl_buffer_t* buffer = surface->pending_buffer;
+        bool had_buffer = surface->buffer != NULL;
+        display_box_t before;
+        display_box_t after;
+        
+        wl_surface_extent(surface, &before);
+        wl_buffer_ref(buffer);
+        wl_buffer_unref(surface->buffer);
+        surface->buffer = buffer;
+        surface->x += surface->pending_dx;
+        surface->y += surface->pending_dy;
+        surface->width = buffer ? buffer->width : 0;
+        surface->height = buffer ? buffer->height : 0;
+        surface->pending_buffer = NULL;
+        surface->pending_attach = false;
+        wl_surface_extent(surface, &after);
+        
+        /* A new buffer of the same geometry only needs its damage composed */
+        bool reshaped = !had_buffer || !buffer ||
+                        before.x0 != after.x0 || before.y0 != after.y0 ||
+                        before.x1 != after.x1 || before.y1 != after.y1;
+        if (reshaped || surface->pending_damage_count == 0) {
+            if (had_buffer) {
+                wl_add_damage(before);
+            }
+            if (buffer) {
+                wl_add_damage(after);
+            }
+        }
+    }
+    
+    if (surface->buffer) {
+        for (uint32_t i = 0; i < surface->pending_damage_count; i++) {
+            display_box_t box = surface->pending_damage[i];
+            display_box_intersect(&box, 0, 0, surface->width, surface->height);
+            box.x0 += surface->x;
+            box.x1 += surface->x;
+            box.y0 += surface->y;
+            box.y1 += surface->y;
+            if (!display_box_empty(&box)) {
+                wl_add_damage(box);
+            }
+        }
+    }
+    surface->pending_damage_count = 0;
+    
+    if (surface->pending_frame) {
+        surface->frame_requested = true;
+        surface->pending_frame = false;
+    }
+    
+    surface->committed = true;
+    g_wayland_compositor.stats.commits++;
+    wl_repaint();
+    
+    return 0;
+}
+
+/**
+ * Signal vertical blank: fire pending frame callbacks
+ */
+int wayland_output_vblank(void) {
+    wl_compositor_t* c = &g_wayland_compositor;
+    int fired = 0;
+    
+    if (!c->initialized) {
+        return -1;
+    }
+    
+    for (uint32_t i = 0; i < c->client_count; i++) {
+        wl_client_t* client = &c->clients[i];
+        for (uint32_t j = 0; j < client->surface_count; j++) {
+            if (client->surfaces[j].frame_requested) {
+                client->surfaces[j].frame_requested = false;
+                client->surfaces[j].frames_done++;
+                fired++;
+            }
+        }
+    }
+    c->stats.frame_callbacks += (uint32_t)fired;
+    return fired;
+}
+
+/**
+ * Check whether the compositor still reads from a buffer
+ */
+bool wayland_buffer_busy(uint32_t client_id, uint32_t buffer_id) {
+    wl_client_t* client = wl_get_client(client_id);
+    if (!client) {
+        return false;
+    }
+    wl_buffer_t* buffer = wl_find_buffer(client, buffer_id);
+    return buffer && buffer->refs > 0;
+}
+
+/**
+ * Get the memory the display should scan out
+ */
+void* wayland_get_scanout(void) {
+    return g_wayland_compositor.scanout;
+}
+
+/**
+ * Get Wayland compositor statistics
+ */
+void wayland_get_stats(wl_stats_t* stats) {
+    if (stats) {
+        *stats = g_wayland_compositor.stats;
+    }
 }
 
 /**
@@ -552,7 +2153,7 @@ int wayland_accept_client(void) {
         return -1;
     }
     
-    if (g_wayland_compositor.client_count >= 16) {
+    if (g_wayland_compositor.client_count >= WL_MAX_CLIENTS) {
         return -1;
     }
     
@@ -29,8 +29,20 @@
 #define GDB_SIGNAL_SEGV     11  /* SIGSEGV */
 #define GDB_SIGNAL_ILL      4   /* SIGILL */
 
-/* GDB packet buffer size */
-#define GDB_PACKET_SIZE     4096
+/* GDB packet buffer size, advertised to the client as PacketSize */
+#define GDB_PACKET_SIZE     0x4000
+
+/* Packet size assumed until the client negotiates with qSupported */
+#define GDB_LEGACY_PACKET_SIZE 0x400
+
+/* Socket stand-in ring buffer size (a full escaped reply plus framing) */
+#define GDB_SOCKET_BUFFER_SIZE (GDB_PACKET_SIZE * 2)
+
+/* Instructions executed by one vCont range step before reporting a stop */
+#define GDB_RANGE_STEP_LIMIT 0x100000
+
+/* Bytes pulled from the socket per receive call */
+#define GDB_RECV_CHUNK      1024
 
 /* GDB register IDs for x86 */
 #define GDB_REG_EAX         0
@@ -68,8 +80,12 @@ typedef struct {
     char buffer[GDB_PACKET_SIZE];
     uint32_t length;
     uint32_t expected_checksum;
+    uint8_t checksum;           /* Running sum of raw packet bytes */
+    uint8_t checksum_digits;    /* Checksum digits seen after '#' */
     bool in_packet;
+    bool in_checksum;
     bool escaped;
+    bool overflow;
 } gdb_parser_t;
 
 /* GDB Server state */
@@ -100,10 +116,17 @@ typedef struct {
     /* Response buffer */
     char response[GDB_PACKET_SIZE];
     
+    /* Framed packet being sent ('$', escaped payload, '#', checksum) */
+    char frame[GDB_SOCKET_BUFFER_SIZE];
+    
+    /* Memory transfer staging buffer */
+    uint8_t xfer[GDB_PACKET_SIZE];
+    
     /* Features */
     bool no_ack_mode;
     bool extended_mode;
     bool multiprocess;
+    uint32_t packet_size;       /* Negotiated via qSupported */
     
     bool initialized;
 } gdb_server_t;
@@ -155,27 +178,51 @@ static uint32_t parse_hex(const char* str, uint32_t* consumed) {
     return value;
 }
 
+/* Two hex digits per byte value, filled in by hex_pairs_init() */
+static char g_hex_pairs[256][2];
+
 /**
- * Write hex value to string
+ * Build the byte-to-hex lookup table
  */
-static void write_hex(char* str, uint32_t value, int bytes) {
-    for (int i = bytes - 1; i >= 0; i--) {
-        uint8_t b = (value >> (i * 8)) & 0xFF;
-        *str++ = value_to_hex(b >> 4);
-        *str++ = value_to_hex(b);
+static void hex_pairs_init(void) {
+    for (int i = 0; i < 256; i++) {
+        g_hex_pairs[i][0] = value_to_hex(i >> 4);
+        g_hex_pairs[i][1] = value_to_hex(i);
     }
-    *str = '\0';
 }
 
 /**
- * Calculate checksum
+ * Hex-encode a byte buffer, two characters per byte
  */
-static uint8_t calculate_checksum(const char* data, uint32_t length) {
-    uint8_t sum = 0;
+static uint32_t encode_hex(char* out, const uint8_t* data, uint32_t length) {
     for (uint32_t i = 0; i < length; i++) {
-        sum += (uint8_t)data[i];
+        out[i * 2] = g_hex_pairs[data[i]][0];
+        out[i * 2 + 1] = g_hex_pairs[data[i]][1];
     }
-    return sum;
+    return length * 2;
+}
+
+/**
+ * Write value as hex without leading zeros, returns characters written
+ */
+static uint32_t format_hex(char* out, uint32_t value) {
+    uint32_t n = 0;
+    int shift = 28;
+    
+    while (shift > 0 && ((value >> shift) & 0xF) == 0) {
+        shift -= 4;
+    }
+    for (; shift >= 0; shift -= 4) {
+        out[n++] = value_to_hex(value >> shift);
+    }
+    return n;
+}
+
+/**
+ * Check whether a byte must be escaped in binary packet data
+ */
+static bool needs_escape(uint8_t c) {
+    return c == '$' || c == '#' || c == GDB_ESCAPE || c == '*';
 }
 
 /* ============================================================================
@@ -196,12 +243,12 @@ static gdb_net_socket_t g_gdb_net_sockets[4];
 static uint32_t g_next_sock_idx = 0;
 
 /* Ring buffers for socket data (allows testing without actual network) */
-static char g_socket_rx_buffer[GDB_PACKET_SIZE];
+static char g_socket_rx_buffer[GDB_SOCKET_BUFFER_SIZE];
 static uint32_t g_socket_rx_head = 0;
 static uint32_t g_socket_rx_tail = 0;
 static uint32_t g_socket_rx_count = 0;
 
-static char g_socket_tx_buffer[GDB_PACKET_SIZE];
+static char g_socket_tx_buffer[GDB_SOCKET_BUFFER_SIZE];
 static uint32_t g_socket_tx_head = 0;
 static uint32_t g_socket_tx_tail = 0;
 static uint32_t g_socket_tx_count = 0;
@@ -216,60 +263,76 @@ typedef struct {
 static pending_connection_t g_pending_connections[4];
 static uint32_t g_pending_count = 0;
 
+/**
+ * Copy into a ring buffer in at most two contiguous runs
+ * Returns bytes stored (short if the ring fills up)
+ */
+static uint32_t ring_write(char* ring, uint32_t* tail, uint32_t* count,
+                           const char* data, uint32_t length) {
+    uint32_t space = GDB_SOCKET_BUFFER_SIZE - *count;
+    if (length > space) length = space;
+    
+    uint32_t first = GDB_SOCKET_BUFFER_SIZE - *tail;
+    if (first > length) first = length;
+    platform_memcpy(ring + *tail, data, first);
+    if (length > first) {
+        platform_memcpy(ring, data + first, length - first);
+    }
+    
+    *tail = (*tail + length) % GDB_SOCKET_BUFFER_SIZE;
+    *count += length;
+    return length;
+}
+
+/**
+ * Copy out of a ring buffer in at most two contiguous runs
+ */
+static uint32_t ring_read(const char* ring, uint32_t* head, uint32_t* count,
+                          char* buffer, uint32_t max_len) {
+    uint32_t length = *count < max_len ? *count : max_len;
+    
+    uint32_t first = GDB_SOCKET_BUFFER_SIZE - *head;
+    if (first > length) first = length;
+    platform_memcpy(buffer, ring + *head, first);
+    if (length > first) {
+        platform_memcpy(buffer + first, ring, length - first);
+    }
+    
+    *head = (*head + length) % GDB_SOCKET_BUFFER_SIZE;
+    *count -= length;
+    return length;
+}
+
 /**
  * Write data to RX ring buffer (used for testing/simulation)
  */
 static int rx_buffer_write(const char* data, uint32_t length) {
-    for (uint32_t i = 0; i < length; i++) {
-        if (g_socket_rx_count >= GDB_PACKET_SIZE) {
-            return (int)i; /* Buffer full */
-        }
-        g_socket_rx_buffer[g_socket_rx_tail] = data[i];
-        g_socket_rx_tail = (g_socket_rx_tail + 1) % GDB_PACKET_SIZE;
-        g_socket_rx_count++;
-    }
-    return (int)length;
+    return (int)ring_write(g_socket_rx_buffer, &g_socket_rx_tail,
+                           &g_socket_rx_count, data, length);
 }
 
 /**
  * Read data from RX ring buffer
  */
 static int rx_buffer_read(char* buffer, uint32_t max_len) {
-    uint32_t bytes_read = 0;
-    while (bytes_read < max_len && g_socket_rx_count > 0) {
-        buffer[bytes_read++] = g_socket_rx_buffer[g_socket_rx_head];
-        g_socket_rx_head = (g_socket_rx_head + 1) % GDB_PACKET_SIZE;
-        g_socket_rx_count--;
-    }
-    return (int)bytes_read;
+    return (int)ring_read(g_socket_rx_buffer, &g_socket_rx_head,
+                          &g_socket_rx_count, buffer, max_len);
 }
 
 /**
  * Write data to TX ring buffer
  */
 static int tx_buffer_write(const char* data, uint32_t length) {
-    for (uint32_t i = 0; i < length; i++) {
-        if (g_socket_tx_count >= GDB_PACKET_SIZE) {
-            return (int)i; /* Buffer full */
-        }
-        g_socket_tx_buffer[g_socket_tx_tail] = data[i];
-        g_socket_tx_tail = (g_socket_tx_tail + 1) % GDB_PACKET_SIZE;
-        g_socket_tx_count++;
-    }
-    return (int)length;
+    return (int)ring_write(g_socket_tx_buffer, &g_socket_tx_tail,
+                           &g_socket_tx_count, data, length);
 }
 
 /**
  * Read data from TX ring buffer (for testing retrieval)
  */
 static int tx_buffer_read(char* buffer, uint32_t max_len) {
-    uint32_t bytes_read = 0;
-    while (bytes_read < max_len && g_socket_tx_count > 0) {
-        buffer[bytes_read++] = g_socket_tx_buffer[g_socket_tx_head];
-        g_socket_tx_head = (g_socket_tx_head + 1) % GDB_PACKET_SIZE;
-        g_socket_tx_count--;
-    }
-    return (int)bytes_read;
+    return (int)ring_read(g_socket_tx_buffer, &g_socket_tx_head,
+                          &g_socket_tx_count, buffer, max_len);
 }
 
 /**
@@ -479,22 +542,38 @@ int gdb_socket_queue_connection(uint32_t client_ip, uint16_t client_port) {
  * GDB PACKET HANDLING
  * ============================================================================ */
 
+/**
+ * Send GDB packet with a binary payload
+ * Reserved characters are escaped and the checksum covers the escaped bytes
+ */
+static int gdb_send_binary(const char* data, uint32_t len) {
+    char* frame = g_gdb_server.frame;
+    uint32_t n = 0;
+    uint8_t checksum = 0;
+    
+    frame[n++] = GDB_START;
+    for (uint32_t i = 0; i < len && n < sizeof(g_gdb_server.frame) - 5; i++) {
+        uint8_t c = (uint8_t)data[i];
+        if (needs_escape(c)) {
+            frame[n++] = GDB_ESCAPE;
+            checksum += (uint8_t)GDB_ESCAPE;
+            c ^= GDB_XOR_MASK;
+        }
+        frame[n++] = (char)c;
+        checksum += c;
+    }
+    frame[n++] = GDB_END;
+    frame[n++] = value_to_hex(checksum >> 4);
+    frame[n++] = value_to_hex(checksum);
+    
+    return gdb_socket_send(&g_gdb_server.socket, frame, n);
+}
+
 /**
  * Send GDB packet
  */
 static int gdb_send_packet(const char* data) {
-    uint32_t len = platform_strlen(data);
-    uint8_t checksum = calculate_checksum(data, len);
-    
-    char packet[GDB_PACKET_SIZE];
-    packet[0] = GDB_START;
-    platform_memcpy(packet + 1, data, len);
-    packet[1 + len] = GDB_END;
-    packet[2 + len] = value_to_hex(checksum >> 4);
-    packet[3 + len] = value_to_hex(checksum);
-    packet[4 + len] = '\0';
-    
-    return gdb_socket_send(&g_gdb_server.socket, packet, 4 + len);
+    return gdb_send_binary(data, platform_strlen(data));
 }
 
 /**
@@ -532,13 +611,101 @@ static void gdb_send_stop_reply(int signal) {
  * GDB COMMAND HANDLERS
  * ============================================================================ */
 
+/**
+ * Parse "addr,length" and return pointer past the length (NULL on error)
+ */
+static const char* parse_addr_length(const char* p, uint32_t* addr, uint32_t* length) {
+    uint32_t consumed;
+    
+    *addr = parse_hex(p, &consumed);
+    p += consumed;
+    if (consumed == 0 || *p != ',') {
+        return 0;
+    }
+    p++;
+    
+    *length = parse_hex(p, &consumed);
+    if (consumed == 0) {
+        return 0;
+    }
+    return p + consumed;
+}
+
+/**
+ * Handle qSupported
+ * Client features need no action here; answering switches replies from
+ * the legacy size to the advertised PacketSize.
+ */
+static void gdb_handle_supported(const char* packet) {
+    (void)packet;
+    
+    char* resp = g_gdb_server.response;
+    uint32_t n;
+    
+    g_gdb_server.packet_size = GDB_PACKET_SIZE;
+    
+    platform_memcpy(resp, "PacketSize=", 11);
+    n = 11;
+    n += format_hex(resp + n, GDB_PACKET_SIZE);
+    const char* features = ";QStartNoAckMode+;qXfer:memory-map:read+"
+                           ";qXfer:features:read+;swbreak+;hwbreak+;vContSupported+";
+    uint32_t flen = platform_strlen(features);
+    platform_memcpy(resp + n, features, flen);
+    resp[n + flen] = '\0';
+    
+    gdb_send_packet(resp);
+}
+
+/**
+ * Handle qXfer:memory-map:read::offset,length
+ * Replies 'm' with a chunk when more follows, 'l' with the final chunk
+ */
+static void gdb_handle_memory_map(const char* packet) {
+    if (!g_gdb_server.vm) {
+        gdb_send_error(1);
+        return;
+    }
+    
+    uint32_t offset, length;
+    if (!parse_addr_length(packet + 23, &offset, &length)) {
+        gdb_send_error(1);
+        return;
+    }
+    
+    char* map = (char*)g_gdb_server.xfer;
+    int map_len = aurora_vm_gdb_memory_map(g_gdb_server.vm, map, sizeof(g_gdb_server.xfer));
+    if (map_len < 0) {
+        gdb_send_error(1);
+        return;
+    }
+    
+    if (length > g_gdb_server.packet_size - 2) {
+        length = g_gdb_server.packet_size - 2;
+    }
+    
+    char* resp = g_gdb_server.response;
+    if (offset >= (uint32_t)map_len) {
+        resp[0] = 'l';
+        gdb_send_binary(resp, 1);
+        return;
+    }
+    
+    uint32_t avail = (uint32_t)map_len - offset;
+    uint32_t chunk = avail < length ? avail : length;
+    resp[0] = chunk < avail ? 'm' : 'l';
+    platform_memcpy(resp + 1, map + offset, chunk);
+    gdb_send_binary(resp, chunk + 1);
+}
+
 /**
  * Handle query packet (q)
  */
 static void gdb_handle_query(const char* packet) {
     if (platform_strncmp(packet, "qSupported", 10) == 0) {
-        /* Report supported features */
-        gdb_send_packet("PacketSize=1000;qXfer:features:read+;swbreak+;hwbreak+");
+        gdb_handle_supported(packet);
+    }
+    else if (platform_strncmp(packet, "qXfer:memory-map:read::", 23) == 0) {
+        gdb_handle_memory_map(packet);
     }
     else if (platform_strncmp(packet, "qAttached", 9) == 0) {
         gdb_send_packet("1");
@@ -561,8 +728,23 @@ static void gdb_handle_query(const char* packet) {
     }
 }
 
+/**
+ * Handle set packet (Q)
+ */
+static void gdb_handle_set(const char* packet) {
+    if (platform_strcmp(packet, "QStartNoAckMode") == 0) {
+        /* The OK reply is still acknowledged; acks stop afterwards */
+        gdb_send_ok();
+        g_gdb_server.no_ack_mode = true;
+    }
+    else {
+        gdb_send_packet("");
+    }
+}
+
 /**
  * Handle read registers (g)
+ * Registers are gathered once and hex-encoded in target (little-endian) order
  */
 static void gdb_handle_read_registers(void) {
     if (!g_gdb_server.vm) {
@@ -570,43 +752,54 @@ static void gdb_handle_read_registers(void) {
         return;
     }
     
-    char resp[256];
-    char* p = resp;
+    uint8_t regs[18 * 4];
+    uint32_t values[18];
     
-    /* Write general purpose registers */
     for (int i = 0; i < 16; i++) {
-        uint32_t reg = aurora_vm_get_register(g_gdb_server.vm, i);
-        write_hex(p, reg, 4);
-        p += 8;
+        values[i] = aurora_vm_get_register(g_gdb_server.vm, i);
+    }
+    values[16] = g_gdb_server.vm->cpu.pc;
+    values[17] = g_gdb_server.vm->cpu.flags;
+    
+    for (int i = 0; i < 18; i++) {
+        regs[i * 4] = (uint8_t)values[i];
+        regs[i * 4 + 1] = (uint8_t)(values[i] >> 8);
+        regs[i * 4 + 2] = (uint8_t)(values[i] >> 16);
+        regs[i * 4 + 3] = (uint8_t)(values[i] >> 24);
     }
     
-    /* Write PC */
-    write_hex(p, g_gdb_server.vm->cpu.pc, 4);
-    p += 8;
-    
-    /* Write flags */
-    write_hex(p, g_gdb_server.vm->cpu.flags, 4);
-    p += 8;
-    
-    *p = '\0';
-    gdb_send_packet(resp);
+    uint32_t n = encode_hex(g_gdb_server.response, regs, sizeof(regs));
+    gdb_send_binary(g_gdb_server.response, n);
 }
 
 /**
  * Handle write registers (G)
  */
-static void gdb_handle_write_registers(const char* packet) {
+static void gdb_handle_write_registers(const char* packet, uint32_t length) {
     if (!g_gdb_server.vm) {
         gdb_send_error(1);
         return;
     }
     
+    if (length < 1 + 16 * 8) {
+        gdb_send_error(1);
+        return;
+    }
+    
     const char* p = packet + 1;  /* Skip 'G' */
     
-    /* Read general purpose registers */
+    /* Read general purpose registers (little-endian, as sent by 'g') */
     for (int i = 0; i < 16; i++) {
-        uint32_t consumed;
-        uint32_t reg = parse_hex(p, &consumed);
+        uint32_t reg = 0;
+        for (int b = 0; b < 4; b++) {
+            int hi = hex_char_value(p[b * 2]);
+            int lo = hex_char_value(p[b * 2 + 1]);
+            if (hi < 0 || lo < 0) {
+                gdb_send_error(1);
+                return;
+            }
+            reg |= (uint32_t)((hi << 4) | lo) << (b * 8);
+        }
         aurora_vm_set_register(g_gdb_server.vm, i, reg);
         p += 8;
     }
@@ -614,6 +807,14 @@ static void gdb_handle_write_registers(const char* packet) {
     gdb_send_ok();
 }
 
+/**
+ * Largest memory read that fits one reply at the negotiated packet size
+ */
+static uint32_t gdb_max_read(uint32_t per_byte) {
+    uint32_t max = (g_gdb_server.packet_size - 1) / per_byte;
+    return max < sizeof(g_gdb_server.xfer) ? max : sizeof(g_gdb_server.xfer);
+}
+
 /**
  * Handle read memory (m)
  */
@@ -623,78 +824,90 @@ static void gdb_handle_read_memory(const char* packet) {
         return;
     }
     
-    const char* p = packet + 1;  /* Skip 'm' */
-    uint32_t consumed;
+    uint32_t addr, length;
+    if (!parse_addr_length(packet + 1, &addr, &length)) {
+        gdb_send_error(1);
+        return;
+    }
     
-    /* Parse address */
-    uint32_t addr = parse_hex(p, &consumed);
-    p += consumed;
+    uint32_t max = gdb_max_read(2);
+    if (length > max) length = max;  /* Limit to one reply */
     
-    if (*p != ',') {
+    int bytes = aurora_vm_read_memory(g_gdb_server.vm, addr, length, g_gdb_server.xfer);
+    if (bytes < 0) {
         gdb_send_error(1);
         return;
     }
-    p++;
     
-    /* Parse length */
-    uint32_t length = parse_hex(p, &consumed);
+    uint32_t n = encode_hex(g_gdb_server.response, g_gdb_server.xfer, (uint32_t)bytes);
+    gdb_send_binary(g_gdb_server.response, n);
+}
+
+/**
+ * Handle binary read memory (x)
+ * Replies 'b' followed by raw bytes, trimmed so the escaped reply fits
+ */
+static void gdb_handle_read_memory_binary(const char* packet) {
+    if (!g_gdb_server.vm) {
+        gdb_send_error(1);
+        return;
+    }
     
-    if (length > 512) length = 512;  /* Limit size */
+    uint32_t addr, length;
+    if (!parse_addr_length(packet + 1, &addr, &length)) {
+        gdb_send_error(1);
+        return;
+    }
     
-    char resp[1024];
-    uint8_t buf[512];
+    uint32_t max = gdb_max_read(1) - 1;
+    if (length > max) length = max;
     
-    int bytes = aurora_vm_read_memory(g_gdb_server.vm, addr, length, buf);
+    int bytes = aurora_vm_read_memory(g_gdb_server.vm, addr, length, g_gdb_server.xfer);
     if (bytes < 0) {
         gdb_send_error(1);
         return;
     }
     
-    /* Convert to hex */
-    for (uint32_t i = 0; i < (uint32_t)bytes; i++) {
-        resp[i*2] = value_to_hex(buf[i] >> 4);
-        resp[i*2+1] = value_to_hex(buf[i]);
+    /* Keep the escaped size within the packet budget */
+    uint32_t budget = g_gdb_server.packet_size - 1;
+    uint32_t count = 0;
+    uint32_t wire = 0;
+    while (count < (uint32_t)bytes) {
+        uint32_t cost = needs_escape(g_gdb_server.xfer[count]) ? 2 : 1;
+        if (wire + cost > budget) break;
+        wire += cost;
+        count++;
     }
-    resp[bytes * 2] = '\0';
     
-    gdb_send_packet(resp);
+    g_gdb_server.response[0] = 'b';
+    platform_memcpy(g_gdb_server.response + 1, g_gdb_server.xfer, count);
+    gdb_send_binary(g_gdb_server.response, count + 1);
 }
 
 /**
  * Handle write memory (M)
  */
-static void gdb_handle_write_memory(const char* packet) {
+static void gdb_handle_write_memory(const char* packet, uint32_t packet_len) {
     if (!g_gdb_server.vm) {
         gdb_send_error(1);
         return;
     }
     
-    const char* p = packet + 1;  /* Skip 'M' */
-    uint32_t consumed;
-    
-    /* Parse address */
-    uint32_t addr = parse_hex(p, &consumed);
-    p += consumed;
-    
-    if (*p != ',') {
+    uint32_t addr, length;
+    const char* p = parse_addr_length(packet + 1, &addr, &length);
+    if (!p || *p != ':') {
         gdb_send_error(1);
         return;
     }
     p++;
     
-    /* Parse length */
-    uint32_t length = parse_hex(p, &consumed);
-    p += consumed;
-    
-    if (*p != ':') {
+    /* Parse data */
+    uint8_t* buf = g_gdb_server.xfer;
+    if (length > sizeof(g_gdb_server.xfer) ||
+        (uint32_t)(p - packet) + length * 2 > packet_len) {
         gdb_send_error(1);
         return;
     }
-    p++;
-    
-    /* Parse data */
-    uint8_t buf[256];
-    if (length > 256) length = 256;
     
     for (uint32_t i = 0; i < length; i++) {
         int hi = hex_char_value(*p++);
@@ -714,6 +927,38 @@ static void gdb_handle_write_memory(const char* packet) {
     gdb_send_ok();
 }
 
+/**
+ * Handle binary write memory (X)
+ * The parser has already removed '}' escapes, so the payload is raw bytes
+ */
+static void gdb_handle_write_memory_binary(const char* packet, uint32_t packet_len) {
+    if (!g_gdb_server.vm) {
+        gdb_send_error(1);
+        return;
+    }
+    
+    uint32_t addr, length;
+    const char* p = parse_addr_length(packet + 1, &addr, &length);
+    if (!p || *p != ':') {
+        gdb_send_error(1);
+        return;
+    }
+    p++;
+    
+    if ((uint32_t)(p - packet) + length > packet_len) {
+        gdb_send_error(1);
+        return;
+    }
+    
+    /* Zero-length writes probe for X support */
+    if (length > 0 && aurora_vm_write_memory(g_gdb_server.vm, addr, length, p) < 0) {
+        gdb_send_error(1);
+        return;
+    }
+    
+    gdb_send_ok();
+}
+
 /**
  * Handle continue (c)
  */
@@ -752,6 +997,60 @@ static void gdb_handle_step(const char* packet) {
     gdb_send_stop_reply(GDB_SIGNAL_TRAP);
 }
 
+/**
+ * Handle vCont
+ * The target has one thread, so the first action applies. Range
+ * stepping ("r start,end") steps in a batch until PC leaves the range,
+ * saving a round trip per instruction.
+ */
+static void gdb_handle_vcont(const char* packet) {
+    if (platform_strcmp(packet, "vCont?") == 0) {
+        gdb_send_packet("vCont;c;C;s;S;r");
+        return;
+    }
+    
+    if (packet[5] != ';' || !g_gdb_server.vm) {
+        gdb_send_error(1);
+        return;
+    }
+    
+    const char* p = packet + 6;
+    switch (*p) {
+        case 'c':
+        case 'C':
+            gdb_handle_continue(p);
+            break;
+            
+        case 's':
+        case 'S':
+            gdb_handle_step(p);
+            break;
+            
+        case 'r': {
+            uint32_t start, end;
+            if (!parse_addr_length(p + 1, &start, &end)) {
+                gdb_send_error(1);
+                return;
+            }
+            
+            g_gdb_server.stepping = true;
+            uint32_t steps = 0;
+            do {
+                if (aurora_vm_step(g_gdb_server.vm) != 0) break;
+                steps++;
+            } while (g_gdb_server.vm->cpu.pc >= start && g_gdb_server.vm->cpu.pc < end &&
+                     steps < GDB_RANGE_STEP_LIMIT);
+            
+            gdb_send_stop_reply(GDB_SIGNAL_TRAP);
+            break;
+        }
+            
+        default:
+            gdb_send_error(1);
+            break;
+    }
+}
+
 /**
  * Handle set breakpoint (Z)
  */
@@ -824,8 +1123,10 @@ static void gdb_handle_remove_breakpoint(const char* packet) {
 
 /**
  * Process received packet
+ * @param packet Unescaped packet data, NUL-terminated
+ * @param length Data length (binary payloads may contain NUL bytes)
  */
-static void gdb_process_packet(const char* packet) {
+static void gdb_process_packet(const char* packet, uint32_t length) {
     char cmd = packet[0];
     
     switch (cmd) {
@@ -838,15 +1139,23 @@ static void gdb_process_packet(const char* packet) {
             break;
             
         case 'G':  /* Write registers */
-            gdb_handle_write_registers(packet);
+            gdb_handle_write_registers(packet, length);
             break;
             
         case 'm':  /* Read memory */
             gdb_handle_read_memory(packet);
             break;
             
+        case 'x':  /* Read memory (binary) */
+            gdb_handle_read_memory_binary(packet);
+            break;
+            
         case 'M':  /* Write memory */
-            gdb_handle_write_memory(packet);
+            gdb_handle_write_memory(packet, length);
+            break;
+            
+        case 'X':  /* Write memory (binary) */
+            gdb_handle_write_memory_binary(packet, length);
             break;
             
         case 'c':  /* Continue */
@@ -869,6 +1178,18 @@ static void gdb_process_packet(const char* packet) {
             gdb_handle_query(packet);
             break;
             
+        case 'Q':  /* Set */
+            gdb_handle_set(packet);
+            break;
+            
+        case 'v':  /* Multi-letter commands */
+            if (platform_strncmp(packet, "vCont", 5) == 0) {
+                gdb_handle_vcont(packet);
+            } else {
+                gdb_send_packet("");
+            }
+            break;
+            
         case 'H':  /* Set thread */
             gdb_send_ok();
             break;
@@ -904,6 +1225,9 @@ int gdb_server_init(AuroraVM* vm, uint16_t port) {
     
     g_gdb_server.vm = vm;
     g_gdb_server.stop_signal = GDB_SIGNAL_TRAP;
+    g_gdb_server.packet_size = GDB_LEGACY_PACKET_SIZE;
+    
+    hex_pairs_init();
     
     if (gdb_socket_init(&g_gdb_server.socket, port) != 0) {
         return -1;
@@ -941,71 +1265,117 @@ void gdb_server_stop(void) {
     
     gdb_socket_close(&g_gdb_server.socket);
     g_gdb_server.running = false;
+    g_gdb_server.initialized = false;
 }
 
 /**
- * Handle GDB server events
+ * Send acknowledgement unless no-ack mode has been negotiated
  */
-int gdb_server_poll(void) {
-    if (!g_gdb_server.initialized || !g_gdb_server.socket.connected) {
-        return -1;
+static void gdb_send_ack(char ack) {
+    if (!g_gdb_server.no_ack_mode) {
+        gdb_socket_send(&g_gdb_server.socket, &ack, 1);
     }
-    
-    char buffer[256];
-    int len = gdb_socket_recv(&g_gdb_server.socket, buffer, sizeof(buffer));
-    
-    if (len <= 0) {
-        return 0;
+}
+
+/**
+ * Feed one received byte to the packet parser
+ * Packets are dispatched as soon as their checksum arrives, so several
+ * pipelined packets in one receive are all handled.
+ */
+static void gdb_parse_byte(char c) {
+    gdb_parser_t* parser = &g_gdb_server.parser;
+    
+    if (parser->in_checksum) {
+        int v = hex_char_value(c);
+        parser->expected_checksum = (parser->expected_checksum << 4) | (uint32_t)(v < 0 ? 0 : v);
+        if (v < 0) parser->overflow = true;
+        if (++parser->checksum_digits < 2) {
+            return;
+        }
+        
+        parser->in_checksum = false;
+        parser->in_packet = false;
+        
+        if (parser->overflow ||
+            (!g_gdb_server.no_ack_mode && parser->expected_checksum != parser->checksum)) {
+            gdb_send_ack(GDB_NACK);
+            return;
+        }
+        
+        parser->buffer[parser->length] = '\0';
+        gdb_send_ack(GDB_ACK);
+        gdb_process_packet(parser->buffer, parser->length);
+        return;
     }
     
-    /* Parse received data */
-    for (int i = 0; i < len; i++) {
-        char c = buffer[i];
-        
+    if (!parser->in_packet) {
         if (c == GDB_INTERRUPT) {
             /* Ctrl+C - stop execution */
             g_gdb_server.stopped = true;
             gdb_send_stop_reply(GDB_SIGNAL_INT);
-            continue;
         }
-        
-        if (c == GDB_ACK || c == GDB_NACK) {
-            /* Acknowledgement */
-            continue;
-        }
-        
-        if (c == GDB_START) {
-            g_gdb_server.parser.in_packet = true;
-            g_gdb_server.parser.length = 0;
-            continue;
-        }
-        
-        if (c == GDB_END && g_gdb_server.parser.in_packet) {
-            /* Packet complete - read checksum */
-            continue;
-        }
-        
-        if (g_gdb_server.parser.in_packet) {
-            if (g_gdb_server.parser.length < GDB_PACKET_SIZE - 1) {
-                g_gdb_server.parser.buffer[g_gdb_server.parser.length++] = c;
-            }
+        else if (c == GDB_START) {
+            parser->in_packet = true;
+            parser->length = 0;
+            parser->checksum = 0;
+            parser->escaped = false;
+            parser->overflow = false;
         }
+        /* Acks and line noise between packets are ignored */
+        return;
     }
     
-    /* Process complete packet */
-    if (g_gdb_server.parser.length > 0) {
-        g_gdb_server.parser.buffer[g_gdb_server.parser.length] = '\0';
-        
-        /* Send ACK */
-        if (!g_gdb_server.no_ack_mode) {
-            char ack = GDB_ACK;
-            gdb_socket_send(&g_gdb_server.socket, &ack, 1);
+    if (c == GDB_START) {
+        /* Restart on a new packet start */
+        parser->length = 0;
+        parser->checksum = 0;
+        parser->escaped = false;
+        parser->overflow = false;
+        return;
+    }
+    
+    if (c == GDB_END) {
+        parser->in_checksum = true;
+        parser->checksum_digits = 0;
+        parser->expected_checksum = 0;
+        return;
+    }
+    
+    parser->checksum += (uint8_t)c;
+    
+    if (c == GDB_ESCAPE && !parser->escaped) {
+        parser->escaped = true;
+        return;
+    }
+    if (parser->escaped) {
+        c ^= GDB_XOR_MASK;
+        parser->escaped = false;
+    }
+    
+    if (parser->length < GDB_PACKET_SIZE - 1) {
+        parser->buffer[parser->length++] = c;
+    } else {
+        parser->overflow = true;
+    }
+}
+
+/**
+ * Handle GDB server events
+ */
+int gdb_server_poll(void) {
+    if (!g_gdb_server.initialized || !g_gdb_server.socket.connected) {
+        return -1;
+    }
+    
+    char buffer[GDB_RECV_CHUNK];
+    int len;
+    
+    /* Drain everything available, dispatching packets as they complete */
+    while (g_gdb_server.socket.connected &&
+           (len = gdb_socket_recv(&g_gdb_server.socket, buffer, sizeof(buffer))) > 0) {
+        for (int i = 0; i < len; i++) {
+            gdb_parse_byte(buffer[i]);
         }
-        
-        gdb_process_packet(g_gdb_server.parser.buffer);
-        
-        g_gdb_server.parser.in_packet = false;
-        g_gdb_server.parser.length = 0;
     }
     
     return 0;
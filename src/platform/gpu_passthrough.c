@@ -8,6 +8,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "../../include/platform/platform_util.h"
+#include "../../include/platform/virtio_gpu.h"
 
 /* ============================================================================
  * GPU DEFINITIONS
@@ -565,27 +566,463 @@ int gpu_wait_idle(uint32_t gpu_id) {
  * VIRTIO-GPU SUPPORT
  * ============================================================================ */
 
-/* VirtIO GPU types */
-#define VIRTIO_GPU_CMD_GET_DISPLAY_INFO         0x0100
-#define VIRTIO_GPU_CMD_RESOURCE_CREATE_2D       0x0101
-#define VIRTIO_GPU_CMD_RESOURCE_UNREF           0x0102
-#define VIRTIO_GPU_CMD_SET_SCANOUT              0x0103
-#define VIRTIO_GPU_CMD_RESOURCE_FLUSH           0x0104
-#define VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D      0x0105
-#define VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING  0x0106
-#define VIRTIO_GPU_CMD_RESOURCE_DETACH_BACKING  0x0107
-#define VIRTIO_GPU_CMD_GET_CAPSET_INFO          0x0108
-#define VIRTIO_GPU_CMD_GET_CAPSET               0x0109
-#define VIRTIO_GPU_CMD_CTX_CREATE               0x0200
-#define VIRTIO_GPU_CMD_CTX_DESTROY              0x0201
-#define VIRTIO_GPU_CMD_CTX_ATTACH_RESOURCE      0x0202
-#define VIRTIO_GPU_CMD_CTX_DETACH_RESOURCE      0x0203
-#define VIRTIO_GPU_CMD_RESOURCE_CREATE_3D       0x0204
-#define VIRTIO_GPU_CMD_TRANSFER_TO_HOST_3D      0x0205
-#define VIRTIO_GPU_CMD_TRANSFER_FROM_HOST_3D    0x0206
-#define VIRTIO_GPU_CMD_SUBMIT_3D                0x0207
-#define VIRTIO_GPU_CMD_UPDATE_CURSOR            0x0300
-#define VIRTIO_GPU_CMD_MOVE_CURSOR              0x0301
+/*
+ * 2D device model. Resources live in host memory; guests attach backing
+ * pages, transfer damaged rectangles into the resource and flush them to
+ * the scanout framebuffer. Both copies move whole rows at a time, so a
+ * partial repaint costs one row copy per damaged line rather than an MMIO
+ * exit per pixel. Guest physical addresses in backing entries are used as
+ * identity-mapped pointers, as everywhere else in this module.
+ */
+
+#define VIRTIO_GPU_BYTES_PER_PIXEL  4
+#define VIRTIO_GPU_MAX_DIMENSION    16384
+
+/* Host-side 2D resource */
+typedef struct {
+    uint32_t id;                        /* 0 = free slot */
+    uint32_t gpu_id;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;                    /* Bytes per row */
+    uint8_t* data;                      /* Host copy of the pixels */
+    virtio_gpu_mem_entry_t* backing;    /* Guest backing pages */
+    uint32_t backing_count;
+    uint64_t backing_size;
+    uint32_t backing_hint;              /* Entry of the last backing lookup */
+    uint64_t backing_hint_start;        /* Byte offset where that entry starts */
+} virtio_gpu_resource_t;
+
+/* Scanout state */
+typedef struct {
+    uint32_t resource_id;               /* 0 = disabled */
+    virtio_gpu_rect_t r;                /* Source rectangle within the resource */
+    virtio_gpu_rect_t damage[VIRTIO_GPU_MAX_DAMAGE];
+    uint32_t damage_count;
+} virtio_gpu_scanout_t;
+
+static virtio_gpu_resource_t g_virtio_resources[VIRTIO_GPU_MAX_RESOURCES];
+static virtio_gpu_scanout_t g_virtio_scanouts[MAX_GPU_DEVICES][VIRTIO_GPU_MAX_SCANOUTS];
+
+/**
+ * Copy one row of pixels
+ * Word copies for the bulk; rows are 4-byte aligned in practice
+ */
+static void gpu_copy_row(uint8_t* dst, const uint8_t* src, uint32_t n) {
+    if ((((uintptr_t)dst ^ (uintptr_t)src) & (sizeof(uintptr_t) - 1)) == 0) {
+        while (n > 0 && ((uintptr_t)dst & (sizeof(uintptr_t) - 1))) {
+            *dst++ = *src++;
+            n--;
+        }
+        uintptr_t* dw = (uintptr_t*)dst;
+        const uintptr_t* sw = (const uintptr_t*)src;
+        while (n >= sizeof(uintptr_t) * 4) {
+            dw[0] = sw[0];
+            dw[1] = sw[1];
+            dw[2] = sw[2];
+            dw[3] = sw[3];
+            dw += 4;
+            sw += 4;
+            n -= sizeof(uintptr_t) * 4;
+        }
+        dst = (uint8_t*)dw;
+        src = (const uint8_t*)sw;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        dst[i] = src[i];
+    }
+}
+
+/**
+ * Check that a rectangle lies within width x height
+ */
+static bool virtio_gpu_rect_fits(const virtio_gpu_rect_t* r, uint32_t width, uint32_t height) {
+    return (uint64_t)r->x + r->width <= width && (uint64_t)r->y + r->height <= height;
+}
+
+/**
+ * Intersect two rectangles, returns false if they do not overlap
+ */
+static bool virtio_gpu_rect_intersect(const virtio_gpu_rect_t* a, const virtio_gpu_rect_t* b,
+                                      virtio_gpu_rect_t* out) {
+    uint32_t x0 = a->x > b->x ? a->x : b->x;
+    uint32_t y0 = a->y > b->y ? a->y : b->y;
+    uint64_t ax1 = (uint64_t)a->x + a->width, bx1 = (uint64_t)b->x + b->width;
+    uint64_t ay1 = (uint64_t)a->y + a->height, by1 = (uint64_t)b->y + b->height;
+    uint64_t x1 = ax1 < bx1 ? ax1 : bx1;
+    uint64_t y1 = ay1 < by1 ? ay1 : by1;
+    
+    if (x1 <= x0 || y1 <= y0) {
+        return false;
+    }
+    out->x = x0;
+    out->y = y0;
+    out->width = (uint32_t)(x1 - x0);
+    out->height = (uint32_t)(y1 - y0);
+    return true;
+}
+
+/**
+ * Find a live resource
+ */
+static virtio_gpu_resource_t* virtio_gpu_find_resource(uint32_t gpu_id, uint32_t resource_id) {
+    if (resource_id == 0) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < VIRTIO_GPU_MAX_RESOURCES; i++) {
+        if (g_virtio_resources[i].id == resource_id && g_virtio_resources[i].gpu_id == gpu_id) {
+            return &g_virtio_resources[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Copy bytes out of a resource's scattered backing
+ * Sequential rows usually hit the same entry, so the last entry is cached
+ */
+static bool virtio_gpu_backing_read(virtio_gpu_resource_t* res, uint64_t offset,
+                                    uint8_t* dst, uint32_t length) {
+    if (offset + length > res->backing_size) {
+        return false;
+    }
+    
+    uint32_t e = res->backing_hint;
+    uint64_t start = res->backing_hint_start;
+    if (offset < start) {
+        e = 0;
+        start = 0;
+    }
+    
+    while (length > 0) {
+        while (offset >= start + res->backing[e].length) {
+            start += res->backing[e].length;
+            e++;
+        }
+        
+        uint64_t within = offset - start;
+        uint32_t chunk = res->backing[e].length - (uint32_t)within;
+        if (chunk > length) chunk = length;
+        
+        const uint8_t* src = (const uint8_t*)(uintptr_t)(res->backing[e].addr + within);
+        gpu_copy_row(dst, src, chunk);
+        dst += chunk;
+        offset += chunk;
+        length -= chunk;
+    }
+    
+    res->backing_hint = e;
+    res->backing_hint_start = start;
+    return true;
+}
+
+/**
+ * Free a resource's backing entries
+ */
+static void virtio_gpu_detach(virtio_gpu_resource_t* res) {
+    if (res->backing) {
+        platform_free(res->backing);
+    }
+    res->backing = NULL;
+    res->backing_count = 0;
+    res->backing_size = 0;
+    res->backing_hint = 0;
+    res->backing_hint_start = 0;
+}
+
+/**
+ * Release a resource and disable any scanout showing it
+ */
+static void virtio_gpu_release(virtio_gpu_resource_t* res) {
+    for (uint32_t s = 0; s < VIRTIO_GPU_MAX_SCANOUTS; s++) {
+        if (g_virtio_scanouts[res->gpu_id][s].resource_id == res->id) {
+            g_virtio_scanouts[res->gpu_id][s].resource_id = 0;
+        }
+    }
+    virtio_gpu_detach(res);
+    if (res->data) {
+        platform_free(res->data);
+    }
+    platform_memset(res, 0, sizeof(*res));
+}
+
+/**
+ * Collapse a scanout's damage list into its bounding box
+ */
+static void virtio_gpu_collapse_damage(virtio_gpu_scanout_t* scanout) {
+    if (scanout->damage_count < 2) {
+        return;
+    }
+    
+    virtio_gpu_rect_t* box = &scanout->damage[0];
+    uint32_t x0 = box->x, y0 = box->y;
+    uint32_t x1 = box->x + box->width, y1 = box->y + box->height;
+    for (uint32_t i = 1; i < scanout->damage_count; i++) {
+        virtio_gpu_rect_t* d = &scanout->damage[i];
+        if (d->x < x0) x0 = d->x;
+        if (d->y < y0) y0 = d->y;
+        if (d->x + d->width > x1) x1 = d->x + d->width;
+        if (d->y + d->height > y1) y1 = d->y + d->height;
+    }
+    
+    box->x = x0;
+    box->y = y0;
+    box->width = x1 - x0;
+    box->height = y1 - y0;
+    scanout->damage_count = 1;
+}
+
+/**
+ * Record flushed damage for a scanout, merging on overflow
+ */
+static void virtio_gpu_add_damage(virtio_gpu_scanout_t* scanout, const virtio_gpu_rect_t* r) {
+    if (scanout->damage_count == VIRTIO_GPU_MAX_DAMAGE) {
+        virtio_gpu_collapse_damage(scanout);
+    }
+    scanout->damage[scanout->damage_count++] = *r;
+}
+
+static uint32_t virtio_gpu_cmd_display_info(gpu_device_t* gpu, virtio_gpu_resp_display_info_t* resp) {
+    platform_memset(resp->pmodes, 0, sizeof(resp->pmodes));
+    for (uint32_t i = 0; i < gpu->display_count && i < VIRTIO_GPU_MAX_SCANOUTS; i++) {
+        resp->pmodes[i].r.width = gpu->displays[i].width;
+        resp->pmodes[i].r.height = gpu->displays[i].height;
+        resp->pmodes[i].enabled = gpu->displays[i].enabled ? 1 : 0;
+    }
+    return VIRTIO_GPU_RESP_OK_DISPLAY_INFO;
+}
+
+static uint32_t virtio_gpu_cmd_create_2d(uint32_t gpu_id, const virtio_gpu_resource_create_2d_t* cmd) {
+    if (cmd->resource_id == 0 || virtio_gpu_find_resource(gpu_id, cmd->resource_id)) {
+        return VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID;
+    }
+    
+    switch (cmd->format) {
+        case VIRTIO_GPU_FORMAT_B8G8R8A8_UNORM:
+        case VIRTIO_GPU_FORMAT_B8G8R8X8_UNORM:
+        case VIRTIO_GPU_FORMAT_A8R8G8B8_UNORM:
+        case VIRTIO_GPU_FORMAT_X8R8G8B8_UNORM:
+        case VIRTIO_GPU_FORMAT_R8G8B8A8_UNORM:
+        case VIRTIO_GPU_FORMAT_X8B8G8R8_UNORM:
+        case VIRTIO_GPU_FORMAT_A8B8G8R8_UNORM:
+        case VIRTIO_GPU_FORMAT_R8G8B8X8_UNORM:
+            break;
+        default:
+            return VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER;
+    }
+    
+    if (cmd->width == 0 || cmd->height == 0 ||
+        cmd->width > VIRTIO_GPU_MAX_DIMENSION || cmd->height > VIRTIO_GPU_MAX_DIMENSION) {
+        return VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER;
+    }
+    
+    virtio_gpu_resource_t* res = NULL;
+    for (uint32_t i = 0; i < VIRTIO_GPU_MAX_RESOURCES; i++) {
+        if (g_virtio_resources[i].id == 0) {
+            res = &g_virtio_resources[i];
+            break;
+        }
+    }
+    if (!res) {
+        return VIRTIO_GPU_RESP_ERR_OUT_OF_MEMORY;
+    }
+    
+    uint32_t stride = cmd->width * VIRTIO_GPU_BYTES_PER_PIXEL;
+    res->data = (uint8_t*)platform_malloc((size_t)stride * cmd->height);
+    if (!res->data) {
+        return VIRTIO_GPU_RESP_ERR_OUT_OF_MEMORY;
+    }
+    platform_memset(res->data, 0, (size_t)stride * cmd->height);
+    
+    res->id = cmd->resource_id;
+    res->gpu_id = gpu_id;
+    res->format = cmd->format;
+    res->width = cmd->width;
+    res->height = cmd->height;
+    res->stride = stride;
+    return VIRTIO_GPU_RESP_OK_NODATA;
+}
+
+static uint32_t virtio_gpu_cmd_attach_backing(uint32_t gpu_id, const virtio_gpu_resource_attach_backing_t* cmd,
+                                              uint32_t cmd_size) {
+    virtio_gpu_resource_t* res = virtio_gpu_find_resource(gpu_id, cmd->resource_id);
+    if (!res) {
+        return VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID;
+    }
+    
+    if (cmd->nr_entries == 0 || cmd->nr_entries > VIRTIO_GPU_MAX_BACKING_ENTRIES ||
+        cmd_size < sizeof(*cmd) + cmd->nr_entries * sizeof(virtio_gpu_mem_entry_t) ||
+        res->backing) {
+        return VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER;
+    }
+    
+    const virtio_gpu_mem_entry_t* entries = (const virtio_gpu_mem_entry_t*)(cmd + 1);
+    uint32_t bytes = cmd->nr_entries * sizeof(virtio_gpu_mem_entry_t);
+    res->backing = (virtio_gpu_mem_entry_t*)platform_malloc(bytes);
+    if (!res->backing) {
+        return VIRTIO_GPU_RESP_ERR_OUT_OF_MEMORY;
+    }
+    platform_memcpy(res->backing, entries, bytes);
+    
+    res->backing_count = cmd->nr_entries;
+    res->backing_size = 0;
+    for (uint32_t i = 0; i < cmd->nr_entries; i++) {
+        res->backing_size += entries[i].length;
+    }
+    res->backing_hint = 0;
+    res->backing_hint_start = 0;
+    return VIRTIO_GPU_RESP_OK_NODATA;
+}
+
+static uint32_t virtio_gpu_cmd_transfer_to_host(uint32_t gpu_id, const virtio_gpu_transfer_to_host_2d_t* cmd) {
+    virtio_gpu_resource_t* res = virtio_gpu_find_resource(gpu_id, cmd->resource_id);
+    if (!res) {
+        return VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID;
+    }
+    if (!res->backing || !virtio_gpu_rect_fits(&cmd->r, res->width, res->height)) {
+        return VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER;
+    }
+    if (cmd->r.width == 0 || cmd->r.height == 0) {
+        return VIRTIO_GPU_RESP_OK_NODATA;
+    }
+    
+    uint32_t row_bytes = cmd->r.width * VIRTIO_GPU_BYTES_PER_PIXEL;
+    uint8_t* dst = res->data + (size_t)cmd->r.y * res->stride + cmd->r.x * VIRTIO_GPU_BYTES_PER_PIXEL;
+    
+    /* Full-width transfers are one contiguous copy */
+    if (row_bytes == res->stride) {
+        if (!virtio_gpu_backing_read(res, cmd->offset, dst, row_bytes * cmd->r.height)) {
+            return VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER;
+        }
+        return VIRTIO_GPU_RESP_OK_NODATA;
+    }
+    
+    uint64_t src = cmd->offset;
+    for (uint32_t row = 0; row < cmd->r.height; row++) {
+        if (!virtio_gpu_backing_read(res, src, dst, row_bytes)) {
+            return VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER;
+        }
+        src += res->stride;
+        dst += res->stride;
+    }
+    return VIRTIO_GPU_RESP_OK_NODATA;
+}
+
+static uint32_t virtio_gpu_cmd_set_scanout(uint32_t gpu_id, gpu_device_t* gpu,
+                                           const virtio_gpu_set_scanout_t* cmd) {
+    if (cmd->scanout_id >= VIRTIO_GPU_MAX_SCANOUTS) {
+        return VIRTIO_GPU_RESP_ERR_INVALID_SCANOUT_ID;
+    }
+    
+    virtio_gpu_scanout_t* scanout = &g_virtio_scanouts[gpu_id][cmd->scanout_id];
+    gpu_display_t* display = &gpu->displays[cmd->scanout_id];
+    
+    if (cmd->resource_id == 0) {
+        scanout->resource_id = 0;
+        display->enabled = false;
+        return VIRTIO_GPU_RESP_OK_NODATA;
+    }
+    
+    virtio_gpu_resource_t* res = virtio_gpu_find_resource(gpu_id, cmd->resource_id);
+    if (!res) {
+        return VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID;
+    }
+    if (cmd->r.width == 0 || cmd->r.height == 0 || !virtio_gpu_rect_fits(&cmd->r, res->width, res->height)) {
+        return VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER;
+    }
+    
+    scanout->resource_id = cmd->resource_id;
+    scanout->r = cmd->r;
+    scanout->damage_count = 0;
+    
+    if (cmd->scanout_id >= gpu->display_count) {
+        gpu->display_count = cmd->scanout_id + 1;
+    }
+    display->id = cmd->scanout_id;
+    display->width = cmd->r.width;
+    display->height = cmd->r.height;
+    if (display->stride < cmd->r.width * VIRTIO_GPU_BYTES_PER_PIXEL) {
+        display->stride = cmd->r.width * VIRTIO_GPU_BYTES_PER_PIXEL;
+    }
+    display->enabled = true;
+    return VIRTIO_GPU_RESP_OK_NODATA;
+}
+
+static uint32_t virtio_gpu_cmd_flush(uint32_t gpu_id, gpu_device_t* gpu,
+                                     const virtio_gpu_resource_flush_t* cmd) {
+    virtio_gpu_resource_t* res = virtio_gpu_find_resource(gpu_id, cmd->resource_id);
+    if (!res) {
+        return VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID;
+    }
+    if (!virtio_gpu_rect_fits(&cmd->r, res->width, res->height)) {
+        return VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER;
+    }
+    
+    for (uint32_t s = 0; s < VIRTIO_GPU_MAX_SCANOUTS; s++) {
+        virtio_gpu_scanout_t* scanout = &g_virtio_scanouts[gpu_id][s];
+        virtio_gpu_rect_t area;
+        if (scanout->resource_id != res->id ||
+            !virtio_gpu_rect_intersect(&cmd->r, &scanout->r, &area)) {
+            continue;
+        }
+        
+        /* Damage in scanout coordinates */
+        virtio_gpu_rect_t damage = area;
+        damage.x -= scanout->r.x;
+        damage.y -= scanout->r.y;
+        virtio_gpu_add_damage(scanout, &damage);
+        
+        gpu_display_t* display = &gpu->displays[s];
+        uint8_t* fb = (uint8_t*)(uintptr_t)display->framebuffer_addr;
+        if (!fb) {
+            continue;
+        }
+        
+        /* Clip to the framebuffer the host attached */
+        uint32_t rows = damage.height;
+        uint32_t row_bytes = damage.width * VIRTIO_GPU_BYTES_PER_PIXEL;
+        uint64_t first = (uint64_t)damage.y * display->stride + damage.x * VIRTIO_GPU_BYTES_PER_PIXEL;
+        if (first + row_bytes > display->framebuffer_size) {
+            continue;
+        }
+        uint64_t fit = (display->framebuffer_size - first - row_bytes) / display->stride + 1;
+        if (rows > fit) rows = (uint32_t)fit;
+        
+        const uint8_t* src = res->data + (size_t)area.y * res->stride + area.x * VIRTIO_GPU_BYTES_PER_PIXEL;
+        uint8_t* dst = fb + first;
+        for (uint32_t row = 0; row < rows; row++) {
+            gpu_copy_row(dst, src, row_bytes);
+            src += res->stride;
+            dst += display->stride;
+        }
+    }
+    return VIRTIO_GPU_RESP_OK_NODATA;
+}
+
+static uint32_t virtio_gpu_cmd_cursor(uint32_t gpu_id, gpu_device_t* gpu, uint32_t cmd_type,
+                                      const virtio_gpu_update_cursor_t* cmd) {
+    if (cmd->pos.scanout_id >= VIRTIO_GPU_MAX_SCANOUTS) {
+        return VIRTIO_GPU_RESP_ERR_INVALID_SCANOUT_ID;
+    }
+    
+    gpu->cursor.x = (int32_t)cmd->pos.x;
+    gpu->cursor.y = (int32_t)cmd->pos.y;
+    
+    if (cmd_type == VIRTIO_GPU_CMD_UPDATE_CURSOR) {
+        virtio_gpu_resource_t* res = virtio_gpu_find_resource(gpu_id, cmd->resource_id);
+        if (cmd->resource_id != 0 && !res) {
+            return VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID;
+        }
+        gpu->cursor.hot_x = cmd->hot_x;
+        gpu->cursor.hot_y = cmd->hot_y;
+        gpu->cursor.image = res ? res->data : NULL;
+        gpu->cursor.width = res ? res->width : 0;
+        gpu->cursor.height = res ? res->height : 0;
+        gpu->cursor.visible = (res != NULL);
+    }
+    return VIRTIO_GPU_RESP_OK_NODATA;
+}
 
 /**
  * Process VirtIO GPU command
@@ -593,39 +1030,139 @@ int gpu_wait_idle(uint32_t gpu_id) {
 int virtio_gpu_process_command(uint32_t gpu_id, uint32_t cmd_type, 
                                 void* cmd_data, uint32_t cmd_size,
                                 void* resp_data, uint32_t* resp_size) {
-    if (gpu_id >= g_gpu_count) {
+    if (gpu_id >= g_gpu_count || !cmd_data || !resp_data || !resp_size ||
+        cmd_size < sizeof(virtio_gpu_ctrl_hdr_t) || *resp_size < sizeof(virtio_gpu_ctrl_hdr_t)) {
         return -1;
     }
     
-    (void)cmd_data;
-    (void)cmd_size;
-    (void)resp_data;
-    (void)resp_size;
+    gpu_device_t* gpu = &g_gpu_devices[gpu_id];
+    const virtio_gpu_ctrl_hdr_t* hdr = (const virtio_gpu_ctrl_hdr_t*)cmd_data;
+    uint32_t resp_len = sizeof(virtio_gpu_ctrl_hdr_t);
+    uint32_t resp_type;
+    int result = 0;
     
+    /* Minimum command size for each type */
+    uint32_t need;
     switch (cmd_type) {
+        case VIRTIO_GPU_CMD_RESOURCE_CREATE_2D:      need = sizeof(virtio_gpu_resource_create_2d_t); break;
+        case VIRTIO_GPU_CMD_RESOURCE_UNREF:
+        case VIRTIO_GPU_CMD_RESOURCE_DETACH_BACKING: need = sizeof(virtio_gpu_resource_unref_t); break;
+        case VIRTIO_GPU_CMD_SET_SCANOUT:             need = sizeof(virtio_gpu_set_scanout_t); break;
+        case VIRTIO_GPU_CMD_RESOURCE_FLUSH:          need = sizeof(virtio_gpu_resource_flush_t); break;
+        case VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D:     need = sizeof(virtio_gpu_transfer_to_host_2d_t); break;
+        case VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING: need = sizeof(virtio_gpu_resource_attach_backing_t); break;
+        case VIRTIO_GPU_CMD_UPDATE_CURSOR:
+        case VIRTIO_GPU_CMD_MOVE_CURSOR:             need = sizeof(virtio_gpu_update_cursor_t); break;
+        default:                                     need = sizeof(virtio_gpu_ctrl_hdr_t); break;
+    }
+    
+    if (cmd_size < need) {
+        resp_type = VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER;
+    } else switch (cmd_type) {
         case VIRTIO_GPU_CMD_GET_DISPLAY_INFO:
-            /* Return display information */
+            if (*resp_size < sizeof(virtio_gpu_resp_display_info_t)) {
+                return -1;
+            }
+            resp_type = virtio_gpu_cmd_display_info(gpu, (virtio_gpu_resp_display_info_t*)resp_data);
+            resp_len = sizeof(virtio_gpu_resp_display_info_t);
             break;
         case VIRTIO_GPU_CMD_RESOURCE_CREATE_2D:
-            /* Create 2D resource */
+            resp_type = virtio_gpu_cmd_create_2d(gpu_id, (const virtio_gpu_resource_create_2d_t*)cmd_data);
+            break;
+        case VIRTIO_GPU_CMD_RESOURCE_UNREF: {
+            virtio_gpu_resource_t* res = virtio_gpu_find_resource(
+                gpu_id, ((const virtio_gpu_resource_unref_t*)cmd_data)->resource_id);
+            if (res) {
+                virtio_gpu_release(res);
+                resp_type = VIRTIO_GPU_RESP_OK_NODATA;
+            } else {
+                resp_type = VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID;
+            }
             break;
+        }
         case VIRTIO_GPU_CMD_SET_SCANOUT:
-            /* Set scanout */
+            resp_type = virtio_gpu_cmd_set_scanout(gpu_id, gpu, (const virtio_gpu_set_scanout_t*)cmd_data);
             break;
         case VIRTIO_GPU_CMD_RESOURCE_FLUSH:
-            /* Flush resource to display */
+            resp_type = virtio_gpu_cmd_flush(gpu_id, gpu, (const virtio_gpu_resource_flush_t*)cmd_data);
             break;
-        case VIRTIO_GPU_CMD_UPDATE_CURSOR:
-            /* Update cursor */
+        case VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D:
+            resp_type = virtio_gpu_cmd_transfer_to_host(gpu_id, (const virtio_gpu_transfer_to_host_2d_t*)cmd_data);
+            break;
+        case VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING:
+            resp_type = virtio_gpu_cmd_attach_backing(
+                gpu_id, (const virtio_gpu_resource_attach_backing_t*)cmd_data, cmd_size);
+            break;
+        case VIRTIO_GPU_CMD_RESOURCE_DETACH_BACKING: {
+            virtio_gpu_resource_t* res = virtio_gpu_find_resource(
+                gpu_id, ((const virtio_gpu_resource_unref_t*)cmd_data)->resource_id);
+            if (res) {
+                virtio_gpu_detach(res);
+                resp_type = VIRTIO_GPU_RESP_OK_NODATA;
+            } else {
+                resp_type = VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID;
+            }
             break;
+        }
+        case VIRTIO_GPU_CMD_UPDATE_CURSOR:
         case VIRTIO_GPU_CMD_MOVE_CURSOR:
-            /* Move cursor */
+            resp_type = virtio_gpu_cmd_cursor(gpu_id, gpu, cmd_type, (const virtio_gpu_update_cursor_t*)cmd_data);
             break;
         default:
-            return -1;
+            /* 3D and capset commands need virgl */
+            resp_type = VIRTIO_GPU_RESP_ERR_UNSPEC;
+            result = -1;
+            break;
     }
     
-    return 0;
+    virtio_gpu_ctrl_hdr_t* resp = (virtio_gpu_ctrl_hdr_t*)resp_data;
+    resp->type = resp_type;
+    resp->flags = hdr->flags & VIRTIO_GPU_FLAG_FENCE;
+    resp->fence_id = (hdr->flags & VIRTIO_GPU_FLAG_FENCE) ? hdr->fence_id : 0;
+    resp->ctx_id = hdr->ctx_id;
+    resp->padding = 0;
+    *resp_size = resp_len;
+    
+    return result;
+}
+
+/**
+ * Take flushed damage for a scanout
+ */
+int virtio_gpu_take_damage(uint32_t gpu_id, uint32_t scanout_id,
+                           virtio_gpu_rect_t* rects, uint32_t max) {
+    if (gpu_id >= g_gpu_count || scanout_id >= VIRTIO_GPU_MAX_SCANOUTS || (!rects && max > 0)) {
+        return -1;
+    }
+    
+    virtio_gpu_scanout_t* scanout = &g_virtio_scanouts[gpu_id][scanout_id];
+    
+    /* Merge down so the caller never loses damage */
+    if (scanout->damage_count > max && max > 0) {
+        virtio_gpu_collapse_damage(scanout);
+    }
+    
+    uint32_t count = scanout->damage_count < max ? scanout->damage_count : max;
+    for (uint32_t i = 0; i < count; i++) {
+        rects[i] = scanout->damage[i];
+    }
+    scanout->damage_count = 0;
+    return (int)count;
+}
+
+/**
+ * Release all virtio-gpu resources owned by a GPU
+ */
+void virtio_gpu_reset(uint32_t gpu_id) {
+    if (gpu_id >= MAX_GPU_DEVICES) {
+        return;
+    }
+    for (uint32_t i = 0; i < VIRTIO_GPU_MAX_RESOURCES; i++) {
+        if (g_virtio_resources[i].id != 0 && g_virtio_resources[i].gpu_id == gpu_id) {
+            virtio_gpu_release(&g_virtio_resources[i]);
+        }
+    }
+    platform_memset(g_virtio_scanouts[gpu_id], 0, sizeof(g_virtio_scanouts[gpu_id]));
 }
 
 /* ============================================================================
@@ -0,0 +1,503 @@
+/**
+ * Aurora OS - Android Boot Streaming Parser Tests
+ *
+ * Host-built harness for the streaming boot.img parser and the SHA-1/SHA-256
+ * module. Builds mkbootimg-compatible images in memory, feeds them through
+ * the stream in assorted chunk sizes and through a simulated storage device,
+ * and (with --bench) measures time-to-kernel-entry for a large image.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../kernel/android/android_boot.h"
+#include "../../kernel/security/sha.h"
+#include "../../kernel/memory/memory.h"
+#include "../../kernel/drivers/vga.h"
+#include "../../kernel/drivers/storage.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/* ---- Kernel service stubs ---- */
+
+void* kmalloc(size_t size) { return malloc(size); }
+void kfree(void* ptr) { free(ptr); }
+void vga_write(const char* str) { (void)str; }
+void vga_write_hex(uint32_t value) { (void)value; }
+void vga_write_dec(int value) { (void)value; }
+
+/* Simulated storage: one device, one bootable partition backed by memory */
+static storage_device_t g_disk;
+static uint8_t* g_disk_data = NULL;
+static uint32_t g_disk_sectors = 0;
+static uint32_t g_disk_reads = 0;
+#define PART_START_LBA 2048
+
+int storage_get_device_count(void) { return g_disk_data ? 1 : 0; }
+
+storage_device_t* storage_get_device(uint8_t index) {
+    return (index == 0 && g_disk_data) ? &g_disk : NULL;
+}
+
+int storage_read_partition_table(storage_device_t* device, storage_partition_t* partitions,
+                                 uint32_t max_partitions) {
+    (void)device;
+    if (max_partitions < 1) return 0;
+    partitions[0].bootable = 1;
+    partitions[0].type = 0x83;
+    partitions[0].start_lba = PART_START_LBA;
+    partitions[0].num_sectors = g_disk_sectors - PART_START_LBA;
+    return 1;
+}
+
+int storage_read_sectors(storage_device_t* device, uint64_t lba, uint32_t count, uint8_t* buffer) {
+    (void)device;
+    if (lba + count > g_disk_sectors) return -1;
+    memcpy(buffer, g_disk_data + lba * 512, (size_t)count * 512);
+    g_disk_reads++;
+    return 0;
+}
+
+static void disk_attach(const uint8_t* image, size_t size) {
+    g_disk_sectors = PART_START_LBA + (uint32_t)((size + 511) / 512);
+    g_disk_data = calloc(g_disk_sectors, 512);
+    memcpy(g_disk_data + (size_t)PART_START_LBA * 512, image, size);
+    memset(&g_disk, 0, sizeof(g_disk));
+    g_disk.status = STORAGE_STATUS_ONLINE;
+    g_disk.sector_size = 512;
+    strcpy(g_disk.model, "hostdisk");
+    g_disk_reads = 0;
+}
+
+static void disk_detach(void) {
+    free(g_disk_data);
+    g_disk_data = NULL;
+}
+
+/* ---- Image builder ---- */
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static size_t align_up(size_t v, size_t a) {
+    return (v + a - 1) / a * a;
+}
+
+static void fill_pattern(uint8_t* p, size_t n, uint32_t seed) {
+    uint32_t x = seed * 2654435761u + 1;
+    for (size_t i = 0; i < n; i++) {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        p[i] = (uint8_t)x;
+    }
+}
+
+static void id_fold(sha1_ctx_t* ctx, const uint8_t* data, uint32_t size) {
+    uint8_t le[4] = { (uint8_t)size, (uint8_t)(size >> 8), (uint8_t)(size >> 16), (uint8_t)(size >> 24) };
+    if (size) sha1_update(ctx, data, size);
+    sha1_update(ctx, le, 4);
+}
+
+/**
+ * Build a v2 boot image the way mkbootimg lays it out:
+ * header page, kernel, ramdisk, second, recovery DTBO, DTB
+ */
+static uint8_t* build_v2_image(uint32_t kernel_size, uint32_t ramdisk_size,
+                               uint32_t dtb_size, uint32_t page_size, size_t* out_size) {
+    size_t off_kernel = page_size;
+    size_t off_ramdisk = off_kernel + align_up(kernel_size, page_size);
+    size_t off_dtb = off_ramdisk + align_up(ramdisk_size, page_size);
+    size_t total = off_dtb + align_up(dtb_size, page_size);
+    uint8_t* img = calloc(1, total);
+
+    fill_pattern(img + off_kernel, kernel_size, 1);
+    fill_pattern(img + off_ramdisk, ramdisk_size, 2);
+    fill_pattern(img + off_dtb, dtb_size, 3);
+
+    boot_img_hdr_v0_t* hdr = (boot_img_hdr_v0_t*)img;
+    memcpy(hdr->magic, BOOT_MAGIC, BOOT_MAGIC_SIZE);
+    hdr->kernel_size = kernel_size;
+    hdr->kernel_addr = 0x10008000;
+    hdr->ramdisk_size = ramdisk_size;
+    hdr->ramdisk_addr = 0x11000000;
+    hdr->page_size = page_size;
+    hdr->header_version = 2;
+    hdr->os_version = (11u << 25) | (0u << 18) | (0u << 11) | ((21u) << 4) | 6u;
+    strcpy((char*)hdr->cmdline, "console=ttyS0 androidboot.hardware=aurora");
+    hdr->header_size = sizeof(boot_img_hdr_v0_t);
+    hdr->dtb_size = dtb_size;
+    hdr->dtb_addr = 0x11f00000;
+
+    sha1_ctx_t ctx;
+    uint8_t digest[SHA1_DIGEST_SIZE];
+    sha1_init(&ctx);
+    id_fold(&ctx, img + off_kernel, kernel_size);
+    id_fold(&ctx, img + off_ramdisk, ramdisk_size);
+    id_fold(&ctx, NULL, 0);     /* second */
+    id_fold(&ctx, NULL, 0);     /* recovery DTBO */
+    id_fold(&ctx, img + off_dtb, dtb_size);
+    sha1_final(&ctx, digest);
+    memcpy(hdr->id, digest, SHA1_DIGEST_SIZE);
+
+    *out_size = total;
+    return img;
+}
+
+static uint8_t* build_v4_image(uint32_t kernel_size, uint32_t ramdisk_size,
+                               uint32_t signature_size, size_t* out_size) {
+    size_t off_kernel = 4096;
+    size_t off_ramdisk = off_kernel + align_up(kernel_size, 4096);
+    size_t off_sig = off_ramdisk + align_up(ramdisk_size, 4096);
+    size_t total = off_sig + align_up(signature_size, 4096);
+    uint8_t* img = calloc(1, total);
+
+    fill_pattern(img + off_kernel, kernel_size, 4);
+    fill_pattern(img + off_ramdisk, ramdisk_size, 5);
+    fill_pattern(img + off_sig, signature_size, 6);
+
+    boot_img_hdr_v4_t* hdr = (boot_img_hdr_v4_t*)img;
+    memcpy(hdr->magic, BOOT_MAGIC, BOOT_MAGIC_SIZE);
+    hdr->kernel_size = kernel_size;
+    hdr->ramdisk_size = ramdisk_size;
+    hdr->header_size = sizeof(boot_img_hdr_v4_t);
+    hdr->header_version = 4;
+    hdr->signature_size = signature_size;
+
+    *out_size = total;
+    return img;
+}
+
+/* Feed an image through a stream in fixed-size chunks */
+static int stream_image(const uint8_t* img, size_t size, size_t chunk,
+                        android_boot_info_t* info, android_boot_stream_t* stream, uint32_t flags) {
+    android_boot_stream_init(stream, info, flags);
+    for (size_t off = 0; off < size; off += chunk) {
+        size_t n = size - off < chunk ? size - off : chunk;
+        int result = android_boot_stream_feed(stream, img + off, n);
+        if (result != BOOT_PARSE_SUCCESS) return result;
+    }
+    return android_boot_stream_finish(stream);
+}
+
+/* ---- Tests ---- */
+
+static int hex_equals(const uint8_t* digest, const char* hex) {
+    char buf[65];
+    size_t n = strlen(hex) / 2;
+    for (size_t i = 0; i < n; i++) sprintf(buf + i * 2, "%02x", digest[i]);
+    return memcmp(buf, hex, n * 2) == 0;
+}
+
+static void test_sha_vectors(void) {
+    printf("\n=== SHA-1 / SHA-256 Known Answers ===\n");
+    const char* msg = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    uint32_t modes[2] = { SHA_ACCEL_NONE, ~0u };
+
+    for (int m = 0; m < 2; m++) {
+        uint32_t accel = sha_set_accel(modes[m]);
+        uint8_t d[SHA256_DIGEST_SIZE];
+        char label[96];
+
+        sha1("abc", 3, d);
+        snprintf(label, sizeof(label), "SHA-1(\"abc\") [accel=%u]", accel);
+        TEST_ASSERT(hex_equals(d, "a9993e364706816aba3e25717850c26c9cd0d89d"), label);
+
+        sha256("abc", 3, d);
+        snprintf(label, sizeof(label), "SHA-256(\"abc\") [accel=%u]", accel);
+        TEST_ASSERT(hex_equals(d, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"), label);
+
+        sha256(msg, strlen(msg), d);
+        snprintf(label, sizeof(label), "SHA-256(448-bit message) [accel=%u]", accel);
+        TEST_ASSERT(hex_equals(d, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"), label);
+
+        sha1(msg, strlen(msg), d);
+        snprintf(label, sizeof(label), "SHA-1(448-bit message) [accel=%u]", accel);
+        TEST_ASSERT(hex_equals(d, "84983e441c3bd26ebaae4aa1f95129e5e54670f1"), label);
+    }
+
+    /* Scalar and accelerated paths agree on odd-sized incremental input */
+    size_t n = 1000003;
+    uint8_t* data = malloc(n);
+    fill_pattern(data, n, 99);
+    uint8_t a1[SHA1_DIGEST_SIZE], b1[SHA1_DIGEST_SIZE];
+    uint8_t a2[SHA256_DIGEST_SIZE], b2[SHA256_DIGEST_SIZE];
+
+    sha_set_accel(SHA_ACCEL_NONE);
+    sha1(data, n, a1);
+    sha256(data, n, a2);
+
+    sha_set_accel(~0u);
+    sha1_ctx_t c1;
+    sha256_ctx_t c2;
+    sha1_init(&c1);
+    sha256_init(&c2);
+    for (size_t off = 0; off < n; off += 777) {
+        size_t len = n - off < 777 ? n - off : 777;
+        sha1_update(&c1, data + off, len);
+        sha256_update(&c2, data + off, len);
+    }
+    sha1_final(&c1, b1);
+    sha256_final(&c2, b2);
+    TEST_ASSERT(memcmp(a1, b1, sizeof(a1)) == 0, "SHA-1 incremental matches one-shot across implementations");
+    TEST_ASSERT(memcmp(a2, b2, sizeof(a2)) == 0, "SHA-256 incremental matches one-shot across implementations");
+    free(data);
+}
+
+static void test_legacy_parse(void) {
+    printf("\n=== In-Memory Parse ===\n");
+    size_t size;
+    uint8_t* img = build_v2_image(100003, 54321, 7777, 4096, &size);
+    android_boot_info_t info;
+
+    TEST_ASSERT(android_boot_parse(img, size, &info) == BOOT_PARSE_SUCCESS, "parse v2 image");
+    TEST_ASSERT(info.dtb_data == img + 4096 + align_up(100003, 4096) + align_up(54321, 4096),
+                "DTB located after ramdisk");
+    TEST_ASSERT(android_boot_validate_checksum(img, size, &info) == BOOT_PARSE_SUCCESS,
+                "mkbootimg image id validates");
+
+    img[4096 + 10] ^= 0x40;
+    TEST_ASSERT(android_boot_validate_checksum(img, size, &info) == BOOT_PARSE_CHECKSUM_ERROR,
+                "corrupted kernel byte detected");
+    free(img);
+}
+
+static void test_stream_chunks(void) {
+    printf("\n=== Streaming Parse ===\n");
+    size_t size;
+    uint8_t* img = build_v2_image(100003, 54321, 7777, 2048, &size);
+    size_t chunks[] = { 1, 7, 512, 4096, 65536, size };
+    int all_ok = 1;
+
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        android_boot_info_t info;
+        android_boot_stream_t stream;
+        int result = stream_image(img, size, chunks[c], &info, &stream,
+                                  BOOT_STREAM_VERIFY_ID | BOOT_STREAM_SECTION_DIGESTS);
+        int ok = result == BOOT_PARSE_SUCCESS &&
+                 memcmp(info.kernel_data, img + 2048, 100003) == 0 &&
+                 memcmp(info.ramdisk_data, img + 2048 + align_up(100003, 2048), 54321) == 0;
+
+        uint8_t expect[SHA256_DIGEST_SIZE], got[SHA256_DIGEST_SIZE];
+        sha256(info.dtb_data, info.dtb_size, expect);
+        ok = ok && android_boot_stream_get_digest(&stream, BOOT_SECTION_DTB, got) == BOOT_PARSE_SUCCESS &&
+             memcmp(expect, got, sizeof(got)) == 0;
+        if (!ok) {
+            printf("    chunk size %zu failed (result %d)\n", chunks[c], result);
+            all_ok = 0;
+        }
+        android_boot_free(&info);
+    }
+    TEST_ASSERT(all_ok, "sections placed and hashed for chunk sizes 1..whole image");
+
+    /* Corruption in the ramdisk fails id verification */
+    android_boot_info_t info;
+    android_boot_stream_t stream;
+    img[2048 + align_up(100003, 2048) + 5] ^= 1;
+    TEST_ASSERT(stream_image(img, size, 4096, &info, &stream, BOOT_STREAM_VERIFY_ID) ==
+                BOOT_PARSE_CHECKSUM_ERROR, "corrupted ramdisk rejected");
+    android_boot_stream_abort(&stream);
+    img[2048 + align_up(100003, 2048) + 5] ^= 1;
+
+    /* Truncated image is reported as incomplete */
+    android_boot_stream_init(&stream, &info, BOOT_STREAM_VERIFY_ID);
+    android_boot_stream_feed(&stream, img, size / 2);
+    size_t image_end = 2048 + align_up(100003, 2048) + align_up(54321, 2048) + 7777;
+    TEST_ASSERT(android_boot_stream_remaining(&stream) == image_end - size / 2, "remaining bytes tracked");
+    TEST_ASSERT(android_boot_stream_finish(&stream) == BOOT_PARSE_INCOMPLETE, "truncated image incomplete");
+    android_boot_stream_abort(&stream);
+
+    /* Bad magic */
+    img[0] = 'X';
+    TEST_ASSERT(stream_image(img, size, 4096, &info, &stream, 0) == BOOT_PARSE_INVALID_MAGIC,
+                "invalid magic rejected");
+    free(img);
+}
+
+static int g_kernel_cb_section = -1;
+static uint64_t g_kernel_ready_ns = 0;
+
+static void on_section(int section, const void* data, uint32_t size, void* context) {
+    (void)data; (void)size; (void)context;
+    if (section == BOOT_SECTION_KERNEL) {
+        g_kernel_cb_section = section;
+        g_kernel_ready_ns = now_ns();
+    }
+}
+
+static void test_stream_v4_placement(void) {
+    printf("\n=== Streaming v4 With Caller Placement ===\n");
+    size_t size;
+    uint8_t* img = build_v4_image(300000, 200000, 4096, &size);
+    uint8_t* load = malloc(300000);
+    android_boot_info_t info;
+    android_boot_stream_t stream;
+
+    android_boot_stream_init(&stream, &info, BOOT_STREAM_SECTION_DIGESTS);
+    TEST_ASSERT(android_boot_stream_set_dest(&stream, BOOT_SECTION_KERNEL, load, 300000) ==
+                BOOT_PARSE_SUCCESS, "kernel placement buffer accepted");
+    android_boot_stream_set_callback(&stream, on_section, NULL);
+    g_kernel_cb_section = -1;
+    for (size_t off = 0; off < size; off += 65536) {
+        android_boot_stream_feed(&stream, img + off, size - off < 65536 ? size - off : 65536);
+    }
+    TEST_ASSERT(android_boot_stream_finish(&stream) == BOOT_PARSE_SUCCESS, "v4 stream finishes");
+    TEST_ASSERT(info.kernel_data == load && memcmp(load, img + 4096, 300000) == 0,
+                "kernel placed directly into load buffer");
+    TEST_ASSERT(info.signature_size == 4096 && info.signature_data != NULL, "signature section captured");
+    TEST_ASSERT(g_kernel_cb_section == BOOT_SECTION_KERNEL, "kernel completion callback fired");
+    TEST_ASSERT((info.owned_sections & (1u << BOOT_SECTION_KERNEL)) == 0, "caller buffer not owned");
+    android_boot_free(&info);
+    free(load);
+    free(img);
+}
+
+static void test_load_from_device(void) {
+    printf("\n=== Load From Storage ===\n");
+    size_t size;
+    uint8_t* img = build_v2_image(1 << 20, 700001, 4097, 4096, &size);
+    android_boot_info_t info;
+
+    disk_attach(img, size);
+    TEST_ASSERT(android_boot_load_from_device("hostdisk", NULL, &info) == BOOT_PARSE_SUCCESS,
+                "boot image streamed from device");
+    TEST_ASSERT(info.kernel_size == (1 << 20) && memcmp(info.kernel_data, img + 4096, 1 << 20) == 0,
+                "kernel contents match");
+    TEST_ASSERT(g_disk_reads == (size + BOOT_STREAM_CHUNK_SIZE - 1) / BOOT_STREAM_CHUNK_SIZE,
+                "image read in chunk-sized requests");
+    android_boot_free(&info);
+    disk_detach();
+
+    img[4096 + align_up(1 << 20, 4096) + align_up(700001, 4096) + 4096] ^= 0xFF;  /* last DTB byte */
+    disk_attach(img, size);
+    TEST_ASSERT(android_boot_load_from_device("hostdisk", NULL, &info) == BOOT_PARSE_CHECKSUM_ERROR,
+                "corrupted image rejected by loader");
+    disk_detach();
+    free(img);
+}
+
+/* ---- Benchmark ---- */
+
+/*
+ * Time-to-kernel-entry: from the first storage read until kernel, ramdisk
+ * and DTB are placed and the image id is verified.
+ * Legacy: read whole image, parse, SHA-1 verify, copy sections out.
+ */
+static void bench_time_to_entry(void) {
+    const uint32_t kernel_size = 40u << 20;
+    const uint32_t ramdisk_size = 24u << 20;
+    const uint32_t dtb_size = 512u << 10;
+    const int iterations = 5;
+    size_t size;
+    uint8_t* img = build_v2_image(kernel_size, ramdisk_size, dtb_size, 4096, &size);
+    uint8_t* kernel_load = malloc(kernel_size);
+    uint8_t* ramdisk_load = malloc(ramdisk_size);
+    uint8_t* dtb_load = malloc(dtb_size);
+    uint8_t* staging = malloc(size);
+    uint8_t* chunk = malloc(BOOT_STREAM_CHUNK_SIZE);
+
+    /* Fault everything in before timing */
+    memset(kernel_load, 0, kernel_size);
+    memset(ramdisk_load, 0, ramdisk_size);
+    memset(dtb_load, 0, dtb_size);
+    memset(staging, 0, size);
+    disk_attach(img, size);
+
+    printf("\n=== Benchmark: time-to-kernel-entry (%.1f MB v2 image) ===\n", size / 1048576.0);
+
+    uint32_t accel_modes[2] = { SHA_ACCEL_NONE, ~0u };
+    for (int m = 0; m < 2; m++) {
+        uint32_t accel = sha_set_accel(accel_modes[m]);
+        uint64_t legacy_best = ~0ull, stream_best = ~0ull, kernel_best = ~0ull;
+
+        for (int it = 0; it < iterations; it++) {
+            /* Legacy: stage whole image, then parse/verify/extract */
+            uint64_t t0 = now_ns();
+            storage_read_sectors(&g_disk, PART_START_LBA, (uint32_t)((size + 511) / 512), staging);
+            android_boot_info_t info;
+            android_boot_parse(staging, size, &info);
+            int ok = android_boot_validate_checksum(staging, size, &info) == BOOT_PARSE_SUCCESS;
+            android_boot_extract_kernel(&info, kernel_load, kernel_size);
+            android_boot_extract_ramdisk(&info, ramdisk_load, ramdisk_size);
+            android_boot_extract_dtb(&info, dtb_load, dtb_size);
+            uint64_t t1 = now_ns();
+            if (!ok) printf("  legacy verification failed!\n");
+            if (t1 - t0 < legacy_best) legacy_best = t1 - t0;
+
+            /* Streaming: chunked reads placed straight at load buffers */
+            android_boot_stream_t stream;
+            t0 = now_ns();
+            android_boot_stream_init(&stream, &info, BOOT_STREAM_VERIFY_ID);
+            android_boot_stream_set_dest(&stream, BOOT_SECTION_KERNEL, kernel_load, kernel_size);
+            android_boot_stream_set_dest(&stream, BOOT_SECTION_RAMDISK, ramdisk_load, ramdisk_size);
+            android_boot_stream_set_dest(&stream, BOOT_SECTION_DTB, dtb_load, dtb_size);
+            android_boot_stream_set_callback(&stream, on_section, NULL);
+            uint64_t lba = PART_START_LBA;
+            uint64_t remaining;
+            while ((remaining = android_boot_stream_remaining(&stream)) > 0) {
+                uint32_t count = BOOT_STREAM_CHUNK_SIZE / 512;
+                if (stream.header_parsed && (remaining + 511) / 512 < count) {
+                    count = (uint32_t)((remaining + 511) / 512);
+                }
+                storage_read_sectors(&g_disk, lba, count, chunk);
+                android_boot_stream_feed(&stream, chunk, (size_t)count * 512);
+                lba += count;
+            }
+            ok = android_boot_stream_finish(&stream) == BOOT_PARSE_SUCCESS;
+            t1 = now_ns();
+            if (!ok) printf("  stream verification failed!\n");
+            if (t1 - t0 < stream_best) stream_best = t1 - t0;
+            if (g_kernel_ready_ns - t0 < kernel_best) kernel_best = g_kernel_ready_ns - t0;
+        }
+
+        printf("  SHA accel=%u  legacy: %7.2f ms   streaming: %7.2f ms (kernel placed at %6.2f ms)   speedup %.2fx\n",
+               accel, legacy_best / 1e6, stream_best / 1e6, kernel_best / 1e6,
+               (double)legacy_best / (double)stream_best);
+    }
+
+    disk_detach();
+    free(chunk);
+    free(staging);
+    free(dtb_load);
+    free(ramdisk_load);
+    free(kernel_load);
+    free(img);
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("========================================\n");
+    printf("Android Boot Streaming Parser Tests\n");
+    printf("========================================\n");
+
+    test_sha_vectors();
+    sha_set_accel(~0u);
+    test_legacy_parse();
+    test_stream_chunks();
+    test_stream_v4_placement();
+    test_load_from_device();
+
+    if (bench) {
+        bench_time_to_entry();
+    }
+
+    printf("\n========================================\n");
+    printf("Passed: %d  Failed: %d\n", tests_passed, tests_failed);
+    printf("========================================\n");
+    return tests_failed == 0 ? 0 : 1;
+}
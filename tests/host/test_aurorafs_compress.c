@@ -0,0 +1,604 @@
+/**
+ * Aurora OS - AuroraFS Compression Tests
+ *
+ * Host-built harness for the AuroraFS LZ4 and entropy-mode codecs and
+ * compressed extents on a memory-backed volume: a hand-built LZ4 block
+ * decoding to the reference output, round trips of structured and random
+ * data at every small size and thousands of fuzzed inputs, decoders
+ * rejecting corrupted and truncated input without writing past their
+ * output, the incompressible-data heuristic, and extents stored in fewer
+ * blocks, falling back to raw, rewritten in part and recompressed cold.
+ * With --bench, compress and decompress MB/s and ratio for both codecs
+ * on a corpus of kernel sources, this harness's own binary, and random
+ * data.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include "../../filesystem/aurorafs/aurorafs.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/* ---- Kernel service stubs ---- */
+
+void* kmalloc(size_t size) {
+    return malloc(size);
+}
+
+void kfree(void* ptr) {
+    free(ptr);
+}
+
+uint32_t smp_get_current_cpu_id(void) {
+    return 0;
+}
+
+void cpu_relax(void) {
+    sched_yield();
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static const uint32_t algorithms[2] = { AURORAFS_COMPRESS_LZ4, AURORAFS_COMPRESS_ZSTD };
+static const char* algorithm_names[2] = { "LZ4", "entropy" };
+
+/* ---- Test data ---- */
+
+static void fill_random(uint8_t* p, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        p[i] = (uint8_t)rng();
+    }
+}
+
+/* Words from a small vocabulary: compresses like text */
+static void fill_text(uint8_t* p, size_t n) {
+    static const char* words[] = {
+        "the ", "kernel ", "block ", "extent ", "inode ", "write ", "read ", "cache ",
+        "page ", "of ", "and ", "to ", "a ", "is ", "device ", "volume\n"
+    };
+    size_t at = 0;
+    while (at < n) {
+        const char* w = words[rng() % 16];
+        size_t len = strlen(w);
+        for (size_t i = 0; i < len && at < n; i++) {
+            p[at++] = (uint8_t)w[i];
+        }
+    }
+}
+
+/* A mix of literal runs, copies from random offsets and byte runs, the
+ * shapes that reach every branch of the match finders and decoders */
+static void fill_mixed(uint8_t* p, size_t n) {
+    size_t at = 0;
+    while (at < n) {
+        size_t len = 1 + rng() % 300;
+        if (len > n - at) {
+            len = n - at;
+        }
+        switch (rng() % 4) {
+            case 0:
+                fill_random(p + at, len);
+                break;
+            case 1:
+                if (at > 0) {
+                    size_t offset = 1 + rng() % (at < 70000 ? at : 70000);
+                    for (size_t i = 0; i < len; i++) {
+                        p[at + i] = p[at + i - offset];
+                    }
+                    break;
+                }
+                /* fall through */
+            case 2:
+                memset(p + at, (int)(rng() & 0xFF), len);
+                break;
+            default:
+                fill_text(p + at, len);
+                break;
+        }
+        at += len;
+    }
+}
+
+static int round_trip(const uint8_t* data, size_t n, uint32_t algorithm, size_t* packed_size) {
+    uint8_t* packed = malloc(n + 1);
+    uint8_t* out = malloc(n + 16);
+    size_t size = 0;
+    int result = aurorafs_compress_block(data, n, packed, &size, algorithm);
+    if (result == 0) {
+        memset(out, 0xA5, n + 16);
+        result = (size < n &&
+                  aurorafs_decompress_block(packed, size, out, n, algorithm) == 0 &&
+                  memcmp(out, data, n) == 0 && out[n] == 0xA5) ? 1 : -2;
+    }
+    if (packed_size) {
+        *packed_size = size;
+    }
+    free(packed);
+    free(out);
+    return result;             /* 1 ok, -1 did not compress, -2 wrong */
+}
+
+/* ---- Codecs ---- */
+
+static void test_lz4_format(void) {
+    printf("\nLZ4 block format:\n");
+
+    /* "abc", a 21-byte match at offset 3 (4 + 15 + 2), then 5 final literals */
+    static const uint8_t block[] = {
+        0x3F, 'a', 'b', 'c', 0x03, 0x00, 0x02,
+        0x50, 'x', 'y', 'z', 'z', 'y'
+    };
+    const char* expect = "abcabcabcabcabcabcabcabcxyzzy";
+    uint8_t out[29];
+    TEST_ASSERT(aurorafs_decompress_block(block, sizeof(block), out, 29, AURORAFS_COMPRESS_LZ4) == 0 &&
+                memcmp(out, expect, 29) == 0, "Reference block decodes");
+    TEST_ASSERT(aurorafs_decompress_block(block, sizeof(block), out, 28, AURORAFS_COMPRESS_LZ4) == -1,
+                "Output size must match exactly");
+
+    uint8_t zeros[4096] = {0};
+    uint8_t packed[4096];
+    size_t size = 0;
+    TEST_ASSERT(aurorafs_compress_block(zeros, 4096, packed, &size, AURORAFS_COMPRESS_LZ4) == 0 &&
+                size < 32, "4 KB of zeros packs into a few bytes");
+    TEST_ASSERT(packed[size - 6] == 0x50 && size >= 6, "Ends in 5 literal bytes, as LZ4 requires");
+
+    TEST_ASSERT(aurorafs_compress_block(zeros, 0, packed, &size, AURORAFS_COMPRESS_LZ4) == -1,
+                "Empty input does not compress");
+    TEST_ASSERT(aurorafs_compress_block(zeros, 4096, packed, &size, AURORAFS_COMPRESS_LZMA) == -1 &&
+                aurorafs_decompress_block(packed, 10, zeros, 4096, AURORAFS_COMPRESS_LZMA) == -1,
+                "LZMA is refused, not faked");
+}
+
+static void test_round_trips(void) {
+    printf("\nRound trips:\n");
+
+    uint8_t* data = malloc(1 << 20);
+    for (int a = 0; a < 2; a++) {
+        char msg[96];
+        int ok = 1;
+        size_t packed;
+
+        /* Every small size, where the end-of-block rules bite */
+        for (size_t n = 1; n <= 300 && ok; n++) {
+            memset(data, 'q', n);
+            int r = round_trip(data, n, algorithms[a], NULL);
+            ok = (r == 1 || r == -1);
+            fill_mixed(data, n);
+            r = round_trip(data, n, algorithms[a], NULL);
+            ok &= (r == 1 || r == -1);
+        }
+        snprintf(msg, sizeof(msg), "%s: sizes 1-300 round trip", algorithm_names[a]);
+        TEST_ASSERT(ok, msg);
+
+        fill_text(data, 65536);
+        ok = round_trip(data, 65536, algorithms[a], &packed) == 1;
+        snprintf(msg, sizeof(msg), "%s: 64 KB of text to %.0f%%", algorithm_names[a],
+                 100.0 * (double)packed / 65536);
+        TEST_ASSERT(ok && packed < 65536 / 2, msg);
+
+        fill_random(data, 65536);
+        snprintf(msg, sizeof(msg), "%s: random data does not compress", algorithm_names[a]);
+        TEST_ASSERT(round_trip(data, 65536, algorithms[a], NULL) == -1, msg);
+
+        /* Matches reaching back across the 64 KB window */
+        fill_random(data, 40000);
+        memcpy(data + 40000, data, 40000);
+        memcpy(data + 80000, data + 10000, 30000);
+        ok = round_trip(data, 110000, algorithms[a], &packed) == 1;
+        snprintf(msg, sizeof(msg), "%s: long-distance repeats packed to %zu bytes",
+                 algorithm_names[a], packed);
+        TEST_ASSERT(ok && packed < 45000, msg);
+
+        /* Long runs need multi-byte length fields */
+        memset(data, 7, 1 << 20);
+        ok = round_trip(data, 1 << 20, algorithms[a], &packed) == 1;
+        snprintf(msg, sizeof(msg), "%s: 1 MB run packed to %zu bytes", algorithm_names[a], packed);
+        TEST_ASSERT(ok, msg);
+    }
+    free(data);
+}
+
+static void test_fuzz(void) {
+    printf("\nFuzz:\n");
+
+    const size_t max = 20000;
+    uint8_t* data = malloc(max);
+    uint8_t* packed = malloc(max);
+    uint8_t* out = malloc(max + 64);
+
+    for (int a = 0; a < 2; a++) {
+        char msg[96];
+        int ok = 1;
+        uint32_t compressed = 0;
+        for (int iter = 0; iter < 3000 && ok; iter++) {
+            size_t n = 1 + rng() % max;
+            fill_mixed(data, n);
+            int r = round_trip(data, n, algorithms[a], NULL);
+            ok = (r == 1 || r == -1);
+            compressed += (r == 1);
+        }
+        snprintf(msg, sizeof(msg), "%s: 3000 mixed inputs round trip (%u compressed)",
+                 algorithm_names[a], compressed);
+        TEST_ASSERT(ok && compressed > 1500, msg);
+
+        /* Corrupt compressed data: the decoder must fail or produce some
+         * output, but never write past the buffer or crash */
+        uint32_t rejected = 0;
+        ok = 1;
+        for (int iter = 0; iter < 3000 && ok; iter++) {
+            size_t n = 64 + rng() % 8000;
+            size_t size = 0;
+            fill_mixed(data, n);
+            if (aurorafs_compress_block(data, n, packed, &size, algorithms[a]) != 0) {
+                continue;
+            }
+            int flips = 1 + (int)(rng() % 4);
+            for (int f = 0; f < flips; f++) {
+                packed[rng() % size] ^= (uint8_t)(1u << (rng() % 8));
+            }
+            if (rng() % 4 == 0) {
+                size = rng() % size;
+            }
+            memset(out + n, 0x5A, 64);
+            if (aurorafs_decompress_block(packed, size, out, n, algorithms[a]) != 0) {
+                rejected++;
+            }
+            for (int g = 0; g < 64; g++) {
+                ok &= out[n + g] == 0x5A;
+            }
+        }
+        snprintf(msg, sizeof(msg), "%s: corrupted input stays in bounds (%u rejected)",
+                 algorithm_names[a], rejected);
+        TEST_ASSERT(ok && rejected > 0, msg);
+
+        /* Pure garbage */
+        ok = 1;
+        for (int iter = 0; iter < 3000 && ok; iter++) {
+            size_t size = rng() % 512;
+            size_t n = 1 + rng() % 4096;
+            fill_random(packed, size);
+            memset(out + n, 0x5A, 64);
+            aurorafs_decompress_block(packed, size, out, n, algorithms[a]);
+            for (int g = 0; g < 64; g++) {
+                ok &= out[n + g] == 0x5A;
+            }
+        }
+        snprintf(msg, sizeof(msg), "%s: random garbage stays in bounds", algorithm_names[a]);
+        TEST_ASSERT(ok, msg);
+    }
+
+    free(data);
+    free(packed);
+    free(out);
+}
+
+static void test_heuristic(void) {
+    printf("\nIncompressible data heuristic:\n");
+
+    uint8_t* data = malloc(1 << 20);
+    fill_random(data, 1 << 20);
+    TEST_ASSERT(!aurorafs_compress_worthwhile(data, 1 << 20), "Random data skipped");
+
+    size_t packed = 0;
+    uint8_t* out = malloc(1 << 20);
+    fill_text(data, 1 << 20);
+    aurorafs_compress_block(data, 1 << 20, out, &packed, AURORAFS_COMPRESS_ZSTD);
+    TEST_ASSERT(!aurorafs_compress_worthwhile(out, packed), "Already compressed data skipped");
+
+    TEST_ASSERT(aurorafs_compress_worthwhile(data, 1 << 20), "Text worth compressing");
+    memset(data, 0, 4096);
+    TEST_ASSERT(aurorafs_compress_worthwhile(data, 4096), "Zeros worth compressing");
+    fill_mixed(data, 1 << 20);
+    TEST_ASSERT(aurorafs_compress_worthwhile(data, 1 << 20), "Mixed data worth compressing");
+    free(data);
+    free(out);
+}
+
+/* ---- Compressed extents ---- */
+
+#define BS          AURORAFS_BLOCK_SIZE
+#define DEV_BLOCKS  8192
+
+typedef struct {
+    uint64_t blocks;
+    uint8_t* data;
+} mem_dev_t;
+
+static mem_dev_t mem;
+static aurorafs_device_t mem_device;
+
+static int mem_read(void* ctx, uint64_t block, void* data, uint32_t count) {
+    mem_dev_t* dev = (mem_dev_t*)ctx;
+    if (block + count > dev->blocks) {
+        return -1;
+    }
+    memcpy(data, dev->data + block * BS, (size_t)count * BS);
+    return 0;
+}
+
+static int mem_write(void* ctx, uint64_t block, const void* data, uint32_t count) {
+    mem_dev_t* dev = (mem_dev_t*)ctx;
+    if (block + count > dev->blocks) {
+        return -1;
+    }
+    memcpy(dev->data + block * BS, data, (size_t)count * BS);
+    return 0;
+}
+
+static aurorafs_extent_t hole(uint64_t blocks) {
+    aurorafs_extent_t extent;
+    memset(&extent, 0, sizeof(extent));
+    extent.length = blocks;
+    return extent;
+}
+
+static int extent_is(aurorafs_mount_t* mount, const aurorafs_extent_t* extent, const uint8_t* expect) {
+    size_t bytes = extent->length * BS;
+    uint8_t* got = malloc(bytes);
+    int ok = aurorafs_read_extent(mount, extent, got, 0, bytes) == (int)bytes &&
+             memcmp(got, expect, bytes) == 0;
+    free(got);
+    return ok;
+}
+
+static void test_extents(void) {
+    printf("\nCompressed extents:\n");
+
+    memset(mem.data, 0, (size_t)mem.blocks * BS);
+    aurorafs_format("mem0", mem.blocks * BS, AURORAFS_FEAT_COMPRESS);
+    TEST_ASSERT(aurorafs_mount_device("mem0", NULL) == 0, "Mount a compressed volume");
+    aurorafs_mount_t* mount = aurorafs_get_mount();
+    uint64_t free0 = mount->superblock->free_blocks;
+
+    const uint64_t blocks = 32;
+    const size_t bytes = blocks * BS;
+    uint8_t* text = malloc(bytes);
+    uint8_t* noise = malloc(bytes);
+    fill_text(text, bytes);
+    fill_random(noise, bytes);
+
+    aurorafs_extent_t a = hole(blocks);
+    TEST_ASSERT(aurorafs_write_extent(mount, &a, text, 0, bytes) == (int)bytes, "Write 128 KB of text");
+    uint64_t used = free0 - mount->superblock->free_blocks;
+    char msg[96];
+    snprintf(msg, sizeof(msg), "Stored LZ4 in %lu of 32 blocks", (unsigned long)used);
+    TEST_ASSERT((a.flags & AURORAFS_EXTENT_LZ4) && used < blocks / 2 &&
+                used == (a.compressed_size + BS - 1) / BS, msg);
+    TEST_ASSERT(extent_is(mount, &a, text), "Reads back");
+
+    uint8_t part[300];
+    TEST_ASSERT(aurorafs_read_extent(mount, &a, part, 5000, 300) == 300 &&
+                memcmp(part, text + 5000, 300) == 0, "Partial read of a compressed extent");
+
+    aurorafs_extent_t b = hole(blocks);
+    aurorafs_write_extent(mount, &b, noise, 0, bytes);
+    TEST_ASSERT(!(b.flags & AURORAFS_EXTENT_COMPRESSED) &&
+                free0 - mount->superblock->free_blocks == used + blocks,
+                "Random data stored raw in full blocks");
+    TEST_ASSERT(extent_is(mount, &b, noise), "Raw extent reads back");
+
+    /* A partial write merges into the whole and recompresses */
+    memset(part, 0xEE, sizeof(part));
+    memcpy(text + 70000, part, sizeof(part));
+    TEST_ASSERT(aurorafs_write_extent(mount, &a, part, 70000, sizeof(part)) == sizeof(part) &&
+                (a.flags & AURORAFS_EXTENT_LZ4), "Partial write to a compressed extent");
+    TEST_ASSERT(extent_is(mount, &a, text), "Merged contents read back");
+
+    /* Text overwritten with noise goes raw, and back again */
+    uint64_t before = mount->superblock->free_blocks;
+    aurorafs_write_extent(mount, &a, noise, 0, bytes);
+    TEST_ASSERT(!(a.flags & AURORAFS_EXTENT_COMPRESSED) && extent_is(mount, &a, noise) &&
+                before - mount->superblock->free_blocks == blocks - used,
+                "Incompressible rewrite grows to full blocks");
+    aurorafs_write_extent(mount, &a, text, 0, bytes);
+    TEST_ASSERT((a.flags & AURORAFS_EXTENT_LZ4) && extent_is(mount, &a, text) &&
+                mount->superblock->free_blocks == before, "Compressible rewrite shrinks again");
+
+    /* Cold data: recompress with the entropy mode */
+    uint32_t lz4_size = a.compressed_size;
+    TEST_ASSERT(aurorafs_recompress_extent(mount, &a, AURORAFS_COMPRESS_ZSTD) == 0 &&
+                (a.flags & AURORAFS_EXTENT_ZSTD) && !(a.flags & AURORAFS_EXTENT_LZ4),
+                "Recompress cold extent with the entropy mode");
+    snprintf(msg, sizeof(msg), "Entropy mode smaller: %u vs %u bytes", a.compressed_size, lz4_size);
+    TEST_ASSERT(a.compressed_size < lz4_size, msg);
+    TEST_ASSERT(extent_is(mount, &a, text), "Recompressed extent reads back");
+
+    /* Corruption on the device fails the read rather than running off the
+     * end of the caller's buffer */
+    uint8_t saved = mem.data[a.physical_block * BS + 100];
+    mem.data[a.physical_block * BS + 100] ^= 0xFF;
+    uint8_t* scratch = malloc(bytes + 64);
+    memset(scratch + bytes, 0x5A, 64);
+    int r = aurorafs_read_extent(mount, &a, scratch, 0, bytes);
+    int guard = 1;
+    for (int g = 0; g < 64; g++) {
+        guard &= scratch[bytes + g] == 0x5A;
+    }
+    TEST_ASSERT(guard && (r == -1 || memcmp(scratch, text, bytes) != 0),
+                "Corrupted extent is not returned as the original data");
+    mem.data[a.physical_block * BS + 100] = saved;
+    free(scratch);
+
+    /* Single blocks are never compressed */
+    aurorafs_extent_t c = hole(1);
+    aurorafs_write_extent(mount, &c, text, 0, BS);
+    TEST_ASSERT(!(c.flags & AURORAFS_EXTENT_COMPRESSED) && extent_is(mount, &c, text),
+                "Single-block extent stored raw");
+
+    aurorafs_free_extent(mount, &a);
+    aurorafs_free_extent(mount, &b);
+    aurorafs_free_extent(mount, &c);
+    TEST_ASSERT(mount->superblock->free_blocks == free0, "Freeing returns exactly the stored blocks");
+
+    /* Compression and dedup together */
+    aurorafs_unmount_device();
+    memset(mem.data, 0, (size_t)mem.blocks * BS);
+    aurorafs_format("mem0", mem.blocks * BS, AURORAFS_FEAT_COMPRESS | AURORAFS_FEAT_DEDUP);
+    aurorafs_mount_device("mem0", NULL);
+    mount = aurorafs_get_mount();
+    free0 = mount->superblock->free_blocks;
+    aurorafs_extent_t d = hole(blocks);
+    aurorafs_extent_t e1 = hole(1), e2 = hole(1);
+    aurorafs_write_extent(mount, &d, text, 0, bytes);
+    aurorafs_write_extent(mount, &e1, text, 0, BS);
+    aurorafs_write_extent(mount, &e2, text, 0, BS);
+    TEST_ASSERT((d.flags & AURORAFS_EXTENT_LZ4) && e1.physical_block == e2.physical_block &&
+                extent_is(mount, &d, text) && extent_is(mount, &e2, text),
+                "Large extents compress while single blocks dedup");
+    aurorafs_free_extent(mount, &d);
+    aurorafs_free_extent(mount, &e1);
+    aurorafs_free_extent(mount, &e2);
+    TEST_ASSERT(mount->superblock->free_blocks == free0, "All blocks returned");
+    aurorafs_unmount_device();
+
+    free(text);
+    free(noise);
+}
+
+/* ---- Benchmark ---- */
+
+/* Kernel sources as a text corpus */
+static size_t load_sources(uint8_t* buf, size_t max) {
+    static const char* files[] = {
+        "kernel/core/kernel.c", "kernel/core/linux_compat.c", "kernel/core/pe_loader.c",
+        "kernel/core/dll_loader.c", "kernel/core/acpi_support.c", "kernel/core/uefi_support.c",
+        "kernel/core/rbtree.c", "kernel/core/radix_tree.c", "kernel/memory/buddy.c",
+        "filesystem/vfs/vfs.c", "filesystem/vfs/fdtable.c", "filesystem/journal/journal.c",
+        "filesystem/aurorafs/aurorafs.c", "filesystem/aurorafs/compress.c"
+    };
+    size_t total = 0;
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]) && total < max; i++) {
+        FILE* f = fopen(files[i], "rb");
+        if (f) {
+            total += fread(buf + total, 1, max - total, f);
+            fclose(f);
+        }
+    }
+    return total;
+}
+
+static size_t load_file(const char* path, uint8_t* buf, size_t max) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return 0;
+    }
+    size_t n = fread(buf, 1, max, f);
+    fclose(f);
+    return n;
+}
+
+static void bench_corpus(const char* name, const uint8_t* data, size_t size) {
+    const size_t chunk = 128 * 1024;       /* Extent-sized pieces */
+    uint8_t* packed = malloc(chunk);
+    uint8_t* out = malloc(chunk);
+
+    for (int a = 0; a < 2; a++) {
+        size_t in_total = 0, out_total = 0, dec_total = 0;
+        uint64_t comp_ns = 0, decomp_ns = 0;
+        int ok = 1;
+        for (int rep = 0; rep < 3; rep++) {
+            for (size_t at = 0; at + chunk <= size; at += chunk) {
+                size_t packed_size = 0;
+                uint64_t t0 = now_ns();
+                int r = aurorafs_compress_block(data + at, chunk, packed, &packed_size, algorithms[a]);
+                uint64_t t1 = now_ns();
+                comp_ns += t1 - t0;
+                in_total += chunk;
+                if (r != 0) {
+                    out_total += chunk;
+                    continue;
+                }
+                out_total += packed_size;
+                t0 = now_ns();
+                ok &= aurorafs_decompress_block(packed, packed_size, out, chunk, algorithms[a]) == 0;
+                decomp_ns += now_ns() - t0;
+                dec_total += chunk;
+                ok &= memcmp(out, data + at, chunk) == 0;
+            }
+        }
+        printf("  %-12s %-8s ratio %5.2f, compress %7.1f MB/s, decompress %7.1f MB/s%s\n",
+               name, algorithm_names[a], (double)in_total / (double)out_total,
+               (double)in_total / (double)comp_ns * 1000.0,
+               decomp_ns ? (double)dec_total / (double)decomp_ns * 1000.0 : 0.0,
+               ok ? "" : "  (MISMATCH)");
+    }
+    free(packed);
+    free(out);
+}
+
+static void run_bench(const char* self) {
+    printf("\nBenchmark (128 KB chunks):\n");
+
+    const size_t max = 8 << 20;
+    uint8_t* buf = malloc(max);
+
+    size_t n = load_sources(buf, max);
+    if (n >= 128 * 1024) {
+        bench_corpus("sources", buf, n);
+    }
+    n = load_file(self, buf, max);
+    if (n >= 128 * 1024) {
+        bench_corpus("binary", buf, n);
+    }
+    fill_random(buf, 4 << 20);
+    bench_corpus("random", buf, 4 << 20);
+    free(buf);
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("Aurora OS AuroraFS Compression Tests\n");
+
+    mem.blocks = DEV_BLOCKS;
+    mem.data = calloc(DEV_BLOCKS, BS);
+    mem_device.blocks = DEV_BLOCKS;
+    mem_device.ctx = &mem;
+    mem_device.read = mem_read;
+    mem_device.write = mem_write;
+    mem_device.flush = NULL;
+    aurorafs_init();
+    aurorafs_register_device("mem0", &mem_device);
+
+    test_lz4_format();
+    test_round_trips();
+    test_fuzz();
+    test_heuristic();
+    test_extents();
+
+    if (bench) {
+        run_bench(argv[0]);
+    }
+
+    free(mem.data);
+    printf("\nPassed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
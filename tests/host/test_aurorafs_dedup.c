@@ -0,0 +1,625 @@
+/**
+ * Aurora OS - AuroraFS Deduplication Tests
+ *
+ * Host-built harness for the AuroraFS dedup index and write path on a
+ * memory-backed volume: SHA-256 block hashing, index add/find/refcount
+ * with blocks freed at zero, the bloom filter skipping misses, duplicate-
+ * heavy datasets checked for space saved and read back byte for byte,
+ * copy-on-write of shared blocks, the index surviving a remount, and
+ * concurrent writers. With --bench, write throughput at several duplicate
+ * ratios, with dedup on and off and with scalar and SHA-NI hashing.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "../../filesystem/aurorafs/aurorafs.h"
+#include "../../kernel/security/sha.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/* ---- Kernel service stubs ---- */
+
+void* kmalloc(size_t size) {
+    return malloc(size);
+}
+
+void kfree(void* ptr) {
+    free(ptr);
+}
+
+uint32_t smp_get_current_cpu_id(void) {
+    return 0;
+}
+
+void cpu_relax(void) {
+    sched_yield();
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* ---- Memory-backed device ---- */
+
+#define BS          AURORAFS_BLOCK_SIZE
+#define DEV_BLOCKS  32768           /* 128 MB */
+
+typedef struct {
+    uint64_t blocks;
+    uint8_t* data;
+    uint64_t writes;                /* Blocks written */
+} mem_dev_t;
+
+static mem_dev_t mem;
+static aurorafs_device_t mem_device;
+
+static int mem_read(void* ctx, uint64_t block, void* data, uint32_t count) {
+    mem_dev_t* dev = (mem_dev_t*)ctx;
+    if (block + count > dev->blocks) {
+        return -1;
+    }
+    memcpy(data, dev->data + block * BS, (size_t)count * BS);
+    return 0;
+}
+
+static int mem_write(void* ctx, uint64_t block, const void* data, uint32_t count) {
+    mem_dev_t* dev = (mem_dev_t*)ctx;
+    if (block + count > dev->blocks) {
+        return -1;
+    }
+    memcpy(dev->data + block * BS, data, (size_t)count * BS);
+    __atomic_add_fetch(&dev->writes, count, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/* Format and mount a fresh volume */
+static aurorafs_mount_t* fresh_volume(uint32_t features) {
+    if (aurorafs_get_mount()) {
+        aurorafs_unmount_device();
+    }
+    memset(mem.data, 0, (size_t)mem.blocks * BS);
+    mem.writes = 0;
+    if (aurorafs_format("mem0", mem.blocks * BS, features) != 0 ||
+        aurorafs_mount_device("mem0", NULL) != 0) {
+        return NULL;
+    }
+    return aurorafs_get_mount();
+}
+
+static aurorafs_mount_t* remount(void) {
+    aurorafs_unmount_device();
+    if (aurorafs_mount_device("mem0", NULL) != 0) {
+        return NULL;
+    }
+    return aurorafs_get_mount();
+}
+
+static aurorafs_dedup_stats_t stats_of(aurorafs_mount_t* mount) {
+    aurorafs_dedup_stats_t st;
+    aurorafs_dedup_get_stats(mount, &st);
+    return st;
+}
+
+/* Block contents for a dataset value: distinct values, distinct blocks */
+static void fill_block(uint8_t* block, uint64_t value) {
+    uint64_t x = value * 0x9E3779B97F4A7C15ull + 1;
+    for (size_t i = 0; i < BS; i += 8) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        memcpy(block + i, &x, 8);
+    }
+}
+
+static int block_is(aurorafs_mount_t* mount, const aurorafs_extent_t* extent, uint64_t value) {
+    uint8_t expect[BS];
+    uint8_t got[BS];
+    fill_block(expect, value);
+    return aurorafs_read_extent(mount, extent, got, 0, BS) == BS &&
+           memcmp(expect, got, BS) == 0;
+}
+
+/* Write a value to a single-block extent starting out as a hole */
+static int write_value(aurorafs_mount_t* mount, aurorafs_extent_t* extent, uint64_t value) {
+    uint8_t block[BS];
+    fill_block(block, value);
+    return aurorafs_write_extent(mount, extent, block, 0, BS);
+}
+
+static aurorafs_extent_t hole(void) {
+    aurorafs_extent_t extent;
+    memset(&extent, 0, sizeof(extent));
+    extent.length = 1;
+    return extent;
+}
+
+/* ---- Hashing ---- */
+
+static void test_hash(void) {
+    printf("\nHashing:\n");
+
+    static const uint8_t zero_block_sha256[32] = {
+        0xad, 0x7f, 0xac, 0xb2, 0x58, 0x6f, 0xc6, 0xe9, 0x66, 0xc0, 0x04, 0xd7, 0xd1, 0xd1, 0x6b, 0x02,
+        0x4f, 0x58, 0x05, 0xff, 0x7c, 0xb4, 0x7c, 0x7a, 0x85, 0xda, 0xbd, 0x8b, 0x48, 0x89, 0x2c, 0xa7
+    };
+    uint8_t block[BS];
+    uint8_t hash[AURORAFS_HASH_SIZE];
+    uint8_t other[AURORAFS_HASH_SIZE];
+
+    memset(block, 0, BS);
+    aurorafs_calculate_hash(block, BS, hash);
+    TEST_ASSERT(memcmp(hash, zero_block_sha256, 32) == 0, "Zero block hashes to its SHA-256");
+
+    uint32_t accel = sha_get_accel();
+    sha_set_accel(SHA_ACCEL_NONE);
+    fill_block(block, 7);
+    aurorafs_calculate_hash(block, BS, other);
+    sha_set_accel(accel);
+    aurorafs_calculate_hash(block, BS, hash);
+    TEST_ASSERT(memcmp(hash, other, 32) == 0, "Scalar and accelerated hashes agree");
+
+    block[BS - 1] ^= 1;
+    aurorafs_calculate_hash(block, BS, other);
+    TEST_ASSERT(memcmp(hash, other, 32) != 0, "One flipped bit changes the hash");
+    printf("    (SHA acceleration: %s)\n", (accel & SHA_ACCEL_SHANI) ? "SHA-NI" : "none");
+}
+
+/* ---- Volume setup ---- */
+
+static void test_volume(void) {
+    printf("\nVolume:\n");
+
+    TEST_ASSERT(aurorafs_register_device("mem0", &mem_device) == -1, "Name cannot be registered twice");
+    TEST_ASSERT(aurorafs_format("nodev", 1 << 20, 0) == -1, "Format needs a registered device");
+    TEST_ASSERT(aurorafs_mount_device("nodev", NULL) == -1, "Mount needs a registered device");
+    TEST_ASSERT(aurorafs_mount_device("mem0", NULL) == -1, "Blank device does not mount");
+
+    aurorafs_mount_t* mount = fresh_volume(AURORAFS_FEAT_DEDUP);
+    TEST_ASSERT(mount != NULL && mount->dedup_enabled, "Format and mount a dedup volume");
+    uint64_t bitmap_blocks = (DEV_BLOCKS + AURORAFS_BITMAP_BITS - 1) / AURORAFS_BITMAP_BITS;
+    TEST_ASSERT(mount->superblock->free_blocks == DEV_BLOCKS - 1 - bitmap_blocks,
+                "Superblock and bitmap are the only blocks in use");
+
+    uint64_t start;
+    TEST_ASSERT(aurorafs_alloc_blocks(mount, 8, &start) == 0 && start == 1 + bitmap_blocks,
+                "First allocation follows the bitmap");
+    TEST_ASSERT(aurorafs_free_blocks(mount, 0, 1) == -1, "Superblock cannot be freed");
+    TEST_ASSERT(aurorafs_free_blocks(mount, start, 8) == 0, "Free the run");
+    TEST_ASSERT(aurorafs_free_blocks(mount, start, 1) == -1, "Double free refused");
+}
+
+/* ---- Index ---- */
+
+static void test_index(void) {
+    printf("\nIndex:\n");
+
+    aurorafs_mount_t* mount = fresh_volume(AURORAFS_FEAT_DEDUP);
+    uint64_t free0 = mount->superblock->free_blocks;
+    uint8_t hash[AURORAFS_HASH_SIZE];
+    uint8_t block[BS];
+    fill_block(block, 1);
+    aurorafs_calculate_hash(block, BS, hash);
+
+    uint64_t b, found = 0;
+    aurorafs_alloc_blocks(mount, 1, &b);
+    TEST_ASSERT(aurorafs_dedup_find_block(mount, hash, &found) == -1, "Empty index finds nothing");
+    TEST_ASSERT(aurorafs_dedup_add_block(mount, hash, b) == 0, "Add a block");
+    TEST_ASSERT(aurorafs_dedup_find_block(mount, hash, &found) == 0 && found == b,
+                "Find it by hash");
+    TEST_ASSERT(aurorafs_dedup_add_block(mount, hash, b + 1) == -1, "Same contents cannot be added twice");
+    uint8_t other[AURORAFS_HASH_SIZE];
+    memcpy(other, hash, sizeof(other));
+    other[31] ^= 0xFF;
+    TEST_ASSERT(aurorafs_dedup_add_block(mount, other, b) == -1, "Same block cannot be added twice");
+    TEST_ASSERT(aurorafs_dedup_find_block(mount, other, &found) == -1,
+                "Hash differing in its last byte is a miss");
+
+    TEST_ASSERT(aurorafs_dedup_inc_refcount(mount, b) == 0, "Take a second reference");
+    TEST_ASSERT(aurorafs_dedup_get_block(mount, hash, &found) == 0 && found == b,
+                "Find and reference in one step");
+    aurorafs_dedup_stats_t st = stats_of(mount);
+    TEST_ASSERT(st.entries == 1 && st.references == 3, "One entry, three references");
+    TEST_ASSERT(aurorafs_dedup_dec_refcount(mount, b) == 2, "Drop one, two left");
+    TEST_ASSERT(aurorafs_dedup_dec_refcount(mount, b) == 1, "Drop one, one left");
+    TEST_ASSERT(mount->superblock->free_blocks == free0 - 1, "Block still allocated");
+    TEST_ASSERT(aurorafs_dedup_dec_refcount(mount, b) == 0, "Last reference dropped");
+    TEST_ASSERT(mount->superblock->free_blocks == free0, "Block freed at zero");
+    TEST_ASSERT(aurorafs_dedup_find_block(mount, hash, &found) == -1, "Freed block left the index");
+    TEST_ASSERT(aurorafs_dedup_dec_refcount(mount, b) == -1, "Unknown block has no count");
+    TEST_ASSERT(aurorafs_dedup_inc_refcount(mount, b) == -1, "Unknown block cannot be referenced");
+
+    /* Grow well past the initial table and probe for misses */
+    const uint32_t n = 20000;
+    int all_found = 1;
+    for (uint32_t i = 0; i < n; i++) {
+        memset(other, 0, sizeof(other));
+        uint64_t v = rng();
+        memcpy(other, &v, 8);
+        v = rng();
+        memcpy(other + 8, &v, 8);
+        v = rng();
+        memcpy(other + 16, &v, 8);
+        other[24] = (uint8_t)i;
+        if (aurorafs_dedup_add_block(mount, other, 100000 + i) != 0) {
+            all_found = 0;
+        }
+    }
+    TEST_ASSERT(all_found && stats_of(mount).entries == n, "Index grows to 20000 entries");
+
+    rng_state = 0x9E3779B97F4A7C15ull;
+    for (uint32_t i = 0; i < n && all_found; i++) {
+        memset(other, 0, sizeof(other));
+        uint64_t v = rng();
+        memcpy(other, &v, 8);
+        v = rng();
+        memcpy(other + 8, &v, 8);
+        v = rng();
+        memcpy(other + 16, &v, 8);
+        other[24] = (uint8_t)i;
+        all_found = aurorafs_dedup_find_block(mount, other, &found) == 0 && found == 100000 + i;
+    }
+    TEST_ASSERT(all_found, "Every entry found after growing");
+
+    aurorafs_dedup_stats_t before = stats_of(mount);
+    for (uint32_t i = 0; i < 100000; i++) {
+        uint64_t v = rng();
+        memcpy(other, &v, 8);
+        v = rng();
+        memcpy(other + 8, &v, 8);
+        v = rng();
+        memcpy(other + 16, &v, 8);
+        aurorafs_dedup_find_block(mount, other, &found);
+    }
+    st = stats_of(mount);
+    uint64_t skips = st.bloom_skips - before.bloom_skips;
+    uint64_t fps = st.false_positives - before.false_positives;
+    printf("    (100000 misses: %lu skipped by the bloom filter, %lu false positives)\n",
+           (unsigned long)skips, (unsigned long)fps);
+    TEST_ASSERT(skips + fps == 100000 && fps < 2000, "Bloom filter answers over 98% of misses");
+}
+
+/* ---- Duplicate-heavy datasets ---- */
+
+static void test_dataset(void) {
+    printf("\nDuplicate-heavy datasets:\n");
+
+    aurorafs_mount_t* mount = fresh_volume(AURORAFS_FEAT_DEDUP);
+    uint64_t free0 = mount->superblock->free_blocks;
+
+    mem.writes = 0;
+
+    /* 8192 blocks drawn from 256 distinct contents */
+    const uint32_t n = 8192, distinct = 256;
+    aurorafs_extent_t* extents = calloc(n, sizeof(aurorafs_extent_t));
+    uint32_t* values = calloc(n, sizeof(uint32_t));
+    int ok = 1;
+    for (uint32_t i = 0; i < n; i++) {
+        extents[i] = hole();
+        values[i] = (uint32_t)(rng() % distinct);
+        ok &= write_value(mount, &extents[i], values[i]) == BS;
+    }
+    TEST_ASSERT(ok, "8192 blocks written");
+    aurorafs_dedup_stats_t st = stats_of(mount);
+    TEST_ASSERT(st.entries == distinct && st.references == n, "256 indexed blocks, 8192 references");
+    TEST_ASSERT(free0 - mount->superblock->free_blocks == distinct, "Only 256 blocks of space used");
+    TEST_ASSERT(mem.writes == distinct, "Duplicates never reach the device");
+
+    ok = 1;
+    for (uint32_t i = 0; i < n; i++) {
+        ok &= block_is(mount, &extents[i], values[i]) &&
+              (extents[i].flags & AURORAFS_EXTENT_DEDUP) != 0;
+    }
+    TEST_ASSERT(ok, "Every block reads back what was written");
+
+    /* Overwrite a shared block in full: it moves, the others keep theirs */
+    uint32_t victim = 0;
+    uint32_t sharer = 1;
+    while (values[sharer] != values[victim]) {
+        sharer++;
+    }
+    uint64_t shared_block = extents[victim].physical_block;
+    TEST_ASSERT(write_value(mount, &extents[victim], 1000) == BS, "Overwrite a shared block");
+    TEST_ASSERT(extents[victim].physical_block != shared_block &&
+                extents[sharer].physical_block == shared_block,
+                "Overwrite takes a new block");
+    TEST_ASSERT(block_is(mount, &extents[victim], 1000) && block_is(mount, &extents[sharer], values[sharer]),
+                "Writer sees new data, sharer old");
+    values[victim] = 1000;
+
+    /* Partial write to a shared block copies it first */
+    uint32_t a = 2, b = 3;
+    while (values[b] != values[a]) {
+        b++;
+    }
+    uint8_t patch[100];
+    memset(patch, 0xEE, sizeof(patch));
+    shared_block = extents[a].physical_block;
+    TEST_ASSERT(aurorafs_write_extent(mount, &extents[a], patch, 1000, sizeof(patch)) == sizeof(patch),
+                "Partial write to a shared block");
+    uint8_t expect[BS], got[BS];
+    fill_block(expect, values[a]);
+    memset(expect + 1000, 0xEE, sizeof(patch));
+    aurorafs_read_extent(mount, &extents[a], got, 0, BS);
+    TEST_ASSERT(extents[a].physical_block != shared_block && memcmp(got, expect, BS) == 0,
+                "Partial write lands in a private copy");
+    TEST_ASSERT(block_is(mount, &extents[b], values[b]), "Sharer unaffected by the partial write");
+    TEST_ASSERT(!(extents[a].flags & AURORAFS_EXTENT_DEDUP), "Modified copy is not indexed");
+
+    /* Partial write to an exclusively held indexed block happens in place */
+    uint64_t entries = stats_of(mount).entries;
+    uint64_t own = extents[victim].physical_block;
+    TEST_ASSERT(aurorafs_write_extent(mount, &extents[victim], patch, 0, 10) == 10 &&
+                extents[victim].physical_block == own, "Exclusive block written in place");
+    TEST_ASSERT(stats_of(mount).entries == entries - 1, "and leaves the index");
+    for (uint32_t i = 0; i < n; i++) {
+        if (i != (uint32_t)a && i != victim) {
+            ok &= block_is(mount, &extents[i], values[i]);
+        }
+    }
+    TEST_ASSERT(ok, "Rest of the dataset intact");
+
+    /* Releasing every extent returns every block */
+    ok = 1;
+    for (uint32_t i = 0; i < n; i++) {
+        ok &= aurorafs_free_extent(mount, &extents[i]) == 0;
+    }
+    st = stats_of(mount);
+    TEST_ASSERT(ok && st.entries == 0 && st.references == 0, "Index empty after freeing all extents");
+    TEST_ASSERT(mount->superblock->free_blocks == free0, "All space returned");
+
+    /* Same dataset without dedup takes a block per extent */
+    mount = fresh_volume(0);
+    free0 = mount->superblock->free_blocks;
+    ok = 1;
+    for (uint32_t i = 0; i < n; i++) {
+        extents[i] = hole();
+        ok &= write_value(mount, &extents[i], values[i]) == BS;
+    }
+    TEST_ASSERT(ok && free0 - mount->superblock->free_blocks == n, "Without dedup, a block per extent");
+    ok = 1;
+    for (uint32_t i = 0; i < n; i++) {
+        ok &= block_is(mount, &extents[i], values[i]);
+    }
+    TEST_ASSERT(ok, "and the data reads back");
+
+    free(extents);
+    free(values);
+}
+
+/* ---- Persistence ---- */
+
+static void test_persist(void) {
+    printf("\nPersistence:\n");
+
+    aurorafs_mount_t* mount = fresh_volume(AURORAFS_FEAT_DEDUP);
+    uint64_t free0 = mount->superblock->free_blocks;
+    const uint32_t n = 2048, distinct = 300;
+    aurorafs_extent_t* extents = calloc(n, sizeof(aurorafs_extent_t));
+    for (uint32_t i = 0; i < n; i++) {
+        extents[i] = hole();
+        write_value(mount, &extents[i], i % distinct);
+    }
+    aurorafs_dedup_stats_t before = stats_of(mount);
+    uint64_t free_before = mount->superblock->free_blocks;
+
+    mount = remount();
+    TEST_ASSERT(mount != NULL, "Remount");
+    aurorafs_dedup_stats_t st = stats_of(mount);
+    TEST_ASSERT(st.entries == before.entries && st.references == before.references,
+                "Index reloaded with its counts");
+    uint64_t table_blocks = 1 + (distinct + AURORAFS_DEDUP_PER_BLOCK - 1) / AURORAFS_DEDUP_PER_BLOCK;
+    TEST_ASSERT(mount->superblock->free_blocks == free_before - table_blocks,
+                "Stored table holds its own blocks");
+
+    int ok = 1;
+    for (uint32_t i = 0; i < n; i++) {
+        ok &= block_is(mount, &extents[i], i % distinct);
+    }
+    TEST_ASSERT(ok, "Data intact after remount");
+
+    aurorafs_extent_t extra = hole();
+    write_value(mount, &extra, 5);
+    TEST_ASSERT(extra.physical_block == extents[5].physical_block, "Reloaded index dedups new writes");
+    aurorafs_free_extent(mount, &extra);
+
+    for (uint32_t i = 0; i < n; i++) {
+        aurorafs_free_extent(mount, &extents[i]);
+    }
+    mount = remount();
+    TEST_ASSERT(mount && stats_of(mount).entries == 0, "Empty index after freeing everything");
+    TEST_ASSERT(mount->superblock->free_blocks == free0 - 1, "Old table freed, empty one stored");
+
+    /* A corrupted table is refused rather than trusted */
+    for (uint32_t i = 0; i < 200; i++) {
+        extents[i] = hole();
+        write_value(mount, &extents[i], i);
+    }
+    aurorafs_sync(mount);
+    uint64_t table = mount->superblock->dedup_table_inode;
+    aurorafs_unmount_device();
+    mem.data[(table + 1) * BS + 40] ^= 1;
+    TEST_ASSERT(aurorafs_mount_device("mem0", NULL) == -1, "Corrupted dedup table fails the mount");
+    mem.data[(table + 1) * BS + 40] ^= 1;
+    TEST_ASSERT(aurorafs_mount_device("mem0", NULL) == 0, "Repaired table mounts");
+
+    free(extents);
+}
+
+/* ---- Concurrent writers ---- */
+
+#define THREADS 4
+#define PER_THREAD 2048
+
+typedef struct {
+    aurorafs_mount_t* mount;
+    aurorafs_extent_t extents[PER_THREAD];
+    uint32_t values[PER_THREAD];
+    uint64_t seed;
+    int ok;
+} writer_t;
+
+static void* writer_main(void* arg) {
+    writer_t* w = (writer_t*)arg;
+    uint8_t block[BS];
+    w->ok = 1;
+    for (uint32_t i = 0; i < PER_THREAD; i++) {
+        w->seed = w->seed * 6364136223846793005ull + 1442695040888963407ull;
+        w->values[i] = (uint32_t)(w->seed >> 33) % 64;
+        w->extents[i] = hole();
+        fill_block(block, w->values[i]);
+        w->ok &= aurorafs_write_extent(w->mount, &w->extents[i], block, 0, BS) == BS;
+        /* Churn: drop and rewrite some blocks */
+        if (i % 7 == 6) {
+            aurorafs_free_extent(w->mount, &w->extents[i - 3]);
+            w->extents[i - 3] = hole();
+            fill_block(block, w->values[i - 3]);
+            w->ok &= aurorafs_write_extent(w->mount, &w->extents[i - 3], block, 0, BS) == BS;
+        }
+    }
+    return NULL;
+}
+
+static void test_concurrent(void) {
+    printf("\nConcurrent writers:\n");
+
+    aurorafs_mount_t* mount = fresh_volume(AURORAFS_FEAT_DEDUP);
+    uint64_t free0 = mount->superblock->free_blocks;
+    writer_t* writers = calloc(THREADS, sizeof(writer_t));
+    pthread_t threads[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        writers[t].mount = mount;
+        writers[t].seed = 1000 + t;
+        pthread_create(&threads[t], NULL, writer_main, &writers[t]);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    int ok = 1;
+    for (int t = 0; t < THREADS; t++) {
+        ok &= writers[t].ok;
+        for (uint32_t i = 0; i < PER_THREAD; i++) {
+            ok &= block_is(mount, &writers[t].extents[i], writers[t].values[i]);
+        }
+    }
+    TEST_ASSERT(ok, "4 threads x 2048 blocks all read back");
+    uint64_t used = free0 - mount->superblock->free_blocks;
+    printf("    (%lu blocks used for 64 distinct contents)\n", (unsigned long)used);
+    TEST_ASSERT(stats_of(mount).entries == 64 && used < 128, "Nearly all duplicates shared");
+
+    for (int t = 0; t < THREADS; t++) {
+        for (uint32_t i = 0; i < PER_THREAD; i++) {
+            aurorafs_free_extent(mount, &writers[t].extents[i]);
+        }
+    }
+    TEST_ASSERT(mount->superblock->free_blocks == free0, "Every block freed exactly once");
+    free(writers);
+}
+
+/* ---- Benchmark ---- */
+
+static void bench_writes(const char* label, uint32_t features, uint32_t dup_percent, uint32_t accel) {
+    aurorafs_mount_t* mount = fresh_volume(features);
+    uint32_t saved_accel = sha_get_accel();
+    sha_set_accel(accel);
+
+    const uint32_t n = 16384;       /* 64 MB */
+    aurorafs_extent_t* extents = calloc(n, sizeof(aurorafs_extent_t));
+    uint8_t* data = malloc((size_t)n * BS);
+    uint32_t next_unique = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t value = (next_unique > 0 && rng() % 100 < dup_percent)
+                         ? (uint32_t)(rng() % next_unique) : next_unique++;
+        fill_block(data + (size_t)i * BS, value);
+        extents[i] = hole();
+    }
+
+    uint64_t free0 = mount->superblock->free_blocks;
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        aurorafs_write_extent(mount, &extents[i], data + (size_t)i * BS, 0, BS);
+    }
+    uint64_t elapsed = now_ns() - start;
+    uint64_t used = free0 - mount->superblock->free_blocks;
+
+    printf("  %-28s %3u%% dup: %7.1f MB/s, %5.1f%% of space used\n", label, dup_percent,
+           (double)n * BS / (double)elapsed * 1000.0, 100.0 * (double)used / n);
+
+    sha_set_accel(saved_accel);
+    free(extents);
+    free(data);
+}
+
+static void run_bench(void) {
+    printf("\nBenchmark (64 MB of 4 KB block writes to a memory device):\n");
+
+    uint32_t accel = sha_get_accel();
+    for (uint32_t dup = 0; dup <= 90; dup += 45) {
+        bench_writes("no dedup", 0, dup, accel);
+        bench_writes("dedup, scalar SHA-256", AURORAFS_FEAT_DEDUP, dup, SHA_ACCEL_NONE);
+        if (accel & SHA_ACCEL_SHANI) {
+            bench_writes("dedup, SHA-NI", AURORAFS_FEAT_DEDUP, dup, accel);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("Aurora OS AuroraFS Dedup Tests\n");
+
+    mem.blocks = DEV_BLOCKS;
+    mem.data = calloc(DEV_BLOCKS, BS);
+    mem_device.blocks = DEV_BLOCKS;
+    mem_device.ctx = &mem;
+    mem_device.read = mem_read;
+    mem_device.write = mem_write;
+    mem_device.flush = NULL;
+    aurorafs_init();
+    aurorafs_register_device("mem0", &mem_device);
+
+    test_hash();
+    test_volume();
+    test_index();
+    test_dataset();
+    test_persist();
+    test_concurrent();
+
+    if (bench) {
+        run_bench();
+    }
+
+    if (aurorafs_get_mount()) {
+        aurorafs_unmount_device();
+    }
+    free(mem.data);
+    printf("\nPassed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
@@ -0,0 +1,743 @@
+/**
+ * Aurora OS - AuroraFS Free-Space Manager Tests
+ *
+ * Host-built harness for the AuroraFS extent allocator on a memory-backed
+ * volume: the trees built from the bitmap at mount, per-CPU goals keeping
+ * each writer's blocks contiguous, best fit, merging on free, refused
+ * double and overlapping frees, reservations and delayed allocation of
+ * compressed extents, a randomized run checked against a shadow bitmap,
+ * and parallel allocating threads. With --bench, fragmentation and
+ * allocation throughput on an aged, simulated 1 TB volume.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "../../filesystem/aurorafs/aurorafs.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/* ---- Kernel service stubs ---- */
+
+static __thread uint32_t current_cpu;
+
+void* kmalloc(size_t size) {
+    return malloc(size);
+}
+
+void kfree(void* ptr) {
+    free(ptr);
+}
+
+uint32_t smp_get_current_cpu_id(void) {
+    return current_cpu;
+}
+
+void cpu_relax(void) {
+    sched_yield();
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* ---- Devices ---- */
+
+#define BS          AURORAFS_BLOCK_SIZE
+#define DEV_BLOCKS  16384           /* 64 MB */
+
+/* Blocks below keep_blocks are stored; the rest read as zeros and drop
+ * writes, which is enough to hold the metadata of a volume far larger
+ * than memory */
+typedef struct {
+    uint64_t blocks;
+    uint64_t keep_blocks;
+    uint8_t* data;
+} mem_dev_t;
+
+static mem_dev_t mem;
+static aurorafs_device_t mem_device;
+
+static int mem_read(void* ctx, uint64_t block, void* data, uint32_t count) {
+    mem_dev_t* dev = (mem_dev_t*)ctx;
+    if (block + count > dev->blocks) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t* out = (uint8_t*)data + (size_t)i * BS;
+        if (block + i < dev->keep_blocks) {
+            memcpy(out, dev->data + (block + i) * BS, BS);
+        } else {
+            memset(out, 0, BS);
+        }
+    }
+    return 0;
+}
+
+static int mem_write(void* ctx, uint64_t block, const void* data, uint32_t count) {
+    mem_dev_t* dev = (mem_dev_t*)ctx;
+    if (block + count > dev->blocks) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < count && block + i < dev->keep_blocks; i++) {
+        memcpy(dev->data + (block + i) * BS, (const uint8_t*)data + (size_t)i * BS, BS);
+    }
+    return 0;
+}
+
+static aurorafs_mount_t* fresh_volume(uint32_t features) {
+    if (aurorafs_get_mount()) {
+        aurorafs_unmount_device();
+    }
+    memset(mem.data, 0, (size_t)mem.keep_blocks * BS);
+    if (aurorafs_format("mem0", mem.blocks * BS, features) != 0 ||
+        aurorafs_mount_device("mem0", NULL) != 0) {
+        return NULL;
+    }
+    return aurorafs_get_mount();
+}
+
+static aurorafs_freespace_stats_t stats_of(aurorafs_mount_t* mount) {
+    aurorafs_freespace_stats_t st;
+    aurorafs_freespace_get_stats(mount, &st);
+    return st;
+}
+
+/* ---- Tests ---- */
+
+static void test_build(void) {
+    printf("\nTrees built at mount:\n");
+
+    aurorafs_mount_t* mount = fresh_volume(0);
+    TEST_ASSERT(mount != NULL, "Format and mount");
+    aurorafs_freespace_stats_t st = stats_of(mount);
+    uint64_t data = DEV_BLOCKS - mount->data_start;
+    TEST_ASSERT(st.extents == 1 && st.largest == data && st.free_blocks == data,
+                "A fresh volume is one free extent");
+    TEST_ASSERT(aurorafs_freespace_verify(mount) == 0, "Trees agree with the bitmap");
+
+    /* Punch a pattern of holes, then remount */
+    uint64_t starts[64];
+    for (int i = 0; i < 64; i++) {
+        aurorafs_alloc_blocks(mount, 1 + (uint64_t)i % 7, &starts[i]);
+    }
+    for (int i = 0; i < 64; i += 3) {
+        aurorafs_free_blocks(mount, starts[i], 1 + (uint64_t)i % 7);
+    }
+    aurorafs_freespace_stats_t before = stats_of(mount);
+    aurorafs_unmount_device();
+    TEST_ASSERT(aurorafs_mount_device("mem0", NULL) == 0, "Remount");
+    mount = aurorafs_get_mount();
+    st = stats_of(mount);
+    TEST_ASSERT(st.extents == before.extents && st.free_blocks == before.free_blocks &&
+                st.largest == before.largest, "Rebuilt trees match the ones unmounted");
+    TEST_ASSERT(aurorafs_freespace_verify(mount) == 0, "Rebuilt trees agree with the bitmap");
+}
+
+static void test_merge(void) {
+    printf("\nAllocation and merging:\n");
+
+    aurorafs_mount_t* mount = fresh_volume(0);
+    current_cpu = 0;
+    uint64_t a, b, c;
+    aurorafs_alloc_blocks(mount, 10, &a);
+    aurorafs_alloc_blocks(mount, 20, &b);
+    aurorafs_alloc_blocks(mount, 30, &c);
+    TEST_ASSERT(a == mount->data_start && b == a + 10 && c == b + 20,
+                "Allocations from one CPU follow each other");
+
+    aurorafs_free_blocks(mount, b, 20);
+    TEST_ASSERT(stats_of(mount).extents == 2, "A hole is a second extent");
+    aurorafs_free_blocks(mount, a, 10);
+    TEST_ASSERT(stats_of(mount).extents == 2 && stats_of(mount).merges == 1,
+                "Freeing beside it merges");
+    aurorafs_free_blocks(mount, c, 30);
+    aurorafs_freespace_stats_t st = stats_of(mount);
+    TEST_ASSERT(st.extents == 1 && st.largest == DEV_BLOCKS - mount->data_start,
+                "Freeing the gap joins both sides into one extent");
+    TEST_ASSERT(aurorafs_freespace_verify(mount) == 0, "Trees agree with the bitmap");
+
+    aurorafs_alloc_blocks(mount, 16, &a);
+    TEST_ASSERT(aurorafs_free_blocks(mount, a, 16) == 0, "Free a run");
+    TEST_ASSERT(aurorafs_free_blocks(mount, a, 16) == -1, "Double free refused");
+    aurorafs_alloc_blocks(mount, 8, &a);
+    TEST_ASSERT(aurorafs_free_blocks(mount, a, 9) == -1 && aurorafs_free_blocks(mount, a - 1, 2) == -1,
+                "Frees overlapping free space refused");
+    TEST_ASSERT(aurorafs_free_blocks(mount, 0, 1) == -1 &&
+                aurorafs_free_blocks(mount, 1, 1) == -1, "Superblock and bitmap cannot be freed");
+    TEST_ASSERT(aurorafs_free_blocks(mount, DEV_BLOCKS - 1, 2) == -1, "Range past the end refused");
+    TEST_ASSERT(aurorafs_free_blocks(mount, a, 0) == 0, "Freeing nothing is a no-op");
+    TEST_ASSERT(aurorafs_freespace_verify(mount) == 0 && stats_of(mount).free_blocks ==
+                DEV_BLOCKS - mount->data_start - 8, "Refused frees changed nothing");
+
+    /* Exhaust the volume, then give it all back */
+    uint64_t free0 = stats_of(mount).free_blocks;
+    uint64_t got = 0;
+    uint64_t s;
+    while (aurorafs_alloc_blocks(mount, 100, &s) == 0) {
+        got += 100;
+    }
+    while (aurorafs_alloc_blocks(mount, 1, &s) == 0) {
+        got++;
+    }
+    TEST_ASSERT(got == free0 && stats_of(mount).extents == 0, "Every block can be allocated");
+    TEST_ASSERT(aurorafs_alloc_blocks(mount, 1, &s) == -1, "Full volume refuses allocation");
+    aurorafs_free_blocks(mount, mount->data_start, DEV_BLOCKS - mount->data_start);
+    TEST_ASSERT(stats_of(mount).extents == 1 && aurorafs_freespace_verify(mount) == 0,
+                "Freeing it all leaves one extent");
+}
+
+static void test_best_fit(void) {
+    printf("\nBest fit:\n");
+
+    aurorafs_mount_t* mount = fresh_volume(0);
+    current_cpu = 0;
+
+    /* Holes of 8, 3 and 5 blocks between allocated separators */
+    uint64_t holes[3], sep, tail;
+    const uint64_t sizes[3] = { 8, 3, 5 };
+    for (int i = 0; i < 3; i++) {
+        aurorafs_alloc_blocks(mount, sizes[i], &holes[i]);
+        aurorafs_alloc_blocks(mount, 1, &sep);
+    }
+    aurorafs_alloc_blocks(mount, 1, &tail);
+    for (int i = 0; i < 3; i++) {
+        aurorafs_free_blocks(mount, holes[i], sizes[i]);
+    }
+
+    /* A CPU with no goal yet gets the tightest hole */
+    current_cpu = 5;
+    uint64_t s;
+    aurorafs_alloc_blocks(mount, 4, &s);
+    TEST_ASSERT(s == holes[2], "4 blocks go in the 5-block hole");
+    current_cpu = 6;
+    aurorafs_alloc_blocks(mount, 3, &s);
+    TEST_ASSERT(s == holes[1], "3 blocks fill the 3-block hole");
+    current_cpu = 7;
+    aurorafs_alloc_blocks(mount, 6, &s);
+    TEST_ASSERT(s == holes[0], "6 blocks go in the 8-block hole");
+    /* CPU 0's goal is the front of the free tail, so another CPU starts
+     * its run halfway along */
+    current_cpu = 8;
+    aurorafs_alloc_blocks(mount, 9, &s);
+    uint64_t tail_len = DEV_BLOCKS - (tail + 1);
+    TEST_ASSERT(s == tail + 1 + ((tail_len / 2) & ~63ull), "9 blocks go halfway along the free tail");
+
+    /* CPU 7's goal is the 2 blocks left in its hole: it continues there
+     * while they last, then falls back to best fit */
+    current_cpu = 7;
+    aurorafs_alloc_blocks(mount, 2, &s);
+    TEST_ASSERT(s == holes[0] + 6 && stats_of(mount).goal_allocs >= 1, "Goal used while it fits");
+    aurorafs_alloc_blocks(mount, 2, &s);
+    TEST_ASSERT(s != holes[0] + 8, "Goal abandoned once blocked");
+    TEST_ASSERT(aurorafs_freespace_verify(mount) == 0, "Trees agree with the bitmap");
+    current_cpu = 0;
+}
+
+static void test_streams(void) {
+    printf("\nPer-CPU goals:\n");
+
+    aurorafs_mount_t* mount = fresh_volume(0);
+    uint64_t last[4] = {0};
+    uint64_t breaks[4] = {0};
+    for (int round = 0; round < 200; round++) {
+        for (uint32_t cpu = 0; cpu < 4; cpu++) {
+            uint64_t s;
+            current_cpu = cpu;
+            aurorafs_alloc_blocks(mount, 4, &s);
+            if (round && s != last[cpu]) {
+                breaks[cpu]++;
+            }
+            last[cpu] = s + 4;
+        }
+    }
+    current_cpu = 0;
+    TEST_ASSERT(breaks[0] + breaks[1] + breaks[2] + breaks[3] == 0,
+                "Four interleaved writers each get one contiguous run");
+    TEST_ASSERT(aurorafs_freespace_verify(mount) == 0, "Trees agree with the bitmap");
+}
+
+static void test_delalloc(void) {
+    printf("\nReservations and delayed allocation:\n");
+
+    aurorafs_mount_t* mount = fresh_volume(AURORAFS_FEAT_COMPRESS);
+    uint64_t free0 = stats_of(mount).free_blocks;
+
+    aurorafs_extent_t e;
+    TEST_ASSERT(aurorafs_allocate_extent(mount, 32 * BS - 100, &e) == 0 &&
+                e.physical_block == 0 && e.length == 32 && (e.flags & AURORAFS_EXTENT_DELALLOC),
+                "Allocating an extent only reserves it");
+    aurorafs_freespace_stats_t st = stats_of(mount);
+    TEST_ASSERT(st.reserved_blocks == 32 && st.free_blocks == free0, "32 blocks reserved, none taken");
+
+    /* Compressible data takes fewer blocks than were reserved */
+    uint8_t* data = malloc(32 * BS);
+    for (size_t i = 0; i < 32 * BS; i++) {
+        data[i] = (uint8_t)("extent allocator "[i % 17]);
+    }
+    TEST_ASSERT(aurorafs_write_extent(mount, &e, data, 0, 32 * BS) == 32 * BS &&
+                e.physical_block != 0 && !(e.flags & AURORAFS_EXTENT_DELALLOC),
+                "Writing places the extent");
+    st = stats_of(mount);
+    char msg[96];
+    snprintf(msg, sizeof(msg), "Stored in %lu of 32 blocks, reservation released",
+             (unsigned long)(free0 - st.free_blocks));
+    TEST_ASSERT(st.reserved_blocks == 0 && free0 - st.free_blocks < 32 &&
+                free0 - st.free_blocks == (e.compressed_size + BS - 1) / BS, msg);
+    uint8_t* back = malloc(32 * BS);
+    TEST_ASSERT(aurorafs_read_extent(mount, &e, back, 0, 32 * BS) == 32 * BS &&
+                memcmp(back, data, 32 * BS) == 0, "Reads back");
+    aurorafs_free_extent(mount, &e);
+    TEST_ASSERT(stats_of(mount).free_blocks == free0, "Freed");
+
+    /* Reservations hold space against plain allocations */
+    aurorafs_extent_t big;
+    TEST_ASSERT(aurorafs_allocate_extent(mount, (free0 - 10) * BS, &big) == 0, "Reserve all but 10 blocks");
+    uint64_t s;
+    TEST_ASSERT(aurorafs_alloc_blocks(mount, 11, &s) == -1, "11 blocks refused");
+    TEST_ASSERT(aurorafs_alloc_blocks(mount, 10, &s) == 0, "10 blocks granted");
+    TEST_ASSERT(aurorafs_allocate_extent(mount, BS, &e) == -1, "Nothing left to reserve");
+    aurorafs_free_blocks(mount, s, 10);
+    aurorafs_free_extent(mount, &big);
+    st = stats_of(mount);
+    TEST_ASSERT(st.reserved_blocks == 0 && st.free_blocks == free0,
+                "Freeing an unwritten extent drops its reservation");
+
+    /* With every free block reserved, writeback still gets its own */
+    TEST_ASSERT(aurorafs_allocate_extent(mount, (free0 - 1) * BS, &big) == 0 &&
+                aurorafs_allocate_extent(mount, BS, &e) == 0, "Reserve every free block");
+    TEST_ASSERT(aurorafs_alloc_blocks(mount, 1, &s) == -1, "Plain allocation refused");
+    TEST_ASSERT(aurorafs_write_extent(mount, &e, data, 0, BS) == BS && e.physical_block != 0,
+                "The reserved extent is placed");
+    st = stats_of(mount);
+    TEST_ASSERT(st.reserved_blocks == free0 - 1 && st.free_blocks == free0 - 1,
+                "Its reservation became the allocation");
+    TEST_ASSERT(aurorafs_alloc_reserved(mount, 2, 1, &s) == -1 && stats_of(mount).reserved_blocks == free0 - 1,
+                "Allocating past a reservation fails and keeps it");
+    aurorafs_free_extent(mount, &e);
+    aurorafs_free_extent(mount, &big);
+    st = stats_of(mount);
+    TEST_ASSERT(st.reserved_blocks == 0 && st.free_blocks == free0, "All given back");
+
+    free(data);
+    free(back);
+}
+
+static void test_stale_blocks(void) {
+    printf("\nNew extents don't expose freed data:\n");
+
+    aurorafs_mount_t* mount = fresh_volume(0);
+    uint8_t* data = malloc(4 * BS);
+    memset(data, 0xAA, 4 * BS);
+
+    aurorafs_extent_t e;
+    aurorafs_allocate_extent(mount, 4 * BS, &e);
+    aurorafs_write_extent(mount, &e, data, 0, 4 * BS);
+    uint64_t old_start = e.physical_block;
+    aurorafs_free_extent(mount, &e);
+
+    current_cpu = 1;
+    aurorafs_allocate_extent(mount, 4 * BS, &e);
+    TEST_ASSERT(aurorafs_write_extent(mount, &e, data, BS + 50, 100) == 100 &&
+                e.physical_block == old_start, "Short write reuses the freed run");
+    current_cpu = 0;
+
+    uint8_t* back = malloc(4 * BS);
+    int clean = aurorafs_read_extent(mount, &e, back, 0, 4 * BS) == 4 * BS;
+    for (size_t i = 0; i < 4 * BS && clean; i++) {
+        clean = back[i] == ((i >= BS + 50 && i < BS + 150) ? 0xAA : 0);
+    }
+    TEST_ASSERT(clean, "Blocks and bytes the write didn't reach read as zeros");
+    aurorafs_free_extent(mount, &e);
+
+    free(data);
+    free(back);
+}
+
+static void test_random(void) {
+    printf("\nRandomized against a shadow bitmap:\n");
+
+    aurorafs_mount_t* mount = fresh_volume(0);
+    enum { LIVE = 512 };
+    uint64_t live_start[LIVE], live_len[LIVE];
+    uint32_t live = 0;
+    uint8_t* shadow = calloc(DEV_BLOCKS, 1);
+    int overlap = 0, verify = 0, spurious = 0;
+
+    for (int op = 0; op < 50000; op++) {
+        current_cpu = (uint32_t)(rng() % 6);
+        if (live < LIVE && (live == 0 || rng() % 100 < 55)) {
+            uint64_t n = (rng() % 4 == 0) ? 1 + rng() % 300 : 1 + rng() % 12;
+            uint64_t s;
+            if (aurorafs_alloc_blocks(mount, n, &s) == 0) {
+                for (uint64_t b = s; b < s + n; b++) {
+                    overlap |= shadow[b] || b < mount->data_start;
+                    shadow[b] = 1;
+                }
+                live_start[live] = s;
+                live_len[live++] = n;
+            } else {
+                /* Only allowed when no run of n is free */
+                uint64_t run = 0;
+                for (uint64_t b = mount->data_start; b < DEV_BLOCKS && run < n; b++) {
+                    run = shadow[b] ? 0 : run + 1;
+                }
+                spurious |= run >= n;
+            }
+        } else {
+            uint32_t i = (uint32_t)(rng() % live);
+            aurorafs_free_blocks(mount, live_start[i], live_len[i]);
+            memset(shadow + live_start[i], 0, live_len[i]);
+            live_start[i] = live_start[--live];
+            live_len[i] = live_len[live];
+        }
+        if (op % 2500 == 0) {
+            verify |= aurorafs_freespace_verify(mount);
+        }
+    }
+    current_cpu = 0;
+    TEST_ASSERT(!overlap, "No block handed out twice");
+    TEST_ASSERT(!spurious, "Allocation fails only when no run fits");
+    TEST_ASSERT(!verify && aurorafs_freespace_verify(mount) == 0, "Trees stay consistent");
+
+    uint64_t used = 0;
+    for (uint32_t i = 0; i < live; i++) {
+        used += live_len[i];
+    }
+    TEST_ASSERT(stats_of(mount).free_blocks == DEV_BLOCKS - mount->data_start - used,
+                "Free count matches");
+    for (uint32_t i = 0; i < live; i++) {
+        aurorafs_free_blocks(mount, live_start[i], live_len[i]);
+    }
+    TEST_ASSERT(stats_of(mount).extents == 1, "Everything merges back into one extent");
+    free(shadow);
+}
+
+/* ---- Threads ---- */
+
+#define THREADS         4
+#define THREAD_OPS      20000
+
+typedef struct {
+    aurorafs_mount_t* mount;
+    uint32_t cpu;
+    uint64_t seed;
+    uint8_t* owner;             /* Shared: which thread holds each block */
+    int errors;
+    uint64_t ops;
+} worker_t;
+
+static void* worker_main(void* arg) {
+    worker_t* w = (worker_t*)arg;
+    enum { LIVE = 64 };
+    uint64_t starts[LIVE], lens[LIVE];
+    uint32_t live = 0;
+    uint64_t state = w->seed;
+
+    current_cpu = w->cpu;
+    for (int op = 0; op < THREAD_OPS; op++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        if (live < LIVE && (live == 0 || state % 2)) {
+            uint64_t n = 1 + (state >> 8) % 16;
+            uint64_t s;
+            if (aurorafs_alloc_blocks(w->mount, n, &s) == 0) {
+                for (uint64_t b = s; b < s + n; b++) {
+                    uint8_t expect = 0;
+                    if (!__atomic_compare_exchange_n(&w->owner[b], &expect, (uint8_t)(w->cpu + 1),
+                                                      0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                        w->errors++;
+                    }
+                }
+                starts[live] = s;
+                lens[live++] = n;
+            }
+        } else {
+            uint32_t i = (uint32_t)((state >> 16) % live);
+            for (uint64_t b = starts[i]; b < starts[i] + lens[i]; b++) {
+                __atomic_store_n(&w->owner[b], 0, __ATOMIC_RELAXED);
+            }
+            if (aurorafs_free_blocks(w->mount, starts[i], lens[i]) != 0) {
+                w->errors++;
+            }
+            starts[i] = starts[--live];
+            lens[i] = lens[live];
+        }
+        w->ops++;
+    }
+    while (live) {
+        live--;
+        for (uint64_t b = starts[live]; b < starts[live] + lens[live]; b++) {
+            __atomic_store_n(&w->owner[b], 0, __ATOMIC_RELAXED);
+        }
+        aurorafs_free_blocks(w->mount, starts[live], lens[live]);
+    }
+    return NULL;
+}
+
+static void test_threads(void) {
+    printf("\nParallel allocators:\n");
+
+    aurorafs_mount_t* mount = fresh_volume(0);
+    uint8_t* owner = calloc(DEV_BLOCKS, 1);
+    worker_t workers[THREADS];
+    pthread_t threads[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        workers[t] = (worker_t){ mount, (uint32_t)t, 0x1234567ull * (uint64_t)(t + 1), owner, 0, 0 };
+        pthread_create(&threads[t], NULL, worker_main, &workers[t]);
+    }
+    int errors = 0;
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        errors += workers[t].errors;
+    }
+    TEST_ASSERT(errors == 0, "4 threads never share a block or fail a free");
+    aurorafs_freespace_stats_t st = stats_of(mount);
+    TEST_ASSERT(st.extents == 1 && st.free_blocks == DEV_BLOCKS - mount->data_start &&
+                aurorafs_freespace_verify(mount) == 0, "All space merged back");
+    free(owner);
+}
+
+/* ---- Benchmark ---- */
+
+#define TB_BLOCKS   (1ull << 28)            /* 1 TB of 4 KB blocks */
+
+typedef struct {
+    uint64_t start;
+    uint64_t len;
+} run_t;
+
+/* Fill to about 70% with mixed sizes, then free a random half, twice */
+static uint32_t age_volume(aurorafs_mount_t* mount, run_t* runs, uint32_t max_runs, uint64_t* ops_ns,
+                           uint64_t* ops) {
+    uint32_t live = 0;
+    uint64_t total = mount->superblock->total_blocks;
+    for (int cycle = 0; cycle < 2; cycle++) {
+        while (live < max_runs && mount->superblock->free_blocks > total * 3 / 10) {
+            uint64_t n = (rng() % 8 == 0) ? 1 + rng() % 8192 : 1 + rng() % 256;
+            current_cpu = (uint32_t)(rng() % 8);
+            uint64_t t0 = now_ns();
+            int r = aurorafs_alloc_blocks(mount, n, &runs[live].start);
+            *ops_ns += now_ns() - t0;
+            (*ops)++;
+            if (r != 0) {
+                break;
+            }
+            runs[live++].len = n;
+        }
+        for (uint32_t i = 0; i < live; ) {
+            if (rng() % 2) {
+                uint64_t t0 = now_ns();
+                aurorafs_free_blocks(mount, runs[i].start, runs[i].len);
+                *ops_ns += now_ns() - t0;
+                (*ops)++;
+                runs[i] = runs[--live];
+            } else {
+                i++;
+            }
+        }
+    }
+    current_cpu = 0;
+    return live;
+}
+
+/* Writers appending 16-block chunks to their own file in turn; returns
+ * average extents per 64 MB file */
+static double stream_fragments(aurorafs_mount_t* mount, int writers, int shared_goal) {
+    uint64_t last[16] = {0};
+    uint64_t extents = 0;
+    const int chunks = 1024;
+    run_t* taken = malloc(sizeof(run_t) * (size_t)writers * chunks);
+    uint32_t n = 0;
+    for (int c = 0; c < chunks; c++) {
+        for (int w = 0; w < writers; w++) {
+            uint64_t s;
+            current_cpu = shared_goal ? 0 : (uint32_t)w;
+            if (aurorafs_alloc_blocks(mount, 16, &s) != 0) {
+                continue;
+            }
+            if (c == 0 || s != last[w]) {
+                extents++;
+            }
+            last[w] = s + 16;
+            taken[n].start = s;
+            taken[n++].len = 16;
+        }
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        aurorafs_free_blocks(mount, taken[i].start, taken[i].len);
+    }
+    free(taken);
+    current_cpu = 0;
+    return (double)extents / writers;
+}
+
+typedef struct {
+    aurorafs_mount_t* mount;
+    uint32_t cpu;
+    uint64_t ops;
+} bench_worker_t;
+
+static void* bench_main(void* arg) {
+    bench_worker_t* w = (bench_worker_t*)arg;
+    current_cpu = w->cpu;
+    uint64_t state = 0x9E3779B9ull * (w->cpu + 1);
+    uint64_t starts[32], lens[32];
+    for (int i = 0; i < 32; i++) {
+        lens[i] = 0;
+    }
+    for (int op = 0; op < 200000; op++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        int i = (int)(state % 32);
+        if (lens[i]) {
+            aurorafs_free_blocks(w->mount, starts[i], lens[i]);
+            lens[i] = 0;
+        } else {
+            uint64_t n = 1 + (state >> 8) % 64;
+            if (aurorafs_alloc_blocks(w->mount, n, &starts[i]) == 0) {
+                lens[i] = n;
+            }
+        }
+        w->ops++;
+    }
+    for (int i = 0; i < 32; i++) {
+        if (lens[i]) {
+            aurorafs_free_blocks(w->mount, starts[i], lens[i]);
+        }
+    }
+    return NULL;
+}
+
+static void run_bench(void) {
+    printf("\nBenchmark (simulated 1 TB volume):\n");
+
+    mem_dev_t tb;
+    aurorafs_device_t tb_device;
+    tb.blocks = TB_BLOCKS;
+    tb.keep_blocks = 1 + (TB_BLOCKS + AURORAFS_BITMAP_BITS - 1) / AURORAFS_BITMAP_BITS;
+    tb.data = calloc(tb.keep_blocks, BS);
+    tb_device = (aurorafs_device_t){ TB_BLOCKS, &tb, mem_read, mem_write, NULL };
+    aurorafs_register_device("tb0", &tb_device);
+
+    if (aurorafs_get_mount()) {
+        aurorafs_unmount_device();
+    }
+    aurorafs_format("tb0", TB_BLOCKS * BS, 0);
+    uint64_t t0 = now_ns();
+    aurorafs_mount_device("tb0", NULL);
+    printf("  Mount, fresh:            %8.1f ms\n", (double)(now_ns() - t0) / 1e6);
+    aurorafs_mount_t* mount = aurorafs_get_mount();
+
+    double per_cpu = stream_fragments(mount, 8, 0);
+    double shared = stream_fragments(mount, 8, 1);
+    printf("  Stream fragments, fresh: %6.2f extents per 64 MB file with per-CPU goals, "
+           "%.2f with one shared goal (8 writers)\n", per_cpu, shared);
+
+    const uint32_t max_runs = 4000000;
+    run_t* runs = malloc(sizeof(run_t) * max_runs);
+    uint64_t ns = 0, ops = 0;
+    uint32_t live = age_volume(mount, runs, max_runs, &ns, &ops);
+    aurorafs_freespace_stats_t st = stats_of(mount);
+    printf("  Aging:                   %lu alloc/free ops, %.2f M ops/s, %lu runs live\n",
+           (unsigned long)ops, (double)ops / (double)ns * 1000.0, (unsigned long)live);
+    printf("  Aged free space:         %.1f%% free in %lu extents, largest %.1f GB\n",
+           100.0 * (double)st.free_blocks / (double)TB_BLOCKS, (unsigned long)st.extents,
+           (double)st.largest * BS / 1e9);
+
+    per_cpu = stream_fragments(mount, 8, 0);
+    shared = stream_fragments(mount, 8, 1);
+    printf("  Stream fragments, aged:  %6.2f extents per 64 MB file with per-CPU goals, "
+           "%.2f with one shared goal (8 writers)\n", per_cpu, shared);
+
+    t0 = now_ns();
+    aurorafs_unmount_device();
+    aurorafs_mount_device("tb0", NULL);
+    mount = aurorafs_get_mount();
+    printf("  Remount, aged:           %8.1f ms to rebuild %lu extents\n",
+           (double)(now_ns() - t0) / 1e6, (unsigned long)stats_of(mount).extents);
+
+    for (int threads = 1; threads <= 4; threads *= 2) {
+        bench_worker_t workers[4];
+        pthread_t ids[4];
+        t0 = now_ns();
+        for (int t = 0; t < threads; t++) {
+            workers[t] = (bench_worker_t){ mount, (uint32_t)t, 0 };
+            pthread_create(&ids[t], NULL, bench_main, &workers[t]);
+        }
+        uint64_t total = 0;
+        for (int t = 0; t < threads; t++) {
+            pthread_join(ids[t], NULL);
+            total += workers[t].ops;
+        }
+        uint64_t elapsed = now_ns() - t0;
+        printf("  Aged alloc/free, %d thread%s: %.2f M ops/s\n", threads, threads > 1 ? "s" : " ",
+               (double)total / (double)elapsed * 1000.0);
+    }
+    printf("  Trees consistent:        %s\n", aurorafs_freespace_verify(mount) == 0 ? "yes" : "NO");
+
+    aurorafs_unmount_device();
+    free(runs);
+    free(tb.data);
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("Aurora OS AuroraFS Free-Space Manager Tests\n");
+
+    mem.blocks = DEV_BLOCKS;
+    mem.keep_blocks = DEV_BLOCKS;
+    mem.data = calloc(DEV_BLOCKS, BS);
+    mem_device = (aurorafs_device_t){ DEV_BLOCKS, &mem, mem_read, mem_write, NULL };
+    aurorafs_init();
+    aurorafs_register_device("mem0", &mem_device);
+
+    test_build();
+    test_merge();
+    test_best_fit();
+    test_streams();
+    test_delalloc();
+    test_stale_blocks();
+    test_random();
+    test_threads();
+
+    if (bench) {
+        run_bench();
+    }
+    if (aurorafs_get_mount()) {
+        aurorafs_unmount_device();
+    }
+
+    free(mem.data);
+    printf("\nPassed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
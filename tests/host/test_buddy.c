@@ -0,0 +1,471 @@
+/**
+ * Aurora OS - Buddy Frame Allocator Tests
+ *
+ * Host-built harness for kernel/memory/buddy.c over a simulated 4 GB
+ * physical map (1M frames): split/merge, natural alignment, reserved
+ * ranges, contiguous DMA ranges, invalid frees, and a long random workload
+ * that tracks frame ownership to catch overlapping allocations. With
+ * --bench, measures alloc/free throughput (against the previous linear
+ * bitmap scan) and reports fragmentation after long random workloads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../kernel/memory/buddy.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/* 4 GB of 4 KB frames */
+#define SIM_FRAMES (1u << 20)
+
+static buddy_frame_t* g_meta;
+static buddy_zone_t g_zone;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* xorshift64 */
+static uint64_t g_rng = 0x9E3779B97F4A7C15ull;
+static uint64_t rnd(void) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return g_rng;
+}
+
+static void reset_zone(void) {
+    buddy_init(&g_zone, g_meta, 0, SIM_FRAMES);
+    buddy_add_range(&g_zone, 0, SIM_FRAMES);
+}
+
+/* ---- Previous frame allocator: linear bitmap scan from frame 0 ---- */
+
+static uint32_t* legacy_bitmap;
+
+static uint32_t legacy_first_free(void) {
+    for (uint32_t i = 0; i < SIM_FRAMES / 32; i++) {
+        if (legacy_bitmap[i] != 0xFFFFFFFF) {
+            for (uint32_t j = 0; j < 32; j++) {
+                if (!(legacy_bitmap[i] & (1u << j))) {
+                    return i * 32 + j;
+                }
+            }
+        }
+    }
+    return BUDDY_INVALID;
+}
+
+static uint32_t legacy_alloc(void) {
+    uint32_t f = legacy_first_free();
+    if (f != BUDDY_INVALID) {
+        legacy_bitmap[f / 32] |= 1u << (f % 32);
+    }
+    return f;
+}
+
+static void legacy_free(uint32_t f) {
+    legacy_bitmap[f / 32] &= ~(1u << (f % 32));
+}
+
+/* ---- Tests ---- */
+
+static void test_init(void) {
+    printf("\nInitialization:\n");
+
+    TEST_ASSERT(buddy_init(&g_zone, g_meta, 100, 1000) == -1,
+                "Unaligned zone base is rejected");
+
+    reset_zone();
+    buddy_stats_t st;
+    buddy_get_stats(&g_zone, &st);
+    TEST_ASSERT(st.free_frames == SIM_FRAMES && st.managed_frames == SIM_FRAMES,
+                "4 GB zone starts fully free");
+    TEST_ASSERT(st.free_blocks[BUDDY_MAX_ORDER] == SIM_FRAMES >> BUDDY_MAX_ORDER &&
+                st.free_blocks[0] == 0,
+                "Free memory is held as max-order blocks");
+    TEST_ASSERT(st.largest_free_order == BUDDY_MAX_ORDER && st.unusable_index[BUDDY_MAX_ORDER] == 0,
+                "No fragmentation at start");
+
+    /* Reserved low memory and an odd-sized range */
+    buddy_init(&g_zone, g_meta, 0, 4096);
+    buddy_add_range(&g_zone, 300, 3000);
+    buddy_get_stats(&g_zone, &st);
+    int low_ok = 1;
+    uint32_t got = 0;
+    for (;;) {
+        uint32_t pfn = buddy_alloc(&g_zone, 0);
+        if (pfn == BUDDY_INVALID) {
+            break;
+        }
+        if (pfn < 300 || pfn >= 3300) {
+            low_ok = 0;
+        }
+        got++;
+    }
+    TEST_ASSERT(st.free_frames == 3000 && got == 3000, "Exactly the added range is allocatable");
+    TEST_ASSERT(low_ok, "Reserved frames are never handed out");
+}
+
+static void test_split_merge(void) {
+    printf("\nSplit and merge:\n");
+    reset_zone();
+
+    int aligned = 1;
+    uint32_t blocks[BUDDY_NUM_ORDERS];
+    for (uint32_t o = 0; o <= BUDDY_MAX_ORDER; o++) {
+        blocks[o] = buddy_alloc(&g_zone, o);
+        if (blocks[o] == BUDDY_INVALID || (blocks[o] & ((1u << o) - 1))) {
+            aligned = 0;
+        }
+    }
+    TEST_ASSERT(aligned, "Every order returns a naturally aligned block");
+
+    buddy_stats_t st;
+    buddy_get_stats(&g_zone, &st);
+    uint32_t used = (1u << BUDDY_NUM_ORDERS) - 1;
+    TEST_ASSERT(st.free_frames == SIM_FRAMES - used, "Free count reflects all orders");
+
+    /* Order-0 allocation splits one max block down to order 0 */
+    reset_zone();
+    uint32_t a = buddy_alloc(&g_zone, 0);
+    buddy_get_stats(&g_zone, &st);
+    int one_each = 1;
+    for (uint32_t o = 0; o < BUDDY_MAX_ORDER; o++) {
+        if (st.free_blocks[o] != 1) {
+            one_each = 0;
+        }
+    }
+    TEST_ASSERT(one_each && st.splits == BUDDY_MAX_ORDER,
+                "Splitting a max block leaves one free buddy per order");
+    uint32_t b = buddy_alloc(&g_zone, 0);
+    TEST_ASSERT(b == (a ^ 1), "Next order-0 allocation is the buddy");
+
+    buddy_free(&g_zone, a);
+    buddy_free(&g_zone, b);
+    buddy_get_stats(&g_zone, &st);
+    TEST_ASSERT(st.free_blocks[BUDDY_MAX_ORDER] == SIM_FRAMES >> BUDDY_MAX_ORDER &&
+                st.free_frames == SIM_FRAMES,
+                "Freeing both buddies merges back to max order");
+
+    TEST_ASSERT(buddy_alloc(&g_zone, BUDDY_MAX_ORDER + 1) == BUDDY_INVALID,
+                "Orders above the maximum are rejected");
+}
+
+static void test_contig(void) {
+    printf("\nContiguous ranges:\n");
+    reset_zone();
+
+    uint32_t p = buddy_alloc_contig(&g_zone, 5);
+    buddy_stats_t st;
+    buddy_get_stats(&g_zone, &st);
+    TEST_ASSERT(p != BUDDY_INVALID && (p & 7) == 0, "5-frame range starts on an 8-frame boundary");
+    TEST_ASSERT(st.free_frames == SIM_FRAMES - 5, "Unused tail of the block is returned");
+
+    /* A 1080p 32bpp framebuffer: 8100 KB, more than one max-order block */
+    uint32_t fb_frames = (1920 * 1080 * 4 + 4095) / 4096;
+    uint32_t fb = buddy_alloc_contig(&g_zone, fb_frames);
+    buddy_get_stats(&g_zone, &st);
+    TEST_ASSERT(fb != BUDDY_INVALID && (fb & ((1u << BUDDY_MAX_ORDER) - 1)) == 0,
+                "Framebuffer range above 4 MB is allocated from adjacent max blocks");
+    TEST_ASSERT(st.free_frames == SIM_FRAMES - 5 - fb_frames, "Large range accounting");
+
+    TEST_ASSERT(buddy_free(&g_zone, p) == 0 && buddy_free(&g_zone, fb) == 0,
+                "Contiguous ranges free by start frame");
+    buddy_get_stats(&g_zone, &st);
+    TEST_ASSERT(st.free_frames == SIM_FRAMES &&
+                st.free_blocks[BUDDY_MAX_ORDER] == SIM_FRAMES >> BUDDY_MAX_ORDER,
+                "Everything merges back after freeing ranges");
+
+    /* Pin one frame in every max block: no 2-block run can exist */
+    buddy_init(&g_zone, g_meta, 0, 8192);
+    buddy_add_range(&g_zone, 0, 8192);
+    uint32_t pins[8];
+    for (int i = 0; i < 8; i++) {
+        pins[i] = buddy_alloc_contig(&g_zone, 1024);
+    }
+    for (int i = 0; i < 8; i++) {
+        buddy_free(&g_zone, pins[i]);
+        pins[i] = buddy_alloc_contig(&g_zone, 1023);
+    }
+    TEST_ASSERT(buddy_alloc_contig(&g_zone, 1025) == BUDDY_INVALID,
+                "Range fails when no adjacent free max blocks exist");
+    TEST_ASSERT(buddy_alloc_contig(&g_zone, 0) == BUDDY_INVALID, "Empty range is rejected");
+}
+
+static void test_invalid_free(void) {
+    printf("\nInvalid frees:\n");
+    reset_zone();
+
+    uint32_t a = buddy_alloc(&g_zone, 3);
+    uint32_t c = buddy_alloc_contig(&g_zone, 10);
+    TEST_ASSERT(buddy_free(&g_zone, a + 1) == -1, "Interior frame of a block is rejected");
+    TEST_ASSERT(buddy_free(&g_zone, c + 2) == -1, "Interior frame of a range is rejected");
+    TEST_ASSERT(buddy_free(&g_zone, SIM_FRAMES + 5) == -1, "Frame outside the zone is rejected");
+    TEST_ASSERT(buddy_free(&g_zone, a) == 0 && buddy_free(&g_zone, a) == -1,
+                "Double free is rejected");
+    TEST_ASSERT(buddy_free(&g_zone, c) == 0 && buddy_free(&g_zone, c) == -1,
+                "Double free of a range is rejected");
+
+    buddy_stats_t st;
+    buddy_get_stats(&g_zone, &st);
+    TEST_ASSERT(st.free_frames == SIM_FRAMES, "Rejected frees leave the zone consistent");
+}
+
+/* Live allocation record for the random workload */
+typedef struct {
+    uint32_t pfn;
+    uint32_t count;
+} live_t;
+
+static uint32_t random_order(void) {
+    /* Mostly single frames, geometric tail up to max order */
+    uint32_t o = 0;
+    while (o < BUDDY_MAX_ORDER && (rnd() & 3) == 0) {
+        o++;
+    }
+    return o;
+}
+
+/**
+ * Run a random alloc/free mix towards a target occupancy
+ * @param owner Optional per-frame owner map for overlap checks
+ * @return Number of overlapping allocations detected
+ */
+static uint32_t random_workload(live_t* live, uint32_t* count, uint32_t max_live,
+                                uint32_t ops, uint32_t target_pct, uint32_t* owner) {
+    uint32_t overlaps = 0;
+    for (uint32_t op = 0; op < ops; op++) {
+        uint32_t used = SIM_FRAMES - g_zone.free_frames;
+        int alloc = *count == 0 ||
+                    (*count < max_live && used * 100ull < (uint64_t)SIM_FRAMES * target_pct &&
+                     (rnd() % 100) < 60);
+        if (alloc) {
+            live_t l;
+            if (rnd() % 8 == 0) {
+                l.count = 1 + (uint32_t)(rnd() % 600);
+                l.pfn = buddy_alloc_contig(&g_zone, l.count);
+            } else {
+                uint32_t o = random_order();
+                l.count = 1u << o;
+                l.pfn = buddy_alloc(&g_zone, o);
+            }
+            if (l.pfn == BUDDY_INVALID) {
+                continue;
+            }
+            if (owner) {
+                for (uint32_t i = 0; i < l.count; i++) {
+                    if (owner[l.pfn + i]) {
+                        overlaps++;
+                    }
+                    owner[l.pfn + i] = op + 1;
+                }
+            }
+            live[(*count)++] = l;
+        } else {
+            uint32_t idx = (uint32_t)(rnd() % *count);
+            live_t l = live[idx];
+            if (owner) {
+                for (uint32_t i = 0; i < l.count; i++) {
+                    owner[l.pfn + i] = 0;
+                }
+            }
+            buddy_free(&g_zone, l.pfn);
+            live[idx] = live[--(*count)];
+        }
+    }
+    return overlaps;
+}
+
+static void test_random(void) {
+    printf("\nRandom workload:\n");
+    reset_zone();
+    g_rng = 42;
+
+    enum { MAX_LIVE = 200000 };
+    live_t* live = malloc(MAX_LIVE * sizeof(live_t));
+    uint32_t* owner = calloc(SIM_FRAMES, sizeof(uint32_t));
+    uint32_t count = 0;
+
+    uint32_t overlaps = random_workload(live, &count, MAX_LIVE, 1000000, 75, owner);
+
+    uint64_t live_frames = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        live_frames += live[i].count;
+    }
+    buddy_stats_t st;
+    buddy_get_stats(&g_zone, &st);
+    printf("    %u live allocations, %.1f%% of frames in use\n",
+           count, 100.0 * (double)live_frames / SIM_FRAMES);
+    TEST_ASSERT(overlaps == 0, "No frame is handed out twice");
+    TEST_ASSERT(st.free_frames + live_frames == SIM_FRAMES, "Free count matches live allocations");
+
+    uint32_t listed = 0;
+    for (uint32_t o = 0; o <= BUDDY_MAX_ORDER; o++) {
+        listed += st.free_blocks[o] << o;
+    }
+    TEST_ASSERT(listed == st.free_frames, "Free lists account for every free frame");
+
+    for (uint32_t i = 0; i < count; i++) {
+        buddy_free(&g_zone, live[i].pfn);
+    }
+    buddy_get_stats(&g_zone, &st);
+    TEST_ASSERT(st.free_frames == SIM_FRAMES &&
+                st.free_blocks[BUDDY_MAX_ORDER] == SIM_FRAMES >> BUDDY_MAX_ORDER,
+                "All blocks merge back to max order (no leaks)");
+
+    free(owner);
+    free(live);
+}
+
+/* ---- Benchmarks ---- */
+
+static void bench_throughput(void) {
+    printf("\nThroughput (alloc+free pairs per second, half of memory in use):\n");
+
+    enum { OPS = 2000000, HELD = 4096 };
+    uint32_t* held = malloc(HELD * sizeof(uint32_t));
+
+    /* Previous allocator: first half of the bitmap full, scan from zero */
+    memset(legacy_bitmap, 0, SIM_FRAMES / 8);
+    for (uint32_t i = 0; i < SIM_FRAMES / 2; i++) {
+        legacy_alloc();
+    }
+    for (uint32_t i = 0; i < HELD; i++) {
+        held[i] = legacy_alloc();
+    }
+    uint32_t legacy_ops = 20000;
+    uint64_t t0 = now_ns();
+    for (uint32_t i = 0; i < legacy_ops; i++) {
+        uint32_t idx = (uint32_t)(rnd() % HELD);
+        legacy_free(held[idx]);
+        held[idx] = legacy_alloc();
+    }
+    double legacy_rate = legacy_ops * 1e9 / (double)(now_ns() - t0);
+
+    /* Buddy, same occupancy */
+    reset_zone();
+    for (uint32_t i = 0; i < SIM_FRAMES / 2 / 1024; i++) {
+        buddy_alloc(&g_zone, BUDDY_MAX_ORDER);
+    }
+    for (uint32_t i = 0; i < HELD; i++) {
+        held[i] = buddy_alloc(&g_zone, 0);
+    }
+    t0 = now_ns();
+    for (uint32_t i = 0; i < OPS; i++) {
+        uint32_t idx = (uint32_t)(rnd() % HELD);
+        buddy_free(&g_zone, held[idx]);
+        held[idx] = buddy_alloc(&g_zone, 0);
+    }
+    double buddy_rate = OPS * 1e9 / (double)(now_ns() - t0);
+    printf("    single frames:  bitmap scan %10.0f/s   buddy %12.0f/s   (%.0fx)\n",
+           legacy_rate, buddy_rate, buddy_rate / legacy_rate);
+
+    /* Mixed orders */
+    reset_zone();
+    uint32_t* orders = malloc(HELD * sizeof(uint32_t));
+    for (uint32_t i = 0; i < HELD; i++) {
+        orders[i] = random_order();
+        held[i] = buddy_alloc(&g_zone, orders[i]);
+    }
+    t0 = now_ns();
+    for (uint32_t i = 0; i < OPS; i++) {
+        uint32_t idx = (uint32_t)(rnd() % HELD);
+        buddy_free(&g_zone, held[idx]);
+        orders[idx] = random_order();
+        held[idx] = buddy_alloc(&g_zone, orders[idx]);
+    }
+    printf("    mixed orders:   buddy %12.0f/s\n", OPS * 1e9 / (double)(now_ns() - t0));
+
+    /* Contiguous DMA-sized ranges */
+    reset_zone();
+    for (uint32_t i = 0; i < HELD; i++) {
+        held[i] = buddy_alloc_contig(&g_zone, 1 + (uint32_t)(rnd() % 64));
+    }
+    t0 = now_ns();
+    for (uint32_t i = 0; i < OPS; i++) {
+        uint32_t idx = (uint32_t)(rnd() % HELD);
+        buddy_free(&g_zone, held[idx]);
+        held[idx] = buddy_alloc_contig(&g_zone, 1 + (uint32_t)(rnd() % 64));
+    }
+    printf("    1-64 frame ranges: buddy %12.0f/s\n", OPS * 1e9 / (double)(now_ns() - t0));
+
+    free(orders);
+    free(held);
+}
+
+static void bench_fragmentation(void) {
+    printf("\nFragmentation after 5M random operations:\n");
+    printf("    %-7s %8s %8s %8s %10s %10s %10s %10s\n", "target", "in use", "live", "largest",
+           "unusable@0", "unusable@4", "unusable@8", "unusable@10");
+
+    enum { MAX_LIVE = 1000000 };
+    live_t* live = malloc(MAX_LIVE * sizeof(live_t));
+    static const uint32_t targets[] = { 25, 50, 75, 90 };
+
+    for (size_t t = 0; t < sizeof(targets) / sizeof(targets[0]); t++) {
+        reset_zone();
+        g_rng = 1000 + t;
+        uint32_t count = 0;
+        uint64_t t0 = now_ns();
+        random_workload(live, &count, MAX_LIVE, 5000000, targets[t], NULL);
+        uint64_t elapsed = now_ns() - t0;
+
+        buddy_stats_t st;
+        buddy_get_stats(&g_zone, &st);
+        printf("    %6u%% %7.1f%% %8u %8u %9.1f%% %9.1f%% %9.1f%% %9.1f%%   (%.1f Mops/s)\n",
+               targets[t], 100.0 * (SIM_FRAMES - st.free_frames) / SIM_FRAMES,
+               count, st.largest_free_order,
+               st.unusable_index[0] / 10.0, st.unusable_index[4] / 10.0,
+               st.unusable_index[8] / 10.0, st.unusable_index[10] / 10.0,
+               5000000 * 1e3 / (double)elapsed);
+    }
+    free(live);
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("Buddy Frame Allocator Tests\n");
+    printf("===========================\n");
+
+    g_meta = malloc(SIM_FRAMES * sizeof(buddy_frame_t));
+    legacy_bitmap = malloc(SIM_FRAMES / 8);
+    if (!g_meta || !legacy_bitmap) {
+        printf("Out of host memory\n");
+        return 1;
+    }
+
+    test_init();
+    test_split_merge();
+    test_contig();
+    test_invalid_free();
+    test_random();
+
+    if (bench) {
+        bench_throughput();
+        bench_fragmentation();
+    }
+
+    free(legacy_bitmap);
+    free(g_meta);
+
+    printf("\nPassed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
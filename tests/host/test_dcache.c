@@ -0,0 +1,438 @@
+/**
+ * Aurora OS - Dentry Cache Tests
+ *
+ * Host-built harness for filesystem/cache/dcache.c and the VFS path walk
+ * on top of it, on a ramdisk: repeated lookups served from the cache,
+ * negative dentries and their invalidation by create, unlink, rmdir and
+ * rename (including renamed directories), "." and "..", open files
+ * pinning their dentries, and LRU reclaim under the size limit. A small
+ * in-harness filesystem backs the benchmarks: its full-path lookup scans
+ * every node like the ramdisk's, its per-directory lookup binary-searches
+ * the directory. With --bench, stat() on a 16-level path and on random
+ * names in a directory of 100k files, with and without the dcache.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include "../../filesystem/cache/dcache.h"
+#include "../../filesystem/vfs/vfs.h"
+#include "../../filesystem/ramdisk/ramdisk.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/* ---- Kernel service stubs ---- */
+
+void* kmalloc(size_t size) {
+    return malloc(size);
+}
+
+void kfree(void* ptr) {
+    free(ptr);
+}
+
+uint32_t smp_get_current_cpu_id(void) {
+    return 0;
+}
+
+void cpu_relax(void) {
+    sched_yield();
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static dcache_stats_t stats_now(void) {
+    dcache_stats_t st;
+    dcache_get_stats(&st);
+    return st;
+}
+
+static int exists(const char* path) {
+    inode_t st;
+    return vfs_stat(path, &st) == 0;
+}
+
+static void setup_ramdisk(void) {
+    ramdisk_create(0);
+    vfs_init();
+    vfs_register_fs("ramdisk", ramdisk_get_ops());
+    vfs_mount("ramdisk0", "/", "ramdisk");
+}
+
+/* ---- Cached lookups ---- */
+
+static void test_lookup(void) {
+    printf("\nCached lookups:\n");
+
+    setup_ramdisk();
+    vfs_mkdir("/a");
+    vfs_mkdir("/a/b");
+    vfs_mkdir("/a/b/c");
+    vfs_create("/a/b/c/file");
+
+    dcache_stats_t before = stats_now();
+    TEST_ASSERT(exists("/a/b/c/file"), "Deep path resolves");
+    dcache_stats_t mid = stats_now();
+    TEST_ASSERT(mid.misses - before.misses == 4, "First walk misses each component");
+    TEST_ASSERT(exists("/a/b/c/file"), "Second walk resolves");
+    dcache_stats_t after = stats_now();
+    TEST_ASSERT(after.misses == mid.misses && after.hits - mid.hits == 4,
+                "Second walk is served from the cache");
+
+    TEST_ASSERT(exists("a/b/c/file"), "Relative-looking path walks from the root");
+    TEST_ASSERT(exists("/a//b/./c/../c/file"), "Extra slashes, . and .. are followed");
+    TEST_ASSERT(exists("/../a"), ".. at the root stays at the root");
+    TEST_ASSERT(!exists("/a/b/c/file/x"), "Regular file is not walked into");
+
+    inode_t st;
+    vfs_stat("/a/b/c/file", &st);
+    TEST_ASSERT(st.type == FILE_TYPE_REGULAR, "Stat through the cache returns the inode");
+    vfs_chmod("/a/b/c/file", 0x1FF);
+    vfs_stat("/a/b/c/file", &st);
+    TEST_ASSERT(st.mode == 0x1FF, "chmod is visible through a cached dentry");
+
+    /* Negative dentries */
+    before = stats_now();
+    TEST_ASSERT(!exists("/a/missing"), "Missing name fails");
+    TEST_ASSERT(!exists("/a/missing"), "Missing name fails again");
+    after = stats_now();
+    TEST_ASSERT(after.negative_hits - before.negative_hits == 1, "Second miss is a negative hit");
+    TEST_ASSERT(after.negative >= 1, "Negative dentry is counted");
+
+    TEST_ASSERT(vfs_create("/a/missing") == 0 && exists("/a/missing"), "Create replaces the negative dentry");
+    int fd = vfs_open("/a/other", O_RDWR);
+    TEST_ASSERT(fd < 0, "Open without O_CREAT fails on a missing name");
+    fd = vfs_open("/a/other", O_RDWR | O_CREAT);
+    TEST_ASSERT(fd >= 0 && exists("/a/other"), "O_CREAT replaces the negative dentry");
+    vfs_close(fd);
+    TEST_ASSERT(!exists("/a/newdir") && vfs_mkdir("/a/newdir") == 0 && exists("/a/newdir"),
+                "mkdir replaces the negative dentry");
+
+    /* Invalidation */
+    TEST_ASSERT(vfs_unlink("/a/missing") == 0 && !exists("/a/missing"), "Unlinked file is gone");
+    TEST_ASSERT(vfs_rmdir("/a/newdir") == 0 && !exists("/a/newdir"), "Removed directory is gone");
+
+    TEST_ASSERT(vfs_rename("/a/other", "/a/renamed") == 0, "Rename file");
+    TEST_ASSERT(!exists("/a/other") && exists("/a/renamed"), "Old name gone, new name found");
+
+    exists("/a/b/c/file");
+    TEST_ASSERT(vfs_rename("/a/b", "/a/z") == 0, "Rename directory");
+    TEST_ASSERT(!exists("/a/b/c/file") && !exists("/a/b"), "Old subtree no longer resolves");
+    TEST_ASSERT(exists("/a/z/c/file"), "Subtree resolves under the new name");
+    fd = vfs_open("/a/z/c/file", O_RDWR);
+    TEST_ASSERT(fd >= 0 && vfs_write(fd, "hello", 5) == 5, "File under renamed directory is usable");
+    vfs_close(fd);
+    TEST_ASSERT(vfs_unlink("/a/z/c/file") == 0 && !exists("/a/z/c/file"),
+                "Filesystem agrees on the renamed path");
+}
+
+/* ---- References and reclaim ---- */
+
+static void test_refcount(void) {
+    printf("\nReferences and reclaim:\n");
+
+    setup_ramdisk();
+    vfs_mkdir("/d");
+    vfs_mkdir("/d/e");
+    vfs_create("/d/e/f");
+
+    int fd = vfs_open("/d/e/f", O_RDONLY);
+    dcache_shrink(UINT32_MAX);
+    dcache_stats_t st = stats_now();
+    TEST_ASSERT(st.dentries == 4, "Open file pins its dentry and ancestors");
+
+    dcache_stats_t before = stats_now();
+    exists("/d/e/f");
+    dcache_stats_t after = stats_now();
+    TEST_ASSERT(after.misses == before.misses, "Pinned path still hits after shrink");
+
+    vfs_unlink("/d/e/f");
+    TEST_ASSERT(!exists("/d/e/f"), "Unlinked while open: name is gone");
+    vfs_close(fd);
+    dcache_shrink(UINT32_MAX);
+    st = stats_now();
+    TEST_ASSERT(st.dentries == 1, "Close releases everything but the root");
+
+    int dfd = vfs_opendir("/d/e");
+    dcache_shrink(UINT32_MAX);
+    st = stats_now();
+    TEST_ASSERT(st.dentries == 3, "Open directory pins its dentry");
+    vfs_closedir(dfd);
+    dcache_shrink(UINT32_MAX);
+    TEST_ASSERT(stats_now().dentries == 1, "Closedir releases it");
+
+    /* LRU limit with negative lookups of many names */
+    dcache_set_limit(16);
+    char path[32];
+    uint32_t peak = 0;
+    for (int i = 0; i < 200; i++) {
+        snprintf(path, sizeof(path), "/d/n%d", i);
+        exists(path);
+        uint32_t n = stats_now().dentries;
+        if (n > peak) {
+            peak = n;
+        }
+    }
+    st = stats_now();
+    TEST_ASSERT(peak <= 16, "Cache never exceeds its limit");
+    TEST_ASSERT(st.evictions >= 180, "Older dentries are evicted");
+
+    before = stats_now();
+    exists("/d/n199");
+    after = stats_now();
+    TEST_ASSERT(after.misses == before.misses, "Most recent name is still cached");
+    before = stats_now();
+    exists("/d/n0");
+    after = stats_now();
+    TEST_ASSERT(after.misses > before.misses, "Oldest name was reclaimed");
+
+    dcache_set_limit(DCACHE_DEFAULT_MAX_DENTRIES);
+
+    /* Remount drops the whole tree */
+    exists("/d/e");
+    vfs_unmount("/");
+    TEST_ASSERT(stats_now().dentries == 0, "Unmount empties the cache");
+}
+
+/* ---- In-harness filesystem with linear lookups ---- */
+
+typedef struct {
+    inode_t inode;
+    char path[96];
+    const char* name;               /* Last component of path */
+    uint32_t parent;
+    uint32_t first_child;           /* Children are contiguous and sorted */
+    uint32_t nchildren;
+} sim_node_t;
+
+static sim_node_t* sim_nodes;
+static uint32_t sim_count;
+static uint64_t sim_lookups;        /* Filesystem lookups of either kind */
+
+static uint32_t sim_add(uint32_t parent, const char* name, file_type_t type) {
+    sim_node_t* node = &sim_nodes[sim_count];
+    memset(node, 0, sizeof(*node));
+    if (sim_count == 0) {
+        strcpy(node->path, "/");
+        node->name = node->path;
+    } else {
+        char path[2 * sizeof(node->path)];
+        snprintf(path, sizeof(path), "%s%s%.31s", sim_nodes[parent].path,
+                 parent == 0 ? "" : "/", name);
+        path[sizeof(node->path) - 1] = '\0';
+        strcpy(node->path, path);
+        node->name = node->path + strlen(node->path) - strlen(name);
+    }
+    node->parent = parent;
+    if (sim_count != 0) {
+        if (sim_nodes[parent].nchildren++ == 0) {
+            sim_nodes[parent].first_child = sim_count;
+        }
+    }
+    node->inode.ino = sim_count;
+    node->inode.type = type;
+    node->inode.mode = type == FILE_TYPE_DIRECTORY ? DEFAULT_DIR_MODE : DEFAULT_FILE_MODE;
+    node->inode.parent_ino = parent;
+    return sim_count++;
+}
+
+static int sim_mount(const char* device) {
+    (void)device;
+    return 0;
+}
+
+static inode_t* sim_lookup(const char* path) {
+    sim_lookups++;
+    for (uint32_t i = 0; i < sim_count; i++) {
+        if (strcmp(sim_nodes[i].path, path) == 0) {
+            return &sim_nodes[i].inode;
+        }
+    }
+    return NULL;
+}
+
+static inode_t* sim_lookup_child(inode_t* dir, const char* name) {
+    sim_lookups++;
+    uint32_t lo = sim_nodes[dir->ino].first_child;
+    uint32_t hi = lo + sim_nodes[dir->ino].nchildren;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(sim_nodes[mid].name, name);
+        if (cmp == 0) {
+            return &sim_nodes[mid].inode;
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+static fs_ops_t sim_ops_dcache = {
+    .mount = sim_mount,
+    .lookup = sim_lookup,
+    .lookup_child = sim_lookup_child
+};
+
+static fs_ops_t sim_ops_plain = {
+    .mount = sim_mount,
+    .lookup = sim_lookup
+};
+
+#define BENCH_DEPTH     16
+#define BENCH_FILES     100000
+
+static char deep_path[256];
+
+static void sim_build(void) {
+    sim_nodes = calloc(BENCH_DEPTH + BENCH_FILES + 2, sizeof(sim_node_t));
+    sim_count = 0;
+    sim_add(0, "/", FILE_TYPE_DIRECTORY);
+
+    /* /big holds the many files, /d0 starts a 16-level chain; each
+     * directory's children are added together and in name order */
+    uint32_t big = sim_add(0, "big", FILE_TYPE_DIRECTORY);
+    uint32_t dir = sim_add(0, "d0", FILE_TYPE_DIRECTORY);
+    for (uint32_t i = 0; i < BENCH_FILES; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "f%06u", i);
+        sim_add(big, name, FILE_TYPE_REGULAR);
+    }
+
+    for (int level = 1; level < BENCH_DEPTH; level++) {
+        char name[8];
+        snprintf(name, sizeof(name), "d%d", level);
+        dir = sim_add(dir, name, level == BENCH_DEPTH - 1 ? FILE_TYPE_REGULAR : FILE_TYPE_DIRECTORY);
+    }
+    strcpy(deep_path, sim_nodes[dir].path);
+}
+
+static void sim_mount_with(int dcache) {
+    vfs_init();
+    vfs_register_fs("simfs", dcache ? &sim_ops_dcache : &sim_ops_plain);
+    vfs_mount("sim0", "/", "simfs");
+}
+
+static void test_simfs(void) {
+    printf("\nLarge directory:\n");
+
+    sim_build();
+    sim_mount_with(1);
+
+    inode_t st;
+    TEST_ASSERT(vfs_stat(deep_path, &st) == 0 && st.type == FILE_TYPE_REGULAR, "16-level path resolves");
+    uint64_t before = sim_lookups;
+    vfs_stat(deep_path, &st);
+    TEST_ASSERT(sim_lookups == before, "Repeated deep stat makes no filesystem lookups");
+
+    TEST_ASSERT(vfs_stat("/big/f099999", &st) == 0 && st.ino == BENCH_FILES + 2, "Last of 100k files resolves");
+    TEST_ASSERT(vfs_stat("/big/f100000", &st) != 0, "Name past the end is missing");
+    before = sim_lookups;
+    vfs_stat("/big/f100000", &st);
+    TEST_ASSERT(sim_lookups == before, "Missing name is answered by a negative dentry");
+
+    sim_mount_with(0);
+    TEST_ASSERT(vfs_stat(deep_path, &st) == 0, "Same path resolves without lookup_child");
+    TEST_ASSERT(stats_now().dentries == 0, "Filesystem without lookup_child is not cached");
+}
+
+/* ---- Benchmark ---- */
+
+static void bench_stat(const char* label, int random, int iterations) {
+    inode_t st;
+    char path[32];
+    uint64_t lookups = sim_lookups;
+    uint64_t start = now_ns();
+
+    for (int i = 0; i < iterations; i++) {
+        if (random) {
+            snprintf(path, sizeof(path), "/big/f%06u", (uint32_t)(rng() % BENCH_FILES));
+            vfs_stat(path, &st);
+        } else {
+            vfs_stat(deep_path, &st);
+        }
+    }
+
+    uint64_t elapsed = now_ns() - start;
+    printf("  %-34s %10.0f ns/stat  %6.2f fs lookups/stat\n", label,
+           (double)elapsed / iterations, (double)(sim_lookups - lookups) / iterations);
+}
+
+static void run_bench(void) {
+    printf("\nBenchmark (stat, %d-level path, %d-file directory):\n", BENCH_DEPTH, BENCH_FILES);
+
+    /* Full-path lookups, linear over every node */
+    sim_mount_with(0);
+    bench_stat("deep path, no dcache", 0, 2000);
+    bench_stat("100k dir random, no dcache", 1, 2000);
+
+    /* Walk through the dcache, sized to hold the directory */
+    sim_mount_with(1);
+    dcache_set_limit(BENCH_FILES + 1024);
+    bench_stat("deep path, dcache", 0, 1000000);
+
+    uint64_t start = now_ns();
+    inode_t st;
+    char path[32];
+    for (uint32_t i = 0; i < BENCH_FILES; i++) {
+        snprintf(path, sizeof(path), "/big/f%06u", i);
+        vfs_stat(path, &st);
+    }
+    printf("  %-34s %10.1f ms\n", "populate 100k dentries", (double)(now_ns() - start) / 1e6);
+    bench_stat("100k dir random, dcache warm", 1, 1000000);
+
+    /* Default limit: most of the directory does not fit */
+    dcache_set_limit(DCACHE_DEFAULT_MAX_DENTRIES);
+    bench_stat("100k dir random, 4k-entry dcache", 1, 2000);
+
+    dcache_stats_t ds = stats_now();
+    printf("  lookups %llu  hits %llu  negative hits %llu  evictions %llu\n",
+           (unsigned long long)ds.lookups, (unsigned long long)ds.hits,
+           (unsigned long long)ds.negative_hits, (unsigned long long)ds.evictions);
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("Aurora OS Dentry Cache Tests\n");
+
+    test_lookup();
+    test_refcount();
+    test_simfs();
+
+    if (bench) {
+        run_bench();
+    }
+
+    printf("\nPassed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
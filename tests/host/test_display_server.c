@@ -0,0 +1,817 @@
+/**
+ * Aurora OS - X11/Wayland Display Server Tests
+ *
+ * Host-built harness for display_server.c. Plays an X client: creates
+ * windows, pixmaps and GCs, fills rectangles, puts images and copies
+ * areas, checking the framebuffer after each flush. Requests are sent both
+ * one at a time and as a buffered byte stream split at arbitrary points.
+ * Then plays Wayland clients committing wl_shm buffers with damage.
+ * With --bench, measures X11 requests per second for fill-heavy and
+ * image-heavy traces, and Wayland commit-to-scanout latency for clients
+ * paced at 60 and 120 Hz.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../include/platform/display_server.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+#define SCREEN_W    1024
+#define SCREEN_H    768
+#define ROOT        1
+#define BASE        0x00200000u     /* First client's resource id base */
+
+static uint32_t* g_fb;
+static int g_client;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* ---- Request encoding (LSB first) ---- */
+
+typedef struct {
+    uint8_t* p;
+    uint32_t len;
+} req_t;
+
+static void put8(req_t* r, uint8_t v) { r->p[r->len++] = v; }
+static void put16(req_t* r, uint16_t v) { put8(r, (uint8_t)v); put8(r, (uint8_t)(v >> 8)); }
+static void put32(req_t* r, uint32_t v) { put16(r, (uint16_t)v); put16(r, (uint16_t)(v >> 16)); }
+
+static void begin(req_t* r, uint8_t* buf, uint8_t opcode, uint8_t data) {
+    r->p = buf;
+    r->len = 0;
+    put8(r, opcode);
+    put8(r, data);
+    put16(r, 0);
+}
+
+static uint32_t finish(req_t* r) {
+    while (r->len & 3) put8(r, 0);
+    r->p[2] = (uint8_t)(r->len / 4);
+    r->p[3] = (uint8_t)(r->len / 4 >> 8);
+    return r->len;
+}
+
+static uint32_t mk_create_window(uint8_t* buf, uint32_t id, uint32_t parent, int16_t x, int16_t y,
+                                 uint16_t w, uint16_t h, uint16_t border, int64_t background) {
+    req_t r;
+    begin(&r, buf, X11_CreateWindow, 0);
+    put32(&r, id);
+    put32(&r, parent);
+    put16(&r, (uint16_t)x);
+    put16(&r, (uint16_t)y);
+    put16(&r, w);
+    put16(&r, h);
+    put16(&r, border);
+    put16(&r, 1);                       /* InputOutput */
+    put32(&r, 0);                       /* CopyFromParent visual */
+    if (background >= 0) {
+        put32(&r, 1u << 1);             /* background-pixel */
+        put32(&r, (uint32_t)background);
+    } else {
+        put32(&r, 0);
+    }
+    return finish(&r);
+}
+
+static uint32_t mk_id(uint8_t* buf, uint8_t opcode, uint32_t id) {
+    req_t r;
+    begin(&r, buf, opcode, 0);
+    put32(&r, id);
+    return finish(&r);
+}
+
+static uint32_t mk_create_gc(uint8_t* buf, uint32_t id, uint32_t drawable, uint8_t function, uint32_t fg) {
+    req_t r;
+    begin(&r, buf, X11_CreateGC, 0);
+    put32(&r, id);
+    put32(&r, drawable);
+    put32(&r, (1u << 0) | (1u << 2));   /* function, foreground */
+    put32(&r, function);
+    put32(&r, fg);
+    return finish(&r);
+}
+
+static uint32_t mk_change_gc_fg(uint8_t* buf, uint32_t id, uint32_t fg) {
+    req_t r;
+    begin(&r, buf, X11_ChangeGC, 0);
+    put32(&r, id);
+    put32(&r, 1u << 2);
+    put32(&r, fg);
+    return finish(&r);
+}
+
+static uint32_t mk_fill(uint8_t* buf, uint32_t drawable, uint32_t gc, const int16_t* rects, uint32_t n) {
+    req_t r;
+    begin(&r, buf, X11_PolyFillRectangle, 0);
+    put32(&r, drawable);
+    put32(&r, gc);
+    for (uint32_t i = 0; i < n * 4; i++) {
+        put16(&r, (uint16_t)rects[i]);
+    }
+    return finish(&r);
+}
+
+static uint32_t mk_put_image(uint8_t* buf, uint32_t drawable, uint32_t gc, int16_t x, int16_t y,
+                             uint16_t w, uint16_t h, uint8_t depth, const uint32_t* pixels) {
+    req_t r;
+    begin(&r, buf, X11_PutImage, X11_IMAGE_ZPIXMAP);
+    put32(&r, drawable);
+    put32(&r, gc);
+    put16(&r, w);
+    put16(&r, h);
+    put16(&r, (uint16_t)x);
+    put16(&r, (uint16_t)y);
+    put8(&r, 0);
+    put8(&r, depth);
+    put16(&r, 0);
+    memcpy(buf + r.len, pixels, (size_t)w * h * 4);
+    r.len += w * h * 4;
+    return finish(&r);
+}
+
+static uint32_t mk_create_pixmap(uint8_t* buf, uint32_t id, uint32_t drawable, uint16_t w, uint16_t h, uint8_t depth) {
+    req_t r;
+    begin(&r, buf, X11_CreatePixmap, depth);
+    put32(&r, id);
+    put32(&r, drawable);
+    put16(&r, w);
+    put16(&r, h);
+    return finish(&r);
+}
+
+static uint32_t mk_copy_area(uint8_t* buf, uint32_t src, uint32_t dst, uint32_t gc,
+                             int16_t sx, int16_t sy, int16_t dx, int16_t dy, uint16_t w, uint16_t h) {
+    req_t r;
+    begin(&r, buf, X11_CopyArea, 0);
+    put32(&r, src);
+    put32(&r, dst);
+    put32(&r, gc);
+    put16(&r, (uint16_t)sx);
+    put16(&r, (uint16_t)sy);
+    put16(&r, (uint16_t)dx);
+    put16(&r, (uint16_t)dy);
+    put16(&r, w);
+    put16(&r, h);
+    return finish(&r);
+}
+
+static int send(uint8_t* buf, uint32_t len) {
+    return x11_process_request((uint32_t)g_client, buf[0], buf, len);
+}
+
+static int rect_is(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t value) {
+    for (uint32_t j = 0; j < h; j++) {
+        for (uint32_t i = 0; i < w; i++) {
+            if (g_fb[(y + j) * SCREEN_W + x + i] != value) return 0;
+        }
+    }
+    return 1;
+}
+
+static void clear_screen(void) {
+    static uint8_t buf[64];
+    int16_t all[] = { 0, 0, SCREEN_W, SCREEN_H };
+    send(buf, mk_change_gc_fg(buf, BASE + 1, 0));
+    send(buf, mk_fill(buf, ROOT, BASE + 1, all, 1));
+}
+
+/* ---- Tests ---- */
+
+static void test_windows_and_fills(void) {
+    uint8_t buf[256];
+
+    printf("\nWindows and PolyFillRectangle:\n");
+
+    TEST_ASSERT(send(buf, mk_create_gc(buf, BASE + 1, ROOT, X11_GXcopy, 0)) == 0, "CreateGC on root");
+    clear_screen();
+    TEST_ASSERT(rect_is(0, 0, SCREEN_W, SCREEN_H, 0), "Root fill reaches the framebuffer");
+
+    TEST_ASSERT(send(buf, mk_create_window(buf, BASE + 2, ROOT, 100, 50, 200, 100, 2, 0x00336699)) == 0,
+                "CreateWindow with background pixel");
+    TEST_ASSERT(rect_is(100, 50, 204, 104, 0), "Unmapped window is not drawn");
+    TEST_ASSERT(send(buf, mk_id(buf, X11_MapWindow, BASE + 2)) == 0, "MapWindow");
+    TEST_ASSERT(rect_is(102, 52, 200, 100, 0x00336699) && rect_is(100, 50, 2, 104, 0),
+                "Mapping paints the interior inside the border");
+
+    int16_t rects[] = { -10, -10, 30, 30, 190, 90, 50, 50, 50, 40, 20, 10 };
+    TEST_ASSERT(send(buf, mk_create_gc(buf, BASE + 3, BASE + 2, X11_GXcopy, 0x00FF0000)) == 0, "CreateGC on window");
+    TEST_ASSERT(send(buf, mk_fill(buf, BASE + 2, BASE + 3, rects, 3)) == 0, "PolyFillRectangle with 3 rects");
+    TEST_ASSERT(rect_is(102, 52, 20, 20, 0x00FF0000) && rect_is(122, 52, 1, 1, 0x00336699),
+                "Rect crossing the window origin is clipped to the interior");
+    TEST_ASSERT(rect_is(292, 142, 10, 10, 0x00FF0000) && rect_is(302, 152, 2, 2, 0),
+                "Rect crossing the far corner stops at the interior edge");
+    TEST_ASSERT(rect_is(152, 92, 20, 10, 0x00FF0000), "Interior rect drawn at window offset");
+
+    /* Child window clipped by its parent */
+    send(buf, mk_create_window(buf, BASE + 4, BASE + 2, 180, 80, 100, 100, 0, 0x0000FF00));
+    send(buf, mk_id(buf, X11_MapWindow, BASE + 4));
+    TEST_ASSERT(rect_is(282, 132, 20, 20, 0x0000FF00) && rect_is(302, 152, 2, 2, 0),
+                "Child window is clipped to its parent");
+
+    send(buf, mk_id(buf, X11_UnmapWindow, BASE + 2));
+    uint32_t before = g_fb[(60) * SCREEN_W + 110];
+    send(buf, mk_fill(buf, BASE + 4, BASE + 3, rects, 3));
+    send(buf, mk_fill(buf, BASE + 2, BASE + 3, rects + 8, 1));
+    TEST_ASSERT(g_fb[60 * SCREEN_W + 110] == before && rect_is(152, 92, 20, 10, 0x00FF0000),
+                "Drawing into an unmapped window (or its child) is discarded");
+    send(buf, mk_id(buf, X11_MapWindow, BASE + 2));
+
+    /* Non-copy function */
+    uint8_t gbuf[64];
+    int16_t one[] = { 0, 0, 4, 4 };
+    send(gbuf, mk_create_gc(gbuf, BASE + 5, ROOT, 0x6 /* GXxor */, 0x00FFFFFF));
+    send(buf, mk_fill(buf, ROOT, BASE + 5, one, 1));
+    TEST_ASSERT(rect_is(0, 0, 4, 4, 0x00FFFFFF), "GXxor onto black gives the foreground");
+    send(buf, mk_fill(buf, ROOT, BASE + 5, one, 1));
+    TEST_ASSERT(rect_is(0, 0, 4, 4, 0), "Second GXxor restores the original");
+}
+
+static void test_images_and_pixmaps(void) {
+    uint8_t* buf = malloc(70000);
+    uint32_t img[32 * 16];
+    for (int i = 0; i < 32 * 16; i++) img[i] = 0x00010203u * (uint32_t)i;
+
+    printf("\nPutImage, pixmaps and CopyArea:\n");
+    clear_screen();
+
+    TEST_ASSERT(send(buf, mk_put_image(buf, ROOT, BASE + 1, 10, 20, 32, 16, 24, img)) == 0, "PutImage 32x16 to root");
+    int ok = 1;
+    for (int y = 0; y < 16; y++) {
+        if (memcmp(g_fb + (20 + y) * SCREEN_W + 10, img + y * 32, 32 * 4) != 0) ok = 0;
+    }
+    TEST_ASSERT(ok, "Image pixels land unchanged");
+
+    send(buf, mk_put_image(buf, ROOT, BASE + 1, SCREEN_W - 8, -4, 32, 16, 24, img));
+    ok = 1;
+    for (int y = 0; y < 12; y++) {
+        if (memcmp(g_fb + y * SCREEN_W + SCREEN_W - 8, img + (y + 4) * 32, 8 * 4) != 0) ok = 0;
+    }
+    TEST_ASSERT(ok, "Image clipped at the screen corner keeps source offsets");
+
+    TEST_ASSERT(send(buf, mk_put_image(buf, ROOT, BASE + 1, 0, 0, 32, 16, 32, img)) == -X11_BadMatch,
+                "Depth mismatch is BadMatch");
+    uint32_t len = mk_put_image(buf, ROOT, BASE + 1, 0, 0, 32, 16, 24, img);
+    buf[2] = (uint8_t)(len / 4 - 1);
+    TEST_ASSERT(send(buf, len - 4) == -X11_BadLength, "Truncated image data is BadLength");
+
+    TEST_ASSERT(send(buf, mk_create_pixmap(buf, BASE + 10, ROOT, 32, 16, 24)) == 0, "CreatePixmap 32x16");
+    TEST_ASSERT(send(buf, mk_put_image(buf, BASE + 10, BASE + 1, 0, 0, 32, 16, 24, img)) == 0,
+                "PutImage into the pixmap");
+    TEST_ASSERT(send(buf, mk_copy_area(buf, BASE + 10, ROOT, BASE + 1, 4, 2, 300, 300, 28, 14)) == 0,
+                "CopyArea pixmap to root");
+    ok = 1;
+    for (int y = 0; y < 14; y++) {
+        if (memcmp(g_fb + (300 + y) * SCREEN_W + 300, img + (2 + y) * 32 + 4, 28 * 4) != 0) ok = 0;
+    }
+    TEST_ASSERT(ok, "Copied region matches the pixmap contents");
+    TEST_ASSERT(rect_is(328, 300, 4, 14, 0), "CopyArea source clipping leaves the rest untouched");
+
+    /* Overlapping scroll down and right on the screen */
+    send(buf, mk_copy_area(buf, ROOT, ROOT, BASE + 1, 300, 300, 303, 305, 28, 14));
+    ok = 1;
+    for (int y = 0; y < 14; y++) {
+        if (memcmp(g_fb + (305 + y) * SCREEN_W + 303, img + (2 + y) * 32 + 4, 28 * 4) != 0) ok = 0;
+    }
+    TEST_ASSERT(ok, "Overlapping CopyArea moves pixels without smearing");
+
+    TEST_ASSERT(send(buf, mk_id(buf, X11_FreePixmap, BASE + 10)) == 0, "FreePixmap");
+    TEST_ASSERT(send(buf, mk_copy_area(buf, BASE + 10, ROOT, BASE + 1, 0, 0, 0, 0, 4, 4)) == -X11_BadDrawable,
+                "Freed pixmap is no longer a drawable");
+    free(buf);
+}
+
+static void test_errors_and_resources(void) {
+    uint8_t buf[256];
+    int16_t one[] = { 0, 0, 1, 1 };
+
+    printf("\nErrors and resource table:\n");
+
+    TEST_ASSERT(send(buf, mk_fill(buf, ROOT, BASE + 999, one, 1)) == -X11_BadGC, "Unknown GC is BadGC");
+    TEST_ASSERT(send(buf, mk_fill(buf, BASE + 999, BASE + 1, one, 1)) == -X11_BadDrawable,
+                "Unknown drawable is BadDrawable");
+    TEST_ASSERT(send(buf, mk_fill(buf, ROOT, BASE + 2, one, 1)) == -X11_BadGC,
+                "Window id used as a GC is BadGC");
+    TEST_ASSERT(send(buf, mk_create_gc(buf, 0x00400001, ROOT, X11_GXcopy, 0)) == -X11_BadIDChoice,
+                "Id outside the client range is BadIDChoice");
+    TEST_ASSERT(send(buf, mk_create_gc(buf, BASE + 1, ROOT, X11_GXcopy, 0)) == -X11_BadIDChoice,
+                "Reusing a live id is BadIDChoice");
+    uint32_t len = mk_fill(buf, ROOT, BASE + 1, one, 1);
+    TEST_ASSERT(x11_process_request((uint32_t)g_client, buf[0], buf, len + 4) == -X11_BadLength,
+                "Length field disagreeing with the request size is BadLength");
+
+    /* Churn GCs to exercise swap-removal and hash deletion */
+    int created = 0;
+    for (uint32_t i = 0; i < 20; i++) {
+        if (send(buf, mk_create_gc(buf, BASE + 0x100 + i, ROOT, X11_GXcopy, i)) == 0) created++;
+    }
+    for (uint32_t i = 0; i < 20; i += 2) {
+        send(buf, mk_id(buf, X11_FreeGC, BASE + 0x100 + i));
+    }
+    int alive = 0, gone = 0;
+    for (uint32_t i = 0; i < 20; i++) {
+        int r = send(buf, mk_fill(buf, ROOT, BASE + 0x100 + i, one, 1));
+        if (i % 2 == 0 && r == -X11_BadGC) gone++;
+        if (i % 2 == 1 && r == 0 && g_fb[0] == i) alive++;
+    }
+    TEST_ASSERT(created == 20 && gone == 10 && alive == 10, "GC lookups stay correct after interleaved frees");
+
+    int filled = 0;
+    for (uint32_t i = 0; i < 64; i++) {
+        if (send(buf, mk_create_gc(buf, BASE + 0x200 + i, ROOT, X11_GXcopy, 0)) == 0) filled++;
+    }
+    TEST_ASSERT(send(buf, mk_create_gc(buf, BASE + 0x300, ROOT, X11_GXcopy, 0)) == -X11_BadAlloc,
+                "GC table exhaustion is BadAlloc");
+    for (uint32_t i = 0; i < 64; i++) {
+        send(buf, mk_id(buf, X11_FreeGC, BASE + 0x200 + i));
+    }
+    for (uint32_t i = 1; i < 20; i += 2) {
+        send(buf, mk_id(buf, X11_FreeGC, BASE + 0x100 + i));
+    }
+    TEST_ASSERT(filled > 0 && send(buf, mk_create_gc(buf, BASE + 0x300, ROOT, X11_GXcopy, 0)) == 0,
+                "Freed GC slots are reusable");
+    send(buf, mk_id(buf, X11_FreeGC, BASE + 0x300));
+
+    /* A second client may draw on the first client's window */
+    int other = x11_accept_client();
+    uint32_t other_base = BASE + 0x00200000;
+    uint8_t b2[64];
+    mk_create_gc(b2, other_base + 1, ROOT, X11_GXcopy, 0x00ABCDEF);
+    TEST_ASSERT(x11_process_request((uint32_t)other, b2[0], b2, 24) == 0, "Second client creates a GC in its range");
+    int16_t r[] = { 0, 0, 5, 5 };
+    len = mk_fill(b2, BASE + 2, other_base + 1, r, 1);
+    TEST_ASSERT(x11_process_request((uint32_t)other, b2[0], b2, len) == 0 && rect_is(102, 52, 5, 5, 0x00ABCDEF),
+                "Second client draws into the first client's window");
+    x11_disconnect_client((uint32_t)other);
+    TEST_ASSERT(send(buf, mk_fill(buf, ROOT, other_base + 1, one, 1)) == -X11_BadGC,
+                "Disconnect releases the client's resources");
+}
+
+static void test_buffered_stream(void) {
+    uint8_t* stream = malloc(1 << 16);
+    uint32_t len = 0;
+    uint32_t img[16 * 16];
+    x11_stats_t before, after;
+
+    printf("\nBuffered request stream:\n");
+    clear_screen();
+
+    for (int i = 0; i < 16 * 16; i++) img[i] = 0x00100000u + (uint32_t)i;
+    for (int i = 0; i < 40; i++) {
+        int16_t rc[] = { (int16_t)(i * 20), 400, 10, 10, (int16_t)(i * 20), 420, 10, 10 };
+        len += mk_fill(stream + len, ROOT, BASE + 1, rc, 2);
+        len += mk_change_gc_fg(stream + len, BASE + 1, (uint32_t)i + 1);
+    }
+    len += mk_put_image(stream + len, ROOT, BASE + 1, 500, 500, 16, 16, 24, img);
+    uint32_t total_requests = 81;
+
+    /* Feed in uneven chunks so requests straddle writes */
+    x11_get_stats(&before);
+    uint32_t off = 0;
+    int executed = 0;
+    int wrote_all = 1;
+    while (off < len) {
+        uint32_t chunk = 7 + (off % 113);
+        if (chunk > len - off) chunk = len - off;
+        if (x11_client_write((uint32_t)g_client, stream + off, chunk) != (int)chunk) wrote_all = 0;
+        off += chunk;
+        if ((off / 113) % 4 == 0) executed += x11_dispatch_client((uint32_t)g_client, 0);
+    }
+    executed += x11_dispatch_client((uint32_t)g_client, 0);
+    x11_get_stats(&after);
+
+    TEST_ASSERT(wrote_all, "Client buffer accepts the whole stream");
+    TEST_ASSERT(executed == (int)total_requests, "Every request executed exactly once");
+    TEST_ASSERT(after.errors == before.errors, "No request errors");
+    int ok = 1;
+    for (int i = 0; i < 40; i++) {
+        if (!rect_is((uint32_t)i * 20, 400, 10, 10, (uint32_t)i) ||
+            !rect_is((uint32_t)i * 20, 420, 10, 10, (uint32_t)i)) ok = 0;
+    }
+    TEST_ASSERT(ok, "Fills use the GC state at their position in the stream");
+    TEST_ASSERT(g_fb[500 * SCREEN_W + 500] == img[0] && g_fb[515 * SCREEN_W + 515] == img[255],
+                "Image at the end of the stream is drawn");
+    TEST_ASSERT(after.flushes - before.flushes <= after.batches - before.batches,
+                "At most one framebuffer flush per batch");
+
+    /* One batch of many fills is a single flush */
+    len = 0;
+    for (int i = 0; i < 200; i++) {
+        int16_t rc[] = { (int16_t)(i * 3), (int16_t)(600 + (i % 7)), 4, 4 };
+        len += mk_fill(stream + len, ROOT, BASE + 1, rc, 1);
+    }
+    x11_client_write((uint32_t)g_client, stream, len);
+    x11_get_stats(&before);
+    executed = x11_dispatch_client((uint32_t)g_client, 0);
+    x11_get_stats(&after);
+    TEST_ASSERT(executed == 200 && after.flushes - before.flushes == 1, "200 fills, one flush");
+    TEST_ASSERT(after.flushed_pixels - before.flushed_pixels <= 600 * 11,
+                "Touching fills coalesce into the strip they cover");
+
+    /* Budgets and partial requests */
+    len = 0;
+    for (int i = 0; i < 10; i++) {
+        int16_t rc[] = { 0, 0, 1, 1 };
+        len += mk_fill(stream + len, ROOT, BASE + 1, rc, 1);
+    }
+    x11_client_write((uint32_t)g_client, stream, len - 3);
+    TEST_ASSERT(x11_dispatch_client((uint32_t)g_client, 4) == 4, "Budget limits requests per wakeup");
+    TEST_ASSERT(x11_server_dispatch(0) == 5, "Partial trailing request waits for more bytes");
+    x11_client_write((uint32_t)g_client, stream + len - 3, 3);
+    TEST_ASSERT(x11_server_dispatch(0) == 1, "Completed request runs on the next wakeup");
+
+    /* Zero length can only be a BIG-REQUESTS request, which is not offered */
+    uint8_t bad[8] = { X11_NoOperation, 0, 0, 0, 0, 0, 0, 0 };
+    x11_client_write((uint32_t)g_client, bad, sizeof(bad));
+    TEST_ASSERT(x11_dispatch_client((uint32_t)g_client, 0) == -X11_BadLength, "Zero-length request is BadLength");
+    TEST_ASSERT(x11_dispatch_client((uint32_t)g_client, 0) == 0, "Unusable stream is discarded");
+    free(stream);
+}
+
+/* ---- Benchmarks ---- */
+
+/*
+ * Traces of 64x64 operations repainting a 512x384 application window, the
+ * way toolkits redraw widgets and browsers redraw tiles: fill-heavy sends
+ * PolyFillRectangle with 8 rectangles, image-heavy sends a 64x64 PutImage.
+ * Unbatched reads each request off the socket, executes and flushes it;
+ * batched reads up to 256 KB per wakeup and dispatches 256 requests at a
+ * time with one flush.
+ */
+static uint32_t build_trace(uint8_t* out, uint32_t count, int images, const uint32_t* tile) {
+    uint32_t len = 0;
+    uint32_t seed = 12345;
+    for (uint32_t i = 0; i < count; i++) {
+        seed = seed * 1103515245u + 12345u;
+        int16_t x = (int16_t)(200 + (seed >> 8) % (512 - 64));
+        int16_t y = (int16_t)(100 + (seed >> 20) % (384 - 64));
+        if (images) {
+            len += mk_put_image(out + len, ROOT, BASE + 1, x, y, 64, 64, 24, tile);
+        } else {
+            int16_t rc[32];
+            for (int k = 0; k < 8; k++) {
+                rc[k * 4] = (int16_t)(x + (k % 4) * 16);
+                rc[k * 4 + 1] = (int16_t)(y + (k / 4) * 32);
+                rc[k * 4 + 2] = 16;
+                rc[k * 4 + 3] = 32;
+            }
+            len += mk_fill(out + len, ROOT, BASE + 1, rc, 8);
+        }
+    }
+    return len;
+}
+
+static void bench_trace(const char* name, int images) {
+    const uint32_t count = images ? 4096 : 16384;
+    const int rounds = 4;
+    uint32_t tile[64 * 64];
+    for (int i = 0; i < 64 * 64; i++) tile[i] = 0x00203040u ^ (uint32_t)i;
+    uint8_t* trace = malloc((size_t)count * (24 + 64 * 64 * 4));
+    uint32_t len = build_trace(trace, count, images, tile);
+
+    /* Unbatched: read one request off the socket, execute, flush */
+    uint8_t* request = malloc(24 + 64 * 64 * 4);
+    uint64_t t0 = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (uint32_t off = 0; off < len; ) {
+            uint32_t rl = (uint32_t)(trace[off + 2] | (trace[off + 3] << 8)) * 4;
+            memcpy(request, trace + off, rl);
+            x11_process_request((uint32_t)g_client, request[0], request, rl);
+            off += rl;
+        }
+    }
+    free(request);
+    double unbatched = (double)count * rounds / ((now_ns() - t0) / 1e9);
+
+    /* Batched: socket-sized writes, 256 requests per wakeup */
+    x11_stats_t before, after;
+    x11_get_stats(&before);
+    t0 = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (uint32_t off = 0; off < len; ) {
+            uint32_t chunk = len - off < 262144 ? len - off : 262144;
+            int n = x11_client_write((uint32_t)g_client, trace + off, chunk);
+            off += (uint32_t)n;
+            while (x11_dispatch_client((uint32_t)g_client, 256) == 256) {
+            }
+        }
+    }
+    double batched = (double)count * rounds / ((now_ns() - t0) / 1e9);
+    x11_get_stats(&after);
+
+    printf("  %-13s unbatched %9.0f req/s   batched %9.0f req/s  (%.1fx, %.1f req/flush, %.0f px/req flushed)\n",
+           name, unbatched, batched, batched / unbatched,
+           (double)(after.requests - before.requests) / (double)(after.flushes - before.flushes),
+           (double)(after.flushed_pixels - before.flushed_pixels) / (double)(after.requests - before.requests));
+    free(trace);
+}
+
+/* ---- Wayland ---- */
+
+#define WL_W        1920
+#define WL_H        1080
+
+static uint32_t* g_wl_fb;
+static int g_wl_client;
+
+static void fill_buffer(uint8_t* base, int32_t stride, int32_t x, int32_t y, int32_t w, int32_t h, uint32_t value) {
+    for (int32_t j = 0; j < h; j++) {
+        uint32_t* row = (uint32_t*)(base + (size_t)(y + j) * (size_t)stride) + x;
+        for (int32_t i = 0; i < w; i++) row[i] = value;
+    }
+}
+
+static int wl_rect_is(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t value) {
+    for (uint32_t j = 0; j < h; j++) {
+        for (uint32_t i = 0; i < w; i++) {
+            if (g_wl_fb[(y + j) * WL_W + x + i] != value) return 0;
+        }
+    }
+    return 1;
+}
+
+static uint32_t wl_commit(uint32_t surface, int buffer, int32_t dx, int32_t dy, const int32_t* damage) {
+    if (buffer >= 0) wayland_surface_attach((uint32_t)g_wl_client, surface, (uint32_t)buffer, dx, dy);
+    if (damage) wayland_surface_damage((uint32_t)g_wl_client, surface, damage[0], damage[1], damage[2], damage[3]);
+    return (uint32_t)wayland_commit_surface((uint32_t)g_wl_client, surface);
+}
+
+static void test_wayland(void) {
+    uint32_t c = (uint32_t)g_wl_client;
+    wl_stats_t before, after;
+
+    printf("\nWayland shm buffers and composition:\n");
+
+    /* Window pool: two 200x100 XRGB buffers with padded stride */
+    const int32_t win_stride = 208 * 4;
+    uint8_t* win_mem = calloc(2, (size_t)win_stride * 100);
+    int pool = wayland_shm_create_pool(c, win_mem, win_stride * 200);
+    TEST_ASSERT(pool > 0, "Create shm pool");
+    int win_a = wayland_shm_pool_create_buffer(c, (uint32_t)pool, 0, 200, 100, win_stride, WL_SHM_FORMAT_XRGB8888);
+    int win_b = wayland_shm_pool_create_buffer(c, (uint32_t)pool, win_stride * 100, 200, 100, win_stride,
+                                               WL_SHM_FORMAT_XRGB8888);
+    TEST_ASSERT(win_a > 0 && win_b > 0, "Create two buffers in the pool");
+    TEST_ASSERT(wayland_shm_pool_create_buffer(c, (uint32_t)pool, win_stride * 100 + 4, 200, 100, win_stride,
+                                               WL_SHM_FORMAT_XRGB8888) < 0, "Buffer past the pool end is rejected");
+    TEST_ASSERT(wayland_shm_pool_create_buffer(c, (uint32_t)pool, 0, 200, 100, 199 * 4,
+                                               WL_SHM_FORMAT_XRGB8888) < 0, "Stride below width is rejected");
+    TEST_ASSERT(wayland_shm_pool_create_buffer(c, (uint32_t)pool, 0, 200, 100, win_stride, 0x34325258) < 0,
+                "Unsupported format is rejected");
+
+    uint8_t* a_mem = win_mem;
+    uint8_t* b_mem = win_mem + win_stride * 100;
+    fill_buffer(a_mem, win_stride, 0, 0, 200, 100, 0x00112233);
+    int surface = wayland_create_surface(c);
+    wayland_surface_set_position(c, (uint32_t)surface, 50, 40);
+    wayland_get_stats(&before);
+    TEST_ASSERT(wl_commit((uint32_t)surface, win_a, 0, 0, NULL) == 0, "Attach and commit a window buffer");
+    wayland_get_stats(&after);
+    TEST_ASSERT(wl_rect_is(50, 40, 200, 100, 0x00112233) && wl_rect_is(49, 40, 1, 1, 0) && wl_rect_is(250, 139, 1, 1, 0),
+                "Window composed at its position");
+    TEST_ASSERT(wayland_get_scanout() == g_wl_fb && after.flips == before.flips, "Windowed output scans out the framebuffer");
+    TEST_ASSERT(wayland_buffer_busy(c, (uint32_t)win_a), "Attached buffer is busy");
+
+    /* Next frame in B: only the damaged rectangle is read */
+    fill_buffer(b_mem, win_stride, 0, 0, 200, 100, 0x00FFFFFF);   /* stale everywhere */
+    fill_buffer(b_mem, win_stride, 10, 20, 30, 15, 0x00445566);
+    int32_t dmg[] = { 10, 20, 30, 15 };
+    wayland_get_stats(&before);
+    wl_commit((uint32_t)surface, win_b, 0, 0, dmg);
+    wayland_get_stats(&after);
+    TEST_ASSERT(wl_rect_is(60, 60, 30, 15, 0x00445566) && wl_rect_is(50, 40, 10, 10, 0x00112233),
+                "Damage composes from the new buffer and nothing else");
+    TEST_ASSERT(after.composed_pixels - before.composed_pixels == 30 * 15, "Composed pixels equal the damage area");
+    TEST_ASSERT(!wayland_buffer_busy(c, (uint32_t)win_a) && after.releases == before.releases + 1,
+                "Replaced buffer is released");
+
+    /* Damage outside the buffer is clipped */
+    int32_t wide[] = { -50, -50, 1000, 1000 };
+    wayland_get_stats(&before);
+    wl_commit((uint32_t)surface, -1, 0, 0, wide);
+    wayland_get_stats(&after);
+    TEST_ASSERT(after.composed_pixels - before.composed_pixels == 200 * 100, "Surface damage is clipped to the buffer");
+
+    /* Translucent popup over the window */
+    const int32_t pop_stride = 16 * 4;
+    uint8_t* pop_mem = calloc(16, (size_t)pop_stride);
+    fill_buffer(pop_mem, pop_stride, 0, 0, 16, 16, 0x80808080);   /* 50% white, premultiplied */
+    int pop_pool = wayland_shm_create_pool(c, pop_mem, pop_stride * 16);
+    int pop_buf = wayland_shm_pool_create_buffer(c, (uint32_t)pop_pool, 0, 16, 16, pop_stride, WL_SHM_FORMAT_ARGB8888);
+    int popup = wayland_create_surface(c);
+    wayland_surface_set_position(c, (uint32_t)popup, 40, 30);
+    wl_commit((uint32_t)popup, pop_buf, 0, 0, NULL);
+    uint32_t over_win = g_wl_fb[45 * WL_W + 52];
+    uint32_t over_bg = g_wl_fb[31 * WL_W + 41];
+    TEST_ASSERT(over_bg == 0x80808080, "ARGB over the clear color keeps its premultiplied value");
+    /* 0x80 + 0xFF * (255 - 0x80) / 255 per channel over the white window */
+    TEST_ASSERT(over_win == 0x80FFFFFF, "ARGB blends over the window beneath");
+
+    /* Moving the popup away recomposes the window underneath */
+    wayland_surface_set_position(c, (uint32_t)popup, 600, 600);
+    TEST_ASSERT(wl_rect_is(50, 40, 6, 6, 0x00FFFFFF) && wl_rect_is(40, 30, 10, 10, 0),
+                "Moved surface exposes what was below");
+
+    /* Frame callbacks */
+    wayland_surface_frame(c, (uint32_t)surface);
+    TEST_ASSERT(wayland_output_vblank() == 0, "Frame callback waits for the commit");
+    wl_commit((uint32_t)surface, -1, 0, 0, NULL);
+    TEST_ASSERT(wayland_output_vblank() == 1 && wayland_output_vblank() == 0, "Frame callback fires once at vblank");
+
+    /* Fullscreen opaque buffers are flipped, not copied */
+    uint8_t* fs_mem = malloc((size_t)WL_W * WL_H * 4 * 2);
+    int fs_pool = wayland_shm_create_pool(c, fs_mem, WL_W * WL_H * 4 * 2);
+    int fs_a = wayland_shm_pool_create_buffer(c, (uint32_t)fs_pool, 0, WL_W, WL_H, WL_W * 4, WL_SHM_FORMAT_XRGB8888);
+    int fs_b = wayland_shm_pool_create_buffer(c, (uint32_t)fs_pool, WL_W * WL_H * 4, WL_W, WL_H, WL_W * 4,
+                                              WL_SHM_FORMAT_XRGB8888);
+    int fs = wayland_create_surface(c);
+    wayland_get_stats(&before);
+    wl_commit((uint32_t)fs, fs_a, 0, 0, NULL);
+    wayland_get_stats(&after);
+    TEST_ASSERT(wayland_get_scanout() == fs_mem, "Fullscreen opaque buffer goes to scanout");
+    TEST_ASSERT(after.flips == before.flips + 1 && after.composed_pixels == before.composed_pixels,
+                "Flip reads no pixels");
+    wl_commit((uint32_t)fs, fs_b, 0, 0, NULL);
+    TEST_ASSERT(wayland_get_scanout() == fs_mem + (size_t)WL_W * WL_H * 4 && !wayland_buffer_busy(c, (uint32_t)fs_a),
+                "Next flip switches scanout and releases the previous buffer");
+    TEST_ASSERT(wayland_buffer_busy(c, (uint32_t)fs_b), "Scanned-out buffer stays busy");
+
+    /* Window commits under a fullscreen surface cost nothing */
+    wayland_get_stats(&before);
+    wl_commit((uint32_t)surface, win_a, 0, 0, dmg);
+    wayland_get_stats(&after);
+    TEST_ASSERT(after.composed_pixels == before.composed_pixels, "Occluded commit composes nothing");
+
+    /* Unmapping the fullscreen surface returns to composition */
+    fill_buffer(a_mem, win_stride, 0, 0, 200, 100, 0x00778899);
+    wl_commit((uint32_t)fs, 0, 0, 0, NULL);
+    TEST_ASSERT(wayland_get_scanout() == g_wl_fb && !wayland_buffer_busy(c, (uint32_t)fs_b),
+                "Unmapping the fullscreen surface restores the framebuffer");
+    TEST_ASSERT(wl_rect_is(50, 40, 200, 100, 0x00778899) && wl_rect_is(0, 0, 40, 40, 0),
+                "Framebuffer is fully recomposed after the flip period");
+
+    /* Wire protocol path */
+    uint32_t args[4] = { (uint32_t)win_b, 0, 0, 0 };
+    int32_t dargs[4] = { 0, 0, 200, 100 };
+    fill_buffer(b_mem, win_stride, 0, 0, 200, 100, 0x00010101);
+    wayland_process_message(c, (uint32_t)surface, WL_SURFACE_ATTACH, (uint8_t*)args, 12);
+    wayland_process_message(c, (uint32_t)surface, WL_SURFACE_DAMAGE, (uint8_t*)dargs, 16);
+    TEST_ASSERT(wl_rect_is(50, 40, 1, 1, 0x00778899), "Attach and damage stay pending until commit");
+    wayland_process_message(c, (uint32_t)surface, WL_SURFACE_COMMIT, NULL, 0);
+    TEST_ASSERT(wl_rect_is(50, 40, 200, 100, 0x00010101), "wl_surface messages route to the surface");
+
+    /* Detach everything so the benchmark starts from an empty output */
+    wl_commit((uint32_t)surface, 0, 0, 0, NULL);
+    wl_commit((uint32_t)popup, 0, 0, 0, NULL);
+    free(fs_mem);
+    free(pop_mem);
+    free(win_mem);
+}
+
+/*
+ * A client paced at 60 or 120 Hz: each vblank it waits for a free buffer,
+ * renders its damaged region, attaches, damages and commits. Latency is
+ * commit to scanout-ready (composition done or flip programmed), the
+ * compositor's share of the frame budget.
+ */
+typedef struct {
+    const char* name;
+    int32_t x, y, width, height;
+    uint32_t format;
+    int32_t dx, dy, dw, dh;     /* Damage per frame, surface coordinates */
+} wl_scenario_t;
+
+static int cmp_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void bench_wayland_rate(const wl_scenario_t* sc, uint32_t surface, const int* buf,
+                               uint8_t* mem, uint32_t hz) {
+    uint32_t c = (uint32_t)g_wl_client;
+    const int frames = 60;
+    const uint64_t period = 1000000000ull / hz;
+    int32_t stride = sc->width * 4;
+    uint64_t lat[frames];
+    int missed = 0;
+    wl_stats_t before, after;
+    wayland_get_stats(&before);
+
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (int f = 0; f < frames; f++) {
+        next.tv_nsec += (long)period;
+        while (next.tv_nsec >= 1000000000L) { next.tv_nsec -= 1000000000L; next.tv_sec++; }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        wayland_output_vblank();
+
+        int b = wayland_buffer_busy(c, (uint32_t)buf[f & 1]) ? (f + 1) & 1 : f & 1;
+        uint8_t* base = mem + (size_t)(b * stride * sc->height);
+        uint32_t color = sc->format == WL_SHM_FORMAT_ARGB8888 ? 0xC0000000u | (uint32_t)f : 0x00102030u + (uint32_t)f;
+        fill_buffer(base, stride, sc->dx, sc->dy, sc->dw, sc->dh, color);
+
+        uint64_t t0 = now_ns();
+        wayland_surface_attach(c, surface, (uint32_t)buf[b], 0, 0);
+        wayland_surface_damage(c, surface, sc->dx, sc->dy, sc->dw, sc->dh);
+        wayland_surface_frame(c, surface);
+        wayland_commit_surface(c, surface);
+        lat[f] = now_ns() - t0;
+        if (lat[f] > period) missed++;
+    }
+    wayland_get_stats(&after);
+
+    qsort(lat, frames, sizeof(lat[0]), cmp_u64);
+    printf("  %-26s %3u Hz  p50 %7.1f us  p99 %7.1f us  (%4.1f%% of frame)  missed %d  flips %llu  px/frame %llu\n",
+           sc->name, hz, lat[frames / 2] / 1e3, lat[frames * 99 / 100] / 1e3,
+           100.0 * (double)lat[frames * 99 / 100] / (double)period, missed,
+           (unsigned long long)(after.flips - before.flips),
+           (unsigned long long)((after.composed_pixels - before.composed_pixels) / frames));
+}
+
+static void bench_wayland_scenario(const wl_scenario_t* sc) {
+    uint32_t c = (uint32_t)g_wl_client;
+    int32_t stride = sc->width * 4;
+    uint8_t* mem = calloc(2, (size_t)stride * (size_t)sc->height);
+    int pool = wayland_shm_create_pool(c, mem, stride * sc->height * 2);
+    int buf[2];
+    buf[0] = wayland_shm_pool_create_buffer(c, (uint32_t)pool, 0, sc->width, sc->height, stride, sc->format);
+    buf[1] = wayland_shm_pool_create_buffer(c, (uint32_t)pool, stride * sc->height, sc->width, sc->height,
+                                            stride, sc->format);
+    int surface = wayland_create_surface(c);
+    wayland_surface_set_position(c, (uint32_t)surface, sc->x, sc->y);
+
+    bench_wayland_rate(sc, (uint32_t)surface, buf, mem, 60);
+    bench_wayland_rate(sc, (uint32_t)surface, buf, mem, 120);
+
+    wayland_surface_attach(c, (uint32_t)surface, 0, 0, 0);
+    wayland_commit_surface(c, (uint32_t)surface);
+    free(mem);
+}
+
+static void bench_wayland(void) {
+    const wl_scenario_t scenarios[] = {
+        { "fullscreen XRGB (flip)",    0, 0, WL_W, WL_H, WL_SHM_FORMAT_XRGB8888, 0, 0, WL_W, WL_H },
+        { "fullscreen ARGB (compose)", 0, 0, WL_W, WL_H, WL_SHM_FORMAT_ARGB8888, 0, 0, WL_W, WL_H },
+        { "800x600 window, full",      300, 200, 800, 600, WL_SHM_FORMAT_XRGB8888, 0, 0, 800, 600 },
+        { "800x600 window, 200x40",    300, 200, 800, 600, WL_SHM_FORMAT_XRGB8888, 40, 500, 200, 40 },
+    };
+
+    printf("\n=== Benchmark: Wayland commit-to-scanout latency, %dx%d ===\n", WL_W, WL_H);
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        bench_wayland_scenario(&scenarios[i]);
+    }
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("========================================\n");
+    printf("X11/Wayland Display Server Tests\n");
+    printf("========================================\n");
+
+    g_fb = calloc(SCREEN_W * SCREEN_H, 4);
+    display_server_init(DISPLAY_PROTOCOL_X11, SCREEN_W, SCREEN_H, g_fb);
+    g_client = x11_accept_client();
+
+    test_windows_and_fills();
+    test_images_and_pixmaps();
+    test_errors_and_resources();
+    test_buffered_stream();
+
+    g_wl_fb = calloc(WL_W * WL_H, 4);
+    wayland_compositor_init(WL_W, WL_H, g_wl_fb);
+    g_wl_client = wayland_accept_client();
+    test_wayland();
+
+    if (bench) {
+        printf("\n=== Benchmark: X11 request throughput, %dx%d ===\n", SCREEN_W, SCREEN_H);
+        bench_trace("fill-heavy", 0);
+        bench_trace("image-heavy", 1);
+        bench_wayland();
+    }
+
+    printf("\n========================================\n");
+    printf("Passed: %d  Failed: %d\n", tests_passed, tests_failed);
+    printf("========================================\n");
+    free(g_wl_fb);
+    free(g_fb);
+    return tests_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,711 @@
+/**
+ * Aurora OS - FAT32 Allocation and FAT Cache Tests
+ *
+ * Host-built harness for the FAT32 driver on memory-backed images laid
+ * out the way mkfs.fat lays them out: boot sector validation at mount,
+ * the free-cluster bitmap and FSInfo hint, contiguous run allocation,
+ * mirrored and single-FAT writeback, cache hit rates, the cluster chain
+ * cache on fragmented chains, file reads and writes, and persistence
+ * across remounts. Every image is checked afterwards by an independent
+ * walk of the raw FATs. With --bench, large-file write throughput and
+ * random seeks with and without the chain cache.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include "../../filesystem/fat32/fat32.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/* ---- Kernel service stubs ---- */
+
+void* kmalloc(size_t size) {
+    return malloc(size);
+}
+
+void kfree(void* ptr) {
+    free(ptr);
+}
+
+uint32_t smp_get_current_cpu_id(void) {
+    return 0;
+}
+
+void cpu_relax(void) {
+    sched_yield();
+}
+
+void page_cache_mapping_init(address_space_t* mapping, struct inode* host) {
+    (void)mapping;
+    (void)host;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* ---- Images ---- */
+
+#define SS              FAT32_SECTOR_SIZE
+#define RESERVED        32
+#define FSINFO_SECTOR   1
+#define BACKUP_SECTOR   6
+
+typedef struct {
+    uint32_t sectors;
+    uint8_t* data;
+    /* Geometry, as formatted */
+    uint32_t spc;
+    uint32_t num_fats;
+    uint32_t fat_size;
+    uint32_t first_data;
+    uint32_t clusters;
+    /* Sectors written into each FAT copy */
+    uint64_t fat_writes[2];
+    uint64_t reads;
+} image_t;
+
+static image_t img;
+static fat32_device_t img_device;
+
+static int img_read(void* ctx, uint64_t sector, void* data, uint32_t count) {
+    image_t* im = (image_t*)ctx;
+    if (sector + count > im->sectors) {
+        return -1;
+    }
+    memcpy(data, im->data + sector * SS, (size_t)count * SS);
+    im->reads++;
+    return 0;
+}
+
+static int img_write(void* ctx, uint64_t sector, const void* data, uint32_t count) {
+    image_t* im = (image_t*)ctx;
+    if (sector + count > im->sectors) {
+        return -1;
+    }
+    for (uint32_t fat = 0; fat < im->num_fats && fat < 2; fat++) {
+        uint64_t start = RESERVED + (uint64_t)fat * im->fat_size;
+        if (sector >= start && sector < start + im->fat_size) {
+            im->fat_writes[fat] += count;
+        }
+    }
+    memcpy(im->data + sector * SS, data, (size_t)count * SS);
+    return 0;
+}
+
+static uint32_t raw_get(uint32_t fat, uint32_t cluster) {
+    const uint8_t* p = img.data + ((uint64_t)RESERVED + (uint64_t)fat * img.fat_size) * SS +
+                       (uint64_t)cluster * 4;
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v & FAT32_EOC_MAX;
+}
+
+/* Set an entry in every FAT copy */
+static void raw_set(uint32_t cluster, uint32_t value) {
+    for (uint32_t fat = 0; fat < img.num_fats; fat++) {
+        uint8_t* p = img.data + ((uint64_t)RESERVED + (uint64_t)fat * img.fat_size) * SS +
+                     (uint64_t)cluster * 4;
+        memcpy(p, &value, 4);
+    }
+}
+
+static fat32_fsinfo_t* raw_fsinfo(void) {
+    return (fat32_fsinfo_t*)(img.data + FSINFO_SECTOR * SS);
+}
+
+static uint32_t raw_free_count(uint32_t fat) {
+    uint32_t n = 0;
+    for (uint32_t c = 2; c < img.clusters + 2; c++) {
+        n += raw_get(fat, c) == FAT32_FREE_CLUSTER;
+    }
+    return n;
+}
+
+/* Format a FAT32 volume: 32 reserved sectors, FSInfo in sector 1, the
+ * backup boot sector in 6, and the root directory in cluster 2 */
+static void make_image(uint32_t sectors, uint32_t spc, uint32_t num_fats, uint16_t ext_flags) {
+    free(img.data);
+    memset(&img, 0, sizeof(img));
+    img.sectors = sectors;
+    img.data = calloc(sectors, SS);
+    img.spc = spc;
+    img.num_fats = num_fats;
+    img.fat_size = (((sectors - RESERVED) / spc + 2) * 4 + SS - 1) / SS;
+    img.first_data = RESERVED + num_fats * img.fat_size;
+    img.clusters = (sectors - img.first_data) / spc;
+
+    fat32_boot_sector_t* bs = (fat32_boot_sector_t*)img.data;
+    memcpy(bs->jump_boot, "\xEB\x58\x90", 3);
+    memcpy(bs->oem_name, "mkfs.fat", 8);
+    bs->bytes_per_sector = SS;
+    bs->sectors_per_cluster = (uint8_t)spc;
+    bs->reserved_sector_count = RESERVED;
+    bs->num_fats = (uint8_t)num_fats;
+    bs->media_type = 0xF8;
+    bs->sectors_per_track = 32;
+    bs->num_heads = 64;
+    bs->total_sectors_32 = sectors;
+    bs->fat_size_32 = img.fat_size;
+    bs->ext_flags = ext_flags;
+    bs->root_cluster = 2;
+    bs->fs_info = FSINFO_SECTOR;
+    bs->backup_boot_sector = BACKUP_SECTOR;
+    bs->drive_number = 0x80;
+    bs->boot_signature = FAT32_BOOT_SIGNATURE;
+    bs->volume_id = 0x1234ABCD;
+    memcpy(bs->volume_label, "AURORA     ", 11);
+    memcpy(bs->fs_type, FAT32_FS_TYPE, 8);
+    img.data[510] = 0x55;
+    img.data[511] = 0xAA;
+
+    fat32_fsinfo_t* fsinfo = raw_fsinfo();
+    fsinfo->lead_signature = FAT32_FSINFO_LEAD_SIG;
+    fsinfo->struct_signature = FAT32_FSINFO_STRUCT_SIG;
+    fsinfo->free_count = img.clusters - 1;
+    fsinfo->next_free = 3;
+    fsinfo->trail_signature = FAT32_FSINFO_TRAIL_SIG;
+
+    memcpy(img.data + BACKUP_SECTOR * SS, img.data, 2 * SS);
+
+    raw_set(0, 0x0FFFFF00 | 0xF8);
+    raw_set(1, FAT32_EOC_MAX);
+    raw_set(2, FAT32_EOC_MAX);
+}
+
+/* Chain count clusters raw, stepping by stride from first */
+static void raw_chain(uint32_t first, uint32_t count, uint32_t stride) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t c = first + i * stride;
+        raw_set(c, (i + 1 < count) ? c + stride : FAT32_EOC_MAX);
+    }
+}
+
+/* Independent consistency check of the raw image: the FAT copies in use
+ * agree, every link lands on a used cluster, no cluster is linked twice,
+ * and FSInfo carries the real free count */
+static bool check_image(bool mirrored) {
+    uint32_t end = img.clusters + 2;
+    uint8_t* linked = calloc(end, 1);
+    bool ok = true;
+
+    if (mirrored) {
+        for (uint32_t fat = 1; fat < img.num_fats; fat++) {
+            ok &= memcmp(img.data + (uint64_t)RESERVED * SS,
+                         img.data + ((uint64_t)RESERVED + (uint64_t)fat * img.fat_size) * SS,
+                         (size_t)img.fat_size * SS) == 0;
+        }
+    }
+    uint32_t active = mirrored ? 0 : (((fat32_boot_sector_t*)img.data)->ext_flags & FAT32_EXT_ACTIVE_MASK);
+    for (uint32_t c = 2; c < end && ok; c++) {
+        uint32_t next = raw_get(active, c);
+        if (next == FAT32_FREE_CLUSTER || next >= FAT32_RESERVED_MIN) {
+            continue;
+        }
+        ok &= next >= 2 && next < end && !linked[next] &&
+              raw_get(active, next) != FAT32_FREE_CLUSTER;
+        if (next < end) {
+            linked[next] = 1;
+        }
+    }
+    ok &= raw_fsinfo()->free_count == raw_free_count(active);
+    free(linked);
+    return ok;
+}
+
+static fat32_mount_t* mount_image(void) {
+    if (fat32_get_mount()) {
+        fat32_unmount_device();
+    }
+    img_device.sectors = img.sectors;
+    if (fat32_mount_device("img0") != 0) {
+        return NULL;
+    }
+    return fat32_get_mount();
+}
+
+static bool bitmap_used(const fat32_mount_t* mount, uint32_t c) {
+    return (mount->cluster_bitmap[c / 64] >> (c & 63)) & 1;
+}
+
+static void fill_pattern(uint8_t* buf, size_t len, uint32_t seed) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)((i * 2654435761u) >> 13) ^ (uint8_t)seed;
+    }
+}
+
+/* ---- Tests ---- */
+
+static void test_mount_validation(void) {
+    printf("\nBoot sector validation:\n");
+
+    make_image(131072, 1, 2, 0);
+    TEST_ASSERT(mount_image() != NULL, "Mount a freshly formatted 64 MB image");
+    fat32_mount_t* mount = fat32_get_mount();
+    TEST_ASSERT(mount->total_clusters == img.clusters && mount->first_data_sector == img.first_data,
+                "Geometry matches the format");
+    TEST_ASSERT(fat32_mount_device("img0") != 0, "Second mount refused");
+    fat32_unmount_device();
+
+    TEST_ASSERT(fat32_mount_device("nodev") != 0, "Unknown device refused");
+
+    fat32_boot_sector_t* bs = (fat32_boot_sector_t*)img.data;
+    img.data[510] = 0;
+    TEST_ASSERT(mount_image() == NULL, "Missing 0x55AA refused");
+    img.data[510] = 0x55;
+
+    bs->bytes_per_sector = 4096;
+    TEST_ASSERT(mount_image() == NULL, "Unsupported sector size refused");
+    bs->bytes_per_sector = SS;
+
+    bs->sectors_per_cluster = 3;
+    TEST_ASSERT(mount_image() == NULL, "Non power-of-two cluster size refused");
+    bs->sectors_per_cluster = 1;
+
+    bs->root_entry_count = 512;
+    TEST_ASSERT(mount_image() == NULL, "FAT12/16 style root directory refused");
+    bs->root_entry_count = 0;
+
+    bs->total_sectors_32 = img.sectors * 2;
+    TEST_ASSERT(mount_image() == NULL, "Volume larger than the device refused");
+    bs->total_sectors_32 = img.sectors;
+
+    bs->root_cluster = img.clusters + 2;
+    TEST_ASSERT(mount_image() == NULL, "Out-of-range root cluster refused");
+    bs->root_cluster = 2;
+
+    TEST_ASSERT(mount_image() != NULL, "Repaired image mounts again");
+}
+
+static void test_bitmap(void) {
+    printf("\nFree-cluster bitmap and FSInfo:\n");
+
+    make_image(131072, 1, 2, 0);
+    raw_chain(100, 50, 1);
+    raw_chain(1000, 20, 3);
+    raw_set(5000, FAT32_BAD_CLUSTER);
+    raw_fsinfo()->free_count = 12345;     /* Stale */
+    raw_fsinfo()->next_free = 7000;
+
+    fat32_mount_t* mount = mount_image();
+    TEST_ASSERT(mount != NULL, "Mount populated image");
+    TEST_ASSERT(mount->free_count == raw_free_count(0), "Free count comes from the FAT, not FSInfo");
+
+    bool match = true;
+    for (uint32_t c = 2; c < img.clusters + 2; c++) {
+        match &= bitmap_used(mount, c) == (raw_get(0, c) != FAT32_FREE_CLUSTER);
+    }
+    TEST_ASSERT(match, "Bitmap matches every FAT entry");
+    TEST_ASSERT(bitmap_used(mount, 0) && bitmap_used(mount, 1), "Clusters 0 and 1 never free");
+    TEST_ASSERT(bitmap_used(mount, 5000), "Bad cluster counted as used");
+
+    TEST_ASSERT(fat32_allocate_cluster(mount) == 7000, "Allocation starts at the FSInfo hint");
+    TEST_ASSERT(fat32_sync(mount) == 0, "Sync");
+    TEST_ASSERT(raw_fsinfo()->free_count == raw_free_count(0) && raw_fsinfo()->next_free == 7001,
+                "FSInfo rewritten with the real count and next hint");
+    TEST_ASSERT(raw_fsinfo()->trail_signature == FAT32_FSINFO_TRAIL_SIG, "FSInfo signatures kept");
+    TEST_ASSERT(check_image(true), "Image consistent");
+
+    raw_fsinfo()->next_free = 0xFFFFFFFF;
+    mount = mount_image();
+    TEST_ASSERT(fat32_allocate_cluster(mount) == 3, "Unknown hint falls back to the first free cluster");
+
+    raw_fsinfo()->lead_signature = 0;
+    mount = mount_image();
+    TEST_ASSERT(mount != NULL && mount->fsinfo_sector == 0, "Damaged FSInfo ignored, not trusted");
+    fat32_unmount_device();
+    TEST_ASSERT(raw_fsinfo()->lead_signature == 0, "Damaged FSInfo left untouched");
+}
+
+static void test_runs(void) {
+    printf("\nRun allocation:\n");
+
+    make_image(131072, 1, 2, 0);
+    fat32_mount_t* mount = mount_image();
+    uint32_t before = mount->free_count;
+
+    uint32_t first = 0;
+    uint32_t n = fat32_allocate_clusters(mount, 0, 100, &first);
+    TEST_ASSERT(n == 100 && first == 3, "100 clusters in one run from the hint");
+    bool chained = true;
+    for (uint32_t i = 0; i < 100; i++) {
+        chained &= fat32_get_fat_entry(mount, first + i) == (i < 99 ? first + i + 1 : FAT32_EOC_MAX);
+    }
+    TEST_ASSERT(chained, "Run chained in order and terminated");
+    TEST_ASSERT(mount->free_count == before - 100, "Free count drops by the run");
+
+    uint32_t more = 0;
+    n = fat32_allocate_clusters(mount, first + 99, 50, &more);
+    TEST_ASSERT(n == 50 && more == first + 100, "Extension continues straight after prev");
+    TEST_ASSERT(fat32_get_fat_entry(mount, first + 99) == more, "prev linked to the new run");
+
+    /* Fragment: every other 64-cluster block taken from 1000 on */
+    for (uint32_t c = 1000; c < img.clusters + 2 - 64; c += 128) {
+        uint32_t got;
+        mount->next_free = c;
+        fat32_allocate_clusters(mount, 0, 64, &got);
+    }
+    mount->next_free = 1000;
+    n = fat32_allocate_clusters(mount, 0, 64, &first);
+    TEST_ASSERT(n == 64 && first == 1064, "Exact-size hole found after the hint");
+    n = fat32_allocate_clusters(mount, 0, 200, &first);
+    TEST_ASSERT(n == 200 && first == 153, "Longer run wraps to the space before the hint");
+
+    TEST_ASSERT(fat32_allocate_clusters(mount, 0, 0, &first) == 0, "Empty request allocates nothing");
+    n = fat32_allocate_clusters(mount, 0, 1000, &first);
+    TEST_ASSERT(n > 0 && n < 1000, "Short run returned when no long one is left");
+
+    while (fat32_allocate_cluster(mount)) {
+    }
+    TEST_ASSERT(mount->free_count == 0, "Volume fills to the last cluster");
+    TEST_ASSERT(fat32_allocate_clusters(mount, 0, 1, &first) == 0, "Full volume allocates nothing");
+    TEST_ASSERT(fat32_sync(mount) == 0 && check_image(true), "Full image consistent");
+}
+
+static void test_writeback(void) {
+    printf("\nFAT writeback:\n");
+
+    make_image(131072, 1, 2, 0);
+    fat32_mount_t* mount = mount_image();
+    fat32_sync(mount);
+    img.fat_writes[0] = img.fat_writes[1] = 0;
+
+    uint32_t first;
+    fat32_allocate_clusters(mount, 0, 10, &first);
+    TEST_ASSERT(img.fat_writes[0] == 0, "Allocation stays in the cache until sync");
+    fat32_sync(mount);
+    TEST_ASSERT(img.fat_writes[0] == FAT32_CACHE_SECTORS && img.fat_writes[1] == FAT32_CACHE_SECTORS,
+                "One page written to each FAT copy");
+    TEST_ASSERT(check_image(true), "Mirrored copies identical");
+    fat32_sync(mount);
+    TEST_ASSERT(img.fat_writes[0] == FAT32_CACHE_SECTORS, "Clean cache writes nothing");
+
+    /* Dirty about twice as many pages as the cache holds */
+    uint32_t pages = (mount->total_clusters + 2) / (FAT32_CACHE_SECTORS * FAT32_ENTRIES_PER_SECTOR);
+    mount->cache_stats.writebacks = 0;
+    for (uint32_t i = 0; i < pages; i++) {
+        mount->next_free = 3 + i * FAT32_CACHE_SECTORS * FAT32_ENTRIES_PER_SECTOR;
+        fat32_allocate_cluster(mount);
+    }
+    TEST_ASSERT(mount->cache_stats.writebacks >= pages - FAT32_CACHE_PAGES,
+                "Dirty pages written back on eviction");
+    fat32_sync(mount);
+    TEST_ASSERT(mount->cache_stats.writebacks == pages, "Each dirty page written exactly once");
+    TEST_ASSERT(check_image(true), "Image consistent after evictions");
+
+    /* Active FAT 1, no mirroring: FAT 0 is stale and must stay so */
+    make_image(131072, 1, 2, FAT32_EXT_NO_MIRROR | 1);
+    uint8_t* fat0 = img.data + (uint64_t)RESERVED * SS;
+    memset(fat0 + 12, 0xEE, 64);
+    raw_fsinfo()->free_count = img.clusters - 1;
+    mount = mount_image();
+    TEST_ASSERT(mount->free_count == img.clusters - 1, "Bitmap built from the active FAT");
+    uint8_t* saved = malloc((size_t)img.fat_size * SS);
+    memcpy(saved, fat0, (size_t)img.fat_size * SS);
+    fat32_allocate_clusters(mount, 0, 500, &first);
+    fat32_sync(mount);
+    TEST_ASSERT(img.fat_writes[0] == 0 && img.fat_writes[1] > 0, "Only the active FAT written");
+    TEST_ASSERT(memcmp(saved, fat0, (size_t)img.fat_size * SS) == 0, "Inactive FAT untouched");
+    TEST_ASSERT(raw_get(1, first + 499) == FAT32_EOC_MAX, "Chain in the active FAT");
+    TEST_ASSERT(check_image(false), "Active FAT consistent");
+    free(saved);
+}
+
+static void test_cache(void) {
+    printf("\nFAT cache:\n");
+
+    make_image(131072, 1, 2, 0);
+    fat32_mount_t* mount = mount_image();
+    mount->cache_stats = (fat32_cache_stats_t){ 0, 0, 0, 0 };
+
+    uint32_t page = FAT32_CACHE_SECTORS * FAT32_ENTRIES_PER_SECTOR;
+    for (uint32_t c = 2; c < 4 * page; c++) {
+        fat32_get_fat_entry(mount, c);
+    }
+    TEST_ASSERT(mount->cache_stats.misses == 4, "Sequential walk misses once per page");
+    TEST_ASSERT(mount->cache_stats.hits == 4 * page - 2 - 4, "Every other lookup hits");
+
+    uint64_t reads = img.reads;
+    for (int round = 0; round < 10; round++) {
+        for (uint32_t p = 0; p < FAT32_CACHE_PAGES; p++) {
+            fat32_get_fat_entry(mount, p * page + 5);
+        }
+    }
+    uint64_t first_round = FAT32_CACHE_PAGES - 4;
+    TEST_ASSERT(img.reads - reads == first_round, "A working set the size of the cache stays resident");
+
+    TEST_ASSERT(fat32_get_fat_entry(mount, img.clusters + 2) == FAT32_BAD_CLUSTER,
+                "Out-of-range entry reads as bad");
+    TEST_ASSERT(fat32_set_fat_entry(mount, 1, 0) != 0, "Reserved entries not writable");
+
+    raw_set(200, 0xF0000000 | 300);
+    mount = mount_image();
+    TEST_ASSERT(fat32_get_fat_entry(mount, 200) == 300, "Top four bits masked on read");
+    fat32_set_fat_entry(mount, 200, 400);
+    fat32_sync(mount);
+    uint32_t raw;
+    memcpy(&raw, img.data + (uint64_t)RESERVED * SS + 200 * 4, 4);
+    TEST_ASSERT(raw == (0xF0000000 | 400), "Top four bits preserved on write");
+}
+
+static void test_chain_map(void) {
+    printf("\nCluster chain cache:\n");
+
+    make_image(131072, 1, 2, 0);
+    /* 300 clusters in runs of 1..7, scattered */
+    uint32_t order[300];
+    uint32_t c = 10;
+    uint32_t i = 0;
+    while (i < 300) {
+        uint32_t run = 1 + (uint32_t)(rng() % 7);
+        for (uint32_t k = 0; k < run && i < 300; k++) {
+            order[i++] = c++;
+        }
+        c += 3 + (uint32_t)(rng() % 40);
+    }
+    for (i = 0; i < 300; i++) {
+        raw_set(order[i], i + 1 < 300 ? order[i + 1] : FAT32_EOC_MAX);
+    }
+    fat32_mount_t* mount = mount_image();
+
+    fat32_chain_t chain;
+    fat32_chain_init(&chain, order[0]);
+    uint32_t cluster = 0;
+    TEST_ASSERT(fat32_chain_map(mount, &chain, 150, &cluster) == 0 && cluster == order[150],
+                "Middle of the chain mapped");
+    TEST_ASSERT(!chain.complete && chain.clusters == 151, "Mapped only as far as asked");
+
+    bool all = true;
+    for (int k = 0; k < 2000; k++) {
+        uint32_t index = (uint32_t)(rng() % 300);
+        all &= fat32_chain_map(mount, &chain, index, &cluster) == 0 && cluster == order[index];
+    }
+    TEST_ASSERT(all, "Random indices match the chain");
+    TEST_ASSERT(chain.run_count < 300 && chain.run_count > 300 / 7, "Contiguous clusters merged into runs");
+    TEST_ASSERT(fat32_chain_map(mount, &chain, 300, &cluster) != 0 && chain.complete,
+                "Index past the end fails and marks the chain complete");
+
+    uint64_t misses = mount->cache_stats.misses + mount->cache_stats.hits;
+    for (int k = 0; k < 1000; k++) {
+        fat32_chain_map(mount, &chain, (uint32_t)(rng() % 300), &cluster);
+    }
+    TEST_ASSERT(mount->cache_stats.misses + mount->cache_stats.hits == misses,
+                "Mapped chain answers without touching the FAT");
+    fat32_chain_destroy(&chain);
+
+    /* A loop must not hang the walk */
+    raw_set(order[299], order[10]);
+    mount = mount_image();
+    fat32_chain_init(&chain, order[0]);
+    TEST_ASSERT(fat32_chain_map(mount, &chain, 1000000, &cluster) != 0, "Looping chain stops");
+    fat32_chain_destroy(&chain);
+    TEST_ASSERT(fat32_free_cluster_chain(mount, order[0]) != 0, "Freeing a looping chain reports it");
+}
+
+static void test_files(void) {
+    printf("\nFile data:\n");
+
+    make_image(131072, 8, 2, 0);
+    fat32_mount_t* mount = mount_image();
+    uint32_t before = mount->free_count;
+
+    size_t len = 1536 * 1024 + 777;
+    uint8_t* data = malloc(len);
+    uint8_t* back = malloc(len);
+    fill_pattern(data, len, 7);
+
+    fat32_file_t file;
+    fat32_file_open(&file, 0, 0);
+    size_t pos = 0;
+    bool ok = true;
+    while (pos < len) {
+        uint32_t n = 1 + (uint32_t)(rng() % 20000);
+        if (n > len - pos) {
+            n = (uint32_t)(len - pos);
+        }
+        ok &= fat32_file_write(mount, &file, (uint32_t)pos, data + pos, n) == (int)n;
+        pos += n;
+    }
+    TEST_ASSERT(ok && file.size == len, "Appends in unaligned pieces");
+    TEST_ASSERT(file.first_cluster != 0 && file.chain.run_count == 1, "File lands in one run");
+
+    memset(back, 0, len);
+    TEST_ASSERT(fat32_file_read(mount, &file, 0, back, (uint32_t)len) == (int)len &&
+                memcmp(back, data, len) == 0, "Whole file reads back");
+    TEST_ASSERT(fat32_file_read(mount, &file, 1000, back, 10) == 10 &&
+                memcmp(back, data + 1000, 10) == 0, "Unaligned small read");
+    TEST_ASSERT(fat32_file_read(mount, &file, (uint32_t)len - 5, back, 100) == 5, "Read clamps at end of file");
+    TEST_ASSERT(fat32_file_read(mount, &file, (uint32_t)len, back, 100) == 0, "Read at end of file is empty");
+    TEST_ASSERT(fat32_file_write(mount, &file, (uint32_t)len + 1, data, 1) < 0, "Write past a hole refused");
+
+    fill_pattern(data + 5000, 70000, 99);
+    fat32_file_write(mount, &file, 5000, data + 5000, 70000);
+    TEST_ASSERT(fat32_file_read(mount, &file, 0, back, (uint32_t)len) == (int)len &&
+                memcmp(back, data, len) == 0, "Overwrite in the middle");
+
+    uint32_t clusters = (uint32_t)((len + mount->bytes_per_cluster - 1) / mount->bytes_per_cluster);
+    TEST_ASSERT(mount->free_count == before - clusters, "Exactly the clusters needed were taken");
+
+    /* Another file in between forces the first to fragment on growth */
+    fat32_file_t other;
+    fat32_file_open(&other, 0, 0);
+    fat32_file_write(mount, &other, 0, data, 10000);
+    uint8_t* tail = malloc(300000);
+    fill_pattern(tail, 300000, 3);
+    TEST_ASSERT(fat32_file_write(mount, &file, (uint32_t)len, tail, 300000) == 300000, "Grow past a neighbour");
+    TEST_ASSERT(file.chain.run_count == 2, "Growth adds one run");
+    TEST_ASSERT(fat32_file_read(mount, &file, (uint32_t)len, back, 300000) == 300000 &&
+                memcmp(back, tail, 300000) == 0, "Grown tail reads back");
+
+    uint32_t first = file.first_cluster;
+    uint32_t size = file.size;
+    fat32_file_close(&file);
+    fat32_file_close(&other);
+    fat32_unmount_device();
+    TEST_ASSERT(check_image(true), "Image consistent after unmount");
+
+    mount = mount_image();
+    fat32_file_open(&file, first, size);
+    TEST_ASSERT(fat32_file_read(mount, &file, 0, back, (uint32_t)len) == (int)len &&
+                memcmp(back, data, len) == 0, "Contents survive a remount");
+    TEST_ASSERT(fat32_file_read(mount, &file, (uint32_t)len, back, 300000) == 300000 &&
+                memcmp(back, tail, 300000) == 0, "Second run survives a remount");
+    fat32_file_close(&file);
+
+    uint32_t free_before = mount->free_count;
+    TEST_ASSERT(fat32_free_cluster_chain(mount, first) == 0, "Free the file's chain");
+    TEST_ASSERT(mount->free_count > free_before && mount->free_count == before - 3,
+                "Every cluster returned, the neighbour's kept");
+    fat32_sync(mount);
+    TEST_ASSERT(check_image(true), "Image consistent after free");
+
+    free(tail);
+    free(data);
+    free(back);
+}
+
+/* ---- Benchmark ---- */
+
+/* Cluster index of a file by walking the FAT from its start, the way a
+ * driver without a chain cache finds it */
+static uint32_t naive_map(fat32_mount_t* mount, uint32_t first, uint32_t index) {
+    uint32_t c = first;
+    while (index--) {
+        c = fat32_get_fat_entry(mount, c);
+    }
+    return c;
+}
+
+static void run_bench(void) {
+    printf("\nBenchmark:\n");
+
+    /* 512 MB volume, 4 KB clusters */
+    make_image(1024 * 1024, 8, 2, 0);
+    fat32_mount_t* mount = mount_image();
+
+    uint32_t chunk = 64 * 1024;
+    uint32_t total = 384u * 1024 * 1024;
+    uint8_t* buf = malloc(chunk);
+    fill_pattern(buf, chunk, 1);
+
+    fat32_file_t file;
+    fat32_file_open(&file, 0, 0);
+    uint64_t t0 = now_ns();
+    for (uint32_t off = 0; off < total; off += chunk) {
+        fat32_file_write(mount, &file, off, buf, chunk);
+    }
+    fat32_sync(mount);
+    uint64_t t1 = now_ns();
+    printf("  Sequential write: %u MB in %.1f ms, %.0f MB/s, %u run(s), %llu FAT sectors written\n",
+           total >> 20, (t1 - t0) / 1e6, (total / 1048576.0) / ((t1 - t0) / 1e9),
+           file.chain.run_count, (unsigned long long)mount->cache_stats.sectors_written);
+    fat32_file_close(&file);
+
+    /* A fragmented 64 MB file: clusters interleaved with another file */
+    make_image(1024 * 1024, 8, 2, 0);
+    uint32_t clusters = 16384;
+    raw_chain(100, clusters, 2);
+    raw_chain(101, clusters, 2);
+    mount = mount_image();
+    fat32_file_open(&file, 100, clusters * mount->bytes_per_cluster);
+
+    int seeks = 20000;
+    uint64_t sum = 0;
+    t0 = now_ns();
+    for (int i = 0; i < seeks; i++) {
+        uint32_t off = (uint32_t)(rng() % (file.size - 512));
+        fat32_file_read(mount, &file, off, buf, 512);
+        sum += buf[0];
+    }
+    t1 = now_ns();
+    int walks = seeks / 10;
+    uint64_t t2 = now_ns();
+    for (int i = 0; i < walks; i++) {
+        uint32_t index = (uint32_t)(rng() % clusters);
+        sum += naive_map(mount, 100, index);
+    }
+    uint64_t t3 = now_ns();
+    printf("  Random 512 B reads, %u-cluster fragmented file: %.2f us/seek cached, "
+           "%.2f us/seek FAT walk (map only), %.0fx\n",
+           clusters, (t1 - t0) / 1e3 / seeks, (t3 - t2) / 1e3 / walks,
+           ((t3 - t2) / (double)walks) / ((t1 - t0) / (double)seeks));
+    printf("  (checksum %llu)\n", (unsigned long long)sum);
+    fat32_file_close(&file);
+
+    free(buf);
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("Aurora OS FAT32 Allocation and FAT Cache Tests\n");
+
+    img_device = (fat32_device_t){ 0, &img, img_read, img_write, NULL };
+    fat32_init();
+    fat32_register_device("img0", &img_device);
+
+    test_mount_validation();
+    test_bitmap();
+    test_runs();
+    test_writeback();
+    test_cache();
+    test_chain_map();
+    test_files();
+
+    if (bench) {
+        run_bench();
+    }
+    if (fat32_get_mount()) {
+        fat32_unmount_device();
+    }
+
+    free(img.data);
+    printf("\nPassed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
@@ -0,0 +1,372 @@
+/**
+ * Aurora OS - File Descriptor Table Tests
+ *
+ * Host-built harness for filesystem/vfs/fdtable.c and the VFS calls on
+ * top of it: lowest-free allocation, growth past the initial 64 slots
+ * and the per-process limit, open file refcounts across dup, dup2 and
+ * fork, close-on-exec, and separate tables seeing separate descriptors
+ * while sharing offsets through inherited open files. "Processes" are
+ * tables swapped in with fdtable_set_kernel(). With --bench, install and
+ * close throughput up to 1M descriptors against the old linear scan of
+ * a fixed array, and vfs_open()/vfs_close() on a ramdisk.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include "../../filesystem/vfs/fdtable.h"
+#include "../../filesystem/vfs/vfs.h"
+#include "../../filesystem/ramdisk/ramdisk.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/* ---- Kernel service stubs ---- */
+
+void* kmalloc(size_t size) {
+    return malloc(size);
+}
+
+void kfree(void* ptr) {
+    free(ptr);
+}
+
+uint32_t smp_get_current_cpu_id(void) {
+    return 0;
+}
+
+void cpu_relax(void) {
+    sched_yield();
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static void setup_ramdisk(void) {
+    ramdisk_create(0);
+    vfs_init();
+    vfs_register_fs("ramdisk", ramdisk_get_ops());
+    vfs_mount("ramdisk0", "/", "ramdisk");
+}
+
+/* ---- Allocation ---- */
+
+static void test_alloc(void) {
+    printf("\nAllocation:\n");
+
+    files_t* files = fdtable_create();
+    file_t* file = file_alloc(NULL, NULL, 0);
+    TEST_ASSERT(files && file, "Table and open file created");
+    TEST_ASSERT(files->max_fds == FDTABLE_INIT_FDS, "Table starts at the initial size");
+
+    int ok = 1;
+    for (int i = 0; i < 10; i++) {
+        ok &= fd_install(files, file_get(file), 0, 0) == i;
+    }
+    TEST_ASSERT(ok, "Descriptors are handed out from 0 upwards");
+    TEST_ASSERT(file->refcount == 11, "Each descriptor holds a reference");
+
+    fd_close(files, 3);
+    fd_close(files, 7);
+    TEST_ASSERT(fd_get(files, 3) == NULL, "Closed descriptor is gone");
+    TEST_ASSERT(fd_close(files, 3) == -1, "Closing it again fails");
+    TEST_ASSERT(fd_install(files, file_get(file), 0, 0) == 3, "Lowest hole is reused first");
+    TEST_ASSERT(fd_install(files, file_get(file), 0, 0) == 7, "Then the next hole");
+    TEST_ASSERT(fd_install(files, file_get(file), 0, 0) == 10, "Then past the end");
+    TEST_ASSERT(fd_install(files, file_get(file), 5, 0) == 11, "min_fd skips used slots");
+    TEST_ASSERT(fd_install(files, file_get(file), 40, 0) == 40, "min_fd lands on a free slot");
+    TEST_ASSERT(fd_install(files, file_get(file), 0, 0) == 12, "Lower slots are still used first");
+    TEST_ASSERT(fd_get(files, -1) == NULL && fd_get(files, 1 << 30) == NULL,
+                "Out-of-range descriptors are not open");
+
+    ok = 1;
+    for (int i = 13; i < 5000; i++) {
+        if (i == 40) {
+            continue;
+        }
+        ok &= fd_install(files, file_get(file), 0, 0) == i;
+    }
+    TEST_ASSERT(ok, "Filling past the initial size stays dense");
+    TEST_ASSERT(files->max_fds >= 5000 && files->max_fds <= 8192, "Table grew by doubling");
+    TEST_ASSERT(fd_get(files, 4999) == file && fd_get(files, 0) == file,
+                "Descriptors survive growth");
+
+    fd_close(files, 2049);
+    fd_close(files, 4097);
+    TEST_ASSERT(fd_install(files, file_get(file), 0, 0) == 2049,
+                "Hole behind full words is found");
+    TEST_ASSERT(fd_install(files, file_get(file), 3000, 0) == 4097,
+                "Hole past min_fd is found");
+    TEST_ASSERT(fd_install(files, file_get(file), 100000, 0) == 100000,
+                "min_fd past the end grows the table");
+    TEST_ASSERT(files->count == 5001, "Count tracks open descriptors");
+
+    int too_big = fd_install(files, file_get(file), FDTABLE_MAX_FDS, 0);
+    TEST_ASSERT(too_big == -1, "Descriptors stop at the per-process limit");
+    file_put(file);
+
+    fdtable_destroy(files);
+    TEST_ASSERT(file->refcount == 1, "Destroying the table drops its references");
+    file_put(file);
+}
+
+/* ---- Sharing ---- */
+
+static void test_sharing(void) {
+    printf("\nSharing:\n");
+
+    files_t* files = fdtable_create();
+    file_t* a = file_alloc(NULL, NULL, 0);
+    file_t* b = file_alloc(NULL, NULL, 0);
+    file_get(a);
+    file_get(b);
+    int fa = fd_install(files, a, 0, 0);
+    int fb = fd_install(files, b, 0, 1);
+
+    int fd = fd_dup(files, fa, 0);
+    TEST_ASSERT(fd == 2 && fd_get(files, fd) == a, "dup() shares the open file");
+    TEST_ASSERT(a->refcount == 3, "dup() takes a reference");
+    TEST_ASSERT(fd_get_cloexec(files, fb) == 1, "Descriptor opened close-on-exec");
+    fd = fd_dup(files, fb, 10);
+    TEST_ASSERT(fd == 10 && fd_get_cloexec(files, fd) == 0,
+                "dup() with min_fd clears close-on-exec");
+    TEST_ASSERT(fd_dup(files, 30, 0) == -1, "dup() of a closed descriptor fails");
+
+    TEST_ASSERT(fd_dup2(files, fa, fb) == fb, "dup2() onto an open descriptor");
+    TEST_ASSERT(fd_get(files, fb) == a && b->refcount == 2,
+                "dup2() replaces the open file and drops its reference");
+    TEST_ASSERT(fd_get_cloexec(files, fb) == 0, "dup2() clears close-on-exec");
+    TEST_ASSERT(fd_dup2(files, fa, fa) == fa && a->refcount == 4,
+                "dup2() onto itself changes nothing");
+    TEST_ASSERT(fd_dup2(files, fa, 300) == 300 && files->max_fds >= 301,
+                "dup2() past the end grows the table");
+    TEST_ASSERT(fd_dup2(files, 299, 5) == -1, "dup2() from a closed descriptor fails");
+    TEST_ASSERT(fd_install(files, file_get(a), 0, 0) == 3, "dup2() slots are skipped");
+
+    fd_set_cloexec(files, fa, 1);
+    fd_set_cloexec(files, 300, 1);
+    TEST_ASSERT(fd_set_cloexec(files, 31, 1) == -1, "Flags on a closed descriptor fail");
+
+    files_t* child = fdtable_fork(files);
+    TEST_ASSERT(child && child->count == files->count, "Fork copies every descriptor");
+    TEST_ASSERT(fd_get(child, 300) == a && fd_get(child, 10) == b,
+                "Child refers to the same open files");
+    TEST_ASSERT(a->refcount == 11 && b->refcount == 3, "Child takes its own references");
+    TEST_ASSERT(fd_get_cloexec(child, fa) == 1, "Child keeps close-on-exec flags");
+
+    fdtable_exec(child);
+    TEST_ASSERT(fd_get(child, fa) == NULL && fd_get(child, 300) == NULL,
+                "exec closes close-on-exec descriptors");
+    TEST_ASSERT(fd_get(child, fb) == a && fd_get(child, 10) == b,
+                "exec keeps the others");
+    TEST_ASSERT(fd_get(files, fa) == a, "Parent is unaffected by the child's exec");
+    TEST_ASSERT(fd_install(child, file_get(b), 0, 0) == fa, "Freed slot is reused");
+
+    fdtable_destroy(child);
+    fdtable_destroy(files);
+    TEST_ASSERT(a->refcount == 1 && b->refcount == 1, "Only the test's references remain");
+    file_put(a);
+    file_put(b);
+}
+
+/* ---- VFS descriptors ---- */
+
+static void test_vfs(void) {
+    printf("\nVFS descriptors:\n");
+
+    setup_ramdisk();
+    vfs_create("/f");
+    int fd = vfs_open("/f", O_RDWR);
+    TEST_ASSERT(fd == 0, "First open gets descriptor 0");
+    vfs_write(fd, "abcdef", 6);
+    vfs_seek(fd, 0, SEEK_SET);
+
+    int dup = vfs_dup(fd);
+    char c = 0;
+    vfs_read(dup, &c, 1);
+    TEST_ASSERT(dup == 1 && c == 'a', "Duplicate reads the same file");
+    vfs_read(fd, &c, 1);
+    TEST_ASSERT(c == 'b', "Duplicates share the file offset");
+
+    TEST_ASSERT(vfs_close(fd) == 0, "Close the original");
+    vfs_read(dup, &c, 1);
+    TEST_ASSERT(c == 'c', "Duplicate keeps the open file alive");
+
+    /* Switch to a forked "process" */
+    files_t* parent = fdtable_current();
+    files_t* child = fdtable_fork(parent);
+    fdtable_set_kernel(child);
+    vfs_read(dup, &c, 1);
+    TEST_ASSERT(c == 'd', "Forked table shares the offset");
+    int cfd = vfs_open("/f", O_RDONLY | O_CLOEXEC);
+    TEST_ASSERT(cfd == 0, "Child allocates in its own table");
+    vfs_read(cfd, &c, 1);
+    TEST_ASSERT(c == 'a', "A fresh open has its own offset");
+    TEST_ASSERT(fd_get_cloexec(child, cfd) == 1, "O_CLOEXEC marks the descriptor");
+    TEST_ASSERT(vfs_set_cloexec(cfd, 0) == 0 && fd_get_cloexec(child, cfd) == 0,
+                "vfs_set_cloexec() clears it");
+    TEST_ASSERT(vfs_dup2(cfd, 7) == 7, "vfs_dup2() to a chosen number");
+
+    fdtable_set_kernel(parent);
+    TEST_ASSERT(fd_get(parent, 0) == NULL && fd_get(parent, 7) == NULL,
+                "Parent does not see the child's descriptors");
+    vfs_read(dup, &c, 1);
+    TEST_ASSERT(c == 'e', "Parent sees the offset the child advanced");
+    fdtable_destroy(child);
+    vfs_read(dup, &c, 1);
+    TEST_ASSERT(c == 'f', "Shared open file outlives the child's table");
+    vfs_close(dup);
+
+    int dfd = vfs_opendir("/");
+    TEST_ASSERT(dfd == 0, "Directory descriptors come from the same table");
+    vfs_close(dfd);
+    TEST_ASSERT(vfs_read(dfd, &c, 1) == -1, "Closed descriptor cannot be read");
+    TEST_ASSERT(vfs_close(dfd) == -1, "Closed descriptor cannot be closed again");
+}
+
+/* ---- Benchmark ---- */
+
+#define BENCH_FDS FDTABLE_MAX_FDS
+
+/* The former global table: a fixed array searched from slot 0 */
+static file_t* linear_table[BENCH_FDS];
+
+static int linear_alloc(file_t* file) {
+    for (uint32_t i = 0; i < BENCH_FDS; i++) {
+        if (!linear_table[i]) {
+            linear_table[i] = file;
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static void bench_linear(file_t* file, uint32_t open_fds, int iterations) {
+    memset(linear_table, 0, sizeof(linear_table));
+    for (uint32_t i = 0; i < open_fds; i++) {
+        linear_table[i] = file;
+    }
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        uint32_t fd = (uint32_t)(rng() % open_fds);
+        linear_table[fd] = NULL;
+        linear_alloc(file);
+    }
+    uint64_t elapsed = now_ns() - start;
+    printf("  %-38s %10.0f ns/close+open\n", "fixed array, linear scan",
+           (double)elapsed / iterations);
+}
+
+static void bench_churn(files_t* files, file_t* file, uint32_t open_fds, int iterations) {
+    uint64_t start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        fd_close(files, (int)(rng() % open_fds));
+        fd_install(files, file_get(file), 0, 0);
+    }
+    uint64_t elapsed = now_ns() - start;
+    printf("  %-38s %10.0f ns/close+open\n", "fd table, bitmap search",
+           (double)elapsed / iterations);
+}
+
+static void run_bench(void) {
+    printf("\nBenchmark (%u descriptors):\n", BENCH_FDS);
+
+    files_t* files = fdtable_create();
+    file_t* file = file_alloc(NULL, NULL, 0);
+
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < BENCH_FDS; i++) {
+        fd_install(files, file_get(file), 0, 0);
+    }
+    uint64_t elapsed = now_ns() - start;
+    printf("  %-38s %10.1f ns/open  (%u slots)\n", "fill 1M, growing from 64",
+           (double)elapsed / BENCH_FDS, files->max_fds);
+
+    start = now_ns();
+    for (uint32_t i = 0; i < BENCH_FDS; i++) {
+        fd_get(files, (int)(rng() % BENCH_FDS));
+    }
+    elapsed = now_ns() - start;
+    printf("  %-38s %10.1f ns/lookup\n", "random lookup, 1M open",
+           (double)elapsed / BENCH_FDS);
+
+    printf(" Random close then reopen, table full:\n");
+    bench_churn(files, file, BENCH_FDS, 1000000);
+    bench_linear(file, BENCH_FDS, 2000);
+
+    printf(" Random close then reopen, 1k open:\n");
+    files_t* small = fdtable_create();
+    for (uint32_t i = 0; i < 1024; i++) {
+        fd_install(small, file_get(file), 0, 0);
+    }
+    bench_churn(small, file, 1024, 1000000);
+    bench_linear(file, 1024, 1000000);
+    fdtable_destroy(small);
+
+    start = now_ns();
+    for (uint32_t i = 0; i < BENCH_FDS; i++) {
+        fd_close(files, (int)i);
+    }
+    elapsed = now_ns() - start;
+    printf("  %-38s %10.1f ns/close\n", "close all 1M", (double)elapsed / BENCH_FDS);
+    fdtable_destroy(files);
+    file_put(file);
+
+    /* Whole-path cost through the VFS, with many descriptors open */
+    setup_ramdisk();
+    vfs_create("/bench");
+    for (int i = 0; i < 100000; i++) {
+        vfs_open("/bench", O_RDONLY);
+    }
+    start = now_ns();
+    for (int i = 0; i < 1000000; i++) {
+        int fd = vfs_open("/bench", O_RDONLY);
+        vfs_close(fd);
+    }
+    elapsed = now_ns() - start;
+    printf("  %-38s %10.0f ns/open+close\n", "vfs_open/vfs_close, 100k open",
+           (double)elapsed / 1000000);
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("Aurora OS File Descriptor Table Tests\n");
+
+    test_alloc();
+    test_sharing();
+    test_vfs();
+
+    if (bench) {
+        run_bench();
+    }
+
+    printf("\nPassed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
@@ -0,0 +1,547 @@
+/**
+ * Aurora OS - GDB Remote Stub Tests
+ *
+ * Host-built harness for the GDB server (src/platform/gdb_server.c) and the
+ * in-VM packet handler. Acts as the GDB client over the in-memory socket
+ * stand-in: frames packets, checks acks and checksums, exercises binary
+ * memory transfer, qXfer:memory-map, vCont and no-ack mode, and (with
+ * --bench) measures full memory dump throughput.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../include/platform/aurora_vm.h"
+#include "../../kernel/network/network.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/* ---- GDB server API (no public header) ---- */
+
+int gdb_server_init(AuroraVM* vm, uint16_t port);
+int gdb_server_start(void);
+void gdb_server_stop(void);
+int gdb_server_poll(void);
+void gdb_server_inject_data(const char* data, uint32_t length);
+uint32_t gdb_server_get_sent_data(char* buffer, uint32_t max_len);
+
+/* ---- Kernel service stubs: no network stack, so the ring buffers are used ---- */
+
+socket_t* socket_create(uint8_t protocol) { (void)protocol; return NULL; }
+int socket_bind(socket_t* sock, uint16_t port) { (void)sock; (void)port; return -1; }
+int socket_send(socket_t* sock, uint8_t* data, uint32_t length) {
+    (void)sock; (void)data; (void)length;
+    return -1;
+}
+int socket_receive(socket_t* sock, uint8_t* data, uint32_t max_length) {
+    (void)sock; (void)data; (void)max_length;
+    return -1;
+}
+void socket_close(socket_t* sock) { (void)sock; }
+
+/* ---- Client side of the protocol ---- */
+
+#define CLIENT_BUF_SIZE 0x10000
+
+static char g_wire[CLIENT_BUF_SIZE];
+static char g_frame[CLIENT_BUF_SIZE];
+static int g_acks = 0;
+static int g_nacks = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int nibble(char c) {
+    return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+/* Frame a payload ($...#cs) escaping binary data */
+static size_t frame_packet(const char* payload, size_t len, char* out) {
+    size_t n = 0;
+    uint8_t sum = 0;
+    out[n++] = '$';
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = (uint8_t)payload[i];
+        if (c == '$' || c == '#' || c == '}' || c == '*') {
+            out[n++] = '}';
+            sum += '}';
+            c ^= 0x20;
+        }
+        out[n++] = (char)c;
+        sum += c;
+    }
+    n += (size_t)sprintf(out + n, "#%02x", sum);
+    return n;
+}
+
+/* Send a framed packet and let the server process it */
+static void client_send(const char* payload, size_t len) {
+    size_t n = frame_packet(payload, len, g_frame);
+    gdb_server_inject_data(g_frame, (uint32_t)n);
+    gdb_server_poll();
+}
+
+static void client_send_str(const char* payload) {
+    client_send(payload, strlen(payload));
+}
+
+/*
+ * Decode the next reply from raw wire bytes, counting acks on the way
+ * Returns payload length, or -1 if no valid packet was found
+ */
+static int decode_reply(const char** cursor, const char* end, char* out) {
+    const char* p = *cursor;
+    while (p < end && *p != '$') {
+        if (*p == '+') g_acks++;
+        if (*p == '-') g_nacks++;
+        p++;
+    }
+    if (p >= end) {
+        *cursor = p;
+        return -1;
+    }
+    p++;
+
+    int n = 0;
+    uint8_t sum = 0;
+    while (p < end && *p != '#') {
+        uint8_t c = (uint8_t)*p++;
+        sum += c;
+        if (c == '}') {
+            c = (uint8_t)*p++;
+            sum += c;
+            c ^= 0x20;
+        }
+        out[n++] = (char)c;
+    }
+    if (p + 3 > end) {
+        *cursor = end;
+        return -1;
+    }
+    unsigned int expected = (unsigned int)((nibble(p[1]) << 4) | nibble(p[2]));
+    *cursor = p + 3;
+    out[n] = '\0';
+    return expected == sum ? n : -1;
+}
+
+/* Fetch the single reply the last command produced */
+static int client_recv(char* out) {
+    uint32_t len = gdb_server_get_sent_data(g_wire, sizeof(g_wire));
+    const char* cursor = g_wire;
+    return decode_reply(&cursor, g_wire + len, out);
+}
+
+static void server_restart(AuroraVM* vm) {
+    gdb_server_stop();
+    gdb_server_init(vm, 1234);
+    gdb_server_start();
+    g_acks = 0;
+    g_nacks = 0;
+}
+
+static void hex_encode(const uint8_t* data, size_t len, char* out) {
+    for (size_t i = 0; i < len; i++) {
+        sprintf(out + i * 2, "%02x", data[i]);
+    }
+}
+
+/* Decoded by hand: sscanf would strlen() the whole reply per byte */
+static void hex_decode(const char* hex, size_t len, uint8_t* out) {
+    for (size_t i = 0; i < len; i++) {
+        out[i] = (uint8_t)((nibble(hex[i * 2]) << 4) | nibble(hex[i * 2 + 1]));
+    }
+}
+
+/* ---- Tests ---- */
+
+static void test_framing(AuroraVM* vm) {
+    printf("\n=== Framing, acks and negotiation ===\n");
+    server_restart(vm);
+    char reply[CLIENT_BUF_SIZE];
+
+    client_send_str("qSupported:multiprocess+;swbreak+;xmlRegisters=i386");
+    int n = client_recv(reply);
+    TEST_ASSERT(n > 0 && g_acks == 1, "qSupported acked and answered");
+    TEST_ASSERT(strstr(reply, "PacketSize=4000") != NULL, "PacketSize raised to 0x4000");
+    TEST_ASSERT(strstr(reply, "QStartNoAckMode+") && strstr(reply, "qXfer:memory-map:read+") &&
+                strstr(reply, "vContSupported+"), "no-ack, memory-map and vCont advertised");
+
+    /* Corrupted checksum must be rejected without a reply */
+    const char* bad = "$qAttached#00";
+    gdb_server_inject_data(bad, (uint32_t)strlen(bad));
+    gdb_server_poll();
+    g_acks = 0;
+    n = client_recv(reply);
+    TEST_ASSERT(n < 0 && g_nacks == 1 && g_acks == 0, "bad checksum NACKed and dropped");
+
+    /* Two pipelined packets in one receive produce two replies */
+    size_t len = frame_packet("qAttached", 9, g_frame);
+    len += frame_packet("qC", 2, g_frame + len);
+    gdb_server_inject_data(g_frame, (uint32_t)len);
+    gdb_server_poll();
+    uint32_t wire = gdb_server_get_sent_data(g_wire, sizeof(g_wire));
+    const char* cursor = g_wire;
+    char second[64];
+    int a = decode_reply(&cursor, g_wire + wire, reply);
+    int b = decode_reply(&cursor, g_wire + wire, second);
+    TEST_ASSERT(a == 1 && reply[0] == '1' && b == 3 && strcmp(second, "QC1") == 0,
+                "pipelined packets each answered");
+
+    /* Register read is one batch in target byte order */
+    aurora_vm_set_register(vm, 1, 0x11223344);
+    vm->cpu.pc = 0x80;
+    client_send_str("g");
+    n = client_recv(reply);
+    TEST_ASSERT(n == 18 * 8, "g returns 16 GPRs, PC and flags");
+    TEST_ASSERT(strncmp(reply + 8, "44332211", 8) == 0 && strncmp(reply + 16 * 8, "80000000", 8) == 0,
+                "registers little-endian");
+
+    /* No-ack mode: the OK is acked, later packets are not */
+    g_acks = 0;
+    client_send_str("QStartNoAckMode");
+    n = client_recv(reply);
+    TEST_ASSERT(n == 2 && strcmp(reply, "OK") == 0 && g_acks == 1, "QStartNoAckMode acked");
+    g_acks = 0;
+    client_send_str("qAttached");
+    n = client_recv(reply);
+    TEST_ASSERT(n == 1 && g_acks == 0, "no acks after QStartNoAckMode");
+}
+
+static void test_binary_memory(AuroraVM* vm) {
+    printf("\n=== Binary memory transfer ===\n");
+    server_restart(vm);
+    char reply[CLIENT_BUF_SIZE];
+    char cmd[CLIENT_BUF_SIZE];
+    int n;
+
+    /* Every reserved character plus NUL must round-trip through X */
+    uint8_t data[256];
+    for (int i = 0; i < 256; i++) data[i] = (uint8_t)(255 - i);
+    data[0] = '#'; data[1] = '$'; data[2] = '}'; data[3] = '*'; data[4] = 0;
+
+    int hdr = sprintf(cmd, "X4100,%x:", (unsigned)sizeof(data));
+    memcpy(cmd + hdr, data, sizeof(data));
+    client_send(cmd, (size_t)hdr + sizeof(data));
+    n = client_recv(reply);
+    TEST_ASSERT(n == 2 && strcmp(reply, "OK") == 0, "X write accepted");
+    TEST_ASSERT(memcmp(&vm->memory[0x4100], data, sizeof(data)) == 0, "X write stored escaped bytes");
+
+    client_send_str("X4100,0:");
+    n = client_recv(reply);
+    TEST_ASSERT(n == 2 && strcmp(reply, "OK") == 0, "zero-length X probe");
+
+    client_send_str("X0,4:abcd");
+    n = client_recv(reply);
+    TEST_ASSERT(n == 3 && reply[0] == 'E', "X into read-only code pages rejected");
+
+    client_send_str("x4100,100");
+    n = client_recv(reply);
+    TEST_ASSERT(n == 257 && reply[0] == 'b' && memcmp(reply + 1, data, sizeof(data)) == 0,
+                "x binary read round-trips");
+
+    client_send_str("m4100,100");
+    n = client_recv(reply);
+    uint8_t decoded[256];
+    hex_decode(reply, sizeof(decoded), decoded);
+    TEST_ASSERT(n == 512 && memcmp(decoded, data, sizeof(data)) == 0, "m hex read matches");
+
+    /* Replies stay at the legacy size until qSupported is exchanged */
+    client_send_str("m4000,2000");
+    n = client_recv(reply);
+    TEST_ASSERT(n == (0x400 - 1) / 2 * 2, "m capped at legacy size before negotiation");
+
+    client_send_str("qSupported");
+    client_recv(reply);
+    client_send_str("m4000,2000");
+    n = client_recv(reply);
+    TEST_ASSERT(n == (0x4000 - 1) / 2 * 2, "m uses negotiated PacketSize");
+
+    /* A large M write spanning several old packet limits */
+    uint8_t big[0x1000];
+    for (size_t i = 0; i < sizeof(big); i++) big[i] = (uint8_t)(i * 7);
+    hdr = sprintf(cmd, "M5000,%x:", (unsigned)sizeof(big));
+    hex_encode(big, sizeof(big), cmd + hdr);
+    client_send(cmd, (size_t)hdr + sizeof(big) * 2);
+    n = client_recv(reply);
+    TEST_ASSERT(n == 2 && memcmp(&vm->memory[0x5000], big, sizeof(big)) == 0, "4KB M write");
+
+    /* Escape-heavy data is trimmed so the escaped x reply still fits */
+    memset(&vm->memory[0x6000], '}', 0x3000);
+    client_send_str("x6000,3000");
+    n = client_recv(reply);
+    TEST_ASSERT(n > 1 && reply[0] == 'b' && (n - 1) * 2 <= 0x4000 - 1, "escaped x reply fits packet");
+}
+
+static void test_memory_map(AuroraVM* vm) {
+    printf("\n=== qXfer:memory-map ===\n");
+    server_restart(vm);
+    char reply[CLIENT_BUF_SIZE];
+    char doc[4096];
+    size_t doc_len = 0;
+    int chunks = 0;
+
+    for (;;) {
+        char cmd[64];
+        sprintf(cmd, "qXfer:memory-map:read::%zx,20", doc_len);
+        client_send_str(cmd);
+        int n = client_recv(reply);
+        if (n < 1 || (reply[0] != 'm' && reply[0] != 'l')) break;
+        memcpy(doc + doc_len, reply + 1, (size_t)n - 1);
+        doc_len += (size_t)n - 1;
+        chunks++;
+        if (reply[0] == 'l') break;
+    }
+    doc[doc_len] = '\0';
+
+    char direct[4096];
+    int direct_len = aurora_vm_gdb_memory_map(vm, direct, sizeof(direct));
+    TEST_ASSERT(chunks > 1 && (int)doc_len == direct_len && strcmp(doc, direct) == 0,
+                "chunked transfer reassembles the document");
+    TEST_ASSERT(strstr(doc, "<memory type=\"rom\" start=\"0x0\" length=\"0x4000\"/>") != NULL,
+                "code pages reported as rom");
+    TEST_ASSERT(strstr(doc, "<memory type=\"ram\" start=\"0x4000\" length=\"0x8000\"/>") != NULL,
+                "heap pages coalesced into one ram region");
+    TEST_ASSERT(strstr(doc, "<memory type=\"ram\" start=\"0xc000\" length=\"0x2000\"/>") != NULL &&
+                strstr(doc, "<memory type=\"ram\" start=\"0xe000\" length=\"0x2000\"/>") != NULL,
+                "MMIO window kept separate from the stack");
+}
+
+static void test_vcont(AuroraVM* vm) {
+    printf("\n=== vCont ===\n");
+    server_restart(vm);
+    char reply[CLIENT_BUF_SIZE];
+    int n;
+
+    client_send_str("vCont?");
+    n = client_recv(reply);
+    TEST_ASSERT(n > 0 && strcmp(reply, "vCont;c;C;s;S;r") == 0, "vCont? lists actions");
+
+    vm->cpu.halted = false;
+    vm->cpu.pc = 0;
+    client_send_str("vCont;s:1");
+    n = client_recv(reply);
+    TEST_ASSERT(n == 3 && strcmp(reply, "S05") == 0 && vm->cpu.pc == 4, "vCont;s steps once");
+
+    uint64_t before = aurora_vm_debugger_get_instruction_count(vm);
+    client_send_str("vCont;r4,100:1");
+    n = client_recv(reply);
+    TEST_ASSERT(n == 3 && vm->cpu.pc == 0x100, "vCont;r range-steps to end of range");
+    TEST_ASSERT(aurora_vm_debugger_get_instruction_count(vm) - before == (0x100 - 4) / 4,
+                "range step executed the whole range in one packet");
+}
+
+static void test_vm_handler(AuroraVM* vm) {
+    printf("\n=== In-VM packet handler ===\n");
+    char resp[8192];
+    char cmd[1024];
+    char reply[8192];
+    int n;
+
+    aurora_vm_gdb_start(vm, 1234);
+    vm->gdb.no_ack_mode = false;
+
+    n = aurora_vm_gdb_process_packet(vm, "$qSupported#37", resp, sizeof(resp));
+    TEST_ASSERT(n > 0 && resp[0] == '+' && strstr(resp, "PacketSize=1000;QStartNoAckMode+") != NULL,
+                "qSupported acked with features");
+
+    uint8_t data[8] = { '#', '$', '}', '*', 0, 1, 2, 3 };
+    int hdr = sprintf(cmd, "X4200,%x:", (unsigned)sizeof(data));
+    memcpy(cmd + hdr, data, sizeof(data));
+    size_t len = frame_packet(cmd, (size_t)hdr + sizeof(data), g_frame);
+    g_frame[len] = '\0';
+    n = aurora_vm_gdb_process_packet(vm, g_frame, resp, sizeof(resp));
+    TEST_ASSERT(n > 0 && memcmp(&vm->memory[0x4200], data, sizeof(data)) == 0, "X write with NUL and escapes");
+
+    /* addr + len wraps to 0: must not pass the bounds check */
+    uint8_t guard = vm->memory[0];
+    len = frame_packet("Xffffffff,1:a", 13, g_frame);
+    g_frame[len] = '\0';
+    n = aurora_vm_gdb_process_packet(vm, g_frame, resp, sizeof(resp));
+    TEST_ASSERT(n > 0 && strstr(resp, "E01") != NULL && vm->memory[0] == guard,
+                "X with a wrapping address range rejected");
+    len = frame_packet("Mffffffff,1:61", 14, g_frame);
+    g_frame[len] = '\0';
+    n = aurora_vm_gdb_process_packet(vm, g_frame, resp, sizeof(resp));
+    TEST_ASSERT(n > 0 && strstr(resp, "E01") != NULL, "M with a wrapping address range rejected");
+    len = frame_packet("mffffffff,2", 11, g_frame);
+    g_frame[len] = '\0';
+    n = aurora_vm_gdb_process_packet(vm, g_frame, resp, sizeof(resp));
+    TEST_ASSERT(n > 0 && strstr(resp, "E01") != NULL, "m with a wrapping address range rejected");
+
+    n = aurora_vm_gdb_process_packet(vm, "$x4200,8#b0", resp, sizeof(resp));
+    const char* cursor = resp;
+    int rn = decode_reply(&cursor, resp + n, reply);
+    TEST_ASSERT(rn == 9 && reply[0] == 'b' && memcmp(reply + 1, data, sizeof(data)) == 0,
+                "x binary read");
+
+    n = aurora_vm_gdb_process_packet(vm, "$m4000,400#c0", resp, sizeof(resp));
+    cursor = resp;
+    rn = decode_reply(&cursor, resp + n, reply);
+    TEST_ASSERT(rn == 0x800, "1KB m read fits the raised reply buffer");
+
+    len = frame_packet("qXfer:memory-map:read::0,400", 28, g_frame);
+    g_frame[len] = '\0';
+    n = aurora_vm_gdb_process_packet(vm, g_frame, resp, sizeof(resp));
+    cursor = resp;
+    rn = decode_reply(&cursor, resp + n, reply);
+    TEST_ASSERT(rn > 0 && reply[0] == 'l' && strstr(reply, "<memory-map>") != NULL, "memory map");
+
+    vm->cpu.halted = false;
+    vm->cpu.pc = 0;
+    len = frame_packet("vCont;r0,40", 11, g_frame);
+    g_frame[len] = '\0';
+    n = aurora_vm_gdb_process_packet(vm, g_frame, resp, sizeof(resp));
+    TEST_ASSERT(n > 0 && vm->cpu.pc == 0x40, "vCont range step");
+
+    len = frame_packet("QStartNoAckMode", 15, g_frame);
+    g_frame[len] = '\0';
+    n = aurora_vm_gdb_process_packet(vm, g_frame, resp, sizeof(resp));
+    TEST_ASSERT(n > 0 && resp[0] == '+', "QStartNoAckMode reply acked");
+    n = aurora_vm_gdb_process_packet(vm, "$?#3f", resp, sizeof(resp));
+    TEST_ASSERT(n > 0 && resp[0] == '$', "later replies not acked");
+
+    aurora_vm_gdb_stop(vm);
+}
+
+/* ---- Benchmark ---- */
+
+/*
+ * Full memory dump: read the whole 64KB address space through the socket
+ * stand-in, decoding every reply as the client would.
+ *  legacy - m packets at the old 512-byte read cap, acks on
+ *  m      - m packets at the negotiated PacketSize, no-ack
+ *  x      - binary x packets at the negotiated PacketSize, no-ack
+ * The stand-in has no round-trip latency, so packets/dump is reported too:
+ * on a real link each packet costs at least one RTT.
+ */
+static void bench_memory_dump(AuroraVM* vm) {
+    const int iterations = 200;
+    static uint8_t expected[AURORA_VM_MEMORY_SIZE];
+    static uint8_t dump[AURORA_VM_MEMORY_SIZE];
+    static char reply[CLIENT_BUF_SIZE];
+
+    srand(1);
+    for (uint32_t i = 0; i < AURORA_VM_MEMORY_SIZE; i++) {
+        vm->memory[i] = (uint8_t)rand();
+    }
+    memcpy(expected, vm->memory, sizeof(expected));
+    memset(expected + AURORA_VM_MMIO_BASE, 0, AURORA_VM_MMIO_SIZE);  /* MMIO reads as zero */
+
+    /* Dump region by region, as GDB splits accesses at map boundaries */
+    char map[1024];
+    uint32_t regions[16][2];
+    int num_regions = 0;
+    aurora_vm_gdb_memory_map(vm, map, sizeof(map));
+    for (const char* p = strstr(map, "start="); p && num_regions < 16; p = strstr(p + 1, "start=")) {
+        sscanf(p, "start=\"0x%x\" length=\"0x%x\"", &regions[num_regions][0], &regions[num_regions][1]);
+        num_regions++;
+    }
+
+    printf("\n=== Benchmark: full memory dump (%u KB, %d regions) ===\n",
+           AURORA_VM_MEMORY_SIZE / 1024, num_regions);
+
+    const char* names[3] = { "legacy m (512B, acks)", "m (negotiated, no-ack)", "x binary (no-ack)" };
+    double rates[3];
+    for (int mode = 0; mode < 3; mode++) {
+        server_restart(vm);
+        if (mode > 0) {
+            client_send_str("qSupported");
+            client_recv(reply);
+            client_send_str("QStartNoAckMode");
+            client_recv(reply);
+        }
+        uint32_t chunk = mode == 0 ? 0x200 : mode == 1 ? 0x1fff : 0x3ffe;
+
+        int ok = 1;
+        uint32_t packets = 0;
+        uint64_t t0 = now_ns();
+        for (int it = 0; it < iterations && ok; it++) {
+            for (int r = 0; r < num_regions && ok; r++) {
+                uint32_t addr = regions[r][0];
+                uint32_t end = regions[r][0] + regions[r][1];
+                while (addr < end) {
+                    uint32_t want = end - addr;
+                    if (want > chunk) want = chunk;
+                    char cmd[32];
+                    sprintf(cmd, "%c%x,%x", mode == 2 ? 'x' : 'm', addr, want);
+                    client_send_str(cmd);
+                    packets++;
+                    int n = client_recv(reply);
+                    uint32_t got;
+                    if (mode == 2) {
+                        if (n < 2 || reply[0] != 'b') { ok = 0; break; }
+                        got = (uint32_t)n - 1;
+                        memcpy(dump + addr, reply + 1, got);
+                    } else {
+                        if (n < 2 || reply[0] == 'E') { ok = 0; break; }
+                        got = (uint32_t)n / 2;
+                        hex_decode(reply, got, dump + addr);
+                    }
+                    addr += got;
+                }
+            }
+        }
+        uint64_t elapsed = now_ns() - t0;
+
+        if (!ok || memcmp(dump, expected, sizeof(dump)) != 0) {
+            printf("  %-24s dump mismatch!\n", names[mode]);
+            tests_failed++;
+            rates[mode] = 0;
+            continue;
+        }
+        rates[mode] = (double)AURORA_VM_MEMORY_SIZE * iterations / (elapsed / 1e9);
+        printf("  %-24s %8.1f MB/s  %4u packets/dump\n", names[mode], rates[mode] / 1048576.0,
+               packets / iterations);
+    }
+    if (rates[0] > 0) {
+        printf("  speedup vs legacy: m %.2fx, x %.2fx\n", rates[1] / rates[0], rates[2] / rates[0]);
+    }
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("========================================\n");
+    printf("GDB Remote Stub Tests\n");
+    printf("========================================\n");
+
+    AuroraVM* vm = aurora_vm_create();
+    if (!vm || aurora_vm_init(vm) != 0) {
+        printf("VM init failed\n");
+        return 1;
+    }
+
+    test_framing(vm);
+    test_binary_memory(vm);
+    test_memory_map(vm);
+    test_vcont(vm);
+    test_vm_handler(vm);
+
+    if (bench) {
+        bench_memory_dump(vm);
+    }
+
+    gdb_server_stop();
+    aurora_vm_destroy(vm);
+
+    printf("\n========================================\n");
+    printf("Passed: %d  Failed: %d\n", tests_passed, tests_failed);
+    printf("========================================\n");
+    return tests_failed == 0 ? 0 : 1;
+}
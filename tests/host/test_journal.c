@@ -0,0 +1,657 @@
+/**
+ * Aurora OS - Journal Tests
+ *
+ * Host-built harness for filesystem/journal/journal.c on a simulated
+ * journal device with a small home area: commits reaching home blocks
+ * only at checkpoints, replay after a crash, torn groups and superblock
+ * copies, a full log checkpointing to make room, failed log writes, and
+ * concurrent committers sharing groups. The crash-injection test records
+ * every device write of a workload that wraps the log several times,
+ * then rebuilds the device as a crash would leave it after each byte of
+ * log writes, replays it, and checks the home blocks hold exactly the
+ * transactions of some prefix that includes every commit that returned.
+ * With --bench, commits per second for 1-16 committing threads against
+ * a device with a 100 us flush, with and without group commit.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "../../filesystem/journal/journal.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/* ---- Kernel service stubs ---- */
+
+void* kmalloc(size_t size) {
+    return malloc(size);
+}
+
+void kfree(void* ptr) {
+    free(ptr);
+}
+
+uint32_t smp_get_current_cpu_id(void) {
+    return 0;
+}
+
+void cpu_relax(void) {
+    sched_yield();
+}
+
+uint32_t timer_get_ticks(void) {
+    return 0;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static void delay_ns(uint64_t ns) {
+    struct timespec ts = { 0, (long)ns };
+    nanosleep(&ts, NULL);
+}
+
+/* ---- Simulated journal device ---- */
+
+#define HOME_BLOCKS     16
+#define HOME_SIZE       64
+#define MAX_LOG_BLOCKS  1024
+
+typedef struct {
+    uint32_t blocks;
+    uint8_t* log;                   /* MAX_LOG_BLOCKS, of which blocks are used */
+    uint8_t home[HOME_BLOCKS][HOME_SIZE];
+    int fail_writes;                /* Fail this many log writes */
+    uint64_t flush_ns;              /* Simulated latency */
+    uint64_t flushes;
+    uint64_t applies;
+} sim_dev_t;
+
+static sim_dev_t sim;               /* The device under test */
+static sim_dev_t crash;             /* Rebuilt after a simulated crash */
+
+static void sim_alloc(sim_dev_t* dev) {
+    memset(dev, 0, sizeof(*dev));
+    dev->log = calloc(MAX_LOG_BLOCKS, JOURNAL_BLOCK_SIZE);
+}
+
+/* Copy contents, keeping dst's own log buffer */
+static void sim_copy(sim_dev_t* dst, const sim_dev_t* src) {
+    uint8_t* log = dst->log;
+    memcpy(log, src->log, (size_t)src->blocks * JOURNAL_BLOCK_SIZE);
+    *dst = *src;
+    dst->log = log;
+}
+
+/* Write log of sim, for crash injection */
+typedef enum { EV_WRITE, EV_APPLY, EV_COMMIT_START, EV_COMMIT_DONE } event_type_t;
+
+typedef struct {
+    event_type_t type;
+    uint32_t at;                    /* Byte offset in the log, or home block */
+    uint32_t size;
+    uint8_t* data;
+} event_t;
+
+#define EVENT_MAX 65536
+
+static event_t* events;
+static uint32_t event_count;
+static int logging;
+
+static void log_event(event_type_t type, uint32_t at, uint32_t size, const void* data) {
+    if (!logging || event_count >= EVENT_MAX) {
+        return;
+    }
+    event_t* ev = &events[event_count++];
+    ev->type = type;
+    ev->at = at;
+    ev->size = size;
+    ev->data = NULL;
+    if (size) {
+        ev->data = malloc(size);
+        memcpy(ev->data, data, size);
+    }
+}
+
+static void clear_events(void) {
+    for (uint32_t i = 0; i < event_count; i++) {
+        free(events[i].data);
+    }
+    event_count = 0;
+}
+
+static int sim_read(void* ctx, uint32_t block, void* data, uint32_t count) {
+    sim_dev_t* dev = (sim_dev_t*)ctx;
+    memcpy(data, dev->log + (size_t)block * JOURNAL_BLOCK_SIZE, (size_t)count * JOURNAL_BLOCK_SIZE);
+    return 0;
+}
+
+static int sim_write(void* ctx, uint32_t block, const void* data, uint32_t count) {
+    sim_dev_t* dev = (sim_dev_t*)ctx;
+    if (dev->fail_writes > 0) {
+        dev->fail_writes--;
+        return -1;
+    }
+    memcpy(dev->log + (size_t)block * JOURNAL_BLOCK_SIZE, data, (size_t)count * JOURNAL_BLOCK_SIZE);
+    if (dev == &sim) {
+        log_event(EV_WRITE, block * JOURNAL_BLOCK_SIZE, count * JOURNAL_BLOCK_SIZE, data);
+    }
+    return 0;
+}
+
+static int sim_flush(void* ctx) {
+    sim_dev_t* dev = (sim_dev_t*)ctx;
+    if (dev->flush_ns) {
+        delay_ns(dev->flush_ns);
+    }
+    __atomic_add_fetch(&dev->flushes, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+static int sim_apply(void* ctx, const journal_operation_t* op) {
+    sim_dev_t* dev = (sim_dev_t*)ctx;
+    if (op->block_num >= HOME_BLOCKS || op->data_size > HOME_SIZE) {
+        return -1;
+    }
+    if (op->new_data) {
+        memcpy(dev->home[op->block_num], op->new_data, op->data_size);
+    }
+    dev->applies++;
+    if (dev == &sim) {
+        log_event(EV_APPLY, op->block_num, (uint32_t)op->data_size, op->new_data);
+    }
+    return 0;
+}
+
+static journal_device_t device_for(sim_dev_t* dev) {
+    journal_device_t jd = {
+        dev->blocks, dev, sim_read, sim_write, sim_flush, sim_apply, NULL
+    };
+    return jd;
+}
+
+static void sim_format(uint32_t blocks) {
+    uint8_t* log = sim.log;
+    memset(&sim, 0, sizeof(sim));
+    memset(log, 0, (size_t)MAX_LOG_BLOCKS * JOURNAL_BLOCK_SIZE);
+    sim.log = log;
+    sim.blocks = blocks;
+    journal_device_t jd = device_for(&sim);
+    journal_format(&jd);
+}
+
+/* Crash now: load sim's current contents into crash and replay them */
+static int crash_and_replay(void) {
+    sim_copy(&crash, &sim);
+    crash.fail_writes = 0;
+    crash.flush_ns = 0;
+    journal_device_t jd = device_for(&crash);
+    if (journal_load(&jd) != 0) {
+        return -1;
+    }
+    return journal_replay();
+}
+
+static journal_stats_t stats_now(void) {
+    journal_stats_t st;
+    journal_get_stats(&st);
+    return st;
+}
+
+/* Commit one transaction writing (block, fill byte, size) triples */
+static int commit_writes(const uint32_t* blocks, const uint8_t* values, const uint32_t* sizes, uint32_t n) {
+    transaction_t* txn = journal_begin_transaction();
+    if (!txn) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        uint8_t data[HOME_SIZE];
+        memset(data, values[i], sizes[i]);
+        journal_operation_t op = journal_create_write_op(blocks[i], NULL, data, sizes[i]);
+        if (journal_add_operation(txn, &op) != 0) {
+            journal_abort_transaction(txn);
+            return -1;
+        }
+    }
+    return journal_commit_transaction(txn);
+}
+
+static int commit_one(uint32_t block, uint8_t value) {
+    uint32_t size = HOME_SIZE;
+    return commit_writes(&block, &value, &size, 1);
+}
+
+static int home_is(sim_dev_t* dev, uint32_t block, uint8_t value) {
+    for (uint32_t i = 0; i < HOME_SIZE; i++) {
+        if (dev->home[block][i] != value) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* ---- Commit and checkpoint ---- */
+
+static void test_commit(void) {
+    printf("\nCommit and checkpoint:\n");
+
+    journal_init();
+    sim_format(64);
+    journal_stats_t st = stats_now();
+    TEST_ASSERT(st.log_blocks == 64 - JOURNAL_SB_BLOCKS, "Log follows the superblock copies");
+
+    uint32_t blocks[2] = { 3, 5 };
+    uint8_t values[2] = { 0xAA, 0xBB };
+    uint32_t sizes[2] = { HOME_SIZE, HOME_SIZE };
+    uint64_t flushes = sim.flushes;
+    TEST_ASSERT(commit_writes(blocks, values, sizes, 2) == 0, "Two-operation transaction commits");
+    st = stats_now();
+    TEST_ASSERT(st.commits == 1 && st.groups == 1 && sim.flushes == flushes + 1,
+                "One group, one flush");
+    TEST_ASSERT(st.used_blocks == 2, "Header block plus commit block in use");
+    TEST_ASSERT(home_is(&sim, 3, 0) && home_is(&sim, 5, 0), "Home blocks untouched until checkpoint");
+
+    TEST_ASSERT(journal_checkpoint() == 0, "Checkpoint succeeds");
+    TEST_ASSERT(home_is(&sim, 3, 0xAA) && home_is(&sim, 5, 0xBB), "Checkpoint writes home blocks");
+    st = stats_now();
+    TEST_ASSERT(st.used_blocks == 0 && st.checkpointed_groups == 1, "Checkpoint frees the log");
+    TEST_ASSERT(journal_checkpoint() == 0 && stats_now().checkpoints == 1,
+                "Nothing left to checkpoint");
+    TEST_ASSERT(crash_and_replay() == 0, "Checkpointed groups are not replayed");
+
+    uint64_t groups = stats_now().groups;
+    transaction_t* txn = journal_begin_transaction();
+    journal_operation_t op = journal_create_create_op(7);
+    journal_add_operation(txn, &op);
+    TEST_ASSERT(journal_abort_transaction(txn) == 0, "Abort a pending transaction");
+    TEST_ASSERT(journal_commit_transaction(txn) == -1, "Aborted transaction cannot commit");
+    TEST_ASSERT(stats_now().groups == groups, "Abort writes nothing");
+
+    /* The memory log other filesystems use still works */
+    journal_init();
+    txn = journal_begin_transaction();
+    op = journal_create_write_op(0, NULL, NULL, 0);
+    journal_add_operation(txn, &op);
+    TEST_ASSERT(journal_commit_transaction(txn) == 0, "Commit to the built-in memory log");
+    TEST_ASSERT(journal_recover() == 1, "Memory log replays its group");
+}
+
+/* ---- Replay ---- */
+
+static void test_replay(void) {
+    printf("\nReplay:\n");
+
+    sim_format(64);
+    commit_one(1, 0x11);
+    commit_one(2, 0x22);
+    commit_one(1, 0x33);
+
+    TEST_ASSERT(crash_and_replay() == 3, "Three committed transactions replayed");
+    TEST_ASSERT(home_is(&crash, 1, 0x33) && home_is(&crash, 2, 0x22),
+                "Replay applies them in order");
+    TEST_ASSERT(stats_now().replayed == 3, "Replay counted");
+    TEST_ASSERT(journal_replay() == 0, "Replaying again finds nothing");
+    TEST_ASSERT(commit_one(4, 0x44) == 0, "Commit after recovery");
+    sim_copy(&sim, &crash);
+    TEST_ASSERT(crash_and_replay() == 1 && home_is(&crash, 4, 0x44),
+                "Group written after recovery replays");
+
+    /* Torn groups end the log */
+    sim_format(64);
+    commit_one(1, 0x11);
+    commit_one(2, 0x22);
+    commit_one(3, 0x33);
+    uint32_t second = (JOURNAL_SB_BLOCKS + 2) * JOURNAL_BLOCK_SIZE;
+    sim.log[second + 100] ^= 1;
+    TEST_ASSERT(crash_and_replay() == 1, "Corrupt data stops replay at that group");
+    TEST_ASSERT(home_is(&crash, 1, 0x11) && home_is(&crash, 2, 0) && home_is(&crash, 3, 0),
+                "Nothing after it is applied");
+    sim.log[second + 100] ^= 1;
+    sim.log[second + 2 * JOURNAL_BLOCK_SIZE - 1] ^= 1;
+    TEST_ASSERT(crash_and_replay() == 3, "Padding after the checksum is not covered");
+    sim.log[second + 2 * JOURNAL_BLOCK_SIZE - 1] ^= 1;
+    sim.log[second + JOURNAL_BLOCK_SIZE + 12] ^= 1;
+    TEST_ASSERT(crash_and_replay() == 1, "Corrupt checksum stops replay");
+    sim.log[second + JOURNAL_BLOCK_SIZE + 12] ^= 1;
+    sim.log[second + 4] ^= 1;
+    TEST_ASSERT(crash_and_replay() == 1, "Wrong sequence number stops replay");
+    sim.log[second + 4] ^= 1;
+
+    /* Superblock copies; back on sim, replaying its three groups */
+    journal_device_t jd = device_for(&sim);
+    journal_load(&jd);
+    journal_replay();
+    commit_one(5, 0x55);
+    journal_stats_t st = stats_now();
+    TEST_ASSERT(st.used_blocks == 2, "One group after the checkpoint");
+    uint8_t saved[2 * JOURNAL_BLOCK_SIZE];
+    memcpy(saved, sim.log, sizeof(saved));
+    uint32_t gen0, gen1;
+    memcpy(&gen0, sim.log + offsetof(journal_superblock_t, generation), 4);
+    memcpy(&gen1, sim.log + JOURNAL_BLOCK_SIZE + offsetof(journal_superblock_t, generation), 4);
+    uint32_t newer = gen1 > gen0 ? 1 : 0;
+    sim.log[newer * JOURNAL_BLOCK_SIZE + 20] ^= 1;
+    TEST_ASSERT(crash_and_replay() == 4, "Torn superblock falls back to the older copy");
+    TEST_ASSERT(home_is(&crash, 3, 0x33) && home_is(&crash, 5, 0x55),
+                "Older tail replays already checkpointed groups too");
+    sim.log[(1 - newer) * JOURNAL_BLOCK_SIZE + 20] ^= 1;
+    TEST_ASSERT(crash_and_replay() == -1, "No valid superblock, no journal");
+    memcpy(sim.log, saved, sizeof(saved));
+}
+
+/* ---- Full log and errors ---- */
+
+static void test_full(void) {
+    printf("\nFull log and errors:\n");
+
+    sim_format(JOURNAL_MIN_BLOCKS);
+    int ok = 1;
+    for (uint32_t i = 0; i < 50; i++) {
+        ok &= commit_one(i % HOME_BLOCKS, (uint8_t)(i + 1)) == 0;
+    }
+    journal_stats_t st = stats_now();
+    TEST_ASSERT(ok, "50 commits into an 8-block log");
+    TEST_ASSERT(st.full_waits > 0 && st.checkpoints > 0, "Full log checkpoints to make room");
+    TEST_ASSERT(st.used_blocks <= st.log_blocks, "Never more in use than the log holds");
+    TEST_ASSERT(crash_and_replay() >= 0 && home_is(&crash, 49 % HOME_BLOCKS, 50) &&
+                home_is(&crash, 34 % HOME_BLOCKS, 35), "Wrapped log replays to the last commit");
+
+    /* Bigger than the whole log */
+    transaction_t* txn = journal_begin_transaction();
+    uint8_t data[HOME_SIZE] = { 0 };
+    for (int i = 0; i < 64; i++) {
+        journal_operation_t op = journal_create_write_op(0, NULL, data, HOME_SIZE);
+        journal_add_operation(txn, &op);
+    }
+    TEST_ASSERT(journal_commit_transaction(txn) == -1, "Transaction larger than the log fails");
+    TEST_ASSERT(stats_now().failed_groups == 1, "Counted as a failed group");
+
+    sim_format(64);
+    commit_one(1, 0x11);
+    sim.fail_writes = 1;
+    TEST_ASSERT(commit_one(2, 0x22) == -1, "Failed log write fails the commit");
+    TEST_ASSERT(stats_now().used_blocks == 2, "Its space is handed back");
+    TEST_ASSERT(commit_one(3, 0x33) == 0, "Next commit succeeds");
+    TEST_ASSERT(crash_and_replay() == 2 && home_is(&crash, 3, 0x33) && home_is(&crash, 2, 0),
+                "Replay continues past the failed write");
+
+    ok = 1;
+    for (int i = 0; i < JOURNAL_MAX_TRANSACTIONS + 8; i++) {
+        txn = journal_begin_transaction();
+        ok &= txn && journal_commit_transaction(txn) == 0;
+    }
+    TEST_ASSERT(ok, "Transaction slots are reused after commit");
+}
+
+/* ---- Crash injection ---- */
+
+#define CRASH_COMMITS   80
+#define CRASH_LOG       24
+
+static uint8_t snapshots[CRASH_COMMITS + 1][HOME_BLOCKS][HOME_SIZE];
+
+static int check_crash_point(uint32_t done, uint32_t started) {
+    journal_device_t jd = device_for(&crash);
+    if (journal_load(&jd) != 0 || journal_replay() < 0) {
+        return 0;
+    }
+    for (uint32_t p = done; p <= started; p++) {
+        if (memcmp(crash.home, snapshots[p], sizeof(crash.home)) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void test_crash(void) {
+    printf("\nCrash injection:\n");
+
+    sim_format(CRASH_LOG);
+    sim_dev_t base, image;
+    sim_alloc(&base);
+    sim_alloc(&image);
+    sim_copy(&base, &sim);
+
+    /* Random multi-block transactions; the model is what each commit leaves */
+    uint8_t model[HOME_BLOCKS][HOME_SIZE];
+    memset(model, 0, sizeof(model));
+    memcpy(snapshots[0], model, sizeof(model));
+    logging = 1;
+    int ok = 1;
+    for (uint32_t c = 1; c <= CRASH_COMMITS; c++) {
+        uint32_t n = 1 + (uint32_t)(rng() % 12);
+        uint32_t blocks[12], sizes[12];
+        uint8_t values[12];
+        for (uint32_t i = 0; i < n; i++) {
+            blocks[i] = (uint32_t)(rng() % HOME_BLOCKS);
+            sizes[i] = 1 + (uint32_t)(rng() % HOME_SIZE);
+            values[i] = (uint8_t)rng();
+        }
+        log_event(EV_COMMIT_START, 0, 0, NULL);
+        ok &= commit_writes(blocks, values, sizes, n) == 0;
+        log_event(EV_COMMIT_DONE, 0, 0, NULL);
+        for (uint32_t i = 0; i < n; i++) {
+            memset(model[blocks[i]], values[i], sizes[i]);
+        }
+        memcpy(snapshots[c], model, sizeof(model));
+    }
+    logging = 0;
+    journal_stats_t st = stats_now();
+    TEST_ASSERT(ok, "Workload commits");
+    TEST_ASSERT(st.blocks_written > 3 * st.log_blocks && st.checkpoints > 3,
+                "Workload wraps the log several times");
+
+    /* Crash after every byte of every log write; then, as a disk that
+     * reorders writes would, with each block of a write lost alone */
+    sim_copy(&image, &base);
+    uint32_t done = 0, started = 0, points = 0, bad = 0, write_bytes = 0;
+    uint32_t lost_points = 0, lost_bad = 0;
+    for (uint32_t e = 0; e <= event_count; e++) {
+        event_t* ev = e < event_count ? &events[e] : NULL;
+        uint32_t cuts = !ev ? 1 : ev->type == EV_WRITE ? ev->size : 0;
+        for (uint32_t k = 0; k < cuts; k++) {
+            sim_copy(&crash, &image);
+            if (ev) {
+                memcpy(crash.log + ev->at, ev->data, k);
+            }
+            if (!check_crash_point(done, started)) {
+                bad++;
+            }
+            points++;
+        }
+        if (!ev) {
+            break;
+        }
+        for (uint32_t lost = 0; ev->type == EV_WRITE && ev->size > JOURNAL_BLOCK_SIZE &&
+                                lost < ev->size; lost += JOURNAL_BLOCK_SIZE) {
+            sim_copy(&crash, &image);
+            memcpy(crash.log + ev->at, ev->data, lost);
+            memcpy(crash.log + ev->at + lost + JOURNAL_BLOCK_SIZE, ev->data + lost + JOURNAL_BLOCK_SIZE,
+                   ev->size - lost - JOURNAL_BLOCK_SIZE);
+            if (!check_crash_point(done, started)) {
+                lost_bad++;
+            }
+            lost_points++;
+        }
+        switch (ev->type) {
+            case EV_WRITE:
+                memcpy(image.log + ev->at, ev->data, ev->size);
+                write_bytes += ev->size;
+                break;
+            case EV_APPLY:
+                memcpy(image.home[ev->at], ev->data, ev->size);
+                break;
+            case EV_COMMIT_START:
+                started++;
+                break;
+            case EV_COMMIT_DONE:
+                done++;
+                break;
+        }
+    }
+    printf("  %u crash points over %u bytes of log writes\n", points, write_bytes);
+    TEST_ASSERT(points == write_bytes + 1, "Every byte offset tried");
+    TEST_ASSERT(bad == 0, "Replay always yields a prefix holding every returned commit");
+    TEST_ASSERT(memcmp(image.home, snapshots[0], sizeof(image.home)) != 0 &&
+                memcmp(crash.home, snapshots[CRASH_COMMITS], sizeof(crash.home)) == 0,
+                "Final crash point recovers every commit");
+    printf("  %u crash points with one block of a write lost\n", lost_points);
+    TEST_ASSERT(lost_points > 0 && lost_bad == 0, "Checksums catch blocks lost out of order");
+
+    clear_events();
+    free(image.log);
+    free(base.log);
+}
+
+/* ---- Concurrent committers ---- */
+
+#define THREADS_MAX 16
+
+typedef struct {
+    uint32_t id;
+    uint32_t commits;
+    int failures;
+    pthread_mutex_t* serialize;     /* Set to commit one at a time */
+} committer_t;
+
+static void* committer_main(void* arg) {
+    committer_t* c = (committer_t*)arg;
+    for (uint32_t i = 1; i <= c->commits; i++) {
+        if (c->serialize) {
+            pthread_mutex_lock(c->serialize);
+        }
+        if (commit_one(c->id % HOME_BLOCKS, (uint8_t)i) != 0) {
+            c->failures++;
+        }
+        if (c->serialize) {
+            pthread_mutex_unlock(c->serialize);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Run committers to completion
+ * @return Elapsed ns
+ */
+static uint64_t run_committers(uint32_t threads, uint32_t each, pthread_mutex_t* serialize, int* failures) {
+    pthread_t tid[THREADS_MAX];
+    committer_t c[THREADS_MAX];
+
+    uint64_t start = now_ns();
+    for (uint32_t t = 0; t < threads; t++) {
+        c[t].id = t;
+        c[t].commits = each;
+        c[t].failures = 0;
+        c[t].serialize = serialize;
+        pthread_create(&tid[t], NULL, committer_main, &c[t]);
+    }
+    *failures = 0;
+    for (uint32_t t = 0; t < threads; t++) {
+        pthread_join(tid[t], NULL);
+        *failures += c[t].failures;
+    }
+    return now_ns() - start;
+}
+
+static void test_concurrent(void) {
+    printf("\nConcurrent committers:\n");
+
+    sim_format(256);
+    sim.flush_ns = 50000;
+    int failures;
+    run_committers(8, 100, NULL, &failures);
+    journal_stats_t st = stats_now();
+    TEST_ASSERT(failures == 0 && st.commits == 800, "800 commits from 8 threads");
+    TEST_ASSERT(st.groups < st.commits, "Commits share groups");
+    TEST_ASSERT(sim.flushes == 2 + st.checkpoints + st.groups,
+                "One flush per group, besides superblock writes");
+
+    sim.flush_ns = 0;
+    int ok = crash_and_replay() >= 0;
+    for (uint32_t t = 0; t < 8; t++) {
+        ok &= home_is(&crash, t, 100);
+    }
+    TEST_ASSERT(ok, "Replay leaves every thread's last write");
+}
+
+/* ---- Benchmark ---- */
+
+static void bench_commits(const char* label, uint32_t threads, int grouped) {
+    pthread_mutex_t serialize = PTHREAD_MUTEX_INITIALIZER;
+    uint32_t each = 4000 / threads;
+    int failures;
+
+    sim_format(MAX_LOG_BLOCKS);
+    sim.flush_ns = 100000;
+    uint64_t elapsed = run_committers(threads, each, grouped ? NULL : &serialize, &failures);
+    journal_stats_t st = stats_now();
+
+    printf("  %-22s %2u threads %9.0f commits/s  %5.1f txns/group%s\n", label, threads,
+           (double)st.commits * 1e9 / (double)elapsed, (double)st.commits / (double)st.groups,
+           failures ? "  (failures)" : "");
+}
+
+static void run_bench(void) {
+    printf("\nBenchmark (100 us flush, 64-byte transactions):\n");
+
+    bench_commits("one at a time", 1, 0);
+    bench_commits("one at a time", 8, 0);
+    for (uint32_t threads = 1; threads <= THREADS_MAX; threads *= 2) {
+        bench_commits("group commit", threads, 1);
+    }
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("Aurora OS Journal Tests\n");
+
+    events = calloc(EVENT_MAX, sizeof(event_t));
+    sim_alloc(&sim);
+    sim_alloc(&crash);
+
+    test_commit();
+    test_replay();
+    test_full();
+    test_crash();
+    test_concurrent();
+
+    if (bench) {
+        run_bench();
+    }
+
+    free(events);
+    free(sim.log);
+    free(crash.log);
+    printf("\nPassed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
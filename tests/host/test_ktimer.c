@@ -0,0 +1,585 @@
+/**
+ * Aurora OS - Kernel Timer Tests
+ *
+ * Host-built harness for the hierarchical timing wheel in
+ * kernel/core/ktimer.c: random timers never fire early or late and fire
+ * in deadline order, cancel and re-arm, cascading through every level,
+ * far-future parking, next-event reporting for tickless CPUs, callbacks
+ * that re-arm or cancel timers, per-CPU wheels and the reprogram hook.
+ * With --bench, measures insert, cancel and expiry with 100k pending
+ * timers against a binary heap, and counts the wakeups an idle CPU
+ * takes with one-shot events against a periodic tick.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include "../../kernel/core/ktimer.h"
+#include "../../kernel/smp/smp.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/* ---- Kernel service stubs ---- */
+
+static uint32_t t_cpu_id;
+
+uint32_t smp_get_current_cpu_id(void) {
+    return t_cpu_id;
+}
+
+void cpu_relax(void) {
+    sched_yield();
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* ---- Firing log ---- */
+
+typedef struct {
+    ktimer_t timer;
+    uint64_t fired_at;              /* Time passed to the ktimer_run() that fired it */
+    uint32_t fires;
+} probe_t;
+
+static uint64_t g_run_now;
+static uint64_t g_last_expires;
+static int g_order_ok;
+
+static void probe_fire(void* data) {
+    probe_t* p = data;
+
+    if (p->timer.expires < g_last_expires) {
+        g_order_ok = 0;
+    }
+    g_last_expires = p->timer.expires;
+    p->fired_at = g_run_now;
+    p->fires++;
+}
+
+static void probe_setup(probe_t* p) {
+    ktimer_setup(&p->timer, probe_fire, p);
+    p->fired_at = 0;
+    p->fires = 0;
+}
+
+static uint32_t run_to(uint32_t cpu, uint64_t now) {
+    g_run_now = now;
+    g_last_expires = 0;
+    return ktimer_run(cpu, now);
+}
+
+static void test_ordering(void) {
+    printf("\nOrdering:\n");
+
+    const uint32_t count = 20000;
+    probe_t* probes = calloc(count, sizeof(*probes));
+    ktimer_init();
+    g_order_ok = 1;
+
+    /* Deadlines spread over every wheel level, up to ~12 days */
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t bits = 1 + (uint32_t)(rng() % 40);
+        probe_setup(&probes[i]);
+        ktimer_add(&probes[i].timer, rng() & ((1ULL << bits) - 1));
+    }
+
+    uint64_t now = 0;
+    uint64_t prev = 0;
+    uint32_t fired = 0;
+    int early = 0, late = 0;
+    while (fired < count) {
+        uint32_t bits = 1 + (uint32_t)(rng() % 36);
+        prev = now;
+        now += 1 + (rng() & ((1ULL << bits) - 1));
+        fired += run_to(0, now);
+
+        for (uint32_t i = 0; i < count; i++) {
+            probe_t* p = &probes[i];
+            if (p->fires && p->fired_at == now) {
+                if (p->timer.expires > now) {
+                    early++;
+                }
+                if (p->timer.expires <= prev && prev != 0) {
+                    late++;
+                }
+            }
+        }
+    }
+
+    uint32_t once = 1;
+    for (uint32_t i = 0; i < count; i++) {
+        if (probes[i].fires != 1 || ktimer_pending(&probes[i].timer)) {
+            once = 0;
+        }
+    }
+
+    ktimer_stats_t stats;
+    ktimer_get_stats(0, &stats);
+
+    TEST_ASSERT(once, "Every timer fires exactly once");
+    TEST_ASSERT(early == 0, "No timer fires before its deadline");
+    TEST_ASSERT(late == 0, "Every timer fires in the first run past its deadline");
+    TEST_ASSERT(g_order_ok, "Timers in one run fire in deadline order");
+    TEST_ASSERT(stats.pending == 0 && stats.expired == count, "Statistics count every expiry");
+    TEST_ASSERT(stats.max_pending == count, "Peak pending count recorded");
+    TEST_ASSERT(stats.cascaded > 0, "Far timers cascade down the wheel");
+
+    free(probes);
+}
+
+static void test_cancel(void) {
+    printf("\nCancel and re-arm:\n");
+
+    const uint32_t count = 1000;
+    probe_t* probes = calloc(count, sizeof(*probes));
+    ktimer_init();
+
+    for (uint32_t i = 0; i < count; i++) {
+        probe_setup(&probes[i]);
+        ktimer_add(&probes[i].timer, 1000 + (rng() % 5000000));
+    }
+
+    int cancelled = 1;
+    for (uint32_t i = 0; i < count; i += 2) {
+        if (ktimer_cancel(&probes[i].timer) != 1) {
+            cancelled = 0;
+        }
+    }
+    TEST_ASSERT(cancelled, "Cancel of a pending timer returns 1");
+    TEST_ASSERT(!ktimer_pending(&probes[0].timer) && ktimer_pending(&probes[1].timer),
+                "Pending reflects cancellation");
+    TEST_ASSERT(ktimer_cancel(&probes[0].timer) == 0, "Second cancel returns 0");
+
+    /* Move one odd timer far out and one to the very start */
+    ktimer_add(&probes[1].timer, 100000000);
+    ktimer_add(&probes[3].timer, 10);
+
+    run_to(0, 20);
+    TEST_ASSERT(probes[3].fires == 1, "Re-armed earlier timer fires at its new deadline");
+
+    run_to(0, 6000000);
+    int even_silent = 1, odd_fired = 1;
+    for (uint32_t i = 0; i < count; i++) {
+        if (i % 2 == 0 && probes[i].fires) {
+            even_silent = 0;
+        }
+        if (i % 2 == 1 && i != 1 && probes[i].fires != 1) {
+            odd_fired = 0;
+        }
+    }
+    TEST_ASSERT(even_silent, "Cancelled timers never fire");
+    TEST_ASSERT(odd_fired, "Remaining timers fire once");
+    TEST_ASSERT(probes[1].fires == 0 && ktimer_pending(&probes[1].timer),
+                "Re-armed later timer stays pending");
+
+    run_to(0, 100000000);
+    TEST_ASSERT(probes[1].fires == 1, "Re-armed later timer fires at its new deadline");
+
+    probe_t past;
+    probe_setup(&past);
+    ktimer_add(&past.timer, 5);
+    TEST_ASSERT(run_to(0, 100000001) == 1 && past.fires == 1,
+                "Deadline already passed fires at the next run");
+
+    free(probes);
+}
+
+static void test_levels(void) {
+    printf("\nCascading:\n");
+
+    ktimer_init();
+
+    /* One timer per level, each just past a level boundary */
+    probe_t probes[KTIMER_LEVELS];
+    for (uint32_t level = 0; level < KTIMER_LEVELS; level++) {
+        probe_setup(&probes[level]);
+        ktimer_add(&probes[level].timer, (1ULL << (6 * level)) + 37);
+    }
+
+    int ok = 1;
+    for (uint32_t level = 0; level < KTIMER_LEVELS; level++) {
+        uint64_t expires = probes[level].timer.expires;
+        run_to(0, expires - 1);
+        if (probes[level].fires) {
+            ok = 0;
+        }
+        run_to(0, expires);
+        if (probes[level].fires != 1) {
+            ok = 0;
+        }
+    }
+    TEST_ASSERT(ok, "Timer on each of the 8 levels fires at its exact deadline");
+
+    ktimer_stats_t stats;
+    ktimer_get_stats(0, &stats);
+    TEST_ASSERT(stats.cascaded >= KTIMER_LEVELS - 1, "Higher-level timers cascaded");
+
+    /* Beyond the wheel's reach */
+    probe_t far;
+    probe_setup(&far);
+    uint64_t base = stats.clock;
+    uint64_t expires = base + (1ULL << 52) + 12345;
+    ktimer_add(&far.timer, expires);
+
+    run_to(0, base + (1ULL << 48));
+    TEST_ASSERT(far.fires == 0 && ktimer_pending(&far.timer),
+                "Deadline past the wheel span stays parked");
+    run_to(0, expires - 1);
+    TEST_ASSERT(far.fires == 0, "Parked timer not early");
+    run_to(0, expires);
+    TEST_ASSERT(far.fires == 1, "Parked timer fires at its deadline");
+}
+
+static void test_next_event(void) {
+    printf("\nNext event:\n");
+
+    ktimer_init();
+    TEST_ASSERT(ktimer_next_event(0) == KTIMER_NONE, "Empty wheel has no next event");
+
+    probe_t probes[64];
+    for (uint32_t i = 0; i < 64; i++) {
+        probe_setup(&probes[i]);
+    }
+
+    ktimer_add(&probes[0].timer, 40);
+    TEST_ASSERT(ktimer_next_event(0) == 40, "Level 0 event is exact");
+
+    ktimer_cancel(&probes[0].timer);
+    ktimer_add(&probes[0].timer, 1000000);
+    uint64_t next = ktimer_next_event(0);
+    TEST_ASSERT(next <= 1000000 && next > 0, "Far event reported no later than its deadline");
+
+    /* A tickless CPU sleeping until each reported event */
+    uint32_t wakeups = 0;
+    while ((next = ktimer_next_event(0)) != KTIMER_NONE) {
+        run_to(0, next);
+        wakeups++;
+    }
+    TEST_ASSERT(probes[0].fires == 1 && probes[0].fired_at == 1000000,
+                "Sleeping until each next event fires the timer on time");
+    TEST_ASSERT(wakeups <= KTIMER_LEVELS, "One wakeup per level at most");
+
+    /* Random timers driven purely by next events */
+    ktimer_init();
+    for (uint32_t i = 0; i < 64; i++) {
+        probe_setup(&probes[i]);
+        ktimer_add(&probes[i].timer, rng() % 100000000);
+    }
+    int exact = 1;
+    while ((next = ktimer_next_event(0)) != KTIMER_NONE) {
+        run_to(0, next);
+    }
+    for (uint32_t i = 0; i < 64; i++) {
+        if (probes[i].fires != 1 || probes[i].fired_at != probes[i].timer.expires) {
+            exact = 0;
+        }
+    }
+    TEST_ASSERT(exact, "Event-driven wheel fires every timer at its exact deadline");
+}
+
+/* ---- Callbacks that use the API ---- */
+
+static ktimer_t periodic;
+static uint32_t periodic_fires;
+
+static void periodic_fire(void* data) {
+    (void)data;
+    periodic_fires++;
+    ktimer_add(&periodic, periodic.expires + 1000);
+}
+
+static probe_t victim;
+static int victim_cancel_result;
+
+static void killer_fire(void* data) {
+    (void)data;
+    victim_cancel_result = ktimer_cancel(&victim.timer);
+}
+
+static uint32_t hook_calls;
+static uint32_t hook_cpu;
+
+static void count_hook(uint32_t cpu) {
+    hook_calls++;
+    hook_cpu = cpu;
+}
+
+static void test_callbacks(void) {
+    printf("\nCallbacks:\n");
+
+    ktimer_init();
+    ktimer_setup(&periodic, periodic_fire, NULL);
+    periodic_fires = 0;
+    ktimer_add(&periodic, 1000);
+    for (uint64_t now = 500; now <= 10000; now += 500) {
+        run_to(0, now);
+    }
+    TEST_ASSERT(periodic_fires == 10, "Self re-arming timer fires once per period");
+    TEST_ASSERT(ktimer_pending(&periodic) && periodic.expires == 11000,
+                "Self re-arming timer stays pending");
+    ktimer_cancel(&periodic);
+
+    ktimer_t killer;
+    ktimer_setup(&killer, killer_fire, NULL);
+    probe_setup(&victim);
+    ktimer_add(&killer, 20000);
+    ktimer_add(&victim.timer, 20000);
+    victim_cancel_result = -1;
+    uint32_t ran = run_to(0, 20000);
+    /* The two share a slot; whichever runs first decides the outcome */
+    TEST_ASSERT((victim_cancel_result == 1 && victim.fires == 0 && ran == 1) ||
+                (victim_cancel_result == 0 && victim.fires == 1 && ran == 2),
+                "Callback can cancel a timer already due in the same run");
+
+    printf("\nPer-CPU wheels:\n");
+
+    probe_t remote;
+    probe_setup(&remote);
+    ktimer_add_on(&remote.timer, 1, 30000);
+    run_to(0, 40000);
+    TEST_ASSERT(remote.fires == 0, "Timer on CPU 1 does not fire from CPU 0's wheel");
+    run_to(1, 40000);
+    TEST_ASSERT(remote.fires == 1, "Timer fires from its own CPU's wheel");
+
+    t_cpu_id = 2;
+    probe_setup(&remote);
+    ktimer_add(&remote.timer, 50000);
+    TEST_ASSERT(remote.timer.cpu == 2, "ktimer_add() uses the current CPU");
+    ktimer_add_on(&remote.timer, 3, 50000);
+    run_to(2, 60000);
+    TEST_ASSERT(remote.fires == 0, "Re-arming on another CPU leaves the old wheel");
+    run_to(3, 60000);
+    TEST_ASSERT(remote.fires == 1, "Re-armed timer fires on its new CPU");
+    t_cpu_id = 0;
+
+    printf("\nReprogram hook:\n");
+
+    ktimer_init();
+    ktimer_set_program_hook(count_hook);
+    hook_calls = 0;
+
+    probe_t a, b, c;
+    probe_setup(&a);
+    probe_setup(&b);
+    probe_setup(&c);
+    ktimer_add(&a.timer, 100000);
+    TEST_ASSERT(hook_calls == 1, "First timer on an idle wheel calls the hook");
+    ktimer_next_event(0);
+    ktimer_add(&b.timer, 500000);
+    TEST_ASSERT(hook_calls == 1, "Later timer does not reprogram");
+    ktimer_add_on(&c.timer, 5, 50000);
+    TEST_ASSERT(hook_calls == 2 && hook_cpu == 5, "Earlier timer reprograms its CPU");
+    ktimer_set_program_hook(NULL);
+}
+
+/* ---- Benchmarks ---- */
+
+/* Binary min-heap of deadlines with back-indices, the obvious alternative */
+typedef struct {
+    uint64_t expires;
+    uint32_t index;
+} heap_timer_t;
+
+typedef struct {
+    heap_timer_t** items;
+    uint32_t size;
+} heap_t;
+
+static void heap_swap(heap_t* h, uint32_t a, uint32_t b) {
+    heap_timer_t* t = h->items[a];
+    h->items[a] = h->items[b];
+    h->items[b] = t;
+    h->items[a]->index = a;
+    h->items[b]->index = b;
+}
+
+static void heap_up(heap_t* h, uint32_t i) {
+    while (i > 0 && h->items[(i - 1) / 2]->expires > h->items[i]->expires) {
+        heap_swap(h, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void heap_down(heap_t* h, uint32_t i) {
+    for (;;) {
+        uint32_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < h->size && h->items[l]->expires < h->items[m]->expires) m = l;
+        if (r < h->size && h->items[r]->expires < h->items[m]->expires) m = r;
+        if (m == i) return;
+        heap_swap(h, i, m);
+        i = m;
+    }
+}
+
+static void heap_insert(heap_t* h, heap_timer_t* t) {
+    t->index = h->size;
+    h->items[h->size++] = t;
+    heap_up(h, t->index);
+}
+
+static void heap_remove(heap_t* h, heap_timer_t* t) {
+    uint32_t i = t->index;
+    h->size--;
+    if (i != h->size) {
+        h->items[i] = h->items[h->size];
+        h->items[i]->index = i;
+        heap_up(h, i);
+        heap_down(h, h->items[i]->index);
+    }
+}
+
+static void noop_fire(void* data) {
+    (void)data;
+}
+
+static void bench_wheel(void) {
+    const uint32_t count = 100000;
+    const uint32_t rounds = 5;
+    ktimer_t* timers = calloc(count, sizeof(*timers));
+    heap_timer_t* htimers = calloc(count, sizeof(*htimers));
+    uint64_t* deadlines = malloc(count * sizeof(*deadlines));
+    heap_t heap = { calloc(count, sizeof(heap_timer_t*)), 0 };
+
+    printf("\n%u pending timers, deadlines up to 10 s (ns/op):\n", count);
+    printf("  %-12s %10s %10s %10s\n", "", "insert", "cancel", "expire");
+
+    for (uint32_t i = 0; i < count; i++) {
+        ktimer_setup(&timers[i], noop_fire, NULL);
+        deadlines[i] = 1 + rng() % 10000000;
+    }
+
+    uint64_t ins = 0, can = 0, exp = 0;
+    for (uint32_t r = 0; r < rounds; r++) {
+        ktimer_init();
+        uint64_t t0 = now_ns();
+        for (uint32_t i = 0; i < count; i++) {
+            ktimer_add(&timers[i], deadlines[i]);
+        }
+        uint64_t t1 = now_ns();
+        for (uint32_t i = 0; i < count; i++) {
+            ktimer_cancel(&timers[i]);
+        }
+        uint64_t t2 = now_ns();
+        for (uint32_t i = 0; i < count; i++) {
+            ktimer_add(&timers[i], deadlines[i]);
+        }
+        /* Expire in 1 ms ticks, as a busy CPU would */
+        uint64_t t3 = now_ns();
+        for (uint64_t now = 1000; now <= 10000000; now += 1000) {
+            ktimer_run(0, now);
+        }
+        uint64_t t4 = now_ns();
+        ins += t1 - t0;
+        can += t2 - t1;
+        exp += t4 - t3;
+    }
+    printf("  %-12s %10.1f %10.1f %10.1f\n", "wheel",
+           (double)ins / (rounds * count), (double)can / (rounds * count),
+           (double)exp / (rounds * count));
+
+    ins = can = exp = 0;
+    for (uint32_t r = 0; r < rounds; r++) {
+        uint64_t t0 = now_ns();
+        for (uint32_t i = 0; i < count; i++) {
+            htimers[i].expires = deadlines[i];
+            heap_insert(&heap, &htimers[i]);
+        }
+        uint64_t t1 = now_ns();
+        for (uint32_t i = 0; i < count; i++) {
+            heap_remove(&heap, &htimers[i]);
+        }
+        uint64_t t2 = now_ns();
+        for (uint32_t i = 0; i < count; i++) {
+            heap_insert(&heap, &htimers[i]);
+        }
+        uint64_t t3 = now_ns();
+        for (uint64_t now = 1000; now <= 10000000; now += 1000) {
+            while (heap.size && heap.items[0]->expires <= now) {
+                heap_remove(&heap, heap.items[0]);
+            }
+        }
+        uint64_t t4 = now_ns();
+        ins += t1 - t0;
+        can += t2 - t1;
+        exp += t4 - t3;
+    }
+    printf("  %-12s %10.1f %10.1f %10.1f\n", "binary heap",
+           (double)ins / (rounds * count), (double)can / (rounds * count),
+           (double)exp / (rounds * count));
+
+    free(heap.items);
+    free(deadlines);
+    free(htimers);
+    free(timers);
+}
+
+static void bench_tickless(void) {
+    printf("\nIdle CPU wakeups over 60 s with 5 sleeping processes:\n");
+
+    ktimer_t timers[5];
+    ktimer_init();
+    for (uint32_t i = 0; i < 5; i++) {
+        ktimer_setup(&timers[i], noop_fire, NULL);
+        ktimer_add(&timers[i], (uint64_t)(i + 1) * 11000000 + rng() % 1000000);
+    }
+
+    uint32_t wakeups = 0;
+    uint64_t next;
+    while ((next = ktimer_next_event(0)) != KTIMER_NONE && next <= 60000000) {
+        ktimer_run(0, next);
+        wakeups++;
+    }
+
+    printf("  periodic 100 Hz tick:   %u\n", 6000);
+    printf("  periodic 1000 Hz tick:  %u\n", 60000);
+    printf("  one-shot next event:    %u\n", wakeups);
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("=== Aurora OS Kernel Timer Tests ===\n");
+
+    test_ordering();
+    test_cancel();
+    test_levels();
+    test_next_event();
+    test_callbacks();
+
+    if (bench) {
+        printf("\n=== Benchmarks ===\n");
+        bench_wheel();
+        bench_tickless();
+    }
+
+    printf("\n========================================\n");
+    printf("Passed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
@@ -0,0 +1,516 @@
+/**
+ * Aurora OS - Per-CPU Magazine Layer Tests
+ *
+ * Host-built harness for kernel/memory/magazine.c on top of the slab
+ * allocator, with one pthread per simulated CPU: magazine hit and swap
+ * behaviour, depot exchange between CPUs, draining on halt, and a
+ * multithreaded stress run with cross-CPU frees that checks for overlap
+ * and leaks. With --bench, measures alloc/free throughput from 1 to 16
+ * threads against the slab allocator behind a single global lock.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sched.h>
+#include "../../kernel/memory/magazine.h"
+#include "../../kernel/smp/smp.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+#define REGION_SIZE (256u * 1024 * 1024)
+
+static uint8_t* g_region;
+
+/* ---- Kernel service stubs: one thread per simulated CPU ---- */
+
+static __thread uint32_t t_cpu_id;
+
+uint32_t smp_get_current_cpu_id(void) {
+    return t_cpu_id;
+}
+
+static long g_host_cpus;
+
+void cpu_relax(void) {
+    /* One host CPU is shared by all the simulated ones; let the holder run */
+    if (!g_host_cpus) {
+        g_host_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (g_host_cpus < 2) {
+        sched_yield();
+    } else {
+        __asm__ volatile("pause" ::: "memory");
+    }
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t rnd(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static void reset_heap(void) {
+    if (slab_init(g_region, REGION_SIZE) != 0) {
+        printf("slab_init failed\n");
+        exit(1);
+    }
+    magazine_init();
+}
+
+static void drain_all(void) {
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        magazine_drain_cpu(cpu);
+    }
+    magazine_reap();
+}
+
+/* ---- Tests ---- */
+
+static void test_single_cpu(void) {
+    printf("\nSingle CPU:\n");
+    reset_heap();
+    t_cpu_id = 0;
+
+    magazine_stats_t ms;
+    void* a = magazine_alloc(64);
+    magazine_get_stats(&ms);
+    TEST_ASSERT(a && ms.slab_allocs == 1 && ms.cpu_allocs == 0,
+                "First allocation misses to the slab layer");
+
+    magazine_free(a);
+    void* b = magazine_alloc(64);
+    magazine_get_stats(&ms);
+    TEST_ASSERT(b == a && ms.cpu_frees == 1 && ms.cpu_allocs == 1,
+                "Free then alloc is served from the loaded magazine (LIFO)");
+
+    /* Fill two magazines' worth, free, reallocate: no slab traffic */
+    uint32_t rounds = ms.magazine_rounds[3];
+    void* objs[64];
+    for (uint32_t i = 0; i < 2 * rounds; i++) {
+        objs[i] = magazine_alloc(64);
+    }
+    for (uint32_t i = 0; i < 2 * rounds; i++) {
+        magazine_free(objs[i]);
+    }
+    magazine_get_stats(&ms);
+    uint64_t slab_before = ms.slab_allocs;
+    for (uint32_t i = 0; i < 2 * rounds; i++) {
+        objs[i] = magazine_alloc(64);
+    }
+    magazine_get_stats(&ms);
+    TEST_ASSERT(ms.slab_allocs == slab_before,
+                "Loaded and previous magazines absorb two magazines of churn");
+    for (uint32_t i = 0; i < 2 * rounds; i++) {
+        magazine_free(objs[i]);
+    }
+
+    void* big = magazine_alloc(20000);
+    slab_stats_t ss;
+    slab_get_stats(&ss);
+    TEST_ASSERT(big && ss.large_pages == 5, "Large requests pass through to page runs");
+    magazine_free(big);
+    slab_get_stats(&ss);
+    TEST_ASSERT(ss.large_pages == 0, "Large frees pass through to page runs");
+    TEST_ASSERT(magazine_alloc(0) == NULL, "Zero-size allocation returns NULL");
+}
+
+static void test_depot(void) {
+    printf("\nDepot exchange:\n");
+    reset_heap();
+
+    enum { N = 300 };
+    void* objs[N];
+
+    /* CPU 1 allocates, CPU 2 frees: full magazines collect in the depot */
+    t_cpu_id = 1;
+    for (int i = 0; i < N; i++) {
+        objs[i] = magazine_alloc(128);
+    }
+    t_cpu_id = 2;
+    for (int i = 0; i < N; i++) {
+        magazine_free(objs[i]);
+    }
+
+    magazine_stats_t ms;
+    magazine_get_stats(&ms);
+    TEST_ASSERT(ms.depot_full[5] > 0, "Remote frees push full magazines to the depot");
+
+    /* CPU 1 allocates again: served from depot magazines, not slabs */
+    uint64_t slab_before = ms.slab_allocs;
+    t_cpu_id = 1;
+    uint32_t from_depot = ms.depot_full[5] * ms.magazine_rounds[5];
+    for (uint32_t i = 0; i < from_depot; i++) {
+        objs[i] = magazine_alloc(128);
+    }
+    magazine_get_stats(&ms);
+    TEST_ASSERT(ms.slab_allocs == slab_before && ms.depot_exchanges > 0,
+                "Allocating CPU refills from depot magazines");
+
+    for (uint32_t i = 0; i < from_depot; i++) {
+        magazine_free(objs[i]);
+    }
+    t_cpu_id = 0;
+}
+
+static void test_bad_frees(void) {
+    printf("\nBad frees:\n");
+    reset_heap();
+    t_cpu_id = 0;
+
+    char* a = (char*)magazine_alloc(64);
+    char* b = (char*)magazine_alloc(64);
+    magazine_stats_t ms;
+    magazine_get_stats(&ms);
+    uint64_t frees_before = ms.cpu_frees;
+
+    magazine_free(a + 8);
+    magazine_get_stats(&ms);
+    TEST_ASSERT(ms.cpu_frees == frees_before && slab_object_class(a) == 3,
+                "Interior pointer is rejected");
+
+    magazine_free(a);
+    magazine_free(a);
+    magazine_get_stats(&ms);
+    TEST_ASSERT(ms.cpu_frees == frees_before + 1 && ms.double_frees == 1,
+                "Double free of a parked object is rejected");
+
+    void* c = magazine_alloc(64);
+    void* d = magazine_alloc(64);
+    TEST_ASSERT(c == a && d != a, "A rejected free never hands an object out twice");
+    magazine_free(c);
+    magazine_free(d);
+    magazine_free(b);
+
+    /* Once back in the slab layer, the slab bitmap catches it */
+    drain_all();
+    slab_stats_t ss;
+    slab_get_stats(&ss);
+    uint64_t slab_frees = ss.frees;
+    magazine_free(b);
+    slab_get_stats(&ss);
+    TEST_ASSERT(ss.frees == slab_frees && ss.class_objects[3] == 0,
+                "Double free of an object back in its slab is rejected");
+}
+
+static void test_drain(void) {
+    printf("\nDrain on halt:\n");
+    reset_heap();
+    t_cpu_id = 3;
+
+    void* objs[20];
+    for (int i = 0; i < 20; i++) {
+        objs[i] = magazine_alloc(32);
+    }
+    for (int i = 0; i < 20; i++) {
+        magazine_free(objs[i]);
+    }
+
+    slab_stats_t ss;
+    slab_get_stats(&ss);
+    TEST_ASSERT(ss.class_objects[1] == 20, "Freed objects stay parked in the CPU's magazine");
+
+    magazine_drain_cpu(3);
+    slab_get_stats(&ss);
+    magazine_stats_t ms;
+    magazine_get_stats(&ms);
+    TEST_ASSERT(ss.class_objects[1] == 0 && ms.drains == 1,
+                "Draining returns the CPU's objects to the slab layer");
+    TEST_ASSERT(ms.depot_empty[1] >= 1, "Drained magazines go to the depot for reuse");
+
+    magazine_reap();
+    slab_get_stats(&ss);
+    TEST_ASSERT(ss.bytes_in_use == 0, "Reaping frees the spare magazines");
+    t_cpu_id = 0;
+}
+
+/* ---- Multithreaded stress ---- */
+
+#define STRESS_THREADS 8
+#define MAILBOX_SIZE 1024
+
+typedef struct {
+    uint8_t* ptr;
+    uint32_t size;
+    uint8_t tag;
+} obj_t;
+
+/* Objects handed to another CPU to free */
+static obj_t g_mailbox[MAILBOX_SIZE];
+static uint32_t g_mail_count;
+static spinlock_t g_mail_lock;
+
+typedef struct {
+    uint32_t cpu;
+    uint32_t ops;
+    uint32_t corrupt;
+    uint32_t failed;
+} stress_arg_t;
+
+static void fill(obj_t* o) {
+    for (uint32_t i = 0; i < o->size; i++) {
+        o->ptr[i] = (uint8_t)(o->tag + i);
+    }
+}
+
+static int intact(const obj_t* o) {
+    for (uint32_t i = 0; i < o->size; i++) {
+        if (o->ptr[i] != (uint8_t)(o->tag + i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void* stress_thread(void* p) {
+    stress_arg_t* arg = (stress_arg_t*)p;
+    t_cpu_id = arg->cpu;
+    uint64_t rng = 0x1234567ull * (arg->cpu + 1);
+
+    enum { LIVE = 512 };
+    obj_t live[LIVE];
+    uint32_t count = 0;
+
+    for (uint32_t op = 0; op < arg->ops; op++) {
+        uint64_t r = rnd(&rng);
+        if (count < LIVE && (count == 0 || (r % 100) < 52)) {
+            obj_t o;
+            o.size = (r >> 8) % 16 == 0 ? 4097 + (uint32_t)((r >> 16) % 8000)
+                                        : 1 + (uint32_t)((r >> 16) % 2048);
+            o.ptr = magazine_alloc(o.size);
+            if (!o.ptr) {
+                arg->failed++;
+                continue;
+            }
+            o.tag = (uint8_t)(r >> 32);
+            fill(&o);
+            live[count++] = o;
+        } else if ((r % 100) < 90) {
+            uint32_t idx = (uint32_t)((r >> 8) % count);
+            if (!intact(&live[idx])) {
+                arg->corrupt++;
+            }
+            magazine_free(live[idx].ptr);
+            live[idx] = live[--count];
+        } else {
+            /* Pass an object to whichever CPU frees next, take one back */
+            uint32_t idx = (uint32_t)((r >> 8) % count);
+            obj_t give = live[idx];
+            live[idx] = live[--count];
+            obj_t take = { NULL, 0, 0 };
+
+            spinlock_acquire(&g_mail_lock);
+            if (g_mail_count) {
+                take = g_mailbox[--g_mail_count];
+            }
+            if (g_mail_count < MAILBOX_SIZE) {
+                g_mailbox[g_mail_count++] = give;
+                give.ptr = NULL;
+            }
+            spinlock_release(&g_mail_lock);
+
+            if (give.ptr) {
+                magazine_free(give.ptr);
+            }
+            if (take.ptr) {
+                if (!intact(&take)) {
+                    arg->corrupt++;
+                }
+                magazine_free(take.ptr);
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (!intact(&live[i])) {
+            arg->corrupt++;
+        }
+        magazine_free(live[i].ptr);
+    }
+    return NULL;
+}
+
+static void test_threads(void) {
+    printf("\nMultithreaded stress (%d CPUs):\n", STRESS_THREADS);
+    reset_heap();
+    spinlock_init(&g_mail_lock);
+    g_mail_count = 0;
+
+    pthread_t threads[STRESS_THREADS];
+    stress_arg_t args[STRESS_THREADS];
+    for (uint32_t i = 0; i < STRESS_THREADS; i++) {
+        args[i].cpu = i;
+        args[i].ops = 200000;
+        args[i].corrupt = 0;
+        args[i].failed = 0;
+        pthread_create(&threads[i], NULL, stress_thread, &args[i]);
+    }
+
+    uint32_t corrupt = 0, failed = 0;
+    for (uint32_t i = 0; i < STRESS_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        corrupt += args[i].corrupt;
+        failed += args[i].failed;
+    }
+
+    t_cpu_id = 0;
+    for (uint32_t i = 0; i < g_mail_count; i++) {
+        if (!intact(&g_mailbox[i])) {
+            corrupt++;
+        }
+        magazine_free(g_mailbox[i].ptr);
+    }
+
+    magazine_stats_t ms;
+    magazine_get_stats(&ms);
+    printf("    %llu CPU-local allocs, %llu slab allocs, %llu depot exchanges\n",
+           (unsigned long long)ms.cpu_allocs, (unsigned long long)ms.slab_allocs,
+           (unsigned long long)ms.depot_exchanges);
+    TEST_ASSERT(failed == 0, "No allocation failures");
+    TEST_ASSERT(corrupt == 0, "No object was overwritten by another allocation");
+    TEST_ASSERT(ms.cpu_allocs > ms.slab_allocs * 4, "Most allocations stay CPU-local");
+
+    drain_all();
+    slab_shrink();
+    slab_stats_t ss;
+    slab_get_stats(&ss);
+    TEST_ASSERT(ss.bytes_in_use == 0 && ss.free_pages == ss.total_pages && ss.free_runs == 1,
+                "All memory returns to the page allocator after drain and reap (no leaks)");
+}
+
+/* ---- Benchmarks ---- */
+
+static spinlock_t g_global_lock;
+static volatile int g_go;
+
+typedef struct {
+    uint32_t cpu;
+    int magazines;
+    uint32_t iterations;
+} bench_arg_t;
+
+static void* bench_thread(void* p) {
+    bench_arg_t* arg = (bench_arg_t*)p;
+    t_cpu_id = arg->cpu;
+    uint64_t rng = 99 + arg->cpu;
+    void* objs[8];
+    static const uint32_t sizes[] = { 24, 64, 96, 200, 256, 512, 48, 128 };
+
+    while (!g_go) {
+        __asm__ volatile("pause");
+    }
+
+    for (uint32_t it = 0; it < arg->iterations; it++) {
+        uint32_t base = (uint32_t)rnd(&rng);
+        for (int i = 0; i < 8; i++) {
+            uint32_t size = sizes[(base + i) & 7];
+            if (arg->magazines) {
+                objs[i] = magazine_alloc(size);
+            } else {
+                spinlock_acquire(&g_global_lock);
+                objs[i] = slab_alloc(size);
+                spinlock_release(&g_global_lock);
+            }
+        }
+        for (int i = 0; i < 8; i++) {
+            if (arg->magazines) {
+                magazine_free(objs[i]);
+            } else {
+                spinlock_acquire(&g_global_lock);
+                slab_free(objs[i]);
+                spinlock_release(&g_global_lock);
+            }
+        }
+    }
+    return NULL;
+}
+
+static double bench_run(uint32_t nthreads, int magazines) {
+    enum { ITERATIONS = 200000 };
+    reset_heap();
+    spinlock_init(&g_global_lock);
+    g_go = 0;
+
+    pthread_t threads[MAX_CPUS];
+    bench_arg_t args[MAX_CPUS];
+    for (uint32_t i = 0; i < nthreads; i++) {
+        args[i].cpu = i;
+        args[i].magazines = magazines;
+        args[i].iterations = ITERATIONS;
+        pthread_create(&threads[i], NULL, bench_thread, &args[i]);
+    }
+
+    uint64_t t0 = now_ns();
+    g_go = 1;
+    for (uint32_t i = 0; i < nthreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    uint64_t elapsed = now_ns() - t0;
+
+    /* Each iteration is 8 alloc/free pairs */
+    return (double)nthreads * ITERATIONS * 8 * 1e3 / (double)elapsed;
+}
+
+static void run_benchmarks(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    printf("\nBenchmarks (alloc+free pairs, Mops/s, %ld host CPUs):\n", cpus);
+    printf("    %-8s %14s %14s %8s\n", "threads", "global lock", "magazines", "ratio");
+
+    static const uint32_t counts[] = { 1, 2, 4, 8, 16 };
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        double locked = bench_run(counts[i], 0);
+        double mags = bench_run(counts[i], 1);
+        printf("    %-8u %14.1f %14.1f %7.1fx\n", counts[i], locked, mags, mags / locked);
+    }
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("Per-CPU Magazine Layer Tests\n");
+    printf("============================\n");
+
+    if (posix_memalign((void**)&g_region, SLAB_PAGE_SIZE, REGION_SIZE) != 0) {
+        printf("Out of host memory\n");
+        return 1;
+    }
+
+    test_single_cpu();
+    test_depot();
+    test_bad_frees();
+    test_drain();
+    test_threads();
+
+    if (bench) {
+        run_benchmarks();
+    }
+
+    free(g_region);
+
+    printf("\nPassed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
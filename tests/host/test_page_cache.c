@@ -0,0 +1,478 @@
+/**
+ * Aurora OS - Page Cache Tests
+ *
+ * Host-built harness for the radix tree in kernel/core/radix_tree.c and
+ * the page cache in filesystem/cache/page_cache.c, driven through the
+ * VFS on a ramdisk: sparse radix indices, gang lookup and node freeing;
+ * unaligned reads and writes checked against a model of the file, cold
+ * reads after reclaim, hit and miss accounting, LRU eviction order,
+ * unlink dropping pages and files past the ramdisk's direct blocks.
+ * With --bench, measures sequential and random 4 KB reads and writes on
+ * a 512 KB file with a cold and a warm cache.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include "../../kernel/core/radix_tree.h"
+#include "../../filesystem/cache/page_cache.h"
+#include "../../filesystem/vfs/vfs.h"
+#include "../../filesystem/ramdisk/ramdisk.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/* ---- Kernel service stubs ---- */
+
+static long live_allocs;
+
+void* kmalloc(size_t size) {
+    void* p = malloc(size);
+    if (p) {
+        live_allocs++;
+    }
+    return p;
+}
+
+void kfree(void* ptr) {
+    if (ptr) {
+        live_allocs--;
+        free(ptr);
+    }
+}
+
+uint32_t smp_get_current_cpu_id(void) {
+    return 0;
+}
+
+void cpu_relax(void) {
+    sched_yield();
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static void setup_fs(void) {
+    /* Ramdisk first so it drops the last run's pages while the cache's
+     * lists still hold them */
+    ramdisk_create(0);
+    vfs_init();
+    vfs_register_fs("ramdisk", ramdisk_get_ops());
+    vfs_mount("ramdisk0", "/", "ramdisk");
+}
+
+static void fill_pattern(uint8_t* buf, size_t size, uint32_t seed) {
+    for (size_t i = 0; i < size; i++) {
+        buf[i] = (uint8_t)((i * 31 + seed) ^ (i >> 8));
+    }
+}
+
+static int read_at(int fd, void* buf, size_t size, long offset) {
+    vfs_seek(fd, offset, SEEK_SET);
+    return vfs_read(fd, buf, size);
+}
+
+static int write_at(int fd, const void* buf, size_t size, long offset) {
+    vfs_seek(fd, offset, SEEK_SET);
+    return vfs_write(fd, buf, size);
+}
+
+/* ---- Radix tree ---- */
+
+static void* item_for(uint32_t index) {
+    return (void*)(uintptr_t)(((uint64_t)index << 1) | 1);
+}
+
+static void test_radix_tree(void) {
+    printf("\nRadix tree:\n");
+
+    radix_tree_root_t root;
+    radix_tree_init(&root);
+    long base_allocs = live_allocs;
+
+    static const uint32_t indices[] = {
+        0, 1, 63, 64, 4095, 4096, 262143, 1000000, 0x7FFFFFFF, 0xFFFFFFFE, 0xFFFFFFFF
+    };
+    const uint32_t n = sizeof(indices) / sizeof(indices[0]);
+    int inserted = 1;
+    for (uint32_t i = 0; i < n; i++) {
+        if (radix_tree_insert(&root, indices[i], item_for(indices[i])) != 0) {
+            inserted = 0;
+        }
+    }
+    TEST_ASSERT(inserted, "Sparse indices up to 0xFFFFFFFF insert");
+    TEST_ASSERT(root.height == RADIX_TREE_MAX_HEIGHT, "Tree grows to full height for the top index");
+
+    int found = 1;
+    for (uint32_t i = 0; i < n; i++) {
+        if (radix_tree_lookup(&root, indices[i]) != item_for(indices[i])) {
+            found = 0;
+        }
+    }
+    TEST_ASSERT(found, "Every index looks up its own item");
+    TEST_ASSERT(radix_tree_lookup(&root, 2) == NULL &&
+                radix_tree_lookup(&root, 4097) == NULL &&
+                radix_tree_lookup(&root, 0xFFFFFFFD) == NULL, "Absent indices miss");
+    TEST_ASSERT(radix_tree_insert(&root, 4096, (void*)1) != 0, "Occupied index is refused");
+
+    void* results[32];
+    uint32_t got = radix_tree_gang_lookup(&root, results, 0, 32);
+    int ordered = got == n;
+    for (uint32_t i = 0; i < got && ordered; i++) {
+        if (results[i] != item_for(indices[i])) {
+            ordered = 0;
+        }
+    }
+    TEST_ASSERT(ordered, "Gang lookup returns every item in index order");
+
+    got = radix_tree_gang_lookup(&root, results, 65, 3);
+    TEST_ASSERT(got == 3 && results[0] == item_for(4095) &&
+                results[2] == item_for(262143),
+                "Gang lookup starts mid-tree and stops at max");
+
+    int deleted = 1;
+    for (uint32_t i = 0; i < n; i++) {
+        if (radix_tree_delete(&root, indices[n - 1 - i]) !=
+            item_for(indices[n - 1 - i])) {
+            deleted = 0;
+        }
+        if (i == 2) {
+            TEST_ASSERT(root.height < RADIX_TREE_MAX_HEIGHT, "Tree shrinks once the top indices go");
+        }
+    }
+    TEST_ASSERT(deleted, "Delete returns each item");
+    TEST_ASSERT(root.height == 0 && root.rnode == NULL, "Tree is empty after deleting everything");
+    TEST_ASSERT(live_allocs == base_allocs, "All nodes freed");
+    TEST_ASSERT(radix_tree_delete(&root, 5) == NULL, "Delete from empty tree returns NULL");
+
+    /* Dense run with random deletes */
+    for (uint32_t i = 0; i < 10000; i++) {
+        radix_tree_insert(&root, i, (void*)(uintptr_t)(i + 1));
+    }
+    uint8_t present[10000];
+    memset(present, 1, sizeof(present));
+    for (uint32_t k = 0; k < 6000; k++) {
+        uint32_t i = (uint32_t)(rng() % 10000);
+        void* item = radix_tree_delete(&root, i);
+        if ((item != NULL) != present[i]) {
+            deleted = 0;
+        }
+        present[i] = 0;
+    }
+    int consistent = deleted;
+    for (uint32_t i = 0; i < 10000; i++) {
+        void* item = radix_tree_lookup(&root, i);
+        if (present[i] ? item != (void*)(uintptr_t)(i + 1) : item != NULL) {
+            consistent = 0;
+        }
+    }
+    TEST_ASSERT(consistent, "Dense tree stays consistent under random deletes");
+    for (uint32_t i = 0; i < 10000; i++) {
+        radix_tree_delete(&root, i);
+    }
+    TEST_ASSERT(live_allocs == base_allocs, "Dense tree frees all its nodes");
+}
+
+/* ---- Reads and writes through the cache ---- */
+
+static void test_read_write(void) {
+    printf("\nReads and writes:\n");
+
+    setup_fs();
+
+    enum { MODEL_SIZE = 40000 };
+    static uint8_t model[MODEL_SIZE + 16];
+    static uint8_t buf[MODEL_SIZE + 16];
+    uint32_t size = 0;
+
+    int fd = vfs_open("/data", O_RDWR | O_CREAT);
+    TEST_ASSERT(fd >= 0, "Create file");
+
+    fill_pattern(buf, 10000, 1);
+    TEST_ASSERT(vfs_write(fd, buf, 10000) == 10000, "Write 10000 bytes spanning three pages");
+    memcpy(model, buf, 10000);
+    size = 10000;
+
+    memset(buf, 0, sizeof(buf));
+    TEST_ASSERT(read_at(fd, buf, 10000, 0) == 10000 && memcmp(buf, model, 10000) == 0,
+                "Read back matches");
+
+    /* Random unaligned writes, some extending the file, with a hole */
+    int ok = 1;
+    for (int k = 0; k < 200; k++) {
+        uint32_t off = (uint32_t)(rng() % (MODEL_SIZE - 1));
+        uint32_t len = 1 + (uint32_t)(rng() % 6000);
+        if (off + len > MODEL_SIZE) {
+            len = MODEL_SIZE - off;
+        }
+        if (k == 100) {
+            off = MODEL_SIZE - 100;     /* Far past EOF: leaves a hole */
+            len = 100;
+        }
+        fill_pattern(buf, len, (uint32_t)k + 7);
+        if (write_at(fd, buf, len, off) != (int)len) {
+            ok = 0;
+        }
+        if (off > size) {
+            memset(model + size, 0, off - size);
+        }
+        memcpy(model + off, buf, len);
+        if (off + len > size) {
+            size = off + len;
+        }
+    }
+    TEST_ASSERT(ok, "200 random unaligned writes succeed");
+
+    memset(buf, 0xEE, sizeof(buf));
+    TEST_ASSERT(read_at(fd, buf, MODEL_SIZE, 0) == (int)size && memcmp(buf, model, size) == 0,
+                "Warm read matches model");
+
+    page_cache_shrink(UINT32_MAX);
+    page_cache_stats_t st;
+    page_cache_get_stats(&st);
+    TEST_ASSERT(st.pages == 0, "Shrink empties the cache");
+
+    memset(buf, 0xEE, sizeof(buf));
+    TEST_ASSERT(read_at(fd, buf, MODEL_SIZE, 0) == (int)size && memcmp(buf, model, size) == 0,
+                "Cold read from ramdisk matches model (writes went through)");
+
+    ok = 1;
+    for (int k = 0; k < 300; k++) {
+        uint32_t off = (uint32_t)(rng() % size);
+        uint32_t len = 1 + (uint32_t)(rng() % 9000);
+        uint32_t expect = off + len > size ? size - off : len;
+        if (read_at(fd, buf, len, off) != (int)expect || memcmp(buf, model + off, expect) != 0) {
+            ok = 0;
+        }
+    }
+    TEST_ASSERT(ok, "Random unaligned reads match model");
+    TEST_ASSERT(read_at(fd, buf, 10, size) == 0, "Read at end of file returns 0");
+
+    inode_t stat;
+    TEST_ASSERT(vfs_stat("/data", &stat) == 0 && stat.size == size, "File size follows writes");
+    TEST_ASSERT(size > 16384, "File is past the ramdisk's 16 KB of direct blocks");
+
+    /* Reopen sees the same inode and data */
+    vfs_close(fd);
+    fd = vfs_open("/data", O_RDONLY);
+    TEST_ASSERT(fd >= 0 && read_at(fd, buf, size, 0) == (int)size && memcmp(buf, model, size) == 0,
+                "Reopened file reads the same data");
+    TEST_ASSERT(vfs_write(fd, buf, 10) == -1, "Write on a read-only descriptor fails");
+    vfs_close(fd);
+
+    fd = vfs_open("/data", O_WRONLY | O_APPEND);
+    fill_pattern(buf, 5, 99);
+    TEST_ASSERT(fd >= 0 && vfs_write(fd, buf, 5) == 5, "Append write");
+    memcpy(model + size, buf, 5);
+    size += 5;
+    TEST_ASSERT(vfs_read(fd, buf, 5) == -1, "Read on a write-only descriptor fails");
+    vfs_close(fd);
+
+    fd = vfs_open("/data", O_RDONLY);
+    TEST_ASSERT(read_at(fd, buf, sizeof(buf), 0) == (int)size && memcmp(buf, model, size) == 0,
+                "Append landed at end of file");
+    vfs_close(fd);
+}
+
+/* ---- Hits, misses and eviction ---- */
+
+static void test_accounting(void) {
+    printf("\nHits, misses and eviction:\n");
+
+    setup_fs();
+
+    /* Page-at-a-time accounting: no readahead */
+    page_cache_set_readahead(0);
+
+    static uint8_t buf[8 * PAGE_CACHE_SIZE];
+    fill_pattern(buf, sizeof(buf), 3);
+    int fd = vfs_open("/eight", O_RDWR | O_CREAT);
+    vfs_write(fd, buf, sizeof(buf));
+    page_cache_shrink(UINT32_MAX);
+
+    page_cache_stats_t a, b;
+    page_cache_get_stats(&a);
+    read_at(fd, buf, PAGE_CACHE_SIZE, 0);
+    page_cache_get_stats(&b);
+    TEST_ASSERT(b.misses - a.misses == 1 && b.readpages - a.readpages == 1, "Cold page is a miss and a readpage");
+
+    page_cache_get_stats(&a);
+    read_at(fd, buf, 100, 50);
+    read_at(fd, buf, 100, 3900);
+    page_cache_get_stats(&b);
+    TEST_ASSERT(b.hits - a.hits == 2 && b.misses == a.misses, "Warm page reads are hits");
+
+    page_cache_get_stats(&a);
+    read_at(fd, buf, 200, PAGE_CACHE_SIZE - 100);
+    page_cache_get_stats(&b);
+    TEST_ASSERT(b.hits - a.hits == 1 && b.misses - a.misses == 1, "Read straddling pages touches both");
+
+    /* Full-page write into an uncached page needs no read */
+    page_cache_get_stats(&a);
+    write_at(fd, buf, PAGE_CACHE_SIZE, 5 * PAGE_CACHE_SIZE);
+    page_cache_get_stats(&b);
+    TEST_ASSERT(b.readpages == a.readpages && b.writepages - a.writepages == 1,
+                "Whole-page overwrite skips readpage");
+
+    page_cache_get_stats(&a);
+    write_at(fd, buf, 10, 6 * PAGE_CACHE_SIZE + 10);
+    page_cache_get_stats(&b);
+    TEST_ASSERT(b.readpages - a.readpages == 1, "Partial overwrite reads the page first");
+
+    /* LRU order with a four-page limit */
+    page_cache_shrink(UINT32_MAX);
+    page_cache_set_limit(4);
+    for (int i = 0; i < 4; i++) {
+        read_at(fd, buf, 1, (long)i * PAGE_CACHE_SIZE);
+    }
+    read_at(fd, buf, 1, 0);                         /* Page 0 now most recent */
+    read_at(fd, buf, 1, 4 * PAGE_CACHE_SIZE);       /* Evicts page 1 */
+    page_cache_get_stats(&b);
+    TEST_ASSERT(b.pages == 4 && b.evictions - a.evictions >= 1, "Limit holds the cache at four pages");
+
+    page_cache_get_stats(&a);
+    read_at(fd, buf, 1, 0);
+    read_at(fd, buf, 1, 2 * PAGE_CACHE_SIZE);
+    read_at(fd, buf, 1, 3 * PAGE_CACHE_SIZE);
+    read_at(fd, buf, 1, 4 * PAGE_CACHE_SIZE);
+    page_cache_get_stats(&b);
+    TEST_ASSERT(b.hits - a.hits == 4 && b.misses == a.misses, "Recently used pages survived");
+
+    page_cache_get_stats(&a);
+    read_at(fd, buf, 1, 1 * PAGE_CACHE_SIZE);
+    page_cache_get_stats(&b);
+    TEST_ASSERT(b.misses - a.misses == 1, "Least recently used page was the one evicted");
+
+    page_cache_set_limit(PAGE_CACHE_DEFAULT_MAX_PAGES);
+    vfs_close(fd);
+
+    /* Unlink drops the file's pages */
+    fd = vfs_open("/eight", O_RDONLY);
+    read_at(fd, buf, sizeof(buf), 0);
+    vfs_close(fd);
+    page_cache_get_stats(&a);
+    TEST_ASSERT(a.pages == 8, "Whole file cached");
+    TEST_ASSERT(vfs_unlink("/eight") == 0, "Unlink file");
+    page_cache_get_stats(&b);
+    TEST_ASSERT(b.pages == 0, "Unlink drops its cached pages");
+
+    /* A new file in the same ramdisk inode does not see stale pages */
+    fd = vfs_open("/fresh", O_RDWR | O_CREAT);
+    memset(buf, 0x11, 100);
+    vfs_write(fd, buf, 100);
+    memset(buf, 0, 200);
+    TEST_ASSERT(read_at(fd, buf, 200, 0) == 100 && buf[0] == 0x11 && buf[99] == 0x11,
+                "Reused inode starts clean");
+    vfs_close(fd);
+
+    page_cache_set_readahead(PAGE_CACHE_RA_DEFAULT_MAX);
+}
+
+/* ---- Benchmark ---- */
+
+#define BENCH_FILE_SIZE (512 * 1024)
+#define BENCH_IO        4096
+
+static double mbps(uint64_t bytes, uint64_t ns) {
+    return ns ? (double)bytes / (1024.0 * 1024.0) / ((double)ns / 1e9) : 0.0;
+}
+
+static uint64_t bench_pass(int fd, uint8_t* buf, int write, int random, int rounds) {
+    uint32_t ios = BENCH_FILE_SIZE / BENCH_IO;
+    uint64_t start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (uint32_t i = 0; i < ios; i++) {
+            long off = (long)(random ? rng() % ios : i) * BENCH_IO;
+            if (write) {
+                write_at(fd, buf, BENCH_IO, off);
+            } else {
+                read_at(fd, buf, BENCH_IO, off);
+            }
+        }
+    }
+    return now_ns() - start;
+}
+
+static void run_bench(void) {
+    printf("\nBenchmark (%d KB file, %d byte I/O):\n", BENCH_FILE_SIZE / 1024, BENCH_IO);
+
+    setup_fs();
+
+    static uint8_t buf[BENCH_IO];
+    fill_pattern(buf, sizeof(buf), 5);
+    int fd = vfs_open("/bench", O_RDWR | O_CREAT);
+    for (uint32_t off = 0; off < BENCH_FILE_SIZE; off += BENCH_IO) {
+        vfs_write(fd, buf, BENCH_IO);
+    }
+
+    const int rounds = 20;
+    uint64_t bytes = (uint64_t)BENCH_FILE_SIZE * rounds;
+    static const char* names[] = { "sequential read", "random read", "sequential write", "random write" };
+
+    for (int t = 0; t < 4; t++) {
+        int write = t >= 2;
+        int random = t & 1;
+
+        /* Cold: every pass starts with an empty cache */
+        uint64_t cold = 0;
+        for (int r = 0; r < rounds; r++) {
+            page_cache_shrink(UINT32_MAX);
+            cold += bench_pass(fd, buf, write, random, 1);
+        }
+
+        bench_pass(fd, buf, write, random, 1);
+        uint64_t warm = bench_pass(fd, buf, write, random, rounds);
+
+        printf("  %-17s cold %8.1f MB/s   warm %8.1f MB/s\n", names[t],
+               mbps(bytes, cold), mbps(bytes, warm));
+    }
+
+    page_cache_stats_t st;
+    page_cache_get_stats(&st);
+    printf("  hits %llu  misses %llu  readpages %llu  writepages %llu\n",
+           (unsigned long long)st.hits, (unsigned long long)st.misses,
+           (unsigned long long)st.readpages, (unsigned long long)st.writepages);
+    vfs_close(fd);
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("Aurora OS Page Cache Tests\n");
+
+    test_radix_tree();
+    test_read_write();
+    test_accounting();
+
+    if (bench) {
+        run_bench();
+    }
+
+    printf("\nPassed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
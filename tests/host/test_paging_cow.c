@@ -0,0 +1,366 @@
+/**
+ * Aurora OS - Copy-on-Write Fork Tests
+ *
+ * Host-built harness for paging_clone_directory() and the COW fault path
+ * in kernel/memory/paging.c. Physical memory is a MAP_32BIT mapping
+ * managed by the buddy allocator, so "physical" addresses are host
+ * pointers that fit the 32-bit page table entries; page tables come from
+ * the slab allocator. Processes are page directories whose user pages are
+ * written through a simulated MMU that raises write faults on read-only
+ * entries. With --bench, measures fork latency and fault counts for large
+ * address spaces against an eager-copy fork.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "../../kernel/memory/paging.h"
+#include "../../kernel/memory/slab.h"
+#include "../../kernel/process/process.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/* Simulated physical memory: 640 MB of frames plus a 16 MB kernel heap */
+#define PHYS_FRAMES     (160u * 1024)
+#define HEAP_BYTES      (16u * 1024 * 1024)
+
+#define USER_BASE       0x40000000u
+
+static buddy_frame_t* g_meta;
+static buddy_zone_t g_zone;
+
+/* ---- Kernel service stubs ---- */
+
+void* kmalloc(size_t size) { return slab_alloc(size); }
+void kfree(void* ptr) { slab_free(ptr); }
+
+static void* pfn_address(uint32_t pfn) {
+    return (void*)((uintptr_t)pfn * PAGE_SIZE);
+}
+
+void* frame_alloc(uint32_t order) {
+    uint32_t pfn = buddy_alloc(&g_zone, order);
+    return pfn == BUDDY_INVALID ? NULL : pfn_address(pfn);
+}
+
+uint32_t frame_get(uint32_t phys_addr) { return buddy_frame_get(&g_zone, phys_addr / PAGE_SIZE); }
+uint32_t frame_put(uint32_t phys_addr) { return buddy_frame_put(&g_zone, phys_addr / PAGE_SIZE); }
+uint32_t frame_refcount(uint32_t phys_addr) { return buddy_frame_refs(&g_zone, phys_addr / PAGE_SIZE); }
+int frame_exclusive(uint32_t phys_addr) { return buddy_frame_exclusive(&g_zone, phys_addr / PAGE_SIZE); }
+int frame_free(void* addr) { return buddy_free(&g_zone, (uint32_t)((uintptr_t)addr / PAGE_SIZE)); }
+void memory_get_frame_stats(buddy_stats_t* stats) { buddy_get_stats(&g_zone, stats); }
+
+/* No swap device is attached, so kswapd is never started */
+process_t* process_create(void (*entry)(void), uint32_t priority) { (void)entry; (void)priority; return NULL; }
+int process_wait_event_until(volatile uint32_t* event, uint64_t deadline_us) { (void)event; (void)deadline_us; return -1; }
+void process_post_event(process_t* process, volatile uint32_t* event) { (void)process; *event = 1; }
+
+void* vm_alloc(size_t size, uint32_t flags) {
+    (void)flags;
+    uint32_t pfn = buddy_alloc_contig(&g_zone, (uint32_t)((size + PAGE_SIZE - 1) / PAGE_SIZE));
+    return pfn == BUDDY_INVALID ? NULL : pfn_address(pfn);
+}
+
+void vm_free(void* ptr) {
+    buddy_free(&g_zone, (uint32_t)((uintptr_t)ptr / PAGE_SIZE));
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* ---- Simulated MMU ---- */
+
+static uint64_t g_write_faults;
+
+static uint32_t* lookup_pte(page_directory_t* dir, uint32_t va) {
+    uint32_t pde = (*dir)[va >> 22];
+    if (!(pde & PAGE_PRESENT)) {
+        return NULL;
+    }
+    page_table_t* table = (page_table_t*)(uintptr_t)(pde & ~0xFFF);
+    return &(*table)[(va >> 12) & 0x3FF];
+}
+
+static uint32_t* phys_word(uint32_t pte, uint32_t va) {
+    return (uint32_t*)(uintptr_t)((pte & ~0xFFF) | (va & 0xFFC));
+}
+
+/* Store through the MMU: a write to a read-only page raises a fault */
+static int proc_write(page_directory_t* dir, uint32_t va, uint32_t value) {
+    uint32_t* pte = lookup_pte(dir, va);
+    if (!pte || !(*pte & PAGE_PRESENT)) {
+        return -1;
+    }
+    if (!(*pte & PAGE_WRITE)) {
+        g_write_faults++;
+        paging_switch_directory(dir);
+        page_fault_handler(va, 0x7);    /* Present, write, user */
+        if (!(*pte & PAGE_WRITE)) {
+            return -1;
+        }
+    }
+    *phys_word(*pte, va) = value;
+    return 0;
+}
+
+static uint32_t proc_read(page_directory_t* dir, uint32_t va) {
+    uint32_t* pte = lookup_pte(dir, va);
+    return pte ? *phys_word(*pte, va) : 0xDEADDEAD;
+}
+
+/**
+ * Create a process with the kernel tables and pages of user memory
+ * filled with a per-page pattern
+ */
+static page_directory_t* make_process(uint32_t pages, uint32_t seed) {
+    page_directory_t* kernel = paging_get_current_directory();
+    page_directory_t* dir = paging_create_directory();
+    (*dir)[0] = (*kernel)[0];
+
+    for (uint32_t i = 0; i < pages; i++) {
+        void* frame = vm_alloc(PAGE_SIZE, MEM_USER);
+        if (!frame) {
+            return NULL;
+        }
+        uint32_t* w = (uint32_t*)frame;
+        for (uint32_t j = 0; j < PAGE_SIZE / 4; j++) {
+            w[j] = seed + i;
+        }
+        paging_map_page(dir, USER_BASE + i * PAGE_SIZE, (uint32_t)(uintptr_t)frame,
+                        PAGE_PRESENT | PAGE_WRITE | PAGE_USER);
+    }
+    return dir;
+}
+
+/* ---- Tests ---- */
+
+static page_directory_t* g_kernel_dir;
+
+static void test_clone(void) {
+    printf("\nClone:\n");
+    uint32_t free_start = g_zone.free_frames;
+
+    page_directory_t* parent = make_process(64, 1000);
+    uint32_t va = USER_BASE + 5 * PAGE_SIZE;
+    uint32_t phys = paging_get_physical_address(parent, va) & ~0xFFF;
+
+    /* A read-only user page is shared without COW */
+    uint32_t ro_va = USER_BASE + 63 * PAGE_SIZE;
+    paging_map_page(parent, ro_va, paging_get_physical_address(parent, ro_va),
+                    PAGE_PRESENT | PAGE_USER);
+
+    paging_cow_stats_t cs;
+    page_directory_t* child = paging_clone_directory(parent);
+    paging_get_cow_stats(&cs);
+    TEST_ASSERT(child != NULL && cs.pages_shared == 64, "Clone shares every user page");
+    TEST_ASSERT(paging_get_physical_address(child, va) == paging_get_physical_address(parent, va),
+                "Child maps the parent's frames");
+
+    uint32_t ppte = *lookup_pte(parent, va);
+    uint32_t cpte = *lookup_pte(child, va);
+    TEST_ASSERT(!(ppte & PAGE_WRITE) && (ppte & PAGE_COW) && !(cpte & PAGE_WRITE) && (cpte & PAGE_COW),
+                "Writable pages become read-only COW in both processes");
+    uint32_t ro_pte = *lookup_pte(child, ro_va);
+    TEST_ASSERT(!(ro_pte & PAGE_COW) && !(ro_pte & PAGE_WRITE), "Read-only pages are shared without COW");
+    TEST_ASSERT(frame_refcount(phys) == 2, "Shared frames have two references");
+    TEST_ASSERT((*child)[0] == (*parent)[0], "Kernel page table is shared, not copied");
+
+    /* Child writes: private copy */
+    TEST_ASSERT(proc_write(child, va, 0xC0FFEE) == 0, "Child write fault is handled");
+    paging_get_cow_stats(&cs);
+    TEST_ASSERT(cs.cow_copies == 1 && cs.cow_reuses == 0, "First write to a shared page copies");
+    TEST_ASSERT(proc_read(child, va) == 0xC0FFEE && proc_read(parent, va) == 1005,
+                "Child's write is private; parent keeps the original");
+    TEST_ASSERT(proc_read(child, va + 4) == 1005, "Copy carries the rest of the page");
+    TEST_ASSERT(frame_refcount(phys) == 1, "Copy drops the child's reference");
+
+    /* Parent writes: sole owner, no copy */
+    TEST_ASSERT(proc_write(parent, va, 0xBEEF) == 0, "Parent write fault is handled");
+    paging_get_cow_stats(&cs);
+    TEST_ASSERT(cs.cow_copies == 1 && cs.cow_reuses == 1 &&
+                (paging_get_physical_address(parent, va) & ~0xFFF) == phys,
+                "Last reference regains write access in place");
+
+    /* Grandchild: three sharers */
+    uint32_t va2 = USER_BASE + 9 * PAGE_SIZE;
+    uint32_t phys2 = paging_get_physical_address(parent, va2) & ~0xFFF;
+    page_directory_t* grandchild = paging_clone_directory(child);
+    TEST_ASSERT(frame_refcount(phys2) == 3, "Fork of a fork takes a third reference");
+    proc_write(grandchild, va2, 7);
+    TEST_ASSERT(frame_refcount(phys2) == 2 && proc_read(child, va2) == 1009,
+                "Grandchild copy leaves the other two sharing");
+
+    paging_destroy_directory(grandchild);
+    paging_destroy_directory(child);
+    TEST_ASSERT(frame_refcount(phys2) == 1 && proc_read(parent, va2) == 1009,
+                "Exiting children drop their references");
+    TEST_ASSERT(paging_get_physical_address(g_kernel_dir, 0x1000) == 0x1000,
+                "Kernel mappings survive child teardown");
+
+    paging_destroy_directory(parent);
+    TEST_ASSERT(g_zone.free_frames == free_start, "All frames are freed after every process exits");
+}
+
+static void test_faults(void) {
+    printf("\nFault accounting:\n");
+    uint32_t free_start = g_zone.free_frames;
+    paging_cow_stats_t before, after;
+    paging_get_cow_stats(&before);
+
+    enum { PAGES = 256 };
+    page_directory_t* parent = make_process(PAGES, 0);
+    page_directory_t* child = paging_clone_directory(parent);
+
+    /* Child touches a quarter of the pages, then exits */
+    for (uint32_t i = 0; i < PAGES; i += 4) {
+        proc_write(child, USER_BASE + i * PAGE_SIZE, i);
+    }
+    paging_destroy_directory(child);
+
+    /* Parent then writes everything */
+    int ok = 1;
+    for (uint32_t i = 0; i < PAGES; i++) {
+        if (proc_write(parent, USER_BASE + i * PAGE_SIZE + 8, ~i) != 0 ||
+            proc_read(parent, USER_BASE + i * PAGE_SIZE) != i) {
+            ok = 0;
+        }
+    }
+    paging_get_cow_stats(&after);
+    TEST_ASSERT(ok, "Parent data intact after child writes and exit");
+    TEST_ASSERT(after.cow_copies - before.cow_copies == PAGES / 4,
+                "Only pages the child wrote were copied");
+    TEST_ASSERT(after.cow_reuses - before.cow_reuses == PAGES,
+                "Parent's faults after the child exits never copy");
+
+    uint64_t faults = g_write_faults;
+    proc_write(parent, USER_BASE, 1);
+    TEST_ASSERT(g_write_faults == faults, "Pages are writable again after the fault");
+
+    paging_destroy_directory(parent);
+    TEST_ASSERT(g_zone.free_frames == free_start, "No frames leak");
+}
+
+/* ---- Benchmarks ---- */
+
+/* fork() the way the previous code would have to: copy every page */
+static page_directory_t* eager_fork(page_directory_t* src, uint32_t pages) {
+    page_directory_t* kernel = paging_get_current_directory();
+    page_directory_t* dir = paging_create_directory();
+    (*dir)[0] = (*kernel)[0];
+    for (uint32_t i = 0; i < pages; i++) {
+        uint32_t va = USER_BASE + i * PAGE_SIZE;
+        uint8_t* copy = vm_alloc(PAGE_SIZE, MEM_USER);
+        uint8_t* orig = (uint8_t*)(uintptr_t)(paging_get_physical_address(src, va) & ~0xFFF);
+        for (uint32_t b = 0; b < PAGE_SIZE; b++) {
+            copy[b] = orig[b];
+        }
+        paging_map_page(dir, va, (uint32_t)(uintptr_t)copy, PAGE_PRESENT | PAGE_WRITE | PAGE_USER);
+    }
+    return dir;
+}
+
+static void run_benchmarks(void) {
+    printf("\nBenchmarks:\n");
+    printf("    %-8s %12s %12s %8s %14s %14s\n", "size", "eager fork", "COW fork",
+           "speedup", "copy fault", "reuse fault");
+
+    static const uint32_t sizes_mb[] = { 16, 64, 256 };
+    for (size_t s = 0; s < sizeof(sizes_mb) / sizeof(sizes_mb[0]); s++) {
+        uint32_t pages = sizes_mb[s] * 256;
+        page_directory_t* parent = make_process(pages, 0);
+
+        page_directory_t* eager = NULL;
+        uint64_t t0 = now_ns();
+        eager = eager_fork(parent, pages);
+        uint64_t eager_ns = now_ns() - t0;
+        paging_destroy_directory(eager);
+
+        t0 = now_ns();
+        page_directory_t* child = paging_clone_directory(parent);
+        uint64_t cow_ns = now_ns() - t0;
+
+        /* Child writes 10% of its pages (copies), exits; parent rewrites them (reuses) */
+        paging_cow_stats_t a, b, c;
+        paging_get_cow_stats(&a);
+        t0 = now_ns();
+        for (uint32_t i = 0; i < pages; i += 10) {
+            proc_write(child, USER_BASE + i * PAGE_SIZE, i);
+        }
+        uint64_t copy_ns = now_ns() - t0;
+        paging_get_cow_stats(&b);
+        paging_destroy_directory(child);
+
+        t0 = now_ns();
+        for (uint32_t i = 0; i < pages; i += 10) {
+            proc_write(parent, USER_BASE + i * PAGE_SIZE, i);
+        }
+        uint64_t reuse_ns = now_ns() - t0;
+        paging_get_cow_stats(&c);
+
+        uint64_t copies = b.cow_copies - a.cow_copies;
+        uint64_t reuses = c.cow_reuses - b.cow_reuses;
+        printf("    %5u MB %10.2f ms %10.2f ms %7.1fx %9.0f ns x%-5llu %6.0f ns x%-5llu\n",
+               sizes_mb[s], eager_ns / 1e6, cow_ns / 1e6, (double)eager_ns / (double)cow_ns,
+               (double)copy_ns / (double)copies, (unsigned long long)copies,
+               (double)reuse_ns / (double)reuses, (unsigned long long)reuses);
+
+        paging_destroy_directory(parent);
+    }
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("Copy-on-Write Fork Tests\n");
+    printf("========================\n");
+
+    /* Frames must sit below 4 GB and on a 4 MB boundary for the zone */
+    size_t phys_bytes = (size_t)PHYS_FRAMES * PAGE_SIZE;
+    size_t span = phys_bytes + HEAP_BYTES + (4u << 20);
+    uint8_t* mem = mmap(NULL, span, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT | MAP_NORESERVE, -1, 0);
+    if (mem == MAP_FAILED) {
+        printf("Cannot map simulated physical memory below 4 GB\n");
+        return 1;
+    }
+    uintptr_t phys_base = ((uintptr_t)mem + (4u << 20) - 1) & ~(uintptr_t)((4u << 20) - 1);
+    uint8_t* heap = (uint8_t*)phys_base + phys_bytes;
+
+    g_meta = malloc(PHYS_FRAMES * sizeof(buddy_frame_t));
+    buddy_init(&g_zone, g_meta, (uint32_t)(phys_base / PAGE_SIZE), PHYS_FRAMES);
+    buddy_add_range(&g_zone, (uint32_t)(phys_base / PAGE_SIZE), PHYS_FRAMES);
+    slab_init(heap, HEAP_BYTES);
+
+    paging_init();
+    g_kernel_dir = paging_get_current_directory();
+
+    test_clone();
+    test_faults();
+
+    if (bench) {
+        run_benchmarks();
+    }
+
+    munmap(mem, span);
+    free(g_meta);
+
+    printf("\nPassed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
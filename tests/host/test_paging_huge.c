@@ -0,0 +1,387 @@
+/**
+ * Aurora OS - Large Page (PSE) Tests
+ *
+ * Host-built harness for the 4 MB page support in kernel/memory/paging.c.
+ * The page-table walker is exercised through paging_get_physical_address()
+ * on huge, split and mixed mappings; page tables come from a slab heap
+ * mapped below 4 GB so the table memory a mapping costs can be measured. With
+ * --bench, runs random accesses over 256 MB through the walker behind a
+ * simulated two-level TLB, and the same access pattern on host memory backed by
+ * small and transparent huge pages as a hardware reference.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "../../kernel/memory/paging.h"
+#include "../../kernel/memory/slab.h"
+#include "../../kernel/process/process.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+#define HEAP_BYTES      (16u * 1024 * 1024)
+#define USER_BASE       0x40000000u
+#define MB              (1024u * 1024)
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* ---- Kernel service stubs: mappings here never own frames ---- */
+
+void* kmalloc(size_t size) { return slab_alloc(size); }
+void kfree(void* ptr) { slab_free(ptr); }
+void* frame_alloc(uint32_t order) { (void)order; return NULL; }
+int frame_free(void* addr) { (void)addr; return -1; }
+uint32_t frame_get(uint32_t phys_addr) { (void)phys_addr; return 0; }
+uint32_t frame_put(uint32_t phys_addr) { (void)phys_addr; return 0; }
+uint32_t frame_refcount(uint32_t phys_addr) { (void)phys_addr; return 0; }
+int frame_exclusive(uint32_t phys_addr) { (void)phys_addr; return 0; }
+void memory_get_frame_stats(buddy_stats_t* stats) { memset(stats, 0, sizeof(*stats)); }
+void* vm_alloc(size_t size, uint32_t flags) { (void)size; (void)flags; return NULL; }
+void vm_free(void* ptr) { (void)ptr; }
+process_t* process_create(void (*entry)(void), uint32_t priority) { (void)entry; (void)priority; return NULL; }
+int process_wait_event_until(volatile uint32_t* event, uint64_t deadline_us) { (void)event; (void)deadline_us; return -1; }
+void process_post_event(process_t* process, volatile uint32_t* event) { (void)process; *event = 1; }
+
+static uint64_t heap_in_use(void) {
+    slab_stats_t st;
+    slab_get_stats(&st);
+    return st.bytes_in_use;
+}
+
+static page_directory_t* new_space(void) {
+    page_directory_t* dir = paging_create_directory();
+    (*dir)[0] = (*paging_get_kernel_directory())[0];
+    return dir;
+}
+
+/* Check v -> p for a spread of offsets across [0, size) */
+static int translates(page_directory_t* dir, uint32_t virt, uint32_t phys, uint32_t size) {
+    for (uint32_t off = 0; off < size; off += 0x3F3F) {
+        if (paging_get_physical_address(dir, virt + off) != phys + off) {
+            return 0;
+        }
+    }
+    return paging_get_physical_address(dir, virt + size - 1) == phys + size - 1;
+}
+
+/* ---- Tests ---- */
+
+static void test_map_huge(void) {
+    printf("\nLarge page mapping:\n");
+    page_directory_t* dir = new_space();
+    uint64_t heap = heap_in_use();
+    paging_huge_stats_t hs;
+
+    TEST_ASSERT(paging_map_huge_page(dir, USER_BASE + PAGE_SIZE, 0x10000000, PAGE_PRESENT) == -1 &&
+                paging_map_huge_page(dir, USER_BASE, 0x10001000, PAGE_PRESENT) == -1,
+                "Unaligned addresses are rejected");
+    TEST_ASSERT(paging_map_huge_page(dir, USER_BASE, 0x10000000, PAGE_PRESENT | PAGE_WRITE | PAGE_USER) == 0,
+                "4 MB page maps");
+    uint32_t pde = (*dir)[USER_BASE >> 22];
+    TEST_ASSERT((pde & PAGE_HUGE) && (pde & HUGE_PAGE_MASK) == 0x10000000, "Directory entry has PS set");
+    TEST_ASSERT(heap_in_use() == heap, "No page table is allocated");
+    TEST_ASSERT(paging_get_physical_address(dir, USER_BASE) == 0x10000000 &&
+                paging_get_physical_address(dir, USER_BASE + 0x123456) == 0x10123456 &&
+                paging_get_physical_address(dir, USER_BASE + 0x3FFFFF) == 0x103FFFFF,
+                "Walker resolves offsets within the large page");
+    TEST_ASSERT(paging_get_physical_address(dir, USER_BASE + HUGE_PAGE_SIZE) == 0,
+                "Next 4 MB stays unmapped");
+    TEST_ASSERT(paging_mark_cow(dir, USER_BASE) == -1 && paging_handle_cow(dir, USER_BASE) == -1,
+                "COW does not apply to large pages");
+
+    TEST_ASSERT(paging_unmap_huge_page(dir, USER_BASE + HUGE_PAGE_SIZE) == -1, "Unmapping a hole fails");
+    TEST_ASSERT(paging_unmap_huge_page(dir, USER_BASE) == 0 &&
+                paging_get_physical_address(dir, USER_BASE + 0x1000) == 0, "4 MB page unmaps");
+
+    /* A table in the way */
+    paging_map_page(dir, USER_BASE, 0x5000, PAGE_PRESENT);
+    TEST_ASSERT(paging_map_huge_page(dir, USER_BASE, 0x10000000, PAGE_PRESENT) == -1,
+                "Large page does not replace live small mappings");
+    paging_unmap_page(dir, USER_BASE);
+    TEST_ASSERT(paging_map_huge_page(dir, USER_BASE, 0x10000000, PAGE_PRESENT) == 0 && heap_in_use() == heap,
+                "Empty page table is freed and replaced");
+
+    paging_get_huge_stats(&hs);
+    TEST_ASSERT(hs.huge_maps == 2 && hs.huge_unmaps == 1, "Map and unmap are counted");
+    paging_destroy_directory(dir);
+}
+
+static void test_split(void) {
+    printf("\nSplitting:\n");
+    page_directory_t* dir = new_space();
+    paging_huge_stats_t before, after;
+    paging_get_huge_stats(&before);
+
+    paging_map_huge_page(dir, USER_BASE, 0x10000000, PAGE_PRESENT | PAGE_WRITE | PAGE_USER);
+    uint32_t hole = USER_BASE + 77 * PAGE_SIZE;
+    TEST_ASSERT(paging_unmap_page(dir, hole) == 0, "Partial unmap succeeds");
+    paging_get_huge_stats(&after);
+    uint32_t pde = (*dir)[USER_BASE >> 22];
+    TEST_ASSERT(!(pde & PAGE_HUGE) && after.splits == before.splits + 1, "Large page was split into a table");
+    TEST_ASSERT(paging_get_physical_address(dir, hole) == 0, "Unmapped page is gone");
+    TEST_ASSERT(translates(dir, USER_BASE, 0x10000000, 77 * PAGE_SIZE) &&
+                translates(dir, hole + PAGE_SIZE, 0x10000000 + 78 * PAGE_SIZE, HUGE_PAGE_SIZE - 78 * PAGE_SIZE),
+                "The other 1023 pages still map the same memory");
+
+    page_table_t* table = (page_table_t*)(uintptr_t)(pde & ~0xFFF);
+    uint32_t pte = (*table)[5];
+    TEST_ASSERT((pte & (PAGE_PRESENT | PAGE_WRITE | PAGE_USER)) == (PAGE_PRESENT | PAGE_WRITE | PAGE_USER) &&
+                !(pte & PAGE_HUGE), "Split entries keep the permissions and drop PS");
+
+    /* Mapping a small page inside a large one also splits */
+    uint32_t va2 = USER_BASE + HUGE_PAGE_SIZE + 9 * PAGE_SIZE;
+    paging_map_huge_page(dir, USER_BASE + HUGE_PAGE_SIZE, 0x20000000, PAGE_PRESENT | PAGE_WRITE);
+    TEST_ASSERT(paging_map_page(dir, va2, 0x7000, PAGE_PRESENT) == 0 &&
+                paging_get_physical_address(dir, va2 + 12) == 0x700C &&
+                paging_get_physical_address(dir, va2 + PAGE_SIZE) == 0x20000000 + 10 * PAGE_SIZE,
+                "Remapping one page inside a large page splits it");
+
+    paging_destroy_directory(dir);
+}
+
+static void test_range(void) {
+    printf("\nRange mapping:\n");
+    page_directory_t* dir = new_space();
+    paging_huge_stats_t before, after;
+
+    /* 8 MB + 8 KB starting one page below a 4 MB boundary */
+    uint32_t virt = 0x4FFFF000;
+    uint32_t phys = 0x20FFF000;
+    uint32_t size = 8 * MB + 2 * PAGE_SIZE;
+    paging_get_huge_stats(&before);
+    TEST_ASSERT(paging_map_range(dir, virt, phys, size, PAGE_PRESENT | PAGE_WRITE) == 0, "Range maps");
+    paging_get_huge_stats(&after);
+    TEST_ASSERT(after.huge_maps - before.huge_maps == 2, "Aligned middle uses two large pages");
+    TEST_ASSERT(!((*dir)[virt >> 22] & PAGE_HUGE) && ((*dir)[0x50000000 >> 22] & PAGE_HUGE) &&
+                ((*dir)[0x50400000 >> 22] & PAGE_HUGE) && !((*dir)[0x50800000 >> 22] & PAGE_HUGE),
+                "Unaligned head and tail use small pages");
+    TEST_ASSERT(translates(dir, virt, phys, size), "Walker resolves the whole range");
+    TEST_ASSERT(paging_get_physical_address(dir, virt + size) == 0 &&
+                paging_get_physical_address(dir, virt - 1) == 0, "Nothing outside the range is mapped");
+
+    TEST_ASSERT(paging_unmap_range(dir, virt, size) == 0, "Range unmaps");
+    int empty = 1;
+    for (uint32_t off = 0; off < size; off += PAGE_SIZE) {
+        if (paging_get_physical_address(dir, virt + off)) {
+            empty = 0;
+        }
+    }
+    paging_get_huge_stats(&after);
+    TEST_ASSERT(empty && after.splits == before.splits, "Unmapping whole large pages needs no split");
+
+    /* Physical and virtual addresses disagree mod 4 MB: no large pages */
+    paging_get_huge_stats(&before);
+    paging_map_range(dir, 0x60000000, 0x30001000, 8 * MB, PAGE_PRESENT);
+    paging_get_huge_stats(&after);
+    TEST_ASSERT(after.huge_maps == before.huge_maps && translates(dir, 0x60000000, 0x30001000, 8 * MB),
+                "Misaligned physical range falls back to small pages");
+
+    paging_destroy_directory(dir);
+}
+
+static void test_table_cost(void) {
+    printf("\nPage table cost:\n");
+    page_directory_t* dir = new_space();
+    uint64_t heap = heap_in_use();
+
+    uint32_t size = 256 * MB;
+    for (uint32_t off = 0; off < size; off += PAGE_SIZE) {
+        paging_map_page(dir, USER_BASE + off, 0x10000000 + off, PAGE_PRESENT | PAGE_WRITE);
+    }
+    uint64_t small_cost = heap_in_use() - heap;
+    paging_destroy_directory(dir);
+
+    dir = new_space();
+    heap = heap_in_use();
+    paging_map_range(dir, USER_BASE, 0x10000000, size, PAGE_PRESENT | PAGE_WRITE);
+    uint64_t huge_cost = heap_in_use() - heap;
+    TEST_ASSERT(small_cost >= 64 * sizeof(page_table_t) && huge_cost == 0,
+                "256 MB costs 64 page tables with small pages and none with large ones");
+    printf("    256 MB: %llu KB of page tables vs %llu KB\n",
+           (unsigned long long)small_cost / 1024, (unsigned long long)huge_cost / 1024);
+
+    /* Fork shares large pages; teardown frees no tables */
+    page_directory_t* child = paging_clone_directory(dir);
+    TEST_ASSERT((*child)[USER_BASE >> 22] == (*dir)[USER_BASE >> 22] && translates(child, USER_BASE, 0x10000000, size),
+                "Clone shares large page entries");
+    paging_destroy_directory(child);
+    TEST_ASSERT(translates(dir, USER_BASE, 0x10000000, size), "Parent mapping survives child teardown");
+    paging_destroy_directory(dir);
+}
+
+/* ---- Benchmarks ---- */
+
+/*
+ * Simulated two-level TLB, sized like a recent x86 core: L1 with 64 x 4 KB
+ * and 32 x 4 MB entries, and a shared 1536-entry second level. Misses in
+ * both levels walk the page tables through paging_get_physical_address().
+ */
+#define TLB_WAYS 4
+
+typedef struct {
+    uint32_t sets;
+    uint32_t tag[512][TLB_WAYS];    /* Page number << 1 | large */
+    uint8_t next[512];
+} tlb_t;
+
+static void tlb_init(tlb_t* tlb, uint32_t entries) {
+    memset(tlb, 0xFF, sizeof(tlb->tag));
+    memset(tlb->next, 0, sizeof(tlb->next));
+    tlb->sets = entries / TLB_WAYS;
+}
+
+static int tlb_lookup(tlb_t* tlb, uint32_t tag) {
+    uint32_t set = (tag >> 1) % tlb->sets;
+    for (uint32_t w = 0; w < TLB_WAYS; w++) {
+        if (tlb->tag[set][w] == tag) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void tlb_fill(tlb_t* tlb, uint32_t tag) {
+    uint32_t set = (tag >> 1) % tlb->sets;
+    tlb->tag[set][tlb->next[set]++ % TLB_WAYS] = tag;
+}
+
+static tlb_t l1_small, l1_huge, stlb;
+static uint64_t g_walks;
+static uint64_t g_walk_refs;        /* Page table entries read by walks */
+
+static uint32_t tlb_translate(page_directory_t* dir, uint32_t va) {
+    uint32_t small_tag = (va >> 12) << 1;
+    uint32_t huge_tag = ((va >> 22) << 1) | 1;
+
+    if (tlb_lookup(&l1_huge, huge_tag) || tlb_lookup(&l1_small, small_tag)) {
+        return va;
+    }
+
+    int large = ((*dir)[va >> 22] & PAGE_HUGE) != 0;
+    uint32_t tag = large ? huge_tag : small_tag;
+    if (!tlb_lookup(&stlb, tag)) {
+        g_walks++;
+        g_walk_refs += large ? 1 : 2;
+        va = paging_get_physical_address(dir, va);
+        tlb_fill(&stlb, tag);
+    }
+    tlb_fill(large ? &l1_huge : &l1_small, tag);
+    return va;
+}
+
+static void bench_walker(void) {
+    enum { ACCESSES = 4000000 };
+    uint32_t size = 256 * MB;
+
+    printf("    Simulated TLB (L1 64 x 4 KB + 32 x 4 MB, L2 1536), %u random accesses over 256 MB:\n",
+           ACCESSES);
+    for (int huge = 0; huge < 2; huge++) {
+        page_directory_t* dir = new_space();
+        if (huge) {
+            paging_map_range(dir, USER_BASE, 0x10000000, size, PAGE_PRESENT | PAGE_WRITE);
+        } else {
+            for (uint32_t off = 0; off < size; off += PAGE_SIZE) {
+                paging_map_page(dir, USER_BASE + off, 0x10000000 + off, PAGE_PRESENT | PAGE_WRITE);
+            }
+        }
+        tlb_init(&l1_small, 64);
+        tlb_init(&l1_huge, 32);
+        tlb_init(&stlb, 1536);
+        g_walks = 0;
+        g_walk_refs = 0;
+
+        uint32_t seed = 7;
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < ACCESSES; i++) {
+            seed = seed * 1103515245u + 12345u;
+            sum += tlb_translate(dir, USER_BASE + (seed % size));
+        }
+        printf("      %s pages: %6.2f%% of accesses walk, %.3f table reads/access (checksum %llx)\n",
+               huge ? "4 MB" : "4 KB", 100.0 * (double)g_walks / ACCESSES,
+               (double)g_walk_refs / ACCESSES, (unsigned long long)(sum & 0xFFFF));
+        paging_destroy_directory(dir);
+    }
+}
+
+static void bench_host(void) {
+    enum { ACCESSES = 20000000 };
+    size_t size = 256u * MB;
+
+    printf("    Host memory, %u random 8-byte reads over 256 MB:\n", ACCESSES);
+    for (int huge = 0; huge < 2; huge++) {
+        uint8_t* raw = mmap(NULL, size + 2 * MB, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            printf("      (cannot map 256 MB)\n");
+            return;
+        }
+        uint64_t* mem = (uint64_t*)(((uintptr_t)raw + 2 * MB - 1) & ~(uintptr_t)(2 * MB - 1));
+        madvise(mem, size, huge ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+        for (size_t i = 0; i < size / 8; i += 512) {
+            mem[i] = i;
+        }
+
+        uint32_t seed = 7;
+        uint64_t sum = 0;
+        uint64_t t0 = now_ns();
+        for (uint32_t i = 0; i < ACCESSES; i++) {
+            seed = seed * 1103515245u + 12345u;
+            sum += mem[(seed >> 2) % (size / 8)];
+        }
+        uint64_t ns = now_ns() - t0;
+        printf("      %s: %5.1f ns/access (checksum %llx)\n",
+               huge ? "transparent huge pages" : "4 KB pages            ", (double)ns / ACCESSES,
+               (unsigned long long)(sum & 0xFFFF));
+        munmap(raw, size + 2 * MB);
+    }
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("Large Page Tests\n");
+    printf("================\n");
+
+    /* Page tables must sit below 4 GB to fit directory entries */
+    void* heap = mmap(NULL, HEAP_BYTES, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (heap == MAP_FAILED) {
+        printf("Cannot map the heap below 4 GB\n");
+        return 1;
+    }
+    slab_init(heap, HEAP_BYTES);
+    paging_init();
+
+    test_map_huge();
+    test_split();
+    test_range();
+    test_table_cost();
+
+    if (bench) {
+        printf("\nBenchmarks:\n");
+        bench_walker();
+        bench_host();
+    }
+
+    munmap(heap, HEAP_BYTES);
+
+    printf("\nPassed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
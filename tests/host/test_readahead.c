@@ -0,0 +1,467 @@
+/**
+ * Aurora OS - Readahead Tests
+ *
+ * Host-built harness for page cache readahead (filesystem/cache/
+ * page_cache.c) driven through the VFS on a simulated block device that
+ * logs every request and charges a per-request latency plus a per-page
+ * transfer time. Checks that sequential streams ramp the window from
+ * 16 KB to the limit without reading a page twice or past end of file,
+ * that marked pages start the next window early, that random and
+ * strided access collapse the window, that each open file keeps its
+ * own stream and that a failed batch falls back to single pages. With
+ * --bench, reports MB/s with readahead on and off for sequential,
+ * strided and random 4 KB reads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include "../../filesystem/cache/page_cache.h"
+#include "../../filesystem/vfs/vfs.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/* ---- Kernel service stubs ---- */
+
+void* kmalloc(size_t size) {
+    return malloc(size);
+}
+
+void kfree(void* ptr) {
+    free(ptr);
+}
+
+uint32_t smp_get_current_cpu_id(void) {
+    return 0;
+}
+
+void cpu_relax(void) {
+    sched_yield();
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* ---- Simulated block device ---- */
+
+#define LOG_MAX 8192
+
+typedef struct {
+    uint32_t ino;
+    uint32_t index;
+    uint32_t count;
+} dev_request_t;
+
+static dev_request_t dev_log[LOG_MAX];
+static uint32_t dev_requests;
+static uint64_t dev_request_ns;         /* Charged once per request */
+static uint64_t dev_page_ns;            /* Charged per page transferred */
+static uint32_t dev_fail_page = 0xFFFFFFFF;
+
+static uint8_t file_byte(uint32_t ino, uint32_t offset) {
+    return (uint8_t)((offset * 7 + ino * 13) ^ (offset >> 12));
+}
+
+static void dev_wait(uint32_t pages) {
+    uint64_t cost = dev_request_ns + dev_page_ns * pages;
+    if (cost == 0) {
+        return;
+    }
+    uint64_t deadline = now_ns() + cost;
+    while (now_ns() < deadline) {
+    }
+}
+
+static int dev_read(inode_t* inode, uint32_t index, uint32_t count, void** pages) {
+    if (dev_requests < LOG_MAX) {
+        dev_log[dev_requests].ino = inode->ino;
+        dev_log[dev_requests].index = index;
+        dev_log[dev_requests].count = count;
+    }
+    dev_requests++;
+    dev_wait(count);
+
+    if (dev_fail_page >= index && dev_fail_page < index + count) {
+        return -1;
+    }
+
+    for (uint32_t p = 0; p < count; p++) {
+        uint8_t* data = pages[p];
+        uint32_t base = (index + p) * PAGE_CACHE_SIZE;
+        for (uint32_t i = 0; i < PAGE_CACHE_SIZE; i++) {
+            data[i] = base + i < inode->size ? file_byte(inode->ino, base + i) : 0;
+        }
+    }
+    return 0;
+}
+
+static int blk_readpage(inode_t* inode, uint32_t index, void* page) {
+    return dev_read(inode, index, 1, &page);
+}
+
+static int blk_readpages(inode_t* inode, uint32_t index, uint32_t count, void** pages) {
+    return dev_read(inode, index, count, pages);
+}
+
+static file_ops_t blk_file_ops = {
+    .readpage = blk_readpage,
+    .readpages = blk_readpages
+};
+
+/* ---- Filesystem of fixed files on the device ---- */
+
+#define BLK_FILES 4
+
+static const char* blk_names[BLK_FILES] = { "/seq", "/tail", "/big", "/other" };
+static const uint32_t blk_sizes[BLK_FILES] = {
+    1024 * 1024, 10000, 8 * 1024 * 1024, 256 * 1024
+};
+static inode_t blk_inodes[BLK_FILES];
+
+static int blk_mount(const char* device) {
+    (void)device;
+    for (uint32_t i = 0; i < BLK_FILES; i++) {
+        memset(&blk_inodes[i], 0, sizeof(inode_t));
+        blk_inodes[i].ino = i + 1;
+        blk_inodes[i].type = FILE_TYPE_REGULAR;
+        blk_inodes[i].size = blk_sizes[i];
+        blk_inodes[i].mode = DEFAULT_FILE_MODE;
+        blk_inodes[i].fops = &blk_file_ops;
+        page_cache_mapping_init(&blk_inodes[i].mapping, &blk_inodes[i]);
+    }
+    return 0;
+}
+
+static inode_t* blk_lookup(const char* path) {
+    for (uint32_t i = 0; i < BLK_FILES; i++) {
+        if (strcmp(blk_names[i], path) == 0) {
+            return &blk_inodes[i];
+        }
+    }
+    return NULL;
+}
+
+static fs_ops_t blk_ops = {
+    .mount = blk_mount,
+    .lookup = blk_lookup
+};
+
+static void setup(void) {
+    vfs_init();
+    vfs_register_fs("blkfs", &blk_ops);
+    vfs_mount("sim0", "/", "blkfs");
+    page_cache_set_readahead(PAGE_CACHE_RA_DEFAULT_MAX);
+}
+
+/* Forget cached pages and the request log */
+static void cold(void) {
+    page_cache_shrink(UINT32_MAX);
+    dev_requests = 0;
+}
+
+static int data_ok(uint32_t ino, const uint8_t* buf, uint32_t offset, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        if (buf[i] != file_byte(ino, offset + i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int read_at(int fd, void* buf, size_t size, long offset) {
+    vfs_seek(fd, offset, SEEK_SET);
+    return vfs_read(fd, buf, size);
+}
+
+static uint32_t pages_requested(void) {
+    uint32_t pages = 0;
+    for (uint32_t i = 0; i < dev_requests && i < LOG_MAX; i++) {
+        pages += dev_log[i].count;
+    }
+    return pages;
+}
+
+/* ---- Sequential streams ---- */
+
+static void test_sequential(void) {
+    printf("\nSequential reads:\n");
+
+    setup();
+    cold();
+
+    static uint8_t buf[64 * 1024];
+    int fd = vfs_open("/seq", O_RDONLY);
+    int ok = 1;
+    for (uint32_t off = 0; off < blk_sizes[0]; off += 4096) {
+        if (vfs_read(fd, buf, 4096) != 4096 || !data_ok(1, buf, off, 4096)) {
+            ok = 0;
+        }
+    }
+    TEST_ASSERT(ok, "1 MB read in 4 KB pieces returns the right data");
+    TEST_ASSERT(vfs_read(fd, buf, 4096) == 0, "Read at end of file returns 0");
+
+    TEST_ASSERT(dev_log[0].index == 0 && dev_log[0].count == PAGE_CACHE_RA_INIT_PAGES,
+                "First window is 16 KB");
+
+    int ramps = 1;
+    uint32_t largest = 0;
+    for (uint32_t i = 1; i < dev_requests; i++) {
+        if (dev_log[i].count < dev_log[i - 1].count && dev_log[i].index + dev_log[i].count < 256) {
+            ramps = 0;
+        }
+        if (dev_log[i].count > largest) {
+            largest = dev_log[i].count;
+        }
+    }
+    TEST_ASSERT(ramps, "Window grows steadily");
+    TEST_ASSERT(largest == PAGE_CACHE_RA_DEFAULT_MAX, "Window reaches the 128 KB limit and stays there");
+
+    static uint8_t seen[256];
+    memset(seen, 0, sizeof(seen));
+    int once = 1;
+    for (uint32_t i = 0; i < dev_requests; i++) {
+        for (uint32_t p = dev_log[i].index; p < dev_log[i].index + dev_log[i].count; p++) {
+            if (p >= 256 || seen[p]++) {
+                once = 0;
+            }
+        }
+    }
+    TEST_ASSERT(once, "Every page read exactly once, none past end of file");
+    TEST_ASSERT(dev_requests <= 256 / PAGE_CACHE_RA_DEFAULT_MAX + 4, "256 pages took a handful of requests");
+
+    page_cache_stats_t st;
+    page_cache_get_stats(&st);
+    TEST_ASSERT(st.ra_async >= 256 / PAGE_CACHE_RA_DEFAULT_MAX - 1, "Marked pages started windows ahead of the reader");
+    TEST_ASSERT(st.ra_pages >= 240, "Nearly every page arrived by readahead");
+    vfs_close(fd);
+
+    /* One large read */
+    cold();
+    fd = vfs_open("/seq", O_RDONLY);
+    TEST_ASSERT(vfs_read(fd, buf, sizeof(buf)) == (int)sizeof(buf) && data_ok(1, buf, 0, sizeof(buf)),
+                "64 KB read returns the right data");
+    TEST_ASSERT(dev_log[0].count >= 16, "A large read is fetched as one batch");
+    vfs_close(fd);
+
+    /* File end inside a page */
+    cold();
+    fd = vfs_open("/tail", O_RDONLY);
+    int got = 0, n;
+    while ((n = vfs_read(fd, buf, 3000)) > 0) {
+        got += n;
+    }
+    TEST_ASSERT(got == 10000, "Short file reads to its exact size");
+    TEST_ASSERT(pages_requested() == 3 && dev_log[0].count == 3, "Window clipped at end of file");
+    vfs_close(fd);
+
+    /* Readahead off */
+    cold();
+    page_cache_set_readahead(0);
+    fd = vfs_open("/seq", O_RDONLY);
+    for (int i = 0; i < 32; i++) {
+        vfs_read(fd, buf, 4096);
+    }
+    int singles = dev_requests == 32;
+    for (uint32_t i = 0; i < dev_requests; i++) {
+        if (dev_log[i].count != 1) {
+            singles = 0;
+        }
+    }
+    TEST_ASSERT(singles, "With readahead off every page is its own request");
+    vfs_close(fd);
+    page_cache_set_readahead(PAGE_CACHE_RA_DEFAULT_MAX);
+}
+
+/* ---- Random and strided access ---- */
+
+static void test_random(void) {
+    printf("\nRandom and strided reads:\n");
+
+    setup();
+    cold();
+
+    static uint8_t buf[8192];
+    page_cache_stats_t before, after;
+    page_cache_get_stats(&before);
+
+    int fd = vfs_open("/big", O_RDONLY);
+    int ok = 1;
+    read_at(fd, buf, 1, 4096 * 1000);           /* Start away from page 0 */
+    cold();
+    for (int i = 0; i < 200; i++) {
+        uint32_t page = (uint32_t)(rng() % 2048);
+        if (read_at(fd, buf, 4096, (long)page * 4096) != 4096 || !data_ok(3, buf, page * 4096, 4096)) {
+            ok = 0;
+        }
+    }
+    TEST_ASSERT(ok, "Random reads return the right data");
+
+    int singles = 1;
+    for (uint32_t i = 0; i < dev_requests; i++) {
+        if (dev_log[i].count != 1) {
+            singles = 0;
+        }
+    }
+    TEST_ASSERT(singles, "Random reads never read ahead");
+    page_cache_get_stats(&after);
+    TEST_ASSERT(after.ra_pages == before.ra_pages, "No readahead pages accounted");
+    vfs_close(fd);
+
+    /* 4 KB out of every 16 KB */
+    cold();
+    fd = vfs_open("/big", O_RDONLY);
+    ok = 1;
+    for (uint32_t page = 0; page < 1024; page += 4) {
+        if (read_at(fd, buf, 4096, (long)page * 4096) != 4096 || !data_ok(3, buf, page * 4096, 4096)) {
+            ok = 0;
+        }
+    }
+    TEST_ASSERT(ok, "Strided reads return the right data");
+    TEST_ASSERT(pages_requested() <= 256 + PAGE_CACHE_RA_INIT_PAGES, "Strided reads waste at most the first window");
+    vfs_close(fd);
+
+    /* A sequential run after random access ramps up again */
+    cold();
+    fd = vfs_open("/big", O_RDONLY);
+    for (int i = 0; i < 20; i++) {
+        read_at(fd, buf, 4096, (long)(rng() % 2048) * 4096);
+    }
+    uint32_t random_requests = dev_requests;
+    vfs_seek(fd, 500 * 4096, SEEK_SET);
+    for (int i = 0; i < 128; i++) {
+        vfs_read(fd, buf, 4096);
+    }
+    uint32_t largest = 0;
+    for (uint32_t i = random_requests; i < dev_requests; i++) {
+        if (dev_log[i].count > largest) {
+            largest = dev_log[i].count;
+        }
+    }
+    TEST_ASSERT(largest == PAGE_CACHE_RA_DEFAULT_MAX, "Sequential run after random access ramps up again");
+    vfs_close(fd);
+
+    /* Two open files streaming different parts of one file */
+    cold();
+    int a = vfs_open("/big", O_RDONLY);
+    int b = vfs_open("/big", O_RDONLY);
+    vfs_seek(b, 4 * 1024 * 1024, SEEK_SET);
+    static uint8_t buf_b[4096];
+    ok = 1;
+    for (uint32_t i = 0; i < 256; i++) {
+        if (vfs_read(a, buf, 4096) != 4096 || !data_ok(3, buf, i * 4096, 4096) ||
+            vfs_read(b, buf_b, 4096) != 4096 || !data_ok(3, buf_b, 4 * 1024 * 1024 + i * 4096, 4096)) {
+            ok = 0;
+        }
+    }
+    TEST_ASSERT(ok, "Interleaved streams on two descriptors read the right data");
+    TEST_ASSERT(dev_requests <= 2 * (256 / PAGE_CACHE_RA_DEFAULT_MAX + 5), "Each descriptor keeps its own window");
+    vfs_close(a);
+    vfs_close(b);
+
+    /* A window that fails falls back to single pages */
+    cold();
+    dev_fail_page = 10;
+    fd = vfs_open("/other", O_RDONLY);
+    ok = 1;
+    for (uint32_t page = 0; page < 10; page++) {
+        if (vfs_read(fd, buf, 4096) != 4096 || !data_ok(4, buf, page * 4096, 4096)) {
+            ok = 0;
+        }
+    }
+    TEST_ASSERT(ok, "Pages before a bad block still read");
+    TEST_ASSERT(vfs_read(fd, buf, 4096) == -1, "The bad page reports an error");
+    TEST_ASSERT(read_at(fd, buf, 4096, 11 * 4096) == 4096 && data_ok(4, buf, 11 * 4096, 4096),
+                "Pages after it still read");
+    dev_fail_page = 0xFFFFFFFF;
+    vfs_close(fd);
+}
+
+/* ---- Benchmark ---- */
+
+typedef enum { PATTERN_SEQUENTIAL, PATTERN_STRIDED, PATTERN_RANDOM } pattern_t;
+
+static double bench_pattern(pattern_t pattern, uint32_t ra_pages) {
+    static uint8_t buf[4096];
+    const uint32_t file_pages = blk_sizes[2] / 4096;
+    uint32_t reads = pattern == PATTERN_STRIDED ? file_pages / 4 :
+                     pattern == PATTERN_RANDOM ? file_pages / 4 : file_pages;
+
+    page_cache_set_readahead(ra_pages);
+    cold();
+    int fd = vfs_open("/big", O_RDONLY);
+
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < reads; i++) {
+        uint32_t page = pattern == PATTERN_SEQUENTIAL ? i :
+                        pattern == PATTERN_STRIDED ? i * 4 : (uint32_t)(rng() % file_pages);
+        read_at(fd, buf, 4096, (long)page * 4096);
+    }
+    uint64_t elapsed = now_ns() - start;
+    vfs_close(fd);
+
+    return (double)reads * 4096 / (1024.0 * 1024.0) / ((double)elapsed / 1e9);
+}
+
+static void run_bench(void) {
+    printf("\nBenchmark (8 MB file, 4 KB reads, %llu us per request + %llu us per page):\n",
+           (unsigned long long)(dev_request_ns / 1000), (unsigned long long)(dev_page_ns / 1000));
+
+    setup();
+    page_cache_set_limit(4096);
+
+    static const char* names[] = { "sequential", "strided 4K/16K", "random" };
+    for (int p = 0; p < 3; p++) {
+        double off = bench_pattern((pattern_t)p, 0);
+        double on = bench_pattern((pattern_t)p, PAGE_CACHE_RA_DEFAULT_MAX);
+        double on_max = bench_pattern((pattern_t)p, PAGE_CACHE_RA_MAX_PAGES);
+        printf("  %-15s off %7.1f MB/s   128 KB %7.1f MB/s   256 KB %7.1f MB/s\n",
+               names[p], off, on, on_max);
+    }
+
+    page_cache_set_readahead(PAGE_CACHE_RA_DEFAULT_MAX);
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("Aurora OS Readahead Tests\n");
+
+    test_sequential();
+    test_random();
+
+    if (bench) {
+        /* A device with a 100 us request cost and 1 GB/s transfer */
+        dev_request_ns = 100000;
+        dev_page_ns = 4000;
+        run_bench();
+    }
+
+    printf("\nPassed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
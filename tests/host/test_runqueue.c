@@ -0,0 +1,1184 @@
+/**
+ * Aurora OS - Per-CPU Runqueue Tests
+ *
+ * Host-built harness for kernel/process/runqueue.c and the red-black
+ * tree under it. The first sections drive the API directly: tree
+ * invariants under random insert/erase, the nice-to-weight mapping,
+ * vruntime ordering and accounting, new-process debit, sleeper credit,
+ * tick and wakeup preemption, CPU selection, stealing and wakeup IPIs.
+ * The rest run a discrete-event simulation of N CPUs with a 1 ms tick
+ * scheduling synthetic tasks (CPU hogs and interactive tasks that run a
+ * short burst and sleep) through the runqueues, with IPIs delivered as
+ * events, and check CPU share ratios across weights, fairness,
+ * balancing and wakeup-to-run latency. With --bench, reports simulated
+ * throughput and latency from 1 to 16 CPUs, the effect of IPIs,
+ * stealing and wakeup granularity, and host time per runqueue operation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../kernel/process/runqueue.h"
+#include "../../kernel/smp/smp.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+#define MS 1000000ull
+#define US 1000ull
+
+/* ---- Kernel service stubs ---- */
+
+static uint32_t g_ncpus = 1;
+static uint32_t g_cur_cpu = 0;
+static uint32_t g_ipi_count = 0;
+static uint32_t g_ipi_cpu = 0;
+static uint32_t g_ipi_vector = 0;
+static void (*g_ipi_hook)(uint32_t cpu) = NULL;
+
+uint32_t smp_get_cpu_count(void) {
+    return g_ncpus;
+}
+
+uint32_t smp_get_current_cpu_id(void) {
+    return g_cur_cpu;
+}
+
+void spinlock_init(spinlock_t* lock) {
+    lock->val = 0;
+}
+
+void spinlock_acquire(spinlock_t* lock) {
+    lock->tickets.next++;
+}
+
+void spinlock_release(spinlock_t* lock) {
+    lock->tickets.owner++;
+}
+
+irqflags_t spinlock_acquire_irqsave(spinlock_t* lock) {
+    spinlock_acquire(lock);
+    return 0;
+}
+
+void spinlock_release_irqrestore(spinlock_t* lock, irqflags_t flags) {
+    (void)flags;
+    spinlock_release(lock);
+}
+
+void apic_send_ipi(uint32_t dest_cpu, uint32_t vector) {
+    g_ipi_count++;
+    g_ipi_cpu = dest_cpu;
+    g_ipi_vector = vector;
+    if (g_ipi_hook) {
+        g_ipi_hook(dest_cpu);
+    }
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t rnd(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static void reset_rq(uint32_t ncpus) {
+    g_ncpus = ncpus;
+    g_cur_cpu = 0;
+    g_ipi_count = 0;
+    g_ipi_hook = NULL;
+    runqueue_init();
+    runqueue_set_stealing(1);
+    runqueue_tunables_t t = { RQ_SCHED_LATENCY_NS, RQ_MIN_GRANULARITY_NS, RQ_WAKEUP_GRANULARITY_NS };
+    runqueue_set_tunables(&t);
+}
+
+static process_t procs[64];
+
+static uint32_t prio_for_nice(int nice) {
+    return (uint32_t)(RQ_PRIORITY_NICE_0 - nice);
+}
+
+static process_t* mkproc(uint32_t i, int nice, uint32_t cpu) {
+    memset(&procs[i], 0, sizeof(procs[i]));
+    procs[i].pid = i + 1;
+    procs[i].priority = prio_for_nice(nice);
+    procs[i].weight = runqueue_nice_to_weight(nice);
+    procs[i].cpu = cpu;
+    rb_clear_node(&procs[i].run_node);
+    return &procs[i];
+}
+
+/* Queue a process with a chosen vruntime on a CPU */
+static void queue_at(process_t* p, uint32_t cpu, uint64_t vruntime) {
+    p->vruntime = vruntime;
+    g_cur_cpu = cpu;
+    runqueue_put_prev(p, 0);
+    g_cur_cpu = 0;
+}
+
+/* ---- Red-black tree ---- */
+
+typedef struct {
+    uint32_t key;
+    rb_node_t node;
+} item_t;
+
+static int rb_check(const rb_node_t* n, const rb_node_t* parent, int* bad) {
+    if (!n) {
+        return 1;
+    }
+    if (n->parent != parent) {
+        *bad = 1;
+    }
+    if (n->red && (n->left && n->left->red)) {
+        *bad = 1;
+    }
+    if (n->red && (n->right && n->right->red)) {
+        *bad = 1;
+    }
+    if (n->left && rb_entry(n->left, item_t, node)->key > rb_entry(n, item_t, node)->key) {
+        *bad = 1;
+    }
+    if (n->right && rb_entry(n->right, item_t, node)->key < rb_entry(n, item_t, node)->key) {
+        *bad = 1;
+    }
+    int lh = rb_check(n->left, n, bad);
+    int rh = rb_check(n->right, n, bad);
+    if (lh != rh) {
+        *bad = 1;
+    }
+    return lh + (n->red ? 0 : 1);
+}
+
+static void item_insert(rb_root_t* root, item_t* it) {
+    rb_node_t** link = &root->node;
+    rb_node_t* parent = NULL;
+    int leftmost = 1;
+    while (*link) {
+        parent = *link;
+        if (it->key < rb_entry(parent, item_t, node)->key) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = 0;
+        }
+    }
+    rb_insert(root, &it->node, parent, link, leftmost);
+}
+
+static void test_rbtree(void) {
+    printf("\nRed-black tree:\n");
+    enum { N = 4096 };
+    static item_t items[N];
+    rb_root_t root;
+    rb_init(&root);
+    for (int i = 0; i < N; i++) {
+        rb_clear_node(&items[i].node);
+    }
+
+    uint64_t seed = 7;
+    int bad = 0, order_ok = 1, leftmost_ok = 1, count_ok = 1;
+    uint32_t linked = 0;
+    for (int op = 0; op < 200000; op++) {
+        item_t* it = &items[rnd(&seed) % N];
+        if (rb_node_linked(&it->node)) {
+            rb_erase(&root, &it->node);
+            linked--;
+        } else {
+            it->key = (uint32_t)(rnd(&seed) % 1000);
+            item_insert(&root, it);
+            linked++;
+        }
+
+        if (op % 5000 == 0 || op == 199999) {
+            if (root.node && root.node->red) {
+                bad = 1;
+            }
+            rb_check(root.node, NULL, &bad);
+            uint32_t seen = 0, prev = 0;
+            for (rb_node_t* n = rb_first(&root); n; n = rb_next(n)) {
+                uint32_t k = rb_entry(n, item_t, node)->key;
+                if (seen && k < prev) {
+                    order_ok = 0;
+                }
+                prev = k;
+                seen++;
+            }
+            if (seen != linked) {
+                count_ok = 0;
+            }
+            rb_node_t* min = root.node;
+            while (min && min->left) {
+                min = min->left;
+            }
+            if (min != rb_first(&root)) {
+                leftmost_ok = 0;
+            }
+        }
+    }
+    TEST_ASSERT(!bad, "Red-black invariants hold under random insert/erase");
+    TEST_ASSERT(order_ok && count_ok, "In-order walk is sorted and complete");
+    TEST_ASSERT(leftmost_ok, "Cached leftmost is the minimum");
+
+    uint32_t back = 0, prev = UINT32_MAX;
+    int rev_ok = 1;
+    for (rb_node_t* n = rb_last(&root); n; n = rb_prev(n)) {
+        uint32_t k = rb_entry(n, item_t, node)->key;
+        if (k > prev) {
+            rev_ok = 0;
+        }
+        prev = k;
+        back++;
+    }
+    TEST_ASSERT(rev_ok && back == linked, "Reverse walk from the last node");
+
+    /* Equal keys keep insertion order */
+    rb_init(&root);
+    for (int i = 0; i < 8; i++) {
+        items[i].key = 5;
+        item_insert(&root, &items[i]);
+    }
+    int fifo = 1, i = 0;
+    for (rb_node_t* n = rb_first(&root); n; n = rb_next(n), i++) {
+        if (rb_entry(n, item_t, node) != &items[i]) {
+            fifo = 0;
+        }
+    }
+    TEST_ASSERT(fifo, "Equal keys iterate in insertion order");
+}
+
+/* ---- API tests ---- */
+
+static void test_weights(void) {
+    printf("\nNice levels and weights:\n");
+    TEST_ASSERT(runqueue_nice_to_weight(0) == RQ_NICE_0_WEIGHT, "Nice 0 has weight 1024");
+    TEST_ASSERT(runqueue_nice_to_weight(-20) == 88761 && runqueue_nice_to_weight(19) == 15,
+                "Table ends match");
+    TEST_ASSERT(runqueue_nice_to_weight(-99) == 88761 && runqueue_nice_to_weight(99) == 15,
+                "Out-of-range nice clamps");
+
+    int ratio_ok = 1;
+    for (int n = -20; n < 19; n++) {
+        double r = (double)runqueue_nice_to_weight(n) / runqueue_nice_to_weight(n + 1);
+        if (r < 1.18 || r > 1.32) {
+            ratio_ok = 0;
+        }
+    }
+    TEST_ASSERT(ratio_ok, "Each nice level is ~1.25x its neighbour");
+
+    TEST_ASSERT(runqueue_priority_to_nice(RQ_PRIORITY_NICE_0) == 0, "Default priority is nice 0");
+    TEST_ASSERT(runqueue_priority_to_nice(RQ_PRIORITY_NICE_0 + 5) == -5, "Higher priority is lower nice");
+    TEST_ASSERT(runqueue_priority_to_nice(1) == 19 && runqueue_priority_to_nice(0) == 19,
+                "Low priorities clamp to nice 19");
+    TEST_ASSERT(runqueue_priority_to_nice(1000) == -20, "High priorities clamp to nice -20");
+}
+
+static void test_timeline(void) {
+    printf("\nTimeline order and accounting:\n");
+    reset_rq(1);
+
+    queue_at(mkproc(0, 0, 0), 0, 30 * MS);
+    queue_at(mkproc(1, 0, 0), 0, 10 * MS);
+    queue_at(mkproc(2, 0, 0), 0, 20 * MS);
+    queue_at(mkproc(3, 0, 0), 0, 10 * MS);
+    TEST_ASSERT(runqueue_nr_queued(0) == 4, "Four processes queued");
+
+    runqueue_stats_t st;
+    runqueue_get_stats(0, &st);
+    TEST_ASSERT(st.load_weight == 4 * RQ_NICE_0_WEIGHT, "Queue load sums the weights");
+
+    process_t* a = runqueue_pick_next(0, 0);
+    TEST_ASSERT(a == &procs[1], "Smallest vruntime runs first");
+    process_t* b = runqueue_pick_next(0, 0);
+    TEST_ASSERT(b == &procs[3], "Equal vruntimes run in arrival order");
+    runqueue_get_stats(0, &st);
+    TEST_ASSERT(st.min_vruntime == 10 * MS, "min_vruntime follows the running process");
+
+    /* b runs 2 ms at nice 0: vruntime advances 2 ms */
+    runqueue_tick(0, 2 * MS);
+    TEST_ASSERT(b->vruntime == 12 * MS && b->sum_exec_runtime == 2 * MS,
+                "Nice 0 accrues vruntime at wall-clock rate");
+
+    process_t* light = mkproc(4, 5, 0);
+    runqueue_remove(b);
+    queue_at(light, 0, 0);
+    process_t* p = runqueue_pick_next(0, 2 * MS);
+    TEST_ASSERT(p == light, "A process far behind runs next");
+    runqueue_tick(0, 3 * MS);
+    uint64_t expect = 1 * MS * RQ_NICE_0_WEIGHT / runqueue_nice_to_weight(5);
+    TEST_ASSERT(light->vruntime == expect, "Nice 5 accrues vruntime 3x faster");
+
+    reset_rq(1);
+    process_t* n1 = mkproc(0, 0, 0);
+    runqueue_wake(n1, RQ_WAKE_NEW, 0);
+    runqueue_get_stats(0, &st);
+    TEST_ASSERT(n1->vruntime > st.min_vruntime, "New process starts behind min_vruntime");
+    TEST_ASSERT(n1->weight == RQ_NICE_0_WEIGHT, "Wake sets the weight from the priority");
+    runqueue_pick_next(0, 0);
+    process_t* n2 = mkproc(1, 0, 0);
+    runqueue_wake(n2, RQ_WAKE_NEW, 1 * MS);
+    TEST_ASSERT(n2->vruntime > n1->vruntime, "A fork cannot jump its parent");
+}
+
+static void test_sleeper(void) {
+    printf("\nSleeper credit and wakeup preemption:\n");
+    reset_rq(1);
+
+    process_t* hog = mkproc(0, 0, 0);
+    queue_at(hog, 0, 0);
+    runqueue_pick_next(0, 0);
+    runqueue_tick(0, 100 * MS);
+
+    runqueue_stats_t st;
+    runqueue_get_stats(0, &st);
+    TEST_ASSERT(st.min_vruntime == 100 * MS, "A lone hog drives min_vruntime");
+
+    process_t* sleeper = mkproc(1, 0, 0);
+    sleeper->vruntime = 0;
+    int resched = runqueue_wake(sleeper, 0, 100 * MS);
+    TEST_ASSERT(sleeper->vruntime == 100 * MS - RQ_SCHED_LATENCY_NS / 2,
+                "Long sleeper is credited half a latency period, no more");
+    TEST_ASSERT(resched == 1, "Credited sleeper preempts the hog");
+    runqueue_get_stats(0, &st);
+    TEST_ASSERT(st.wakeup_preempts == 1, "Wakeup preemption counted");
+    TEST_ASSERT(g_ipi_count == 0, "Local wakeup sends no IPI");
+
+    /* A wakeup barely behind the running process does not preempt */
+    reset_rq(1);
+    hog = mkproc(0, 0, 0);
+    queue_at(hog, 0, 50 * MS);
+    runqueue_pick_next(0, 0);
+    process_t* close = mkproc(1, 0, 0);
+    close->vruntime = 50 * MS - RQ_WAKEUP_GRANULARITY_NS / 2;
+    TEST_ASSERT(runqueue_wake(close, 0, 0) == 0, "Wakeup within the granularity waits");
+    TEST_ASSERT(close->vruntime == 50 * MS - RQ_WAKEUP_GRANULARITY_NS / 2,
+                "Recent sleeper keeps its own vruntime");
+
+    /* Heavier wakers get a proportionally smaller granularity */
+    reset_rq(1);
+    hog = mkproc(0, 0, 0);
+    queue_at(hog, 0, 50 * MS);
+    runqueue_pick_next(0, 0);
+    process_t* heavy = mkproc(1, -10, 0);
+    heavy->vruntime = 50 * MS - RQ_WAKEUP_GRANULARITY_NS / 2;
+    TEST_ASSERT(runqueue_wake(heavy, 0, 0) == 1, "Nice -10 wakeup preempts with a smaller lead");
+}
+
+static void test_tick(void) {
+    printf("\nTick preemption:\n");
+    reset_rq(1);
+
+    process_t* a = mkproc(0, 0, 0);
+    process_t* b = mkproc(1, 0, 0);
+    queue_at(a, 0, 0);
+    queue_at(b, 0, 0);
+    TEST_ASSERT(runqueue_pick_next(0, 0) == a, "A runs first");
+    TEST_ASSERT(runqueue_tick(0, 1 * MS) == 0, "1 ms into a 3 ms slice: keep running");
+    TEST_ASSERT(runqueue_tick(0, 2900 * US) == 0, "Still inside the slice");
+    TEST_ASSERT(runqueue_tick(0, 3100 * US) == 1, "Slice used up: reschedule");
+
+    runqueue_put_prev(a, 3100 * US);
+    TEST_ASSERT(runqueue_pick_next(0, 3100 * US) == b, "B runs next");
+
+    reset_rq(1);
+    a = mkproc(0, 0, 0);
+    queue_at(a, 0, 0);
+    runqueue_pick_next(0, 0);
+    TEST_ASSERT(runqueue_tick(0, 500 * MS) == 0, "Alone on the CPU: never preempted");
+
+    /* Crowded: the period stretches to nr * min_granularity */
+    reset_rq(1);
+    for (int i = 0; i < 16; i++) {
+        queue_at(mkproc((uint32_t)i, 0, 0), 0, 0);
+    }
+    runqueue_pick_next(0, 0);
+    uint64_t slice = RQ_MIN_GRANULARITY_NS;
+    TEST_ASSERT(runqueue_tick(0, slice - 10 * US) == 0 && runqueue_tick(0, slice + 10 * US) == 1,
+                "With 16 runnable the slice is the minimum granularity");
+
+    runqueue_stats_t st;
+    runqueue_get_stats(0, &st);
+    TEST_ASSERT(st.tick_preempts == 1, "Tick preemption counted");
+
+    /* Idle CPU with work queued asks to reschedule */
+    reset_rq(1);
+    queue_at(mkproc(0, 0, 0), 0, 0);
+    TEST_ASSERT(runqueue_tick(0, 0) == 1, "Idle tick with queued work reschedules");
+
+    runqueue_tunables_t t = { .latency_ns = 24 * MS };
+    runqueue_set_tunables(&t);
+    runqueue_get_tunables(&t);
+    TEST_ASSERT(t.latency_ns == 24 * MS && t.min_granularity_ns == RQ_MIN_GRANULARITY_NS,
+                "Tunables update only the given fields");
+}
+
+static void test_remove(void) {
+    printf("\nRemoval:\n");
+    reset_rq(2);
+
+    process_t* a = mkproc(0, 0, 1);
+    process_t* b = mkproc(1, 0, 1);
+    process_t* c = mkproc(2, 0, 1);
+    queue_at(a, 1, 1);
+    queue_at(b, 1, 2);
+    queue_at(c, 1, 3);
+    TEST_ASSERT(runqueue_remove(b) == 0, "Queued process removed");
+    TEST_ASSERT(runqueue_remove(b) == -1, "Second removal fails");
+    TEST_ASSERT(runqueue_nr_queued(1) == 2, "Queue length tracks removals");
+
+    TEST_ASSERT(runqueue_pick_next(1, 0) == a, "Remaining order intact");
+    TEST_ASSERT(runqueue_remove(a) == 0, "Running process removed");
+    runqueue_stats_t st;
+    runqueue_get_stats(1, &st);
+    TEST_ASSERT(st.load_weight == RQ_NICE_0_WEIGHT, "Load drops with removals");
+    TEST_ASSERT(runqueue_pick_next(1, 0) == c && runqueue_pick_next(1, 0) == NULL,
+                "Nothing left after the last pick");
+}
+
+static void test_select_cpu(void) {
+    printf("\nCPU selection:\n");
+    reset_rq(4);
+
+    runqueue_wake(mkproc(0, 0, 2), 0, 0);
+    TEST_ASSERT(procs[0].cpu == 2, "Idle previous CPU is kept");
+
+    /* CPU 2 runs procs[0]; queue one more there */
+    g_cur_cpu = 2;
+    runqueue_pick_next(2, 0);
+    g_cur_cpu = 0;
+    queue_at(mkproc(1, 0, 2), 2, 0);
+    runqueue_wake(mkproc(2, 0, 2), 0, 0);
+    TEST_ASSERT(procs[2].cpu != 2, "Moves off a CPU two busier than the idlest");
+
+    reset_rq(4);
+    queue_at(mkproc(0, 0, 1), 1, 0);
+    runqueue_pick_next(1, 0);
+    runqueue_wake(mkproc(1, 0, 1), 0, 0);
+    TEST_ASSERT(procs[1].cpu == 1, "Stays put when the imbalance is one");
+
+    reset_rq(2);
+    TEST_ASSERT(runqueue_select_cpu(mkproc(0, 0, 99)) == 0, "Unknown CPU falls back to the current one");
+}
+
+static void test_steal(void) {
+    printf("\nWork stealing:\n");
+    reset_rq(4);
+
+    /* Three waiting on CPU 1, one on CPU 2 */
+    queue_at(mkproc(0, 0, 1), 1, 100 * MS);
+    queue_at(mkproc(1, 0, 1), 1, 130 * MS);
+    queue_at(mkproc(2, 0, 1), 1, 110 * MS);
+    queue_at(mkproc(3, 0, 2), 2, 0);
+
+    process_t* p = runqueue_pick_next(0, 0);
+    TEST_ASSERT(p && p->cpu == 0, "Idle CPU steals and takes ownership");
+    TEST_ASSERT(p == &procs[1], "Steals the process furthest from running");
+    TEST_ASSERT(runqueue_nr_queued(1) == 2, "Victim was the busiest CPU");
+    TEST_ASSERT(p->vruntime == 130 * MS, "vruntime rebased between queues");
+
+    runqueue_stats_t thief, victim;
+    runqueue_get_stats(0, &thief);
+    runqueue_get_stats(1, &victim);
+    TEST_ASSERT(thief.steals == 1 && victim.stolen == 1, "Steal counted on both sides");
+
+    runqueue_set_stealing(0);
+    TEST_ASSERT(runqueue_pick_next(3, 0) == NULL, "No stealing when disabled");
+    runqueue_set_stealing(1);
+    TEST_ASSERT(runqueue_pick_next(3, 0) != NULL, "Re-enabled stealing finds work");
+
+    /* Balancing pulls from a CPU two busier */
+    reset_rq(2);
+    for (int i = 0; i < 4; i++) {
+        queue_at(mkproc((uint32_t)i, 0, 0), 0, (uint64_t)i * MS);
+    }
+    runqueue_pick_next(0, 0);
+    g_cur_cpu = 1;
+    TEST_ASSERT(runqueue_balance(1) == 1, "Balancing pulls from the busier CPU");
+    TEST_ASSERT(runqueue_nr_queued(1) == 1 && runqueue_nr_queued(0) == 2, "One process moved");
+    TEST_ASSERT(runqueue_balance(1) == 1, "Still two apart: pull again");
+    TEST_ASSERT(runqueue_balance(1) == 0 && runqueue_nr_queued(1) == 2,
+                "No pull once within one");
+    g_cur_cpu = 0;
+}
+
+static void test_ipi(void) {
+    printf("\nWakeup IPIs:\n");
+    reset_rq(4);
+
+    runqueue_wake(mkproc(0, 0, 2), 0, 0);
+    TEST_ASSERT(g_ipi_count == 1 && g_ipi_cpu == 2, "Idle remote CPU is kicked");
+    TEST_ASSERT(g_ipi_vector == RQ_RESCHED_VECTOR, "Kick uses the reschedule vector");
+
+    /* Every CPU busy with a process at vruntime 50 ms */
+    reset_rq(4);
+    for (uint32_t cpu = 0; cpu < 4; cpu++) {
+        queue_at(mkproc(cpu, 0, cpu), cpu, 50 * MS);
+        g_cur_cpu = cpu;
+        runqueue_pick_next(cpu, 0);
+    }
+    g_cur_cpu = 0;
+
+    process_t* near = mkproc(10, 0, 2);
+    near->vruntime = 50 * MS;
+    runqueue_wake(near, 0, 0);
+    TEST_ASSERT(g_ipi_count == 0, "No kick when the wakeup would not preempt");
+
+    process_t* far = mkproc(11, 0, 3);
+    far->vruntime = 0;
+    runqueue_wake(far, 0, 0);
+    TEST_ASSERT(g_ipi_count == 1 && g_ipi_cpu == 3, "Kick to preempt a remote CPU");
+
+    runqueue_stats_t st;
+    runqueue_get_stats(3, &st);
+    TEST_ASSERT(st.ipis == 1, "IPIs counted on the target");
+}
+
+/* ---- Discrete-event simulator ---- */
+
+#define SIM_MAX_TASKS       256
+#define SIM_MAX_SAMPLES     (1u << 20)
+#define SIM_MAX_GROUPS      4
+#define SIM_TICK_NS         (1 * MS)
+#define SIM_IPI_NS          (2 * US)
+
+typedef struct {
+    uint32_t count;
+    int nice;
+    uint64_t burst_ns;          /* 0: CPU-bound */
+    uint64_t sleep_ns;          /* Mean sleep; uniform over [0, 2 * mean] */
+} sim_group_t;
+
+typedef struct {
+    process_t proc;
+    uint32_t group;
+    uint64_t remaining;         /* Left of the current burst */
+    uint64_t ran_ns;
+    uint64_t demand_ns;         /* CPU time asked for */
+    uint64_t ready_at;
+    int woken;                  /* Waiting to run after a wakeup */
+    uint64_t bursts;
+} sim_task_t;
+
+typedef struct {
+    sim_task_t* cur;
+    uint64_t started;           /* Last time cur was charged */
+    uint64_t gen;               /* Invalidates stale burst-end events */
+    uint64_t busy_ns;
+} sim_cpu_t;
+
+enum { EV_TICK, EV_DONE, EV_WAKE, EV_KICK };
+
+typedef struct {
+    uint64_t time;
+    uint64_t seq;
+    uint32_t type;
+    uint32_t id;
+    uint64_t gen;
+} sim_event_t;
+
+typedef struct {
+    uint32_t cpus;
+    sim_group_t groups[SIM_MAX_GROUPS];
+    uint64_t duration_ns;
+    int ipis;
+    int stealing;
+    int pile_up;                /* Start with every task queued on CPU 0 */
+    uint64_t wakeup_gran_ns;    /* 0: default */
+} sim_config_t;
+
+typedef struct {
+    double util;                /* Busy fraction over all CPUs */
+    double share[SIM_MAX_GROUPS];   /* Mean per-task fraction of all CPU time */
+    double jain[SIM_MAX_GROUPS];    /* Jain's fairness index within a group */
+    double served[SIM_MAX_GROUPS];  /* CPU time received / demanded (bursty groups) */
+    double bursts_per_sec;
+    double lat_mean_us;
+    uint64_t lat_p50_ns;
+    uint64_t lat_p99_ns;
+    uint64_t lat_max_ns;
+    uint64_t steals;
+    uint64_t pulls;
+    uint64_t ipis;
+    uint64_t events;
+} sim_result_t;
+
+static sim_event_t* heap;
+static uint32_t heap_len, heap_cap;
+static uint64_t heap_seq;
+static uint64_t sim_now;
+static sim_cpu_t sim_cpus[MAX_CPUS];
+static sim_task_t sim_tasks[SIM_MAX_TASKS];
+static uint32_t sim_ntasks;
+static const sim_config_t* sim_cfg;
+static uint64_t* lat_samples;
+static uint32_t lat_count;
+static uint64_t sim_rng;
+
+static int ev_before(const sim_event_t* a, const sim_event_t* b) {
+    return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+static void ev_push(uint64_t time, uint32_t type, uint32_t id, uint64_t gen) {
+    if (heap_len == heap_cap) {
+        heap_cap = heap_cap ? heap_cap * 2 : 1024;
+        heap = realloc(heap, heap_cap * sizeof(*heap));
+    }
+    sim_event_t ev = { time, heap_seq++, type, id, gen };
+    uint32_t i = heap_len++;
+    while (i > 0 && ev_before(&ev, &heap[(i - 1) / 2])) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = ev;
+}
+
+static sim_event_t ev_pop(void) {
+    sim_event_t top = heap[0];
+    sim_event_t last = heap[--heap_len];
+    uint32_t i = 0;
+    for (;;) {
+        uint32_t c = 2 * i + 1;
+        if (c >= heap_len) {
+            break;
+        }
+        if (c + 1 < heap_len && ev_before(&heap[c + 1], &heap[c])) {
+            c++;
+        }
+        if (!ev_before(&heap[c], &last)) {
+            break;
+        }
+        heap[i] = heap[c];
+        i = c;
+    }
+    heap[i] = last;
+    return top;
+}
+
+static sim_task_t* task_of(process_t* p) {
+    return (sim_task_t*)p;
+}
+
+static int cpu_bound(const sim_task_t* t) {
+    return sim_cfg->groups[t->group].burst_ns == 0;
+}
+
+static void sim_kick_hook(uint32_t cpu) {
+    if (sim_cfg->ipis) {
+        ev_push(sim_now + SIM_IPI_NS, EV_KICK, cpu, 0);
+    }
+}
+
+/* Charge the running task for the time since it was last charged */
+static void cpu_charge(uint32_t cpu) {
+    sim_cpu_t* c = &sim_cpus[cpu];
+    uint64_t ran = sim_now - c->started;
+    c->cur->ran_ns += ran;
+    c->busy_ns += ran;
+    if (!cpu_bound(c->cur)) {
+        c->cur->remaining -= ran < c->cur->remaining ? ran : c->cur->remaining;
+    }
+    c->started = sim_now;
+}
+
+/* scheduler_schedule(): balance, then run the next process or idle */
+static void cpu_schedule(uint32_t cpu) {
+    sim_cpu_t* c = &sim_cpus[cpu];
+    g_cur_cpu = cpu;
+    runqueue_balance(cpu);
+    process_t* p = runqueue_pick_next(cpu, sim_now);
+    c->gen++;
+
+    if (!p) {
+        c->cur = NULL;
+        return;
+    }
+
+    sim_task_t* t = task_of(p);
+    if (t->woken) {
+        if (lat_count < SIM_MAX_SAMPLES) {
+            lat_samples[lat_count++] = sim_now - t->ready_at;
+        }
+        t->woken = 0;
+    }
+    p->state = PROCESS_RUNNING;
+    c->cur = t;
+    c->started = sim_now;
+    if (!cpu_bound(t)) {
+        ev_push(sim_now + t->remaining, EV_DONE, cpu, c->gen);
+    }
+}
+
+/* Preempt the running task back onto the queue and pick again */
+static void cpu_resched(uint32_t cpu) {
+    sim_cpu_t* c = &sim_cpus[cpu];
+    if (c->cur) {
+        cpu_charge(cpu);
+        g_cur_cpu = cpu;
+        runqueue_put_prev(&c->cur->proc, sim_now);
+    }
+    cpu_schedule(cpu);
+}
+
+static void sim_wake(sim_task_t* t, int flags) {
+    const sim_group_t* g = &sim_cfg->groups[t->group];
+    t->remaining = g->burst_ns;
+    t->demand_ns += g->burst_ns;
+    t->ready_at = sim_now;
+    t->woken = !(flags & RQ_WAKE_NEW);
+
+    /* Device interrupts arrive on the BSP, which reschedules on return
+     * from the interrupt if the wakeup preempts it */
+    g_cur_cpu = 0;
+    if (runqueue_wake(&t->proc, flags, sim_now)) {
+        ev_push(sim_now, EV_KICK, 0, 0);
+    }
+}
+
+static void sim_tick(uint32_t cpu) {
+    sim_cpu_t* c = &sim_cpus[cpu];
+    if (c->cur) {
+        cpu_charge(cpu);
+    }
+    g_cur_cpu = cpu;
+    if (runqueue_tick(cpu, sim_now)) {
+        cpu_resched(cpu);
+    }
+    ev_push(sim_now + SIM_TICK_NS, EV_TICK, cpu, 0);
+}
+
+/* The running task finished its burst and sleeps */
+static void sim_done(uint32_t cpu) {
+    sim_cpu_t* c = &sim_cpus[cpu];
+    sim_task_t* t = c->cur;
+    cpu_charge(cpu);
+    t->bursts++;
+    t->proc.state = PROCESS_BLOCKED;
+    uint64_t mean = sim_cfg->groups[t->group].sleep_ns;
+    uint64_t sleep = mean ? rnd(&sim_rng) % (2 * mean + 1) : 0;
+    ev_push(sim_now + sleep, EV_WAKE, (uint32_t)(t - sim_tasks), 0);
+    cpu_schedule(cpu);
+}
+
+static void sim_run(const sim_config_t* cfg, sim_result_t* res) {
+    reset_rq(cfg->cpus);
+    runqueue_set_stealing(cfg->stealing);
+    if (cfg->wakeup_gran_ns) {
+        runqueue_tunables_t t = { .wakeup_granularity_ns = cfg->wakeup_gran_ns };
+        runqueue_set_tunables(&t);
+    }
+    g_ipi_hook = sim_kick_hook;
+    sim_cfg = cfg;
+    sim_rng = 0x9E3779B97F4A7C15ull;
+    sim_now = 0;
+    heap_len = 0;
+    heap_seq = 0;
+    lat_count = 0;
+    memset(sim_cpus, 0, sizeof(sim_cpus));
+    memset(sim_tasks, 0, sizeof(sim_tasks));
+
+    sim_ntasks = 0;
+    for (uint32_t g = 0; g < SIM_MAX_GROUPS; g++) {
+        for (uint32_t i = 0; i < cfg->groups[g].count && sim_ntasks < SIM_MAX_TASKS; i++) {
+            sim_task_t* t = &sim_tasks[sim_ntasks++];
+            t->group = g;
+            t->proc.pid = sim_ntasks;
+            t->proc.cpu = 0;        /* Everything is created on the BSP */
+            t->proc.priority = prio_for_nice(cfg->groups[g].nice);
+            rb_clear_node(&t->proc.run_node);
+        }
+    }
+    for (uint32_t i = 0; i < sim_ntasks; i++) {
+        sim_task_t* t = &sim_tasks[i];
+        if (cfg->pile_up) {
+            t->remaining = cfg->groups[t->group].burst_ns;
+            t->demand_ns = t->remaining;
+            t->proc.weight = runqueue_nice_to_weight(cfg->groups[t->group].nice);
+            g_cur_cpu = 0;
+            runqueue_put_prev(&t->proc, 0);
+        } else {
+            sim_wake(t, RQ_WAKE_NEW);
+        }
+    }
+    heap_len = 0;   /* Drop the start-up kicks; every CPU schedules at 0 */
+    for (uint32_t cpu = 0; cpu < cfg->cpus; cpu++) {
+        ev_push(0, EV_KICK, cpu, 0);
+        ev_push(SIM_TICK_NS, EV_TICK, cpu, 0);
+    }
+
+    uint64_t events = 0;
+    while (heap_len && heap[0].time <= cfg->duration_ns) {
+        sim_event_t ev = ev_pop();
+        sim_now = ev.time;
+        events++;
+
+        switch (ev.type) {
+        case EV_TICK:
+            sim_tick(ev.id);
+            break;
+        case EV_DONE:
+            if (ev.gen == sim_cpus[ev.id].gen) {
+                sim_done(ev.id);
+            }
+            break;
+        case EV_WAKE:
+            sim_wake(&sim_tasks[ev.id], 0);
+            break;
+        case EV_KICK:
+            cpu_resched(ev.id);
+            break;
+        }
+    }
+
+    /* Charge the tasks still running at the end */
+    sim_now = cfg->duration_ns;
+    for (uint32_t cpu = 0; cpu < cfg->cpus; cpu++) {
+        if (sim_cpus[cpu].cur) {
+            cpu_charge(cpu);
+        }
+    }
+
+    memset(res, 0, sizeof(*res));
+    uint64_t busy = 0;
+    for (uint32_t cpu = 0; cpu < cfg->cpus; cpu++) {
+        busy += sim_cpus[cpu].busy_ns;
+        runqueue_stats_t st;
+        runqueue_get_stats(cpu, &st);
+        res->steals += st.steals;
+        res->pulls += st.pulled;
+        res->ipis += st.ipis;
+    }
+    double total = (double)cfg->duration_ns * cfg->cpus;
+    res->util = (double)busy / total;
+
+    uint64_t bursts = 0;
+    for (uint32_t g = 0; g < SIM_MAX_GROUPS; g++) {
+        double sum = 0, sq = 0, got = 0, want = 0;
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < sim_ntasks; i++) {
+            if (sim_tasks[i].group != g) {
+                continue;
+            }
+            sum += (double)sim_tasks[i].ran_ns;
+            sq += (double)sim_tasks[i].ran_ns * (double)sim_tasks[i].ran_ns;
+            got += (double)sim_tasks[i].ran_ns;
+            want += (double)sim_tasks[i].demand_ns;
+            bursts += sim_tasks[i].bursts;
+            n++;
+        }
+        if (n) {
+            res->share[g] = sum / n / total;
+            res->jain[g] = sq > 0 ? sum * sum / (n * sq) : 1.0;
+            res->served[g] = want > 0 ? got / want : 0;
+        }
+    }
+    res->bursts_per_sec = (double)bursts * 1e9 / (double)cfg->duration_ns;
+
+    if (lat_count) {
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < lat_count; i++) {
+            sum += lat_samples[i];
+        }
+        res->lat_mean_us = (double)sum / lat_count / 1000.0;
+    }
+    res->events = events;
+}
+
+static int cmp_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Fill in the latency percentiles from the collected samples */
+static void sim_latency(sim_result_t* res) {
+    if (!lat_count) {
+        return;
+    }
+    qsort(lat_samples, lat_count, sizeof(uint64_t), cmp_u64);
+    res->lat_p50_ns = lat_samples[lat_count / 2];
+    res->lat_p99_ns = lat_samples[(uint64_t)lat_count * 99 / 100];
+    res->lat_max_ns = lat_samples[lat_count - 1];
+}
+
+static void simulate(const sim_config_t* cfg, sim_result_t* res) {
+    sim_run(cfg, res);
+    sim_latency(res);
+}
+
+static void test_sim_shares(void) {
+    printf("\nSimulation - CPU share by weight:\n");
+    sim_result_t r;
+
+    sim_config_t cfg = { .cpus = 1, .duration_ns = 10000 * MS, .ipis = 1, .stealing = 1,
+                         .groups = { { 1, 0, 0, 0 }, { 1, 5, 0, 0 } } };
+    simulate(&cfg, &r);
+    double ratio = r.share[0] / r.share[1];
+    double want = (double)runqueue_nice_to_weight(0) / runqueue_nice_to_weight(5);
+    printf("    nice 0 vs nice 5 on one CPU: %.3f (weights say %.3f)\n", ratio, want);
+    TEST_ASSERT(ratio > want * 0.97 && ratio < want * 1.03, "Two-way share matches the weight ratio");
+
+    cfg = (sim_config_t){ .cpus = 1, .duration_ns = 10000 * MS, .ipis = 1, .stealing = 1,
+                          .groups = { { 2, -5, 0, 0 }, { 2, 0, 0, 0 }, { 2, 5, 0, 0 }, { 2, 10, 0, 0 } } };
+    simulate(&cfg, &r);
+    static const int nices[4] = { -5, 0, 5, 10 };
+    double wsum = 0;
+    for (int g = 0; g < 4; g++) {
+        wsum += 2.0 * runqueue_nice_to_weight(nices[g]);
+    }
+    int shares_ok = 1, jain_ok = 1;
+    printf("    nice -5/0/5/10, two each:");
+    for (int g = 0; g < 4; g++) {
+        double expect = runqueue_nice_to_weight(nices[g]) / wsum;
+        printf(" %.4f (%.4f)", r.share[g], expect);
+        if (r.share[g] < expect * 0.95 || r.share[g] > expect * 1.05) {
+            shares_ok = 0;
+        }
+        if (r.jain[g] < 0.999) {
+            jain_ok = 0;
+        }
+    }
+    printf("\n");
+    TEST_ASSERT(shares_ok, "Each nice level gets its weight share within 5%");
+    TEST_ASSERT(jain_ok, "Equal weights split their share evenly");
+
+    cfg = (sim_config_t){ .cpus = 4, .duration_ns = 10000 * MS, .ipis = 1, .stealing = 1,
+                          .groups = { { 4, 0, 0, 0 }, { 4, 3, 0, 0 } } };
+    simulate(&cfg, &r);
+    ratio = r.share[0] / r.share[1];
+    want = (double)runqueue_nice_to_weight(0) / runqueue_nice_to_weight(3);
+    printf("    4 CPUs, 4 x nice 0 + 4 x nice 3: ratio %.3f (weights say %.3f), util %.4f\n",
+           ratio, want, r.util);
+    TEST_ASSERT(r.util > 0.999, "Mixed weights keep every CPU busy");
+    TEST_ASSERT(ratio > 1.0, "Heavier processes still get more across CPUs");
+}
+
+static void test_sim_fairness(void) {
+    printf("\nSimulation - fairness and balancing:\n");
+    sim_result_t r;
+
+    sim_config_t cfg = { .cpus = 4, .duration_ns = 10000 * MS, .ipis = 1, .stealing = 1,
+                         .groups = { { 12, 0, 0, 0 } } };
+    simulate(&cfg, &r);
+    printf("    4 CPUs, 12 CPU-bound tasks: util %.4f, Jain %.4f\n", r.util, r.jain[0]);
+    TEST_ASSERT(r.util > 0.999, "All CPUs stay busy with more tasks than CPUs");
+    TEST_ASSERT(r.jain[0] > 0.99, "CPU time is shared evenly (Jain > 0.99)");
+
+    cfg.cpus = 8;
+    cfg.groups[0].count = 8;
+    simulate(&cfg, &r);
+    printf("    8 CPUs, 8 tasks all created on CPU 0: util %.4f\n", r.util);
+    TEST_ASSERT(r.util > 0.999, "Tasks created on one CPU spread to all CPUs");
+
+    /* 16 tasks queued on CPU 0 before the other CPUs come up */
+    sim_result_t off;
+    cfg.groups[0].count = 16;
+    cfg.pile_up = 1;
+    simulate(&cfg, &r);
+    cfg.stealing = 0;
+    simulate(&cfg, &off);
+    printf("    8 CPUs, 16 tasks piled on CPU 0: Jain %.4f balanced (%llu pulls), util %.4f not\n",
+           r.jain[0], (unsigned long long)r.pulls, off.util);
+    TEST_ASSERT(r.util > 0.999 && r.jain[0] > 0.99, "Balancing evens out a piled-up CPU");
+    TEST_ASSERT(r.pulls + r.steals >= 7 && r.pulls < 64, "Balancing settles instead of ping-ponging");
+    TEST_ASSERT(off.util < 0.2, "Without stealing or balancing the other CPUs idle");
+}
+
+static void test_sim_latency(void) {
+    printf("\nSimulation - wakeup-to-run latency:\n");
+    sim_result_t fair, late;
+
+    /* A GUI-like thread (1 ms every ~10 ms) beside four CPU hogs */
+    sim_config_t cfg = { .cpus = 1, .duration_ns = 10000 * MS, .ipis = 1, .stealing = 1,
+                         .groups = { { 4, 0, 0, 0 }, { 1, 0, 1 * MS, 10 * MS } } };
+    simulate(&cfg, &fair);
+    cfg.wakeup_gran_ns = 1000 * MS;
+    simulate(&cfg, &late);
+    printf("    interactive beside 4 hogs: served %.3f, p50/p99 %.0f/%.0f us "
+           "(%.0f/%.0f us without wakeup preemption)\n",
+           fair.served[1], fair.lat_p50_ns / 1e3, fair.lat_p99_ns / 1e3,
+           late.lat_p50_ns / 1e3, late.lat_p99_ns / 1e3);
+    TEST_ASSERT(fair.served[1] > 0.99, "Interactive thread gets all the CPU it asks for");
+    TEST_ASSERT(fair.lat_p99_ns < 100 * US, "It runs within 100 us of waking (p99)");
+    TEST_ASSERT(late.lat_p50_ns > 10 * fair.lat_p99_ns, "Without wakeup preemption it waits out slices");
+    TEST_ASSERT(fair.share[0] * 4 + fair.share[1] > 0.999, "Hogs soak up the rest");
+
+    /* A sleeper cannot bank its sleep: after 1 s away it gets ~half a period */
+    cfg = (sim_config_t){ .cpus = 1, .duration_ns = 10000 * MS, .ipis = 1, .stealing = 1,
+                          .groups = { { 1, 0, 0, 0 }, { 1, 0, 200 * MS, 1000 * MS } } };
+    simulate(&cfg, &fair);
+    printf("    200 ms bursts after ~1 s sleeps beside a hog: hog share %.3f\n", fair.share[0]);
+    TEST_ASSERT(fair.share[0] > 0.5, "Returning sleeper shares with the hog instead of monopolizing");
+
+    /* Remote wakeups on 4 CPUs, with and without IPIs */
+    sim_result_t with, without;
+    cfg = (sim_config_t){ .cpus = 4, .duration_ns = 5000 * MS, .ipis = 1, .stealing = 1,
+                          .groups = { { 4, 0, 0, 0 }, { 8, 0, 200 * US, 2 * MS } } };
+    simulate(&cfg, &with);
+    cfg.ipis = 0;
+    simulate(&cfg, &without);
+    printf("    4 CPUs, 4 hogs + 8 interactive: p50/p99 %.0f/%.0f us with IPIs, "
+           "%.0f/%.0f us without\n",
+           with.lat_p50_ns / 1e3, with.lat_p99_ns / 1e3,
+           without.lat_p50_ns / 1e3, without.lat_p99_ns / 1e3);
+    TEST_ASSERT(with.ipis > 0, "Remote wakeups sent IPIs");
+    TEST_ASSERT(with.lat_p99_ns < 500 * US, "p99 wakeup latency under half a tick with IPIs");
+    TEST_ASSERT(without.lat_p99_ns > with.lat_p99_ns, "Without IPIs wakeups wait for a tick");
+    TEST_ASSERT(with.util > 0.95, "Hogs keep the CPUs busy");
+
+    /* Equal-weight bursty tasks: idle CPUs take queued work */
+    sim_result_t steal_on, steal_off;
+    cfg = (sim_config_t){ .cpus = 8, .duration_ns = 5000 * MS, .ipis = 1, .stealing = 1,
+                          .groups = { { 16, 0, 3 * MS, 3 * MS } } };
+    simulate(&cfg, &steal_on);
+    cfg.stealing = 0;
+    simulate(&cfg, &steal_off);
+    printf("    8 CPUs, 16 x 3ms/3ms: mean latency %.0f us with stealing (%llu migrations), "
+           "%.0f us without\n",
+           steal_on.lat_mean_us, (unsigned long long)(steal_on.steals + steal_on.pulls),
+           steal_off.lat_mean_us);
+    TEST_ASSERT(steal_on.steals + steal_on.pulls > 0, "Idle CPUs took work from busy ones");
+    TEST_ASSERT(steal_off.steals + steal_off.pulls == 0, "Stealing can be turned off");
+    TEST_ASSERT(steal_on.lat_mean_us <= steal_off.lat_mean_us, "Stealing does not hurt latency");
+    TEST_ASSERT(steal_on.bursts_per_sec >= steal_off.bursts_per_sec, "Stealing does not hurt throughput");
+}
+
+/* ---- Benchmarks ---- */
+
+static void bench_scaling(void) {
+    printf("\nSimulated mixed load (N hogs + 2N interactive 200us/2ms, 10s):\n");
+    printf("  %-5s %8s %12s %8s %8s %8s %8s %8s\n",
+           "CPUs", "util", "bursts/s", "p50 us", "p99 us", "max us", "migr", "IPIs");
+    for (uint32_t cpus = 1; cpus <= 16; cpus *= 2) {
+        sim_config_t cfg = { .cpus = cpus, .duration_ns = 10000 * MS, .ipis = 1, .stealing = 1,
+                             .groups = { { cpus, 0, 0, 0 }, { 2 * cpus, 0, 200 * US, 2 * MS } } };
+        sim_result_t r;
+        uint64_t t0 = now_ns();
+        simulate(&cfg, &r);
+        uint64_t t1 = now_ns();
+        printf("  %-5u %8.4f %12.0f %8.1f %8.1f %8.1f %8llu %8llu   (%.1f M events/s)\n",
+               cpus, r.util, r.bursts_per_sec, r.lat_p50_ns / 1e3, r.lat_p99_ns / 1e3,
+               r.lat_max_ns / 1e3, (unsigned long long)(r.steals + r.pulls),
+               (unsigned long long)r.ipis, r.events * 1e3 / (double)(t1 - t0));
+    }
+}
+
+static void bench_policies(void) {
+    printf("\nPolicy comparison (8 CPUs, 16 equal-weight 3ms/3ms tasks, 10s):\n");
+    printf("  %-20s %8s %12s %10s %8s %8s\n", "", "util", "bursts/s", "mean us", "p99 us", "max us");
+    static const struct { const char* name; int ipis; int stealing; } modes[] = {
+        { "IPIs + stealing", 1, 1 },
+        { "stealing only", 0, 1 },
+        { "IPIs only", 1, 0 },
+        { "neither", 0, 0 },
+    };
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        sim_config_t cfg = { .cpus = 8, .duration_ns = 10000 * MS,
+                             .ipis = modes[m].ipis, .stealing = modes[m].stealing,
+                             .groups = { { 16, 0, 3 * MS, 3 * MS } } };
+        sim_result_t r;
+        simulate(&cfg, &r);
+        printf("  %-20s %8.4f %12.0f %10.0f %8.0f %8.0f\n", modes[m].name, r.util,
+               r.bursts_per_sec, r.lat_mean_us, r.lat_p99_ns / 1e3, r.lat_max_ns / 1e3);
+    }
+}
+
+static void bench_granularity(void) {
+    printf("\nWakeup granularity (1 CPU, 4 hogs + 1 interactive 1ms/10ms, 10s):\n");
+    printf("  %-12s %10s %10s %10s\n", "gran", "p50 us", "p99 us", "served");
+    static const uint64_t grans[] = { 250 * US, 1 * MS, 4 * MS, 1000 * MS };
+    for (size_t i = 0; i < sizeof(grans) / sizeof(grans[0]); i++) {
+        sim_config_t cfg = { .cpus = 1, .duration_ns = 10000 * MS, .ipis = 1, .stealing = 1,
+                             .wakeup_gran_ns = grans[i],
+                             .groups = { { 4, 0, 0, 0 }, { 1, 0, 1 * MS, 10 * MS } } };
+        sim_result_t r;
+        simulate(&cfg, &r);
+        printf("  %8.2f ms %10.1f %10.1f %10.3f\n", grans[i] / 1e6, r.lat_p50_ns / 1e3,
+               r.lat_p99_ns / 1e3, r.served[1]);
+    }
+}
+
+static void bench_ops(void) {
+    printf("\nRunqueue operation cost (host):\n");
+    static process_t many[4096];
+    for (uint32_t queued = 16; queued <= 4096; queued *= 16) {
+        reset_rq(1);
+        uint64_t seed = 42;
+        for (uint32_t i = 0; i < queued; i++) {
+            memset(&many[i], 0, sizeof(many[i]));
+            many[i].priority = prio_for_nice((int)(rnd(&seed) % 40) - 20);
+            rb_clear_node(&many[i].run_node);
+            runqueue_wake(&many[i], RQ_WAKE_NEW, 0);
+        }
+        const uint32_t iters = 4000000;
+        uint64_t clock = 0;
+        uint64_t t0 = now_ns();
+        for (uint32_t i = 0; i < iters; i++) {
+            process_t* p = runqueue_pick_next(0, clock);
+            clock += 100 * US;
+            runqueue_put_prev(p, clock);
+        }
+        uint64_t t1 = now_ns();
+        printf("  %5u queued: %.1f ns per pick + requeue\n", queued,
+               (double)(t1 - t0) / iters);
+    }
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("=== Aurora OS Per-CPU Runqueue Tests ===\n");
+
+    lat_samples = malloc(SIM_MAX_SAMPLES * sizeof(uint64_t));
+    if (!lat_samples) {
+        printf("Out of memory\n");
+        return 1;
+    }
+
+    test_rbtree();
+    test_weights();
+    test_timeline();
+    test_sleeper();
+    test_tick();
+    test_remove();
+    test_select_cpu();
+    test_steal();
+    test_ipi();
+    test_sim_shares();
+    test_sim_fairness();
+    test_sim_latency();
+
+    if (bench) {
+        printf("\n=== Benchmarks ===\n");
+        bench_scaling();
+        bench_policies();
+        bench_granularity();
+        bench_ops();
+    }
+
+    free(lat_samples);
+    free(heap);
+
+    printf("\n========================================\n");
+    printf("Passed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
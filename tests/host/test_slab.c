@@ -0,0 +1,429 @@
+/**
+ * Aurora OS - Slab Allocator Tests
+ *
+ * Host-built harness for the kmalloc backend (kernel/memory/slab.c) over a
+ * heap-allocated region: size-class rounding and alignment, page-run
+ * fallthrough and coalescing, invalid frees, and a randomized alloc/free
+ * stress run that checks every live allocation for overlap (by pattern)
+ * and the region for leaks. With --bench, compares alloc/free throughput
+ * against the previous first-fit list allocator.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../kernel/memory/slab.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+#define REGION_SIZE (64u * 1024 * 1024)
+
+static uint8_t* g_region;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* xorshift64 */
+static uint64_t g_rng = 0x9E3779B97F4A7C15ull;
+static uint64_t rnd(void) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return g_rng;
+}
+
+static void reset_region(size_t size) {
+    int rc = slab_init(g_region, size);
+    if (rc != 0) {
+        printf("slab_init failed\n");
+        exit(1);
+    }
+}
+
+/* ---- Previous kmalloc: first-fit block list, for the benchmark baseline ---- */
+
+typedef struct legacy_block {
+    size_t size;
+    int free;
+    struct legacy_block* next;
+} legacy_block_t;
+
+static legacy_block_t* legacy_heap;
+
+static void legacy_init(void* base, size_t size) {
+    legacy_heap = (legacy_block_t*)base;
+    legacy_heap->size = size - sizeof(legacy_block_t);
+    legacy_heap->free = 1;
+    legacy_heap->next = NULL;
+}
+
+static void* legacy_alloc(size_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+    size = (size + 7) & ~(size_t)7;
+    for (legacy_block_t* cur = legacy_heap; cur; cur = cur->next) {
+        if (cur->free && cur->size >= size) {
+            if (cur->size >= size + sizeof(legacy_block_t) + 8) {
+                legacy_block_t* nb = (legacy_block_t*)((uint8_t*)cur + sizeof(legacy_block_t) + size);
+                nb->size = cur->size - size - sizeof(legacy_block_t);
+                nb->free = 1;
+                nb->next = cur->next;
+                cur->size = size;
+                cur->next = nb;
+            }
+            cur->free = 0;
+            return (uint8_t*)cur + sizeof(legacy_block_t);
+        }
+    }
+    return NULL;
+}
+
+static void legacy_free(void* ptr) {
+    legacy_block_t* block = (legacy_block_t*)((uint8_t*)ptr - sizeof(legacy_block_t));
+    block->free = 1;
+    if (block->next && block->next->free) {
+        block->size += sizeof(legacy_block_t) + block->next->size;
+        block->next = block->next->next;
+    }
+    legacy_block_t* cur = legacy_heap;
+    while (cur && cur->next != block) {
+        cur = cur->next;
+    }
+    if (cur && cur->free) {
+        cur->size += sizeof(legacy_block_t) + block->size;
+        cur->next = block->next;
+    }
+}
+
+/* ---- Tests ---- */
+
+static void test_size_classes(void) {
+    printf("\nSize classes:\n");
+    reset_region(REGION_SIZE);
+
+    static const size_t sizes[] = { 1, 16, 17, 40, 48, 49, 100, 200, 500, 512,
+                                    513, 700, 1000, 1500, 2000, 3000, 4000, 4096 };
+    static const size_t expect[] = { 16, 16, 32, 48, 48, 64, 128, 256, 512, 512,
+                                     768, 768, 1024, 1536, 2048, 3072, 4096, 4096 };
+    int rounded = 1, aligned = 1;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        void* p = slab_alloc(sizes[i]);
+        if (!p || slab_usable_size(p) != expect[i]) {
+            rounded = 0;
+        }
+        if ((uintptr_t)p % SLAB_MIN_ALIGN) {
+            aligned = 0;
+        }
+    }
+    TEST_ASSERT(rounded, "Requests round up to the next size class");
+    TEST_ASSERT(aligned, "Objects are 16-byte aligned");
+
+    void* page = slab_alloc(4096);
+    TEST_ASSERT(page && ((uintptr_t)page & (SLAB_PAGE_SIZE - 1)) == 0,
+                "4 KB class objects are page aligned");
+    TEST_ASSERT(slab_alloc(0) == NULL, "Zero-size allocation returns NULL");
+
+    /* A one-page slab of 64-byte objects holds 64 of them */
+    reset_region(REGION_SIZE);
+    uint8_t* objs[65];
+    int contiguous = 1;
+    for (int i = 0; i < 65; i++) {
+        objs[i] = slab_alloc(64);
+        if (i > 0 && i < 64 && objs[i] != objs[i - 1] + 64) {
+            contiguous = 0;
+        }
+    }
+    TEST_ASSERT(contiguous, "A fresh slab hands out consecutive objects");
+    TEST_ASSERT(((uintptr_t)objs[64] & (SLAB_PAGE_SIZE - 1)) == 0 &&
+                (objs[64] < objs[0] || objs[64] >= objs[0] + SLAB_PAGE_SIZE),
+                "A full slab moves allocation to a new slab");
+
+    slab_free(objs[10]);
+    TEST_ASSERT(slab_alloc(64) == objs[10], "A freed object is reused first");
+
+    slab_stats_t st;
+    slab_get_stats(&st);
+    TEST_ASSERT(st.class_objects[3] == 65 && st.class_slabs[3] == 2,
+                "Per-class object and slab counts");
+}
+
+static void test_large(void) {
+    printf("\nLarge allocations:\n");
+    reset_region(REGION_SIZE);
+
+    slab_stats_t st;
+    slab_get_stats(&st);
+    uint32_t total = st.free_pages;
+
+    void* a = slab_alloc(4097);
+    void* b = slab_alloc(100000);
+    void* c = slab_alloc(3 * SLAB_PAGE_SIZE);
+    TEST_ASSERT(a && b && c, "Allocations above 4 KB succeed");
+    TEST_ASSERT(((uintptr_t)a & (SLAB_PAGE_SIZE - 1)) == 0 &&
+                ((uintptr_t)b & (SLAB_PAGE_SIZE - 1)) == 0,
+                "Large allocations are page aligned");
+    TEST_ASSERT(slab_usable_size(a) == 2 * SLAB_PAGE_SIZE &&
+                slab_usable_size(b) == 25 * SLAB_PAGE_SIZE,
+                "Large allocations round to whole pages");
+
+    slab_get_stats(&st);
+    TEST_ASSERT(st.large_pages == 30 && st.free_pages == total - 30,
+                "Page accounting for large allocations");
+
+    /* Free the middle one, then the outer ones: everything coalesces */
+    slab_free(b);
+    slab_get_stats(&st);
+    TEST_ASSERT(st.free_runs == 2, "Freeing between live runs leaves a hole");
+    slab_free(a);
+    slab_free(c);
+    slab_get_stats(&st);
+    TEST_ASSERT(st.free_runs == 1 && st.largest_free_run == total,
+                "Frees coalesce back into a single run");
+
+    void* all = slab_alloc((size_t)total * SLAB_PAGE_SIZE);
+    TEST_ASSERT(all != NULL, "Whole region is allocatable after coalescing");
+    TEST_ASSERT(slab_alloc(5000) == NULL, "Exhausted region returns NULL");
+    TEST_ASSERT(slab_alloc(16) == NULL, "Slab classes fail when no pages remain");
+    slab_free(all);
+    TEST_ASSERT(slab_alloc(16) != NULL, "Allocation recovers after free");
+}
+
+static void test_invalid_free(void) {
+    printf("\nInvalid frees:\n");
+    reset_region(REGION_SIZE);
+
+    uint8_t* p = slab_alloc(128);
+    uint8_t* q = slab_alloc(128);
+    uint8_t* big = slab_alloc(20000);
+    int outside = 0;
+    slab_free(&outside);
+    slab_free(p + 8);
+    slab_free(big + SLAB_PAGE_SIZE);
+    slab_stats_t st;
+    slab_get_stats(&st);
+    TEST_ASSERT(st.frees == 0, "Foreign and interior pointers are ignored");
+    TEST_ASSERT(slab_usable_size(p + 8) == 0 && slab_usable_size(big + 100) == 0,
+                "Usable size is 0 for interior pointers");
+
+    slab_free(p);
+    slab_free(p);
+    slab_get_stats(&st);
+    TEST_ASSERT(st.frees == 1 && st.class_objects[5] == 1, "Double free is ignored");
+    TEST_ASSERT(slab_alloc(128) == p && slab_alloc(128) != q,
+                "Slab state is intact after the double free");
+
+    slab_free(big);
+    slab_free(big);
+    slab_get_stats(&st);
+    TEST_ASSERT(st.large_pages == 0 && st.frees == 2, "Large double free is ignored");
+}
+
+/* Live allocation record for the stress test */
+typedef struct {
+    uint8_t* ptr;
+    size_t size;
+    uint8_t tag;
+} live_t;
+
+static size_t random_size(void) {
+    uint64_t r = rnd();
+    switch (r % 16) {
+    case 0:  return 4097 + (size_t)((r >> 8) % 60000);       /* Large */
+    case 1:
+    case 2:  return 1025 + (size_t)((r >> 8) % 3072);        /* 1-4 KB */
+    default: return 1 + (size_t)((r >> 8) % 1024);           /* Small */
+    }
+}
+
+static int check_pattern(const live_t* l) {
+    for (size_t i = 0; i < l->size; i++) {
+        if (l->ptr[i] != (uint8_t)(l->tag + i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void test_stress(void) {
+    printf("\nRandomized stress:\n");
+    reset_region(REGION_SIZE);
+
+    slab_stats_t st;
+    slab_get_stats(&st);
+    uint32_t initial_free = st.free_pages;
+
+    enum { MAX_LIVE = 4096, OPS = 400000 };
+    live_t* live = calloc(MAX_LIVE, sizeof(live_t));
+    uint32_t count = 0;
+    int corrupt = 0, bad_size = 0, bad_align = 0, failed = 0;
+
+    for (uint32_t op = 0; op < OPS; op++) {
+        int do_alloc = count == 0 || (count < MAX_LIVE && (rnd() % 100) < 55);
+        if (do_alloc) {
+            live_t* l = &live[count];
+            l->size = random_size();
+            l->ptr = slab_alloc(l->size);
+            if (!l->ptr) {
+                failed++;
+                continue;
+            }
+            l->tag = (uint8_t)op;
+            if (slab_usable_size(l->ptr) < l->size) {
+                bad_size++;
+            }
+            if ((uintptr_t)l->ptr % SLAB_MIN_ALIGN) {
+                bad_align++;
+            }
+            for (size_t i = 0; i < l->size; i++) {
+                l->ptr[i] = (uint8_t)(l->tag + i);
+            }
+            count++;
+        } else {
+            uint32_t idx = (uint32_t)(rnd() % count);
+            if (!check_pattern(&live[idx])) {
+                corrupt++;
+            }
+            slab_free(live[idx].ptr);
+            live[idx] = live[--count];
+        }
+    }
+
+    int final_ok = 1;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!check_pattern(&live[i])) {
+            final_ok = 0;
+        }
+    }
+
+    slab_get_stats(&st);
+    printf("    %u live at end, peak %.1f MB, %u slab pages, %u large pages\n",
+           count, (double)st.peak_bytes_in_use / (1024.0 * 1024.0),
+           st.slab_pages, st.large_pages);
+    TEST_ASSERT(failed == 0, "No allocation failures with free space available");
+    TEST_ASSERT(corrupt == 0 && final_ok, "No live allocation was overwritten (no overlap)");
+    TEST_ASSERT(bad_size == 0 && bad_align == 0, "Usable size and alignment hold for every allocation");
+    TEST_ASSERT(st.allocs - st.frees == count, "Alloc/free counts match live objects");
+
+    for (uint32_t i = 0; i < count; i++) {
+        slab_free(live[i].ptr);
+    }
+    slab_shrink();
+    slab_get_stats(&st);
+    TEST_ASSERT(st.bytes_in_use == 0 && st.slab_pages == 0 && st.large_pages == 0,
+                "Nothing in use after freeing everything");
+    TEST_ASSERT(st.free_pages == initial_free && st.free_runs == 1,
+                "All pages return to one free run (no leaks)");
+    free(live);
+}
+
+/* ---- Benchmarks ---- */
+
+typedef struct {
+    const char* name;
+    size_t (*size)(void);
+} workload_t;
+
+static size_t size_small(void) { return 16 + (rnd() % 4) * 16; }
+static size_t size_structs(void) {
+    static const size_t s[] = { 24, 40, 64, 96, 136, 200, 256, 512 };
+    return s[rnd() % 8];
+}
+static size_t size_mixed(void) { return 1 + (size_t)(rnd() % 4096); }
+
+static double bench_run(int legacy, size_t (*size)(void), uint32_t live_target, uint32_t ops) {
+    void** live = calloc(live_target, sizeof(void*));
+    size_t region = 32u * 1024 * 1024;
+    if (legacy) {
+        legacy_init(g_region, region);
+    } else {
+        reset_region(region);
+    }
+
+    g_rng = 12345;
+    for (uint32_t i = 0; i < live_target; i++) {
+        size_t s = size();
+        live[i] = legacy ? legacy_alloc(s) : slab_alloc(s);
+    }
+
+    /* Steady state: free a random live object, allocate a replacement */
+    uint64_t t0 = now_ns();
+    for (uint32_t i = 0; i < ops; i++) {
+        uint32_t idx = (uint32_t)(rnd() % live_target);
+        size_t s = size();
+        if (legacy) {
+            legacy_free(live[idx]);
+            live[idx] = legacy_alloc(s);
+        } else {
+            slab_free(live[idx]);
+            live[idx] = slab_alloc(s);
+        }
+    }
+    uint64_t t1 = now_ns();
+    free(live);
+    return (double)ops * 1e9 / (double)(t1 - t0);
+}
+
+static void run_benchmarks(void) {
+    printf("\nBenchmarks (free+alloc pairs per second, steady state):\n");
+
+    static const workload_t loads[] = {
+        { "16-64 B", size_small },
+        { "struct sizes", size_structs },
+        { "1 B-4 KB mixed", size_mixed },
+    };
+    static const uint32_t lives[] = { 100, 1000, 5000 };
+
+    printf("    %-16s %6s %14s %14s %8s\n", "workload", "live", "first-fit", "slab", "speedup");
+    for (size_t w = 0; w < sizeof(loads) / sizeof(loads[0]); w++) {
+        for (size_t l = 0; l < sizeof(lives) / sizeof(lives[0]); l++) {
+            uint32_t ops = lives[l] >= 5000 ? 20000 : 200000;
+            double old_rate = bench_run(1, loads[w].size, lives[l], ops);
+            double new_rate = bench_run(0, loads[w].size, lives[l], 2000000);
+            printf("    %-16s %6u %12.0f/s %12.0f/s %7.1fx\n", loads[w].name,
+                   lives[l], old_rate, new_rate, new_rate / old_rate);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("Slab Allocator Tests\n");
+    printf("====================\n");
+
+    if (posix_memalign((void**)&g_region, SLAB_PAGE_SIZE, REGION_SIZE) != 0) {
+        printf("Out of host memory\n");
+        return 1;
+    }
+
+    test_size_classes();
+    test_large();
+    test_invalid_free();
+    test_stress();
+
+    if (bench) {
+        run_benchmarks();
+    }
+
+    free(g_region);
+
+    printf("\nPassed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
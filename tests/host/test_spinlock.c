@@ -0,0 +1,807 @@
+/**
+ * Aurora OS - Spinlock Tests
+ *
+ * Host-built harness for kernel/smp/spinlock.c, with one pthread per
+ * simulated CPU: ticket lock FIFO hand-off and wraparound, mutual
+ * exclusion under contention for the ticket, MCS and queued locks
+ * (including nested queued locks), reader-writer lock sharing and writer
+ * preference, and contention statistics. Built a second time with
+ * ENABLE_LOCKDEP (test_lockdep) it also checks lock-order validation:
+ * AB/BA and longer cycles across threads, recursion and unbalanced
+ * releases. With --bench, compares the previous test-and-test-and-set
+ * lock with the new locks and pthread mutexes: uncontended cost, and
+ * throughput and fairness from 1 to 16 threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include "../../kernel/smp/smp.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/* ---- Kernel service stubs: one thread per simulated CPU ---- */
+
+static __thread uint32_t t_cpu_id;
+static long g_host_cpus;
+
+uint32_t smp_get_current_cpu_id(void) {
+    return t_cpu_id;
+}
+
+void cpu_relax(void) {
+    /* One host CPU is shared by all the simulated ones; let the holder run */
+    if (g_host_cpus < 2) {
+        sched_yield();
+    } else {
+        __asm__ volatile("pause" ::: "memory");
+    }
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* The lock spinlock_acquire() used to be, for comparison */
+typedef struct {
+    volatile uint32_t lock;
+} ttas_lock_t;
+
+static void ttas_acquire(ttas_lock_t* lock) {
+    while (__sync_lock_test_and_set(&lock->lock, 1)) {
+        while (lock->lock) {
+            cpu_relax();
+        }
+    }
+}
+
+static void ttas_release(ttas_lock_t* lock) {
+    __sync_lock_release(&lock->lock);
+}
+
+/* ---- Lock type dispatch for the threaded tests ---- */
+
+enum { LK_TTAS, LK_TICKET, LK_QSPIN, LK_MCS, LK_RW_WRITE, LK_MUTEX, LK_COUNT };
+
+static const char* lock_names[LK_COUNT] = {
+    "TTAS (old)", "ticket", "qspinlock", "MCS", "rwlock (write)", "pthread mutex",
+};
+
+typedef struct {
+    ttas_lock_t ttas;
+    spinlock_t ticket __attribute__((aligned(64)));
+    qspinlock_t qspin __attribute__((aligned(64)));
+    mcs_lock_t mcs __attribute__((aligned(64)));
+    rwlock_t rw __attribute__((aligned(64)));
+    pthread_mutex_t mutex __attribute__((aligned(64)));
+} any_lock_t;
+
+static any_lock_t g_lock;
+
+static void any_init(any_lock_t* l) {
+    l->ttas.lock = 0;
+    spinlock_init(&l->ticket);
+    qspinlock_init(&l->qspin);
+    mcs_lock_init(&l->mcs);
+    rwlock_init(&l->rw);
+    pthread_mutex_init(&l->mutex, NULL);
+}
+
+static inline void any_acquire(any_lock_t* l, int kind, mcs_node_t* node) {
+    switch (kind) {
+    case LK_TTAS:       ttas_acquire(&l->ttas); break;
+    case LK_TICKET:     spinlock_acquire(&l->ticket); break;
+    case LK_QSPIN:      qspinlock_acquire(&l->qspin); break;
+    case LK_MCS:        mcs_lock_acquire(&l->mcs, node); break;
+    case LK_RW_WRITE:   rwlock_write_acquire(&l->rw); break;
+    case LK_MUTEX:      pthread_mutex_lock(&l->mutex); break;
+    }
+}
+
+static inline void any_release(any_lock_t* l, int kind, mcs_node_t* node) {
+    switch (kind) {
+    case LK_TTAS:       ttas_release(&l->ttas); break;
+    case LK_TICKET:     spinlock_release(&l->ticket); break;
+    case LK_QSPIN:      qspinlock_release(&l->qspin); break;
+    case LK_MCS:        mcs_lock_release(&l->mcs, node); break;
+    case LK_RW_WRITE:   rwlock_write_release(&l->rw); break;
+    case LK_MUTEX:      pthread_mutex_unlock(&l->mutex); break;
+    }
+}
+
+/* ---- Ticket lock ---- */
+
+static spinlock_t g_fifo_lock;
+static volatile uint32_t g_order[8];
+static volatile uint32_t g_order_len;
+
+static void* fifo_thread(void* arg) {
+    t_cpu_id = (uint32_t)(uintptr_t)arg;
+    spinlock_acquire(&g_fifo_lock);
+    g_order[g_order_len++] = t_cpu_id;
+    spinlock_release(&g_fifo_lock);
+    return NULL;
+}
+
+static void test_ticket(void) {
+    printf("\nTicket lock:\n");
+    spinlock_t lock;
+    spinlock_init(&lock);
+
+    spinlock_acquire(&lock);
+    TEST_ASSERT(lock.tickets.next == 1 && lock.tickets.owner == 0, "Acquire takes a ticket");
+    TEST_ASSERT(!spinlock_try_acquire(&lock), "Trylock fails while held");
+    spinlock_release(&lock);
+    TEST_ASSERT(lock.tickets.owner == 1, "Release serves the next ticket");
+    TEST_ASSERT(spinlock_try_acquire(&lock), "Trylock succeeds when free");
+    spinlock_release(&lock);
+
+    /* Wrap the 16-bit counters */
+    lock.tickets.owner = 0xFFFE;
+    lock.tickets.next = 0xFFFE;
+    int wrap_ok = 1;
+    for (int i = 0; i < 4; i++) {
+        if (i % 2) {
+            wrap_ok &= spinlock_try_acquire(&lock);
+        } else {
+            spinlock_acquire(&lock);
+        }
+        spinlock_release(&lock);
+    }
+    TEST_ASSERT(wrap_ok && lock.tickets.owner == 2 && lock.tickets.next == 2,
+                "Tickets wrap around 16 bits");
+
+    /* Waiters are served in arrival order */
+    spinlock_init(&g_fifo_lock);
+    g_order_len = 0;
+    t_cpu_id = 0;
+    spinlock_acquire(&g_fifo_lock);
+    pthread_t threads[6];
+    for (uint32_t i = 0; i < 6; i++) {
+        pthread_create(&threads[i], NULL, fifo_thread, (void*)(uintptr_t)(i + 1));
+        /* Wait until it holds its ticket before starting the next */
+        while (g_fifo_lock.tickets.next != i + 2) {
+            sched_yield();
+        }
+    }
+    spinlock_release(&g_fifo_lock);
+    for (uint32_t i = 0; i < 6; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    int fifo = g_order_len == 6;
+    for (uint32_t i = 0; i < g_order_len; i++) {
+        fifo &= g_order[i] == i + 1;
+    }
+    TEST_ASSERT(fifo, "Waiters acquire in arrival order");
+}
+
+/* ---- Mutual exclusion ---- */
+
+typedef struct {
+    uint32_t cpu;
+    int kind;
+    uint32_t iterations;
+    uint64_t count;
+} mutex_arg_t;
+
+/* Written only under the lock */
+static volatile uint64_t g_counter;
+static volatile uint32_t g_inside;
+static volatile uint32_t g_overlaps;
+
+static void* exclusion_thread(void* arg) {
+    mutex_arg_t* a = arg;
+    mcs_node_t node;
+    t_cpu_id = a->cpu;
+
+    for (uint32_t i = 0; i < a->iterations; i++) {
+        any_acquire(&g_lock, a->kind, &node);
+        if (g_inside++) {
+            g_overlaps++;
+        }
+        g_counter++;
+        if ((i & 255) == 0) {
+            sched_yield();      /* Get preempted while holding the lock */
+        }
+        g_inside--;
+        any_release(&g_lock, a->kind, &node);
+    }
+    return NULL;
+}
+
+static void test_exclusion(void) {
+    printf("\nMutual exclusion (8 threads):\n");
+    enum { THREADS = 8, ITERS = 20000 };
+
+    for (int kind = LK_TICKET; kind <= LK_RW_WRITE; kind++) {
+        any_init(&g_lock);
+        g_counter = 0;
+        g_inside = 0;
+        g_overlaps = 0;
+
+        pthread_t threads[THREADS];
+        mutex_arg_t args[THREADS];
+        for (uint32_t i = 0; i < THREADS; i++) {
+            args[i] = (mutex_arg_t){ i, kind, ITERS, 0 };
+            pthread_create(&threads[i], NULL, exclusion_thread, &args[i]);
+        }
+        for (uint32_t i = 0; i < THREADS; i++) {
+            pthread_join(threads[i], NULL);
+        }
+
+        char msg[96];
+        snprintf(msg, sizeof(msg), "%s: no overlap, no lost updates", lock_names[kind]);
+        TEST_ASSERT(g_overlaps == 0 && g_counter == (uint64_t)THREADS * ITERS, msg);
+    }
+    TEST_ASSERT(g_lock.qspin.val == 0 && g_lock.mcs.tail == NULL, "Queues empty afterwards");
+}
+
+/* ---- Queued spinlock ---- */
+
+static qspinlock_t g_outer, g_inner;
+static volatile uint64_t g_nested_a, g_nested_b;
+
+static void* nested_thread(void* arg) {
+    t_cpu_id = (uint32_t)(uintptr_t)arg;
+    for (int i = 0; i < 20000; i++) {
+        qspinlock_acquire(&g_outer);
+        g_nested_a++;
+        qspinlock_acquire(&g_inner);
+        g_nested_b++;
+        if ((i & 127) == 0) {
+            sched_yield();
+        }
+        qspinlock_release(&g_inner);
+        qspinlock_release(&g_outer);
+
+        /* Sometimes take only the inner lock, to queue on it alone */
+        if (i & 1) {
+            qspinlock_acquire(&g_inner);
+            g_nested_b++;
+            qspinlock_release(&g_inner);
+        }
+    }
+    return NULL;
+}
+
+static void test_qspinlock(void) {
+    printf("\nQueued spinlock:\n");
+    qspinlock_t lock;
+    qspinlock_init(&lock);
+
+    t_cpu_id = 0;
+    qspinlock_acquire(&lock);
+    TEST_ASSERT(lock.val == 1, "Uncontended acquire sets only the locked byte");
+    TEST_ASSERT(!qspinlock_try_acquire(&lock), "Trylock fails while held");
+    qspinlock_release(&lock);
+    TEST_ASSERT(lock.val == 0, "Release clears the word");
+    TEST_ASSERT(qspinlock_try_acquire(&lock), "Trylock succeeds when free");
+    qspinlock_release(&lock);
+    TEST_ASSERT(sizeof(qspinlock_t) <= 16 && sizeof(lock.val) == 4, "Lock state fits in 32 bits");
+
+    qspinlock_init(&g_outer);
+    qspinlock_init(&g_inner);
+    g_nested_a = 0;
+    g_nested_b = 0;
+    pthread_t threads[6];
+    for (uint32_t i = 0; i < 6; i++) {
+        pthread_create(&threads[i], NULL, nested_thread, (void*)(uintptr_t)i);
+    }
+    for (uint32_t i = 0; i < 6; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    TEST_ASSERT(g_nested_a == 6 * 20000 && g_nested_b == 6 * 30000,
+                "Nested queued locks under contention lose no updates");
+    TEST_ASSERT(g_outer.val == 0 && g_inner.val == 0, "Both locks free afterwards");
+}
+
+/* ---- Reader-writer lock ---- */
+
+static rwlock_t g_rw;
+static volatile uint64_t g_rw_a, g_rw_b;
+static volatile uint32_t g_torn;
+static volatile uint32_t g_readers_in, g_max_readers;
+static volatile int g_rw_stage;
+
+static void* rw_reader(void* arg) {
+    t_cpu_id = (uint32_t)(uintptr_t)arg;
+    for (int i = 0; i < 20000; i++) {
+        rwlock_read_acquire(&g_rw);
+        uint32_t in = __sync_add_and_fetch(&g_readers_in, 1);
+        if (in > g_max_readers) {
+            g_max_readers = in;
+        }
+        uint64_t a = g_rw_a;
+        if ((i & 63) == 0) {
+            sched_yield();
+        }
+        if (g_rw_b != a) {
+            g_torn++;
+        }
+        __sync_sub_and_fetch(&g_readers_in, 1);
+        rwlock_read_release(&g_rw);
+    }
+    return NULL;
+}
+
+static void* rw_writer(void* arg) {
+    t_cpu_id = (uint32_t)(uintptr_t)arg;
+    for (int i = 0; i < 5000; i++) {
+        rwlock_write_acquire(&g_rw);
+        if (g_readers_in) {
+            g_torn++;
+        }
+        g_rw_a++;
+        sched_yield();
+        g_rw_b++;
+        rwlock_write_release(&g_rw);
+    }
+    return NULL;
+}
+
+static void* rw_blocked_writer(void* arg) {
+    t_cpu_id = (uint32_t)(uintptr_t)arg;
+    rwlock_write_acquire(&g_rw);
+    g_rw_stage = 1;
+    rwlock_write_release(&g_rw);
+    return NULL;
+}
+
+static void test_rwlock(void) {
+    printf("\nReader-writer lock:\n");
+    rwlock_init(&g_rw);
+    t_cpu_id = 0;
+
+    rwlock_read_acquire(&g_rw);
+    rwlock_read_acquire(&g_rw);
+    TEST_ASSERT(g_rw.cnt == 2, "Readers share the lock");
+    rwlock_read_release(&g_rw);
+    rwlock_read_release(&g_rw);
+    rwlock_write_acquire(&g_rw);
+    TEST_ASSERT(g_rw.cnt == RWLOCK_WRITER, "Writer holds it alone");
+    rwlock_write_release(&g_rw);
+    TEST_ASSERT(g_rw.cnt == 0, "Free after the writer");
+
+    /* A waiting writer holds back new readers */
+    g_rw_stage = 0;
+    rwlock_read_acquire(&g_rw);
+    pthread_t w;
+    pthread_create(&w, NULL, rw_blocked_writer, (void*)(uintptr_t)1);
+    while (!(g_rw.cnt & RWLOCK_WAITING)) {
+        sched_yield();
+    }
+    TEST_ASSERT(g_rw_stage == 0, "Writer waits for the reader");
+    TEST_ASSERT(g_rw.cnt == (RWLOCK_WAITING | 1), "Waiting writer flags the lock");
+    rwlock_read_release(&g_rw);
+    pthread_join(w, NULL);
+    TEST_ASSERT(g_rw_stage == 1 && g_rw.cnt == 0, "Writer runs once the reader leaves");
+
+    g_rw_a = g_rw_b = 0;
+    g_torn = 0;
+    g_readers_in = 0;
+    g_max_readers = 0;
+    pthread_t threads[8];
+    for (uint32_t i = 0; i < 8; i++) {
+        pthread_create(&threads[i], NULL, i < 6 ? rw_reader : rw_writer, (void*)(uintptr_t)i);
+    }
+    for (uint32_t i = 0; i < 8; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    TEST_ASSERT(g_torn == 0, "Readers never see a half-done write");
+    TEST_ASSERT(g_rw_a == 10000 && g_rw_b == 10000, "Writers lose no updates");
+    TEST_ASSERT(g_max_readers > 1, "Readers overlapped each other");
+    TEST_ASSERT(g_rw.cnt == 0, "Lock free afterwards");
+}
+
+/* ---- Statistics ---- */
+
+static spinlock_t g_stat_lock;
+static qspinlock_t g_stat_qlock;
+
+static void* stat_thread(void* arg) {
+    t_cpu_id = (uint32_t)(uintptr_t)arg;
+    for (int i = 0; i < 2000; i++) {
+        spinlock_acquire(&g_stat_lock);
+        sched_yield();
+        spinlock_release(&g_stat_lock);
+    }
+    for (int i = 0; i < 2000; i++) {
+        qspinlock_acquire(&g_stat_qlock);
+        sched_yield();
+        qspinlock_release(&g_stat_qlock);
+    }
+    return NULL;
+}
+
+static void test_stats(void) {
+    printf("\nContention statistics:\n");
+    lock_stat_t st = {0}, qst = {0};
+    spinlock_init(&g_stat_lock);
+    qspinlock_init(&g_stat_qlock);
+    spinlock_set_stats(&g_stat_lock, &st);
+    qspinlock_set_stats(&g_stat_qlock, &qst);
+
+    t_cpu_id = 0;
+    for (int i = 0; i < 100; i++) {
+        spinlock_acquire(&g_stat_lock);
+        spinlock_release(&g_stat_lock);
+    }
+    TEST_ASSERT(st.acquisitions == 100 && st.contended == 0, "Uncontended acquisitions counted");
+    TEST_ASSERT(st.hold_cycles > 0 && st.max_hold_cycles <= st.hold_cycles, "Hold time measured");
+    spinlock_try_acquire(&g_stat_lock);
+    spinlock_release(&g_stat_lock);
+    TEST_ASSERT(st.acquisitions == 101, "Trylock counted");
+
+    st = (lock_stat_t){0};
+    pthread_t threads[4];
+    for (uint32_t i = 0; i < 4; i++) {
+        pthread_create(&threads[i], NULL, stat_thread, (void*)(uintptr_t)i);
+    }
+    for (uint32_t i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    printf("    ticket: %llu acquisitions, %llu contended, avg spin %llu cycles, max hold %llu\n",
+           (unsigned long long)st.acquisitions, (unsigned long long)st.contended,
+           (unsigned long long)(st.contended ? st.spin_cycles / st.contended : 0),
+           (unsigned long long)st.max_hold_cycles);
+    TEST_ASSERT(st.acquisitions == 8000 && qst.acquisitions == 8000, "Every acquisition counted");
+    TEST_ASSERT(st.contended > 0 && st.spin_cycles > 0, "Ticket lock contention recorded");
+    TEST_ASSERT(qst.contended > 0 && qst.max_spin_cycles > 0, "Queued lock contention recorded");
+    TEST_ASSERT(st.max_spin_cycles <= st.spin_cycles, "Max spin within the total");
+
+    spinlock_set_stats(&g_stat_lock, NULL);
+    spinlock_acquire(&g_stat_lock);
+    spinlock_release(&g_stat_lock);
+    TEST_ASSERT(st.acquisitions == 8000, "Detached statistics stop counting");
+}
+
+/* ---- Lock-order validation ---- */
+
+#ifdef ENABLE_LOCKDEP
+
+static lockdep_report_t g_report;
+static volatile uint32_t g_reports;
+static jmp_buf g_escape;
+static int g_escape_armed;
+
+static void report_handler(const lockdep_report_t* report) {
+    g_report = *report;
+    g_reports++;
+    if (g_escape_armed) {
+        g_escape_armed = 0;
+        longjmp(g_escape, 1);
+    }
+}
+
+static spinlock_t g_la, g_lb, g_lc;
+
+static void* order_ab(void* arg) {
+    t_cpu_id = (uint32_t)(uintptr_t)arg;
+    spinlock_acquire(&g_la);
+    spinlock_acquire(&g_lb);
+    spinlock_release(&g_lb);
+    spinlock_release(&g_la);
+    return NULL;
+}
+
+static void* order_ba(void* arg) {
+    t_cpu_id = (uint32_t)(uintptr_t)arg;
+    spinlock_acquire(&g_lb);
+    spinlock_acquire(&g_la);
+    spinlock_release(&g_la);
+    spinlock_release(&g_lb);
+    return NULL;
+}
+
+static void test_lockdep(void) {
+    printf("\nLock-order validation:\n");
+    lockdep_reset();
+    lockdep_set_handler(report_handler);
+    g_reports = 0;
+    spinlock_init(&g_la);
+    spinlock_init(&g_lb);
+    spinlock_init(&g_lc);
+
+    /* AB on one CPU, later BA on another: never actually deadlocks */
+    pthread_t t;
+    pthread_create(&t, NULL, order_ab, (void*)(uintptr_t)1);
+    pthread_join(t, NULL);
+    lockdep_stats_t st;
+    lockdep_get_stats(&st);
+    TEST_ASSERT(g_reports == 0 && st.dependencies == 1, "A then B records one ordering");
+    pthread_create(&t, NULL, order_ab, (void*)(uintptr_t)2);
+    pthread_join(t, NULL);
+    TEST_ASSERT(g_reports == 0, "Repeating the same order is fine");
+
+    pthread_create(&t, NULL, order_ba, (void*)(uintptr_t)3);
+    pthread_join(t, NULL);
+    TEST_ASSERT(g_reports == 1 && g_report.kind == LOCKDEP_INVERSION, "B then A is reported");
+    TEST_ASSERT(g_report.held == &g_lb && g_report.acquiring == &g_la && g_report.cpu == 3,
+                "Report names the locks and CPU");
+
+    /* Cycle through a third lock: A -> B, B -> C, then C -> A */
+    lockdep_reset();
+    g_reports = 0;
+    t_cpu_id = 0;
+    spinlock_acquire(&g_la);
+    spinlock_acquire(&g_lb);
+    spinlock_release(&g_lb);
+    spinlock_release(&g_la);
+    spinlock_acquire(&g_lb);
+    spinlock_acquire(&g_lc);
+    spinlock_release(&g_lc);
+    spinlock_release(&g_lb);
+    TEST_ASSERT(g_reports == 0, "A-B and B-C chain cleanly");
+    spinlock_acquire(&g_lc);
+    spinlock_acquire(&g_la);
+    spinlock_release(&g_la);
+    spinlock_release(&g_lc);
+    TEST_ASSERT(g_reports == 1 && g_report.kind == LOCKDEP_INVERSION, "C then A closes a three-lock cycle");
+
+    /* A trylock in the reverse order cannot deadlock */
+    lockdep_reset();
+    g_reports = 0;
+    spinlock_acquire(&g_la);
+    spinlock_acquire(&g_lb);
+    spinlock_release(&g_lb);
+    spinlock_release(&g_la);
+    spinlock_acquire(&g_lb);
+    int got = spinlock_try_acquire(&g_la);
+    if (got) {
+        spinlock_release(&g_la);
+    }
+    spinlock_release(&g_lb);
+    TEST_ASSERT(got && g_reports == 0, "Reverse-order trylock is not reported");
+
+    /* Per-CPU locks taken in index order, as runqueue balancing does */
+    lockdep_reset();
+    g_reports = 0;
+    static spinlock_t per_cpu[8];
+    for (int i = 0; i < 8; i++) {
+        spinlock_init(&per_cpu[i]);
+    }
+    for (int a = 0; a < 8; a++) {
+        for (int b = a + 1; b < 8; b++) {
+            spinlock_acquire(&per_cpu[a]);
+            spinlock_acquire(&per_cpu[b]);
+            spinlock_release(&per_cpu[b]);
+            spinlock_release(&per_cpu[a]);
+        }
+    }
+    lockdep_get_stats(&st);
+    TEST_ASSERT(g_reports == 0 && st.dependencies == 28 && st.locks == 8,
+                "Consistent index order: 28 orderings, no reports");
+
+    /* Mixed lock types share one graph; readers may nest */
+    lockdep_reset();
+    g_reports = 0;
+    qspinlock_t q;
+    rwlock_t rw;
+    mcs_lock_t m;
+    mcs_node_t node;
+    qspinlock_init(&q);
+    rwlock_init(&rw);
+    mcs_lock_init(&m);
+    rwlock_read_acquire(&rw);
+    rwlock_read_acquire(&rw);
+    qspinlock_acquire(&q);
+    qspinlock_release(&q);
+    rwlock_read_release(&rw);
+    rwlock_read_release(&rw);
+    TEST_ASSERT(g_reports == 0, "Recursive read holds are allowed");
+    qspinlock_acquire(&q);
+    mcs_lock_acquire(&m, &node);
+    mcs_lock_release(&m, &node);
+    qspinlock_release(&q);
+    TEST_ASSERT(g_reports == 0, "Orderings recorded across lock types");
+    lockdep_get_stats(&st);
+    TEST_ASSERT(st.dependencies == 2, "Two orderings: rw -> q -> mcs");
+    mcs_lock_acquire(&m, &node);
+    rwlock_write_acquire(&rw);
+    rwlock_write_release(&rw);
+    mcs_lock_release(&m, &node);
+    TEST_ASSERT(g_reports == 1 && g_report.kind == LOCKDEP_INVERSION && g_report.acquiring == &rw,
+                "mcs -> rw closes a cycle across lock types");
+
+    /* Taking a held lock again would spin forever; escape from the report */
+    lockdep_reset();
+    g_reports = 0;
+    spinlock_acquire(&g_la);
+    g_escape_armed = 1;
+    if (!setjmp(g_escape)) {
+        spinlock_acquire(&g_la);
+    }
+    TEST_ASSERT(g_reports == 1 && g_report.kind == LOCKDEP_RECURSION && g_report.acquiring == &g_la,
+                "Recursive acquisition reported before it spins");
+    spinlock_release(&g_la);
+
+    lockdep_reset();
+    g_reports = 0;
+    spinlock_init(&g_lc);
+    spinlock_acquire(&g_lc);
+    spinlock_release(&g_lc);
+    spinlock_release(&g_lc);
+    TEST_ASSERT(g_reports == 1 && g_report.kind == LOCKDEP_UNHELD, "Release of an unheld lock reported");
+    lockdep_get_stats(&st);
+    TEST_ASSERT(st.violations == 1 && st.last.kind == LOCKDEP_UNHELD, "Statistics keep the last violation");
+
+    lockdep_set_handler(NULL);
+    lockdep_reset();
+}
+
+#endif /* ENABLE_LOCKDEP */
+
+/* ---- Benchmarks ---- */
+
+static void bench_uncontended(void) {
+    printf("\nUncontended acquire + release (ns):\n");
+    enum { ITERS = 10000000 };
+    lock_stat_t st = {0};
+
+    for (int kind = 0; kind < LK_COUNT + 1; kind++) {
+        any_init(&g_lock);
+        int k = kind;
+        const char* name;
+        if (kind == LK_COUNT) {
+            spinlock_set_stats(&g_lock.ticket, &st);
+            k = LK_TICKET;
+            name = "ticket + stats";
+        } else {
+            name = lock_names[kind];
+        }
+        mcs_node_t node;
+        uint64_t t0 = now_ns();
+        for (uint32_t i = 0; i < ITERS; i++) {
+            any_acquire(&g_lock, k, &node);
+            __asm__ volatile("" ::: "memory");
+            any_release(&g_lock, k, &node);
+        }
+        uint64_t t1 = now_ns();
+        printf("  %-16s %6.2f\n", name, (double)(t1 - t0) / ITERS);
+    }
+
+    rwlock_init(&g_lock.rw);
+    uint64_t t0 = now_ns();
+    for (uint32_t i = 0; i < ITERS; i++) {
+        rwlock_read_acquire(&g_lock.rw);
+        __asm__ volatile("" ::: "memory");
+        rwlock_read_release(&g_lock.rw);
+    }
+    uint64_t t1 = now_ns();
+    printf("  %-16s %6.2f\n", "rwlock (read)", (double)(t1 - t0) / ITERS);
+}
+
+typedef struct {
+    uint32_t cpu;
+    int kind;
+    uint64_t count;
+} bench_arg_t;
+
+static volatile int g_go, g_stop;
+static volatile uint64_t g_shared[8];
+
+static void* bench_thread(void* arg) {
+    bench_arg_t* a = arg;
+    mcs_node_t node;
+    t_cpu_id = a->cpu;
+    uint64_t n = 0;
+    while (!g_go) {
+        sched_yield();
+    }
+    while (!g_stop) {
+        any_acquire(&g_lock, a->kind, &node);
+        for (int i = 0; i < 8; i++) {
+            g_shared[i]++;
+        }
+        any_release(&g_lock, a->kind, &node);
+        for (int i = 0; i < 32; i++) {
+            __asm__ volatile("" ::: "memory");
+        }
+        n++;
+    }
+    a->count = n;
+    return NULL;
+}
+
+static void bench_contended_run(int kind, uint32_t nthreads, double* mops, double* jain) {
+    any_init(&g_lock);
+    g_go = 0;
+    g_stop = 0;
+    pthread_t threads[MAX_CPUS];
+    bench_arg_t args[MAX_CPUS];
+    for (uint32_t i = 0; i < nthreads; i++) {
+        args[i] = (bench_arg_t){ i, kind, 0 };
+        pthread_create(&threads[i], NULL, bench_thread, &args[i]);
+    }
+    uint64_t t0 = now_ns();
+    g_go = 1;
+    struct timespec dur = { 0, 200 * 1000000L };
+    nanosleep(&dur, NULL);
+    g_stop = 1;
+    for (uint32_t i = 0; i < nthreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    uint64_t elapsed = now_ns() - t0;
+
+    double sum = 0, sq = 0;
+    for (uint32_t i = 0; i < nthreads; i++) {
+        sum += (double)args[i].count;
+        sq += (double)args[i].count * (double)args[i].count;
+    }
+    *mops = sum * 1e3 / (double)elapsed;
+    *jain = sq > 0 ? sum * sum / (nthreads * sq) : 1.0;
+}
+
+static void bench_contended(void) {
+    printf("\nContended throughput, M acquisitions/s (Jain fairness), %ld host CPUs:\n", g_host_cpus);
+    if (g_host_cpus < 2) {
+        printf("  (one host CPU: waiters yield instead of spinning, so this measures\n"
+               "   hand-off under preemption rather than cache-line traffic)\n");
+    }
+    static const int kinds[] = { LK_TTAS, LK_TICKET, LK_QSPIN, LK_MCS, LK_MUTEX };
+    printf("  %-8s", "threads");
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        printf(" %18s", lock_names[kinds[k]]);
+    }
+    printf("\n");
+
+    static const uint32_t counts[] = { 1, 2, 4, 8, 16 };
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        printf("  %-8u", counts[c]);
+        for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+            double mops, jain;
+            bench_contended_run(kinds[k], counts[c], &mops, &jain);
+            printf("    %6.2f (%5.3f)", mops, jain);
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+    g_host_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+#ifdef ENABLE_LOCKDEP
+    printf("=== Aurora OS Spinlock Tests (lockdep) ===\n");
+#else
+    printf("=== Aurora OS Spinlock Tests ===\n");
+#endif
+
+    test_ticket();
+    test_exclusion();
+    test_qspinlock();
+    test_rwlock();
+    test_stats();
+#ifdef ENABLE_LOCKDEP
+    test_lockdep();
+#endif
+
+    if (bench) {
+        printf("\n=== Benchmarks ===\n");
+        bench_uncontended();
+        bench_contended();
+    }
+
+    printf("\n========================================\n");
+    printf("Passed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
@@ -0,0 +1,628 @@
+/**
+ * Aurora OS - Swap and Page Reclaim Tests
+ *
+ * Host-built harness for kernel/memory/swap.c and the reclaim path in
+ * kernel/memory/paging.c. Physical memory is a small MAP_32BIT buddy zone
+ * (so address spaces can be several times larger than RAM), the swap
+ * device is a temporary file written with pwritev(), and user processes
+ * run against a simulated MMU that sets accessed/dirty bits and raises
+ * faults like the hardware would. Covers swap entries, batched writeout,
+ * CLOCK second chances, fork with swapped pages, watermarks and a
+ * memory-pressure workload with data verification. With --bench, compares
+ * batched against page-at-a-time writeout on a device with per-request
+ * latency and measures an overcommitted hot/cold workload.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include "../../kernel/memory/paging.h"
+#include "../../kernel/memory/swap.h"
+#include "../../kernel/memory/slab.h"
+#include "../../kernel/process/process.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/* 4 MB of "RAM" for user pages, 64 MB of swap */
+#define PHYS_FRAMES     1024u
+#define SWAP_SLOTS      16384u
+#define HEAP_BYTES      (16u * 1024 * 1024)
+
+#define USER_BASE       0x40000000u
+
+static buddy_frame_t g_meta[PHYS_FRAMES];
+static buddy_zone_t g_zone;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* ---- Kernel service stubs, mirroring memory.c ---- */
+
+void* kmalloc(size_t size) { return slab_alloc(size); }
+void kfree(void* ptr) { slab_free(ptr); }
+
+static void* pfn_address(uint32_t pfn) {
+    return (void*)((uintptr_t)pfn * PAGE_SIZE);
+}
+
+void* frame_alloc(uint32_t order) {
+    swap_pressure(g_zone.free_frames, 1u << order);
+    uint32_t pfn = buddy_alloc(&g_zone, order);
+    if (pfn == BUDDY_INVALID && swap_direct_reclaim(1u << order)) {
+        pfn = buddy_alloc(&g_zone, order);
+    }
+    return pfn == BUDDY_INVALID ? NULL : pfn_address(pfn);
+}
+
+int frame_free(void* addr) { return buddy_free(&g_zone, (uint32_t)((uintptr_t)addr / PAGE_SIZE)); }
+uint32_t frame_get(uint32_t phys_addr) { return buddy_frame_get(&g_zone, phys_addr / PAGE_SIZE); }
+uint32_t frame_put(uint32_t phys_addr) { return buddy_frame_put(&g_zone, phys_addr / PAGE_SIZE); }
+uint32_t frame_refcount(uint32_t phys_addr) { return buddy_frame_refs(&g_zone, phys_addr / PAGE_SIZE); }
+int frame_exclusive(uint32_t phys_addr) { return buddy_frame_exclusive(&g_zone, phys_addr / PAGE_SIZE); }
+void memory_get_frame_stats(buddy_stats_t* stats) { buddy_get_stats(&g_zone, stats); }
+
+void* vm_alloc(size_t size, uint32_t flags) {
+    (void)flags;
+    uint32_t pfn = buddy_alloc_contig(&g_zone, (uint32_t)((size + PAGE_SIZE - 1) / PAGE_SIZE));
+    return pfn == BUDDY_INVALID ? NULL : pfn_address(pfn);
+}
+
+void vm_free(void* ptr) { frame_free(ptr); }
+
+static int g_kswapd_started;
+
+process_t* process_create(void (*entry)(void), uint32_t priority) {
+    (void)entry;
+    (void)priority;
+    g_kswapd_started = 1;
+    return NULL;
+}
+
+int process_wait_event_until(volatile uint32_t* event, uint64_t deadline_us) {
+    (void)event;
+    (void)deadline_us;
+    return -1;
+}
+
+void process_post_event(process_t* process, volatile uint32_t* event) {
+    (void)process;
+    *event = 1;
+}
+
+/* ---- File-backed swap device ---- */
+
+static struct {
+    int fd;
+    uint64_t requests;
+    uint64_t latency_ns;        /* Simulated per-request device latency */
+    int fail_writes;
+} g_dev;
+
+static void device_delay(void) {
+    if (g_dev.latency_ns) {
+        uint64_t until = now_ns() + g_dev.latency_ns;
+        while (now_ns() < until) {
+        }
+    }
+}
+
+static int file_read(void* ctx, uint32_t slot, void* page) {
+    (void)ctx;
+    g_dev.requests++;
+    device_delay();
+    return pread(g_dev.fd, page, PAGE_SIZE, (off_t)slot * PAGE_SIZE) == PAGE_SIZE ? 0 : -1;
+}
+
+static int file_write(void* ctx, uint32_t slot, void* const* pages, uint32_t count) {
+    (void)ctx;
+    struct iovec iov[SWAP_BATCH];
+    if (g_dev.fail_writes || count > SWAP_BATCH) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        iov[i].iov_base = pages[i];
+        iov[i].iov_len = PAGE_SIZE;
+    }
+    g_dev.requests++;
+    device_delay();
+    ssize_t n = pwritev(g_dev.fd, iov, (int)count, (off_t)slot * PAGE_SIZE);
+    return n == (ssize_t)count * PAGE_SIZE ? 0 : -1;
+}
+
+/* ---- Simulated MMU ---- */
+
+static uint64_t g_faults;
+
+static uint32_t* lookup_pte(page_directory_t* dir, uint32_t va) {
+    uint32_t pde = (*dir)[va >> 22];
+    if (!(pde & PAGE_PRESENT)) {
+        return NULL;
+    }
+    page_table_t* table = (page_table_t*)(uintptr_t)(pde & ~0xFFF);
+    return &(*table)[(va >> 12) & 0x3FF];
+}
+
+/**
+ * Access a word through the MMU, faulting the page in (or breaking COW)
+ * and setting the accessed and dirty bits
+ */
+static uint32_t* proc_access(page_directory_t* dir, uint32_t va, int write) {
+    uint32_t* pte = lookup_pte(dir, va);
+    if (!pte) {
+        return NULL;
+    }
+    /* A write to a swapped COW page faults twice: swap-in, then COW */
+    for (int tries = 0; tries < 3; tries++) {
+        int present = *pte & PAGE_PRESENT;
+        if (present && (!write || (*pte & PAGE_WRITE))) {
+            *pte |= PAGE_ACCESSED | (write ? PAGE_DIRTY : 0);
+            return (uint32_t*)(uintptr_t)((*pte & ~0xFFF) | (va & 0xFFC));
+        }
+        g_faults++;
+        paging_switch_directory(dir);
+        page_fault_handler(va, (present ? 0x1 : 0) | (write ? 0x2 : 0) | 0x4);
+    }
+    return NULL;
+}
+
+static int proc_write(page_directory_t* dir, uint32_t va, uint32_t value) {
+    uint32_t* p = proc_access(dir, va, 1);
+    if (!p) {
+        return -1;
+    }
+    *p = value;
+    return 0;
+}
+
+static uint32_t proc_read(page_directory_t* dir, uint32_t va) {
+    uint32_t* p = proc_access(dir, va, 0);
+    return p ? *p : 0xDEADDEAD;
+}
+
+static page_directory_t* g_kernel_dir;
+
+/**
+ * Create a process whose pages each hold seed + index in every word;
+ * the accessed bits are left clear
+ */
+static page_directory_t* make_process(uint32_t pages, uint32_t seed) {
+    page_directory_t* dir = paging_create_directory();
+    (*dir)[0] = (*g_kernel_dir)[0];
+
+    for (uint32_t i = 0; i < pages; i++) {
+        uint32_t* frame = frame_alloc(0);
+        if (!frame) {
+            return NULL;
+        }
+        for (uint32_t j = 0; j < PAGE_SIZE / 4; j++) {
+            frame[j] = seed + i;
+        }
+        paging_map_page(dir, USER_BASE + i * PAGE_SIZE, (uint32_t)(uintptr_t)frame,
+                        PAGE_PRESENT | PAGE_WRITE | PAGE_USER);
+    }
+    return dir;
+}
+
+static void clear_accessed(page_directory_t* dir, uint32_t pages) {
+    for (uint32_t i = 0; i < pages; i++) {
+        uint32_t* pte = lookup_pte(dir, USER_BASE + i * PAGE_SIZE);
+        *pte &= ~PAGE_ACCESSED;
+    }
+}
+
+static uint32_t used_slots(void) {
+    swap_stats_t ss;
+    swap_get_stats(&ss);
+    return ss.used_slots;
+}
+
+/* ---- Tests ---- */
+
+static void test_swap_entries(void) {
+    printf("\nSwap entries:\n");
+    uint32_t free_start = g_zone.free_frames;
+    page_directory_t* dir = make_process(8, 100);
+    uint32_t va = USER_BASE + 3 * PAGE_SIZE;
+
+    paging_switch_directory(dir);
+    TEST_ASSERT(page_swap_out(va) == 0, "Page swaps out");
+    uint32_t pte = *lookup_pte(dir, va);
+    TEST_ASSERT(!(pte & PAGE_PRESENT) && (pte & PAGE_SWAPPED) && (pte & PAGE_WRITE) && (pte & PAGE_USER),
+                "Entry is non-present, marked swapped and keeps its permissions");
+    TEST_ASSERT(used_slots() == 1 && g_zone.free_frames == free_start - 7, "One slot used, frame freed");
+    TEST_ASSERT(paging_get_physical_address(dir, va) == 0, "Swapped page has no physical address");
+
+    paging_reclaim_stats_t rs;
+    paging_get_reclaim_stats(&rs);
+    uint64_t ins = rs.swap_ins;
+    TEST_ASSERT(proc_read(dir, va + 40) == 103, "Fault brings the data back");
+    paging_get_reclaim_stats(&rs);
+    pte = *lookup_pte(dir, va);
+    TEST_ASSERT(rs.swap_ins == ins + 1 && (pte & PAGE_PRESENT) && (pte & PAGE_WRITE) && !(pte & PAGE_SWAPPED),
+                "Entry is present and writable again");
+    TEST_ASSERT(used_slots() == 0, "Slot freed on swap-in");
+
+    TEST_ASSERT(page_swap_out(USER_BASE + 100 * PAGE_SIZE) == -1, "Unmapped page cannot be swapped out");
+    TEST_ASSERT(paging_swap_out(dir, 0x1000) == -1, "Kernel pages are never swapped");
+
+    /* Unmapping a swapped page releases its slot */
+    paging_swap_out(dir, va);
+    paging_unmap_page(dir, va);
+    TEST_ASSERT(used_slots() == 0, "Unmapping a swapped page frees its slot");
+
+    paging_destroy_directory(dir);
+    TEST_ASSERT(g_zone.free_frames == free_start, "No frames leak");
+}
+
+static void test_batched_reclaim(void) {
+    printf("\nBatched reclaim:\n");
+    uint32_t free_start = g_zone.free_frames;
+    page_directory_t* dir = make_process(64, 0);
+
+    swap_stats_t before, after;
+    swap_get_stats(&before);
+    uint32_t freed = paging_reclaim(64);
+    swap_get_stats(&after);
+    TEST_ASSERT(freed == 64 && g_zone.free_frames == free_start, "Reclaim evicts unreferenced pages");
+    TEST_ASSERT(after.write_requests - before.write_requests == 64 / SWAP_BATCH,
+                "Each batch reaches the device as one write");
+
+    uint32_t first = *lookup_pte(dir, USER_BASE) >> 12;
+    int sequential = 1;
+    for (uint32_t i = 1; i < 64; i++) {
+        if ((*lookup_pte(dir, USER_BASE + i * PAGE_SIZE) >> 12) != first + i) {
+            sequential = 0;
+        }
+    }
+    TEST_ASSERT(sequential, "Pages evicted together occupy consecutive slots");
+
+    int ok = 1;
+    for (uint32_t i = 0; i < 64; i++) {
+        if (proc_read(dir, USER_BASE + i * PAGE_SIZE + 4 * (i % 1024)) != i) {
+            ok = 0;
+        }
+    }
+    TEST_ASSERT(ok && used_slots() == 0, "Every page reads back intact");
+
+    paging_destroy_directory(dir);
+    TEST_ASSERT(g_zone.free_frames == free_start, "No frames leak");
+}
+
+static void test_clock(void) {
+    printf("\nCLOCK second chance:\n");
+    page_directory_t* dir = make_process(64, 0);
+
+    /* Touch the even pages */
+    for (uint32_t i = 0; i < 64; i += 2) {
+        proc_read(dir, USER_BASE + i * PAGE_SIZE);
+    }
+
+    paging_reclaim_stats_t before, after;
+    paging_get_reclaim_stats(&before);
+    uint32_t freed = paging_reclaim(32);
+    paging_get_reclaim_stats(&after);
+
+    int odd_only = 1;
+    for (uint32_t i = 0; i < 64; i++) {
+        uint32_t pte = *lookup_pte(dir, USER_BASE + i * PAGE_SIZE);
+        if ((i & 1) != !(pte & PAGE_PRESENT)) {
+            odd_only = 0;
+        }
+    }
+    TEST_ASSERT(freed == 32 && odd_only, "Referenced pages survive, unreferenced ones are evicted");
+    TEST_ASSERT(after.referenced - before.referenced >= 32, "Accessed bits are consumed as second chances");
+
+    int cleared = 1;
+    for (uint32_t i = 0; i < 64; i += 2) {
+        if (*lookup_pte(dir, USER_BASE + i * PAGE_SIZE) & PAGE_ACCESSED) {
+            cleared = 0;
+        }
+    }
+    TEST_ASSERT(cleared, "Hand clears the accessed bit as it passes");
+
+    freed = paging_reclaim(32);
+    TEST_ASSERT(freed == 32, "Pages not re-referenced go on the next pass");
+
+    paging_destroy_directory(dir);
+    TEST_ASSERT(used_slots() == 0, "Exit frees all swap slots");
+}
+
+static void test_fork(void) {
+    printf("\nFork and sharing:\n");
+    uint32_t free_start = g_zone.free_frames;
+    page_directory_t* parent = make_process(16, 500);
+    page_directory_t* child = paging_clone_directory(parent);
+
+    paging_reclaim_stats_t before, after;
+    paging_get_reclaim_stats(&before);
+    TEST_ASSERT(paging_reclaim(16) == 0, "COW-shared frames are not evicted");
+    paging_get_reclaim_stats(&after);
+    TEST_ASSERT(after.skipped > before.skipped, "Shared frames are counted as skipped");
+    paging_destroy_directory(child);
+
+    /* Swapped entries are shared by a fork */
+    clear_accessed(parent, 16);
+    TEST_ASSERT(paging_reclaim(16) == 16, "Sole owner's pages are evictable after the child exits");
+    child = paging_clone_directory(parent);
+    uint32_t va = USER_BASE + 7 * PAGE_SIZE;
+    TEST_ASSERT(used_slots() == 16 && *lookup_pte(child, va) == *lookup_pte(parent, va),
+                "Fork shares swap slots without reading them");
+
+    proc_write(child, va, 0xAB);
+    TEST_ASSERT(proc_read(child, va) == 0xAB && proc_read(child, va + 4) == 507,
+                "Child swaps in a private copy");
+    TEST_ASSERT(!(*lookup_pte(parent, va) & PAGE_PRESENT) && used_slots() == 16,
+                "Parent's entry and the slot are untouched");
+    TEST_ASSERT(proc_read(parent, va) == 507, "Parent swaps in the original data");
+    TEST_ASSERT(used_slots() == 15, "Slot freed when both entries are gone");
+
+    paging_destroy_directory(child);
+    paging_destroy_directory(parent);
+    TEST_ASSERT(used_slots() == 0 && g_zone.free_frames == free_start,
+                "No slots or frames leak");
+}
+
+static void test_failures(void) {
+    printf("\nFailure handling:\n");
+    uint32_t free_start = g_zone.free_frames;
+    page_directory_t* dir = make_process(32, 0);
+
+    g_dev.fail_writes = 1;
+    swap_stats_t ss;
+    TEST_ASSERT(paging_reclaim(32) == 0, "Device write error evicts nothing");
+    swap_get_stats(&ss);
+    int intact = 1;
+    for (uint32_t i = 0; i < 32; i++) {
+        if (!(*lookup_pte(dir, USER_BASE + i * PAGE_SIZE) & PAGE_PRESENT)) {
+            intact = 0;
+        }
+    }
+    TEST_ASSERT(intact && ss.used_slots == 0 && ss.write_errors > 0,
+                "Entries stay present and slots are released");
+    g_dev.fail_writes = 0;
+
+    /* Fill swap with slots held by a fake consumer */
+    static void* pages[SWAP_BATCH];
+    static uint32_t slots[SWAP_SLOTS];
+    for (uint32_t i = 0; i < SWAP_BATCH; i++) {
+        pages[i] = pfn_address(g_zone.base_pfn);
+    }
+    uint32_t held = 0;
+    while (held + SWAP_BATCH <= SWAP_SLOTS - 8 && swap_write_pages(pages, SWAP_BATCH, slots + held) == 0) {
+        held += SWAP_BATCH;
+    }
+    while (held < SWAP_SLOTS - 8 && swap_write_pages(pages, 1, slots + held) == 0) {
+        held++;
+    }
+    TEST_ASSERT(swap_write_pages(pages, 16, slots + held) == -1 && used_slots() == held,
+                "A batch larger than the free space fails without taking slots");
+    TEST_ASSERT(paging_reclaim(32) == 8, "Reclaim stops when swap is full");
+    TEST_ASSERT(paging_reclaim(32) == 0, "Full swap reclaims nothing further");
+    for (uint32_t i = 0; i < held; i++) {
+        swap_slot_put(slots[i]);
+    }
+
+    paging_destroy_directory(dir);
+    TEST_ASSERT(used_slots() == 0 && g_zone.free_frames == free_start, "No slots or frames leak");
+}
+
+static void test_watermarks(void) {
+    printf("\nWatermarks:\n");
+    uint32_t free_start = g_zone.free_frames;
+    swap_set_watermarks(32, 64, 128);
+    swap_stats_t before, after;
+    swap_get_stats(&before);
+
+    /* Fill memory down to just above min */
+    page_directory_t* dir = make_process(free_start - 40, 0);
+    swap_get_stats(&after);
+    TEST_ASSERT(dir && swap_kswapd_pending() && after.kswapd_wakeups == before.kswapd_wakeups + 1,
+                "Dropping below low wakes kswapd once");
+    TEST_ASSERT(after.direct_reclaims == before.direct_reclaims, "No direct reclaim above min");
+
+    swap_balance();
+    TEST_ASSERT(!swap_kswapd_pending() && g_zone.free_frames >= 128, "kswapd reclaims up to high");
+
+    /* Allocating far past physical memory falls back to direct reclaim */
+    page_directory_t* big = make_process(PHYS_FRAMES * 2, 7);
+    swap_get_stats(&after);
+    TEST_ASSERT(big != NULL, "Allocation beyond RAM succeeds by swapping");
+    TEST_ASSERT(after.direct_reclaims > before.direct_reclaims, "Allocations below min reclaim directly");
+
+    paging_destroy_directory(big);
+    paging_destroy_directory(dir);
+    TEST_ASSERT(used_slots() == 0 && g_zone.free_frames == free_start, "No slots or frames leak");
+}
+
+/**
+ * Memory-pressure workload: an address space four times the size of RAM,
+ * with random reads and writes checked against a shadow copy
+ */
+static void test_pressure(void) {
+    printf("\nMemory pressure:\n");
+    uint32_t free_start = g_zone.free_frames;
+    enum { PAGES = PHYS_FRAMES * 4, OPS = 200000 };
+    swap_set_watermarks(16, 32, 64);
+
+    page_directory_t* dir = make_process(PAGES, 0);
+    static uint32_t shadow[PAGES];
+    for (uint32_t i = 0; i < PAGES; i++) {
+        shadow[i] = i;
+    }
+
+    /* Word 0 of each page is rewritten, the last word keeps its initial value */
+    uint32_t seed = 12345;
+    int ok = dir != NULL;
+    for (uint32_t op = 0; op < OPS && ok; op++) {
+        seed = seed * 1103515245u + 12345u;
+        uint32_t page = (seed >> 8) % PAGES;
+        uint32_t va = USER_BASE + page * PAGE_SIZE;
+        if (seed & 0x10000) {
+            shadow[page] = seed;
+            ok = proc_write(dir, va, seed) == 0;
+        } else {
+            ok = proc_read(dir, va) == shadow[page];
+        }
+        if (swap_kswapd_pending()) {
+            swap_balance();
+        }
+    }
+    TEST_ASSERT(ok, "Random reads over 4x RAM see the latest writes");
+
+    int intact = 1;
+    for (uint32_t i = 0; i < PAGES && intact; i++) {
+        uint32_t va = USER_BASE + i * PAGE_SIZE;
+        if (proc_read(dir, va) != shadow[i] || proc_read(dir, va + PAGE_SIZE - 4) != i) {
+            intact = 0;
+        }
+    }
+    TEST_ASSERT(intact, "Every page holds its last written value");
+
+    paging_reclaim_stats_t rs;
+    paging_get_reclaim_stats(&rs);
+    TEST_ASSERT(rs.evicted > PAGES && rs.swap_ins > PAGES, "Workload cycles pages through swap");
+
+    paging_destroy_directory(dir);
+    TEST_ASSERT(used_slots() == 0 && g_zone.free_frames == free_start, "No slots or frames leak");
+}
+
+/* ---- Benchmarks ---- */
+
+static void run_benchmarks(void) {
+    printf("\nBenchmarks:\n");
+    g_dev.latency_ns = 50000;    /* 50 us per device request */
+    swap_set_watermarks(16, 32, 64);
+
+    enum { PAGES = 512 };
+    page_directory_t* dir = make_process(PAGES, 0);
+    uint64_t req = g_dev.requests;
+    uint64_t t0 = now_ns();
+    for (uint32_t i = 0; i < PAGES; i++) {
+        paging_swap_out(dir, USER_BASE + i * PAGE_SIZE);
+    }
+    uint64_t single_ns = now_ns() - t0;
+    uint64_t single_req = g_dev.requests - req;
+    for (uint32_t i = 0; i < PAGES; i++) {
+        proc_read(dir, USER_BASE + i * PAGE_SIZE);
+    }
+    clear_accessed(dir, PAGES);
+
+    req = g_dev.requests;
+    t0 = now_ns();
+    paging_reclaim(PAGES);
+    uint64_t batch_ns = now_ns() - t0;
+    uint64_t batch_req = g_dev.requests - req;
+    paging_destroy_directory(dir);
+
+    printf("    Writeout of %u pages at 50 us/request:\n", PAGES);
+    printf("      page at a time: %8.1f ms  %5llu requests  %8.0f pages/s\n", single_ns / 1e6,
+           (unsigned long long)single_req, PAGES / (single_ns / 1e9));
+    printf("      batched (%2u):   %8.1f ms  %5llu requests  %8.0f pages/s\n", SWAP_BATCH,
+           batch_ns / 1e6, (unsigned long long)batch_req, PAGES / (batch_ns / 1e9));
+
+    /* Hot/cold workload: 90% of accesses to a hot set that fits in RAM */
+    g_dev.latency_ns = 0;
+    enum { SPACE = PHYS_FRAMES * 4, HOT = PHYS_FRAMES / 2, OPS = 1000000 };
+    dir = make_process(SPACE, 0);
+    paging_reclaim_stats_t a, b;
+    paging_get_reclaim_stats(&a);
+    uint64_t faults = g_faults;
+    uint32_t seed = 99;
+    t0 = now_ns();
+    for (uint32_t op = 0; op < OPS; op++) {
+        seed = seed * 1103515245u + 12345u;
+        uint32_t page = (seed % 10) ? (seed >> 8) % HOT : HOT + (seed >> 8) % (SPACE - HOT);
+        proc_write(dir, USER_BASE + page * PAGE_SIZE, op);
+        if (swap_kswapd_pending()) {
+            swap_balance();
+        }
+    }
+    uint64_t ns = now_ns() - t0;
+    paging_get_reclaim_stats(&b);
+    printf("    Hot/cold workload, %u MB space over %u MB RAM, 90%% to a %u MB hot set:\n",
+           SPACE / 256, PHYS_FRAMES / 256, HOT / 256);
+    printf("      %.0f accesses/s, %.2f%% faulted, %llu evicted, %llu swapped in\n",
+           OPS / (ns / 1e9), 100.0 * (double)(g_faults - faults) / OPS,
+           (unsigned long long)(b.evicted - a.evicted), (unsigned long long)(b.swap_ins - a.swap_ins));
+    paging_destroy_directory(dir);
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("Swap and Page Reclaim Tests\n");
+    printf("===========================\n");
+
+    /* Frames must sit below 4 GB and on a 4 MB boundary for the zone */
+    size_t phys_bytes = (size_t)PHYS_FRAMES * PAGE_SIZE;
+    size_t span = phys_bytes + HEAP_BYTES + (4u << 20);
+    uint8_t* mem = mmap(NULL, span, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (mem == MAP_FAILED) {
+        printf("Cannot map simulated physical memory below 4 GB\n");
+        return 1;
+    }
+    uintptr_t phys_base = ((uintptr_t)mem + (4u << 20) - 1) & ~(uintptr_t)((4u << 20) - 1);
+    buddy_init(&g_zone, g_meta, (uint32_t)(phys_base / PAGE_SIZE), PHYS_FRAMES);
+    buddy_add_range(&g_zone, (uint32_t)(phys_base / PAGE_SIZE), PHYS_FRAMES);
+    slab_init((uint8_t*)phys_base + phys_bytes, HEAP_BYTES);
+
+    paging_init();
+    g_kernel_dir = paging_get_current_directory();
+
+    FILE* file = tmpfile();
+    if (!file) {
+        printf("Cannot create swap file\n");
+        return 1;
+    }
+    g_dev.fd = fileno(file);
+
+    swap_device_t dev = { SWAP_SLOTS, NULL, file_read, file_write };
+    printf("\nSetup:\n");
+    TEST_ASSERT(swap_init(&dev) == 0 && swap_active(), "File-backed swap device activates");
+    TEST_ASSERT(swap_init(&dev) == -1, "Second device is refused");
+    swap_start_kswapd();
+    TEST_ASSERT(g_kswapd_started, "kswapd is started once swap is active");
+
+    swap_stats_t ss;
+    swap_get_stats(&ss);
+    TEST_ASSERT(ss.total_slots == SWAP_SLOTS && ss.wmark_min < ss.wmark_low && ss.wmark_low < ss.wmark_high,
+                "Default watermarks are ordered");
+
+    test_swap_entries();
+    test_batched_reclaim();
+    test_clock();
+    test_fork();
+    test_failures();
+    test_watermarks();
+    test_pressure();
+
+    if (bench) {
+        run_benchmarks();
+    }
+
+    fclose(file);
+    munmap(mem, span);
+
+    printf("\nPassed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
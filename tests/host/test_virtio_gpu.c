@@ -0,0 +1,377 @@
+/**
+ * Aurora OS - VirtIO GPU 2D Device Model Tests
+ *
+ * Host-built harness for virtio_gpu_process_command() in gpu_passthrough.c.
+ * Plays the guest driver: creates resources, attaches scattered backing,
+ * transfers and flushes damaged rectangles and checks the scanout
+ * framebuffer pixel for pixel. With --bench, measures frames per second
+ * for a guest repainting partial regions of a 1080p scanout.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../include/platform/virtio_gpu.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/* ---- GPU API (no public header) ---- */
+
+int gpu_init(void);
+int gpu_passthrough_set_display_mode(uint32_t gpu_id, uint32_t display_id,
+                                     uint32_t width, uint32_t height, uint32_t refresh);
+int gpu_set_framebuffer(uint32_t gpu_id, uint32_t display_id, uint64_t fb_addr, uint32_t fb_size);
+
+/* ---- Guest driver helpers ---- */
+
+static uint64_t g_last_fence = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Submit a command, return the response type */
+static uint32_t submit(void* cmd, uint32_t size) {
+    virtio_gpu_resp_display_info_t resp;
+    uint32_t resp_size = sizeof(resp);
+    virtio_gpu_ctrl_hdr_t* hdr = (virtio_gpu_ctrl_hdr_t*)cmd;
+    if (virtio_gpu_process_command(0, hdr->type, cmd, size, &resp, &resp_size) < 0) {
+        return 0;
+    }
+    g_last_fence = resp.hdr.fence_id;
+    return resp.hdr.type;
+}
+
+static uint32_t create_2d(uint32_t id, uint32_t format, uint32_t w, uint32_t h) {
+    virtio_gpu_resource_create_2d_t cmd = {
+        .hdr.type = VIRTIO_GPU_CMD_RESOURCE_CREATE_2D,
+        .resource_id = id, .format = format, .width = w, .height = h
+    };
+    return submit(&cmd, sizeof(cmd));
+}
+
+/* Attach backing split into nr pieces of uneven size */
+static uint32_t attach_backing(uint32_t id, uint8_t* mem, uint32_t size, uint32_t nr, uint8_t** pieces) {
+    struct {
+        virtio_gpu_resource_attach_backing_t hdr;
+        virtio_gpu_mem_entry_t entries[8];
+    } cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.hdr.hdr.type = VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING;
+    cmd.hdr.resource_id = id;
+    cmd.hdr.nr_entries = nr;
+
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < nr; i++) {
+        uint32_t len = (i == nr - 1) ? size - offset : size / nr + 13 * (i + 1);
+        /* Each piece lives in its own allocation to prove scatter works */
+        pieces[i] = malloc(len);
+        memcpy(pieces[i], mem + offset, len);
+        cmd.entries[i].addr = (uint64_t)(uintptr_t)pieces[i];
+        cmd.entries[i].length = len;
+        offset += len;
+    }
+    return submit(&cmd, sizeof(cmd.hdr) + nr * sizeof(virtio_gpu_mem_entry_t));
+}
+
+static uint32_t set_scanout(uint32_t scanout, uint32_t id, uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+    virtio_gpu_set_scanout_t cmd = {
+        .hdr.type = VIRTIO_GPU_CMD_SET_SCANOUT,
+        .r = { x, y, w, h }, .scanout_id = scanout, .resource_id = id
+    };
+    return submit(&cmd, sizeof(cmd));
+}
+
+static uint32_t transfer(uint32_t id, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t res_width) {
+    virtio_gpu_transfer_to_host_2d_t cmd = {
+        .hdr.type = VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D,
+        .r = { x, y, w, h },
+        .offset = ((uint64_t)y * res_width + x) * 4,
+        .resource_id = id
+    };
+    return submit(&cmd, sizeof(cmd));
+}
+
+static uint32_t flush(uint32_t id, uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+    virtio_gpu_resource_flush_t cmd = {
+        .hdr.type = VIRTIO_GPU_CMD_RESOURCE_FLUSH,
+        .r = { x, y, w, h }, .resource_id = id
+    };
+    return submit(&cmd, sizeof(cmd));
+}
+
+static uint32_t unref(uint32_t id) {
+    virtio_gpu_resource_unref_t cmd = { .hdr.type = VIRTIO_GPU_CMD_RESOURCE_UNREF, .resource_id = id };
+    return submit(&cmd, sizeof(cmd));
+}
+
+/* Compare a framebuffer rectangle against the guest image */
+static int rect_matches(const uint32_t* fb, uint32_t fb_pitch, uint32_t fx, uint32_t fy,
+                        const uint32_t* img, uint32_t img_pitch, uint32_t ix, uint32_t iy,
+                        uint32_t w, uint32_t h) {
+    for (uint32_t y = 0; y < h; y++) {
+        if (memcmp(fb + (fy + y) * fb_pitch + fx, img + (iy + y) * img_pitch + ix, w * 4) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int rect_is(const uint32_t* fb, uint32_t pitch, uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                   uint32_t value) {
+    for (uint32_t j = 0; j < h; j++) {
+        for (uint32_t i = 0; i < w; i++) {
+            if (fb[(y + j) * pitch + x + i] != value) return 0;
+        }
+    }
+    return 1;
+}
+
+/* ---- Tests ---- */
+
+static void test_resources(void) {
+    printf("\n=== Resources and display info ===\n");
+
+    gpu_passthrough_set_display_mode(0, 0, 640, 480, 60);
+    virtio_gpu_ctrl_hdr_t cmd = { .type = VIRTIO_GPU_CMD_GET_DISPLAY_INFO };
+    virtio_gpu_resp_display_info_t info;
+    uint32_t size = sizeof(info);
+    int rc = virtio_gpu_process_command(0, cmd.type, &cmd, sizeof(cmd), &info, &size);
+    TEST_ASSERT(rc == 0 && info.hdr.type == VIRTIO_GPU_RESP_OK_DISPLAY_INFO && size == sizeof(info),
+                "display info response");
+    TEST_ASSERT(info.pmodes[0].enabled && info.pmodes[0].r.width == 640 && info.pmodes[0].r.height == 480,
+                "display 0 reports 640x480");
+
+    TEST_ASSERT(create_2d(1, VIRTIO_GPU_FORMAT_B8G8R8X8_UNORM, 64, 32) == VIRTIO_GPU_RESP_OK_NODATA,
+                "create 2D resource");
+    TEST_ASSERT(create_2d(1, VIRTIO_GPU_FORMAT_B8G8R8X8_UNORM, 64, 32) == VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID,
+                "duplicate resource id rejected");
+    TEST_ASSERT(create_2d(2, 999, 64, 32) == VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER, "unknown format rejected");
+    TEST_ASSERT(create_2d(0, VIRTIO_GPU_FORMAT_B8G8R8X8_UNORM, 64, 32) == VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID,
+                "resource id 0 rejected");
+    TEST_ASSERT(transfer(1, 0, 0, 8, 8, 64) == VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER,
+                "transfer without backing rejected");
+
+    virtio_gpu_resource_flush_t fcmd = {
+        .hdr = { .type = VIRTIO_GPU_CMD_RESOURCE_FLUSH, .flags = VIRTIO_GPU_FLAG_FENCE, .fence_id = 77 },
+        .r = { 0, 0, 8, 8 }, .resource_id = 1
+    };
+    TEST_ASSERT(submit(&fcmd, sizeof(fcmd)) == VIRTIO_GPU_RESP_OK_NODATA && g_last_fence == 77,
+                "fence id echoed");
+    TEST_ASSERT(submit(&fcmd, sizeof(fcmd) - 4) == VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER,
+                "short command rejected");
+
+    TEST_ASSERT(unref(1) == VIRTIO_GPU_RESP_OK_NODATA && unref(1) == VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID,
+                "unref releases the id");
+    virtio_gpu_reset(0);
+}
+
+static void test_blits(void) {
+    printf("\n=== Transfer, scanout and flush ===\n");
+    const uint32_t W = 200, H = 120;
+    const uint32_t FB_W = 160, FB_H = 100;
+    uint32_t* img = malloc(W * H * 4);
+    uint32_t* fb = malloc(FB_W * FB_H * 4);
+    uint8_t* pieces[8];
+
+    for (uint32_t i = 0; i < W * H; i++) img[i] = 0xff000000u | (i * 2654435761u >> 8);
+    memset(fb, 0xAB, FB_W * FB_H * 4);
+
+    gpu_passthrough_set_display_mode(0, 0, FB_W, FB_H, 60);
+    gpu_set_framebuffer(0, 0, (uint64_t)(uintptr_t)fb, FB_W * FB_H * 4);
+
+    create_2d(5, VIRTIO_GPU_FORMAT_B8G8R8X8_UNORM, W, H);
+    TEST_ASSERT(attach_backing(5, (uint8_t*)img, W * H * 4, 5, pieces) == VIRTIO_GPU_RESP_OK_NODATA,
+                "attach 5 scattered backing entries");
+    TEST_ASSERT(set_scanout(0, 5, 20, 10, FB_W, FB_H) == VIRTIO_GPU_RESP_OK_NODATA,
+                "scanout shows a 160x100 window at (20,10)");
+    TEST_ASSERT(set_scanout(0, 5, 100, 0, FB_W, FB_H) == VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER,
+                "scanout rect outside resource rejected");
+    TEST_ASSERT(set_scanout(9, 5, 0, 0, 8, 8) == VIRTIO_GPU_RESP_ERR_INVALID_SCANOUT_ID, "bad scanout id");
+
+    /* Partial transfer: rows straddle backing entry boundaries */
+    TEST_ASSERT(transfer(5, 30, 15, 50, 40, W) == VIRTIO_GPU_RESP_OK_NODATA, "partial transfer");
+    TEST_ASSERT(flush(5, 30, 15, 50, 40) == VIRTIO_GPU_RESP_OK_NODATA, "flush damaged rect");
+    TEST_ASSERT(rect_matches(fb, FB_W, 10, 5, img, W, 30, 15, 50, 40), "flushed pixels reach the framebuffer");
+    TEST_ASSERT(rect_is(fb, FB_W, 0, 0, FB_W, 5, 0xABABABABu) && rect_is(fb, FB_W, 60, 5, 100, 40, 0xABABABABu),
+                "pixels outside the damage untouched");
+
+    virtio_gpu_rect_t damage[16];
+    int n = virtio_gpu_take_damage(0, 0, damage, 16);
+    TEST_ASSERT(n == 1 && damage[0].x == 10 && damage[0].y == 5 && damage[0].width == 50 &&
+                damage[0].height == 40, "damage reported in scanout coordinates");
+    TEST_ASSERT(virtio_gpu_take_damage(0, 0, damage, 16) == 0, "damage drained");
+
+    /* Full-width transfer is one contiguous copy */
+    TEST_ASSERT(transfer(5, 0, 0, W, H, W) == VIRTIO_GPU_RESP_OK_NODATA, "full transfer");
+    /* Flush partly outside the scanout window is clipped */
+    flush(5, 0, 0, W, 50);
+    TEST_ASSERT(rect_matches(fb, FB_W, 0, 0, img, W, 20, 10, FB_W, 40), "flush clipped to scanout window");
+    n = virtio_gpu_take_damage(0, 0, damage, 16);
+    TEST_ASSERT(n == 1 && damage[0].width == FB_W && damage[0].height == 40, "clipped damage");
+
+    /* More flushes than damage slots merge into a bounding box */
+    for (uint32_t i = 0; i < 20; i++) flush(5, 20 + i * 5, 10 + i * 3, 4, 4);
+    n = virtio_gpu_take_damage(0, 0, damage, 16);
+    TEST_ASSERT(n >= 1 && n <= 16, "damage bounded by slot count");
+    for (uint32_t i = 0; i < 20; i++) flush(5, 20 + i * 5, 10 + i * 3, 4, 4);
+    n = virtio_gpu_take_damage(0, 0, damage, 2);
+    TEST_ASSERT(n == 1 && damage[0].x == 0 && damage[0].y == 0 && damage[0].width == 99 &&
+                damage[0].height == 61, "overflow collapses into bounding box");
+
+    /* Transfer past the end of backing */
+    virtio_gpu_transfer_to_host_2d_t bad = {
+        .hdr.type = VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D, .r = { 0, 0, 10, 10 },
+        .offset = (uint64_t)W * H * 4 - 8, .resource_id = 5
+    };
+    TEST_ASSERT(submit(&bad, sizeof(bad)) == VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER, "backing overrun rejected");
+
+    /* Small framebuffer: rows past its end are clipped */
+    gpu_set_framebuffer(0, 0, (uint64_t)(uintptr_t)fb, FB_W * 4 * 20);
+    memset(fb, 0, FB_W * FB_H * 4);
+    flush(5, 20, 10, FB_W, FB_H);
+    TEST_ASSERT(rect_matches(fb, FB_W, 0, 0, img, W, 20, 10, FB_W, 20) &&
+                rect_is(fb, FB_W, 0, 20, FB_W, FB_H - 20, 0), "flush clipped to framebuffer size");
+
+    TEST_ASSERT(unref(5) == VIRTIO_GPU_RESP_OK_NODATA && flush(5, 0, 0, 1, 1) == VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID,
+                "unref detaches scanout");
+
+    virtio_gpu_reset(0);
+    for (int i = 0; i < 5; i++) free(pieces[i]);
+    free(fb);
+    free(img);
+}
+
+/* ---- Benchmark ---- */
+
+/* Per-pixel MMIO stand-in: one bounds-checked store per pixel */
+static uint32_t* g_mmio_fb;
+static uint32_t g_mmio_size;
+
+static void __attribute__((noinline)) mmio_write32(uint32_t offset, uint32_t value) {
+    if (offset + 4 <= g_mmio_size) {
+        g_mmio_fb[offset / 4] = value;
+    }
+}
+
+/*
+ * A guest repainting partial regions of a 1920x1080 scanout: per frame, a
+ * 640x480 window, a 300x200 panel, a 1920x32 status bar and a 64x64 cursor
+ * region. The per-pixel path writes each damaged pixel through an MMIO
+ * stand-in (a function call, far cheaper than a real trap, so it is a lower
+ * bound); the virtio path issues one transfer and one flush per rectangle.
+ */
+static void bench_partial_repaint(void) {
+    const uint32_t W = 1920, H = 1080;
+    const int frames = 300;
+    const virtio_gpu_rect_t regions[] = {
+        { 200, 150, 640, 480 }, { 1400, 600, 300, 200 }, { 0, 1048, 1920, 32 }, { 960, 540, 64, 64 }
+    };
+    const int nregions = sizeof(regions) / sizeof(regions[0]);
+    uint32_t* guest = malloc(W * H * 4);
+    uint32_t* fb = malloc(W * H * 4);
+    memset(guest, 0, W * H * 4);
+    memset(fb, 0, W * H * 4);
+
+    gpu_passthrough_set_display_mode(0, 0, W, H, 60);
+    gpu_set_framebuffer(0, 0, (uint64_t)(uintptr_t)fb, W * H * 4);
+    create_2d(1, VIRTIO_GPU_FORMAT_B8G8R8X8_UNORM, W, H);
+    struct {
+        virtio_gpu_resource_attach_backing_t hdr;
+        virtio_gpu_mem_entry_t entry;
+    } attach = {
+        .hdr = { .hdr.type = VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING, .resource_id = 1, .nr_entries = 1 },
+        .entry = { (uint64_t)(uintptr_t)guest, W * H * 4, 0 }
+    };
+    submit(&attach, sizeof(attach));
+    set_scanout(0, 1, 0, 0, W, H);
+
+    uint64_t damaged = 0;
+    for (int r = 0; r < nregions; r++) damaged += (uint64_t)regions[r].width * regions[r].height;
+
+    printf("\n=== Benchmark: partial repaint, 1920x1080, %d regions (%.1f%% of screen) ===\n",
+           nregions, 100.0 * damaged / (W * H));
+
+    /* Per-pixel MMIO writes of the damaged regions */
+    g_mmio_fb = fb;
+    g_mmio_size = W * H * 4;
+    uint64_t t0 = now_ns();
+    for (int f = 0; f < frames; f++) {
+        for (int r = 0; r < nregions; r++) {
+            const virtio_gpu_rect_t* rc = &regions[r];
+            for (uint32_t y = rc->y; y < rc->y + rc->height; y++) {
+                for (uint32_t x = rc->x; x < rc->x + rc->width; x++) {
+                    mmio_write32((y * W + x) * 4, (uint32_t)f ^ x);
+                }
+            }
+        }
+    }
+    double mmio_fps = frames / ((now_ns() - t0) / 1e9);
+
+    /* virtio-gpu: transfer + flush the same rectangles */
+    t0 = now_ns();
+    for (int f = 0; f < frames; f++) {
+        for (int r = 0; r < nregions; r++) {
+            const virtio_gpu_rect_t* rc = &regions[r];
+            transfer(1, rc->x, rc->y, rc->width, rc->height, W);
+            flush(1, rc->x, rc->y, rc->width, rc->height);
+        }
+        virtio_gpu_rect_t damage[16];
+        virtio_gpu_take_damage(0, 0, damage, 16);
+    }
+    double virtio_fps = frames / ((now_ns() - t0) / 1e9);
+
+    /* virtio-gpu without damage tracking: whole frame every time */
+    t0 = now_ns();
+    for (int f = 0; f < frames; f++) {
+        transfer(1, 0, 0, W, H, W);
+        flush(1, 0, 0, W, H);
+        virtio_gpu_rect_t damage[16];
+        virtio_gpu_take_damage(0, 0, damage, 16);
+    }
+    double full_fps = frames / ((now_ns() - t0) / 1e9);
+
+    printf("  per-pixel MMIO:          %8.1f fps\n", mmio_fps);
+    printf("  virtio full frame:       %8.1f fps\n", full_fps);
+    printf("  virtio damage rects:     %8.1f fps  (%.1fx vs per-pixel)\n", virtio_fps, virtio_fps / mmio_fps);
+
+    virtio_gpu_reset(0);
+    free(fb);
+    free(guest);
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("========================================\n");
+    printf("VirtIO GPU 2D Device Model Tests\n");
+    printf("========================================\n");
+
+    gpu_init();
+    test_resources();
+    test_blits();
+
+    if (bench) {
+        bench_partial_repaint();
+    }
+
+    printf("\n========================================\n");
+    printf("Passed: %d  Failed: %d\n", tests_passed, tests_failed);
+    printf("========================================\n");
+    return tests_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,901 @@
+/**
+ * Aurora OS - Writeback Tests
+ *
+ * Host-built harness for page cache writeback (filesystem/cache/
+ * page_cache.c and writeback.c) driven through the VFS on a simulated
+ * block device. Files are laid out interleaved on the device, so the
+ * order pages are written in shows up as seeks. Checks dirty accounting,
+ * age and background flushing in block order, fsync and fdatasync
+ * touching only their own file, write errors, and throttling at the
+ * dirty ratio. The filesystem journals file sizes through
+ * filesystem/journal in ordered mode; replaying the device's write log
+ * to every possible crash point checks that a committed size never
+ * covers data that had not reached the device, and that the check
+ * catches a filesystem committing too early. With --bench, reports write
+ * throughput with and without writeback and fsync latency next to a
+ * large dirty file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include "../../filesystem/cache/page_cache.h"
+#include "../../filesystem/cache/writeback.h"
+#include "../../filesystem/vfs/vfs.h"
+#include "../../filesystem/journal/journal.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("  ✓ %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("  ✗ %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/* ---- Kernel service stubs ---- */
+
+void* kmalloc(size_t size) {
+    return malloc(size);
+}
+
+void kfree(void* ptr) {
+    free(ptr);
+}
+
+uint32_t smp_get_current_cpu_id(void) {
+    return 0;
+}
+
+void cpu_relax(void) {
+    sched_yield();
+}
+
+uint32_t timer_get_ticks(void) {
+    return 0;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* ---- Simulated block device ---- */
+
+#define WB_FILES        8
+#define WB_FILE_PAGES   1024
+#define DEV_BLOCKS      (WB_FILES * WB_FILE_PAGES)
+#define BLOCK_LOG_MAX   8192
+
+static uint8_t* dev_data;
+static uint32_t dev_head;
+static uint64_t dev_writes;
+static uint64_t dev_seeks;
+static uint32_t dev_fail_block = 0xFFFFFFFF;
+static uint32_t block_log[BLOCK_LOG_MAX];
+static uint32_t block_log_n;
+
+/* Cost model for the benchmark */
+static uint64_t dev_request_ns;
+static uint64_t dev_seek_ns;
+static uint64_t dev_page_ns;
+
+/* Crash log: every device write and journal commit, in order */
+typedef enum { EV_WRITE, EV_COMMIT, EV_FSYNC_DONE } event_type_t;
+
+typedef struct {
+    event_type_t type;
+    uint32_t file;
+    uint32_t block;
+    uint32_t size;
+    uint8_t* data;
+} dev_event_t;
+
+#define EVENT_MAX 16384
+
+static dev_event_t* events;
+static uint32_t event_count;
+static int logging;
+
+static void log_event(event_type_t type, uint32_t file, uint32_t block, uint32_t size, const void* data) {
+    if (!logging || event_count >= EVENT_MAX) {
+        return;
+    }
+    dev_event_t* ev = &events[event_count++];
+    ev->type = type;
+    ev->file = file;
+    ev->block = block;
+    ev->size = size;
+    ev->data = NULL;
+    if (data) {
+        ev->data = malloc(PAGE_CACHE_SIZE);
+        memcpy(ev->data, data, PAGE_CACHE_SIZE);
+    }
+}
+
+static void clear_events(void) {
+    for (uint32_t i = 0; i < event_count; i++) {
+        free(events[i].data);
+    }
+    event_count = 0;
+}
+
+static void dev_wait(uint64_t cost) {
+    if (cost == 0) {
+        return;
+    }
+    uint64_t deadline = now_ns() + cost;
+    while (now_ns() < deadline) {
+    }
+}
+
+static int dev_write(uint32_t file, uint32_t block, const void* data) {
+    if (block == dev_fail_block) {
+        return -1;
+    }
+
+    uint64_t cost = dev_request_ns + dev_page_ns;
+    if (block != dev_head + 1) {
+        dev_seeks++;
+        cost += dev_seek_ns;
+    }
+    dev_wait(cost);
+
+    dev_head = block;
+    dev_writes++;
+    if (block_log_n < BLOCK_LOG_MAX) {
+        block_log[block_log_n++] = block;
+    }
+    memcpy(dev_data + (size_t)block * PAGE_CACHE_SIZE, data, PAGE_CACHE_SIZE);
+    log_event(EV_WRITE, file, block, 0, data);
+    return 0;
+}
+
+static void dev_reset_counters(void) {
+    dev_writes = 0;
+    dev_seeks = 0;
+    block_log_n = 0;
+    dev_head = 0xFFFFFFF0;
+}
+
+/* ---- Journalled filesystem on the device ---- */
+
+static backing_dev_t wb_bdi;
+static inode_t wb_inodes[WB_FILES];
+static uint32_t ondisk_size[WB_FILES];     /* Reached by written data */
+static uint32_t committed_size[WB_FILES];  /* Recorded by the journal */
+static uint32_t fsync_calls, datasync_calls, commits;
+static const char* wb_names[WB_FILES] = { "/f0", "/f1", "/f2", "/f3", "/f4", "/f5", "/f6", "/f7" };
+
+static uint32_t file_of(inode_t* inode) {
+    return inode->ino - 1;
+}
+
+/* Interleaved layout: page p of every file sits side by side */
+static uint32_t block_of(uint32_t file, uint32_t index) {
+    return index * WB_FILES + file;
+}
+
+static int wb_readpage(inode_t* inode, uint32_t index, void* page) {
+    uint32_t file = file_of(inode);
+    uint32_t start = index * PAGE_CACHE_SIZE;
+
+    memset(page, 0, PAGE_CACHE_SIZE);
+    if (index < WB_FILE_PAGES && start < ondisk_size[file]) {
+        uint32_t length = ondisk_size[file] - start;
+        if (length > PAGE_CACHE_SIZE) {
+            length = PAGE_CACHE_SIZE;
+        }
+        memcpy(page, dev_data + (size_t)block_of(file, index) * PAGE_CACHE_SIZE, length);
+    }
+    return 0;
+}
+
+static int wb_writepage(inode_t* inode, uint32_t index, const void* page, uint32_t length) {
+    uint32_t file = file_of(inode);
+
+    if (index >= WB_FILE_PAGES || dev_write(file, block_of(file, index), page) != 0) {
+        return -1;
+    }
+    if (index * PAGE_CACHE_SIZE + length > ondisk_size[file]) {
+        ondisk_size[file] = index * PAGE_CACHE_SIZE + length;
+    }
+    return 0;
+}
+
+static uint32_t wb_bmap(inode_t* inode, uint32_t index) {
+    return index < WB_FILE_PAGES ? block_of(file_of(inode), index) : VFS_BLOCK_NONE;
+}
+
+/* Journal a file's size; its data has to be on the device already */
+static int commit_size(uint32_t file, uint32_t size) {
+    transaction_t* txn = journal_begin_transaction();
+    if (!txn) {
+        return -1;
+    }
+    journal_operation_t op = journal_create_metadata_op(file, NULL, &size, sizeof(size));
+    if (journal_add_operation(txn, &op) != 0 || journal_commit_transaction(txn) != 0) {
+        return -1;
+    }
+    committed_size[file] = size;
+    commits++;
+    log_event(EV_COMMIT, file, 0, size, NULL);
+    return 0;
+}
+
+static int wb_fsync(inode_t* inode, int datasync) {
+    uint32_t file = file_of(inode);
+
+    if (datasync) {
+        datasync_calls++;
+        /* Only a size change is needed to read the data back */
+        if (committed_size[file] == inode->size) {
+            return 0;
+        }
+    } else {
+        fsync_calls++;
+    }
+    return commit_size(file, inode->size);
+}
+
+/**
+ * Periodic journal commit of every file's size. Ordered mode writes the
+ * data out first; the broken variant commits sizes whose data may still
+ * be only in the cache.
+ */
+static void fs_commit(int ordered) {
+    for (uint32_t f = 0; f < WB_FILES; f++) {
+        if (committed_size[f] == wb_inodes[f].size) {
+            continue;
+        }
+        if (ordered) {
+            page_cache_sync(&wb_inodes[f]);
+        }
+        commit_size(f, wb_inodes[f].size);
+    }
+}
+
+static file_ops_t wb_file_ops = {
+    .readpage = wb_readpage,
+    .writepage = wb_writepage,
+    .bmap = wb_bmap,
+    .fsync = wb_fsync
+};
+
+static int wb_mount(const char* device) {
+    (void)device;
+    for (uint32_t f = 0; f < WB_FILES; f++) {
+        memset(&wb_inodes[f], 0, sizeof(inode_t));
+        wb_inodes[f].ino = f + 1;
+        wb_inodes[f].type = FILE_TYPE_REGULAR;
+        wb_inodes[f].mode = DEFAULT_FILE_MODE;
+        wb_inodes[f].fops = &wb_file_ops;
+        page_cache_mapping_init(&wb_inodes[f].mapping, &wb_inodes[f]);
+        wb_inodes[f].mapping.bdi = &wb_bdi;
+        ondisk_size[f] = 0;
+        committed_size[f] = 0;
+    }
+    return 0;
+}
+
+static inode_t* wb_lookup(const char* path) {
+    for (uint32_t f = 0; f < WB_FILES; f++) {
+        if (strcmp(wb_names[f], path) == 0) {
+            return &wb_inodes[f];
+        }
+    }
+    return NULL;
+}
+
+static fs_ops_t wb_ops = {
+    .mount = wb_mount,
+    .lookup = wb_lookup
+};
+
+static void setup(void) {
+    static int registered = 0;
+
+    /* Forget the previous run's dirty files before the cache goes */
+    if (registered) {
+        bdi_unregister(&wb_bdi);
+    }
+    vfs_init();
+    bdi_register(&wb_bdi, "sim0");
+    registered = 1;
+
+    vfs_register_fs("wbfs", &wb_ops);
+    vfs_mount("sim0", "/", "wbfs");
+    journal_init();
+
+    memset(dev_data, 0, (size_t)DEV_BLOCKS * PAGE_CACHE_SIZE);
+    dev_reset_counters();
+    dev_fail_block = 0xFFFFFFFF;
+    fsync_calls = datasync_calls = commits = 0;
+    writeback_set_ratios(WRITEBACK_BACKGROUND_RATIO, WRITEBACK_DIRTY_RATIO);
+    writeback_set_expire(WRITEBACK_EXPIRE_US, WRITEBACK_INTERVAL_US);
+    page_cache_set_limit(PAGE_CACHE_DEFAULT_MAX_PAGES);
+}
+
+static void fill(uint8_t* buf, uint32_t size, uint32_t seed) {
+    for (uint32_t i = 0; i < size; i++) {
+        buf[i] = (uint8_t)(seed * 31 + i * 7 + (i >> 8));
+    }
+}
+
+static int disk_matches(uint32_t file, const uint8_t* expect, uint32_t size) {
+    for (uint32_t off = 0; off < size; off += PAGE_CACHE_SIZE) {
+        uint32_t len = size - off < PAGE_CACHE_SIZE ? size - off : PAGE_CACHE_SIZE;
+        const uint8_t* block = dev_data + (size_t)block_of(file, off / PAGE_CACHE_SIZE) * PAGE_CACHE_SIZE;
+        if (memcmp(block, expect + off, len) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int blocks_ascending(void) {
+    for (uint32_t i = 1; i < block_log_n; i++) {
+        if (block_log[i] <= block_log[i - 1]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static page_cache_stats_t cache_stats(void) {
+    page_cache_stats_t st;
+    page_cache_get_stats(&st);
+    return st;
+}
+
+/* ---- Dirty tracking ---- */
+
+static void test_dirty(void) {
+    printf("\nDirty tracking:\n");
+
+    setup();
+
+    static uint8_t data[16 * PAGE_CACHE_SIZE];
+    static uint8_t back[16 * PAGE_CACHE_SIZE];
+    fill(data, sizeof(data), 1);
+
+    int fd = vfs_open("/f0", O_RDWR);
+    TEST_ASSERT(vfs_write(fd, data, 10 * PAGE_CACHE_SIZE) == 10 * PAGE_CACHE_SIZE, "40 KB write succeeds");
+    TEST_ASSERT(dev_writes == 0 && cache_stats().dirty == 10, "Write only dirties 10 cached pages");
+    TEST_ASSERT(wb_inodes[0].size == 10 * PAGE_CACHE_SIZE && ondisk_size[0] == 0, "Size grows in memory, not on the device");
+    TEST_ASSERT(wb_bdi.dirty_pages == 10 && wb_bdi.dirty_head == &wb_inodes[0].mapping, "File is on the device's dirty list");
+
+    vfs_seek(fd, 0, SEEK_SET);
+    TEST_ASSERT(vfs_read(fd, back, 10 * PAGE_CACHE_SIZE) == 10 * PAGE_CACHE_SIZE &&
+                memcmp(back, data, 10 * PAGE_CACHE_SIZE) == 0, "Dirty data reads back");
+
+    uint64_t dirtied = cache_stats().dirtied;
+    vfs_seek(fd, 0, SEEK_SET);
+    vfs_write(fd, data, 10 * PAGE_CACHE_SIZE);
+    TEST_ASSERT(cache_stats().dirty == 10 && cache_stats().dirtied == dirtied, "Rewriting dirty pages counts nothing new");
+
+    page_cache_shrink(UINT32_MAX);
+    TEST_ASSERT(cache_stats().pages == 10, "Reclaim leaves dirty pages alone");
+
+    TEST_ASSERT(writeback_sync(&wb_bdi) == 10 && dev_writes == 10, "Sync writes the 10 pages once each");
+    TEST_ASSERT(cache_stats().dirty == 0 && wb_bdi.dirty_pages == 0 && wb_bdi.dirty_head == NULL,
+                "Nothing dirty afterwards");
+    TEST_ASSERT(disk_matches(0, data, 10 * PAGE_CACHE_SIZE), "Device holds the data");
+    TEST_ASSERT(page_cache_shrink(UINT32_MAX) == 10, "Clean pages can be reclaimed");
+    vfs_close(fd);
+
+    /* Last page partly used */
+    fd = vfs_open("/f1", O_RDWR);
+    vfs_write(fd, data, 10000);
+    writeback_sync(&wb_bdi);
+    TEST_ASSERT(ondisk_size[1] == 10000, "Last page written up to end of file");
+    vfs_close(fd);
+
+    /* Truncating a dirty file drops its dirty pages */
+    fd = vfs_open("/f2", O_RDWR);
+    vfs_write(fd, data, 5 * PAGE_CACHE_SIZE);
+    page_cache_truncate(&wb_inodes[2].mapping, 0);
+    TEST_ASSERT(cache_stats().dirty == 0 && wb_bdi.dirty_pages == 0 && wb_inodes[2].mapping.nrdirty == 0,
+                "Truncation drops dirty pages and their accounting");
+    vfs_close(fd);
+}
+
+/* ---- Flusher ---- */
+
+static void test_flusher(void) {
+    printf("\nFlusher:\n");
+
+    setup();
+
+    static uint8_t data[64 * PAGE_CACHE_SIZE];
+    fill(data, sizeof(data), 2);
+
+    /* Age */
+    writeback_run(&wb_bdi, 1000000);
+    int a = vfs_open("/f0", O_RDWR);
+    vfs_write(a, data, 4 * PAGE_CACHE_SIZE);
+    TEST_ASSERT(writeback_run(&wb_bdi, 10000000) == 0, "Young dirty data is left in the cache");
+
+    int b = vfs_open("/f1", O_RDWR);
+    vfs_write(b, data, 4 * PAGE_CACHE_SIZE);
+    TEST_ASSERT(writeback_run(&wb_bdi, 31000000) == 4 && wb_inodes[0].mapping.nrdirty == 0 &&
+                wb_inodes[1].mapping.nrdirty == 4, "After 30 s only the older file is written");
+    TEST_ASSERT(writeback_run(&wb_bdi, 40000000) == 4 && cache_stats().dirty == 0, "The newer one follows once it expires");
+
+    writeback_stats_t ws;
+    writeback_get_stats(&wb_bdi, &ws);
+    TEST_ASSERT(ws.expired_pages == 8 && ws.background_pages == 0, "Accounted as expired");
+    vfs_close(a);
+    vfs_close(b);
+
+    /* Background ratio: 200 page cache, 20 background, 40 limit */
+    setup();
+    page_cache_set_limit(200);
+    writeback_set_ratios(10, 20);
+    a = vfs_open("/f0", O_RDWR);
+    vfs_write(a, data, 30 * PAGE_CACHE_SIZE);
+    writeback_get_stats(&wb_bdi, &ws);
+    TEST_ASSERT(wb_bdi.flush_wake && ws.wakeups == 1, "Passing the background ratio wakes the flusher");
+    TEST_ASSERT(dev_writes == 0 && ws.throttled == 0, "Writer is not held back below the dirty ratio");
+    TEST_ASSERT(writeback_run(&wb_bdi, 0) == 10 && cache_stats().dirty == 20 && !wb_bdi.flush_wake,
+                "Flusher writes down to the background ratio");
+    vfs_close(a);
+
+    /* Failing writeback ends throttling with an error rather than a wait */
+    setup();
+    page_cache_set_limit(200);
+    writeback_set_ratios(10, 20);
+    a = vfs_open("/f0", O_RDWR);
+    dev_fail_block = block_of(0, 44);   /* Newest pages go first */
+    TEST_ASSERT(vfs_write(a, data, 45 * PAGE_CACHE_SIZE) == -1,
+                "A throttled writer gets the writeback error back");
+    writeback_get_stats(&wb_bdi, &ws);
+    TEST_ASSERT(ws.throttled == 1 && ws.write_errors == 1, "The failed page is counted");
+    vfs_close(a);
+    setup();
+    a = vfs_open("/f0", O_RDWR);
+    vfs_write(a, data, PAGE_CACHE_SIZE);
+    dev_fail_block = block_of(0, 0);
+    TEST_ASSERT(writeback_run(&wb_bdi, UINT64_MAX / 2) == 1 && wb_bdi.pass_result == -1,
+                "A pass whose writes all fail reports no progress");
+    dev_fail_block = 0xFFFFFFFF;
+    TEST_ASSERT(writeback_run(&wb_bdi, UINT64_MAX / 2 + WRITEBACK_EXPIRE_US) == 1 &&
+                wb_bdi.pass_result == 1,
+                "The next pass makes progress once the device recovers");
+    vfs_close(a);
+
+    /* Block order across files */
+    setup();
+    int fds[4];
+    for (int f = 0; f < 4; f++) {
+        fds[f] = vfs_open(wb_names[f], O_RDWR);
+    }
+    for (int i = 0; i < 200; i++) {
+        int f = (int)(rng() % 4);
+        uint32_t page = (uint32_t)(rng() % 64);
+        vfs_seek(fds[f], (long)page * PAGE_CACHE_SIZE, SEEK_SET);
+        vfs_write(fds[f], data, PAGE_CACHE_SIZE);
+    }
+    uint32_t dirty = cache_stats().dirty;
+    dev_reset_counters();
+    writeback_sync(&wb_bdi);
+    TEST_ASSERT(dev_writes == dirty && blocks_ascending(), "Pages of several files go out in block order");
+    for (int f = 0; f < 4; f++) {
+        vfs_close(fds[f]);
+    }
+}
+
+/* ---- fsync ---- */
+
+static void test_fsync(void) {
+    printf("\nfsync:\n");
+
+    setup();
+
+    static uint8_t data[32 * PAGE_CACHE_SIZE];
+    fill(data, sizeof(data), 3);
+
+    int a = vfs_open("/f0", O_RDWR);
+    int b = vfs_open("/f1", O_RDWR);
+    vfs_write(a, data, 8 * PAGE_CACHE_SIZE);
+    vfs_write(b, data, 16 * PAGE_CACHE_SIZE);
+
+    TEST_ASSERT(vfs_fsync(a) == 0, "fsync succeeds");
+    TEST_ASSERT(dev_writes == 8 && wb_inodes[0].mapping.nrdirty == 0 && wb_inodes[1].mapping.nrdirty == 16,
+                "Only the file's own pages are written");
+    TEST_ASSERT(blocks_ascending(), "In block order");
+    TEST_ASSERT(fsync_calls == 1 && committed_size[0] == 8 * PAGE_CACHE_SIZE, "Its size is journalled afterwards");
+    TEST_ASSERT(disk_matches(0, data, 8 * PAGE_CACHE_SIZE), "Data is on the device");
+
+    dev_reset_counters();
+    TEST_ASSERT(vfs_fsync(a) == 0 && dev_writes == 0, "fsync of a clean file writes nothing");
+
+    /* Overwrite in place: fdatasync needs no journal commit */
+    uint32_t before = commits;
+    vfs_seek(a, 0, SEEK_SET);
+    vfs_write(a, data + PAGE_CACHE_SIZE, 2 * PAGE_CACHE_SIZE);
+    TEST_ASSERT(vfs_fdatasync(a) == 0 && dev_writes == 2 && datasync_calls == 1 && commits == before,
+                "fdatasync after an overwrite skips the journal");
+    vfs_seek(a, 0, SEEK_END);
+    vfs_write(a, data, PAGE_CACHE_SIZE);
+    TEST_ASSERT(vfs_fdatasync(a) == 0 && commits == before + 1 && committed_size[0] == 9 * PAGE_CACHE_SIZE,
+                "fdatasync after an append journals the size");
+
+    /* Write error */
+    vfs_seek(b, 0, SEEK_SET);
+    vfs_write(b, data, PAGE_CACHE_SIZE);
+    dev_fail_block = block_of(1, 3);
+    page_cache_stats_t st = cache_stats();
+    TEST_ASSERT(vfs_fsync(b) == -1, "fsync reports a failed page write");
+    TEST_ASSERT(cache_stats().write_errors == st.write_errors + 1 && wb_inodes[1].mapping.nrdirty == 1,
+                "The failed page stays dirty");
+    dev_fail_block = 0xFFFFFFFF;
+    TEST_ASSERT(vfs_fsync(b) == 0 && wb_inodes[1].mapping.nrdirty == 0, "Retried once the device recovers");
+    TEST_ASSERT(disk_matches(1, data, 16 * PAGE_CACHE_SIZE), "All of the file is on the device");
+    TEST_ASSERT(vfs_fsync(b) == 0, "The error is reported once");
+
+    vfs_close(a);
+    vfs_close(b);
+}
+
+/* ---- Throttling ---- */
+
+static void test_throttle(void) {
+    printf("\nThrottling:\n");
+
+    setup();
+    page_cache_set_limit(400);
+    writeback_set_ratios(10, 20);
+
+    static uint8_t data[PAGE_CACHE_SIZE];
+    static uint8_t back[PAGE_CACHE_SIZE];
+    int fd = vfs_open("/f3", O_RDWR);
+    uint32_t worst = 0;
+    for (uint32_t p = 0; p < 512; p++) {
+        fill(data, PAGE_CACHE_SIZE, p);
+        vfs_write(fd, data, PAGE_CACHE_SIZE);
+        page_cache_stats_t st = cache_stats();
+        if (st.dirty + st.writeback > worst) {
+            worst = st.dirty + st.writeback;
+        }
+    }
+    writeback_stats_t ws;
+    writeback_get_stats(&wb_bdi, &ws);
+    TEST_ASSERT(worst <= 81, "Dirty pages never pass the 20% limit");
+    TEST_ASSERT(ws.throttled > 0 && ws.direct_pages > 0, "The writer was throttled");
+    TEST_ASSERT(cache_stats().dirty >= 40, "Throttling stops halfway, not at zero");
+
+    writeback_sync(&wb_bdi);
+    int ok = 1;
+    vfs_seek(fd, 0, SEEK_SET);
+    for (uint32_t p = 0; p < 512; p++) {
+        fill(data, PAGE_CACHE_SIZE, p);
+        if (vfs_read(fd, back, PAGE_CACHE_SIZE) != PAGE_CACHE_SIZE || memcmp(back, data, PAGE_CACHE_SIZE) != 0 ||
+            memcmp(dev_data + (size_t)block_of(3, p) * PAGE_CACHE_SIZE, data, PAGE_CACHE_SIZE) != 0) {
+            ok = 0;
+        }
+    }
+    TEST_ASSERT(ok, "2 MB reads back from cache and device intact");
+    vfs_close(fd);
+}
+
+/* ---- Crash ordering ---- */
+
+#define REC_MAGIC   0x52454331u
+#define CRASH_FILES 3
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t len;
+    uint32_t sum;
+} record_t;
+
+static uint32_t record_sum(const uint8_t* payload, uint32_t len, uint32_t seq) {
+    uint32_t sum = seq * 2654435761u;
+    for (uint32_t i = 0; i < len; i++) {
+        sum = (sum << 5) + sum + payload[i];
+    }
+    return sum;
+}
+
+/* Append-only workload with fsyncs, background flushes and journal commits */
+static void crash_workload(int ordered) {
+    static uint8_t buf[sizeof(record_t) + 9000];
+    uint32_t seq[CRASH_FILES] = { 0 };
+    int fds[CRASH_FILES];
+
+    for (int f = 0; f < CRASH_FILES; f++) {
+        fds[f] = vfs_open(wb_names[f], O_RDWR | O_APPEND);
+    }
+
+    logging = 1;
+    for (int step = 0; step < 400; step++) {
+        int f = (int)(rng() % CRASH_FILES);
+        if (wb_inodes[f].size > 200 * 1024) {
+            continue;
+        }
+
+        record_t* rec = (record_t*)buf;
+        uint32_t len = 50 + (uint32_t)(rng() % 8950);
+        rec->magic = REC_MAGIC;
+        rec->seq = ++seq[f];
+        rec->len = len;
+        fill(buf + sizeof(record_t), len, rec->seq + (uint32_t)f * 1000);
+        rec->sum = record_sum(buf + sizeof(record_t), len, rec->seq);
+        vfs_write(fds[f], buf, sizeof(record_t) + len);
+
+        uint32_t action = (uint32_t)(rng() % 12);
+        if (action == 0) {
+            if (vfs_fsync(fds[f]) == 0) {
+                log_event(EV_FSYNC_DONE, (uint32_t)f, 0, wb_inodes[f].size, NULL);
+            }
+        } else if (action == 1) {
+            page_cache_writeback(&wb_bdi, 1 + (uint32_t)(rng() % 8), UINT64_MAX);
+        } else if (action == 2) {
+            fs_commit(ordered);
+        }
+    }
+    logging = 0;
+
+    for (int f = 0; f < CRASH_FILES; f++) {
+        vfs_close(fds[f]);
+    }
+}
+
+static uint8_t* crash_disk;
+
+static uint8_t crash_byte(uint32_t file, uint32_t offset) {
+    uint32_t block = block_of(file, offset / PAGE_CACHE_SIZE);
+    return crash_disk[(size_t)block * PAGE_CACHE_SIZE + offset % PAGE_CACHE_SIZE];
+}
+
+/* Are the first size bytes of a file whole, valid records? */
+static int file_valid(uint32_t file, uint32_t size) {
+    static uint8_t payload[9000];
+    uint32_t off = 0;
+    uint32_t expect_seq = 1;
+
+    while (off < size) {
+        record_t rec;
+        uint8_t* r = (uint8_t*)&rec;
+        if (size - off < sizeof(rec)) {
+            return 0;
+        }
+        for (uint32_t i = 0; i < sizeof(rec); i++) {
+            r[i] = crash_byte(file, off + i);
+        }
+        off += sizeof(rec);
+        if (rec.magic != REC_MAGIC || rec.seq != expect_seq++ || rec.len > sizeof(payload) || size - off < rec.len) {
+            return 0;
+        }
+        for (uint32_t i = 0; i < rec.len; i++) {
+            payload[i] = crash_byte(file, off + i);
+        }
+        off += rec.len;
+        if (record_sum(payload, rec.len, rec.seq) != rec.sum) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Replay the log, crashing after every event in turn
+ * @return Crash points where a committed size covers bad data, or an
+ *         fsync that had returned was lost
+ */
+static uint32_t replay_crashes(uint32_t* points) {
+    uint32_t committed[CRASH_FILES] = { 0 };
+    uint32_t synced[CRASH_FILES] = { 0 };
+    uint32_t violations = 0;
+
+    memset(crash_disk, 0, (size_t)DEV_BLOCKS * PAGE_CACHE_SIZE);
+    *points = 0;
+
+    for (uint32_t i = 0; i < event_count; i++) {
+        dev_event_t* ev = &events[i];
+        if (ev->type == EV_WRITE) {
+            memcpy(crash_disk + (size_t)ev->block * PAGE_CACHE_SIZE, ev->data, PAGE_CACHE_SIZE);
+        } else if (ev->type == EV_COMMIT) {
+            committed[ev->file] = ev->size;
+        } else {
+            synced[ev->file] = ev->size;
+        }
+
+        (*points)++;
+        for (uint32_t f = 0; f < CRASH_FILES; f++) {
+            if (committed[f] < synced[f] || !file_valid(f, committed[f])) {
+                violations++;
+                break;
+            }
+        }
+    }
+    return violations;
+}
+
+static void test_crash(void) {
+    printf("\nCrash ordering with the journal:\n");
+
+    events = calloc(EVENT_MAX, sizeof(dev_event_t));
+    crash_disk = malloc((size_t)DEV_BLOCKS * PAGE_CACHE_SIZE);
+
+    setup();
+    crash_workload(1);
+    uint32_t writes = 0, commits_logged = 0, fsyncs = 0;
+    for (uint32_t i = 0; i < event_count; i++) {
+        writes += events[i].type == EV_WRITE;
+        commits_logged += events[i].type == EV_COMMIT;
+        fsyncs += events[i].type == EV_FSYNC_DONE;
+    }
+    TEST_ASSERT(writes > 100 && commits_logged > 10 && fsyncs >= 3, "Workload mixes writeback, commits and fsyncs");
+
+    uint32_t points;
+    uint32_t violations = replay_crashes(&points);
+    TEST_ASSERT(violations == 0, "Ordered mode: no crash point exposes unwritten data");
+    TEST_ASSERT(points == event_count && points > 100, "Every event boundary checked as a crash point");
+
+    int durable = 1;
+    for (uint32_t f = 0; f < CRASH_FILES; f++) {
+        memcpy(crash_disk, dev_data, (size_t)DEV_BLOCKS * PAGE_CACHE_SIZE);
+        if (!file_valid(f, committed_size[f])) {
+            durable = 0;
+        }
+    }
+    TEST_ASSERT(durable, "Final device state is consistent");
+    clear_events();
+
+    /* Same workload, journalling sizes before the data is written */
+    setup();
+    crash_workload(0);
+    violations = replay_crashes(&points);
+    TEST_ASSERT(violations > 0, "Committing before writeback is caught");
+    clear_events();
+
+    free(events);
+    free(crash_disk);
+}
+
+/* ---- Benchmark ---- */
+
+static double bench_writes(int writeback, int random_pattern) {
+    static uint8_t data[PAGE_CACHE_SIZE];
+    const uint32_t pages = 2048;
+
+    setup();
+    page_cache_set_limit(8192);
+    for (uint32_t f = 0; f < WB_FILES; f++) {
+        wb_inodes[f].mapping.bdi = writeback ? &wb_bdi : NULL;
+        wb_inodes[f].size = 256 * PAGE_CACHE_SIZE;
+        ondisk_size[f] = 256 * PAGE_CACHE_SIZE;
+    }
+
+    int fds[WB_FILES];
+    for (uint32_t f = 0; f < WB_FILES; f++) {
+        fds[f] = vfs_open(wb_names[f], O_RDWR);
+    }
+    fill(data, sizeof(data), 9);
+    dev_reset_counters();
+
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < pages; i++) {
+        uint32_t f, page;
+        if (random_pattern) {
+            f = (uint32_t)(rng() % WB_FILES);
+            page = (uint32_t)(rng() % 256);
+        } else {
+            f = i / 256;
+            page = i % 256;
+        }
+        vfs_seek(fds[f], (long)page * PAGE_CACHE_SIZE, SEEK_SET);
+        vfs_write(fds[f], data, PAGE_CACHE_SIZE);
+    }
+    writeback_sync(&wb_bdi);
+    uint64_t elapsed = now_ns() - start;
+
+    for (uint32_t f = 0; f < WB_FILES; f++) {
+        vfs_close(fds[f]);
+        wb_inodes[f].mapping.bdi = &wb_bdi;
+    }
+    return (double)pages * PAGE_CACHE_SIZE / (1024.0 * 1024.0) / ((double)elapsed / 1e9);
+}
+
+static void bench_fsync(void) {
+    static uint8_t data[PAGE_CACHE_SIZE];
+    uint64_t total[2] = { 0, 0 }, worst[2] = { 0, 0 };
+    const int rounds = 50;
+
+    setup();
+    page_cache_set_limit(8192);
+    fill(data, sizeof(data), 4);
+    int big = vfs_open("/f0", O_RDWR);
+    int small = vfs_open("/f1", O_RDWR | O_APPEND);
+
+    /* mode 0: fsync the small file; mode 1: sync the whole device first */
+    for (int mode = 0; mode < 2; mode++) {
+        for (int r = 0; r < rounds; r++) {
+            vfs_seek(big, 0, SEEK_SET);
+            for (int p = 0; p < 256; p++) {
+                vfs_write(big, data, PAGE_CACHE_SIZE);
+            }
+            vfs_write(small, data, 512);
+
+            uint64_t start = now_ns();
+            if (mode == 1) {
+                writeback_sync(&wb_bdi);
+            }
+            vfs_fsync(small);
+            uint64_t t = now_ns() - start;
+            total[mode] += t;
+            if (t > worst[mode]) {
+                worst[mode] = t;
+            }
+        }
+        writeback_sync(&wb_bdi);
+    }
+
+    printf("  fsync next to 1 MB dirty:  avg %7.0f us  max %7.0f us\n",
+           (double)total[0] / rounds / 1000.0, (double)worst[0] / 1000.0);
+    printf("  sync device then fsync:    avg %7.0f us  max %7.0f us\n",
+           (double)total[1] / rounds / 1000.0, (double)worst[1] / 1000.0);
+    vfs_close(big);
+    vfs_close(small);
+}
+
+static void run_bench(void) {
+    /* 20 us per request, 200 us seek, 4 us per page */
+    dev_request_ns = 20000;
+    dev_seek_ns = 200000;
+    dev_page_ns = 4000;
+
+    printf("\nBenchmark (8 MB of 4 KB writes over 8 interleaved files):\n");
+    double wt = bench_writes(0, 0);
+    double wb = bench_writes(1, 0);
+    printf("  file by file    write-through %7.1f MB/s   writeback %7.1f MB/s\n", wt, wb);
+    wt = bench_writes(0, 1);
+    wb = bench_writes(1, 1);
+    printf("  random          write-through %7.1f MB/s   writeback %7.1f MB/s\n", wt, wb);
+
+    bench_fsync();
+
+    dev_request_ns = dev_seek_ns = dev_page_ns = 0;
+}
+
+int main(int argc, char** argv) {
+    int bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+
+    printf("Aurora OS Writeback Tests\n");
+
+    dev_data = malloc((size_t)DEV_BLOCKS * PAGE_CACHE_SIZE);
+
+    test_dirty();
+    test_flusher();
+    test_fsync();
+    test_throttle();
+    test_crash();
+
+    if (bench) {
+        run_bench();
+    }
+
+    free(dev_data);
+    printf("\nPassed: %d  Failed: %d\n", tests_passed, tests_failed);
+    return tests_failed ? 1 : 0;
+}
@@ -5,6 +5,7 @@
  */
 
 #include "../kernel/memory/memory.h"
+#include "../kernel/memory/paging.h"
 #include "../kernel/process/process.h"
 #include "../filesystem/vfs/vfs.h"
 #include "../filesystem/journal/journal.h"
@@ -45,6 +46,31 @@ void test_memory(void) {
     } else {
         vga_write("vm_alloc: FAIL\n");
     }
+    
+    /* Test large-page vm_alloc: mapped with a 4 MB page, and freeing it
+     * leaves the kernel's identity mapping alone */
+    page_directory_t* kdir = paging_get_kernel_directory();
+    paging_huge_stats_t before, after;
+    paging_get_huge_stats(&before);
+    uint32_t huge = (uint32_t)(uintptr_t)vm_alloc(HUGE_PAGE_SIZE, MEM_KERNEL);
+    paging_get_huge_stats(&after);
+    if (huge && !(huge & (HUGE_PAGE_SIZE - 1)) && after.huge_maps == before.huge_maps + 1 &&
+        paging_get_physical_address(kdir, huge + PAGE_SIZE) == huge + PAGE_SIZE) {
+        vga_write("vm_alloc (4 MB page): PASS\n");
+    } else {
+        vga_write("vm_alloc (4 MB page): FAIL\n");
+    }
+    if (huge) {
+        vm_free((void*)(uintptr_t)huge);
+        paging_get_huge_stats(&after);
+        if (after.huge_unmaps == before.huge_unmaps + 1 &&
+            paging_get_physical_address(kdir, huge) == 0 &&
+            paging_get_physical_address(kdir, 0x00100000) == 0x00100000) {
+            vga_write("vm_free (4 MB page): PASS\n");
+        } else {
+            vga_write("vm_free (4 MB page): FAIL\n");
+        }
+    }
 }
 
 /**